@@ -0,0 +1,218 @@
+/**
+ * @file vivid.h
+ * @brief C API of libvivid: the ViVid pipeline embedded in another application.
+ *
+ * A pipeline is created from a vivid_config, receives the frames of the application with vivid_push_frame() and
+ * hands the detections of each frame to a callback or to vivid_poll(). Every pipeline owns its devices' queues,
+ * buffers, item pool and threads, so several pipelines can run in the same process.
+ *
+ * Typical use:
+ *   vivid_config config;
+ *   vivid_config_init(&config);
+ *   config.width = 1920; config.height = 1080; config.pixel_type = VIVID_PIXEL_UINT8;
+ *   vivid_pipeline *pipeline;
+ *   if (vivid_create(&config, &pipeline, error, sizeof(error)) != VIVID_OK) { ... }
+ *   while (capturing) vivid_push_frame(pipeline, pixels, -1, &frame_id);   // results: callback or vivid_poll()
+ *   vivid_close(pipeline);                                                  // waits for the last frame
+ *   vivid_get_stats(pipeline, &stats);
+ *   vivid_destroy(pipeline);
+ *
+ * Results are delivered in the order the frames leave the pipeline, which is not always the order they were pushed:
+ * use the frame id returned by vivid_push_frame() to match them, or set in_order to get them in the order of the ids. Without a callback the results must be polled; when
+ * result_depth results are waiting the pipeline stops taking frames until the application polls.
+ *
+ * Compatibility: the structures start with their size, so a library built with a newer vivid.h accepts the
+ * structures of an application built with an older one. Fields are only ever appended.
+ */
+#ifndef VIVID_H
+#define VIVID_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define VIVID_VERSION_MAJOR 1
+#define VIVID_VERSION_MINOR 2
+
+/**
+ * @brief Opaque handle of a pipeline.
+ */
+typedef struct vivid_pipeline vivid_pipeline;
+
+/**
+ * @brief Result of the calls of the API.
+ */
+typedef enum vivid_status {
+    VIVID_OK = 0,                     /**< Success. */
+    VIVID_ERROR_INVALID_ARGUMENT = 1, /**< A parameter or a field of the configuration is not valid. */
+    VIVID_ERROR_RUNTIME = 2,          /**< The pipeline failed (devices, memory, callback...); see vivid_last_error(). */
+    VIVID_ERROR_TIMEOUT = 3,          /**< Nothing happened before the timeout. */
+    VIVID_ERROR_CLOSED = 4            /**< The pipeline has been closed (and, for vivid_poll, every result delivered). */
+} vivid_status;
+
+/**
+ * @brief Backend of the pipeline (the --api values of the command line).
+ */
+typedef enum vivid_api {
+    VIVID_API_PIPELINE = 0,   /**< oneTBB parallel_pipeline. */
+    VIVID_API_FGFN = 1,       /**< oneTBB flow graph, function nodes. */
+    VIVID_API_FGAN = 2,       /**< oneTBB flow graph, async nodes. */
+    VIVID_API_SYCLEVENTS = 3, /**< SYCL events. */
+    VIVID_API_TASKFLOW = 4,   /**< Taskflow pipeline. */
+    VIVID_API_SERIE = 5,      /**< One frame at a time. */
+    VIVID_API_CORO = 6        /**< C++20 coroutines, one per frame in flight. */
+} vivid_api;
+
+/**
+ * @brief Type of the pixels of the pushed frames (single channel).
+ */
+typedef enum vivid_pixel_type {
+    VIVID_PIXEL_FLOAT32 = 1,
+    VIVID_PIXEL_UINT8 = 2,
+    VIVID_PIXEL_UINT16 = 3
+} vivid_pixel_type;
+
+/**
+ * @brief A window of a frame and the class it matches best.
+ */
+typedef struct vivid_detection {
+    uint32_t x;     /**< Left column of the window (pixels). */
+    uint32_t y;     /**< Top row of the window (pixels). */
+    uint32_t cls;   /**< Best class of the window. */
+    float score;    /**< Squared distance to the class (smaller is a better match). */
+} vivid_detection;
+
+/**
+ * @brief Detections of a frame, sorted by score.
+ */
+typedef struct vivid_result {
+    uint64_t frame_id;                 /**< Id returned by vivid_push_frame() for the frame. */
+    uint32_t count;                    /**< Number of detections. */
+    const vivid_detection *detections; /**< Detections (only valid during the callback, or until the next poll). */
+} vivid_result;
+
+/**
+ * @brief Callback that receives the result of each frame (called from a thread of the pipeline, one call at a time).
+ *
+ * The callback may block (the pipeline waits for it) but must not call the API of the same pipeline.
+ */
+typedef void (*vivid_result_callback)(const vivid_result *result, void *user_data);
+
+/**
+ * @brief Configuration of a pipeline. Initialise it with vivid_config_init() and set the fields you need.
+ */
+typedef struct vivid_config {
+    uint32_t struct_size;            /**< sizeof(vivid_config) (set by vivid_config_init). */
+    vivid_api api;                   /**< Backend (default: VIVID_API_PIPELINE). */
+    const char *config_stages;       /**< Device of each stage as in --config, e.g. "000", "222", "CPU" (NULL: default). */
+    uint32_t width;                  /**< Width of the frames (required). */
+    uint32_t height;                 /**< Height of the frames (required). */
+    vivid_pixel_type pixel_type;     /**< Type of the pixels (default: VIVID_PIXEL_FLOAT32). */
+    uint32_t threads;                /**< CPU threads (0: default). */
+    uint32_t in_flight_frames;       /**< Frames processed at the same time (0: default). */
+    uint32_t queue_depth;            /**< Pushed frames that can wait for the pipeline (0: default). */
+    uint32_t top_k;                  /**< Detections reported per frame (0: default). */
+    uint32_t result_depth;           /**< Results that can wait to be delivered (0: default). */
+    int drop_results;                /**< Drop results instead of waiting when result_depth are waiting (default: 0). */
+    vivid_result_callback callback;  /**< Receives the results (NULL: use vivid_poll). */
+    void *user_data;                 /**< Passed to the callback. */
+    int verbose;                     /**< Print the configuration and the devices like the command line (default: 0). */
+    const char *stages;              /**< Stages of the pipeline as in --stages, e.g. "cosine,histogram,pwdist" (NULL: default). */
+    int in_order;                    /**< Deliver the results in the order of the frame ids, as --reorder (default: 0). */
+} vivid_config;
+
+/**
+ * @brief Statistics of a pipeline.
+ */
+typedef struct vivid_stats {
+    uint32_t struct_size;       /**< sizeof(vivid_stats), set by the caller. */
+    uint64_t frames_pushed;     /**< Frames accepted by vivid_push_frame(). */
+    uint64_t frames_processed;  /**< Frames whose result has been delivered (callback or waiting for vivid_poll). */
+    uint64_t results_dropped;   /**< Results dropped because result_depth were waiting (drop_results). */
+    uint64_t push_waits;        /**< Pushes that waited for a free slot of the input queue. */
+    double push_wait_ms;        /**< Total time the pushes waited (ms). */
+    uint64_t input_stalls;      /**< Times the pipeline waited for a frame to be pushed. */
+    double input_stall_ms;      /**< Total time the pipeline waited for frames (ms). */
+    uint64_t result_waits;      /**< Frames that waited for the delivery of older results. */
+    double result_wait_ms;      /**< Total time the frames waited for the delivery (ms). */
+    double elapsed_s;           /**< Time since the pipeline was created, or until it was closed (s). */
+    double throughput_fps;      /**< frames_processed / elapsed_s. */
+    uint64_t usm_bytes;         /**< USM allocated by this pipeline (buffers, items and input queue), in bytes. */
+    uint64_t usm_peak_bytes;    /**< Most USM allocated by this pipeline at the same time, in bytes. */
+    uint64_t reorder_held;      /**< Frames held by in_order until an older one was processed. */
+    double reorder_wait_ms;     /**< Total time the held frames waited for the older ones (ms). */
+} vivid_stats;
+
+/**
+ * @brief Version of the library, (VIVID_VERSION_MAJOR << 16) | VIVID_VERSION_MINOR.
+ */
+uint32_t vivid_version(void);
+
+/**
+ * @brief Fill a configuration with the default values.
+ */
+void vivid_config_init(vivid_config *config);
+
+/**
+ * @brief Create a pipeline and start it (it waits for the first frame).
+ * @param config Configuration (copied).
+ * @param pipeline Receives the pipeline (NULL on failure).
+ * @param error Receives the description of the failure (may be NULL).
+ * @param error_size Size of error in bytes.
+ */
+vivid_status vivid_create(const vivid_config *config, vivid_pipeline **pipeline, char *error, size_t error_size);
+
+/**
+ * @brief Copy a frame into the input queue of the pipeline.
+ * @param pixels height rows of width pixels of pixel_type, without padding (the buffer can be reused on return).
+ * @param timeout_ms Maximum time to wait for a free slot of the queue (negative: no limit, 0: do not wait).
+ * @param frame_id Receives the id of the frame in its result (may be NULL).
+ * @return VIVID_OK, VIVID_ERROR_TIMEOUT, VIVID_ERROR_CLOSED or VIVID_ERROR_RUNTIME if the pipeline has failed.
+ */
+vivid_status vivid_push_frame(vivid_pipeline *pipeline, const void *pixels, int timeout_ms, uint64_t *frame_id);
+
+/**
+ * @brief Take the oldest result waiting to be delivered (only without a callback).
+ * @param result Receives the result; its detections are valid until the next call or vivid_destroy().
+ * @param timeout_ms Maximum time to wait for a result (negative: no limit, 0: do not wait).
+ * @return VIVID_OK, VIVID_ERROR_TIMEOUT, or VIVID_ERROR_CLOSED once the pipeline is closed and every result has been taken.
+ */
+vivid_status vivid_poll(vivid_pipeline *pipeline, vivid_result *result, int timeout_ms);
+
+/**
+ * @brief End the stream: wait until every pushed frame has been processed and its result delivered.
+ *
+ * Without a callback, the results that do not fit in result_depth must be polled from another thread while closing.
+ *
+ * @return VIVID_OK, or VIVID_ERROR_RUNTIME if the pipeline failed.
+ */
+vivid_status vivid_close(vivid_pipeline *pipeline);
+
+/**
+ * @brief Get the statistics of the pipeline (stats->struct_size must be set).
+ */
+vivid_status vivid_get_stats(vivid_pipeline *pipeline, vivid_stats *stats);
+
+/**
+ * @brief Get the description of the last failure of the pipeline ("" if there is none).
+ */
+const char *vivid_last_error(const vivid_pipeline *pipeline);
+
+/**
+ * @brief Get the name of a status.
+ */
+const char *vivid_status_string(vivid_status status);
+
+/**
+ * @brief Close the pipeline if needed and free all its resources.
+ */
+void vivid_destroy(vivid_pipeline *pipeline);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* VIVID_H */
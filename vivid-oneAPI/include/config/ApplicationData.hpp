@@ -1,6 +1,11 @@
 #ifndef APPLICATION_DATA_HPP
 #define APPLICATION_DATA_HPP
 
+#include "CameraEmulator.hpp"
+#include "FrameSource.hpp"
+#include "ReorderBuffer.hpp"
+#include "ResultSink.hpp"
+#include "TemporalCache.hpp"
 #include "pipeline_template.hpp"
 #include <array>
 #include <atomic>
@@ -15,6 +20,7 @@ class ApplicationData {
   public:
     int height = 0;
     int width = 0;
+    PixelType pixelType = PixelType::Float32; // Type of the pixels of the input frames
     const int numFilters = 100;
     const int window_height = 128;
     const int windowWidth = 64;
@@ -28,25 +34,28 @@ class ApplicationData {
     bool autoMode = true;
 
     sycl::queue USM_queue;
+    USMUsage usmUsage; // USM allocated by the buffers of this pipeline (also added to USMUsage::process())
 
-    int id = 0;
+    std::atomic<int> id = 0; // Last frame ID assigned (incremented concurrently by the input nodes)
 
     // Buffers
-    FloatBuffer *globalFrame = nullptr;
+    FrameBuffer *globalFrame = nullptr;
     FloatBuffer *globalCla = nullptr;
+    std::vector<FloatBuffer *> stageCla; // Classes of the stages with their own classifier (--stages name:dict=N:model=FILE)
     float *filterBank = nullptr;
 
     // Number of frames to process in the optimization
     std::atomic<int> numGPUframes = 0;
     std::atomic<int> numCPUframes = 0;
 
-    // Vectors of atomic integers for filters on GPU and CPU
+    // Vectors of atomic integers for filters on GPU and CPU (one per stage, see setNumStages)
     std::vector<std::atomic<int>> numFiltersGPU; // Atomic integers for GPU filters
     std::vector<std::atomic<int>> numFiltersCPU; // Atomic integers for CPU filters
 
     // Variables relacionadas con el tiempo
-    std::vector<double> time_GPU_S{{0.0, 0.0, 0.0}};
-    std::vector<double> time_CPU_S{{0.0, 0.0, 0.0}};
+    std::vector<double> time_GPU_S;
+    std::vector<double> time_CPU_S;
+    double activeFraction{1.0}; // Mean fraction of the frames processed with regions of interest (--roi)
     float totalTime{0.0f};
     float sampleTime{0.0f};
     float systemTime{0.0f};
@@ -63,6 +72,21 @@ class ApplicationData {
     std::random_device seed;
     std::mt19937 mte{seed()};
 
+    // Ingest statistics of the multi-frame input (--input)
+    FrameSourceStats ingestStats;
+
+    // Real-time statistics of the synthetic camera (--camera)
+    CameraStats cameraStats;
+
+    // Backpressure statistics of the output of the detections (--sink)
+    ResultSinkStats sinkStats;
+
+    // Statistics of the temporal reuse (--reuse)
+    TemporalReuseStats reuseStats;
+
+    // Reorder depth and head-of-line blocking of the output (--reorder)
+    ReorderStats reorderStats;
+
     // ViVidItem for debugging
     ViVidItem *item_debug = nullptr;
 
@@ -77,14 +101,12 @@ class ApplicationData {
     float avgPower_W{0.0f};
     float totalKilowattHours{0.0f};
 
-    // Constructor to initialize the atomic vectors
-    ApplicationData()
-        : numFiltersGPU(NUM_STAGES), numFiltersCPU(NUM_STAGES) {
-        for (int i = 0; i < NUM_STAGES; ++i) {
-            numFiltersGPU[i] = 0;
-            numFiltersCPU[i] = 0;
-        }
-    }
+    /**
+     * @brief Size the per-stage counters and times to the stages of the pipeline (--stages), all of them to 0.
+     */
+    void setNumStages(size_t numStages);
+
+    size_t numStages() const { return time_CPU_S.size(); }
 
     void selectUSMQueue(sycl::queue &Q);
 
@@ -6,7 +6,21 @@
 #define DEFAULT_IMAGE_RESOLUTION 1     //< Default image resolution (1: 1080p, 2: 1440p, 3: 2160p, 4: 2880p, 5: 4320p)
 #define DEFAULT_NUM_THREADS 8          //< Default number of threads
 #define DEFAULT_CONFIG_STAGES "000"    //< Default configuration of the stages
+#define DEFAULT_STAGES "cosine,histogram,pwdist" //< Default stages of the pipeline (--stages)
+#define MAX_STAGES 16                  //< Maximum number of stages of a pipeline (--stages)
 #define DEFAULT_SIZE_CIRCULAR_BUFFER 4 //< Default size of the circular buffer
+#define DEFAULT_PREFETCH_FRAMES 4      //< Default number of input frames read ahead by the I/O thread (--input)
+#define DEFAULT_IO_DEPTH 4             //< Default number of input frames being read at the same time by the I/O thread (--input)
+#define DEFAULT_DEADLINE_PERIODS 2     //< Default deadline of the frames of the synthetic camera, in frame periods (--camera)
+#define DEFAULT_SINK_DEPTH 8           //< Default number of frames that can wait for the writer thread of the result sink (--sink)
+#define DEFAULT_SINK_TOPK 16           //< Default number of detections written per frame by the result sink (--sink)
+#define DEFAULT_REUSE_REFRESH 30       //< Default number of frames between two keyframes of the temporal reuse (--reuse)
+#define DEFAULT_QUEUES_PER_DEVICE 1    //< Default number of SYCL queues of each device, the frames in flight are spread over them (--queues)
+#define MAX_GPU_BATCH 8                //< Maximum number of frames launched together by a batched GPU stage (--gpu-batch)
+#define DEFAULT_GPU_BATCH_TIMEOUT 200  //< Default time a batch of the GPU stages waits for more frames, in microseconds (--gpu-batch-timeout)
+#define GPU_BATCH_PIXELS (1920 * 1080) //< Pixels per launch targeted by --gpu-batch auto (the batch grows as the frames shrink)
+#define DEFAULT_REORDER_TIMEOUT 50     //< Default time the oldest frame held by the reorder buffer waits before the gap is skipped, in ms (--reorder-gap skip)
+#define USM_ALIGNMENT 4096             //< Alignment of the USM buffers (page size, needed by the O_DIRECT reads of --input)
 #define DEFAULT_CORES_GPU 1            //< Default number of cores to use in the GPU
 #define DEFAULT_SIZE_GPU 3             //< Default size of the GPU
 
@@ -29,7 +43,8 @@ enum class PipelineType {
     FlowGraphFunctionalNode = 2,
     FlowGraphAsyncNode = 3,
     SYCLEvents = 4,
-    Taskflow = 5
+    Taskflow = 5,
+    Coroutine = 6
 };
 
 enum class PathSelection {
@@ -128,6 +143,12 @@ enum class StageState {
 #define ENERGYPCM_ENABLED 0
 #endif
 
+#ifdef __ALLOCCOUNT__
+#define ALLOCCOUNT_ENABLED 1
+#else
+#define ALLOCCOUNT_ENABLED 0
+#endif
+
 #ifdef __NOQUEUE__
 #define DEVICE_QUEUE_ENABLED 0
 #else
@@ -158,12 +179,11 @@ enum class StageState {
 #define __NODEPRIORITY__ 0
 #endif
 
+// Built for the workload simulator (make NUMSTAGES=N): without --stages the pipeline has N simulated stages
 #ifndef __NUMSTAGES__
-#define USE_VIVID_APP 1
-#define NUM_STAGES 3
+#define DEFAULT_SIM_STAGES 0
 #else
-#define USE_VIVID_APP 0
-#define NUM_STAGES __NUMSTAGES__
+#define DEFAULT_SIM_STAGES __NUMSTAGES__
 #endif
 
 #ifndef __PWDIST__
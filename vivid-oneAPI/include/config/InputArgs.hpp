@@ -3,33 +3,93 @@
 #define INPUT_ARGS_HPP
 
 #include "../CLI11.hpp"
+#include "AsyncReader.hpp"
+#include "FrameContainer.hpp"
 #include "GlobalParameters.hpp"
+#include "QueuePool.hpp"
+#include "ReorderBuffer.hpp"
 #include "ResourcesManager.hpp"
+#include "ResultSink.hpp"
 #include "WorkloadSimulator.hpp"
 #include <array>
 #include <chrono>
+#include <iostream>
 #include <memory>
 #include <string>
 #include <vector>
 
+struct StageKernels;
+
+/**
+ * @brief Classifier of a stage that compares the histograms with classes, given in --stages as name:dict=N:model=FILE.
+ * The stages without one use the global classes.
+ */
+struct StageClassifier {
+    int dictSize{0};   //< Bins of the histograms compared with the classes (0: those of the global classes)
+    std::string model; //< Raw float32 file with the coefficients of the classes, one row of dictSize per class (empty: random)
+
+    bool custom() const { return dictSize > 0 || !model.empty(); }
+};
+
 class InputArgs {
   public:
     // Basic arguments that must be entered (some of them have default values)
-    PipelineType pipelineName{PipelineType::ParallelPipeline};                                         //< Pipeline type (SeriePipeline, ParallelPipeline, FlowGraphFunctionalNode, FlowGraphAsyncNode, SYCLEvents) (Default: 1)
+    PipelineType pipelineName{PipelineType::ParallelPipeline};                                         //< Pipeline type (SeriePipeline, ParallelPipeline, FlowGraphFunctionalNode, FlowGraphAsyncNode, SYCLEvents, Taskflow, Coroutine) (Default: 1)
     int numFrames{DEFAULT_NUM_FRAMES};                                                                 //< Number of frames to process (Default: 1000)
     int imageResolution{DEFAULT_IMAGE_RESOLUTION};                                                     //< Image resolution 0: 1080p, 2: 1440p, 3: 2160p, 4: 2880p, 5: 4320p (Default: 1)
     int nThreads{DEFAULT_NUM_THREADS};                                                                 //< Number of threads to use (Default: 8)
     std::chrono::duration<double> duration{0};                                                         //< Duration in seconds (if user wants to use it)
     std::chrono::duration<double> timeSampling{0};                                                     //< Time sampling for model
-    std::vector<StageState> stageExecutionState{std::vector<StageState>(NUM_STAGES, StageState::CPU)}; //< 0: CPU, 1: GPU, 2: CPU and GPU
+    std::vector<std::string> stageNames;                                                               //< Names of the stages of the pipeline, in order (Default: cosine,histogram,pwdist)
+    std::vector<const StageKernels *> stages;                                                          //< Kernels of each stage, from the StageRegistry
+    std::vector<StageClassifier> stageClassifiers;                                                     //< Classifier of each stage (dict=, model= in --stages)
+    std::vector<std::vector<size_t>> stageLevels;                                                      //< Stages of each level: they all take the output of the previous level (fan-out) and the next level waits for all of them (join)
+    std::vector<size_t> stageLevel;                                                                    //< Level of each stage
+    std::vector<StageState> stageExecutionState;                                                       //< 0: CPU, 1: GPU, 2: CPU and GPU
     std::string configStagesStr{DEFAULT_CONFIG_STAGES};                                                //< Configuration of the stages (Default: 000)
 
     // Optional arguments that can be entered (some of them have default values)
     int inFlightFrames{0};                                                   //< Number of frames in flight (Default: -1)
-    size_t sizeCircularBuffer{0};                                            //< Size of the circular buffer
+    size_t sizeCircularBuffer{0};                                            //< Size of the item pool
+    size_t memBudget{0};                                                     //< Memory budget in bytes for the buffers (Default: 0, no limit)
+    int maxTokens{0};                                                        //< Maximum number of tokens that fit in the memory budget (Default: 0, no limit)
+    std::string inputPath;                                                   //< Multi-frame input: .bin file, directory of .bin files or raw video (Default: empty, use the example image)
+    int inputHeight{0};                                                      //< Height of the frames of a raw input
+    int inputWidth{0};                                                       //< Width of the frames of a raw input
+    FrameContainer::PixelType inputFormat{FrameContainer::PixelType::Float32}; //< Pixel type of a raw input (Default: float32)
+    int prefetchFrames{DEFAULT_PREFETCH_FRAMES};                             //< Number of input frames read ahead by the I/O thread (Default: 4)
+    IOBackend ioBackend{IOBackend::Auto};                                    //< Backend of the reads of the input (Default: auto, io_uring or pread threads)
+    int ioDepth{DEFAULT_IO_DEPTH};                                           //< Number of input frames being read at the same time (Default: 4)
+    bool directIO{false};                                                    //< Read the input with O_DIRECT (Default: false)
+    int tileHeight{0};                                                       //< Height of the tiles of the input frames (Default: 0, whole frames)
+    int tileWidth{0};                                                        //< Width of the tiles of the input frames (Default: 0, whole frames)
+    std::string roiPath;                                                     //< List of per-frame regions of interest (Default: empty, whole frames)
+    double reuseThreshold{-1.0};                                             //< Difference above which a tile is recomputed (Default: -1, no temporal reuse)
+    int reuseRefresh{DEFAULT_REUSE_REFRESH};                                 //< Frames between two keyframes of the temporal reuse (Default: 30)
+    bool reuseVerify{false};                                                 //< Compare the reused frames with their full recomputation (Default: false)
+    double cameraFps{0.0};                                                   //< Frame rate of the synthetic camera (Default: 0, no camera)
+    int cameraBurst{1};                                                      //< Frames released together by the camera (Default: 1)
+    double cameraJitter{0.0};                                                //< Jitter of the releases of the camera in ms (Default: 0)
+    double deadline{0.0};                                                    //< Deadline of each camera frame in ms (Default: 0, DEFAULT_DEADLINE_PERIODS periods)
+    std::string sinkPath;                                                    //< File where the detections are written (Default: empty, results discarded)
+    ResultSinkConfig::Format sinkFormat{ResultSinkConfig::Format::JsonLines}; //< Format of the detections (Default: JSON lines, binary for .bin files)
+    int sinkDepth{DEFAULT_SINK_DEPTH};                                       //< Frames that can wait for the writer thread (Default: 8)
+    int sinkTopK{DEFAULT_SINK_TOPK};                                         //< Detections written per frame (Default: 16)
+    bool sinkDrop{false};                                                    //< Drop frames when the sink falls behind instead of waiting (Default: false)
+    bool reorder{false};                                                     //< Deliver the frames to the sink in the order of their ids (Default: false, as they finish)
+    size_t reorderWindow{0};                                                 //< Frames the reorder buffer can hold (Default: 0, the item pool)
+    ReorderGap reorderGap{ReorderGap::Wait};                                 //< What the reorder buffer does with the late frames (Default: wait)
+    double reorderTimeout{DEFAULT_REORDER_TIMEOUT};                          //< Time a gap is waited for with --reorder-gap skip, in ms (Default: 50)
     bool useDependsOnSerial{false};                                          //< Use SYCL depends_on with SerialPipeline (Default: false)
-    std::vector<double> throughput_CPU{std::vector<double>(NUM_STAGES, -1)}; //< Throughput of the CPU in each stage (workload simulation)
-    std::vector<double> throughput_GPU{std::vector<double>(NUM_STAGES, -1)}; //< Throughput of the GPU in each stage (workload simulation)
+    bool gpuBlocking{false};                                                 //< The GPU stages of --api pipeline, fgan and coro wait on their worker (Default: false, the worker is released)
+    bool gpuGraph{false};                                                    //< The frames of --api syclevents that run whole on the GPU replay a recorded SYCL graph (Default: false)
+    int queuesPerDevice{DEFAULT_QUEUES_PER_DEVICE};                          //< SYCL queues of each device, the frames in flight are spread over them (Default: 1)
+    QueuePolicy queuePolicy{QueuePolicy::RoundRobin};                        //< Assignment of the frames to the queues of --queues (Default: rr)
+    bool queueInOrder{INORDER_QUEUE};                                        //< The queues added by --queues are in-order (Default: as the configured queues)
+    int gpuBatch{1};                                                         //< Frames launched together by the batched GPU stages (Default: 1, no batches; 0: auto, by resolution)
+    int gpuBatchTimeout{DEFAULT_GPU_BATCH_TIMEOUT};                          //< Time a batch of the GPU stages waits for more frames, in microseconds (Default: 200)
+    std::vector<double> throughput_CPU;                                      //< Throughput of the CPU in each stage (workload simulation)
+    std::vector<double> throughput_GPU;                                      //< Throughput of the GPU in each stage (workload simulation)
 
     // Internal variables that are used to control the behavior of the pipelines
     bool GPUactive{false};                               //< GPU active (Default: false)
@@ -37,7 +97,7 @@ class InputArgs {
 
     // Control and management of semaphores (cores and task queues)
     std::unique_ptr<ResourcesManager> resourcesManager;                               //< Resources manager
-    std::vector<Acc> executionDevicePriority{std::vector<Acc>(NUM_STAGES, Acc::CPU)}; //< Prefer GPU in each stage (false: CPU, true: GPU) (Default: false)
+    std::vector<Acc> executionDevicePriority;                                         //< Prefer GPU in each stage (false: CPU, true: GPU) (Default: false)
 
     bool preferGpu = true;
 
@@ -49,6 +109,14 @@ class InputArgs {
     const double convergenceThreshold{0.1}; //< Convergence umbral
 
     InputArgs(int argc, char *argv[]);
+
+    /**
+     * @brief Parse the arguments of an embedded pipeline (libvivid), without the program name.
+     *
+     * Unlike the command line constructor, an invalid argument throws std::invalid_argument instead of ending the
+     * process, and with quiet nothing is printed.
+     */
+    InputArgs(const std::vector<std::string> &args, bool quiet);
     const std::string getImageTypeToString() const;
     std::string getPrefDevice() const {
         std::string result;
@@ -57,13 +125,24 @@ class InputArgs {
         }
         return result;
     }
+    size_t numStages() const { return stages.size(); }
+    bool isBranch(size_t stage) const { return stageLevels[stageLevel[stage]].size() > 1; }
+    bool hasOwnOutput(size_t stage) const { return stageLevels[stageLevel[stage]].front() != stage; } // The first stage of a level writes the output of the item
+    bool hasBranches() const { return stageLevels.size() < numStages(); }
+    bool asyncGPUStages() const { return (pipelineName == PipelineType::ParallelPipeline || pipelineName == PipelineType::FlowGraphAsyncNode || pipelineName == PipelineType::Coroutine) && GPUactive && !gpuBlocking; } // See GPUCompletion.hpp
+    std::string stagesString() const;
     bool hasDuration() const { return duration.count() > 0; }
     bool hasTimeSampling() const { return timeSampling.count() > 0; }
     void printArguments() const;
 
   private:
+    bool embedded{false};                 //< Created by libvivid: report parse errors with exceptions
+    std::ostream console{std::cout.rdbuf()}; //< Output of the summary of the arguments (no buffer when quiet)
+
     void parseArguments(int argc, char *argv[]);
+    void parseStages(const std::string &stagesStr, const std::string &stagesFile);
     void setResources(const std::vector<int> &size, const std::vector<int> &cores, Acc acc);
+    int defaultCoresGPU() const;
     void setExecutionDevicePriority(const std::vector<int> &exeDevPriority, std::vector<Acc> &executionDevicePriority);
     void setThroughput(const std::vector<double> &th, std::vector<double> &throughput);
     bool parseConfigStages();
@@ -0,0 +1,113 @@
+/**
+ * @file StageRegistry.hpp
+ * @brief Registry of the kernels that can be used as stages of the pipeline.
+ *
+ * Each stage is registered by name with its kernel for each device. The pipeline is declared at run time as an ordered
+ * list of names (--stages or --stages-file), so changing the number or the kernels of the stages does not need a
+ * rebuild. The builtin stages are the ViVid kernels (cosine, histogram, pwdist and the variants of pwdist that
+ * __PWDIST__ selects at build time) and the workload simulator (sim, with the throughputs of --thcpu and --thgpu).
+ *
+ * The kernels find the position of the stage they run in item->stage (set by runStage), which indexes the counters of
+ * ApplicationData and the per-stage times of the item.
+ *
+ * The stages separated by | in --stages are branches of the pipeline: they all take the output of the previous stage
+ * and the next one waits for all of them. The classifier stages (pwdist) accept name:dict=N:model=FILE to compare the
+ * histograms with their own classes, and every branch but the first writes its own output (ViVidItem::outOf).
+ *
+ * The ViVid kernels also have a batched GPU kernel, which --gpu-batch uses to launch several frames at once (see
+ * StageBatcher); the stages without one launch a kernel per frame.
+ */
+#pragma once
+#ifndef STAGE_REGISTRY_HPP
+#define STAGE_REGISTRY_HPP
+
+#include "GlobalParameters.hpp"
+#include "SYCLUtils.hpp"
+#include "StageBatcher.hpp"
+#include "pipeline_template.hpp"
+#include <cstddef>
+#include <functional>
+#include <map>
+#include <string>
+#include <sycl/sycl.hpp>
+#include <vector>
+
+class ApplicationData;
+class InputArgs;
+class Tracer;
+
+using namespace Pipeline_template;
+
+/**
+ * @brief Kernel of a stage on one device.
+ */
+using StageKernel = std::function<SyclEventInfo(ViVidItem *, Tracer &, ApplicationData &, InputArgs &, sycl::queue &, std::vector<sycl::event> *)>;
+
+/**
+ * @brief Kernels of a registered stage.
+ */
+struct StageKernels {
+    std::string name;     ///< Name of the stage in --stages.
+    StageKernel cpu;      ///< Kernel on the CPU.
+    StageKernel gpu;      ///< Kernel on the GPU.
+    bool enqueues = true;     ///< The kernels submit their work to the queue and return its event (false: they run on the calling thread).
+    bool classifier = false;  ///< The kernels compare the histograms with the classes of the stage (they accept dict= and model=).
+    StageBatchKernel gpuBatch; ///< Kernel of several frames in one launch on the GPU (--gpu-batch, empty: one frame per launch).
+
+    SyclEventInfo operator()(Acc acc, ViVidItem *item, Tracer &tracer, ApplicationData &appData, InputArgs &inputArgs, sycl::queue &Q, std::vector<sycl::event> *depends_on = nullptr) const {
+        return acc == Acc::GPU ? gpu(item, tracer, appData, inputArgs, Q, depends_on) : cpu(item, tracer, appData, inputArgs, Q, depends_on);
+    }
+};
+
+class StageRegistry {
+  public:
+    /**
+     * @brief Get the registry (the builtin stages are registered the first time).
+     */
+    static StageRegistry &instance();
+
+    /**
+     * @brief Register a stage. Must be called before the arguments are parsed (the registry is not synchronized).
+     * @param name Name of the stage in --stages.
+     * @param cpu Kernel on the CPU.
+     * @param gpu Kernel on the GPU.
+     * @param enqueues The kernels submit their work to the queue and return its event.
+     * @param classifier The kernels compare the histograms with the classes of the stage (ViVidItem::claOf).
+     * @throws std::invalid_argument If the name is empty, has a separator of --stages (, | :) or is already registered.
+     */
+    void add(const std::string &name, StageKernel cpu, StageKernel gpu, bool enqueues = true, bool classifier = false);
+
+    /**
+     * @brief Give a registered stage a kernel that runs several frames in one launch on the GPU (--gpu-batch).
+     * @throws std::invalid_argument If no stage has that name or the kernel is empty.
+     */
+    void setBatchKernel(const std::string &name, StageBatchKernel gpuBatch);
+
+    /**
+     * @brief Get the kernels of a stage (the reference is valid for the lifetime of the process).
+     * @throws std::invalid_argument If no stage has that name.
+     */
+    const StageKernels &get(const std::string &name) const;
+
+    /**
+     * @brief Get the names of the registered stages, sorted.
+     */
+    std::vector<std::string> names() const;
+
+  private:
+    std::map<std::string, StageKernels> stages; //< Node based: the kernels never move once registered
+
+    StageRegistry();
+};
+
+/**
+ * @brief Run a stage of the pipeline of inputArgs on an item. The host side of the branches of an item runs one at a time.
+ * @param stage Position of the stage in the pipeline.
+ * @param acc Device that runs the stage.
+ * @param batcher Batches of the GPU stages (--gpu-batch), or nullptr to launch each frame on its own.
+ * @param depends_on Optional events the kernel must wait for.
+ */
+SyclEventInfo runStage(std::size_t stage, Acc acc, ViVidItem *item, Tracer &tracer, ApplicationData &appData, InputArgs &inputArgs, StageBatcher *batcher, sycl::queue &Q,
+                       std::vector<sycl::event> *depends_on = nullptr);
+
+#endif // STAGE_REGISTRY_HPP
@@ -5,15 +5,23 @@
 #include <sycl/sycl.hpp>
 #include <tbb/tick_count.h>
 
+// Reads the profiling information of the event, so it waits for the command to complete
+inline void record_sycl_time(ViVidItem *item, const sycl::event &m_event, int stage, const std::string &accStr) {
+    if constexpr (TRACE_ENABLED || TIMESTAGES_ENABLED || AUTOMODE_ENABLED || ADVANCEDMETRICS_ENABLED) {
+        item->execution_time = (m_event.get_profiling_info<sycl::info::event_profiling::command_end>() - m_event.get_profiling_info<sycl::info::event_profiling::command_start>());
+        if (accStr == "CPU_S") {
+            item->timeCPU_S[stage] = item->execution_time * 1e-6;
+        } else if (accStr == "GPU_S") {
+            item->timeGPU_S[stage] = item->execution_time * 1e-6;
+        }
+    }
+}
+
+// The SYCL events pipeline and the GPU stages handed to GPUCompletion record the time once the event completes
 inline void save_time_info_on_sycl(ViVidItem *item, InputArgs &inputArgs, sycl::event &m_event, int stage, const std::string &accStr) {
     if constexpr (TRACE_ENABLED || TIMESTAGES_ENABLED || AUTOMODE_ENABLED || ADVANCEDMETRICS_ENABLED) {
-        if (inputArgs.pipelineName != PipelineType::SYCLEvents) {
-            item->execution_time = (m_event.get_profiling_info<sycl::info::event_profiling::command_end>() - m_event.get_profiling_info<sycl::info::event_profiling::command_start>());
-            if (accStr == "CPU_S") {
-                item->timeCPU_S[stage] = item->execution_time * 1e-6;
-            } else if (accStr == "GPU_S") {
-                item->timeGPU_S[stage] = item->execution_time * 1e-6;
-            }
+        if (inputArgs.pipelineName != PipelineType::SYCLEvents && !(accStr == "GPU_S" && inputArgs.asyncGPUStages())) {
+            record_sycl_time(item, m_event, stage, accStr);
         }
     }
 }
@@ -66,11 +74,11 @@ inline void save_time_info_normal(ViVidItem *item, int stage, const std::string
     }
 }
 
-inline void get_ptrs_cosine(ViVidItem *item, float *&ptr_frame, float *&ptr_ind, float *&ptr_val, int &f_pitch_f) {
-    ptr_frame = item->frame->get_HOST_PTR(BUF_READ);
+// The frame pointer is obtained with item->frame->visitPixels (its type depends on the input), f_pitch_f is in pixels
+inline void get_ptrs_cosine(ViVidItem *item, float *&ptr_ind, float *&ptr_val, int &f_pitch_f) {
     ptr_ind = item->ind->get_HOST_PTR(BUF_WRITE);
     ptr_val = item->val->get_HOST_PTR(BUF_WRITE);
-    f_pitch_f = item->frame->pitch / sizeof(float);
+    f_pitch_f = item->frame->pixelPitch();
 }
 
 inline void get_ptrs_histogram(ViVidItem *item, ApplicationData &appData, float *&ptr_his, float *&ptr_val, float *&ptr_ind, int &histogram_pitch_f, int &assignments_pitch_f, int &weights_pitch_f) {
@@ -82,13 +90,40 @@ inline void get_ptrs_histogram(ViVidItem *item, ApplicationData &appData, float
     weights_pitch_f = item->val->pitch / sizeof(float);
 }
 
+// With regions of interest (--roi) only the span of active cells is compared with the classes. Each stage uses its own
+// classes and output, if it has them (branches of --stages)
 inline void get_ptrs_pwdist(ViVidItem *item, float *&ptra, float *&ptrb, float *&out, int &owidth, int &aheight, int &awidth, int &bheight, int &adatawidth) {
-    ptra = item->cla->get_HOST_PTR(BUF_READ);
+    FloatBuffer *cla = item->claOf(item->stage);
+    FloatBuffer *outBuffer = item->outOf(item->stage);
+    ptra = cla->get_HOST_PTR(BUF_READ);
     ptrb = item->his->get_HOST_PTR(BUF_READ);
-    out = item->out->get_HOST_PTR(BUF_WRITE);
-    owidth = item->out->pitch / sizeof(float);
-    aheight = item->cla->height;
-    awidth = item->cla->pitch / sizeof(float);
+    out = outBuffer->get_HOST_PTR(BUF_WRITE);
+    owidth = outBuffer->pitch / sizeof(float);
+    aheight = cla->height;
+    awidth = cla->pitch / sizeof(float);
     bheight = item->his->height;
-    adatawidth = item->cla->width;
+    adatawidth = cla->width;
+    if (item->region != nullptr) {
+        ptrb += item->region->firstCell * (item->his->pitch / sizeof(float));
+        out += item->region->firstCell;
+        bheight = static_cast<int>(item->region->endCell - item->region->firstCell);
+    }
+}
+
+// Pixels whose filter response is computed: the interior of the frame, or the active part with --roi
+inline Rect get_active_pixels(ViVidItem *item, ApplicationData &appData) {
+    if (item->region != nullptr) {
+        return item->region->pixels;
+    }
+    int apron = appData.filterDim / 2;
+    return {apron, apron, appData.width - 2 * apron, appData.height - 2 * apron};
+}
+
+// Cells whose histogram is computed: all of them, or the active ones with --roi
+inline Rect get_active_cells(ViVidItem *item, ApplicationData &appData) {
+    if (item->region != nullptr) {
+        return item->region->cells;
+    }
+    int apron = appData.filterDim / 2;
+    return {0, 0, (appData.width - 2 * apron) / appData.cellSize, (appData.height - 2 * apron) / appData.cellSize};
 }
@@ -79,11 +79,31 @@ SyclEventInfo blockhistogram(ViVidItem *item, Tracer &my_tracer, ApplicationData
  */
 template <Acc D>
 SyclEventInfo pwdist(ViVidItem *item, Tracer &my_tracer, ApplicationData &appData, InputArgs &inputArgs, sycl::queue &Q, std::vector<sycl::event> *depends_on = nullptr);
+
+/**
+ * @brief Executes a given variant of the pair-wise distance (pwdist), whatever __PWDIST__ selects for Details::pwdist.
+ *
+ * @tparam D Accelerator type (Acc::CPU or Acc::GPU)
+ * @tparam tile_size Size of the tiles of the kernel (0 for the basic version).
+ * @tparam T Type of the elements of the tiled kernel (float, sycl::float4) or basic.
+ */
+template <Acc D, size_t tile_size, typename T>
+SyclEventInfo pwdist_variant(ViVidItem *item, Tracer &my_tracer, ApplicationData &appData, InputArgs &inputArgs, sycl::queue &Q, std::vector<sycl::event> *depends_on = nullptr);
+
+/**
+ * @brief Executes the pair-wise distance of several frames with a single launch on the GPU (--gpu-batch), with the
+ * variant that __PWDIST__ selects for Details::pwdist.
+ *
+ * @param[in] items Items of the batch (at most MAX_GPU_BATCH).
+ * @param[in] count Number of items.
+ * @param[in] appData ApplicationData object containing application-specific data.
+ * @param[in] Q The SYCL queue to enqueue the filter.
+ * @param[in] depends_on Optional vector of SYCL events to synchronize with before executing this operation.
+ * @return The SYCL event of the launch, shared by the items.
+ */
+sycl::event pwdist_batch(ViVidItem *const *items, std::size_t count, ApplicationData &appData, sycl::queue &Q, const std::vector<sycl::event> *depends_on);
 } // namespace Details
 
-SyclEventInfo cosinefilter(Acc acc, ViVidItem *item, Tracer &my_tracer, ApplicationData &appData, InputArgs &inputArgs, sycl::queue &Q, std::vector<sycl::event> *depends_on = nullptr);
-SyclEventInfo blockhistogram(Acc acc, ViVidItem *item, Tracer &my_tracer, ApplicationData &appData, InputArgs &inputArgs, sycl::queue &Q, std::vector<sycl::event> *depends_on = nullptr);
-SyclEventInfo pwdist(Acc acc, ViVidItem *item, Tracer &my_tracer, ApplicationData &appData, InputArgs &inputArgs, sycl::queue &Q, std::vector<sycl::event> *depends_on = nullptr);
 SyclEventInfo workloadsimulator(Acc acc, ViVidItem *item, Tracer &my_tracer, ApplicationData &appData, InputArgs &inputArgs, int stage);
 
 #endif
\ No newline at end of file
@@ -71,4 +71,35 @@ SyclEventInfo blockhistogram_GPU(ViVidItem *item, Tracer &my_tracer, Application
 template <size_t tile_size, typename T>
 SyclEventInfo pwdist_GPU(ViVidItem *item, Tracer &my_tracer, ApplicationData &appData, InputArgs &inputArgs, sycl::queue &Q, std::vector<sycl::event> *depends_on = nullptr);
 
+// *********************************************************************************************************************
+// BATCHES: several frames per launch (--gpu-batch, see StageBatcher)
+// *********************************************************************************************************************
+/**
+ * @brief Computes the cosine filter of several frames with a single launch on the GPU.
+ *
+ * @param[in] items Items of the batch (at most MAX_GPU_BATCH), whose frames have the same pixel type.
+ * @param[in] count Number of items.
+ * @param[in] appData The ApplicationData object containing filter bank and other important parameters.
+ * @param[in] Q The SYCL queue to enqueue the filter.
+ * @param[in] depends_on Optional vector of SYCL events to synchronize with before executing this operation.
+ * @return The SYCL event of the launch, shared by the items.
+ */
+sycl::event cosinefilter_GPU_batch(ViVidItem *const *items, std::size_t count, ApplicationData &appData, sycl::queue &Q, const std::vector<sycl::event> *depends_on);
+
+/**
+ * @brief Computes the block histogram of several frames with a single launch on the GPU.
+ * @see cosinefilter_GPU_batch
+ */
+sycl::event blockhistogram_GPU_batch(ViVidItem *const *items, std::size_t count, ApplicationData &appData, sycl::queue &Q, const std::vector<sycl::event> *depends_on);
+
+/**
+ * @brief Executes the pairwise distance of several frames with a single launch on the GPU, with the classes and the
+ * output of the stage of each item.
+ * @tparam tile_size The tile size used for the optimized SYCL kernel (16, or 0 for the basic version).
+ * @tparam T The data type of the input data (float, sycl::float4 or basic).
+ * @see cosinefilter_GPU_batch
+ */
+template <size_t tile_size, typename T>
+sycl::event pwdist_GPU_batch(ViVidItem *const *items, std::size_t count, ApplicationData &appData, sycl::queue &Q, const std::vector<sycl::event> *depends_on);
+
 #endif
\ No newline at end of file
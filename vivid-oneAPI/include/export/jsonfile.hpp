@@ -2,6 +2,7 @@
 #ifndef JSONFILE_HPP
 #define JSONFILE_HPP
 
+#include "AllocCounter.hpp"
 #include "ApplicationData.hpp"
 #include "GlobalParameters.hpp"
 #include "InputArgs.hpp"
@@ -2,18 +2,24 @@
 #ifndef FILTERS_AVX_H
 #define FILTERS_AVX_H
 
+#include "RoiList.hpp"
 #include <immintrin.h>
 #include <cmath>
+#include <cstdint>
 
 // *********************************************************************************************************************
 // FILTER 1:
 // *********************************************************************************************************************
-void cosine_filter_AVX(float* fr_data, float* ind, float *val, float* fb_array, const int height, const int width, const int filter_h, const int filter_w, const int n_filters, int pitch);
+// Pixel: float, uint8_t or uint16_t (the pixels are widened to float in the registers)
+// region: pixels whose response is computed (the interior of the frame, or the active part with --roi)
+template <typename Pixel>
+void cosine_filter_AVX(const Pixel* fr_data, float* ind, float *val, float* fb_array, const int height, const int width, const int filter_h, const int filter_w, const int n_filters, int pitch, const Rect &region);
 
 // *********************************************************************************************************************
 // FILTER 2:
 // *********************************************************************************************************************
-void block_histogram_AVX(float *ptr_his, float *id_data, float *wt_data, int max_bin, int cell_size, int im_height, int im_width, float pitch_his, float pitch_ind);
+// cells: cells whose histogram is computed (all of them, or the active ones with --roi)
+void block_histogram_AVX(float *ptr_his, float *id_data, float *wt_data, int max_bin, int cell_size, int im_height, int im_width, float pitch_his, float pitch_ind, const Rect &cells);
 
 // *********************************************************************************************************************
 // FILTER 3:
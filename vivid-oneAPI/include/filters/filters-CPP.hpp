@@ -7,6 +7,7 @@
 #include <fstream>
 #include <cstdlib>
 #include <cassert>
+#include <cstdint>
 #include <sycl/sycl.hpp>
 #include <algorithm>
 #include <cmath>
@@ -22,10 +23,14 @@ using namespace Pipeline_template;
 float * transposeBank(float* filter_bank);
 
 // Optimized Filter 1 that works with a transposed bank of filters
-void cosine_filter_transpose(float* fr_data, float* ind, float *val, float* fb_array_main, const int height, const int width, const int filter_h, const int filter_w, const int n_filters, int pitch);
+// Pixel: float, uint8_t or uint16_t (the pixels are converted to float when they are read)
+// region: pixels whose response is computed (the interior of the frame, or the active part with --roi)
+template <typename Pixel>
+void cosine_filter_transpose(const Pixel* fr_data, float* ind, float *val, float* fb_array_main, const int height, const int width, const int filter_h, const int filter_w, const int n_filters, int pitch, const Rect &region);
 
 // SECOND FILTER:
-void block_histogram(float *ptr_his, float *ptr_ind, float *ptr_val, int max_bin, int cell_size, int im_height, int im_width, float pitch_his, float pitch_ind);
+// cells: cells whose histogram is computed (all of them, or the active ones with --roi)
+void block_histogram(float *ptr_his, float *ptr_ind, float *ptr_val, int max_bin, int cell_size, int im_height, int im_width, float pitch_his, float pitch_ind, const Rect &cells);
 
 // THIRD FILTER:
 void pwdist_c(float *ptra, float *ptrb, float *out_data, int owidth, int aheight, int awidth, int bheight, int adatawidth);
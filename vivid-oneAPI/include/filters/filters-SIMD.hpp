@@ -2,8 +2,10 @@
 #ifndef FILTERS_SIMD_H
 #define FILTERS_SIMD_H
 
+#include "RoiList.hpp"
 #include <algorithm>
 #include <cstddef>
+#include <cstdint>
 #include <experimental/simd>
 #include <iostream>
 #include <vector>
@@ -21,11 +23,15 @@ using mask_t = stdx::native_simd_mask<float>;
 // *********************************************************************************************************************
 // FILTER 1:
 // *********************************************************************************************************************
-void cosine_filter_SIMD(float *fr_data, float *ind, float *val, float *fb_array_main, const int height, const int width, const int filter_h, const int filter_w, const int n_filters, int pitch);
+// Pixel: float, uint8_t or uint16_t (converting loads widen the pixels to float in the registers)
+// region: pixels whose response is computed (the interior of the frame, or the active part with --roi)
+template <typename Pixel>
+void cosine_filter_SIMD(const Pixel *fr_data, float *ind, float *val, float *fb_array_main, const int height, const int width, const int filter_h, const int filter_w, const int n_filters, int pitch, const Rect &region);
 // *********************************************************************************************************************
 // FILTER 2:
 // *********************************************************************************************************************
-void block_histogram_SIMD(float *ptr_his, float *id_data, float *wt_data, int max_bin, int cell_size, int im_height, int im_width, float pitch_his, float pitch_ind);
+// cells: cells whose histogram is computed (all of them, or the active ones with --roi)
+void block_histogram_SIMD(float *ptr_his, float *id_data, float *wt_data, int max_bin, int cell_size, int im_height, int im_width, float pitch_his, float pitch_ind, const Rect &cells);
 // *********************************************************************************************************************
 // FILTER 3:
 // *********************************************************************************************************************
@@ -5,6 +5,7 @@
 #include "SYCLUtils.hpp"
 #include "pipeline_template.hpp"
 #include <cmath>
+#include <cstdint>
 #include <vector>
 
 using namespace Pipeline_template;
@@ -12,12 +13,16 @@ using namespace Pipeline_template;
 // *********************************************************************************************************************
 // FILTER 1:
 // *********************************************************************************************************************
-sycl::event cosine_filter_transpose_sycl(float *frame, float *ind, float *val, float *fb_array_main, const int height, const int width, const int filter_size, const int n_filters, const int f_pitch_f, sycl::queue &Q, const std::vector<sycl::event> *depends_on = nullptr);
+// Pixel: float, uint8_t or uint16_t (the pixels are converted to float when they are loaded); f_pitch_f is the pitch in pixels
+// region: pixels whose response is computed (the interior of the frame, or the active part with --roi)
+template <typename Pixel>
+sycl::event cosine_filter_transpose_sycl(const Pixel *frame, float *ind, float *val, float *fb_array_main, const int height, const int width, const int filter_size, const int n_filters, const int f_pitch_f, const Rect &region, sycl::queue &Q, const std::vector<sycl::event> *depends_on = nullptr);
 
 // *********************************************************************************************************************
 // FILTER 2:
 // *********************************************************************************************************************
-sycl::event block_histogram_sycl(float *ptr_his, float *ptr_ind, float *ptr_val, int cell_size, int im_height, int im_width, float pitch_his, float pitch_ind, float pitch_val, sycl::queue &Q, const std::vector<sycl::event> *depends_on = nullptr);
+// cells: cells whose histogram is computed (all of them, or the active ones with --roi)
+sycl::event block_histogram_sycl(float *ptr_his, float *ptr_ind, float *ptr_val, int cell_size, int im_height, int im_width, float pitch_his, float pitch_ind, float pitch_val, const Rect &cells, sycl::queue &Q, const std::vector<sycl::event> *depends_on = nullptr);
 
 // *********************************************************************************************************************
 // FILTER 3:
@@ -33,4 +38,53 @@ sycl::event pwdist_sycl_tiled(float *ptra, float *ptrb, float *out_data, int owi
 template <size_t tile_size>
 sycl::event pwdist_sycl_tiled_float4(float *ptra, float *ptrb, float *out_data, int owidth, int aheight, int awidth, int bheight, int adatawidth, sycl::queue &Q, const std::vector<sycl::event> *depends_on = nullptr);
 
+// *********************************************************************************************************************
+// BATCHES: several frames per launch (--gpu-batch)
+// *********************************************************************************************************************
+// The kernels of a batch take the buffers and the active part of each frame (at most MAX_GPU_BATCH) and run them in a
+// single launch, with the frame as the first dimension of the range; the rest of the arguments are those of the
+// kernels of one frame. The frames may have different regions (--roi, --reuse): the range covers the largest one.
+template <typename Pixel>
+struct CosineBatchFrame {
+    const Pixel *frame;
+    float *ind;
+    float *val;
+    int f_pitch_f;
+    Rect region;
+};
+
+template <typename Pixel>
+sycl::event cosine_filter_transpose_sycl_batch(const CosineBatchFrame<Pixel> *frames, int count, float *fb_array_main, const int height, const int width, const int filter_size, const int n_filters, sycl::queue &Q, const std::vector<sycl::event> *depends_on = nullptr);
+
+struct HistogramBatchFrame {
+    float *ptr_his;
+    float *ptr_ind;
+    float *ptr_val;
+    int histogram_pitch_f;
+    int assignments_pitch_f;
+    int weights_pitch_f;
+    Rect cells;
+};
+
+sycl::event block_histogram_sycl_batch(const HistogramBatchFrame *frames, int count, int cell_size, sycl::queue &Q, const std::vector<sycl::event> *depends_on = nullptr);
+
+struct PwdistBatchFrame {
+    float *ptra;
+    float *ptrb;
+    float *out_data;
+    int owidth;
+    int aheight;
+    int awidth;
+    int bheight;
+    int adatawidth;
+};
+
+sycl::event pwdist_sycl_basic_batch(const PwdistBatchFrame *frames, int count, sycl::queue &Q, const std::vector<sycl::event> *depends_on = nullptr);
+
+template <size_t tile_size>
+sycl::event pwdist_sycl_tiled_batch(const PwdistBatchFrame *frames, int count, sycl::queue &Q, const std::vector<sycl::event> *depends_on = nullptr);
+
+template <size_t tile_size>
+sycl::event pwdist_sycl_tiled_float4_batch(const PwdistBatchFrame *frames, int count, sycl::queue &Q, const std::vector<sycl::event> *depends_on = nullptr);
+
 #endif
\ No newline at end of file
@@ -0,0 +1,65 @@
+#pragma once
+#include "ApplicationData.hpp"
+#include "Coroutines.hpp"
+#include "GPUCompletion.hpp"
+#include "InputArgs.hpp"
+#include "PipelineInterface.hpp"
+#include "StageRegistry.hpp"
+#include "Tracer.hpp"
+#include <atomic>
+#include <cstdint>
+#include <exception>
+#include <memory>
+#include <mutex>
+#include <sycl/sycl.hpp>
+#include <vector>
+
+/**
+ * @brief Pipeline whose frames in flight are C++20 coroutines (--api coro).
+ *
+ * Each token (--iff) is a coroutine that takes frames until the input ends. For each stage it co_awaits the admission
+ * of the ResourcesManager and, for the GPU stages, the completion of the kernel (GPUCompletion). A token that does not
+ * get a core is suspended until a stage releases one, and the branches of a level run as coroutines of their own that
+ * the token joins. The tokens run on a small executor (--threads, plus one for the GPU if its stages block), so the
+ * number of frames in flight does not cost OS threads. The input node runs on a thread of its own, one token at a
+ * time: a token that waits there for a free item, a frame or the camera is suspended, not blocking the executor.
+ */
+class CoroutinePipeline : public PipelineInterface {
+  public:
+    void executePipeline(ApplicationData &appData, InputArgs &inputArgs, ItemPool &bufferItems, Tracer &traceFile, sycl::queue &Q_GPU, sycl::queue &Q_CPU, EnergyPCM *energyPCM) override;
+
+  private:
+    struct Run;
+    struct Join;
+
+    /**
+     * @brief Token: processes frames until the input ends or a token fails.
+     */
+    DetachedCoroutine runToken(Run &run);
+
+    /**
+     * @brief Run the stages of a level of the pipeline on the item, the branches at the same time.
+     */
+    CoroTask runLevel(Run &run, const std::vector<size_t> &level, ViVidItem *item);
+
+    /**
+     * @brief Branch of a level run by its own coroutine; it resumes the token once every branch has ended.
+     */
+    DetachedCoroutine runBranch(Run &run, size_t stage, ViVidItem *item, Join &join);
+
+    /**
+     * @brief Acquire the resources of a stage, run it and release them.
+     */
+    CoroTask runStageAsync(Run &run, size_t stage, ViVidItem *item);
+
+    /**
+     * @brief Suspend until a device of the ResourcesManager admits the stage.
+     * @param index Stage, or -1 for the device of the frame in Decoupled mode.
+     */
+    CoroTask admit(Run &run, int index, ViVidItem *item, Acc &acc);
+
+    /**
+     * @brief Release the resources of a stage and resume the tokens waiting for an admission.
+     */
+    void release(Run &run, Acc acc, int index);
+};
@@ -1,10 +1,14 @@
 // FlowGraphPipeline.hpp
 #pragma once
 #include "Comparer.hpp"
+#include "GPUCompletion.hpp"
 #include "PipelineInterface.hpp"
+#include "StageRegistry.hpp"
 #include "Timer.hpp"
 #include "execute_code.hpp"
+#include <atomic>
 #include <functional>
+#include <memory>
 #include <oneapi/tbb.h>
 #include <unordered_map>
 
@@ -18,54 +22,62 @@ using join_t = tbb::flow::join_node<std::tuple<ViVidItem *, token_t>, tbb::flow:
 using indexer_t = tbb::flow::indexer_node<ViVidItem *, ViVidItem *>;
 using mfn_two_inputs_t = tbb::flow::multifunction_node<std::tuple<ViVidItem *, token_t>, std::tuple<ViVidItem *, ViVidItem *>>;
 using mfn_one_input_t = tbb::flow::multifunction_node<indexer_t::output_type, std::tuple<ViVidItem *, ViVidItem *>>;
+using mfn_join_t = tbb::flow::multifunction_node<indexer_t::output_type, std::tuple<ViVidItem *>>;
 using CPUNode_t = tbb::flow::function_node<ViVidItem *, ViVidItem *>;
 
 // Define some elements used on the Async Node version
 using FGPU_t = tbb::flow::async_node<ViVidItem *, ViVidItem *>;
 using gateway_type = FGPU_t::gateway_type;
-using StageFunction = std::function<SyclEventInfo(Acc, ViVidItem *, Tracer &, ApplicationData &, InputArgs &, sycl::queue &, std::vector<sycl::event> *)>;
 
-// Async GPU Node Definitions
+// Async GPU Node Definitions (one object per async node, shared by all the items that go through it). The kernel is
+// submitted without waiting and the completion thread puts the item through the gateway once the GPU has run it
 class FGPU {
-    tbb::task_arena a;
-    std::function<SyclEventInfo(ViVidItem *, Tracer &, ApplicationData &, InputArgs &, sycl::queue &)> kernel_func;
     int stage;
+    Tracer &traceFile;
+    ApplicationData &appData;
+    InputArgs &inputArgs;
+    sycl::queue &Q_GPU;
+    StageBatcher *batcher;                        //< Batches of the GPU stages (--gpu-batch), if any
+    PipelineInterface &pipeline;
+    GPUCompletion *completion;                    //< Null with --gpu-blocking: the kernel is waited for by the calling thread
+    std::atomic<gateway_type *> gateway{nullptr}; //< Gateway of the async node (the node is copied after this object is created)
+    std::vector<sycl::event> noEvents;            //< Passed as depends_on so that the kernels return without waiting
+
+    static void complete(void *self, void *item, const sycl::event &event);
+    void finish(gateway_type &gateway, ViVidItem *item, const sycl::event *event);
 
   public:
-    FGPU(std::function<SyclEventInfo(ViVidItem *, Tracer &, ApplicationData &, InputArgs &, sycl::queue &)> kernel_func, int stage);
-    void submit(gateway_type &gateway, ViVidItem *item, Tracer &trace_file, ApplicationData &appData, InputArgs &inputArgs, sycl::queue &Q_GPU, PipelineInterface &pipeline);
+    FGPU(int stage, Tracer &traceFile, ApplicationData &appData, InputArgs &inputArgs, sycl::queue &Q_GPU, StageBatcher *batcher, PipelineInterface &pipeline, GPUCompletion *completion);
+    void submit(gateway_type &gateway, ViVidItem *item);
 };
 
-// Create the Flow Graph Pipeline
-template <typename NodeType, std::size_t N>
+// Create the Flow Graph Pipeline (the stages are those of --stages)
+template <typename NodeType>
 class FlowGraphPipeline : public PipelineInterface {
   public:
-    void executePipeline(ApplicationData &appData, InputArgs &inputArgs, circular_buffer &bufferItems, Tracer &traceFile, sycl::queue &Q_GPU, sycl::queue &Q_CPU, EnergyPCM *energyPCM = nullptr) override;
+    void executePipeline(ApplicationData &appData, InputArgs &inputArgs, ItemPool &bufferItems, Tracer &traceFile, sycl::queue &Q_GPU, sycl::queue &Q_CPU, EnergyPCM *energyPCM = nullptr) override;
 
   private:
-    void setupPipeline(ApplicationData &appData, InputArgs &inputArgs, circular_buffer &bufferItems, Tracer &traceFile, sycl::queue &Q_GPU, sycl::queue &Q_CPU, EnergyPCM *energyPCM);
+    void setupPipeline(ApplicationData &appData, InputArgs &inputArgs, ItemPool &bufferItems, Tracer &traceFile, sycl::queue &Q_GPU, sycl::queue &Q_CPU, EnergyPCM *energyPCM);
     void initTokenBuffer(tbb::flow::buffer_node<int> &token_buffer, InputArgs &inputArgs);
-    auto create_Input_Node(tbb::flow::graph &g, ApplicationData &appData, InputArgs &inputArgs, circular_buffer &bufferItems, Tracer &traceFile);
-    auto create_Output_Node(tbb::flow::graph &g, tbb::flow::buffer_node<int> &token_buffer, ApplicationData &appData, InputArgs &inputArgs, circular_buffer &bufferItems, Tracer &traceFile, EnergyPCM *energyPCM);
+    auto create_Input_Node(tbb::flow::graph &g, ApplicationData &appData, InputArgs &inputArgs, ItemPool &bufferItems, Tracer &traceFile);
+    auto create_Output_Node(tbb::flow::graph &g, tbb::flow::buffer_node<int> &token_buffer, ApplicationData &appData, InputArgs &inputArgs, ItemPool &bufferItems, Tracer &traceFile, EnergyPCM *energyPCM);
     auto create_Indexer_Node(tbb::flow::graph &g);
+    auto create_Join_Node(tbb::flow::graph &g, int branches);
 
-    template <std::size_t Stage>
-    void addStage(tbb::flow::graph &g, InputArgs &inputArgs, Tracer &traceFile, ApplicationData &appData, sycl::queue &Q_GPU, sycl::queue &Q_CPU, std::vector<indexer_t *> &indexers, std::vector<std::shared_ptr<void>> &nodes_storage);
+    void addStage(tbb::flow::graph &g, int stage, indexer_t &source, InputArgs &inputArgs, Tracer &traceFile, ApplicationData &appData, sycl::queue &Q_GPU, sycl::queue &Q_CPU, std::vector<indexer_t *> &indexers, std::vector<std::shared_ptr<void>> &nodes_storage);
 
-    template <int Stage>
-    auto create_Splitter_Node(tbb::flow::graph &g, InputArgs &inputArgs, Tracer &traceFile);
+    template <typename Splitter_t>
+    auto create_Splitter_Node(tbb::flow::graph &g, int stage, InputArgs &inputArgs, Tracer &traceFile);
 
-    template <int Stage>
-    auto create_CPU_Node(tbb::flow::graph &g, ApplicationData &appData, InputArgs &inputArgs, Tracer &traceFile, sycl::queue &Q_CPU);
+    auto create_CPU_Node(tbb::flow::graph &g, int stage, ApplicationData &appData, InputArgs &inputArgs, Tracer &traceFile, sycl::queue &Q_CPU);
 
-    template <typename GPU_NodeType, int Stage>
-    auto create_GPU_Node(tbb::flow::graph &g, Tracer &traceFile, ApplicationData &appData, InputArgs &inputArgs, sycl::queue &Q_GPU, PipelineInterface &pipeline);
+    auto create_GPU_Node(tbb::flow::graph &g, int stage, Tracer &traceFile, ApplicationData &appData, InputArgs &inputArgs, sycl::queue &Q_GPU, PipelineInterface &pipeline);
 
-    template <int Stage>
-    auto create_GPU_Node_with_AN(tbb::flow::graph &g, Tracer &traceFile, ApplicationData &appData, InputArgs &inputArgs, sycl::queue &Q_GPU, PipelineInterface &pipeline);
+    auto create_GPU_Node_with_AN(tbb::flow::graph &g, int stage, Tracer &traceFile, ApplicationData &appData, InputArgs &inputArgs, sycl::queue &Q_GPU, PipelineInterface &pipeline);
 
-    template <int Stage>
-    auto create_GPU_Node_with_FN(tbb::flow::graph &g, Tracer &traceFile, ApplicationData &appData, InputArgs &inputArgs, sycl::queue &Q_GPU, PipelineInterface &pipeline);
+    auto create_GPU_Node_with_FN(tbb::flow::graph &g, int stage, Tracer &traceFile, ApplicationData &appData, InputArgs &inputArgs, sycl::queue &Q_GPU, PipelineInterface &pipeline);
 
     std::vector<std::shared_ptr<void>> nodes_storage_;
+    std::unique_ptr<GPUCompletion> gpuCompletion_; //< Completes the async GPU nodes (null with --api fgfn or --gpu-blocking)
 };
\ No newline at end of file
@@ -1,22 +1,36 @@
 #pragma once
 #include "Comparer.hpp"
+#include "GPUCompletion.hpp"
 #include "GlobalParameters.hpp"
 #include "PipelineInterface.hpp"
+#include "StageRegistry.hpp"
 #include "execute_code.hpp"
 #include <functional>
+#include <iostream>
+#include <memory>
 #include <oneapi/tbb.h>
+#include <thread>
 #include <unordered_map>
 
-template <std::size_t N>
 class ParallelPipeline : public PipelineInterface {
   public:
-    void executePipeline(ApplicationData &appData, InputArgs &inputArgs, circular_buffer &bufferItems, Tracer &traceFile, sycl::queue &Q_GPU, sycl::queue &Q_CPU, EnergyPCM *energyPCM = nullptr) override;
+    void executePipeline(ApplicationData &appData, InputArgs &inputArgs, ItemPool &bufferItems, Tracer &traceFile, sycl::queue &Q_GPU, sycl::queue &Q_CPU, EnergyPCM *energyPCM = nullptr) override;
 
   private:
+    std::unique_ptr<GPUCompletion> gpuCompletion; //< Resumes the GPU stages that released their worker (null with --gpu-blocking)
+    std::vector<sycl::event> noEvents;            //< Passed as depends_on so that the GPU kernels return without waiting
+
     template <typename FilterType>
     void addStage(FilterType &filter, ApplicationData &appData, InputArgs &inputArgs, Tracer &traceFile, sycl::queue &Q_GPU, sycl::queue &Q_CPU);
 
     SyclEventInfo processStage(std::size_t stage, Acc acc, ViVidItem *item, Tracer &traceFile, ApplicationData &appData, InputArgs &inputArgs, sycl::queue &Q_GPU, sycl::queue &Q_CPU);
-    void logProcessing(const std::string &message);
     Acc selectPathWrapper(InputArgs &inputArgs, std::size_t stage, bool GPU_item, ViVidItem *item, Tracer *traceFile);
+
+    // The message pieces are streamed directly, so nothing is built (or allocated) when LOG is disabled
+    template <typename... Args>
+    void logProcessing(const Args &...args) {
+        if constexpr (LOG_ENABLED) {
+            (std::clog << ... << args) << " with thread " << std::this_thread::get_id() << ".\n";
+        }
+    }
 };
\ No newline at end of file
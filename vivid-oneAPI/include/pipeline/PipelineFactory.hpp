@@ -1,6 +1,7 @@
 #ifndef PIPELINE_FACTORY_HPP
 #define PIPELINE_FACTORY_HPP
 
+#include "CoroutinePipeline.hpp"
 #include "FlowGraphPipeline.hpp"
 #include "GlobalParameters.hpp"
 #include "ParallelPipeline.hpp"
@@ -7,7 +7,8 @@
 #include "TimeMeasurements.hpp"
 #include "Timer.hpp"
 #include "Tracer.hpp"
-#include "circular-buffer.hpp"
+#include "ItemPool.hpp"
+#include "PipelineRuntime.hpp"
 
 // Forward declaration EnergyPCM
 class EnergyPCM;
@@ -15,21 +16,32 @@ class EnergyPCM;
 class PipelineInterface {
   public:
     virtual ~PipelineInterface() = default;
-    virtual void executePipeline(ApplicationData &appData, InputArgs &inputArgs, circular_buffer &bufferItems, Tracer &traceFile, sycl::queue &Q_GPU, sycl::queue &Q_CPU, EnergyPCM *energyPCM = nullptr) = 0;
+    virtual void executePipeline(ApplicationData &appData, InputArgs &inputArgs, ItemPool &bufferItems, Tracer &traceFile, sycl::queue &Q_GPU, sycl::queue &Q_CPU, EnergyPCM *energyPCM = nullptr) = 0;
+
+    // Attach the input and output components of the frames (owned by the caller, they must outlive the execution)
+    void attach(const PipelineRuntime &runtime_) {
+        runtime = runtime_;
+    }
 
     // Public wrapper for reduceCountersAfterProcessing
     void publicReduceCountersAfterProcessing(const InputArgs &inputArgs, const ApplicationData &appData, Acc accelerator, int index, sycl::queue *Q = nullptr, sycl::event *event = nullptr, std::vector<sycl::event> *vectorEvents = nullptr);
 
   protected:
+    PipelineRuntime runtime; // Components of the input and output of the frames (none attached: the global frame, no output)
+
     Acc selectPath(InputArgs &inputArgs, int index, bool &isGPUFrame, ViVidItem *item = nullptr, Tracer *tracer = nullptr);
-    Acc selectPathDecoupled(InputArgs &inputArgs, int index, bool &isGPUFrame);
-    Acc selectPathCoupled(InputArgs &inputArgs, int index, bool &isGPUFrame);
+    // One attempt to acquire the stage (Acc::OTHER if it failed); allowQueue=false never waits in the queue of a device
+    Acc selectPathDecoupled(InputArgs &inputArgs, int index, bool &isGPUFrame, bool allowQueue = true);
+    Acc selectPathCoupled(InputArgs &inputArgs, int index, bool &isGPUFrame, bool allowQueue = true);
 
     // Function to reduce counters after processing
     void reduceCountersAfterProcessing(const InputArgs &inputArgs, const ApplicationData &appData, Acc accelerator, int index, sycl::queue *Q = nullptr, sycl::event *event = nullptr, std::vector<sycl::event> *vectorEvents = nullptr);
 
+    // Check whether the input node must produce another frame (frames or duration left, and a frame in a pushed input)
+    bool hasNextFrame(ApplicationData &appData, InputArgs &inputArgs, ItemPool &bufferItems);
+
     // Function to process input nodes
-    ViVidItem *processInputNode(ApplicationData &appData, InputArgs &inputArgs, circular_buffer &bufferItems, Tracer &traceFile);
+    ViVidItem *processInputNode(ApplicationData &appData, InputArgs &inputArgs, ItemPool &bufferItems, Tracer &traceFile);
 
     // New helper functions for improved modularity
     void logProcessing(ViVidItem *item);
@@ -38,5 +50,6 @@ class PipelineInterface {
     bool isAutoModeEnabled(ApplicationData &appData, ViVidItem *item, InputArgs &inputArgs);
     void optimizePipeline(ApplicationData &appData, InputArgs &inputArgs);
     void debugAndTrace(ViVidItem *item, ApplicationData &appData, Tracer &traceFile);
-    void recycleItem(circular_buffer &bufferItems, ViVidItem *item);
+    // Function to process output nodes: the output stage of the frame (see PipelineRuntime::complete), then back to the pool
+    void processOutputNode(InputArgs &inputArgs, ItemPool &bufferItems, ViVidItem *item);
 };
\ No newline at end of file
@@ -0,0 +1,76 @@
+/**
+ * @file PipelineRuntime.hpp
+ * @brief Runtime components a frame goes through around the stages: its input, before the first stage, and its
+ * output, after the last one.
+ *
+ * main() and libvivid own the components of the options that were given (--input, --roi, --reuse, --queues, --camera,
+ * --sink, --reorder, --gpu-batch) and attach them to the pipeline with a PipelineRuntime of non-owning pointers
+ * (nullptr: option not given). The input node of every backend admits its frames with admit() and the output node
+ * hands them to complete(), the output stage: the reorder buffer, the result sink and the return of the frame, queues
+ * and camera slot. The item pool only recycles the items it gets back. The stages get the batcher of the GPU stages
+ * from the backend, as an argument of runStage().
+ */
+#pragma once
+#ifndef PIPELINE_RUNTIME_HPP
+#define PIPELINE_RUNTIME_HPP
+
+#include "CameraEmulator.hpp"
+#include "FrameSource.hpp"
+#include "ItemPool.hpp"
+#include "QueuePool.hpp"
+#include "ReorderBuffer.hpp"
+#include "ResultSink.hpp"
+#include "RoiList.hpp"
+#include "StageBatcher.hpp"
+#include "TemporalCache.hpp"
+
+struct PipelineRuntime {
+    FrameSource *frameSource = nullptr;     ///< Multi-frame input (--input, or the frames pushed to libvivid; nullptr: the global frame).
+    const RoiList *rois = nullptr;          ///< Regions of interest of the frames (--roi).
+    TemporalCache *temporalCache = nullptr; ///< Temporal reuse (--reuse).
+    QueuePool *queuePool = nullptr;         ///< Queues of the frames in flight (--queues, only with several queues per device).
+    CameraEmulator *camera = nullptr;       ///< Synthetic camera (--camera).
+    ResultSink *resultSink = nullptr;       ///< Output of the detections (--sink, or the results of libvivid).
+    ReorderBuffer *reorderBuffer = nullptr; ///< Output in the order of the frame ids (--reorder).
+    StageBatcher *stageBatcher = nullptr;   ///< Batches of the GPU stages (--gpu-batch), passed by the backends to runStage.
+
+    /**
+     * @brief Check whether the input has another frame (a pushed input ends when the application closes it).
+     */
+    bool reserveFrame() const;
+
+    /**
+     * @brief Prepare a new item (its id already set) before the first stage: take its frame, regions, tiles to
+     * recompute and queues, and wait for the camera to release the frame.
+     */
+    void admit(ViVidItem *item) const;
+
+    /**
+     * @brief Output stage of a finished item: complete its output with the temporal reuse, then deliver it (through the
+     * reorder buffer, if any) to the result sink and give back its frame, queues and camera slot before recycling it.
+     * @param item Item that went through every stage.
+     * @param bufferItems Pool the item returns to.
+     */
+    void complete(ViVidItem *item, ItemPool &bufferItems) const;
+
+    /**
+     * @brief Deliver the frames held by the reorder buffer once the pipeline has finished, so their items are recycled
+     * and their results reach the sink before it is stopped.
+     */
+    void flush(ItemPool &bufferItems) const;
+
+  private:
+    struct Delivery {
+        const PipelineRuntime *runtime;
+        ItemPool *bufferItems;
+    };
+
+    static void deliverReordered(void *delivery, ViVidItem *item, bool inOrder);
+
+    /**
+     * @param inOrder false for a frame skipped by the reorder buffer: its results are not written.
+     */
+    void deliver(ViVidItem *item, ItemPool &bufferItems, bool inOrder) const;
+};
+
+#endif // PIPELINE_RUNTIME_HPP
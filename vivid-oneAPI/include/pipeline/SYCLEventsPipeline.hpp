@@ -3,26 +3,32 @@
 #include "Comparer.hpp"
 #include "Device.hpp"
 #include "PipelineInterface.hpp"
+#include "StageGraphs.hpp"
+#include "StageRegistry.hpp"
 #include "Timer.hpp"
 #include "execute_code.hpp"
-#include <functional>
+#include <atomic>
+#include <exception>
 #include <mutex>
 #include <oneapi/tbb.h>
 #include <sycl/sycl.hpp>
 #include <thread>
-#include <unordered_map>
 #include <vector>
 
-// Mutexes for protecting critical sections
-extern std::mutex input_mutex;  ///< Mutex for protecting the ID counter and other critical sections
-extern std::mutex output_mutex; ///< Mutex for protecting the output node
-
 /**
- * @brief SYCLEventsPipeline class template for managing and executing the SYCL pipeline.
+ * @brief SYCLEventsPipeline class for managing and executing the SYCL pipeline (the stages are those of --stages).
  *
- * @tparam N Number of stages in the pipeline.
+ * A fixed pool of workers (--threads, no more than the frames in flight) admits the frames one at a time (the input
+ * node is serial) and submits their stages, each one depending only on the events of the previous level of the same
+ * frame; the stages that run on the host (the CPU kernels without SYCL and the simulator) are host tasks, so a worker
+ * never runs or waits for a stage. The last command of a frame is a host task that depends on all its stages and hands
+ * the frame to the output thread, so no thread is parked on a frame while it runs: a worker takes the next frame as
+ * soon as it has submitted one, up to --iff frames in flight (an atomic token counter). The output thread releases the
+ * frames in the order of their ids (they finish in any order: the early ones are held by id until the previous ones
+ * have left), and the per-frame vectors of events keep their capacity, so memory and latency do not grow with the
+ * length of the run. With --gpu-graph a frame whose stages all run on the GPU replays the graph recorded for its item
+ * instead (see StageGraphs.hpp).
  */
-template <std::size_t N>
 class SYCLEventsPipeline : public PipelineInterface {
   public:
     /**
@@ -30,53 +36,68 @@ class SYCLEventsPipeline : public PipelineInterface {
      *
      * @param appData Application data.
      * @param inputArgs Input arguments.
-     * @param bufferItems Circular buffer containing items to process.
+     * @param bufferItems Pool of items to process.
      * @param traceFile Trace file for logging.
      * @param Q_GPU SYCL queue for GPU.
      * @param Q_CPU SYCL queue for CPU.
      * @param energyPCM Optional energy PCM pointer.
      */
-    void executePipeline(ApplicationData &appData, InputArgs &inputArgs, circular_buffer &bufferItems, Tracer &traceFile, sycl::queue &Q_GPU, sycl::queue &Q_CPU, EnergyPCM *energyPCM = nullptr) override;
+    void executePipeline(ApplicationData &appData, InputArgs &inputArgs, ItemPool &bufferItems, Tracer &traceFile, sycl::queue &Q_GPU, sycl::queue &Q_CPU, EnergyPCM *energyPCM = nullptr) override;
 
   private:
-    /**
-     * @brief Type definition for the stage function.
-     */
-    using StageFunction = std::function<SyclEventInfo(Acc, ViVidItem *, Tracer &, ApplicationData &, InputArgs &, sycl::queue &, std::vector<sycl::event> *)>;
-
-    std::unique_ptr<Device> inFlightFrames;                        ///< Device for managing in-flight frames.
-    std::unordered_map<std::size_t, StageFunction> stageFunctions; ///< Map of stage functions.
+    std::unique_ptr<Device> inFlightFrames;               ///< Device for managing in-flight frames.
+    std::unique_ptr<StageGraphs> stageGraphs;             ///< Graphs of the frames that run whole on the GPU (--gpu-graph).
+    tbb::concurrent_bounded_queue<ViVidItem *> completed; ///< Frames whose stages have all run, as they finish (nullptr: stop the output thread).
+    std::atomic<int> freeTokens{0};                       ///< Frames that can still enter the pipeline (--iff).
+    std::atomic<int> pendingCompletions{0};               ///< Completion host tasks submitted that have not run yet.
+    std::atomic<bool> failed{false};                      ///< A worker or the output thread failed: the others stop.
+    std::mutex inputMutex;                                ///< Serializes the input node of the workers.
 
     /**
      * @brief Run a stage wrapper.
      *
-     * @tparam StageFunc Type of the stage function.
      * @param acc Accelerator type.
      * @param item Item to process.
      * @param traceFile Trace file for logging.
      * @param inputArgs Input arguments.
      * @param appData Application data.
      * @param Q SYCL queue.
-     * @param stage_func Stage function to execute.
      * @param eventInfo SYCL event info.
      * @param stage_ID Stage identifier.
+     * @param prevEvents Events of the stages of the previous level (the stage depends on them only).
+     * @param levelEvents Events of the stages of the current level (the stages of the next level depend on them).
      */
-    template <typename StageFunc>
-    void runStageWrapper(Acc acc, ViVidItem *item, Tracer &traceFile, InputArgs &inputArgs, ApplicationData &appData, sycl::queue &Q, StageFunc stage_func, SyclEventInfo &eventInfo, int stage_ID);
+    void runStageWrapper(Acc acc, ViVidItem *item, Tracer &traceFile, InputArgs &inputArgs, ApplicationData &appData, sycl::queue &Q, SyclEventInfo &eventInfo, int stage_ID, std::vector<sycl::event> &prevEvents, std::vector<sycl::event> &levelEvents);
 
     /**
-     * @brief Process an image.
+     * @brief Worker of the pool: admits frames and submits their stages until the input ends.
      *
      * @param appData Application data.
      * @param inputArgs Input arguments.
      * @param traceFile Trace file for logging.
-     * @param bufferItems Circular buffer containing items to process.
-     * @param filter_bank Filter bank for processing.
+     * @param bufferItems Pool of items to process.
      * @param Q_GPU SYCL queue for GPU.
      * @param Q_CPU SYCL queue for CPU.
-     * @param energyPCM Optional energy PCM pointer.
      */
-    void processImage(ApplicationData &appData, InputArgs &inputArgs, Tracer &traceFile, circular_buffer &bufferItems, float *filter_bank, sycl::queue &Q_GPU, sycl::queue &Q_CPU, EnergyPCM *energyPCM = nullptr);
+    void processImage(ApplicationData &appData, InputArgs &inputArgs, Tracer &traceFile, ItemPool &bufferItems, sycl::queue &Q_GPU, sycl::queue &Q_CPU);
+
+    /**
+     * @brief Output thread: releases the completed frames in the order of their ids until it gets a nullptr.
+     *
+     * @param firstId Id of the first frame of the execution.
+     */
+    void processOutput(ApplicationData &appData, InputArgs &inputArgs, Tracer &traceFile, ItemPool &bufferItems, sycl::queue &Q_GPU, sycl::queue &Q_CPU, size_t firstId);
+
+    /**
+     * @brief Output node of a completed frame (its turn has come): measurements, debug and trace, then its output stage.
+     * @throws sycl::exception If a stage of the frame failed asynchronously.
+     */
+    void outputFrame(ViVidItem *item, ApplicationData &appData, InputArgs &inputArgs, Tracer &traceFile, ItemPool &bufferItems, sycl::queue &Q_GPU, sycl::queue &Q_CPU);
+
+    /**
+     * @brief Submit the host task that hands the frame to the output thread once all its stages have run.
+     */
+    void submitCompletion(ViVidItem *item, sycl::queue &Q_GPU, sycl::queue &Q_CPU);
 
     /**
      * @brief Add stages to the pipeline.
@@ -87,16 +108,33 @@ class SYCLEventsPipeline : public PipelineInterface {
      * @param traceFile Trace file for logging.
      * @param Q_GPU SYCL queue for GPU.
      * @param Q_CPU SYCL queue for CPU.
+     * @param prevEvents Scratch vector for the events of the previous level.
+     * @param levelEvents Scratch vector for the events of a level.
+     * @param stageAccs Scratch vector for the device selected for each stage.
      */
-    void addStages(ViVidItem *item, ApplicationData &appData, InputArgs &inputArgs, Tracer &traceFile, sycl::queue &Q_GPU, sycl::queue &Q_CPU);
+    void addStages(ViVidItem *item, ApplicationData &appData, InputArgs &inputArgs, Tracer &traceFile, sycl::queue &Q_GPU, sycl::queue &Q_CPU, std::vector<sycl::event> &prevEvents, std::vector<sycl::event> &levelEvents, std::vector<Acc> &stageAccs);
 
     /**
-     * @brief Get the stage function for the specified stage.
-     *
-     * @param stage Stage number.
-     * @return StageFunction The stage function.
+     * @brief Submit the stages of a frame that runs whole on the GPU as the graph of its item.
+     * @return false if graphs are not usable: the stages must be submitted one by one.
+     */
+    bool replayGraph(ViVidItem *item, ApplicationData &appData, InputArgs &inputArgs, Tracer &traceFile, sycl::queue &Q_GPU, std::vector<sycl::event> &prevEvents, std::vector<sycl::event> &levelEvents);
+
+    /**
+     * @brief Take a token to admit a frame, waiting while --iff frames are in flight.
+     * @return false if the pipeline failed.
+     */
+    bool acquireToken();
+
+    /**
+     * @brief Give back the token of a frame that left the pipeline.
+     */
+    void releaseToken();
+
+    /**
+     * @brief Stop the workers and the output thread after a failure.
      */
-    StageFunction getStageFunction(size_t stage);
+    void fail();
 
     /**
      * @brief Reserve a frame in flight.
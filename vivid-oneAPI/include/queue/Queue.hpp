@@ -45,7 +45,7 @@ struct OptConfResults {
 
 class PipelineOptimizer {
   public:
-    static std::vector<OptConfResults> findOptimalConfiguration(int nstages, std::vector<double> thC, std::vector<double> thG, int nc, bool debug = false);
+    static std::vector<OptConfResults> findOptimalConfiguration(int nstages, std::vector<double> thC, std::vector<double> thG, int nc, bool debug = false, int maxTokens = 0);
 
   private:
     static std::pair<double, int> findMinWithIndex(const std::vector<double> &v);
@@ -59,7 +59,7 @@ class PipelineOptimizer {
                                                         const std::vector<double> &TserCS, const std::vector<double> &TserGS,
                                                         int nc, const std::vector<double> &rhoG, const std::vector<double> &rhoC,
                                                         int stageBotl, std::string devBot,
-                                                        bool debug);
+                                                        bool debug, int maxTokens);
 };
 
 #endif // QUEUE_HPP
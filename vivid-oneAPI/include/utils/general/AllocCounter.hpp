@@ -0,0 +1,59 @@
+/**
+ * @file AllocCounter.hpp
+ * @brief Allocation audit counter used to check that the steady-state hot path does not allocate.
+ *
+ * When the program is built with ALLOCCOUNT=1 the global operator new/delete are replaced
+ * (see AllocCounter.cpp) and every allocation is counted. The input node marks the beginning of
+ * the steady state once all the items of the pool have been used at least once, and the output
+ * node marks the end when no more than a pool of frames is left to start, so neither the warm-up
+ * nor the drain and teardown are counted and the report gives the allocations per frame of the
+ * steady state. Runs too short to have one (three pools of frames) report none. Without the flag
+ * all the functions are no-ops.
+ */
+#pragma once
+#ifndef ALLOC_COUNTER_HPP
+#define ALLOC_COUNTER_HPP
+
+#include "GlobalParameters.hpp"
+#include <cstddef>
+
+namespace AllocCounter {
+/**
+ * @brief Gets the total number of allocations performed since the program started.
+ */
+size_t allocations() noexcept;
+
+/**
+ * @brief Gets the total number of bytes allocated since the program started.
+ */
+size_t bytes() noexcept;
+
+/**
+ * @brief Marks the beginning of the steady state (only the first call is taken into account).
+ * @param frame Number of frames started at this point.
+ */
+void startSteadyState(int frame) noexcept;
+
+/**
+ * @brief Marks the end of the steady state (only the first call after the beginning is taken into account).
+ * @param frame Number of frames started at this point.
+ */
+void stopSteadyState(int frame) noexcept;
+
+/**
+ * @brief Checks whether the steady state has been measured (start and stop have been marked).
+ */
+bool hasSteadyState() noexcept;
+
+/**
+ * @brief Gets the number of allocations per frame measured in the steady state.
+ */
+double allocationsPerFrame() noexcept;
+
+/**
+ * @brief Gets the number of bytes allocated per frame measured in the steady state.
+ */
+double bytesPerFrame() noexcept;
+} // namespace AllocCounter
+
+#endif // ALLOC_COUNTER_HPP
@@ -0,0 +1,87 @@
+/**
+ * @file AsyncReader.hpp
+ * @brief Asynchronous positional reads used by the I/O thread of the frame source (--io-backend).
+ *
+ * Backends:
+ *  - io_uring: the reads are queued in a submission ring shared with the kernel (raw syscalls, no liburing).
+ *  - pread: a pool of threads, each one blocked in pread() on one request (fallback when io_uring is not available).
+ *  - sync: pread() in the calling thread, one request at a time.
+ *
+ * The caller keeps at most capacity() reads outstanding: submit() never blocks and wait() returns the next read
+ * that has completed, in any order. Short reads are resubmitted by the backends, so a completion without error
+ * means that the whole range has been read. An O_DIRECT read (ReadRequest::alignment) is resumed from the start of the
+ * block where it stopped, so the resubmitted read stays aligned (the overlap is read again).
+ */
+#pragma once
+#ifndef ASYNC_READER_HPP
+#define ASYNC_READER_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+
+/**
+ * @brief Backend of the asynchronous reads.
+ */
+enum class IOBackend {
+    Auto,  //< io_uring if the kernel allows it, otherwise pread threads
+    Uring, //< io_uring
+    Pread, //< Pool of pread threads
+    Sync   //< pread in the I/O thread
+};
+
+const char *ioBackendName(IOBackend backend);
+
+/**
+ * @brief A read of a range of a file.
+ */
+struct ReadRequest {
+    int fd;               ///< File descriptor (may be opened with O_DIRECT, then dst, size and offset must be aligned).
+    void *dst;            ///< Destination of the data.
+    size_t size;          ///< Number of bytes to read.
+    uint64_t offset;      ///< Position in the file.
+    uint64_t tag;         ///< Identifier returned by wait() when the read completes.
+    size_t alignment = 0; ///< Block size of an O_DIRECT descriptor (0: buffered read).
+};
+
+/**
+ * @brief Result of a read.
+ */
+struct ReadCompletion {
+    uint64_t tag; ///< Tag of the request.
+    int error;    ///< 0 if the whole range was read, errno of the failure otherwise (ENODATA: unexpected end of file, or
+                  ///< of an O_DIRECT read inside a block).
+};
+
+class AsyncReader {
+  public:
+    virtual ~AsyncReader() = default;
+
+    /**
+     * @brief Create a reader.
+     * @param backend Backend (Auto: io_uring, falling back to pread threads if io_uring_setup fails).
+     * @param capacity Maximum number of outstanding reads.
+     * @throws std::runtime_error If the backend is Uring and the kernel does not allow io_uring.
+     */
+    static std::unique_ptr<AsyncReader> create(IOBackend backend, size_t capacity);
+
+    virtual IOBackend backend() const = 0;
+    size_t capacity() const { return maxRequests; }
+
+    /**
+     * @brief Queue a read (the caller must not exceed capacity() outstanding reads).
+     */
+    virtual void submit(const ReadRequest &request) = 0;
+
+    /**
+     * @brief Wait until a read completes.
+     * @throws std::runtime_error If the backend itself fails (not for I/O errors of a read, see ReadCompletion::error).
+     */
+    virtual ReadCompletion wait() = 0;
+
+  protected:
+    explicit AsyncReader(size_t capacity) : maxRequests{capacity} {}
+    size_t maxRequests;
+};
+
+#endif // ASYNC_READER_HPP
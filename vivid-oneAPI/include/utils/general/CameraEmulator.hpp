@@ -0,0 +1,103 @@
+/**
+ * @file CameraEmulator.hpp
+ * @brief Synthetic camera (--camera): releases the frames to the pipeline on a timer instead of as fast as it accepts them.
+ *
+ * Frame k of the camera arrives at t0 + k * period. With a burst of N frames, the frames are released in groups of
+ * N every N periods (same mean rate). The jitter moves each release by a uniform random offset in [-jitter, +jitter]
+ * (the arrivals never go back in time). t0 is the moment the input node asks for the first frame.
+ *
+ * The camera is open loop: it never drops frames and never waits for the pipeline. If the pipeline falls behind,
+ * the frames wait to be admitted (there is no free item or token) and the queueing delay grows.
+ *
+ * Each frame is stamped with its arrival time and its deadline (arrival + --deadline). When the item is released
+ * its end-to-end latency (arrival to release, including the queueing delay) is recorded and, if the deadline has
+ * passed, a miss is counted.
+ */
+#pragma once
+#ifndef CAMERA_EMULATOR_HPP
+#define CAMERA_EMULATOR_HPP
+
+#include "LatencyHistogram.hpp"
+#include "pipeline_template.hpp"
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+#include <random>
+
+using namespace Pipeline_template;
+
+/**
+ * @brief Timing of the synthetic camera.
+ */
+struct CameraConfig {
+    double fps = 0.0;      ///< Frames per second.
+    int burst = 1;         ///< Frames released together.
+    double jitter = 0.0;   ///< Maximum deviation of each release from its nominal time (ms).
+    double deadline = 0.0; ///< Time after the arrival by which a frame must be released (ms, 0: DEFAULT_DEADLINE_PERIODS periods).
+    uint32_t seed = 1;     ///< Seed of the jitter.
+};
+
+/**
+ * @brief Real-time statistics of the synthetic camera.
+ */
+struct CameraStats {
+    double fps = 0.0;             ///< Frame rate of the camera.
+    int burst = 1;                ///< Frames released together.
+    double jitter = 0.0;          ///< Jitter of the releases (ms).
+    double deadline = 0.0;        ///< Deadline of each frame after its arrival (ms).
+    size_t frames = 0;            ///< Frames completed.
+    size_t deadlineMisses = 0;    ///< Frames released after their deadline.
+    double achievedFps = 0.0;     ///< Frames completed per second since the first arrival.
+    LatencySummary queueingDelay; ///< Time from the arrival of each frame to its admission in the pipeline (ms).
+    LatencySummary latency;       ///< Time from the arrival of each frame to its release (ms).
+};
+
+class CameraEmulator {
+  public:
+    using Clock = std::chrono::steady_clock;
+
+    /**
+     * @brief Create the camera.
+     * @throws std::invalid_argument If the rate is not positive, the burst is smaller than 1 or the jitter or the deadline are negative.
+     */
+    explicit CameraEmulator(const CameraConfig &config);
+
+    /**
+     * @brief Wait until the next frame of the camera arrives and stamp it in the item (called by the input node, from any thread).
+     * @param item Item that will carry the frame.
+     */
+    void admit(ViVidItem *item);
+
+    /**
+     * @brief Record the latency of a frame and check its deadline (called when the item is released, from any thread).
+     * @param item Item previously passed to admit().
+     */
+    void complete(ViVidItem *item) noexcept;
+
+    /**
+     * @brief Get a snapshot of the statistics.
+     */
+    CameraStats getStats() const;
+
+  private:
+    CameraConfig config;
+    std::mutex mutex;             //< Protects the arrival schedule (from rng to groupArrival)
+    Clock::duration period;       //< Time between two frames
+    Clock::duration deadline;     //< Deadline of a frame after its arrival
+    std::mt19937 rng;             //< Generator of the jitter
+    std::uniform_real_distribution<double> jitter;
+    bool started = false;
+    Clock::time_point t0;         //< Nominal arrival of the first frame
+    Clock::time_point lastArrival;
+    size_t nextFrame = 0;         //< Index of the next frame of the camera
+    Clock::time_point groupArrival; //< Arrival of the current burst
+
+    LatencyHistogram queueingDelay;
+    LatencyHistogram latency;
+    std::atomic<size_t> misses{0};
+    std::atomic<int64_t> lastCompletion{0}; //< Release of the last frame (ns since t0)
+};
+
+#endif // CAMERA_EMULATOR_HPP
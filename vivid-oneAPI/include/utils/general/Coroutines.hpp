@@ -0,0 +1,189 @@
+/**
+ * @file Coroutines.hpp
+ * @brief Minimal C++20 coroutine support of the coroutine backend (--api coro): an executor, two coroutine types and a
+ * mutex that suspends instead of blocking.
+ *
+ * A suspended coroutine is only its frame, so a frame in flight that waits for a core, for the GPU or for its turn in the
+ * input or output does not hold a thread. The executor runs the ready coroutines on a fixed number of threads; whoever
+ * makes a coroutine ready again (a release, the completion of a kernel, an unlock) schedules it on the executor.
+ */
+#pragma once
+#ifndef COROUTINES_HPP
+#define COROUTINES_HPP
+
+#include <condition_variable>
+#include <coroutine>
+#include <cstddef>
+#include <deque>
+#include <exception>
+#include <mutex>
+#include <thread>
+#include <utility>
+#include <vector>
+
+class CoroExecutor {
+  public:
+    /**
+     * @brief Start the threads of the executor.
+     * @param numThreads Number of threads (at least one).
+     */
+    explicit CoroExecutor(size_t numThreads);
+
+    /**
+     * @brief Stop the threads once the ready coroutines have run. The suspended coroutines must have finished already.
+     */
+    ~CoroExecutor();
+
+    CoroExecutor(const CoroExecutor &) = delete;
+    CoroExecutor &operator=(const CoroExecutor &) = delete;
+
+    /**
+     * @brief Resume the coroutine on a thread of the executor.
+     */
+    void schedule(std::coroutine_handle<> handle);
+
+    /**
+     * @brief Awaitable that moves the calling coroutine to a thread of the executor.
+     */
+    auto yield() {
+        struct Yield {
+            CoroExecutor &executor;
+            bool await_ready() const noexcept { return false; }
+            void await_suspend(std::coroutine_handle<> handle) { executor.schedule(handle); }
+            void await_resume() const noexcept {}
+        };
+        return Yield{*this};
+    }
+
+    /**
+     * @brief Number of threads of the executor.
+     */
+    size_t size() const { return threads.size(); }
+
+  private:
+    std::deque<std::coroutine_handle<>> ready; //< Coroutines waiting for a thread
+    std::mutex mutex;
+    std::condition_variable available;
+    bool stopping = false;
+    std::vector<std::thread> threads;
+
+    void worker();
+};
+
+/**
+ * @brief Coroutine that starts when it is called and destroys itself when it ends. Its body must not let exceptions out.
+ */
+struct DetachedCoroutine {
+    struct promise_type {
+        DetachedCoroutine get_return_object() noexcept { return {}; }
+        std::suspend_never initial_suspend() const noexcept { return {}; }
+        std::suspend_never final_suspend() const noexcept { return {}; }
+        void return_void() const noexcept {}
+        void unhandled_exception() const noexcept { std::terminate(); }
+    };
+};
+
+/**
+ * @brief Coroutine that starts when it is awaited and resumes the awaiting coroutine when it ends (its exception is
+ * rethrown there).
+ */
+class CoroTask {
+  public:
+    struct promise_type {
+        std::coroutine_handle<> continuation;
+        std::exception_ptr exception;
+
+        CoroTask get_return_object() noexcept { return CoroTask{std::coroutine_handle<promise_type>::from_promise(*this)}; }
+        std::suspend_always initial_suspend() const noexcept { return {}; }
+        auto final_suspend() const noexcept {
+            struct Final {
+                bool await_ready() const noexcept { return false; }
+                std::coroutine_handle<> await_suspend(std::coroutine_handle<promise_type> handle) noexcept { return handle.promise().continuation; }
+                void await_resume() const noexcept {}
+            };
+            return Final{};
+        }
+        void return_void() const noexcept {}
+        void unhandled_exception() noexcept { exception = std::current_exception(); }
+    };
+
+    CoroTask(CoroTask &&other) noexcept : handle{std::exchange(other.handle, nullptr)} {}
+    CoroTask(const CoroTask &) = delete;
+    CoroTask &operator=(const CoroTask &) = delete;
+    ~CoroTask() {
+        if (handle) {
+            handle.destroy();
+        }
+    }
+
+    bool await_ready() const noexcept { return false; }
+    std::coroutine_handle<> await_suspend(std::coroutine_handle<> awaiting) noexcept {
+        handle.promise().continuation = awaiting;
+        return handle;
+    }
+    void await_resume() const {
+        if (handle.promise().exception) {
+            std::rethrow_exception(handle.promise().exception);
+        }
+    }
+
+  private:
+    std::coroutine_handle<promise_type> handle;
+
+    explicit CoroTask(std::coroutine_handle<promise_type> handle_) : handle{handle_} {}
+};
+
+/**
+ * @brief Mutex for coroutines: a coroutine that finds it locked is suspended and the unlock hands it the mutex.
+ */
+class CoroMutex {
+  public:
+    /**
+     * @brief Unlocks the mutex when it goes out of scope.
+     */
+    class Guard {
+      public:
+        explicit Guard(CoroMutex &mutex_) : mutex{&mutex_} {}
+        Guard(Guard &&other) noexcept : mutex{std::exchange(other.mutex, nullptr)} {}
+        Guard(const Guard &) = delete;
+        Guard &operator=(const Guard &) = delete;
+        ~Guard() {
+            if (mutex) {
+                mutex->unlock();
+            }
+        }
+
+      private:
+        CoroMutex *mutex;
+    };
+
+    /**
+     * @param executor_ Executor that resumes the coroutine the mutex is handed to.
+     */
+    explicit CoroMutex(CoroExecutor &executor_) : executor{executor_} {}
+
+    /**
+     * @brief Awaitable that locks the mutex; co_await returns the Guard that unlocks it.
+     */
+    auto lock() {
+        struct Lock {
+            CoroMutex &mutex;
+            bool await_ready() { return mutex.tryLock(); }
+            bool await_suspend(std::coroutine_handle<> handle) { return mutex.lockOrWait(handle); }
+            Guard await_resume() { return Guard{mutex}; }
+        };
+        return Lock{*this};
+    }
+
+  private:
+    CoroExecutor &executor;
+    std::mutex mutex;
+    bool locked = false;
+    std::deque<std::coroutine_handle<>> waiting; //< In the order they tried to lock
+
+    bool tryLock();
+    bool lockOrWait(std::coroutine_handle<> handle);
+    void unlock();
+};
+
+#endif // COROUTINES_HPP
@@ -2,7 +2,7 @@
 #define DATA_BUFFERS_HPP
 
 #include "ApplicationData.hpp"
-#include "circular-buffer.hpp"
+#include "ItemPool.hpp"
 #include "pipeline_template.hpp"
 #include <memory>
 #include <random>
@@ -10,11 +10,20 @@
 #include <sycl/sycl.hpp>
 #include <vector>
 
+class InputArgs;
+
 namespace DataBuffers {
-FloatBuffer *createGlobalFrame(const std::unique_ptr<float[]> &f_imData, int height, int width, sycl::queue &Q);
-float *createFilterBank(const int numFilters, const int filterDim, std::mt19937 &mte, sycl::queue &Q);
-FloatBuffer *createGlobalCla(const int window_height, const int window_width, const int cell_size, const int block_size, const int dict_size, std::mt19937 &mte, sycl::queue &Q);
-void createAllBuffers(ApplicationData &appData, const std::unique_ptr<float[]> &f_imData);
+FrameBuffer *createGlobalFrame(const void *f_imData, int height, int width, PixelType pixelType, sycl::queue &Q, USMUsage &usage);
+float *createFilterBank(const int numFilters, const int filterDim, std::mt19937 &mte, sycl::queue &Q, USMUsage &usage);
+FloatBuffer *createGlobalCla(const int window_height, const int window_width, const int cell_size, const int block_size, const int dict_size, std::mt19937 &mte, sycl::queue &Q, USMUsage &usage);
+void createAllBuffers(ApplicationData &appData, const void *f_imData);
+
+/**
+ * @brief Create the classes of the stages with their own classifier (dict=, model= in --stages) and give the items the
+ * buffers of the stages that do not use the global classes or output (the branches but the first of each level).
+ * @throws std::invalid_argument If a model cannot be read or does not match the histograms.
+ */
+void createStageBuffers(ApplicationData &appData, const InputArgs &inputArgs, ItemPool &bufferItems);
 } // namespace DataBuffers
 
 #endif // DATA_BUFFERS_HPP
\ No newline at end of file
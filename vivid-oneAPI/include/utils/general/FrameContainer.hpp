@@ -0,0 +1,227 @@
+/**
+ * @file FrameContainer.hpp
+ * @brief Versioned, self-describing container of frames (.bin files in the media folder and --input).
+ *
+ * Layout (little endian):
+ *
+ *   offset  size  field
+ *        0     4  magic "VVDF"
+ *        4     2  version (FrameContainer::VERSION)
+ *        6     2  header size in bytes (64)
+ *        8     4  width
+ *       12     4  height
+ *       16     4  channels
+ *       20     4  pixel type (PixelType)
+ *       24     8  frame count
+ *       32     8  file offset of the frame offset table (frame count x uint64)
+ *       40     8  file offset of the checksum table (frame count x uint32 CRC-32), 0 if there are no checksums
+ *       48     4  flags (reserved, 0)
+ *       52    12  reserved (0)
+ *
+ * The frames are stored after the header and the tables after the frames, so a writer can stream frames
+ * without knowing their number in advance. FrameWriter starts every frame at a multiple of FRAME_ALIGNMENT
+ * bytes so that the frames can be read with O_DIRECT (readers must always use the offset table).
+ * media/convert_img_to_bin.py writes the same format.
+ *
+ * The reader also accepts the two layouts used before the container existed: the two int32 header
+ * (height, width) followed by float frames, and the six int32 header written by older versions of the
+ * converter (rows, cols, depth, type, channels, bytes).
+ */
+#pragma once
+#ifndef FRAME_CONTAINER_HPP
+#define FRAME_CONTAINER_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace FrameContainer {
+constexpr char MAGIC[4] = {'V', 'V', 'D', 'F'}; //< Magic number of the container
+constexpr uint16_t VERSION = 1;                 //< Latest version of the format
+constexpr size_t HEADER_SIZE = 64;              //< Size of the header in bytes
+constexpr size_t FRAME_ALIGNMENT = 4096;        //< Alignment of the frames written by FrameWriter (O_DIRECT block)
+
+/**
+ * @brief Type of the pixels stored in the container.
+ */
+enum class PixelType : uint32_t {
+    Float32 = 1,
+    UInt8 = 2,
+    UInt16 = 3
+};
+
+/**
+ * @brief Layout of the file read by FrameReader.
+ */
+enum class Layout {
+    Container,     //< Versioned container (VVDF)
+    LegacyHeader2, //< int32 height, int32 width, float frames
+    LegacyHeader6, //< int32 rows, cols, depth, type, channels, bytes, one float frame (old converter)
+    Raw            //< No header, dimensions given by the user
+};
+
+size_t pixelSize(PixelType type);
+const char *pixelTypeName(PixelType type);
+
+/**
+ * @brief Standard CRC-32 (same as zlib.crc32), used for the per-frame checksums.
+ * @param data Data to checksum.
+ * @param size Size of the data in bytes.
+ * @param crc Previous value, to checksum data in several calls.
+ */
+uint32_t crc32(const void *data, size_t size, uint32_t crc = 0);
+
+/**
+ * @brief Reader of frame containers (and of the legacy and raw layouts).
+ *
+ * The constructor validates the whole layout against the size of the file, so a truncated or
+ * mismatched file fails when it is opened rather than when a frame is read.
+ */
+class FrameReader {
+  public:
+    /**
+     * @brief Open a container (or a legacy .bin file) and validate it.
+     * @param path Path of the file.
+     * @throws std::runtime_error If the file cannot be read, is truncated or its header is not valid.
+     */
+    explicit FrameReader(const std::string &path);
+
+    /**
+     * @brief Open a headerless file of consecutive frames.
+     * @param path Path of the file.
+     * @param width Width of the frames.
+     * @param height Height of the frames.
+     * @param type Type of the pixels.
+     * @throws std::runtime_error If the file cannot be read or does not contain a complete frame.
+     */
+    FrameReader(const std::string &path, uint32_t width, uint32_t height, PixelType type = PixelType::Float32);
+
+    ~FrameReader();
+    FrameReader(FrameReader &&other) noexcept;
+    FrameReader &operator=(FrameReader &&other) noexcept;
+    FrameReader(const FrameReader &) = delete;
+    FrameReader &operator=(const FrameReader &) = delete;
+
+    const std::string &path() const { return filePath; }
+    Layout layout() const { return fileLayout; }
+    uint16_t version() const { return fileVersion; }
+    uint32_t width() const { return frameWidth; }
+    uint32_t height() const { return frameHeight; }
+    uint32_t channels() const { return frameChannels; }
+    PixelType pixelType() const { return type; }
+    size_t frameCount() const { return offsets.size(); }
+    size_t frameBytes() const { return bytesPerFrame; }
+    uint64_t frameOffset(size_t index) const { return offsets.at(index); }
+    bool hasChecksums() const { return !checksums.empty(); }
+
+    /**
+     * @brief Read a frame (the file is reopened if it was released).
+     * @param index Index of the frame.
+     * @param dst Destination, at least frameBytes() bytes.
+     * @param verify Check the CRC-32 of the frame, if the container has checksums.
+     */
+    void readFrame(size_t index, void *dst, bool verify = false);
+
+    /**
+     * @brief Read a rectangle of a frame (the file is reopened if it was released).
+     * @param index Index of the frame.
+     * @param x Left column of the rectangle.
+     * @param y Top row of the rectangle.
+     * @param width Columns of the rectangle.
+     * @param height Rows of the rectangle.
+     * @param dst Destination of the first row.
+     * @param dstPitch Bytes between the rows in dst.
+     */
+    void readRegion(size_t index, uint32_t x, uint32_t y, uint32_t width, uint32_t height, void *dst, size_t dstPitch);
+
+    /**
+     * @brief Check the CRC-32 of a frame already in memory (no-op if the container has no checksums).
+     * @throws std::runtime_error If the checksum does not match.
+     */
+    void verifyFrame(size_t index, const void *data) const;
+
+    /**
+     * @brief Get the descriptor of the file, to read the frames asynchronously (the file is reopened if it was released).
+     */
+    int descriptor();
+
+    /**
+     * @brief Get a descriptor of the file opened with O_DIRECT (the reads bypass the page cache).
+     * @return The descriptor, or -1 if the file system does not support O_DIRECT.
+     */
+    int directDescriptor();
+
+    /**
+     * @brief Close the file descriptors (readFrame reopens the file when needed).
+     */
+    void release();
+
+  private:
+    std::string filePath;
+    int fd = -1;
+    int directFd = -1;
+    bool directUnsupported = false;
+    uint64_t fileSize = 0;
+    Layout fileLayout = Layout::Container;
+    uint16_t fileVersion = 0;
+    uint32_t frameWidth = 0;
+    uint32_t frameHeight = 0;
+    uint32_t frameChannels = 1;
+    PixelType type = PixelType::Float32;
+    size_t bytesPerFrame = 0;
+    std::vector<uint64_t> offsets;
+    std::vector<uint32_t> checksums;
+
+    void open();
+    void readAt(void *dst, size_t size, uint64_t offset);
+    void parseContainer();
+    void parseLegacy();
+    void checkFrames();
+};
+
+/**
+ * @brief Writer of frame containers. The frames are streamed to the file and the tables are written by close().
+ */
+class FrameWriter {
+  public:
+    /**
+     * @brief Create (or truncate) a container.
+     * @param alignment Alignment of the offset of each frame in the file (1: no padding between frames).
+     * @throws std::runtime_error If the file cannot be created.
+     */
+    FrameWriter(const std::string &path, uint32_t width, uint32_t height, uint32_t channels = 1, PixelType type = PixelType::Float32, bool checksums = true,
+                size_t alignment = FRAME_ALIGNMENT);
+    ~FrameWriter();
+    FrameWriter(const FrameWriter &) = delete;
+    FrameWriter &operator=(const FrameWriter &) = delete;
+
+    /**
+     * @brief Append a frame of width*height*channels pixels.
+     */
+    void writeFrame(const void *data);
+
+    /**
+     * @brief Write the tables and the final header and close the file.
+     */
+    void close();
+
+  private:
+    std::string filePath;
+    int fd = -1;
+    uint32_t frameWidth;
+    uint32_t frameHeight;
+    uint32_t frameChannels;
+    PixelType type;
+    bool withChecksums;
+    size_t frameAlignment;
+    size_t bytesPerFrame;
+    uint64_t position = HEADER_SIZE;
+    std::vector<uint64_t> offsets;
+    std::vector<uint32_t> checksums;
+
+    void writeAt(const void *src, size_t size, uint64_t offset);
+};
+} // namespace FrameContainer
+
+#endif // FRAME_CONTAINER_HPP
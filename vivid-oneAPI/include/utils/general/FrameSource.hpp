@@ -0,0 +1,308 @@
+/**
+ * @file FrameSource.hpp
+ * @brief Multi-frame input of the pipeline (--input): frames read by a dedicated I/O thread into a prefetch ring.
+ *
+ * Supported inputs:
+ *  - A .bin frame container (see FrameContainer.hpp) with any number of frames.
+ *  - A directory: its .bin files in lexicographic order (all with the same dimensions).
+ *  - Any other file is taken as raw video (no header), its dimensions are given with --input-size and its
+ *    pixel type with --input-format.
+ *  - shm:NAME: frames published by another process in a shared memory ring (see SharedFrameRing.hpp).
+ *
+ * The pixels may be float32, uint8 or uint16 (the same type in all the files). The ring keeps them with their
+ * native type, stage 1 widens them to float.
+ *
+ * Containers with checksums are verified the first time each frame is read.
+ *
+ * The I/O thread keeps several frames being read at the same time (--io-depth) through an AsyncReader
+ * (io_uring, pread threads or synchronous pread, --io-backend). With --direct the whole blocks of each frame
+ * are read with O_DIRECT straight into the (page aligned) ring buffers, so streaming a long sequence does not
+ * evict the data of the kernels from the caches; the rest of the frame goes through the page cache.
+ *
+ * The frames are streamed in a loop, so the number of frames to process is not limited by the length of the input.
+ *
+ * A shared memory input is consumed in order and is not looped. When the devices can read host memory the items
+ * take the frames straight from the slots of the shared ring (zero copy) and give each slot back to the producer
+ * when they are released; otherwise the I/O thread copies each frame into the (USM) prefetch ring and gives the
+ * shared slot back at once.
+ *
+ * With --tile the frames of a file input are never read whole: each frame is split into overlapping tiles (see
+ * TileGrid.hpp) and the I/O thread reads every tile, row by row, into a slot of the ring sized to a tile. The items
+ * take one tile each (item->tile), so the pipeline only holds ring-size tiles of the frames in memory.
+ *
+ * A pushed input (libvivid, see vivid.h) has no I/O thread: the application copies each frame into a free slot of the
+ * ring with push() and ends the stream with close(). The pipeline stops once every pushed frame has been processed.
+ */
+#pragma once
+#ifndef FRAME_SOURCE_HPP
+#define FRAME_SOURCE_HPP
+
+#include "AsyncReader.hpp"
+#include "FrameContainer.hpp"
+#include "GlobalParameters.hpp"
+#include "SharedFrameRing.hpp"
+#include "TileGrid.hpp"
+#include "pipeline_template.hpp"
+#include <condition_variable>
+#include <cstddef>
+#include <exception>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <tbb/tick_count.h>
+#include <vector>
+
+using namespace Pipeline_template;
+
+/**
+ * @brief Configuration of the reads of the I/O thread.
+ */
+struct FrameSourceIO {
+    IOBackend backend = IOBackend::Auto; ///< Backend of the reads.
+    size_t depth = DEFAULT_IO_DEPTH;     ///< Number of frames being read at the same time.
+    bool direct = false;                 ///< Read the frames with O_DIRECT (bypassing the page cache) when they are aligned.
+    bool zeroCopy = false;               ///< Shared memory input: the items read the frames in the shared ring instead of copies.
+};
+
+/**
+ * @brief Ingest statistics of the frame source.
+ */
+struct FrameSourceStats {
+    size_t framesRead = 0;      ///< Frames read from storage.
+    size_t loops = 0;           ///< Times the input has been restarted from the first frame.
+    double readTimeAvg = 0.0;   ///< Mean time from the submission of the read of a frame to its completion (ms).
+    double readTimeMax = 0.0;   ///< Maximum time from the submission of the read of a frame to its completion (ms).
+    double bandwidth = 0.0;     ///< Read bandwidth while there were reads in flight (MB/s).
+    size_t stalls = 0;          ///< Frames the input node had to wait for.
+    double stallTime = 0.0;     ///< Total time the input node waited for frames (ms).
+    IOBackend backend = IOBackend::Auto; ///< Backend used for the reads.
+    size_t ioDepth = 0;         ///< Number of frames read at the same time.
+    size_t directFrames = 0;    ///< Frames read with O_DIRECT.
+    bool sharedMemory = false;  ///< The input is a shared memory ring.
+    bool zeroCopy = false;      ///< The items read the frames in the shared ring.
+    bool pushed = false;        ///< The frames are pushed by the application.
+    size_t pushWaits = 0;       ///< Pushes that had to wait for a free slot of the ring.
+    double pushWaitTime = 0.0;  ///< Total time the pushes waited for a free slot (ms).
+    size_t tiles = 0;           ///< Tiles per frame (--tile, 0: whole frames); framesRead counts tiles.
+    double tileOverhead = 0.0;  ///< Fraction of the pixels of the tiles read more than once or outside the frame.
+};
+
+class FrameSource {
+  public:
+    /**
+     * @brief Open the input and index its frames.
+     * @param path File or directory with the frames.
+     * @param rawHeight Height of the frames of a raw file (ignored for .bin inputs).
+     * @param rawWidth Width of the frames of a raw file (ignored for .bin inputs).
+     * @param rawType Type of the pixels of a raw file (ignored for .bin inputs).
+     * @throws std::invalid_argument If the input does not exist, is empty or its frames have different dimensions or pixel types.
+     */
+    FrameSource(const std::string &path, int rawHeight = 0, int rawWidth = 0, PixelType rawType = PixelType::Float32);
+
+    /**
+     * @brief Create an input whose frames are pushed by the application (see push()).
+     * @param height Height of the frames.
+     * @param width Width of the frames.
+     * @param type Type of the pixels.
+     * @throws std::invalid_argument If the frames are empty.
+     */
+    FrameSource(int height, int width, PixelType type);
+    ~FrameSource();
+
+    FrameSource(const FrameSource &) = delete;
+    FrameSource &operator=(const FrameSource &) = delete;
+
+    /// Dimensions of the frames given to the items (the tiles with --tile)
+    int height() const { return tileGrid ? tileGrid->tileHeight() : frameHeight; }
+    int width() const { return tileGrid ? tileGrid->tileWidth() : frameWidth; }
+    /// Dimensions of the frames of the input
+    int inputHeight() const { return frameHeight; }
+    int inputWidth() const { return frameWidth; }
+    PixelType pixelType() const { return framePixelType; }
+    size_t numFrames() const { return frames.size(); }
+    /// Frame buffers the items take their frames from, numbered by ViVidItem::frameSlot (once started)
+    size_t ringSize() const { return slots.size(); }
+    const TileGrid *tiles() const { return tileGrid.get(); }
+
+    /**
+     * @brief Split every frame into tiles (must be called before readFrame() and start()).
+     * @param grid Tiles of a frame of the input.
+     * @throws std::invalid_argument If the input is a shared memory ring or pushed (only files can be read by tiles).
+     */
+    void setTiles(const TileGrid &grid);
+
+    /**
+     * @brief Read a frame synchronously (used to fill the global frame before the pipeline starts).
+     * @param index Index of the frame in the input (a shared memory input copies its oldest frame without consuming it,
+     *              a tiled input reads the first tile of the frame).
+     * @param dst Destination buffer (same dimensions and pixel type as the input).
+     */
+    void readFrame(size_t index, FrameBuffer *dst);
+
+    /**
+     * @brief Allocate the prefetch ring and start the I/O thread.
+     * @param Q Queue used for the USM allocation of the ring.
+     * @param usage Accounting of the USM of the ring (the one of the pipeline).
+     * @param numSlots Number of frame buffers in the ring (frames held by the items plus frames read ahead).
+     * @param idleFrame Frame assigned to the items while they do not hold a slot of the ring.
+     * @param io Backend, queue depth and O_DIRECT use of the reads (zero copy for a shared memory input).
+     * @throws std::runtime_error If the backend is not available (e.g. io_uring forced but disabled by the kernel).
+     */
+    void start(sycl::queue &Q, USMUsage &usage, size_t numSlots, FrameBuffer *idleFrame, const FrameSourceIO &io = {});
+
+    /**
+     * @brief Stop the I/O thread (the ring is kept until the source is destroyed).
+     */
+    void stop();
+
+    /**
+     * @brief Pushed input: copy a frame into the next free slot of the ring.
+     * @param pixels Pixels of the frame (height rows of width pixels, without padding).
+     * @param timeoutMs Maximum time to wait for a free slot (negative: no limit).
+     * @return Number of the frame in the input (from 1, the item_id of the item that takes it), or 0 if no slot was
+     *         freed before the timeout.
+     * @throws std::logic_error If the input is not pushed, or it has been closed or stopped.
+     */
+    size_t push(const void *pixels, int timeoutMs = -1);
+
+    /**
+     * @brief Pushed input: no more frames will be pushed, the pipeline stops after the last one.
+     */
+    void close();
+
+    /**
+     * @brief Reserve the next frame of the input for the input node (must be called before acquire()).
+     *
+     * Inputs read from storage or shared memory always have a next frame. A pushed input waits until the frame has
+     * been pushed, so the pipeline can stop cleanly when the stream ends.
+     *
+     * @return false if the input has been closed (or stopped) and all its frames have already been reserved.
+     */
+    bool reserveFrame();
+
+    /**
+     * @brief Give the next frame of the input to an item, waiting for the I/O thread if it is not ready yet.
+     * @param item Item that takes the frame (item->frame and item->frameSlot are set, and item->item_id for a pushed input).
+     * @throws std::runtime_error If the I/O thread failed to read a frame or the producer of a shared memory input has finished.
+     */
+    void acquire(ViVidItem *item);
+
+    /**
+     * @brief Return the frame held by an item to the ring (no-op if the item holds no frame).
+     * @param item Item that releases its frame.
+     */
+    void release(ViVidItem *item);
+
+    /**
+     * @brief Check whether an item holds the pixels read by readFrame(0) (the global frame and its golden output).
+     * @param item Item that holds a frame of the input.
+     * @return true for every repetition of the first frame of a file (its first tile with --tile); always false for a
+     *         shared memory or pushed input, whose frames do not repeat.
+     */
+    bool holdsFirstFrame(const ViVidItem *item) const;
+
+    /**
+     * @brief Get a snapshot of the ingest statistics.
+     */
+    FrameSourceStats getStats();
+
+  private:
+    struct FrameLocation {
+        size_t file;  //< Index of the file in files
+        size_t index; //< Index of the frame in the file
+    };
+
+    /**
+     * @brief Small fixed-capacity FIFO of slot indices (no allocations once created).
+     */
+    struct SlotQueue {
+        std::vector<int> slots;
+        size_t head = 0;
+        size_t count = 0;
+        void init(size_t capacity) {
+            slots.assign(capacity, -1);
+            head = count = 0;
+        }
+        void push(int slot) {
+            slots[(head + count++) % slots.size()] = slot;
+        }
+        int pop() {
+            int slot = slots[head];
+            head = (head + 1) % slots.size();
+            --count;
+            return slot;
+        }
+        int front() const {
+            return slots[head];
+        }
+    };
+
+    int frameHeight = 0;
+    int frameWidth = 0;
+    PixelType framePixelType = PixelType::Float32;
+    size_t frameBytes = 0;
+    std::vector<FrameContainer::FrameReader> files;
+    std::vector<FrameLocation> frames;
+    size_t openFile = 0; //< Only the file being read keeps its descriptor open
+
+    // Prefetch ring
+    std::vector<FrameBuffer *> slots;
+    FrameBuffer *idleFrame = nullptr;
+    SlotQueue freeSlots;
+    SlotQueue readySlots;
+    std::mutex ringMutex;
+    std::condition_variable slotFreed;
+    std::condition_variable frameReady;
+    bool stopping = false;
+    std::exception_ptr ioError;
+    std::thread ioThread;
+
+    // Reads in flight (only used by the I/O thread)
+    FrameSourceIO ioConfig;
+    std::unique_ptr<AsyncReader> reader;
+    SlotQueue readingSlots;                  //< Slots being read, in input order
+    std::vector<int> pendingReads;           //< Outstanding reads of each slot
+    std::vector<size_t> slotFrame;           //< Index in frames of the frame read into each slot
+    std::vector<size_t> slotTile;            //< Tile read into each slot (--tile)
+    std::vector<size_t> slotFrameNumber;     //< Number of the frame (from 1) of the tile read into each slot (--tile)
+    std::vector<char> slotVerify;            //< Verify the checksum of the frame when its read completes
+    std::vector<tbb::tick_count> submitTime; //< Time when the read of each slot was submitted
+    size_t readsInFlight = 0;
+    tbb::tick_count busyStart;
+
+    // Statistics (readTime, busyTime and stall counters are protected by ringMutex)
+    size_t nextFrame = 0;
+    size_t nextTile = 0;      //< Next tile of nextFrame (--tile)
+    size_t framesStarted = 0; //< Frames whose first tile has been submitted (--tile)
+    FrameSourceStats stats;
+    double readTimeTotal = 0.0;
+    double busyTime = 0.0; //< Time with reads in flight (ms)
+
+    void addFile(const std::string &path, int rawHeight, int rawWidth, PixelType rawType);
+    void readInto(const FrameLocation &location, FrameBuffer *dst, bool verify);
+    void ioLoop();
+    // Shared memory input (shm:NAME)
+    std::unique_ptr<SharedFrameRing::Consumer> shm;
+    uint32_t shmNext = 0;      //< Next frame of the shared ring to take (zero copy: protected by shmTakeMutex)
+    std::mutex shmTakeMutex;   //< Zero copy: serializes the input nodes that take frames from the shared ring
+    uint32_t shmReleased = 0;  //< First frame of the shared ring not given back to the producer
+    std::vector<char> shmDone; //< Zero copy: the item holding the frame in each slot has been released
+
+    // Pushed input
+    bool pushMode = false;     //< The frames are pushed by the application
+    bool pushClosed = false;   //< close() has been called (protected by ringMutex)
+    size_t framesReserved = 0; //< Frames reserved by the input node (protected by ringMutex)
+
+    // Tiled input (--tile)
+    std::unique_ptr<TileGrid> tileGrid;
+
+    void submitFrame(int slot);
+    void submitTile(int slot);
+    void completeRead();
+    void drainReads();
+    bool waitShmFrame(uint32_t index, bool countStall);
+    void shmLoop();
+};
+
+#endif // FRAME_SOURCE_HPP
@@ -0,0 +1,84 @@
+/**
+ * @file GPUCompletion.hpp
+ * @brief Completion thread of the GPU stages: the workers submit the kernels and never wait for them.
+ *
+ * A GPU stage used to wait for its kernel on the thread that submitted it, so a worker slept for the whole device
+ * execution and --threads had to be oversubscribed to keep the CPU path busy. Now the stage submits its kernel and
+ * hands the event to this thread, which waits for the events and runs the completion of each stage once its kernel
+ * has finished:
+ *  - --api pipeline suspends the task of the stage (tbb::task::suspend) and the completion resumes it (await).
+ *  - --api fgan completes the async node through its gateway (notify with the completion of the node).
+ *  - --api coro suspends the coroutine of the stage and the completion schedules it on the executor (notify).
+ * While the GPU runs, the worker takes other items of the CPU path. Handing over a stage costs a lock and a push on a
+ * vector that keeps its capacity, nothing is allocated per item.
+ *
+ * The events are waited for in submission order, but every kernel that has finished by then is completed, so a short
+ * kernel is not held behind a long one for longer than the wait of the oldest.
+ */
+#pragma once
+#ifndef GPU_COMPLETION_HPP
+#define GPU_COMPLETION_HPP
+
+#include <condition_variable>
+#include <cstddef>
+#include <mutex>
+#include <oneapi/tbb/task.h>
+#include <sycl/sycl.hpp>
+#include <thread>
+#include <vector>
+
+class GPUCompletion {
+  public:
+    /**
+     * @brief Completion of a stage, run by the completion thread once the event has completed.
+     */
+    using Callback = void (*)(void *context, void *arg, const sycl::event &event);
+
+    /**
+     * @brief Start the completion thread.
+     */
+    GPUCompletion();
+
+    /**
+     * @brief Stop the completion thread after completing the pending stages.
+     */
+    ~GPUCompletion();
+
+    GPUCompletion(const GPUCompletion &) = delete;
+    GPUCompletion &operator=(const GPUCompletion &) = delete;
+
+    /**
+     * @brief Suspend the calling TBB task until the event has completed. Must be called from a TBB task.
+     * @throws sycl::exception If the command of the event failed.
+     */
+    void await(sycl::event &event);
+
+    /**
+     * @brief Run done(context, arg, event) on the completion thread once the event has completed (also if it failed).
+     */
+    void notify(const sycl::event &event, Callback done, void *context, void *arg);
+
+    /**
+     * @brief Number of stages whose kernel was waited for by the completion thread.
+     */
+    size_t getCompleted();
+
+  private:
+    struct Pending {
+        sycl::event event;
+        Callback done;
+        void *context;
+        void *arg;
+    };
+
+    std::vector<Pending> pending; //< Submitted by the workers, taken by the completion thread
+    std::mutex mutex;
+    std::condition_variable ready;
+    bool stopping = false;
+    size_t completed = 0;
+    std::thread completion;
+
+    void completionLoop();
+};
+
+#endif // GPU_COMPLETION_HPP
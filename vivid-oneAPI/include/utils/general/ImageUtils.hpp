@@ -1,26 +1,67 @@
 #ifndef IMAGE_UTILS_HPP
 #define IMAGE_UTILS_HPP
 
-#include <fstream>
-#include <memory>
+#include "FrameContainer.hpp"
+#include <cstddef>
 #include <string>
-#include <vector>
 
+/**
+ * @brief Loader of the input image (.bin frame containers in the media folder, see FrameContainer.hpp).
+ *
+ * The file is memory-mapped (read only) instead of being read into intermediate buffers, so the
+ * pixels are copied exactly once, straight from the page cache into the destination (USM) buffer.
+ * The mapping is kept until release() is called or the object is destroyed.
+ */
 class Image {
   public:
     Image();
-    ~Image() = default;
+    ~Image();
+
+    Image(const Image &) = delete;
+    Image &operator=(const Image &) = delete;
+
+    /**
+     * @brief Map the example image for the given resolution and read its dimensions.
+     * @param quality Image resolution (see convertImageTypeToString).
+     * @param height Output: height of the image.
+     * @param width Output: width of the image.
+     * @throws std::runtime_error If the file cannot be opened/mapped, it is truncated, its checksum does not match or it is not a single channel image.
+     */
+    void loadImageData(int quality, int &height, int &width);
+
+    /**
+     * @brief Get a pointer to the pixels of the image (inside the mapping).
+     * @return Pointer to height*width pixels of type getPixelType(), or nullptr if no image is mapped.
+     */
+    const void *getImageData() const;
+
+    /**
+     * @brief Get the type of the pixels of the image (float32, uint8 or uint16).
+     */
+    FrameContainer::PixelType getPixelType() const;
+
+    /**
+     * @brief Get the size in bytes of the pixels of the image.
+     */
+    size_t getImageSize() const;
+
+    /**
+     * @brief Unmap the image once its pixels have been copied to the device buffers.
+     */
+    void release();
 
-    std::ifstream openImageFile(const std::string &imagePath);
-    std::unique_ptr<float[]> readImageData(std::ifstream &fbin, int &height, int &width);
-    void readImageDimensions(std::ifstream &fbin, int &height, int &width);
     std::string getExampleImagePath(int quality);
-    std::unique_ptr<float[]> loadImageData(int quality, int &height, int &width);
-    const std::unique_ptr<float[]> &getImageData() const;
     const std::string convertImageTypeToString(int type) const;
 
   private:
-    std::unique_ptr<float[]> imageData;
+    int fd = -1;                      // File descriptor of the mapped file
+    void *mapping = nullptr;          // Start of the mapping
+    size_t mappingSize = 0;           // Size of the mapping (whole file)
+    const void *imageData = nullptr;  // Pixels of the image (inside the mapping)
+    size_t imageSize = 0;             // Size of the pixels in bytes
+    FrameContainer::PixelType pixelType = FrameContainer::PixelType::Float32; // Type of the pixels
+
+    void mapImageFile(const std::string &imagePath);
 };
 
-#endif // IMAGE_UTILS_HPP
\ No newline at end of file
+#endif // IMAGE_UTILS_HPP
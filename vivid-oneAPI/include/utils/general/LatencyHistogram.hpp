@@ -0,0 +1,110 @@
+/**
+ * @file LatencyHistogram.hpp
+ * @brief Lock-free histogram of latencies with logarithmic buckets, used for the latency percentiles of the results.
+ *
+ * Each power of two (in microseconds) is split in SUB_BUCKETS buckets, so a percentile is known with an error
+ * below 2^(1/SUB_BUCKETS) (~9%). Recording a value is a few relaxed atomic operations and never allocates, so
+ * the histogram can be updated from the output nodes of any backend.
+ */
+#pragma once
+#ifndef LATENCY_HISTOGRAM_HPP
+#define LATENCY_HISTOGRAM_HPP
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+
+/**
+ * @brief Summary of a latency distribution (ms).
+ */
+struct LatencySummary {
+    size_t count = 0; ///< Number of values.
+    double avg = 0.0; ///< Mean.
+    double p50 = 0.0; ///< Median.
+    double p90 = 0.0; ///< 90th percentile.
+    double p99 = 0.0; ///< 99th percentile.
+    double max = 0.0; ///< Maximum.
+};
+
+class LatencyHistogram {
+  public:
+    static constexpr int SUB_BUCKETS = 8;                       ///< Buckets per power of two.
+    static constexpr int OCTAVES = 32;                          ///< Powers of two covered (up to 2^32 us, ~71 min).
+    static constexpr size_t NUM_BUCKETS = SUB_BUCKETS * OCTAVES + 1;
+
+    /**
+     * @brief Add a value.
+     * @param ms Latency in milliseconds (negative values are counted as 0).
+     */
+    void record(double ms) noexcept {
+        double us = std::max(ms, 0.0) * 1000.0;
+        buckets[bucketOf(us)].fetch_add(1, std::memory_order_relaxed);
+        count.fetch_add(1, std::memory_order_relaxed);
+        sum.fetch_add(us, std::memory_order_relaxed);
+        double prev = maxValue.load(std::memory_order_relaxed);
+        while (us > prev && !maxValue.compare_exchange_weak(prev, us, std::memory_order_relaxed)) {
+        }
+    }
+
+    /**
+     * @brief Get the value below which a fraction of the values fall (upper bound of its bucket, in ms).
+     * @param fraction Fraction of the values (0.5 for the median).
+     */
+    double percentile(double fraction) const noexcept {
+        uint64_t total = count.load(std::memory_order_relaxed);
+        if (total == 0) {
+            return 0.0;
+        }
+        uint64_t rank = static_cast<uint64_t>(std::ceil(fraction * static_cast<double>(total)));
+        rank = std::clamp<uint64_t>(rank, 1, total);
+        uint64_t seen = 0;
+        for (size_t i = 0; i < NUM_BUCKETS; ++i) {
+            seen += buckets[i].load(std::memory_order_relaxed);
+            if (seen >= rank) {
+                return std::min(upperBound(i), maxValue.load(std::memory_order_relaxed)) / 1000.0;
+            }
+        }
+        return maxValue.load(std::memory_order_relaxed) / 1000.0;
+    }
+
+    /**
+     * @brief Get the count, mean, percentiles and maximum of the values.
+     */
+    LatencySummary summary() const noexcept {
+        LatencySummary s;
+        s.count = count.load(std::memory_order_relaxed);
+        if (s.count == 0) {
+            return s;
+        }
+        s.avg = sum.load(std::memory_order_relaxed) / static_cast<double>(s.count) / 1000.0;
+        s.p50 = percentile(0.50);
+        s.p90 = percentile(0.90);
+        s.p99 = percentile(0.99);
+        s.max = maxValue.load(std::memory_order_relaxed) / 1000.0;
+        return s;
+    }
+
+  private:
+    std::array<std::atomic<uint64_t>, NUM_BUCKETS> buckets = {};
+    std::atomic<uint64_t> count{0};
+    std::atomic<double> sum{0.0};      //< Sum of the values (us)
+    std::atomic<double> maxValue{0.0}; //< Largest value (us)
+
+    // Bucket 0 holds [0, 1) us, bucket i > 0 holds [2^((i-1)/SUB), 2^(i/SUB)) us
+    static size_t bucketOf(double us) noexcept {
+        if (us < 1.0) {
+            return 0;
+        }
+        size_t index = static_cast<size_t>(std::log2(us) * SUB_BUCKETS) + 1;
+        return std::min(index, NUM_BUCKETS - 1);
+    }
+
+    static double upperBound(size_t bucket) noexcept {
+        return std::exp2(static_cast<double>(bucket) / SUB_BUCKETS);
+    }
+};
+
+#endif // LATENCY_HISTOGRAM_HPP
@@ -0,0 +1,50 @@
+/**
+ * @file MemoryBudget.hpp
+ * @brief Sizing of the number of tokens and of the item pool to a RAM/USM memory budget (--mem-budget).
+ */
+#pragma once
+#ifndef MEMORY_BUDGET_HPP
+#define MEMORY_BUDGET_HPP
+
+#include "ApplicationData.hpp"
+#include "InputArgs.hpp"
+#include <cstddef>
+#include <string>
+
+namespace MemoryBudget {
+/**
+ * @brief Compute the memory shared by all the items (global frame, filter bank and classification coefficients).
+ * @param appData Application data (image dimensions and constants).
+ * @return Size in bytes.
+ */
+size_t globalFootprint(const ApplicationData &appData);
+
+/**
+ * @brief Compute the memory needed by one item of the pool (USM buffers plus the host side object).
+ * @param appData Application data (image dimensions and constants).
+ * @return Size in bytes.
+ */
+size_t itemFootprint(const ApplicationData &appData);
+
+/**
+ * @brief Adjust the number of tokens (in-flight frames) and the size of the item pool so that they fit in the budget.
+ *
+ * It sets inputArgs.maxTokens, which is also used by the optimizer (AUTO mode) to bound its choice of tokens.
+ * Does nothing if no budget has been set.
+ *
+ * @param appData Application data (image dimensions and constants).
+ * @param inputArgs Input arguments (memBudget, inFlightFrames and sizeCircularBuffer are read and updated).
+ * @throws std::invalid_argument If the budget cannot hold even a single item.
+ */
+void apply(const ApplicationData &appData, InputArgs &inputArgs);
+
+/**
+ * @brief Parse a size such as "512M", "8G", "1.5G", "4096K" or "1048576" (bytes).
+ * @param str String to parse.
+ * @return Size in bytes.
+ * @throws std::invalid_argument If the format is not valid.
+ */
+size_t parseSize(const std::string &str);
+} // namespace MemoryBudget
+
+#endif // MEMORY_BUDGET_HPP
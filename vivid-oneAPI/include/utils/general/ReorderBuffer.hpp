@@ -0,0 +1,142 @@
+/**
+ * @file ReorderBuffer.hpp
+ * @brief Reorder buffer of the output (--reorder): the frames are delivered strictly in the order of their ids.
+ *
+ * Most backends release the frames in the order they finish, so the result sink (and the callback of libvivid) see
+ * a frame before an older one that is still in flight. With --reorder the output stage (PipelineRuntime) hands every
+ * finished item to this buffer instead: a frame whose id is the next one is delivered at once, together with the run
+ * of younger frames it was holding back; any other frame is held in a window indexed by its id until the gap before it
+ * closes.
+ *
+ * The held frames keep their item, so the window is bounded by the item pool: with the default window (the capacity
+ * of the pool) it can never overflow, and when every item is held the input node waits for the missing frame like
+ * for any other item. The gap policy (--reorder-gap) decides what happens when a frame is late:
+ *  - wait: the frames behind it wait for as long as it takes (the output is never out of order, nothing is lost).
+ *  - skip: once the oldest held frame has waited --reorder-timeout, or a frame does not fit in --reorder-window,
+ *    the missing frames are skipped and the held ones delivered. A skipped frame that arrives afterwards is released
+ *    without reaching the result sink.
+ *
+ * Nothing blocks in the buffer (the output nodes are serial, a thread waiting there for the missing frame would keep
+ * it from arriving): the timeout is checked when the frames arrive, and flush() delivers what is left at the end of
+ * the run. The frames are delivered by one thread at a time, outside the lock.
+ *
+ * Metrics: reorder depth (frames held when a frame arrives, mean and peak) and head-of-line blocking (frames that
+ * waited for an older one and the time they waited).
+ */
+#pragma once
+#ifndef REORDER_BUFFER_HPP
+#define REORDER_BUFFER_HPP
+
+#include "GlobalParameters.hpp"
+#include "pipeline_template.hpp"
+#include <chrono>
+#include <cstddef>
+#include <mutex>
+#include <string>
+#include <vector>
+
+using namespace Pipeline_template;
+
+/**
+ * @brief What the reorder buffer does with a frame that is late.
+ */
+enum class ReorderGap {
+    Wait, ///< Hold the younger frames until it arrives.
+    Skip  ///< Skip it after --reorder-timeout, or when the window is full.
+};
+
+/**
+ * @brief Configuration of the reorder buffer.
+ */
+struct ReorderConfig {
+    size_t window = 0;                        ///< Frames that can be held (0: the capacity of the item pool).
+    ReorderGap gap = ReorderGap::Wait;        ///< Policy for the late frames.
+    double timeout = DEFAULT_REORDER_TIMEOUT; ///< Time the oldest held frame waits before the gap is skipped (ms, ReorderGap::Skip).
+};
+
+/**
+ * @brief Statistics of the reorder buffer.
+ */
+struct ReorderStats {
+    size_t window = 0;           ///< Frames that can be held.
+    size_t delivered = 0;        ///< Frames delivered in order.
+    size_t heldFrames = 0;       ///< Frames that arrived before an older one and were held.
+    size_t peakDepth = 0;        ///< Maximum number of frames held at the same time.
+    double meanDepth = 0.0;      ///< Mean number of frames held when a frame arrives.
+    double blockedTime = 0.0;    ///< Total time the held frames waited for the older ones (ms, head-of-line blocking).
+    double blockedTimeMax = 0.0; ///< Longest time a frame was held (ms).
+    size_t skipped = 0;          ///< Frames skipped because they were late (ReorderGap::Skip, or missing at the end).
+    size_t lateFrames = 0;       ///< Skipped frames that arrived afterwards (released without output).
+};
+
+class ReorderBuffer {
+  public:
+    using Clock = std::chrono::steady_clock;
+
+    /**
+     * @brief Receives the frames (the rest of the output stage of the item).
+     * @param inOrder false for a skipped frame that arrived after the younger ones were delivered.
+     */
+    using Deliver = void (*)(void *context, ViVidItem *item, bool inOrder);
+
+    /**
+     * @param config Window and gap policy.
+     * @param poolCapacity Items of the pool (the default window, and the maximum).
+     * @param firstId Id of the first frame.
+     * @throws std::invalid_argument If the pool is empty or the timeout is negative.
+     */
+    ReorderBuffer(const ReorderConfig &config, size_t poolCapacity, size_t firstId = 1);
+
+    ReorderBuffer(const ReorderBuffer &) = delete;
+    ReorderBuffer &operator=(const ReorderBuffer &) = delete;
+
+    /**
+     * @brief Hand over a finished item (from any thread): it is delivered now, with the frames it was holding back,
+     * or held until the older ones arrive.
+     */
+    void push(ViVidItem *item, Deliver deliver, void *context);
+
+    /**
+     * @brief Deliver the held frames, skipping the missing ones (at the end of the run, or after a failure).
+     */
+    void flush(Deliver deliver, void *context);
+
+    /**
+     * @brief Get a snapshot of the statistics.
+     */
+    ReorderStats getStats();
+
+    /**
+     * @brief Description of the buffer for the console.
+     */
+    std::string describe() const;
+
+  private:
+    struct Slot {
+        ViVidItem *item = nullptr;
+        Clock::time_point arrival; //< When the frame was held
+        bool held = false;         //< It arrived before an older frame
+    };
+
+    std::mutex mutex;
+    ReorderGap gap;
+    Clock::duration timeout;
+    std::vector<Slot> slots;         //< Ring of the window, indexed by id % size
+    size_t next;                     //< Id of the next frame to deliver
+    size_t held = 0;                 //< Frames in the window
+    Clock::time_point blockedSince;  //< Arrival of the oldest frame held behind the current gap
+    std::vector<ViVidItem *> ready;  //< Frames to deliver, in order
+    std::vector<ViVidItem *> batch;  //< Frames being delivered (swapped with ready)
+    bool delivering = false;         //< A thread is delivering the ready frames
+
+    // Statistics (protected by mutex)
+    size_t arrivals = 0;
+    size_t depthSum = 0;
+    ReorderStats stats;
+
+    void take(size_t id, Clock::time_point now);
+    void skipGap(Clock::time_point now);
+    void drain(std::unique_lock<std::mutex> &lock, Deliver deliver, void *context);
+};
+
+#endif // REORDER_BUFFER_HPP
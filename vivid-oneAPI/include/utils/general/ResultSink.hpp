@@ -0,0 +1,174 @@
+/**
+ * @file ResultSink.hpp
+ * @brief Asynchronous output of the detections of each frame (--sink): bounded queue plus a dedicated writer thread.
+ *
+ * The output of stage 3 holds, for every 8x8 cell of the frame, the distance of its block histogram to each class
+ * of the classifier. When an item is released, the sink reduces it to the best class of each window position
+ * (a single pass over the output, about 1% of the cost of stage 3) and keeps the --sink-topk positions with the
+ * smallest distance. That reduction is done in a preallocated slot of the queue; formatting and writing the
+ * records are left to the writer thread, so a slow disk does not throttle the output node.
+ *
+ * When the queue is full the frame either waits for a free slot (backpressure, default) or is dropped (--sink-drop).
+ *
+ * Formats:
+ *  - JSON lines: one object per frame, {"frame":N,"detections":[{"x":X,"y":Y,"class":C,"score":S},...]}.
+ *  - Binary: header {magic "VVDT", version, frame width, frame height, top-K} (uint32 each) followed by one record
+ *    per frame {frame id (uint64), count (uint32), count x {x, y, class (uint32), score (float32)}}, little endian.
+ *
+ * The score is the squared distance of the window to its class (smaller is a better match). Records are written
+ * in the order the frames leave the pipeline, which is not always the order of the frame ids (--reorder delivers
+ * them in the order of the ids, see ReorderBuffer.hpp).
+ *
+ * With --tile each item holds a tile of the frame and only reports the cells the tile owns (see TileGrid.hpp), with
+ * frame coordinates. The writer thread merges the detections of the tiles of each frame and writes the frame once
+ * all its tiles have arrived (tiles cannot be dropped, a frame would never be complete).
+ *
+ * Instead of a file, the writer thread can hand each frame to a callback (used by libvivid to deliver the results
+ * to the application); the callback may block, which applies backpressure like a slow disk.
+ */
+#pragma once
+#ifndef RESULT_SINK_HPP
+#define RESULT_SINK_HPP
+
+#include "GlobalParameters.hpp"
+#include "TileGrid.hpp"
+#include "pipeline_template.hpp"
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <exception>
+#include <functional>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+using namespace Pipeline_template;
+
+/**
+ * @brief A window position of a frame and its best class.
+ */
+struct Detection {
+    uint32_t x;   ///< Left column of the window (pixels).
+    uint32_t y;   ///< Top row of the window (pixels).
+    uint32_t cls; ///< Best class of the window.
+    float score;  ///< Squared distance to the class (smaller is better).
+};
+
+/**
+ * @brief Configuration of the result sink.
+ */
+struct ResultSinkConfig {
+    enum class Format {
+        JsonLines, //< One JSON object per line
+        Binary     //< Packed records (see ResultSink.hpp)
+    };
+
+    using Callback = std::function<void(uint64_t frameId, const Detection *detections, size_t count)>;
+
+    std::string path;                  ///< Output file (ignored when there is a callback).
+    Format format = Format::JsonLines; ///< Format of the records.
+    size_t depth = DEFAULT_SINK_DEPTH; ///< Frames that can wait for the writer thread.
+    size_t topK = DEFAULT_SINK_TOPK;   ///< Detections written per frame.
+    bool drop = false;                 ///< Drop the frames when the queue is full instead of waiting.
+    Callback callback;                 ///< Called by the writer thread with the detections of each frame instead of writing them.
+    const TileGrid *tiles = nullptr;   ///< Tiles of the frames (--tile): the detections of the tiles of a frame are stitched together.
+};
+
+/**
+ * @brief Backpressure statistics of the result sink.
+ */
+struct ResultSinkStats {
+    size_t framesWritten = 0;  ///< Frames written to the file (or delivered to the callback).
+    size_t framesDropped = 0;  ///< Frames dropped because the queue was full (--sink-drop).
+    size_t detections = 0;     ///< Detections written.
+    size_t bytesWritten = 0;   ///< Bytes written.
+    size_t blockedFrames = 0;  ///< Frames that had to wait for a free slot.
+    double blockedTime = 0.0;  ///< Total time the released items waited for a free slot (ms).
+    size_t depth = 0;          ///< Capacity of the queue.
+    size_t peakQueued = 0;     ///< Maximum number of frames in the queue.
+    double writeTimeAvg = 0.0; ///< Mean time to format and write a frame (ms).
+};
+
+class ResultSink {
+  public:
+    /**
+     * @brief Open the output file (unless there is a callback) and start the writer thread.
+     * @param config Output file or callback, format and queue.
+     * @param frameWidth Width of the frames (pixels, the whole frame with tiles).
+     * @param frameHeight Height of the frames (pixels, the whole frame with tiles).
+     * @throws std::invalid_argument If the depth or the number of detections per frame is 0, or tiles would be dropped.
+     * @throws std::runtime_error If the file cannot be created.
+     */
+    ResultSink(const ResultSinkConfig &config, int frameWidth, int frameHeight);
+    ~ResultSink();
+
+    ResultSink(const ResultSink &) = delete;
+    ResultSink &operator=(const ResultSink &) = delete;
+
+    /**
+     * @brief Queue the detections of a processed item (called before the item is recycled, from any thread).
+     */
+    void submit(ViVidItem *item);
+
+    /**
+     * @brief Write the queued frames, stop the writer thread and close the file.
+     * @throws std::runtime_error If a write failed.
+     */
+    void stop();
+
+    /**
+     * @brief Get a snapshot of the backpressure statistics.
+     */
+    ResultSinkStats getStats();
+
+  private:
+    struct Slot {
+        uint64_t frameId = 0;
+        size_t count = 0;
+        bool ready = false;
+        bool tile = false;                 //< The detections are those of a tile of the frame
+        std::vector<Detection> detections; //< Best topK windows (heap while the frame is reduced)
+        std::vector<float> best;           //< Smallest distance of each cell
+        std::vector<uint32_t> bestClass;   //< Class of the smallest distance of each cell
+    };
+
+    /**
+     * @brief Detections of the tiles of a frame received so far (only used by the writer thread).
+     */
+    struct PartialFrame {
+        uint64_t frameId = 0;
+        size_t tilesLeft = 0; //< 0: free
+        size_t count = 0;
+        std::vector<Detection> detections; //< Best topK windows of the tiles received (heap)
+    };
+
+    ResultSinkConfig config;
+    int cellsX;                     //< Cells per row of the output of stage 3
+    int cellsY;                     //< Rows of cells of the output of stage 3
+    std::vector<PartialFrame> partials; //< Frames waiting for some of their tiles (writer thread only)
+    FILE *file = nullptr;
+    std::string record; //< Encoding buffer of the writer thread
+
+    std::vector<Slot> slots;
+    size_t head = 0; //< Next frame to write
+    size_t tail = 0; //< Next slot to fill
+    std::mutex mutex;
+    std::condition_variable slotFree;
+    std::condition_variable slotReady;
+    bool stopping = false;
+    std::exception_ptr writeError;
+    std::thread writer;
+
+    // Statistics (protected by mutex)
+    ResultSinkStats stats;
+    double writeTimeTotal = 0.0;
+
+    void reduce(ViVidItem *item, Slot &slot);
+    void encode(uint64_t frameId, const Detection *detections, size_t count);
+    PartialFrame &stitch(const Slot &slot);
+    void writeLoop();
+};
+
+#endif // RESULT_SINK_HPP
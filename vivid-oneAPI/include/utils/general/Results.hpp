@@ -2,9 +2,11 @@
 #ifndef RESULTS_HPP
 #define RESULTS_HPP
 
+#include "AllocCounter.hpp"
 #include "ApplicationData.hpp"
 #include "GlobalParameters.hpp"
 #include "InputArgs.hpp"
+#include "ItemPool.hpp"
 #include <iomanip>
 #include <iostream>
 
@@ -27,50 +29,69 @@ inline void calculateAndDisplayResults(ApplicationData &appData, const InputArgs
         return (denominator == 0) ? 0 : numerator / denominator;
     };
 
+    const size_t numStages = appData.numStages();
+    auto sumStages = [numStages](auto value) {
+        double total = 0;
+        for (size_t i = 0; i < numStages; i++) {
+            total += value(i);
+        }
+        return total;
+    };
+
     if constexpr (ADVANCEDMETRICS_ENABLED) {
         std::cout << "---------------------------------------------------------------------------------------" << std::endl;
         std::cout << " TOTAL FILTERS BY DEVICE" << std::endl;
         std::cout << "---------------------------------------------------------------------------------------" << std::endl;
-        std::cout << " GPU: " << appData.numFiltersGPU[0].load() << " - " << appData.numFiltersGPU[1].load() << " - " << appData.numFiltersGPU[2].load() << std::endl;
-        std::cout << " CPU: " << appData.numFiltersCPU[0].load() << " - " << appData.numFiltersCPU[1].load() << " - " << appData.numFiltersCPU[2].load() << std::endl;
+        std::cout << " GPU:";
+        for (size_t i = 0; i < numStages; i++) {
+            std::cout << (i == 0 ? " " : " - ") << appData.numFiltersGPU[i].load();
+        }
+        std::cout << std::endl;
+        std::cout << " CPU:";
+        for (size_t i = 0; i < numStages; i++) {
+            std::cout << (i == 0 ? " " : " - ") << appData.numFiltersCPU[i].load();
+        }
+        std::cout << std::endl;
     }
 
     if constexpr (ADVANCEDMETRICS_ENABLED || TIMESTAGES_ENABLED) {
-        int totalNumFiltersGPU = appData.numFiltersGPU[0].load() + appData.numFiltersGPU[1].load() + appData.numFiltersGPU[2].load();
-        int totalNumFiltersCPU = appData.numFiltersCPU[0].load() + appData.numFiltersCPU[1].load() + appData.numFiltersCPU[2].load();
+        int totalNumFiltersGPU = static_cast<int>(sumStages([&](size_t i) { return appData.numFiltersGPU[i].load(); }));
+        int totalNumFiltersCPU = static_cast<int>(sumStages([&](size_t i) { return appData.numFiltersCPU[i].load(); }));
+        double totalTimeGPU = sumStages([&](size_t i) { return appData.time_GPU_S[i]; });
+        double totalTimeCPU = sumStages([&](size_t i) { return appData.time_CPU_S[i]; });
         std::cout << "---------------------------------------------------------------------------------------" << std::endl;
         std::cout << " TIME PER STAGE ( GPU frames: " << totalNumFiltersGPU << "; CPU frames: " << totalNumFiltersCPU << " )" << std::endl;
         std::cout << "---------------------------------------------------------------------------------------" << std::endl;
         if (inputArgs.selectedPath == PathSelection::Decoupled && !TIMESTAGES_ENABLED) {
             std::string stagesStr;
-            for (int i = 1; i <= NUM_STAGES; i++) {
+            for (size_t i = 1; i <= numStages; i++) {
                 stagesStr += std::to_string(i);
-                if (i < NUM_STAGES) {
+                if (i < numStages) {
                     stagesStr += "-";
                 }
             }
             if (totalNumFiltersGPU > 0) {
-                std::cout << " GPU Time: " << safe_divide(appData.time_GPU_S[0] + appData.time_GPU_S[1] + appData.time_GPU_S[2], totalNumFiltersGPU) << " ms" << std::endl;
+                std::cout << " GPU Time: " << safe_divide(totalTimeGPU, totalNumFiltersGPU) << " ms" << std::endl;
                 std::cout << " - Stage " << stagesStr << ":\t" << std::setprecision(2) << std::fixed << safe_divide(appData.time_GPU_S[0], appData.numFiltersGPU[0].load()) << " ms" << std::endl;
             }
             if (totalNumFiltersCPU > 0) {
                 std::cout << "---------------------------------------------------------------------------------------" << std::endl;
-                std::cout << " CPU Time: " << safe_divide(appData.time_CPU_S[0] + appData.time_CPU_S[1] + appData.time_CPU_S[2], totalNumFiltersCPU) << " ms" << std::endl;
+                std::cout << " CPU Time: " << safe_divide(totalTimeCPU, totalNumFiltersCPU) << " ms" << std::endl;
                 std::cout << " - Stage " << stagesStr << ":\t" << std::setprecision(2) << std::fixed << safe_divide(appData.time_CPU_S[0], appData.numFiltersCPU[0].load()) << " ms" << std::endl;
             }
         } else {
             if (totalNumFiltersGPU > 0) {
-                std::cout << " GPU Time: " << safe_divide(appData.time_GPU_S[0] + appData.time_GPU_S[1] + appData.time_GPU_S[2], totalNumFiltersGPU) << " ms" << std::endl;
-                std::cout << " - Stage 1:\t" << std::setprecision(2) << std::fixed << safe_divide(appData.time_GPU_S[0], appData.numFiltersGPU[0].load()) << " ms" << std::endl;
-                std::cout << " - Stage 2:\t" << std::setprecision(2) << std::fixed << safe_divide(appData.time_GPU_S[1], appData.numFiltersGPU[1].load()) << " ms" << std::endl;
-                std::cout << " - Stage 3:\t" << std::setprecision(2) << std::fixed << safe_divide(appData.time_GPU_S[2], appData.numFiltersGPU[2].load()) << " ms" << std::endl;
+                std::cout << " GPU Time: " << safe_divide(totalTimeGPU, totalNumFiltersGPU) << " ms" << std::endl;
+                for (size_t i = 0; i < numStages; i++) {
+                    std::cout << " - Stage " << (i + 1) << " (" << inputArgs.stageNames[i] << "):\t" << std::setprecision(2) << std::fixed << safe_divide(appData.time_GPU_S[i], appData.numFiltersGPU[i].load()) << " ms" << std::endl;
+                }
             }
             if (totalNumFiltersCPU > 0) {
                 std::cout << "---------------------------------------------------------------------------------------" << std::endl;
-                std::cout << " CPU Time: " << safe_divide(appData.time_CPU_S[0] + appData.time_CPU_S[1] + appData.time_CPU_S[2], totalNumFiltersCPU) << " ms" << std::endl;
-                std::cout << " - Stage 1:\t" << std::setprecision(2) << std::fixed << safe_divide(appData.time_CPU_S[0], appData.numFiltersCPU[0].load()) << " ms" << std::endl;
-                std::cout << " - Stage 2:\t" << std::setprecision(2) << std::fixed << safe_divide(appData.time_CPU_S[1], appData.numFiltersCPU[1].load()) << " ms" << std::endl;
-                std::cout << " - Stage 3:\t" << std::setprecision(2) << std::fixed << safe_divide(appData.time_CPU_S[2], appData.numFiltersCPU[2].load()) << " ms" << std::endl;
+                std::cout << " CPU Time: " << safe_divide(totalTimeCPU, totalNumFiltersCPU) << " ms" << std::endl;
+                for (size_t i = 0; i < numStages; i++) {
+                    std::cout << " - Stage " << (i + 1) << " (" << inputArgs.stageNames[i] << "):\t" << std::setprecision(2) << std::fixed << safe_divide(appData.time_CPU_S[i], appData.numFiltersCPU[i].load()) << " ms" << std::endl;
+                }
             }
         }
     }
@@ -90,6 +111,105 @@ inline void calculateAndDisplayResults(ApplicationData &appData, const InputArgs
         std::cout << " Balance time: \t" << std::setprecision(2) << std::fixed << appData.sampleTime << " ms" << std::endl;
         std::cout << " System time: \t" << std::setprecision(2) << std::fixed << appData.systemTime << " ms" << std::endl;
     }
+
+    if (inputArgs.memBudget > 0 || VERBOSE_ENABLED) {
+        std::cout << "---------------------------------------------------------------------------------------" << std::endl;
+        std::cout << " Peak USM: \t" << std::setprecision(2) << std::fixed << appData.usmUsage.getPeak() / (1024.0 * 1024.0) << " MB";
+        if (inputArgs.memBudget > 0) {
+            std::cout << " (budget: " << inputArgs.memBudget / (1024.0 * 1024.0) << " MB)";
+        }
+        std::cout << std::endl;
+    }
+
+    if constexpr (ALLOCCOUNT_ENABLED) {
+        std::cout << "---------------------------------------------------------------------------------------" << std::endl;
+        if (AllocCounter::hasSteadyState()) {
+            std::cout << " Allocs/frame: \t" << std::setprecision(2) << std::fixed << AllocCounter::allocationsPerFrame() << " (" << AllocCounter::bytesPerFrame() << " bytes/frame, steady state)" << std::endl;
+        } else {
+            std::cout << " Allocs/frame: \tnot measured (not enough frames to reach the steady state)" << std::endl;
+        }
+        std::cout << " Allocs total: \t" << AllocCounter::allocations() << std::endl;
+    }
+    std::cout << "---------------------------------------------------------------------------------------" << std::endl;
+}
+
+inline void displayItemPoolStats(const ItemPoolStats &stats) {
+    std::cout << " ITEM POOL" << std::endl;
+    std::cout << "---------------------------------------------------------------------------------------" << std::endl;
+    std::cout << " Capacity: \t" << stats.capacity << " items (peak in use: " << stats.peakInUse << ")" << std::endl;
+    std::cout << " Acquired: \t" << stats.acquired << " (per-thread cache hits: " << stats.cacheHits << ")" << std::endl;
+    std::cout << " Released: \t" << stats.released << std::endl;
+    std::cout << " Waits: \t" << stats.blockingWaits << " blocking, " << stats.failedTries << " failed tries" << std::endl;
+    std::cout << "---------------------------------------------------------------------------------------" << std::endl;
+}
+
+inline void displayFrameSourceStats(const FrameSourceStats &stats) {
+    std::cout << " INPUT" << std::endl;
+    std::cout << "---------------------------------------------------------------------------------------" << std::endl;
+    if (stats.tiles > 0) {
+        std::cout << " Tiles read: \t" << stats.framesRead << " (" << stats.framesRead / stats.tiles << " frames of " << stats.tiles << " tiles, input restarted " << stats.loops
+                  << " times)" << std::endl;
+        std::cout << " Tile overhead: \t" << std::setprecision(1) << std::fixed << stats.tileOverhead * 100.0 << "% of the pixels processed twice or padding" << std::endl;
+    } else {
+        std::cout << " Frames read: \t" << stats.framesRead << " (input restarted " << stats.loops << " times)" << std::endl;
+    }
+    if (stats.sharedMemory) {
+        std::cout << " Reads: \tshared memory ring (" << (stats.zeroCopy ? "read in place" : "copied to the prefetch ring") << ")" << std::endl;
+    } else {
+        std::cout << " Reads: \t" << ioBackendName(stats.backend) << ", depth " << stats.ioDepth << " (" << stats.directFrames << " frames with O_DIRECT)" << std::endl;
+    }
+    std::cout << " Ingest latency: " << std::setprecision(3) << std::fixed << stats.readTimeAvg << " ms avg, " << stats.readTimeMax << " ms max ("
+              << std::setprecision(2) << stats.bandwidth << " MB/s)" << std::endl;
+    std::cout << " Input stalls: \t" << stats.stalls << " (" << std::setprecision(2) << std::fixed << stats.stallTime << " ms waiting for frames)" << std::endl;
+    std::cout << "---------------------------------------------------------------------------------------" << std::endl;
+}
+
+inline void displayCameraStats(const CameraStats &stats) {
+    std::cout << " CAMERA" << std::endl;
+    std::cout << "---------------------------------------------------------------------------------------" << std::endl;
+    std::cout << " Rate: \t\t" << std::setprecision(2) << std::fixed << stats.fps << " FPS (burst " << stats.burst << ", jitter " << stats.jitter
+              << " ms), achieved " << stats.achievedFps << " FPS" << std::endl;
+    std::cout << " Deadline: \t" << stats.deadline << " ms, missed by " << stats.deadlineMisses << " of " << stats.frames << " frames" << std::endl;
+    std::cout << " Queueing: \t" << std::setprecision(3) << stats.queueingDelay.avg << " ms avg, " << stats.queueingDelay.p99 << " ms p99, "
+              << stats.queueingDelay.max << " ms max" << std::endl;
+    std::cout << " Latency: \t" << stats.latency.p50 << " ms p50, " << stats.latency.p90 << " ms p90, " << stats.latency.p99 << " ms p99, "
+              << stats.latency.max << " ms max" << std::endl;
+    std::cout << "---------------------------------------------------------------------------------------" << std::endl;
+}
+
+inline void displayResultSinkStats(const ResultSinkStats &stats) {
+    std::cout << " RESULT SINK" << std::endl;
+    std::cout << "---------------------------------------------------------------------------------------" << std::endl;
+    std::cout << " Written: \t" << stats.framesWritten << " frames, " << stats.detections << " detections (" << std::setprecision(2) << std::fixed
+              << stats.bytesWritten / (1024.0 * 1024.0) << " MB, " << std::setprecision(3) << stats.writeTimeAvg << " ms per frame)" << std::endl;
+    std::cout << " Queue: \t" << stats.depth << " frames (peak " << stats.peakQueued << "), " << stats.framesDropped << " dropped" << std::endl;
+    std::cout << " Backpressure: \t" << stats.blockedFrames << " frames waited " << std::setprecision(2) << stats.blockedTime << " ms" << std::endl;
+    std::cout << "---------------------------------------------------------------------------------------" << std::endl;
+}
+
+inline void displayReorderStats(const ReorderStats &stats) {
+    std::cout << " REORDER BUFFER" << std::endl;
+    std::cout << "---------------------------------------------------------------------------------------" << std::endl;
+    std::cout << " Delivered: \t" << stats.delivered << " frames in order (window " << stats.window << "), " << stats.skipped << " skipped, " << stats.lateFrames
+              << " arrived after being skipped" << std::endl;
+    std::cout << " Depth: \t" << std::setprecision(2) << std::fixed << stats.meanDepth << " frames held on average, " << stats.peakDepth << " peak" << std::endl;
+    std::cout << " Blocking: \t" << stats.heldFrames << " frames waited for an older one, " << std::setprecision(3) << stats.blockedTime << " ms in total, "
+              << stats.blockedTimeMax << " ms max" << std::endl;
+    std::cout << "---------------------------------------------------------------------------------------" << std::endl;
+}
+
+inline void displayTemporalReuseStats(const TemporalReuseStats &stats) {
+    std::cout << " TEMPORAL REUSE" << std::endl;
+    std::cout << "---------------------------------------------------------------------------------------" << std::endl;
+    std::cout << " Frames: 	" << stats.frames << " (" << stats.keyframes << " keyframes every " << stats.refresh << " frames, " << stats.reusedFrames
+              << " reused)" << std::endl;
+    std::cout << " Dirty tiles: 	" << stats.dirtyTiles << " of " << stats.tiles << " (threshold " << std::setprecision(3) << std::fixed << stats.threshold
+              << ", " << stats.diffTimeAvg << " ms per comparison)" << std::endl;
+    std::cout << " Reuse ratio: 	" << std::setprecision(1) << stats.reuseRatio * 100.0 << "% of the cells copied from the reference" << std::endl;
+    if (stats.verifiedFrames > 0) {
+        std::cout << " Verification: 	" << stats.mismatchedFrames << " of " << stats.verifiedFrames << " frames above the tolerance (max error "
+                  << std::setprecision(4) << stats.maxError << ")" << std::endl;
+    }
     std::cout << "---------------------------------------------------------------------------------------" << std::endl;
 }
 
@@ -0,0 +1,108 @@
+/**
+ * @file RoiList.hpp
+ * @brief Per-frame regions of interest (--roi): the stages only process the part of each frame around them.
+ *
+ * The list is a text file with one region per line, "frame x y width height" (pixels, frames numbered from 1 in the
+ * order of the input; '#' starts a comment). A frame can have several regions; the frames that are not listed are
+ * processed whole.
+ *
+ * The window positions of the detector are anchored at the cells of the histograms, so the active part of a frame is
+ * the set of window positions whose window overlaps a region (each region grows by the window minus one cell to the
+ * left and up), rounded to whole cells. The stages process the bounding box of that set for all the regions of the
+ * frame:
+ *  - stage 1 computes the filter response of the pixels of the active cells (their halo, filterDim / 2 pixels, is
+ *    read from the frame);
+ *  - stage 2 computes the histograms of the active cells;
+ *  - stage 3 compares the span of cells from the first to the last active cell (row-major) with the classes.
+ * The result sink only reports the active cells.
+ */
+#pragma once
+#ifndef ROI_LIST_HPP
+#define ROI_LIST_HPP
+
+#include <cstddef>
+#include <string>
+#include <vector>
+
+/**
+ * @brief Rectangle of a frame (pixels or cells).
+ */
+struct Rect {
+    int x = 0;      ///< Left column.
+    int y = 0;      ///< Top row.
+    int width = 0;  ///< Columns.
+    int height = 0; ///< Rows.
+};
+
+/**
+ * @brief Part of a frame processed by the stages for its regions of interest.
+ */
+struct ActiveRegion {
+    std::vector<Rect> rois; ///< Regions of interest of the frame (pixels, clipped to the frame).
+    Rect pixels;            ///< Pixels whose filter response is computed (stage 1).
+    Rect cells;             ///< Cells whose histogram is computed (stage 2), i.e. the active window positions.
+    int cellsPerRow = 0;    ///< Cells per row of the frame.
+    size_t firstCell = 0;   ///< First cell compared with the classes (stage 3, row-major index).
+    size_t endCell = 0;     ///< End of the cells compared with the classes (exclusive).
+    double fraction = 1.0;  ///< Active cells / cells of the frame.
+
+    /**
+     * @brief Check whether a cell of the frame (row-major index) is active.
+     */
+    bool contains(size_t cell) const {
+        int cx = static_cast<int>(cell % cellsPerRow);
+        int cy = static_cast<int>(cell / cellsPerRow);
+        return cx >= cells.x && cx < cells.x + cells.width && cy >= cells.y && cy < cells.y + cells.height;
+    }
+};
+
+class RoiList {
+  public:
+    /**
+     * @brief Load the regions of interest of a list file.
+     * @param path Text file with one "frame x y width height" region per line.
+     * @param frameHeight Height of the frames.
+     * @param frameWidth Width of the frames.
+     * @param cellSize Pixels per cell of the histograms.
+     * @param apron Pixels of the border of the frame without cells (filterDim / 2).
+     * @param windowHeight Height of the detector window.
+     * @param windowWidth Width of the detector window.
+     * @throws std::runtime_error If the file cannot be read.
+     * @throws std::invalid_argument If a line is malformed or a region lies outside the frame.
+     */
+    RoiList(const std::string &path, int frameHeight, int frameWidth, int cellSize, int apron, int windowHeight, int windowWidth);
+
+    /**
+     * @brief Get the active part of a frame.
+     * @param frame Number of the frame (from 1).
+     * @return The active region, or nullptr if the frame has no regions of interest (it is processed whole).
+     */
+    const ActiveRegion *find(size_t frame) const {
+        return frame > 0 && frame <= regions.size() && !regions[frame - 1].rois.empty() ? &regions[frame - 1] : nullptr;
+    }
+
+    size_t frames() const { return listedFrames; }
+    size_t rois() const { return listedRois; }
+
+    /**
+     * @brief Get the mean active fraction of the frames up to the last listed one (the others count as whole frames).
+     */
+    double meanFraction() const;
+
+  private:
+    int frameHeight;
+    int frameWidth;
+    int cellSize;
+    int apron;
+    int windowHeight;
+    int windowWidth;
+    int cellsX;
+    int cellsY;
+    size_t listedFrames = 0;
+    size_t listedRois = 0;
+    std::vector<ActiveRegion> regions; //< Indexed by frame - 1 (no regions: not listed)
+
+    void activate(ActiveRegion &region) const;
+};
+
+#endif // ROI_LIST_HPP
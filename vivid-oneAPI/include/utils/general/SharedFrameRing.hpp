@@ -0,0 +1,195 @@
+/**
+ * @file SharedFrameRing.hpp
+ * @brief Single-producer/single-consumer ring of frames in POSIX shared memory (--input shm:NAME).
+ *
+ * A capture process (the producer) creates the segment /NAME and writes each frame into the next free slot of the
+ * ring; the pipeline (the consumer) takes the frames in order and gives the slots back once the items that hold
+ * them have been released. Both sides sleep on the two counters of the ring with process-shared futexes, so an
+ * idle ring costs no CPU and a new frame wakes the consumer immediately.
+ *
+ * Segment layout (native endianness, the producer and the consumer run on the same machine):
+ *  - Header (one page): magic, version, frame geometry, number of slots and the counters.
+ *  - Slots: slotBytes each (frameBytes rounded up to a page), starting at dataOffset.
+ *
+ * The counters are 32-bit and wrap around, so the number of slots must be a power of two. The producer may only
+ * write the slot of frame writeIndex when writeIndex - readIndex < slots; the consumer may only read the frames
+ * in [readIndex, writeIndex).
+ *
+ * This header does not depend on SYCL, so tools (shm_producer) can be built with any C++20 compiler.
+ */
+#pragma once
+#ifndef SHARED_FRAME_RING_HPP
+#define SHARED_FRAME_RING_HPP
+
+#include "FrameContainer.hpp"
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+namespace SharedFrameRing {
+using FrameContainer::PixelType;
+
+constexpr char MAGIC[8] = {'V', 'V', 'S', 'H', 'R', 'I', 'N', 'G'};
+constexpr uint32_t VERSION = 1;
+constexpr size_t PAGE_SIZE = 4096;
+constexpr int POLL_MS = 100; ///< Maximum time a wait sleeps before checking whether the other side is still there.
+
+/**
+ * @brief Header at the beginning of the segment.
+ */
+struct Header {
+    char magic[8];       ///< MAGIC (written last by the producer, with ready).
+    uint32_t version;    ///< VERSION.
+    uint32_t pixelType;  ///< FrameContainer::PixelType of the pixels.
+    uint32_t width;      ///< Width of the frames (pixels).
+    uint32_t height;     ///< Height of the frames (pixels).
+    uint32_t slots;      ///< Number of slots (power of two).
+    uint32_t reserved;   ///< Padding, 0.
+    uint64_t frameBytes; ///< Bytes of a frame (rows without padding).
+    uint64_t slotBytes;  ///< Bytes between two slots (frameBytes rounded up to PAGE_SIZE).
+    uint64_t dataOffset; ///< Offset of the first slot.
+
+    alignas(64) std::atomic<uint32_t> ready;        ///< 1 once the producer has filled the header.
+    alignas(64) std::atomic<uint32_t> writeIndex;   ///< Frames published by the producer.
+    alignas(64) std::atomic<uint32_t> readIndex;    ///< Frames given back by the consumer.
+    alignas(64) std::atomic<uint32_t> producerOpen; ///< 1 while the producer is running.
+    std::atomic<uint32_t> consumerOpen;             ///< 1 while a consumer is attached.
+    std::atomic<uint32_t> attachments;              ///< Number of times a consumer has attached.
+};
+
+static_assert(std::atomic<uint32_t>::is_always_lock_free, "The counters of the ring must be lock free to be shared between processes");
+static_assert(sizeof(Header) <= PAGE_SIZE, "The header of the ring must fit in a page");
+
+/**
+ * @brief Result of a wait on the ring.
+ */
+enum class WaitResult {
+    Ready,   //< The frame (or the slot) is available
+    Timeout, //< Nothing happened during the wait
+    Closed   //< The other side has gone away
+};
+
+/**
+ * @brief Common part of the producer and the consumer: the mapping of the segment.
+ */
+class Segment {
+  public:
+    ~Segment();
+    Segment(const Segment &) = delete;
+    Segment &operator=(const Segment &) = delete;
+
+    const std::string &name() const { return segmentName; }
+    uint32_t width() const { return header->width; }
+    uint32_t height() const { return header->height; }
+    PixelType pixelType() const { return static_cast<PixelType>(header->pixelType); }
+    uint32_t slots() const { return header->slots; }
+    size_t frameBytes() const { return header->frameBytes; }
+
+    /**
+     * @brief Get the memory of a slot.
+     */
+    unsigned char *slotData(uint32_t slot) const;
+
+    /**
+     * @brief Get the whole mapping (e.g. to register it with a device).
+     */
+    void *mappingBase() const { return base; }
+    size_t mappingSize() const { return size; }
+
+  protected:
+    Segment() = default;
+    void map(int fd, size_t bytes);
+
+    std::string segmentName; //< Name of the segment, with the leading '/'
+    void *base = nullptr;
+    size_t size = 0;
+    Header *header = nullptr;
+};
+
+/**
+ * @brief Side of the capture process: creates the segment and publishes the frames.
+ */
+class Producer : public Segment {
+  public:
+    /**
+     * @brief Create the segment (an existing segment with the same name is replaced).
+     * @throws std::invalid_argument If the number of slots is not a power of two or the geometry is empty.
+     * @throws std::runtime_error If the segment cannot be created.
+     */
+    Producer(const std::string &name, uint32_t width, uint32_t height, PixelType type, uint32_t slots);
+
+    /**
+     * @brief Tell the consumer that no more frames will come and remove the segment name.
+     */
+    ~Producer();
+
+    /**
+     * @brief Wait until the slot of the next frame is free.
+     * @param timeoutMs Maximum time to wait.
+     * @return Ready, Timeout, or Closed if a consumer was attached and has gone away.
+     */
+    WaitResult waitSlot(int timeoutMs);
+
+    /**
+     * @brief Get the memory where the next frame must be written (only valid after waitSlot() returned Ready).
+     */
+    unsigned char *nextFrame() const;
+
+    /**
+     * @brief Make the frame written in nextFrame() visible to the consumer.
+     */
+    void publish();
+
+    /**
+     * @brief Check whether a consumer is attached.
+     */
+    bool consumerAttached() const;
+
+    /**
+     * @brief Get the number of frames published.
+     */
+    uint32_t published() const;
+};
+
+/**
+ * @brief Side of the pipeline: attaches to the segment of a running producer.
+ */
+class Consumer : public Segment {
+  public:
+    /**
+     * @brief Map the segment and check its header.
+     * @throws std::invalid_argument If the segment does not exist, is not a frame ring or its version is not supported.
+     */
+    explicit Consumer(const std::string &name);
+
+    /**
+     * @brief Detach from the segment (a producer waiting for a slot is woken up).
+     */
+    ~Consumer();
+
+    /**
+     * @brief Wait until frame index (counted from the start of the ring) has been published.
+     * @return Ready, Timeout, or Closed if the producer has finished and the frame will never be published.
+     */
+    WaitResult waitFrame(uint32_t index, int timeoutMs);
+
+    /**
+     * @brief Check (without waiting) whether frame index has been published.
+     */
+    bool available(uint32_t index) const;
+
+    /**
+     * @brief Give back to the producer all the slots of the frames before index.
+     */
+    void releaseUntil(uint32_t index);
+
+    /**
+     * @brief Get the index of the first frame not given back yet (the first frame the consumer can read).
+     */
+    uint32_t firstFrame() const;
+};
+
+} // namespace SharedFrameRing
+
+#endif // SHARED_FRAME_RING_HPP
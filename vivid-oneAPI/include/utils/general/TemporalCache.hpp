@@ -0,0 +1,149 @@
+/**
+ * @file TemporalCache.hpp
+ * @brief Temporal reuse (--reuse): the stages only recompute the tiles of a frame that changed, the rest of the output
+ * is copied from a reference frame.
+ *
+ * The reference is a keyframe: a frame processed whole whose pixels and output are kept by the cache. Every --reuse-refresh
+ * frames a new keyframe is processed whole and replaces it once it is released, which bounds the drift of the reused
+ * results and gives the items in flight a reference that does not depend on the order in which they finish.
+ *
+ * The cells of the histograms are grouped in tiles of TILE_CELLS x TILE_CELLS cells. When a frame is admitted, the mean
+ * absolute difference of each tile against the reference is computed over the pixels its cells depend on (the pixels
+ * of the cells plus the halo of the filter), so a tile below the threshold has the same output as in the reference
+ * (exactly with a threshold of 0). The stages process the bounding box of the dirty tiles (see ActiveRegion) and, when
+ * the item is released, the output of the other cells is copied from the reference.
+ *
+ * With --reuse-verify every reused frame is also computed whole on the host and compared with the merged output.
+ */
+#pragma once
+#ifndef TEMPORAL_CACHE_HPP
+#define TEMPORAL_CACHE_HPP
+
+#include "RoiList.hpp"
+#include "pipeline_template.hpp"
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+using namespace Pipeline_template;
+
+/**
+ * @brief Options of the temporal reuse.
+ */
+struct TemporalReuseConfig {
+    double threshold = 0.0; ///< Mean absolute difference per pixel (units of the input pixels) above which a tile is recomputed.
+    int refresh = 0;        ///< Frames between two keyframes (0: DEFAULT_REUSE_REFRESH).
+    bool verify = false;    ///< Compare every reused frame with its full recomputation.
+};
+
+/**
+ * @brief Statistics of the temporal reuse.
+ */
+struct TemporalReuseStats {
+    double threshold = 0.0;       ///< Threshold of the dirty tiles.
+    int refresh = 0;              ///< Frames between two keyframes.
+    size_t frames = 0;            ///< Frames released.
+    size_t keyframes = 0;         ///< Frames processed whole to become the reference.
+    size_t reusedFrames = 0;      ///< Frames with part of their output copied from the reference.
+    size_t dirtyTiles = 0;        ///< Tiles recomputed in the reused frames.
+    size_t tiles = 0;             ///< Tiles of the reused frames.
+    double reuseRatio = 0.0;      ///< Cells copied from the reference / cells of all the frames.
+    double diffTimeAvg = 0.0;     ///< Mean time of the comparison of a frame with the reference (ms).
+    size_t verifiedFrames = 0;    ///< Reused frames compared with their full recomputation (--reuse-verify).
+    size_t mismatchedFrames = 0;  ///< Verified frames with an output farther than the tolerance.
+    double maxError = 0.0;        ///< Largest difference found by the verification.
+};
+
+/**
+ * @brief Keyframe kept by the cache (immutable once published).
+ */
+struct TemporalReference {
+    size_t itemId = 0;                ///< Item that processed the keyframe.
+    std::vector<unsigned char> pixels; ///< Pixels of the keyframe, rows without padding.
+    std::vector<float> out;            ///< Output of the keyframe, with the layout of the out buffer of the items.
+};
+
+class TemporalCache {
+  public:
+    static constexpr int TILE_CELLS = 4; //< Cells per side of a tile
+
+    /**
+     * @brief Create the cache for frames of the given geometry.
+     * @param config Options of the reuse.
+     * @param height Height of the frames.
+     * @param width Width of the frames.
+     * @param cellSize Pixels per cell of the histograms.
+     * @param apron Pixels of the border of the frame without cells (filterDim / 2).
+     * @param numFilters Filters of the bank (bins of the histograms).
+     * @param filterBank Bank of filters, used by --reuse-verify.
+     * @param cla Classes, used by --reuse-verify.
+     * @throws std::invalid_argument If the threshold is negative or the frames are smaller than a cell.
+     */
+    TemporalCache(const TemporalReuseConfig &config, int height, int width, int cellSize, int apron, int numFilters, float *filterBank, FloatBuffer *cla);
+
+    /**
+     * @brief Decide how a frame is processed (called by the serial input node, after the frame has been taken).
+     *
+     * The item becomes a keyframe, is processed whole (no reference yet) or is restricted to its dirty tiles.
+     */
+    void admit(ViVidItem *item);
+
+    /**
+     * @brief Complete the output of a reused frame with the reference, or publish a keyframe (called when the item is
+     * released, from any thread, before the result sink reads the output).
+     */
+    void complete(ViVidItem *item);
+
+    /**
+     * @brief Get a snapshot of the statistics.
+     */
+    TemporalReuseStats getStats() const;
+
+  private:
+    TemporalReuseConfig config;
+    int height;
+    int width;
+    int cellSize;
+    int apron;
+    int numFilters;
+    float *filterBank;
+    FloatBuffer *cla;
+    int cellsX;
+    int cellsY;
+    int tilesX;
+    int tilesY;
+    std::vector<double> tileDiff; //< Difference of each tile with the reference (protected by diffMutex)
+
+    mutable std::mutex mutex;                                //< Protects the references, the keyframe state and diffTime
+    std::shared_ptr<const TemporalReference> current;        //< Reference of the admitted frames
+    std::vector<std::shared_ptr<TemporalReference>> spares;  //< References that can be rewritten once no item uses them
+    bool keyframePending = false;                            //< A keyframe is being processed
+
+    std::mutex diffMutex;                                            //< Serializes the search of the dirty region (tileDiff)
+    mutable std::mutex verifyMutex;                                  //< Serializes the verification (shared scratch buffers)
+    std::vector<float> scratchInd, scratchVal, scratchHis, scratchOut;
+
+    // Statistics
+    std::atomic<size_t> frames{0};
+    std::atomic<size_t> keyframes{0};
+    std::atomic<size_t> reusedFrames{0};
+    std::atomic<size_t> dirtyTiles{0};
+    std::atomic<size_t> tiles{0};
+    std::atomic<uint64_t> reusedCells{0};
+    std::atomic<uint64_t> totalCells{0};
+    double diffTime = 0.0; //< Protected by mutex
+    size_t diffs = 0;      //< Protected by mutex
+    std::atomic<size_t> verifiedFrames{0};
+    std::atomic<size_t> mismatchedFrames{0};
+    double maxError = 0.0; //< Protected by verifyMutex
+
+    void findDirtyRegion(ViVidItem *item, const TemporalReference &reference);
+    void publish(ViVidItem *item);
+    void merge(ViVidItem *item, const TemporalReference &reference) const;
+    void verify(ViVidItem *item);
+};
+
+#endif // TEMPORAL_CACHE_HPP
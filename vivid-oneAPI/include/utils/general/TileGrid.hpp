@@ -0,0 +1,89 @@
+/**
+ * @file TileGrid.hpp
+ * @brief Split of a large frame into overlapping tiles processed as independent items (--tile).
+ *
+ * The stages only see tiles: the items, the prefetch ring and the output buffers are sized to a tile, so frames
+ * larger than the host or device memory can be streamed from storage one tile at a time.
+ *
+ * The cells of the histograms start after the apron of the filter (filterDim / 2 pixels) and cover cellSize pixels
+ * each. A tile starts at a multiple of cellSize pixels, so its cells are cells of the frame and the pixels around
+ * them (the halo of the filter) are real pixels of the frame: every cell computed in a tile is exact.
+ *
+ * Consecutive tiles overlap by the detector window minus one cell (plus the apron), so every window position
+ * (anchored at a cell) lies entirely inside the tile that owns it. Each cell of the frame is owned by exactly one
+ * tile, which reports its detections; the detections of the tiles of a frame are stitched back together with frame
+ * coordinates. The last tile of each row and column owns the remaining cells of the frame, and the part of it that
+ * falls outside the frame is filled with zeros.
+ */
+#pragma once
+#ifndef TILE_GRID_HPP
+#define TILE_GRID_HPP
+
+#include <cstddef>
+#include <vector>
+
+/**
+ * @brief A tile of the frame.
+ */
+struct Tile {
+    int x = 0;      ///< Left column of the tile in the frame (pixels, multiple of the cell size).
+    int y = 0;      ///< Top row of the tile in the frame (pixels, multiple of the cell size).
+    int width = 0;  ///< Columns of the frame inside the tile (the rest of the tile is zero).
+    int height = 0; ///< Rows of the frame inside the tile.
+    int cellX0 = 0; ///< First column of cells owned by the tile (tile cells).
+    int cellX1 = 0; ///< End of the columns of cells owned by the tile (exclusive).
+    int cellY0 = 0; ///< First row of cells owned by the tile (tile cells).
+    int cellY1 = 0; ///< End of the rows of cells owned by the tile (exclusive).
+};
+
+class TileGrid {
+  public:
+    /**
+     * @brief Split a frame into tiles (a single tile if the frame fits in one).
+     * @param frameHeight Height of the frame.
+     * @param frameWidth Width of the frame.
+     * @param tileHeight Height of the tiles (clamped to the height of the frame).
+     * @param tileWidth Width of the tiles (clamped to the width of the frame).
+     * @param cellSize Pixels per cell of the histograms.
+     * @param apron Pixels of the border of the frame without cells (filterDim / 2).
+     * @param windowHeight Height of the detector window.
+     * @param windowWidth Width of the detector window.
+     * @throws std::invalid_argument If a tile cannot hold a window plus the apron.
+     */
+    TileGrid(int frameHeight, int frameWidth, int tileHeight, int tileWidth, int cellSize, int apron, int windowHeight, int windowWidth);
+
+    size_t size() const { return tiles.size(); }
+    const Tile &operator[](size_t i) const { return tiles[i]; }
+    int tileHeight() const { return height; }
+    int tileWidth() const { return width; }
+    size_t columns() const { return tilesX; }
+    size_t rows() const { return tilesY; }
+
+    /**
+     * @brief Get the fraction of the pixels of the tiles that is computed more than once (overlap and padding).
+     */
+    double overhead() const;
+
+  private:
+    /**
+     * @brief Tiles along one axis.
+     */
+    struct Span {
+        int origin; //< First pixel
+        int length; //< Pixels of the frame inside the tile
+        int cell0;  //< First owned cell (tile cells)
+        int cell1;  //< End of the owned cells
+    };
+
+    int height;
+    int width;
+    int frameHeight;
+    int frameWidth;
+    size_t tilesX = 0;
+    size_t tilesY = 0;
+    std::vector<Tile> tiles;
+
+    static std::vector<Span> split(int frameLength, int tileLength, int cellSize, int apron, int windowLength, const char *axis);
+};
+
+#endif // TILE_GRID_HPP
@@ -3,13 +3,18 @@
 
 #include "ApplicationData.hpp"
 #include "GlobalParameters.hpp"
+#include "InputArgs.hpp"
+#include "StageRegistry.hpp"
 #include "pipeline_template.hpp"
 #include <sycl/sycl.hpp>
 
+// The times of an item restricted to its regions of interest (--roi) are accumulated as the time of a whole frame, so
+// the samples of the cost model are comparable; optimizePipeline scales them back by the mean active fraction
 inline void timeMeasurements_advanced(ApplicationData &appData, ViVidItem *item) {
-    for (int i = 0; i < NUM_STAGES; ++i) {
+    const double scale = 1.0 / item->activeFraction();
+    for (size_t i = 0; i < appData.numStages(); ++i) {
         if (item->timeGPU_S[i] > 0) {
-            appData.time_GPU_S[i] += item->timeGPU_S[i];
+            appData.time_GPU_S[i] += item->timeGPU_S[i] * scale;
             if constexpr (TIMESTAGES_ENABLED) {
                 appData.numGPUframes++;
             } else if constexpr (ADVANCEDMETRICS_ENABLED) {
@@ -17,7 +22,7 @@ inline void timeMeasurements_advanced(ApplicationData &appData, ViVidItem *item)
             }
         }
         if (item->timeCPU_S[i] > 0) {
-            appData.time_CPU_S[i] += item->timeCPU_S[i];
+            appData.time_CPU_S[i] += item->timeCPU_S[i] * scale;
             if constexpr (TIMESTAGES_ENABLED) {
                 appData.numCPUframes++;
             } else if constexpr (ADVANCEDMETRICS_ENABLED) {
@@ -31,53 +36,55 @@ inline void timeMeasurements_basic(ApplicationData &appData, ViVidItem *item) {
     auto &frameRef = item->GPU_item ? appData.numGPUframes : appData.numCPUframes;
     auto &timeRef = item->GPU_item ? appData.time_GPU_S : appData.time_CPU_S;
     auto &itemTimeRef = item->GPU_item ? item->timeGPU_S : item->timeCPU_S;
+    const double scale = 1.0 / item->activeFraction();
     frameRef++;
-    for (int i = 0; i < NUM_STAGES; ++i) {
-        timeRef[i] += itemTimeRef[i];
+    for (size_t i = 0; i < appData.numStages(); ++i) {
+        timeRef[i] += itemTimeRef[i] * scale;
     }
 }
 
-inline void timeMeasurements_syclevents(ApplicationData &appData, ViVidItem *item, Acc accelerator) {
+inline void timeMeasurements_syclevents(ApplicationData &appData, InputArgs &inputArgs, ViVidItem *item, Acc accelerator) {
+    const double scale = 1.0 / item->activeFraction();
     int counter = 0;
     for (const auto &event : item->stage_events) {
         const Acc stage_acc = item->stage_acc[counter]; // Cachear el valor de stage_acc
         const bool isGPU = (stage_acc == Acc::GPU);
         const bool isCPU = (stage_acc == Acc::CPU);
 
-        if constexpr (USE_VIVID_APP) {
+        if (inputArgs.stages[counter]->enqueues) {
             if (isGPU) {
-                // Calcular tiempos para GPU en modo VIVID_APP
+                // Calcular tiempos para GPU con el perfil del evento del kernel
                 auto command_end = event.get_profiling_info<sycl::info::event_profiling::command_end>();
                 auto command_start = event.get_profiling_info<sycl::info::event_profiling::command_start>();
-                appData.time_GPU_S[counter] += (command_end - command_start) * 1e-6;
+                appData.time_GPU_S[counter] += (command_end - command_start) * 1e-6 * scale;
             } else if (isCPU) {
                 if constexpr (SYCL_ENABLED) {
                     // Calcular tiempos para CPU en modo SYCL
                     auto command_end = event.get_profiling_info<sycl::info::event_profiling::command_end>();
                     auto command_start = event.get_profiling_info<sycl::info::event_profiling::command_start>();
-                    appData.time_CPU_S[counter] += (command_end - command_start) * 1e-6;
+                    appData.time_CPU_S[counter] += (command_end - command_start) * 1e-6 * scale;
                 } else {
                     // Usar tiempos predefinidos si no está SYCL habilitado
-                    appData.time_CPU_S[counter] += item->timeCPU_S[counter];
+                    appData.time_CPU_S[counter] += item->timeCPU_S[counter] * scale;
                 }
             }
         } else {
-            // Si no estamos en VIVID_APP, usar tiempos predefinidos
+            // Si la etapa no encola su trabajo (simulador), usar tiempos predefinidos
             if (isGPU) {
-                appData.time_GPU_S[counter] += item->timeGPU_S[counter];
+                appData.time_GPU_S[counter] += item->timeGPU_S[counter] * scale;
             } else if (isCPU) {
-                appData.time_CPU_S[counter] += item->timeCPU_S[counter];
+                appData.time_CPU_S[counter] += item->timeCPU_S[counter] * scale;
             }
         }
         counter++;
     }
 }
 
-inline void timeMeasurements(ApplicationData &appData, ViVidItem *item, Acc accelerator = Acc::OTHER) {
+inline void timeMeasurements(ApplicationData &appData, InputArgs &inputArgs, ViVidItem *item, Acc accelerator = Acc::OTHER) {
     if (accelerator == Acc::OTHER) {
         timeMeasurements_advanced(appData, item);
     } else {
-        timeMeasurements_syclevents(appData, item, accelerator);
+        timeMeasurements_syclevents(appData, inputArgs, item, accelerator);
     }
 }
 
@@ -12,11 +12,22 @@
 /************************************************************************************
  *       -------------------          CLASS TEMPLATES            ----------------------
  *************************************************************************************/
+#include "FrameContainer.hpp"
 #include "GlobalParameters.hpp"
+#include "RoiList.hpp"
+#include "TileGrid.hpp"
+#include <array>
+#include <atomic>
+#include <charconv>
+#include <chrono>
 #include <cmath>
 #include <condition_variable>
+#include <cstring>
 #include <iostream>
+#include <memory>
 #include <mutex>
+#include <stdexcept>
+#include <string>
 #include <oneapi/tbb.h>
 #include <sycl/sycl.hpp>
 #include <vector>
@@ -24,6 +35,9 @@
 using namespace std;
 using namespace oneapi;
 
+struct TemporalReference; // TemporalCache.hpp
+class QueuePool;          // QueuePool.hpp
+
 namespace Pipeline_template {
 /**************************
  *
@@ -53,6 +67,65 @@ class ViVidItem; // forward declaration
 
 #define MAX_BUFFERS 10
 
+/**
+ * @class USMUsage
+ * @brief Accounting of the USM allocated by a pipeline (current and peak bytes).
+ *
+ * Every pipeline accounts its own buffers (ApplicationData::usmUsage), so several pipelines in the same process
+ * report their own memory. Each allocation is also added to its parent, by default process(), the total of the process.
+ */
+class USMUsage {
+  public:
+    /**
+     * @param parent_ Accounting that also receives the allocations (nullptr: none).
+     */
+    explicit USMUsage(USMUsage *parent_ = &process()) noexcept : parent{parent_} {}
+
+    USMUsage(const USMUsage &) = delete;
+    USMUsage &operator=(const USMUsage &) = delete;
+
+    /**
+     * @brief Register a new USM allocation.
+     * @param bytes Size of the allocation in bytes.
+     */
+    void allocated(size_t bytes) noexcept {
+        size_t now = current.fetch_add(bytes, std::memory_order_relaxed) + bytes;
+        size_t prev = peak.load(std::memory_order_relaxed);
+        while (now > prev && !peak.compare_exchange_weak(prev, now, std::memory_order_relaxed)) {
+        }
+        if (parent != nullptr) {
+            parent->allocated(bytes);
+        }
+    }
+
+    /**
+     * @brief Register the release of a USM allocation.
+     * @param bytes Size of the allocation in bytes.
+     */
+    void freed(size_t bytes) noexcept {
+        current.fetch_sub(bytes, std::memory_order_relaxed);
+        if (parent != nullptr) {
+            parent->freed(bytes);
+        }
+    }
+
+    size_t getCurrent() const noexcept { return current.load(std::memory_order_relaxed); }
+    size_t getPeak() const noexcept { return peak.load(std::memory_order_relaxed); }
+
+    /**
+     * @brief Get the accounting of the whole process.
+     */
+    static USMUsage &process() noexcept {
+        static USMUsage total{nullptr};
+        return total;
+    }
+
+  private:
+    USMUsage *parent;                  //< Also receives the allocations (nullptr: none)
+    std::atomic<size_t> current{0};    //< Bytes currently allocated
+    std::atomic<size_t> peak{0};       //< Maximum number of bytes allocated at the same time
+};
+
 /**
  * @class Buffer_template
  * @tparam A_Type The type of the elements stored in the buffer (e.g. float, int)
@@ -83,8 +156,10 @@ class Buffer_template {
     int mapaccess = BUF_UNDEFINED;
 
     A_Type *data = nullptr;
+    bool external = false; // data is owned by someone else (e.g. a slot of a shared memory ring) and is not freed
 
     sycl::queue bufferTemplateQueue; // queue for USM allocation
+    USMUsage &usmUsage;              // accounting of the allocation (the one of the pipeline that owns the buffer)
 
     /**
      * @brief Constructor with width and height.
@@ -92,21 +167,23 @@ class Buffer_template {
      * @param w The width of the buffer.
      * @param access Access mode for the buffer.
      * @param queue SYCL queue for USM allocation.
+     * @param usage Accounting of the allocation.
      */
-    Buffer_template(size_t h, size_t w, int access, sycl::queue &queue);
+    Buffer_template(size_t h, size_t w, int access, sycl::queue &queue, USMUsage &usage);
     /**
      * @brief Constructor with width only.
      * @param w The width of the buffer.
      * @param access Access mode for the buffer.
      * @param queue SYCL queue for USM allocation.
+     * @param usage Accounting of the allocation.
      */
-    Buffer_template(size_t w, int access, sycl::queue &queue);
+    Buffer_template(size_t w, int access, sycl::queue &queue, USMUsage &usage);
 
     /**
      * @brief Copy constructor.
      * @param global Pointer to another Buffer_template object to copy from.
      * @param access Access mode for the buffer.
-     * @param queue SYCL queue for USM allocation.
+     * @param queue SYCL queue for USM allocation (the allocation is accounted with the one of global).
      */
     Buffer_template(Buffer_template *global, int access, sycl::queue &queue);
 
@@ -172,6 +249,66 @@ bool Buffer_template<A_Type>::use_pitch = false;
 
 using FloatBuffer = Buffer_template<float>;
 using IntBuffer = Buffer_template<int>;
+using FrameContainer::PixelType;
+
+/**
+ * @class FrameBuffer
+ * @brief Buffer of an input frame, stored with the pixel type of the source (float32, uint8 or uint16).
+ *
+ * The storage is a byte buffer: width and pitch of the base class are measured in bytes, pixelWidth and
+ * pixelPitch() in pixels. Stage 1 reads the pixels with their native type and widens them to float itself.
+ */
+class FrameBuffer : public Buffer_template<unsigned char> {
+  public:
+    PixelType pixelType; ///< Type of the pixels.
+    size_t pixelWidth;   ///< Width of the frame in pixels.
+
+    FrameBuffer(size_t h, size_t w, PixelType type, int access, sycl::queue &queue, USMUsage &usage)
+        : Buffer_template<unsigned char>(h, w * FrameContainer::pixelSize(type), access, queue, usage), pixelType{type}, pixelWidth{w} {}
+
+    /**
+     * @brief Frame stored in memory owned by someone else (e.g. a slot of a shared memory ring), which is not freed.
+     * @param memory Pixels, h rows of w pixels without padding.
+     */
+    FrameBuffer(size_t h, size_t w, PixelType type, void *memory, int access, sycl::queue &queue, USMUsage &usage) : FrameBuffer(h, w, type, access, queue, usage) {
+        data = static_cast<unsigned char *>(memory);
+        external = true;
+    }
+
+    /**
+     * @brief Get the pitch of the frame in pixels.
+     */
+    size_t pixelPitch() const {
+        return pitch / FrameContainer::pixelSize(pixelType);
+    }
+
+    /**
+     * @brief Get the host pointer to the pixels.
+     * @tparam Pixel Type of the pixels (must match pixelType).
+     */
+    template <typename Pixel>
+    Pixel *pixels(int access) {
+        return reinterpret_cast<Pixel *>(get_HOST_PTR(access));
+    }
+
+    /**
+     * @brief Call a function with the host pointer to the pixels, typed with the pixel type of the frame.
+     * @param access Access mode of the pointer.
+     * @param f Generic callable that takes a float*, uint8_t* or uint16_t*.
+     * @return The value returned by f.
+     */
+    template <typename F>
+    decltype(auto) visitPixels(int access, F &&f) {
+        switch (pixelType) {
+        case PixelType::UInt8:
+            return f(pixels<uint8_t>(access));
+        case PixelType::UInt16:
+            return f(pixels<uint16_t>(access));
+        default:
+            return f(pixels<float>(access));
+        }
+    }
+};
 
 /**************************
  *
@@ -185,23 +322,24 @@ void Buffer_template<A_Type>::reuse_ZCB() {
 }
 //---------------------------------------------------------
 template <typename A_Type>
-Buffer_template<A_Type>::Buffer_template(size_t h, size_t w, int access, sycl::queue &queue) : width{w}, height{h}, Ne{w * h}, kernelaccess{access}, bufferTemplateQueue{queue} {
+Buffer_template<A_Type>::Buffer_template(size_t h, size_t w, int access, sycl::queue &queue, USMUsage &usage)
+    : width{w}, height{h}, Ne{w * h}, kernelaccess{access}, bufferTemplateQueue{queue}, usmUsage{usage} {
     set_pitch();
 }
 //---------------------------------------------------------
 template <typename A_Type>
-Buffer_template<A_Type>::Buffer_template(size_t w, int access, sycl::queue &queue) : width{w}, height{1}, Ne{w}, kernelaccess{access}, bufferTemplateQueue{queue} {
+Buffer_template<A_Type>::Buffer_template(size_t w, int access, sycl::queue &queue, USMUsage &usage) : width{w}, height{1}, Ne{w}, kernelaccess{access}, bufferTemplateQueue{queue}, usmUsage{usage} {
     set_pitch();
 }
 //---------------------------------------------------------
 template <typename A_Type>
 Buffer_template<A_Type>::Buffer_template(Buffer_template *global, int access, sycl::queue &queue) : // does it make sense?
-                                                                                                    width{global->width}, height{global->height}, Ne{global->Ne}, pitch{global->pitch}, size{global->size}, kernelaccess{access}, bufferTemplateQueue{queue} {}
+                                                                                                    width{global->width}, height{global->height}, Ne{global->Ne}, pitch{global->pitch}, size{global->size}, kernelaccess{access}, bufferTemplateQueue{queue}, usmUsage{global->usmUsage} {}
 
 //---------------------------------------------------------
 template <typename A_Type>
 Buffer_template<A_Type>::~Buffer_template() {
-    if (!ZCB && data != NULL)
+    if (!ZCB && !external && data != NULL)
         free_host_USM();
 }
 //---------------------------------------------------------
@@ -267,18 +405,21 @@ A_Type *Buffer_template<A_Type>::get_HOST_PTR(int access) {
 //---------------------------------------------------------
 template <typename A_Type>
 void Buffer_template<A_Type>::alloc_host_USM() {
-    data = sycl::malloc_shared<A_Type>(size / sizeof(A_Type), bufferTemplateQueue);
+    data = sycl::aligned_alloc_shared<A_Type>(USM_ALIGNMENT, size / sizeof(A_Type), bufferTemplateQueue);
     if (data == NULL) {
-        printf("Error I can't malloc host buffer. size: %zu\n", size);
-        exit(0);
+        throw std::runtime_error("Unable to allocate a USM buffer of " + std::to_string(size) + " bytes (" + std::to_string(usmUsage.getCurrent()) +
+                                 " bytes already in use). Reduce --iff/--buffersize or set a --mem-budget.");
     }
+    usmUsage.allocated(size);
 }
 
 //---------------------------------------------------------
 template <typename A_Type>
 void Buffer_template<A_Type>::free_host_USM() {
-    if (data != NULL)
+    if (data != NULL) {
         sycl::free(data, bufferTemplateQueue);
+        usmUsage.freed(size);
+    }
 }
 
 /**
@@ -299,6 +440,75 @@ class Item_template {
     }
 };
 
+/**
+ * @class TraceBuffer
+ * @brief Fixed-capacity text buffer used to accumulate the trace events of an item.
+ *
+ * It replaces a std::stringstream so that tracing a frame does not allocate memory. Numbers are
+ * formatted with std::to_chars using the same format as the default ostream (%g, precision 6).
+ * If a frame generates more text than TRACE_BUFFER_SIZE bytes the remaining events are dropped
+ * and the overflow flag is set.
+ */
+class TraceBuffer {
+  public:
+    static constexpr size_t TRACE_BUFFER_SIZE = 4096; ///< Capacity of the buffer in bytes.
+
+    TraceBuffer &operator<<(const char *str) {
+        append(str, std::strlen(str));
+        return *this;
+    }
+    TraceBuffer &operator<<(double value) {
+        std::array<char, 32> tmp;
+        auto res = std::to_chars(tmp.data(), tmp.data() + tmp.size(), value, std::chars_format::general, 6);
+        append(tmp.data(), static_cast<size_t>(res.ptr - tmp.data()));
+        return *this;
+    }
+    TraceBuffer &operator<<(size_t value) {
+        std::array<char, 24> tmp;
+        auto res = std::to_chars(tmp.data(), tmp.data() + tmp.size(), value);
+        append(tmp.data(), static_cast<size_t>(res.ptr - tmp.data()));
+        return *this;
+    }
+    TraceBuffer &operator<<(std::ostream &(*)(std::ostream &)) { // std::endl
+        append("\n", 1);
+        return *this;
+    }
+
+    /**
+     * @brief Write the content of the buffer into an output stream.
+     * @param os Output stream.
+     */
+    void writeTo(std::ostream &os) const {
+        os.write(buffer.data(), static_cast<std::streamsize>(length));
+    }
+
+    /**
+     * @brief Empty the buffer (the storage is kept).
+     */
+    void clear() noexcept {
+        length = 0;
+        overflow = false;
+    }
+
+    bool overflowed() const noexcept {
+        return overflow;
+    }
+
+  private:
+    std::array<char, TRACE_BUFFER_SIZE> buffer; //< Storage of the buffer
+    size_t length = 0;                          //< Number of bytes used
+    bool overflow = false;                      //< Some events did not fit in the buffer
+
+    void append(const char *str, size_t n) {
+        if (length + n > buffer.size()) {
+            overflow = true;
+            return;
+        }
+        std::memcpy(buffer.data() + length, str, n);
+        length += n;
+    }
+};
+
 /**
  * @class ViVidItem
  * @brief A derived class template from Item_template for managing ViVid items in the processing pipeline.
@@ -311,7 +521,10 @@ class ViVidItem : public Item_template {
   public:
     size_t item_id = 0;          //< The item ID
     bool GPU_item = false;       //< The item has been processed on GPU only.
-    std::stringstream traceItem; //< The trace of the item.
+    int stage = 0;               //< Position of the stage that is processing the item (set by runStage)
+    std::mutex branchMutex;      //< Taken by the branches of the pipeline that process the item at the same time
+    std::atomic<int> branchesDone{0}; //< Branches of the current level that have finished with the item (join)
+    TraceBuffer traceItem;       //< The trace of the item.
 
     std::atomic<int> *ptrSizeActualStage = nullptr; //< Atomic pointer of integer type pointing to the current stage size.
     std::atomic<int> *ptrCoreActualStage = nullptr; //< Atomic pointer of integer type pointing to the current stage size.
@@ -322,25 +535,58 @@ class ViVidItem : public Item_template {
     std::vector<sycl::event> stage_events; //< Create a vector of events to wait for the previous stage or save the event of the current stage.
     std::vector<Acc> stage_acc;            //< Create a vector of accelerators to save the accelerator used in each stage.
     sycl::queue &ViVidItemQueue;           //< Reference to the queue we use to allocate memory with malloc_shared
+    USMUsage &ViVidItemUsage;              //< Accounting of the buffers of the item
 
     // Variables for time measurement
     tbb::tick_count filter_start;           //< The filter used to start the timer
-    std::vector<double> timeCPU_S{0, 0, 0}; //< The CPU execution time for each stage
-    std::vector<double> timeGPU_S{0, 0, 0}; //< The GPU execution time for each stage
+    std::array<double, MAX_STAGES> timeCPU_S{}; //< The CPU execution time for each stage
+    std::array<double, MAX_STAGES> timeGPU_S{}; //< The GPU execution time for each stage
     double execution_time = 0;              //< The total execution time of the kernel
 
+    // Synthetic camera (--camera)
+    std::chrono::steady_clock::time_point arrivalTime{};  //< Arrival of the frame at the camera
+    std::chrono::steady_clock::time_point deadlineTime{}; //< Time by which the item must be released
+
     // Buffers used in the ViVid pipeline
-    FloatBuffer *frame; // Input                    //< The input frame buffer
+    FrameBuffer *frame; // Input                    //< The input frame buffer
+    int frameSlot = -1;                              //< Slot of the input prefetch ring held by the item (-1: global frame)
+    QueuePool *queuePool = nullptr;                  //< Pool of queues the stages of the item submit to (--queues, nullptr: the configured queues)
+    int queueSlot = -1;                              //< Queues of the pool assigned to the item (-1: none)
+    const Tile *tile = nullptr;                      //< Tile of the input frame held by the item (--tile, nullptr: whole frame)
+    size_t tileFrame = 0;                            //< Number of the input frame the tile belongs to (from 1)
+    size_t inputFrame = 0;                           //< Number of the frame in the input file (from 1, repeats when the input restarts; 0: not read from a file)
+    const ActiveRegion *region = nullptr;            //< Part of the frame processed by the stages (--roi, --reuse, nullptr: whole frame)
+    ActiveRegion dirtyRegion;                        //< Tiles of the frame that changed since the reference (--reuse)
+    std::shared_ptr<const TemporalReference> reference; //< Keyframe whose output completes the item (--reuse, nullptr: none)
+    bool keyframe = false;                           //< The item is processed whole to become the reference (--reuse)
     FloatBuffer *ind;   // F1                       //< The indices buffer
     FloatBuffer *val;   // F1                       //< The values buffer
     FloatBuffer *his;   // F2                       //< The histogram buffer
     FloatBuffer *cla;   // F2                       //< The classification buffer
     FloatBuffer *out;   // F3                       //< The output buffer
+    std::array<FloatBuffer *, MAX_STAGES> claStage{}; //< Classes of the stages with their own classifier (nullptr: cla)
+    std::array<FloatBuffer *, MAX_STAGES> outStage{}; //< Output of the branches but the first of each level (nullptr: out)
 
-    ViVidItem(size_t id, FloatBuffer *global_frame, FloatBuffer *global_cla, int num_filters, sycl::queue &Q);
-    ViVidItem(FloatBuffer *global_frame, FloatBuffer *global_cla, int num_filters, sycl::queue &Q);
+    ViVidItem(size_t id, FrameBuffer *global_frame, FloatBuffer *global_cla, int num_filters, sycl::queue &Q, USMUsage &usage);
+    ViVidItem(FrameBuffer *global_frame, FloatBuffer *global_cla, int num_filters, sycl::queue &Q, USMUsage &usage);
     ~ViVidItem();
     void recycle();
+
+    /**
+     * @brief Give a stage its own classes and/or output buffer (see InputArgs::stageClassifiers and hasOwnOutput).
+     * @param stage Position of the stage.
+     * @param classes Classes of the stage, or nullptr to use the global ones.
+     * @param ownOutput Allocate an output buffer for the stage instead of writing the output of the item.
+     */
+    void setStageBuffers(int stage, FloatBuffer *classes, bool ownOutput);
+
+    FloatBuffer *claOf(int stage_) const { return claStage[stage_] != nullptr ? claStage[stage_] : cla; }
+    FloatBuffer *outOf(int stage_) const { return outStage[stage_] != nullptr ? outStage[stage_] : out; }
+
+    /**
+     * @brief Get the fraction of the frame processed by the stages (scales the cost of the item).
+     */
+    double activeFraction() const { return region != nullptr ? region->fraction : 1.0; }
 };
 
 } // namespace Pipeline_template
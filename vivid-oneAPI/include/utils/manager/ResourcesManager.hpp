@@ -10,6 +10,7 @@
 #include <string>
 #include <thread>
 #include <tuple>
+#include <unordered_map>
 
 class ResourcesManager {
   private:
@@ -17,6 +18,8 @@ class ResourcesManager {
     std::string name;
     bool monitoring;
     std::thread monitorThread;
+    std::unordered_map<std::thread::id, Acc> lastUsedDevice; // Last device used by each thread (per manager, so several pipelines can coexist)
+    std::mutex lastUsedDeviceMutex;                          // Mutex to protect access to lastUsedDevice map
 
     void monitorResources();
 
@@ -25,7 +28,7 @@ class ResourcesManager {
     void addDevice(const Acc &acc, std::unique_ptr<Device> device);
     ~ResourcesManager();
 
-    std::tuple<AcquisitionStatus, Acc> acquireForStage(int stageIndex, StageState stageState, Acc preferedAcc = Acc::OTHER);
+    std::tuple<AcquisitionStatus, Acc> acquireForStage(int stageIndex, StageState stageState, Acc preferedAcc = Acc::OTHER, bool allowQueue = true); // allowQueue=false: never wait in the queue of a device
     void releaseForStage(int stageIndex, Acc selectedAcc);
     void startMonitoring();
     void stopMonitoring();
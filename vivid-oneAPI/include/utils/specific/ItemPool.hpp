@@ -0,0 +1,352 @@
+/**
+ * @file ItemPool.hpp
+ * @brief Bounded lock-free MPMC pool of ViVidItem objects shared by all the pipeline backends.
+ *
+ * The pool owns every ViVidItem created for the execution. Free items are kept in a bounded
+ * multi-producer/multi-consumer ring (Vyukov's sequence-per-cell algorithm), so any thread can
+ * acquire or release an item without a serial node or a mutex around the call. Each thread also
+ * keeps a tiny private cache of recently released items to avoid touching the shared ring when
+ * the same thread releases and acquires items back to back (typical of the output -> input path
+ * in the TBB backends).
+ *
+ * The counters of acquisitions, releases and cache hits are striped per thread (one cache line per stripe, summed by
+ * getStats()), so a cache hit only touches memory of its own thread. The peak of items in use is sampled when an item
+ * is taken from the shared ring, which already touches shared state.
+ */
+
+#pragma once
+#ifndef ITEM_POOL_HPP_
+#define ITEM_POOL_HPP_
+
+#include "pipeline_template.hpp"
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <stdexcept>
+#include <thread>
+#include <vector>
+
+using namespace Pipeline_template;
+using namespace oneapi;
+
+/**
+ * @brief Occupancy statistics of the item pool.
+ */
+struct ItemPoolStats {
+    size_t capacity = 0;       ///< Number of items owned by the pool.
+    size_t acquired = 0;       ///< Total number of successful acquisitions.
+    size_t released = 0;       ///< Total number of releases.
+    size_t inUse = 0;          ///< Items currently held by the pipeline.
+    size_t peakInUse = 0;      ///< Maximum number of items out of the shared ring (held by the pipeline or parked in a per-thread cache).
+    size_t cacheHits = 0;      ///< Acquisitions served by the per-thread cache.
+    size_t failedTries = 0;    ///< Non-blocking acquisitions that found the pool empty.
+    size_t blockingWaits = 0;  ///< Blocking acquisitions that had to wait for a release.
+};
+
+class ItemPool {
+  public:
+    static constexpr size_t CACHE_SIZE = 2; ///< Maximum number of items kept in each per-thread cache.
+
+    /**
+     * @brief Creates the pool and all the items it owns.
+     * @param size_ Number of items in the pool.
+     * @param global_f Global (read only) frame buffer shared by all the items.
+     * @param global_c Global (read only) classification buffer shared by all the items.
+     * @param n_filters Number of filters in the pipeline.
+     * @param Q SYCL queue used for the USM allocations of the items.
+     * @param usage Accounting of the USM of the items (the one of the pipeline).
+     * @param reserve_ Number of free items that must stay in the shared ring before a release may be cached by the thread (usually the number of tokens).
+     */
+    explicit ItemPool(size_t size_, FrameBuffer *global_f, FloatBuffer *global_c, int n_filters, sycl::queue &Q, USMUsage &usage, size_t reserve_ = 0)
+        : size{size_}, mask{roundUpPow2(size_) - 1}, cells{std::make_unique<Cell[]>(mask + 1)}, reserve{reserve_}, poolId{nextPoolId()} {
+        if (size_ == 0) {
+            throw std::invalid_argument("ItemPool: the pool must contain at least one item");
+        }
+        for (size_t i = 0; i <= mask; ++i) {
+            cells[i].sequence.store(i, std::memory_order_relaxed);
+        }
+        items.reserve(size_);
+        for (size_t i = 0; i < size_; ++i) {
+            items.push_back(new ViVidItem(i, global_f, global_c, n_filters, Q, usage));
+            push(items.back());
+        }
+        freeItems.store(size_, std::memory_order_relaxed);
+    }
+
+    ~ItemPool() {
+        for (auto &item : items) {
+            delete item;
+        }
+    }
+
+    ItemPool(const ItemPool &) = delete;
+    ItemPool &operator=(const ItemPool &) = delete;
+
+    /**
+     * @brief Gives a stage its own classes and/or output in all the items (see ViVidItem::setStageBuffers).
+     */
+    void setStageBuffers(size_t stage, FloatBuffer *classes, bool ownOutput) {
+        for (auto &item : items) {
+            item->setStageBuffers(static_cast<int>(stage), classes, ownOutput);
+        }
+    }
+
+    /**
+     * @brief Gets a free item without blocking.
+     * @return A free item, or nullptr if the pool is empty.
+     */
+    ViVidItem *try_acquire() noexcept {
+        ViVidItem *item = tryAcquireQuiet();
+        if (item == nullptr) {
+            failedTries.fetch_add(1, std::memory_order_relaxed);
+        }
+        return item;
+    }
+
+    /**
+     * @brief Gets a free item, waiting until another thread releases one if the pool is empty.
+     * @return A free item (never nullptr).
+     */
+    ViVidItem *acquire() {
+        if (ViVidItem *item = tryAcquireQuiet()) {
+            return item;
+        }
+        blockingWaits.fetch_add(1, std::memory_order_relaxed);
+        for (int spin = 0;; ++spin) {
+            // Read the release counter before retrying so that a release between the retry and the wait is not lost
+            size_t seen = releases.load(std::memory_order_acquire);
+            if (ViVidItem *item = tryAcquireQuiet()) {
+                return item;
+            }
+            if (spin < SPIN_LIMIT) {
+                std::this_thread::yield();
+            } else {
+                releases.wait(seen, std::memory_order_acquire);
+            }
+        }
+    }
+
+    /**
+     * @brief Returns an item to the pool. The item is recycled (buffers cleared) before becoming available again.
+     * @param item Item previously obtained from acquire() or try_acquire().
+     */
+    void release(ViVidItem *item) {
+        item->recycle();
+        stripeOf(stripes.get()).released.fetch_add(1, std::memory_order_relaxed);
+        if (!pushCache(item)) {
+            pushShared(item);
+        }
+    }
+
+    /**
+     * @brief Gets the number of items owned by the pool.
+     */
+    size_t capacity() const noexcept {
+        return size;
+    }
+
+    /**
+     * @brief Gets an approximation of the number of items available in the shared ring (cached items are not counted).
+     */
+    size_t free_space() const noexcept {
+        return freeItems.load(std::memory_order_relaxed);
+    }
+
+    /**
+     * @brief Gets a snapshot of the occupancy statistics.
+     */
+    ItemPoolStats getStats() const noexcept {
+        ItemPoolStats stats;
+        stats.capacity = size;
+        for (size_t i = 0; i < STAT_STRIPES; ++i) {
+            stats.acquired += stripes[i].acquired.load(std::memory_order_relaxed);
+            stats.released += stripes[i].released.load(std::memory_order_relaxed);
+            stats.cacheHits += stripes[i].cacheHits.load(std::memory_order_relaxed);
+        }
+        // The stripes are read one by one: a release may be seen before its acquisition
+        stats.inUse = stats.acquired > stats.released ? stats.acquired - stats.released : 0;
+        stats.peakInUse = peakInUse.load(std::memory_order_relaxed);
+        stats.failedTries = failedTries.load(std::memory_order_relaxed);
+        stats.blockingWaits = blockingWaits.load(std::memory_order_relaxed);
+        return stats;
+    }
+
+  private:
+    static constexpr int SPIN_LIMIT = 64;       ///< Number of yields before sleeping on the release counter.
+    static constexpr size_t STAT_STRIPES = 64;  ///< Stripes of the counters (threads beyond this share a stripe).
+
+    struct alignas(64) Cell {
+        std::atomic<size_t> sequence{0}; //< Sequence number of the cell (Vyukov ring).
+        ViVidItem *data = nullptr;       //< Item stored in the cell.
+    };
+
+    struct alignas(64) StatStripe {
+        std::atomic<size_t> acquired{0};  //< Successful acquisitions of the threads of the stripe.
+        std::atomic<size_t> released{0};  //< Releases of the threads of the stripe.
+        std::atomic<size_t> cacheHits{0}; //< Acquisitions served by the cache of the threads of the stripe.
+    };
+
+    struct ThreadCache {
+        size_t owner = 0;                                //< Identifier of the pool owning the cached items.
+        std::weak_ptr<void> ownerAlive;                  //< Expires when the owner pool is destroyed.
+        size_t count = 0;                                //< Number of cached items.
+        std::array<ViVidItem *, CACHE_SIZE> items = {}; //< Cached items.
+    };
+
+    size_t size;                                    //< Number of items owned by the pool.
+    size_t mask;                                    //< Ring capacity - 1 (capacity is a power of two).
+    std::unique_ptr<Cell[]> cells;                  //< Ring of free items.
+    alignas(64) std::atomic<size_t> enqueuePos{0};  //< Next position to write (release).
+    alignas(64) std::atomic<size_t> dequeuePos{0};  //< Next position to read (acquire).
+    alignas(64) std::atomic<size_t> releases{0};    //< Release counter used to wake up blocked acquirers.
+    std::atomic<size_t> freeItems{0};               //< Approximate number of items in the ring.
+    std::vector<ViVidItem *> items;                 //< All the items owned by the pool.
+    size_t reserve;                                 //< Minimum number of free items in the ring before caching releases.
+    size_t poolId;                                  //< Unique identifier used to validate the per-thread caches.
+    std::shared_ptr<void> alive{std::make_shared<char>()}; //< Lets the per-thread caches know the pool still exists.
+
+    // Statistics
+    std::unique_ptr<StatStripe[]> stripes{std::make_unique<StatStripe[]>(STAT_STRIPES)};
+    std::atomic<size_t> peakInUse{0};
+    std::atomic<size_t> failedTries{0};
+    std::atomic<size_t> blockingWaits{0};
+
+    static size_t roundUpPow2(size_t n) {
+        size_t p = 1;
+        while (p < n) {
+            p <<= 1;
+        }
+        return p;
+    }
+
+    static size_t nextPoolId() {
+        static std::atomic<size_t> counter{0};
+        return ++counter;
+    }
+
+    /**
+     * @brief Returns an item to the shared ring and wakes up the blocked acquirers.
+     */
+    void pushShared(ViVidItem *item) noexcept {
+        push(item);
+        freeItems.fetch_add(1, std::memory_order_relaxed);
+        releases.fetch_add(1, std::memory_order_release);
+        releases.notify_all();
+    }
+
+    static StatStripe &stripeOf(StatStripe *stripes) noexcept {
+        static std::atomic<size_t> nextStripe{0};
+        thread_local size_t stripe = nextStripe.fetch_add(1, std::memory_order_relaxed) % STAT_STRIPES;
+        return stripes[stripe];
+    }
+
+    static ThreadCache &threadCache() {
+        thread_local ThreadCache cache;
+        return cache;
+    }
+
+    ViVidItem *tryAcquireQuiet() noexcept {
+        StatStripe &stripe = stripeOf(stripes.get());
+        ViVidItem *item = popCache();
+        if (item != nullptr) {
+            stripe.cacheHits.fetch_add(1, std::memory_order_relaxed);
+        } else {
+            item = pop();
+            if (item == nullptr) {
+                return nullptr;
+            }
+            // Sampled on the ring path only: the items out of the ring include the ones parked in the caches
+            size_t before = freeItems.fetch_sub(1, std::memory_order_relaxed);
+            size_t outOfRing = size - std::min(size, before > 0 ? before - 1 : 0);
+            size_t peak = peakInUse.load(std::memory_order_relaxed);
+            while (outOfRing > peak && !peakInUse.compare_exchange_weak(peak, outOfRing, std::memory_order_relaxed)) {
+            }
+        }
+        stripe.acquired.fetch_add(1, std::memory_order_relaxed);
+        return item;
+    }
+
+    ViVidItem *popCache() noexcept {
+        ThreadCache &cache = threadCache();
+        if (cache.owner != poolId || cache.count == 0) {
+            return nullptr;
+        }
+        return cache.items[--cache.count];
+    }
+
+    bool pushCache(ViVidItem *item) noexcept {
+        // Only keep the item private if the ring holds enough items for the other threads, otherwise a
+        // blocked acquirer could wait for an item that is parked in the cache of an idle thread.
+        if (freeItems.load(std::memory_order_relaxed) < reserve + CACHE_SIZE) {
+            return false;
+        }
+        ThreadCache &cache = threadCache();
+        if (cache.owner != poolId) {
+            // The thread may serve several pools (two pipelines in one process share the TBB workers): the cache
+            // only changes owner once it is empty or its owner is gone, so the items of another live pool are never lost
+            if (cache.count != 0 && !cache.ownerAlive.expired()) {
+                return false;
+            }
+            cache.owner = poolId;
+            cache.ownerAlive = alive;
+            cache.count = 0;
+        }
+        if (cache.count == CACHE_SIZE) {
+            return false;
+        }
+        cache.items[cache.count++] = item;
+        // The check above is a relaxed snapshot that several releasers can pass at once while the acquirers drain
+        // the ring. Check again now that the item is parked: if the ring fell below the reserve, give the cache back,
+        // so the items parked by a thread never exceed CACHE_SIZE and only stay parked while the ring held the reserve
+        if (freeItems.load(std::memory_order_relaxed) < reserve) {
+            while (cache.count > 0) {
+                pushShared(cache.items[--cache.count]);
+            }
+        }
+        return true;
+    }
+
+    void push(ViVidItem *item) noexcept {
+        size_t pos = enqueuePos.load(std::memory_order_relaxed);
+        for (;;) {
+            Cell &cell = cells[pos & mask];
+            size_t seq = cell.sequence.load(std::memory_order_acquire);
+            intptr_t diff = static_cast<intptr_t>(seq) - static_cast<intptr_t>(pos);
+            if (diff == 0) {
+                if (enqueuePos.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) {
+                    cell.data = item;
+                    cell.sequence.store(pos + 1, std::memory_order_release);
+                    return;
+                }
+            } else {
+                // The ring can never be full: it is at least as large as the number of items
+                pos = enqueuePos.load(std::memory_order_relaxed);
+            }
+        }
+    }
+
+    ViVidItem *pop() noexcept {
+        size_t pos = dequeuePos.load(std::memory_order_relaxed);
+        for (;;) {
+            Cell &cell = cells[pos & mask];
+            size_t seq = cell.sequence.load(std::memory_order_acquire);
+            intptr_t diff = static_cast<intptr_t>(seq) - static_cast<intptr_t>(pos + 1);
+            if (diff == 0) {
+                if (dequeuePos.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) {
+                    ViVidItem *item = cell.data;
+                    cell.sequence.store(pos + mask + 1, std::memory_order_release);
+                    return item;
+                }
+            } else if (diff < 0) {
+                return nullptr; // Empty
+            } else {
+                pos = dequeuePos.load(std::memory_order_relaxed);
+            }
+        }
+    }
+};
+
+#endif
@@ -0,0 +1,90 @@
+/**
+ * @file QueuePool.hpp
+ * @brief Pool of SYCL queues per device, so the kernels of different frames do not serialize behind a single queue.
+ *
+ * configureSYCLQueues creates one queue per device; with --queues N each device gets N queues on the same context (the
+ * first one is the configured queue). The input node assigns each frame a slot of the pool, round-robin or to the slot
+ * with fewer frames in flight (--queue-policy), and every stage of the frame submits to the queue of its slot on the
+ * selected device (runStage), so the chain of a frame stays on one queue and frames on different queues overlap. The
+ * slot is released when the item is recycled.
+ */
+#pragma once
+#ifndef QUEUE_POOL_HPP
+#define QUEUE_POOL_HPP
+
+#include "pipeline_template.hpp"
+#include <atomic>
+#include <cstddef>
+#include <memory>
+#include <string>
+#include <sycl/sycl.hpp>
+#include <vector>
+
+using namespace Pipeline_template;
+
+/**
+ * @brief How the input node chooses the queues of a frame.
+ */
+enum class QueuePolicy {
+    RoundRobin, ///< Each frame takes the next slot.
+    LeastLoaded ///< Each frame takes the slot with fewer frames in flight.
+};
+
+class QueuePool {
+  public:
+    /**
+     * @param gpuQueue Configured GPU queue (the first queue of the GPU).
+     * @param cpuQueue Configured CPU queue (the first queue of the CPU).
+     * @param queuesPerDevice Queues of each device.
+     * @param policy How the frames are assigned to the queues.
+     * @param inOrder Whether the added queues are in-order (the properties of profiling are those of the configured queue).
+     * @param cpuQueues The CPU queue is used by the stages (SYCL kernels or --api syclevents); otherwise only the GPU has a pool.
+     * @throws std::invalid_argument If queuesPerDevice is 0.
+     */
+    QueuePool(sycl::queue &gpuQueue, sycl::queue &cpuQueue, size_t queuesPerDevice, QueuePolicy policy, bool inOrder, bool cpuQueues);
+
+    /**
+     * @brief Assign a slot of the pool to the frame of the item.
+     */
+    void assign(ViVidItem *item);
+
+    /**
+     * @brief Release the slot of the item (when it is recycled).
+     */
+    void release(ViVidItem *item);
+
+    /**
+     * @brief Queue of the item for a stage submitted to the configured queue of a device.
+     * @return The queue of the slot of the item on that device, or `Q` itself if the item has no slot or `Q` is not a
+     * configured queue (e.g. the recording queue of StageGraphs).
+     */
+    sycl::queue &queueOf(const ViVidItem *item, sycl::queue &Q);
+
+    /**
+     * @brief Number of queues per device.
+     */
+    size_t size() const { return slots; }
+
+    /**
+     * @brief Description of the pool for the console.
+     */
+    std::string describe() const;
+
+  private:
+    struct DeviceQueues {
+        sycl::queue *configured = nullptr; //< Queue given to the pipelines
+        std::vector<sycl::queue> queues;   //< One per slot, the first one is the configured queue
+    };
+
+    size_t slots;
+    QueuePolicy policy;
+    bool inOrder;
+    DeviceQueues gpu;
+    DeviceQueues cpu;
+    std::unique_ptr<std::atomic<int>[]> load; //< Frames in flight of each slot
+    std::atomic<size_t> next{0};               //< Next slot of the round-robin
+
+    static void createQueues(DeviceQueues &device, sycl::queue &configured, size_t count, bool inOrder);
+};
+
+#endif // QUEUE_POOL_HPP
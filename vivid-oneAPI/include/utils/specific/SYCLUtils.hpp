@@ -90,8 +90,10 @@ std::string getBackendName(sycl::backend backend);
  * @param gpuQueue The SYCL queue for the GPU device.
  * @param cpuQueue The SYCL queue for the CPU device.
  * @param numThreads The number of threads to use for the CPU device.
+ * @param syclEventsEnabled Create the CPU queue even if the CPU kernels are not SYCL (syclevents API).
+ * @param quiet Do not print the devices and the properties of the queues.
  */
-void configureSYCLQueues(sycl::queue &gpuQueue, sycl::queue &cpuQueue, int numThreads, bool syclEventsEnabled = false);
+void configureSYCLQueues(sycl::queue &gpuQueue, sycl::queue &cpuQueue, int numThreads, bool syclEventsEnabled = false, bool quiet = false);
 
 /**
  * @brief Warms up the SYCL device by running a simple vector addition kernel.
@@ -0,0 +1,127 @@
+/**
+ * @file StageBatcher.hpp
+ * @brief Batches of frames launched together by the GPU stages (--gpu-batch).
+ *
+ * A GPU stage launches one kernel per frame, and at low resolutions the launch and its synchronization cost as much as
+ * the kernel, which leaves the GPU idle. With --gpu-batch B the frames that reach a GPU stage at the same time join a
+ * batch of that stage: the first one waits up to --gpu-batch-timeout for the others, and the batch is launched as a
+ * single kernel over the frames (the batched kernels of StageRegistry) as soon as it has B frames or the time is up.
+ * Every frame of the batch gets the event of the launch, as if it had launched the kernel itself, so the pipelines do
+ * not know about the batches.
+ *
+ * With --gpu-batch auto the batch grows as the frames shrink, so a launch covers about GPU_BATCH_PIXELS pixels (a
+ * 1080p frame): 8 frames of 240p, 5 of 480p, 2 of 720p and no batches from 1080p on.
+ *
+ * The frame that starts a batch keeps its thread while it waits, and the GPU must admit B frames at once (the default
+ * --coresgpu is raised to B), so a batch only fills when there are B frames in flight ready for the stage.
+ */
+#pragma once
+#ifndef STAGE_BATCHER_HPP
+#define STAGE_BATCHER_HPP
+
+#include "GlobalParameters.hpp"
+#include "SYCLUtils.hpp"
+#include "pipeline_template.hpp"
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <exception>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <sycl/sycl.hpp>
+#include <vector>
+
+class ApplicationData;
+class InputArgs;
+class Tracer;
+
+using namespace Pipeline_template;
+
+/**
+ * @brief Kernel of a stage that runs several frames with one launch on the GPU (see StageKernels::gpuBatch).
+ * The items are in the stage of the batch (item->stage) and the event is that of the launch.
+ */
+using StageBatchKernel = std::function<sycl::event(ViVidItem *const *items, std::size_t count, ApplicationData &, sycl::queue &, const std::vector<sycl::event> *)>;
+
+class StageBatcher {
+  public:
+    /**
+     * @brief Batch of --gpu-batch auto for frames of the given size.
+     */
+    static std::size_t autoSize(int height, int width);
+
+    /**
+     * @param numStages Stages of the pipeline (each one has its own batches).
+     * @param batchSize Frames of a full batch (2 to MAX_GPU_BATCH).
+     * @param timeout Time the first frame of a batch waits for the others.
+     * @throws std::invalid_argument If the batch size is out of range.
+     */
+    StageBatcher(std::size_t numStages, std::size_t batchSize, std::chrono::microseconds timeout);
+    ~StageBatcher();
+
+    StageBatcher(const StageBatcher &) = delete;
+    StageBatcher &operator=(const StageBatcher &) = delete;
+
+    /**
+     * @brief Run the stage on the item as part of a batch (called by runStage instead of the kernel of the stage).
+     * @param kernel Batched kernel of the stage.
+     * @param Q Queue of the item; the batch is launched on the queue of its first frame.
+     * @param depends_on Events the kernel must wait for (the batch waits for those of all its frames). nullptr: wait
+     * for the launch to finish before returning, as the kernels of one frame do.
+     * @return The event of the launch of the batch.
+     */
+    SyclEventInfo submit(std::size_t stage, const StageBatchKernel &kernel, ViVidItem *item, Tracer &tracer, ApplicationData &appData, InputArgs &inputArgs, sycl::queue &Q,
+                         std::vector<sycl::event> *depends_on);
+
+    /**
+     * @brief Frames of a full batch.
+     */
+    std::size_t getBatchSize() const { return batchSize; }
+
+    /**
+     * @brief Number of batches launched.
+     */
+    std::size_t getLaunches() const { return launches.load(std::memory_order_relaxed); }
+
+    /**
+     * @brief Number of frames launched in a batch.
+     */
+    std::size_t getFrames() const { return frames.load(std::memory_order_relaxed); }
+
+  private:
+    struct Batch {
+        std::array<ViVidItem *, MAX_GPU_BATCH> items{};
+        std::size_t count = 0;
+        std::vector<sycl::event> depends_on; //< Events of all the frames (keeps its capacity)
+        sycl::queue *Q = nullptr;
+        std::chrono::steady_clock::time_point deadline;
+        bool closed = false;  //< No more frames join (it is being launched)
+        bool done = false;    //< The launch has returned
+        sycl::event event;
+        std::exception_ptr error;
+        std::size_t waiting = 0; //< Frames that have not taken the event yet
+    };
+
+    // Batches of a stage: the one that admits frames and the ones that are being launched or read
+    struct Stage {
+        std::mutex mutex;
+        std::condition_variable changed;
+        Batch *open = nullptr;
+        std::vector<std::unique_ptr<Batch>> batches; //< Owned, reused once read by all their frames
+        std::vector<Batch *> spare;
+    };
+
+    std::size_t batchSize;
+    std::chrono::microseconds timeout;
+    std::vector<std::unique_ptr<Stage>> stages;
+    std::atomic<std::size_t> launches{0};
+    std::atomic<std::size_t> frames{0};
+
+    Batch *takeBatch(Stage &stage);
+    void launch(Stage &stage, Batch *batch, const StageBatchKernel &kernel, ApplicationData &appData, std::unique_lock<std::mutex> &lock);
+};
+
+#endif // STAGE_BATCHER_HPP
@@ -0,0 +1,120 @@
+/**
+ * @file StageGraphs.hpp
+ * @brief Recorded SYCL graphs of the frames whose stages all run on the GPU (--gpu-graph, --api syclevents).
+ *
+ * A frame of the SYCL events pipeline submits one command group per stage, and the runtime analyses the dependencies of
+ * each one; at low resolutions that costs as much as the kernels. With --gpu-graph the stages of a frame that runs whole
+ * on the GPU are recorded as a command_graph, and the next frames replay it with a single submission. The kernels
+ * capture the buffers of the item, its input frame and its active region. Each item keeps a graph per slot of the input
+ * ring (--input), so the frames it takes from the ring replay the graphs it already has; a graph is only recorded again
+ * when the region changes (--roi, --reuse). If most of the frames must record their graph again, replaying them costs
+ * more than it saves, so the graphs are disabled and the reason is logged.
+ *
+ * Graphs need the sycl_ext_oneapi_graph extension and a GPU whose backend supports them. Otherwise (the CPU OpenCL
+ * device, an older compiler, the builds that profile each stage) or if a graph fails to record or run, the frames are
+ * submitted stage by stage as before.
+ */
+#pragma once
+#ifndef STAGE_GRAPHS_HPP
+#define STAGE_GRAPHS_HPP
+
+#include "ApplicationData.hpp"
+#include "RoiList.hpp"
+#include "pipeline_template.hpp"
+#include <atomic>
+#include <cstddef>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <sycl/sycl.hpp>
+#include <type_traits>
+#include <unordered_map>
+
+class StageGraphs {
+  public:
+    /**
+     * @brief Check whether the frames submitted to the queue can be replayed as graphs.
+     * @param reason Why not, if they cannot.
+     */
+    static bool supported(const sycl::queue &Q, std::string &reason);
+
+    /**
+     * @param Q_ Queue that replays the graphs (the GPU queue of the pipeline, or the queue of the frame with --queues).
+     * @param frameSlots_ Slots of the input ring the items take their frames from (0: the items keep the global frame).
+     */
+    StageGraphs(sycl::queue &Q_, size_t frameSlots_);
+    ~StageGraphs();
+
+    StageGraphs(const StageGraphs &) = delete;
+    StageGraphs &operator=(const StageGraphs &) = delete;
+
+    /**
+     * @brief Replay the graph of the item for its ring slot, recording it first if there is none or the region changed.
+     * @param record Called as record(queue) to submit the stages of the item to the recording queue (nothing runs).
+     * @param event Event of the replay.
+     * @return false if graphs are not usable (they are disabled from then on): the caller submits the stages itself.
+     */
+    template <typename Record>
+    bool replay(ViVidItem *item, ApplicationData &appData, Record &&record, sycl::event &event) {
+        using RecordType = std::remove_reference_t<Record>;
+        return replayGraph(item, appData, [](void *context, sycl::queue &Q) { (*static_cast<RecordType *>(context))(Q); }, &record, event);
+    }
+
+    /**
+     * @brief Number of graphs recorded.
+     */
+    size_t getRecorded() const { return recorded.load(std::memory_order_relaxed); }
+
+    /**
+     * @brief Number of graphs recorded again because the region of their slot changed.
+     */
+    size_t getRerecorded() const { return rerecorded.load(std::memory_order_relaxed); }
+
+    /**
+     * @brief Number of frames submitted as a graph.
+     */
+    size_t getReplayed() const { return replayed.load(std::memory_order_relaxed); }
+
+  private:
+    using RecordFn = void (*)(void *context, sycl::queue &Q);
+
+    static constexpr size_t HIT_WINDOW = 256;            //< Frames whose slot had a graph, counted together
+    static constexpr size_t MAX_MISSES = HIT_WINDOW / 2; //< Graphs recorded again in a window before they are disabled
+
+    // What the kernels read besides the buffers of the item: a graph is valid while it does not change
+    struct Key {
+        const void *frame = nullptr;
+        bool hasRegion = false;
+        Rect pixels;
+        Rect cells;
+        size_t firstCell = 0;
+        size_t endCell = 0;
+    };
+    struct Graph;
+    struct Slot;
+
+    sycl::queue &Q;
+    size_t frameSlots;
+    sycl::queue recordQueue;                                       //< Only used to record, one graph at a time
+    std::mutex recordMutex;
+    std::mutex slotsMutex;
+    std::unordered_map<const ViVidItem *, std::unique_ptr<Slot>> slots; //< Graphs of each item of the pool
+    std::atomic<bool> active{true};
+    std::atomic<size_t> recorded{0};
+    std::atomic<size_t> rerecorded{0};
+    std::atomic<size_t> replayed{0};
+    std::atomic<size_t> windowFrames{0}; //< Frames of the current window of HIT_WINDOW
+    std::atomic<size_t> windowMisses{0}; //< Graphs recorded again in the current window
+
+    bool replayGraph(ViVidItem *item, ApplicationData &appData, RecordFn record, void *context, sycl::event &event);
+    static Key keyOf(ViVidItem *item, ApplicationData &appData);
+    static bool sameKey(const Key &a, const Key &b);
+
+    /**
+     * @brief Count a frame whose slot already had a graph; disables the graphs if too many had to be recorded again.
+     * @return false if the graphs have been disabled.
+     */
+    bool countHit(bool hit);
+};
+
+#endif // STAGE_GRAPHS_HPP
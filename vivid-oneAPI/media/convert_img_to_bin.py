@@ -1,53 +1,131 @@
-import cv2
-import numpy as np
+"""Convert images or videos to the ViVid frame container (.bin).
+
+Layout (little endian, see include/utils/general/FrameContainer.hpp):
+    64 byte header: magic "VVDF", version, header size, width, height, channels, pixel type,
+                    frame count, offset of the frame offset table, offset of the checksum table
+    frames (each one starting at a multiple of --align bytes, 4096 by default, so they can be read with O_DIRECT)
+    frame offset table (uint64 per frame)
+    checksum table (CRC-32 per frame, optional)
+
+The pixels are stored as float32 (default), uint8 or uint16 (--dtype). The values are not rescaled, so an
+8-bit source gives the same results in the pipeline with any of the three types; uint8 needs 4x less
+storage and bandwidth than float32.
+"""
+import argparse
+import os
+import struct
 import sys
+import zlib
 
-def write_raw_image(image, filename):
-    try:
-        with open(filename, 'wb') as file:
-            rows, cols = image.shape
-            depth = image.dtype
-            channels = 1  # Grayscale image has only 1 channel
-
-            file.write(np.int32(rows).tobytes())
-            file.write(np.int32(cols).tobytes())
-            file.write(np.int32(cv2.CV_32F).tobytes())  # Write the OpenCV depth constant
-            file.write(np.int32(cv2.CV_32F).tobytes())  # Write the OpenCV type constant
-            file.write(np.int32(channels).tobytes())
-
-            size_in_bytes = image.nbytes
-            file.write(np.int32(size_in_bytes).tobytes())
-            file.write(image.tobytes())
-    except Exception as e:
-        print(f"Error while writing raw image: {e}")
-        return False
-    return True
+MAGIC = b"VVDF"
+VERSION = 1
+HEADER_FORMAT = "<4sHHIIIIQQQI12x"
+HEADER_SIZE = struct.calcsize(HEADER_FORMAT)  # 64 bytes
+FRAME_ALIGNMENT = 4096
+PIXEL_TYPES = {"float32": 1, "uint8": 2, "uint16": 3}
+IMAGE_EXTENSIONS = {".bmp", ".jpg", ".jpeg", ".png", ".tif", ".tiff", ".pgm", ".ppm"}
 
-def main(argv):
-    if len(argv) < 3:
-        print("Usage: python convert_image_to_bin.py <image_path> <output_bin_path>")
-        return -1
 
-    example_image_path = argv[1]
+class FrameWriter:
+    """Streams frames to a container; the tables and the final header are written by close()."""
+
+    def __init__(self, filename, width, height, channels=1, pixel_type="float32", checksums=True, alignment=FRAME_ALIGNMENT):
+        self.file = open(filename, "wb")
+        self.alignment = alignment
+        self.width = width
+        self.height = height
+        self.channels = channels
+        self.pixel_type = pixel_type
+        self.checksums = [] if checksums else None
+        self.offsets = []
+        self.file.write(bytes(HEADER_SIZE))  # Placeholder, rewritten by close()
+
+    def write_frame(self, data):
+        padding = -self.file.tell() % self.alignment
+        self.file.write(bytes(padding))
+        self.offsets.append(self.file.tell())
+        self.file.write(data)
+        if self.checksums is not None:
+            self.checksums.append(zlib.crc32(data) & 0xFFFFFFFF)
+
+    def close(self):
+        offset_table = self.file.tell()
+        self.file.write(struct.pack(f"<{len(self.offsets)}Q", *self.offsets))
+        checksum_table = 0
+        if self.checksums is not None:
+            checksum_table = self.file.tell()
+            self.file.write(struct.pack(f"<{len(self.checksums)}I", *self.checksums))
+        header = struct.pack(HEADER_FORMAT, MAGIC, VERSION, HEADER_SIZE, self.width, self.height, self.channels,
+                             PIXEL_TYPES[self.pixel_type], len(self.offsets), offset_table, checksum_table, 0)
+        self.file.seek(0)
+        self.file.write(header)
+        self.file.close()
 
-    example_image = cv2.imread(example_image_path, cv2.IMREAD_GRAYSCALE)
 
-    if example_image is None:
-        print("Could not open or find the image")
-        return -1
+def read_frames(path, keep_depth=False):
+    """Yield the frames of an image or a video as grayscale images (16-bit images keep their depth if keep_depth)."""
+    import cv2
 
-    example_image = example_image.astype(np.float32)
+    if os.path.splitext(path)[1].lower() in IMAGE_EXTENSIONS:
+        flags = cv2.IMREAD_GRAYSCALE | (cv2.IMREAD_ANYDEPTH if keep_depth else 0)
+        image = cv2.imread(path, flags)
+        if image is None:
+            raise IOError(f"Could not open or find the image {path}")
+        yield image
+        return
 
-    height, width = example_image.shape
+    video = cv2.VideoCapture(path)
+    if not video.isOpened():
+        raise IOError(f"Could not open the video {path}")
+    while True:
+        ok, frame = video.read()
+        if not ok:
+            break
+        yield cv2.cvtColor(frame, cv2.COLOR_BGR2GRAY)
+    video.release()
 
-    print(f"Width={width}; Height={height}")
 
-    if write_raw_image(example_image, argv[2]):
-        print("OK!")
-        return 0
-    else:
-        print("Error!")
+def main(argv):
+    import numpy as np
+
+    parser = argparse.ArgumentParser(description="Convert images or videos to the ViVid frame container (.bin)")
+    parser.add_argument("inputs", nargs="+", help="Images or videos (in order), the last argument is the output .bin")
+    parser.add_argument("--no-checksum", action="store_true", help="Do not store the CRC-32 of each frame")
+    parser.add_argument("--align", type=int, default=FRAME_ALIGNMENT, help="Alignment of the frames in the file in bytes (default: 4096, 1: no padding)")
+    parser.add_argument("--dtype", choices=PIXEL_TYPES.keys(), default="float32", help="Type of the stored pixels (default: float32)")
+    args = parser.parse_args(argv[1:])
+    if args.align < 1:
+        parser.error("--align must be at least 1")
+    if len(args.inputs) < 2:
+        parser.error("Usage: python convert_img_to_bin.py <image_or_video> [...] <output_bin_path>")
+    inputs, output = args.inputs[:-1], args.inputs[-1]
+
+    dtype = {"float32": np.float32, "uint8": np.uint8, "uint16": np.uint16}[args.dtype]
+    writer = None
+    try:
+        for path in inputs:
+            for frame in read_frames(path, keep_depth=args.dtype != "uint8"):
+                if np.dtype(dtype).kind == "u" and frame.max(initial=0) > np.iinfo(dtype).max:
+                    raise ValueError(f"{path}: pixel values do not fit in {args.dtype}")
+                frame = np.ascontiguousarray(frame, dtype=dtype)
+                height, width = frame.shape
+                if writer is None:
+                    print(f"Width={width}; Height={height}; Pixels={args.dtype}")
+                    writer = FrameWriter(output, width, height, pixel_type=args.dtype, checksums=not args.no_checksum,
+                                         alignment=args.align)
+                elif (width, height) != (writer.width, writer.height):
+                    raise ValueError(f"{path}: frame size {width}x{height} differs from {writer.width}x{writer.height}")
+                writer.write_frame(frame.tobytes())
+        if writer is None:
+            raise ValueError("No frames found in the inputs")
+        writer.close()
+    except Exception as e:
+        print(f"Error while writing the frame container: {e}")
         return 1
 
+    print(f"OK! {len(writer.offsets)} frame(s) written to {output}")
+    return 0
+
+
 if __name__ == "__main__":
     sys.exit(main(sys.argv))
@@ -0,0 +1,68 @@
+#!/bin/bash
+
+# *********************************************************************************************************************************************************************************
+# USAGE: ./bench_apis.sh [frames in flight...]
+# *********************************************************************************************************************************************************************************
+# Throughput of every --api with the same threads and stages, for several numbers of frames in flight (--iff). The
+# coroutine backend (coro) keeps the number of threads fixed as --iff grows; the others need a thread (or a task) per
+# frame that waits. The binary must have been built (make).
+#
+# Environment variables:
+#   APIS        Backends to compare (default: pipeline fgfn fgan syclevents taskflow coro)
+#   THREADS     Threads of the CPU (default: 8)
+#   CONFIG      Configuration of the stages (default: 111, CPU+GPU in every stage)
+#   RESOLUTION  Image resolution (default: 1, 1080p)
+#   NUMFRAMES   Frames per run (default: 400)
+#   REPEAT      Runs per configuration, the best one is reported (default: 3)
+
+SCRIPT_DIR=$(cd "$(dirname "$0")" && pwd)
+MAIN="${SCRIPT_DIR}/../main"
+
+read -r -a APIS <<< "${APIS:-pipeline fgfn fgan syclevents taskflow coro}"
+THREADS=${THREADS:-8}
+CONFIG=${CONFIG:-111}
+RESOLUTION=${RESOLUTION:-1}
+NUMFRAMES=${NUMFRAMES:-400}
+REPEAT=${REPEAT:-3}
+
+if [ ! -x "$MAIN" ]; then
+    echo "Error: ${MAIN} not found, build it first with make"
+    exit 1
+fi
+
+if [ $# -gt 0 ]; then
+    frames_in_flight=("$@")
+else
+    frames_in_flight=("8" "64" "1024")
+fi
+
+# Best throughput (FPS) of REPEAT runs of an API with the given frames in flight
+best_throughput() {
+    local api=$1
+    local iff=$2
+    local best=0
+    for ((i = 0; i < REPEAT; i++)); do
+        local fps
+        fps=$("$MAIN" --api "$api" --threads "$THREADS" --iff "$iff" --resolution "$RESOLUTION" --numframes "$NUMFRAMES" --config "$CONFIG" | awk '/^ Throughput:/ {print $2; exit}')
+        if [ -z "$fps" ]; then
+            echo "Error: no throughput reported by: main --api $api --iff $iff" >&2
+            exit 1
+        fi
+        best=$(awk -v a="$best" -v b="$fps" 'BEGIN {print (b > a) ? b : a}')
+    done
+    echo "$best"
+}
+
+printf "%-8s" "IFF"
+for api in "${APIS[@]}"; do
+    printf " %-12s" "$api"
+done
+printf "\n"
+for iff in "${frames_in_flight[@]}"; do
+    printf "%-8s" "$iff"
+    for api in "${APIS[@]}"; do
+        fps=$(best_throughput "$api" "$iff") || exit 1
+        printf " %-12s" "$fps"
+    done
+    printf "\n"
+done
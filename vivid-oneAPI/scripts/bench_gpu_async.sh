@@ -0,0 +1,55 @@
+#!/bin/bash
+
+# *********************************************************************************************************************************************************************************
+# USAGE: ./bench_gpu_async.sh [threads...]
+# *********************************************************************************************************************************************************************************
+# Throughput of --api pipeline with the same number of threads when the GPU stages keep their worker waiting
+# (--gpu-blocking) and when they release it to the CPU path (default). The binary must have been built (make).
+#
+# Environment variables:
+#   CONFIG      Configuration of the stages (default: 111, CPU+GPU in every stage)
+#   RESOLUTION  Image resolution (default: 1, 1080p)
+#   NUMFRAMES   Frames per run (default: 400)
+#   REPEAT      Runs per configuration, the best one is reported (default: 3)
+
+SCRIPT_DIR=$(cd "$(dirname "$0")" && pwd)
+MAIN="${SCRIPT_DIR}/../main"
+
+CONFIG=${CONFIG:-111}
+RESOLUTION=${RESOLUTION:-1}
+NUMFRAMES=${NUMFRAMES:-400}
+REPEAT=${REPEAT:-3}
+
+if [ ! -x "$MAIN" ]; then
+    echo "Error: ${MAIN} not found, build it first with make"
+    exit 1
+fi
+
+if [ $# -gt 0 ]; then
+    num_threads=("$@")
+else
+    num_threads=("2" "4" "8")
+fi
+
+# Best throughput (FPS) of REPEAT runs with the given extra arguments
+best_throughput() {
+    local best=0
+    for ((i = 0; i < REPEAT; i++)); do
+        local fps
+        fps=$("$MAIN" --api pipeline --resolution "$RESOLUTION" --numframes "$NUMFRAMES" --config "$CONFIG" "$@" | awk '/^ Throughput:/ {print $2; exit}')
+        if [ -z "$fps" ]; then
+            echo "Error: no throughput reported by: main $*" >&2
+            exit 1
+        fi
+        best=$(awk -v a="$best" -v b="$fps" 'BEGIN {print (b > a) ? b : a}')
+    done
+    echo "$best"
+}
+
+printf "%-8s %-14s %-14s %-8s\n" "Threads" "Blocking FPS" "Released FPS" "Speedup"
+for nthreads in "${num_threads[@]}"; do
+    blocking=$(best_throughput --threads "$nthreads" --gpu-blocking) || exit 1
+    released=$(best_throughput --threads "$nthreads") || exit 1
+    speedup=$(awk -v a="$blocking" -v b="$released" 'BEGIN {printf "%.2f", (a > 0) ? b / a : 0}')
+    printf "%-8s %-14s %-14s %-8s\n" "$nthreads" "$blocking" "$released" "${speedup}x"
+done
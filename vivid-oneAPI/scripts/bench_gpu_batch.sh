@@ -0,0 +1,81 @@
+#!/bin/bash
+
+# *********************************************************************************************************************************************************************************
+# USAGE: ./bench_gpu_batch.sh [batch sizes...]
+# *********************************************************************************************************************************************************************************
+# Throughput of the GPU stages launched one frame at a time and in batches of several frames (--gpu-batch). The
+# batches pay off at low resolutions: give a small input with INPUT (and INPUT_SIZE for a raw video), otherwise the
+# example image of RESOLUTION is used. The binary must have been built (make).
+#
+# Environment variables:
+#   API         Backend (default: pipeline)
+#   THREADS     Threads of the CPU (default: 8)
+#   IFF         Frames in flight, at least the largest batch (default: 16)
+#   CONFIG      Configuration of the stages (default: 222, GPU in every stage)
+#   RESOLUTION  Image resolution when there is no INPUT (default: 0, 720p)
+#   INPUT       Multi-frame input (--input), e.g. a 240p or 480p raw video
+#   INPUT_SIZE  Size of a raw INPUT (--input-size), e.g. 426x240
+#   TIMEOUT     Time a batch waits for more frames, in microseconds (default: that of the build)
+#   NUMFRAMES   Frames per run (default: 1000)
+#   REPEAT      Runs per configuration, the best one is reported (default: 3)
+
+SCRIPT_DIR=$(cd "$(dirname "$0")" && pwd)
+MAIN="${SCRIPT_DIR}/../main"
+
+API=${API:-pipeline}
+THREADS=${THREADS:-8}
+IFF=${IFF:-16}
+CONFIG=${CONFIG:-222}
+RESOLUTION=${RESOLUTION:-0}
+NUMFRAMES=${NUMFRAMES:-1000}
+REPEAT=${REPEAT:-3}
+
+if [ ! -x "$MAIN" ]; then
+    echo "Error: ${MAIN} not found, build it first with make"
+    exit 1
+fi
+
+if [ $# -gt 0 ]; then
+    batches=("$@")
+else
+    batches=("1" "2" "4" "8" "auto")
+fi
+
+common=(--api "$API" --threads "$THREADS" --iff "$IFF" --numframes "$NUMFRAMES" --config "$CONFIG")
+if [ -n "$INPUT" ]; then
+    common+=(--input "$INPUT")
+    if [ -n "$INPUT_SIZE" ]; then
+        common+=(--input-size "$INPUT_SIZE")
+    fi
+else
+    common+=(--resolution "$RESOLUTION")
+fi
+
+# Best throughput (FPS) of REPEAT runs with the given batch size
+best_throughput() {
+    local batch=$1
+    local extra=()
+    if [ "$batch" != "1" ]; then
+        extra=(--gpu-batch "$batch")
+        if [ -n "$TIMEOUT" ]; then
+            extra+=(--gpu-batch-timeout "$TIMEOUT")
+        fi
+    fi
+    local best=0
+    for ((i = 0; i < REPEAT; i++)); do
+        local fps
+        fps=$("$MAIN" "${common[@]}" "${extra[@]}" | awk '/^ Throughput:/ {print $2; exit}')
+        if [ -z "$fps" ]; then
+            echo "Error: no throughput reported by: main ${common[*]} ${extra[*]}" >&2
+            exit 1
+        fi
+        best=$(awk -v a="$best" -v b="$fps" 'BEGIN {print (b > a) ? b : a}')
+    done
+    echo "$best"
+}
+
+printf "%-8s %-12s\n" "Batch" "FPS"
+for batch in "${batches[@]}"; do
+    fps=$(best_throughput "$batch") || exit 1
+    printf "%-8s %-12s\n" "$batch" "$fps"
+done
@@ -0,0 +1,70 @@
+#!/bin/bash
+
+# *********************************************************************************************************************************************************************************
+# USAGE: ./bench_queues.sh [queues per device...]
+# *********************************************************************************************************************************************************************************
+# Throughput of --api syclevents with one or several SYCL queues per device (--queues), with the frames assigned
+# round-robin (rr) and to the least loaded queue (least). The default configuration runs every stage on the CPU device,
+# so it can be measured without a GPU; build it with make SYCL=1 so the stages of the CPU are SYCL kernels.
+#
+# Environment variables:
+#   THREADS     Threads of the CPU (default: 8)
+#   IFF         Frames in flight (default: 8)
+#   CONFIG      Configuration of the stages (default: 000, CPU in every stage)
+#   ORDER       Order of the added queues, in or out (default: that of the build)
+#   RESOLUTION  Image resolution (default: 1, 1080p)
+#   NUMFRAMES   Frames per run (default: 400)
+#   REPEAT      Runs per configuration, the best one is reported (default: 3)
+
+SCRIPT_DIR=$(cd "$(dirname "$0")" && pwd)
+MAIN="${SCRIPT_DIR}/../main"
+
+THREADS=${THREADS:-8}
+IFF=${IFF:-8}
+CONFIG=${CONFIG:-000}
+RESOLUTION=${RESOLUTION:-1}
+NUMFRAMES=${NUMFRAMES:-400}
+REPEAT=${REPEAT:-3}
+
+if [ ! -x "$MAIN" ]; then
+    echo "Error: ${MAIN} not found, build it first with make SYCL=1"
+    exit 1
+fi
+
+if [ $# -gt 0 ]; then
+    queues=("$@")
+else
+    queues=("1" "2" "4")
+fi
+
+# Best throughput (FPS) of REPEAT runs with the given extra arguments
+best_throughput() {
+    local best=0
+    for ((i = 0; i < REPEAT; i++)); do
+        local fps
+        fps=$("$MAIN" --api syclevents --threads "$THREADS" --iff "$IFF" --resolution "$RESOLUTION" --numframes "$NUMFRAMES" --config "$CONFIG" "$@" | awk '/^ Throughput:/ {print $2; exit}')
+        if [ -z "$fps" ]; then
+            echo "Error: no throughput reported by: main --api syclevents $*" >&2
+            exit 1
+        fi
+        best=$(awk -v a="$best" -v b="$fps" 'BEGIN {print (b > a) ? b : a}')
+    done
+    echo "$best"
+}
+
+printf "%-8s %-12s %-12s\n" "Queues" "rr" "least"
+for n in "${queues[@]}"; do
+    if [ "$n" -eq 1 ]; then
+        # A single queue per device: the policy does not apply
+        fps=$(best_throughput) || exit 1
+        printf "%-8s %-12s %-12s\n" "$n" "$fps" "$fps"
+        continue
+    fi
+    extra=(--queues "$n")
+    if [ -n "$ORDER" ]; then
+        extra+=(--queue-order "$ORDER")
+    fi
+    rr=$(best_throughput "${extra[@]}" --queue-policy rr) || exit 1
+    least=$(best_throughput "${extra[@]}" --queue-policy least) || exit 1
+    printf "%-8s %-12s %-12s\n" "$n" "$rr" "$least"
+done
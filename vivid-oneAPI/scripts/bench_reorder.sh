@@ -0,0 +1,58 @@
+#!/bin/bash
+
+# *********************************************************************************************************************************************************************************
+# USAGE: ./bench_reorder.sh [api...]
+# *********************************************************************************************************************************************************************************
+# Cost of delivering the frames in the order of their ids (--reorder) on the backends that release them out of order:
+# throughput without and with the reorder buffer, and the head-of-line blocking it reports (frames held behind an older
+# one, mean depth and total time they waited).
+#
+# Environment variables:
+#   THREADS     Threads of the CPU (default: 8)
+#   IFF         Frames in flight (default: 8)
+#   CONFIG      Configuration of the stages (default: 000)
+#   GAP         Gap policy of --reorder, wait or skip (default: wait)
+#   RESOLUTION  Image resolution (default: 1, 1080p)
+#   NUMFRAMES   Frames per run (default: 400)
+
+SCRIPT_DIR=$(cd "$(dirname "$0")" && pwd)
+MAIN="${SCRIPT_DIR}/../main"
+
+THREADS=${THREADS:-8}
+IFF=${IFF:-8}
+CONFIG=${CONFIG:-000}
+GAP=${GAP:-wait}
+RESOLUTION=${RESOLUTION:-1}
+NUMFRAMES=${NUMFRAMES:-400}
+
+if [ ! -x "$MAIN" ]; then
+    echo "Error: ${MAIN} not found, build it first with make"
+    exit 1
+fi
+
+if [ $# -gt 0 ]; then
+    apis=("$@")
+else
+    apis=("pipeline" "fgfn" "fgan" "taskflow" "coro")
+fi
+
+run() {
+    local api=$1
+    shift
+    "$MAIN" --api "$api" --threads "$THREADS" --iff "$IFF" --resolution "$RESOLUTION" --numframes "$NUMFRAMES" --config "$CONFIG" "$@"
+}
+
+printf "%-10s %-12s %-12s %-10s %-10s %-12s\n" "API" "FPS" "FPS reorder" "Held" "Depth" "Blocked ms"
+for api in "${apis[@]}"; do
+    base=$(run "$api" | awk '/^ Throughput:/ {print $2; exit}')
+    output=$(run "$api" --reorder --reorder-gap "$GAP")
+    if [ -z "$base" ] || [ -z "$output" ]; then
+        echo "Error: main --api $api did not finish" >&2
+        exit 1
+    fi
+    fps=$(echo "$output" | awk '/^ Throughput:/ {print $2; exit}')
+    held=$(echo "$output" | awk '/^ Blocking:/ {print $2; exit}')
+    depth=$(echo "$output" | awk '/^ Depth:/ {print $2; exit}')
+    blocked=$(echo "$output" | awk '/^ Blocking:/ {for (i = 1; i <= NF; i++) if ($i == "ms") {print $(i - 1); exit}}')
+    printf "%-10s %-12s %-12s %-10s %-10s %-12s\n" "$api" "$base" "$fps" "$held" "$depth" "$blocked"
+done
@@ -20,7 +20,7 @@ flag_configs=(  ["CONFIG"]="CSV=1" ["TIMESTAGES"]="CSV=1 TIMESTAGES=1" )
 # GLOBAL VARIABLES
 # *********************************************************************************************************************************************************************************
 # List of executables:
-API_executables=("pipeline" "fgfn" "fgan" "syclevents" "taskflow")
+API_executables=("pipeline" "fgfn" "fgan" "syclevents" "taskflow" "coro")
 
 # Number of frames and image resolution: 
 declare -A img_res_and_frames
@@ -0,0 +1,448 @@
+#include "vivid.h"
+#include "ApplicationData.hpp"
+#include "DataBuffers.hpp"
+#include "FrameSource.hpp"
+#include "GlobalParameters.hpp"
+#include "InputArgs.hpp"
+#include "ItemPool.hpp"
+#include "PipelineFactory.hpp"
+#include "PipelineRuntime.hpp"
+#include "ReorderBuffer.hpp"
+#include "ResultSink.hpp"
+#include "SYCLUtils.hpp"
+#include "Tracer.hpp"
+#include <algorithm>
+#include <chrono>
+#include <climits>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdio>
+#include <cstring>
+#include <exception>
+#include <memory>
+#include <mutex>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <type_traits>
+#include <vector>
+#include <sycl/sycl.hpp>
+#include <tbb/tick_count.h>
+
+// The detections of the sink are handed to the application without a copy
+static_assert(std::is_standard_layout_v<Detection> && sizeof(vivid_detection) == sizeof(Detection), "vivid_detection must match Detection");
+static_assert(offsetof(vivid_detection, x) == offsetof(Detection, x) && offsetof(vivid_detection, y) == offsetof(Detection, y) &&
+                  offsetof(vivid_detection, cls) == offsetof(Detection, cls) && offsetof(vivid_detection, score) == offsetof(Detection, score),
+              "vivid_detection must match Detection");
+static_assert(VIVID_PIXEL_FLOAT32 == static_cast<int>(PixelType::Float32) && VIVID_PIXEL_UINT8 == static_cast<int>(PixelType::UInt8) &&
+                  VIVID_PIXEL_UINT16 == static_cast<int>(PixelType::UInt16),
+              "vivid_pixel_type must match PixelType");
+
+namespace {
+constexpr const char *API_NAMES[] = {"pipeline", "fgfn", "fgan", "syclevents", "taskflow", "serie", "coro"}; //< --api of each vivid_api
+
+void copyError(char *error, size_t errorSize, const std::string &message) {
+    if (error != nullptr && errorSize > 0) {
+        std::snprintf(error, errorSize, "%s", message.c_str());
+    }
+}
+
+vivid_status statusOf(const std::exception &e) {
+    return dynamic_cast<const std::invalid_argument *>(&e) != nullptr ? VIVID_ERROR_INVALID_ARGUMENT : VIVID_ERROR_RUNTIME;
+}
+} // namespace
+
+/**
+ * @brief Everything a pipeline needs, so several pipelines can run in the same process (what main() keeps in locals).
+ *
+ * The runner thread executes the pipeline until the input is closed. The results are handed by the writer thread of
+ * the result sink either to the callback of the application or to a ring of result_depth results read by vivid_poll().
+ */
+struct vivid_pipeline {
+    struct PolledResult {
+        uint64_t frameId = 0;
+        size_t count = 0;
+        std::vector<vivid_detection> detections; //< Preallocated to top_k
+    };
+
+    vivid_config config;
+    ApplicationData appData;
+    std::unique_ptr<InputArgs> inputArgs;
+    sycl::queue Q_GPU, Q_CPU;
+    std::unique_ptr<ItemPool> bufferItems;
+    std::unique_ptr<FrameSource> frameSource;
+    std::unique_ptr<ResultSink> resultSink;
+    std::unique_ptr<ReorderBuffer> reorderBuffer;
+    PipelineRuntime runtime; //< The components above, attached to the pipeline
+    std::unique_ptr<PipelineInterface> pipeline;
+    Tracer traceFile;
+    std::thread runner;
+
+    // Results waiting for vivid_poll() (protected by mutex)
+    std::vector<PolledResult> results;
+    size_t head = 0;   //< Oldest result
+    size_t queued = 0; //< Results in the ring
+    std::vector<vivid_detection> polled; //< Detections of the last polled result (owned by the application until the next poll)
+    std::mutex mutex;
+    std::condition_variable resultReady;
+    std::condition_variable resultTaken;
+    bool drained = false;    //< Closed and every result delivered
+    bool discarding = false; //< Being destroyed: the results that do not fit are dropped instead of waiting
+    std::exception_ptr error;
+    std::string lastError;
+
+    std::mutex closeMutex; //< Serialises vivid_close()
+    bool closed = false;
+    tbb::tick_count created, closedAt;
+
+    ~vivid_pipeline() {
+        // The pipeline and the buffers of the items use the queues and the global frame: release them first
+        pipeline.reset();
+        resultSink.reset();
+        reorderBuffer.reset();
+        frameSource.reset();
+        bufferItems.reset();
+        delete appData.globalFrame;
+        delete appData.globalCla;
+        for (auto cla : appData.stageCla) {
+            delete cla;
+        }
+    }
+
+    void fail(std::exception_ptr e) {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            if (!error) {
+                error = e;
+                try {
+                    std::rethrow_exception(e);
+                } catch (const std::exception &ex) {
+                    lastError = ex.what();
+                } catch (...) {
+                    lastError = "unknown error";
+                }
+            }
+        }
+        resultReady.notify_all();
+    }
+
+    bool failed() {
+        std::lock_guard<std::mutex> lock(mutex);
+        return error != nullptr;
+    }
+
+    /**
+     * @brief Hand the detections of a frame to the application (called by the writer thread of the sink).
+     */
+    void deliver(uint64_t frameId, const Detection *detections, size_t count) {
+        if (config.callback != nullptr) {
+            vivid_result result{frameId, static_cast<uint32_t>(count), reinterpret_cast<const vivid_detection *>(detections)};
+            config.callback(&result, config.user_data);
+            return;
+        }
+        std::unique_lock<std::mutex> lock(mutex);
+        // A full ring holds the writer thread, which fills the queue of the sink (and drops there with drop_results)
+        resultTaken.wait(lock, [this] { return queued < results.size() || discarding; });
+        if (discarding) {
+            return;
+        }
+        PolledResult &slot = results[(head + queued) % results.size()];
+        slot.frameId = frameId;
+        slot.count = count;
+        std::memcpy(slot.detections.data(), detections, count * sizeof(vivid_detection));
+        queued++;
+        lock.unlock();
+        resultReady.notify_one();
+    }
+};
+
+uint32_t vivid_version(void) {
+    return (VIVID_VERSION_MAJOR << 16) | VIVID_VERSION_MINOR;
+}
+
+void vivid_config_init(vivid_config *config) {
+    if (config == nullptr) {
+        return;
+    }
+    std::memset(config, 0, sizeof(*config));
+    config->struct_size = sizeof(vivid_config);
+    config->api = VIVID_API_PIPELINE;
+    config->pixel_type = VIVID_PIXEL_FLOAT32;
+}
+
+vivid_status vivid_create(const vivid_config *config, vivid_pipeline **pipeline, char *error, size_t error_size) {
+    if (pipeline == nullptr) {
+        copyError(error, error_size, "vivid_create: pipeline is NULL");
+        return VIVID_ERROR_INVALID_ARGUMENT;
+    }
+    *pipeline = nullptr;
+    if (config == nullptr || config->struct_size < sizeof(uint32_t)) {
+        copyError(error, error_size, "vivid_create: the configuration is NULL or not initialised with vivid_config_init()");
+        return VIVID_ERROR_INVALID_ARGUMENT;
+    }
+
+    std::unique_ptr<vivid_pipeline> p;
+    try {
+        p = std::make_unique<vivid_pipeline>();
+        // Fields unknown to an older application keep their default value
+        vivid_config_init(&p->config);
+        std::memcpy(&p->config, config, std::min<size_t>(config->struct_size, sizeof(vivid_config)));
+        p->config.struct_size = sizeof(vivid_config);
+        const vivid_config &c = p->config;
+
+        if (c.api < VIVID_API_PIPELINE || c.api > VIVID_API_CORO) {
+            throw std::invalid_argument("vivid_create: unknown api " + std::to_string(c.api));
+        }
+        if (c.pixel_type < VIVID_PIXEL_FLOAT32 || c.pixel_type > VIVID_PIXEL_UINT16) {
+            throw std::invalid_argument("vivid_create: unknown pixel_type " + std::to_string(c.pixel_type));
+        }
+        if (c.width < static_cast<uint32_t>(p->appData.windowWidth) || c.height < static_cast<uint32_t>(p->appData.window_height) || c.width > INT_MAX || c.height > INT_MAX) {
+            throw std::invalid_argument("vivid_create: the frames must be at least " + std::to_string(p->appData.windowWidth) + "x" + std::to_string(p->appData.window_height) + " (got " +
+                                        std::to_string(c.width) + "x" + std::to_string(c.height) + ")");
+        }
+
+        // Same options as the command line; the input never runs out, it ends when the application closes it
+        std::vector<std::string> args{"--api", API_NAMES[c.api], "--numframes", std::to_string(INT_MAX)};
+        if (c.stages != nullptr) {
+            args.insert(args.end(), {"--stages", c.stages});
+        }
+        if (c.config_stages != nullptr) {
+            args.insert(args.end(), {"--config", c.config_stages});
+        } else if (c.api == VIVID_API_SERIE) {
+            args.insert(args.end(), {"--config", "CPU"});
+        }
+        if (c.threads > 0) {
+            args.insert(args.end(), {"--threads", std::to_string(c.threads)});
+        }
+        if (c.in_flight_frames > 0) {
+            args.insert(args.end(), {"--iff", std::to_string(c.in_flight_frames)});
+        }
+        if (c.in_order != 0) {
+            args.push_back("--reorder");
+        }
+        p->inputArgs = std::make_unique<InputArgs>(args, !c.verbose);
+        InputArgs &inputArgs = *p->inputArgs;
+
+        // Devices and buffers of this pipeline
+        ApplicationData &appData = p->appData;
+        appData.setNumStages(inputArgs.numStages());
+        appData.height = static_cast<int>(c.height);
+        appData.width = static_cast<int>(c.width);
+        appData.pixelType = static_cast<PixelType>(c.pixel_type);
+        SYCLUtils::configureSYCLQueues(p->Q_GPU, p->Q_CPU, inputArgs.nThreads, inputArgs.pipelineName == PipelineType::SYCLEvents, !c.verbose);
+        appData.selectUSMQueue(p->Q_GPU);
+        DataBuffers::createAllBuffers(appData, nullptr);
+        // The global frame is only the idle frame of the items here, it never reaches the stages
+        std::memset(appData.globalFrame->get_HOST_PTR(BUF_WRITE), 0, appData.globalFrame->size);
+        p->bufferItems = std::make_unique<ItemPool>(inputArgs.sizeCircularBuffer, appData.globalFrame, appData.globalCla, appData.numFilters, appData.USM_queue, appData.usmUsage, static_cast<size_t>(inputArgs.inFlightFrames));
+        DataBuffers::createStageBuffers(appData, inputArgs, *p->bufferItems);
+
+        // Input: the frames pushed by the application
+        p->frameSource = std::make_unique<FrameSource>(appData.height, appData.width, appData.pixelType);
+        size_t queueDepth = c.queue_depth > 0 ? c.queue_depth : DEFAULT_PREFETCH_FRAMES;
+        p->frameSource->start(appData.USM_queue, appData.usmUsage, static_cast<size_t>(std::max(inputArgs.inFlightFrames, inputArgs.maxTokens)) + queueDepth, appData.globalFrame);
+        p->runtime.frameSource = p->frameSource.get();
+
+        // Output: the detections of each frame, to the callback or to vivid_poll()
+        ResultSinkConfig sinkConfig;
+        sinkConfig.depth = c.result_depth > 0 ? c.result_depth : DEFAULT_SINK_DEPTH;
+        sinkConfig.topK = c.top_k > 0 ? c.top_k : DEFAULT_SINK_TOPK;
+        sinkConfig.drop = c.drop_results != 0;
+        vivid_pipeline *self = p.get();
+        sinkConfig.callback = [self](uint64_t frameId, const Detection *detections, size_t count) { self->deliver(frameId, detections, count); };
+        if (c.callback == nullptr) {
+            p->results.resize(sinkConfig.depth);
+            for (auto &result : p->results) {
+                result.detections.resize(sinkConfig.topK);
+            }
+        }
+        p->resultSink = std::make_unique<ResultSink>(sinkConfig, appData.width, appData.height);
+        p->runtime.resultSink = p->resultSink.get();
+        if (inputArgs.reorder) {
+            // The pushed frames are numbered from 1
+            p->reorderBuffer = std::make_unique<ReorderBuffer>(ReorderConfig{}, p->bufferItems->capacity());
+            p->runtime.reorderBuffer = p->reorderBuffer.get();
+        }
+
+        // Run the pipeline until the input is closed
+        p->pipeline = PipelineFactory::createPipeline(inputArgs.pipelineName);
+        p->pipeline->attach(p->runtime);
+        p->created = tbb::tick_count::now();
+        p->runner = std::thread([self] {
+            try {
+                self->pipeline->executePipeline(self->appData, *self->inputArgs, *self->bufferItems, self->traceFile, self->Q_GPU, self->Q_CPU);
+            } catch (...) {
+                self->fail(std::current_exception());
+                self->frameSource->stop(); // Wake up the pushes
+            }
+        });
+    } catch (const std::exception &e) { // Also sycl::exception
+        copyError(error, error_size, e.what());
+        return statusOf(e);
+    }
+
+    *pipeline = p.release();
+    copyError(error, error_size, "");
+    return VIVID_OK;
+}
+
+vivid_status vivid_push_frame(vivid_pipeline *pipeline, const void *pixels, int timeout_ms, uint64_t *frame_id) {
+    if (pipeline == nullptr || pixels == nullptr) {
+        return VIVID_ERROR_INVALID_ARGUMENT;
+    }
+    if (pipeline->failed()) {
+        return VIVID_ERROR_RUNTIME;
+    }
+    try {
+        size_t id = pipeline->frameSource->push(pixels, timeout_ms);
+        if (id == 0) {
+            return VIVID_ERROR_TIMEOUT;
+        }
+        if (frame_id != nullptr) {
+            *frame_id = id;
+        }
+        return VIVID_OK;
+    } catch (const std::logic_error &) {
+        // Closed by the application, or stopped because the pipeline failed
+        return pipeline->failed() ? VIVID_ERROR_RUNTIME : VIVID_ERROR_CLOSED;
+    }
+}
+
+vivid_status vivid_poll(vivid_pipeline *pipeline, vivid_result *result, int timeout_ms) {
+    if (pipeline == nullptr || result == nullptr || pipeline->config.callback != nullptr) {
+        return VIVID_ERROR_INVALID_ARGUMENT;
+    }
+    std::unique_lock<std::mutex> lock(pipeline->mutex);
+    auto done = [pipeline] { return pipeline->queued > 0 || pipeline->drained || pipeline->error; };
+    if (timeout_ms < 0) {
+        pipeline->resultReady.wait(lock, done);
+    } else {
+        pipeline->resultReady.wait_for(lock, std::chrono::milliseconds(timeout_ms), done);
+    }
+    if (pipeline->queued == 0) {
+        if (pipeline->drained) {
+            return VIVID_ERROR_CLOSED;
+        }
+        return pipeline->error ? VIVID_ERROR_RUNTIME : VIVID_ERROR_TIMEOUT;
+    }
+
+    // The slot goes back to the writer thread: keep the detections in the buffer of the application
+    auto &slot = pipeline->results[pipeline->head];
+    pipeline->polled.assign(slot.detections.begin(), slot.detections.begin() + slot.count);
+    result->frame_id = slot.frameId;
+    result->count = static_cast<uint32_t>(slot.count);
+    result->detections = pipeline->polled.data();
+    pipeline->head = (pipeline->head + 1) % pipeline->results.size();
+    pipeline->queued--;
+    lock.unlock();
+    pipeline->resultTaken.notify_one();
+    return VIVID_OK;
+}
+
+vivid_status vivid_close(vivid_pipeline *pipeline) {
+    if (pipeline == nullptr) {
+        return VIVID_ERROR_INVALID_ARGUMENT;
+    }
+    std::lock_guard<std::mutex> closeLock(pipeline->closeMutex);
+    if (!pipeline->closed) {
+        // The pipeline processes the frames already pushed and leaves its loop
+        pipeline->frameSource->close();
+        if (pipeline->runner.joinable()) {
+            pipeline->runner.join();
+        }
+        try {
+            // Only frames held behind one that never finished (the pipeline failed) are left
+            pipeline->runtime.flush(*pipeline->bufferItems);
+        } catch (...) {
+            pipeline->fail(std::current_exception());
+        }
+        pipeline->frameSource->stop();
+        try {
+            pipeline->resultSink->stop();
+        } catch (...) {
+            pipeline->fail(std::current_exception());
+        }
+        pipeline->closedAt = tbb::tick_count::now();
+        pipeline->closed = true;
+        {
+            std::lock_guard<std::mutex> lock(pipeline->mutex);
+            pipeline->drained = true;
+        }
+        pipeline->resultReady.notify_all();
+    }
+    return pipeline->failed() ? VIVID_ERROR_RUNTIME : VIVID_OK;
+}
+
+vivid_status vivid_get_stats(vivid_pipeline *pipeline, vivid_stats *stats) {
+    if (pipeline == nullptr || stats == nullptr || stats->struct_size < sizeof(uint32_t)) {
+        return VIVID_ERROR_INVALID_ARGUMENT;
+    }
+    FrameSourceStats ingest = pipeline->frameSource->getStats();
+    ResultSinkStats sink = pipeline->resultSink->getStats();
+    tbb::tick_count end;
+    {
+        std::lock_guard<std::mutex> closeLock(pipeline->closeMutex);
+        end = pipeline->closed ? pipeline->closedAt : tbb::tick_count::now();
+    }
+
+    vivid_stats snapshot{};
+    snapshot.frames_pushed = ingest.framesRead;
+    snapshot.frames_processed = sink.framesWritten;
+    snapshot.results_dropped = sink.framesDropped;
+    snapshot.push_waits = ingest.pushWaits;
+    snapshot.push_wait_ms = ingest.pushWaitTime;
+    snapshot.input_stalls = ingest.stalls;
+    snapshot.input_stall_ms = ingest.stallTime;
+    snapshot.result_waits = sink.blockedFrames;
+    snapshot.result_wait_ms = sink.blockedTime;
+    snapshot.elapsed_s = (end - pipeline->created).seconds();
+    snapshot.throughput_fps = snapshot.elapsed_s > 0.0 ? snapshot.frames_processed / snapshot.elapsed_s : 0.0;
+    // Only the buffers of this pipeline: the other pipelines of the process have their own ApplicationData
+    snapshot.usm_bytes = pipeline->appData.usmUsage.getCurrent();
+    snapshot.usm_peak_bytes = pipeline->appData.usmUsage.getPeak();
+    if (pipeline->reorderBuffer) {
+        ReorderStats reorder = pipeline->reorderBuffer->getStats();
+        snapshot.reorder_held = reorder.heldFrames;
+        snapshot.reorder_wait_ms = reorder.blockedTime;
+    }
+
+    // Only the fields known to the application are written
+    uint32_t size = stats->struct_size;
+    snapshot.struct_size = size;
+    std::memcpy(stats, &snapshot, std::min<size_t>(size, sizeof(vivid_stats)));
+    return VIVID_OK;
+}
+
+const char *vivid_last_error(const vivid_pipeline *pipeline) {
+    return pipeline != nullptr ? pipeline->lastError.c_str() : "";
+}
+
+const char *vivid_status_string(vivid_status status) {
+    switch (status) {
+    case VIVID_OK:
+        return "ok";
+    case VIVID_ERROR_INVALID_ARGUMENT:
+        return "invalid argument";
+    case VIVID_ERROR_RUNTIME:
+        return "runtime error";
+    case VIVID_ERROR_TIMEOUT:
+        return "timeout";
+    case VIVID_ERROR_CLOSED:
+        return "closed";
+    }
+    return "unknown status";
+}
+
+void vivid_destroy(vivid_pipeline *pipeline) {
+    if (pipeline == nullptr) {
+        return;
+    }
+    {
+        // Nobody will poll the results that are still waiting
+        std::lock_guard<std::mutex> lock(pipeline->mutex);
+        pipeline->discarding = true;
+    }
+    pipeline->resultTaken.notify_all();
+    vivid_close(pipeline);
+    delete pipeline;
+}
@@ -1,5 +1,17 @@
 #include "ApplicationData.hpp"
 
+void ApplicationData::setNumStages(size_t numStages) {
+    // The atomics cannot be moved: the vectors are rebuilt instead of resized
+    numFiltersGPU = std::vector<std::atomic<int>>(numStages);
+    numFiltersCPU = std::vector<std::atomic<int>>(numStages);
+    for (size_t i = 0; i < numStages; ++i) {
+        numFiltersGPU[i] = 0;
+        numFiltersCPU[i] = 0;
+    }
+    time_GPU_S.assign(numStages, 0.0);
+    time_CPU_S.assign(numStages, 0.0);
+}
+
 void ApplicationData::selectUSMQueue(sycl::queue &Q) {
     USM_queue = Q;
 }
@@ -10,5 +22,6 @@ ApplicationData::~ApplicationData() {
     }
     if (filterBank != nullptr) {
         sycl::free(filterBank, USM_queue);
+        usmUsage.freed(numFilters * filterSize * sizeof(float));
     }
 }
@@ -1,10 +1,13 @@
 #include "InputArgs.hpp"
 #include "Device.hpp"
 #include "GlobalParameters.hpp"
+#include "MemoryBudget.hpp"
 #include "PipelineFactory.hpp"
 #include "Stage.hpp"
+#include "StageRegistry.hpp"
 #include <array>
 #include <filesystem>
+#include <fstream>
 #include <iomanip>
 #include <iostream>
 #include <regex>
@@ -16,6 +19,19 @@ InputArgs::InputArgs(int argc, char *argv[]) {
     parseArguments(argc, argv);
 }
 
+InputArgs::InputArgs(const std::vector<std::string> &args, bool quiet)
+    : embedded{true} {
+    if (quiet) {
+        console.rdbuf(nullptr); // Writes are discarded (the stream just sets its badbit)
+    }
+    std::vector<char *> argv;
+    argv.push_back(const_cast<char *>("libvivid"));
+    for (const auto &arg : args) {
+        argv.push_back(const_cast<char *>(arg.c_str()));
+    }
+    parseArguments(static_cast<int>(argv.size()), argv.data());
+}
+
 bool InputArgs::parseConfigStages() {
     try {
         if constexpr (TIMESTAGES_ENABLED) {
@@ -43,9 +59,9 @@ bool InputArgs::parseConfigStages() {
             std::fill(stageExecutionState.begin(), stageExecutionState.end(), StageState::CPU_GPU);
             selectedPath = PathSelection::Decoupled;
             return true;
-        } else if (configStagesStr.length() == NUM_STAGES) {
+        } else if (configStagesStr.length() == numStages()) {
             GPUactive = true;
-            for (int i = 0; i < NUM_STAGES; i++) {
+            for (size_t i = 0; i < numStages(); i++) {
                 if (configStagesStr[i] == '2') {
                     stageExecutionState[i] = StageState::GPU;
                 } else if (configStagesStr[i] == '1') {
@@ -53,7 +69,7 @@ bool InputArgs::parseConfigStages() {
                 } else if (configStagesStr[i] == '0') {
                     stageExecutionState[i] = StageState::CPU;
                 } else {
-                    std::cout << "Invalid configuration of the stages" << std::endl;
+                    console << "Invalid configuration of the stages" << std::endl;
                     return false;
                 }
             }
@@ -69,8 +85,134 @@ bool InputArgs::parseConfigStages() {
     return false;
 }
 
+void InputArgs::parseStages(const std::string &stagesStr, const std::string &stagesFile) {
+    if (!stagesStr.empty() && !stagesFile.empty()) {
+        throw std::invalid_argument("Specify either --stages or --stages-file, not both.");
+    }
+
+    // Lista separada por comas o por líneas (fichero), ignorando espacios y comentarios
+    std::string list = stagesStr;
+    if (!stagesFile.empty()) {
+        std::ifstream file(stagesFile);
+        if (!file) {
+            throw std::invalid_argument("Cannot open the stages file " + stagesFile);
+        }
+        std::string line;
+        while (std::getline(file, line)) {
+            list += line.substr(0, line.find('#')) + ",";
+        }
+    }
+    if (list.find_first_not_of(" \t\r,") == std::string::npos) {
+        if (!list.empty()) {
+            throw std::invalid_argument("The pipeline needs at least one stage");
+        }
+        list = DEFAULT_STAGES;
+        if constexpr (DEFAULT_SIM_STAGES > 0) {
+            list = "sim";
+            for (int i = 1; i < DEFAULT_SIM_STAGES; i++) {
+                list += ",sim";
+            }
+        }
+    }
+
+    // Trozos separados por sep, sin espacios alrededor
+    auto trim = [](std::string str) {
+        str.erase(0, str.find_first_not_of(" \t\r"));
+        str.erase(str.find_last_not_of(" \t\r") + 1);
+        return str;
+    };
+    auto split = [&trim](const std::string &str, char sep) {
+        std::vector<std::string> parts;
+        size_t start = 0;
+        while (start <= str.size()) {
+            size_t end = std::min(str.find(sep, start), str.size());
+            parts.push_back(trim(str.substr(start, end - start)));
+            start = end + 1;
+        }
+        return parts;
+    };
+
+    // Niveles separados por comas; las ramas de un nivel (fan-out sobre la salida del nivel anterior), por '|'
+    for (const auto &level : split(list, ',')) {
+        if (level.empty()) {
+            continue;
+        }
+        stageLevels.emplace_back();
+        for (const auto &spec : split(level, '|')) {
+            if (spec.empty()) {
+                throw std::invalid_argument("Empty branch in the stages '" + level + "'");
+            }
+            stageLevels.back().push_back(stageNames.size());
+            stageLevel.push_back(stageLevels.size() - 1);
+            stageNames.push_back(spec);
+        }
+    }
+    if (stageNames.size() > MAX_STAGES) {
+        throw std::invalid_argument("The pipeline has " + std::to_string(stageNames.size()) + " stages, the maximum is " + std::to_string(MAX_STAGES));
+    }
+    if (stageLevels.front().size() > 1) {
+        throw std::invalid_argument("The first stage of the pipeline cannot have branches (" + list + ")");
+    }
+
+    // Cada etapa es name[:dict=N][:model=FILE]; las opciones solo valen para las etapas que usan clases
+    for (auto &spec : stageNames) {
+        std::vector<std::string> options = split(spec, ':');
+        const StageKernels &kernels = StageRegistry::instance().get(options[0]);
+        StageClassifier classifier;
+        spec = options[0];
+        for (size_t o = 1; o < options.size(); o++) {
+            size_t eq = options[o].find('=');
+            std::string key = trim(options[o].substr(0, eq));
+            std::string value = eq == std::string::npos ? "" : trim(options[o].substr(eq + 1));
+            if (!kernels.classifier) {
+                throw std::invalid_argument("The stage " + options[0] + " does not take options (" + options[o] + ")");
+            }
+            if (key == "dict") {
+                size_t pos = 0;
+                try {
+                    classifier.dictSize = std::stoi(value, &pos);
+                } catch (const std::exception &) {
+                    pos = 0;
+                }
+                if (pos == 0 || pos != value.size() || classifier.dictSize <= 0) {
+                    throw std::invalid_argument("Invalid dict of the stage " + options[0] + ": " + value);
+                }
+            } else if (key == "model" && !value.empty()) {
+                classifier.model = value;
+            } else {
+                throw std::invalid_argument("Invalid option of the stage " + options[0] + ": " + options[o] + " (dict=N, model=FILE)");
+            }
+            spec += ":" + key + "=" + value;
+        }
+        stages.push_back(&kernels);
+        stageClassifiers.push_back(classifier);
+    }
+    stageExecutionState.assign(numStages(), StageState::CPU);
+    executionDevicePriority.assign(numStages(), Acc::CPU);
+    throughput_CPU.assign(numStages(), -1);
+    throughput_GPU.assign(numStages(), -1);
+}
+
+std::string InputArgs::stagesString() const {
+    std::string result;
+    for (const auto &level : stageLevels) {
+        for (size_t i = 0; i < level.size(); i++) {
+            result += (i > 0 ? "|" : (result.empty() ? "" : ",")) + stageNames[level[i]];
+        }
+    }
+    return result;
+}
+
+// Con lotes en la GPU (--gpu-batch) la GPU debe admitir a la vez los frames de un lote
+int InputArgs::defaultCoresGPU() const {
+    if (gpuBatch == 1) {
+        return DEFAULT_CORES_GPU;
+    }
+    return std::max(DEFAULT_CORES_GPU, gpuBatch > 0 ? gpuBatch : MAX_GPU_BATCH);
+}
+
 void InputArgs::setResources(const std::vector<int> &size, const std::vector<int> &cores, Acc acc) {
-    auto num_cores = (acc == Acc::CPU ? nThreads : DEFAULT_CORES_GPU);
+    auto num_cores = (acc == Acc::CPU ? nThreads : defaultCoresGPU());
     // Si estamos en Acc::GPU y todos los valores de stageExecutionState son GPU, entonces los cores de CPU son 0
     if (acc == Acc::CPU && std::all_of(stageExecutionState.begin(), stageExecutionState.end(), [](StageState s) { return s == StageState::GPU; })) {
         num_cores = 0;
@@ -81,12 +223,12 @@ void InputArgs::setResources(const std::vector<int> &size, const std::vector<int
     }
     auto device = std::make_unique<Device>(acc, num_cores);
 
-    auto getVectorValue = [](const std::vector<int> &vec, int index, int default_value) {
+    auto getVectorValue = [&](const std::vector<int> &vec, int index, int default_value) {
         if (vec.empty()) {
             return default_value;
         } else if (vec.size() == 1) {
             return vec[0];
-        } else if (vec.size() == NUM_STAGES) {
+        } else if (vec.size() == numStages()) {
             return vec[index];
         } else {
             throw std::invalid_argument("Invalid vector size.");
@@ -103,27 +245,27 @@ void InputArgs::setResources(const std::vector<int> &size, const std::vector<int
         }
 
         // Default values
-        int default_cores = (acc == Acc::CPU) ? ((SYCL_ENABLED) ? 1 : nThreads) : DEFAULT_CORES_GPU;
+        int default_cores = (acc == Acc::CPU) ? ((SYCL_ENABLED) ? 1 : nThreads) : defaultCoresGPU();
         int default_size = 0;
 
         // Add the stages to the device
         int _cores = getVectorValue(cores, 0, default_cores);
         int _size = getVectorValue(size, 0, default_size);
         if constexpr (LOG_ENABLED) {
-            std::cout << "Adding device " << device->getAccStr() << " with cores: " << _cores << ", size: " << _size << std::endl;
+            console << "Adding device " << device->getAccStr() << " with cores: " << _cores << ", size: " << _size << std::endl;
         }
         device->addStage(0, _cores, _size);
         device->mapStageIndex(0, 0);
     } else {
         // Check the size and cores vectors
-        if (size.size() > 1 && size.size() != NUM_STAGES) {
+        if (size.size() > 1 && size.size() != numStages()) {
             throw std::invalid_argument("Invalid size vector configuration for the coupled path.");
         }
-        if (cores.size() > 1 && cores.size() != NUM_STAGES) {
+        if (cores.size() > 1 && cores.size() != numStages()) {
             throw std::invalid_argument("Invalid cores vector configuration for the coupled path.");
         }
 
-        for (int i = 0; i < NUM_STAGES; i++) {
+        for (int i = 0; i < static_cast<int>(numStages()); i++) {
             int _cores = 0;
             int _size = 0;
 
@@ -131,10 +273,10 @@ void InputArgs::setResources(const std::vector<int> &size, const std::vector<int
                 if constexpr (__ACQMODE__ != 2) {
                     _size = getVectorValue(size, i, DEFAULT_CORES_GPU);
                 }
-                _cores = getVectorValue(cores, i, (acc == Acc::CPU) ? ((SYCL_ENABLED) ? 1 : nThreads) : DEFAULT_CORES_GPU);
+                _cores = getVectorValue(cores, i, (acc == Acc::CPU) ? ((SYCL_ENABLED) ? 1 : nThreads) : defaultCoresGPU());
             } else if (stageExecutionState[i] == StageState::GPU) {
                 if (acc == Acc::GPU) {
-                    _cores = getVectorValue(cores, i, DEFAULT_CORES_GPU);
+                    _cores = getVectorValue(cores, i, defaultCoresGPU());
                     if constexpr (__ACQMODE__ != 2) {
                         _size = getVectorValue(size, i, inFlightFrames);
                     }
@@ -148,7 +290,7 @@ void InputArgs::setResources(const std::vector<int> &size, const std::vector<int
                 }
             }
             if constexpr (LOG_ENABLED) {
-                std::cout << "Adding stage " << i << " to device " << device->getAccStr() << " with _cores: " << _cores << ", _size: " << _size << std::endl;
+                console << "Adding stage " << i << " to device " << device->getAccStr() << " with _cores: " << _cores << ", _size: " << _size << std::endl;
             }
 
             // Add the stage to the device
@@ -160,7 +302,7 @@ void InputArgs::setResources(const std::vector<int> &size, const std::vector<int
 
     // Verificación antes de agregar el dispositivo
     if constexpr (LOG_ENABLED) {
-        std::clog << "Adding device " << device->getAccStr() << " to the resources manager" << std::endl;
+        console << "Adding device " << device->getAccStr() << " to the resources manager" << std::endl;
     }
     resourcesManager->addDevice(acc, std::move(device));
 
@@ -171,7 +313,7 @@ void InputArgs::setResources(const std::vector<int> &size, const std::vector<int
 void InputArgs::setExecutionDevicePriority(const std::vector<int> &exeDevPriority, std::vector<Acc> &executionDevicePriority) {
     if (exeDevPriority.empty()) {
         // If exeDevPriority is empty, determine the priority based on stageExecutionState
-        for (int i = 0; i < NUM_STAGES; i++) {
+        for (size_t i = 0; i < numStages(); i++) {
             Acc acc = ((stageExecutionState[i] == StageState::GPU) || (stageExecutionState[i] == StageState::CPU_GPU)) ? Acc::GPU : Acc::CPU;
             executionDevicePriority[i] = acc;
         }
@@ -181,7 +323,7 @@ void InputArgs::setExecutionDevicePriority(const std::vector<int> &exeDevPriorit
         if (exeDevPriority.size() == 1) {
             // If only one priority is given, apply it to all stages
             std::fill(executionDevicePriority.begin(), executionDevicePriority.end(), defaultAcc);
-        } else if (exeDevPriority.size() == NUM_STAGES) {
+        } else if (exeDevPriority.size() == numStages()) {
             // If priorities are given for all stages, transform them accordingly
             std::transform(exeDevPriority.begin(), exeDevPriority.end(), executionDevicePriority.begin(),
                            [](int v) { return (v == 2) ? Acc::GPU : Acc::CPU; });
@@ -195,7 +337,7 @@ void InputArgs::setThroughput(const std::vector<double> &th, std::vector<double>
     if (th.size() == 1) {
         // If only one throughput value is given, apply it to all stages
         std::fill(throughput.begin(), throughput.end(), th[0]);
-    } else if (th.size() == NUM_STAGES) {
+    } else if (th.size() == numStages()) {
         // If throughput values are given for all stages, copy them to throughput
         std::copy(th.begin(), th.end(), throughput.begin());
     }
@@ -203,7 +345,7 @@ void InputArgs::setThroughput(const std::vector<double> &th, std::vector<double>
 
 void InputArgs::parseArguments(int argc, char *argv[]) {
     auto printSeparator = []() {
-        std::cout << "---------------------------------------------------------------------------------------\n";
+        console << "---------------------------------------------------------------------------------------\n";
     };
 
     CLI::App app{"vivid-OneAPI: An example of a pipeline using oneAPI"};
@@ -212,6 +354,18 @@ void InputArgs::parseArguments(int argc, char *argv[]) {
     std::string pipelineStr;
     std::string durationStr;
     std::string timeSamplingStr;
+    std::string memBudgetStr;
+    std::string inputSizeStr;
+    std::string tileSizeStr;
+    std::string inputFormatStr;
+    std::string ioBackendStr;
+    std::string queuePolicyStr;
+    std::string queueOrderStr;
+    std::string gpuBatchStr;
+    std::string reorderGapStr;
+    std::string sinkFormatStr;
+    std::string stagesStr;
+    std::string stagesFile;
     std::vector<int> sizeGPU;
     std::vector<int> sizeCPU;
     std::vector<int> coresCPU;
@@ -219,23 +373,63 @@ void InputArgs::parseArguments(int argc, char *argv[]) {
     std::vector<int> exeDevPriority;
     std::vector<double> th_CPU;
     std::vector<double> th_GPU;
+    std::string registeredStages;
+    for (const auto &name : StageRegistry::instance().names()) {
+        registeredStages += (registeredStages.empty() ? "" : ", ") + name;
+    }
 
-    app.add_option("--api", pipelineStr, "Name of the API")->required()->check(CLI::IsMember({"pipeline", "fgfn", "fgan", "syclevents", "taskflow", "serie"}))->default_val("pipeline");
+    app.add_option("--api", pipelineStr, "Name of the API")->required()->check(CLI::IsMember({"pipeline", "fgfn", "fgan", "syclevents", "taskflow", "coro", "serie"}))->default_val("pipeline");
     app.add_option("--numframes", numFrames, "Number of frames to process")->check(CLI::PositiveNumber);
     app.add_option("--resolution", imageResolution, "Image resolution (0: 1280x720, 1: 1080p, 2: 1440p, 3: 2160p, 4: 2880p, 5: 4320p)")->check(CLI::Range(0, 5));
     app.add_option("--duration", durationStr, "Duration of the execution");
     app.add_option("--threads", nThreads, "Number of cores to use in the CPU")->check(CLI::PositiveNumber);
     app.add_option("--iff", inFlightFrames, "Number of frames in flight")->check(CLI::PositiveNumber);
     app.add_option("--config", configStagesStr, "Configuration of the stages as a string (0: CPU, 1: CPU+GPU, 2: GPU)");
-    app.add_option("--buffersize", sizeCircularBuffer, "Size of the circular buffer")->check(CLI::PositiveNumber);
-    app.add_option("--sizegpu", sizeGPU, "Size of the general GPU queue")->expected(1, NUM_STAGES);
-    app.add_option("--sizecpu", sizeCPU, "Size of the general CPU queue")->expected(1, NUM_STAGES);
-    app.add_option("--corescpu", coresCPU, "Number of cores per stage in the CPU")->expected(1, NUM_STAGES);
-    app.add_option("--coresgpu", coresGPU, "Number of cores per stage in the GPU")->expected(1, NUM_STAGES);
-    app.add_option("--prefdevice", exeDevPriority, "Preferred device per stage (0: CPU, 2: GPU)")->expected(1, NUM_STAGES);
+    app.add_option("--stages", stagesStr, "Stages of the pipeline in order, separated by commas; stages separated by | are branches on the output of the previous one, "
+                                   "and name:dict=N:model=FILE gives its own classes to a stage (default: " DEFAULT_STAGES "; registered: " + registeredStages + ")");
+    app.add_option("--stages-file", stagesFile, "File with the stages of the pipeline in order (one per line or separated by commas, # starts a comment)");
+    app.add_option("--buffersize", sizeCircularBuffer, "Size of the item pool")->check(CLI::PositiveNumber);
+    app.add_option("--mem-budget", memBudgetStr, "Memory budget for the buffers (e.g. 512M, 8G); sizes the in-flight frames and the item pool to fit");
+    app.add_option("--input", inputPath, "Multi-frame input: .bin file, directory of .bin files, raw video or shm:NAME (default: example image of --resolution)");
+    app.add_option("--input-size", inputSizeStr, "Frame size of a raw --input as WIDTHxHEIGHT (e.g. 1920x1080)");
+    app.add_option("--input-format", inputFormatStr, "Pixel type of a raw --input (float32, uint8 or uint16)")->check(CLI::IsMember({"float32", "uint8", "uint16"}));
+    app.add_option("--prefetch", prefetchFrames, "Number of input frames read ahead by the I/O thread")->check(CLI::PositiveNumber);
+    app.add_option("--io-backend", ioBackendStr, "Backend of the reads of --input (auto, uring, pread or sync)")->check(CLI::IsMember({"auto", "uring", "pread", "sync"}));
+    app.add_option("--io-depth", ioDepth, "Number of --input frames being read at the same time")->check(CLI::PositiveNumber);
+    app.add_flag("--direct", directIO, "Read --input with O_DIRECT, bypassing the page cache");
+    app.add_option("--tile", tileSizeStr, "Split the --input frames into tiles of WIDTHxHEIGHT processed as separate items (e.g. 2048x2048)");
+    app.add_option("--roi", roiPath, "Per-frame regions of interest ('frame x y width height' per line); only the windows around them are processed");
+    app.add_option("--reuse", reuseThreshold, "Reuse the output of the tiles that changed less than this mean absolute difference per pixel since the last keyframe")->check(CLI::NonNegativeNumber);
+    app.add_option("--reuse-refresh", reuseRefresh, "Frames between two keyframes of --reuse (processed whole to become the reference)")->check(CLI::PositiveNumber);
+    app.add_flag("--reuse-verify", reuseVerify, "Compare every frame reused by --reuse with its full recomputation on the host");
+    app.add_option("--camera", cameraFps, "Emulate a camera: release the frames at this rate (frames per second)")->check(CLI::PositiveNumber);
+    app.add_option("--camera-burst", cameraBurst, "Frames released together by --camera")->check(CLI::PositiveNumber);
+    app.add_option("--camera-jitter", cameraJitter, "Maximum deviation of each --camera release from its nominal time (ms)")->check(CLI::NonNegativeNumber);
+    app.add_option("--deadline", deadline, "Time after its arrival by which each --camera frame must be released (ms, default: 2 periods)")->check(CLI::PositiveNumber);
+    app.add_option("--sink", sinkPath, "Write the detections of each frame to this file (JSON lines, or binary for .bin files)");
+    app.add_option("--sink-format", sinkFormatStr, "Format of --sink (jsonl or binary)")->check(CLI::IsMember({"jsonl", "binary"}));
+    app.add_option("--sink-depth", sinkDepth, "Number of frames that can wait for the writer thread of --sink")->check(CLI::PositiveNumber);
+    app.add_option("--sink-topk", sinkTopK, "Number of detections written per frame by --sink")->check(CLI::PositiveNumber);
+    app.add_flag("--sink-drop", sinkDrop, "Drop frames when --sink falls behind instead of waiting for it");
+    app.add_flag("--reorder", reorder, "Deliver the frames to --sink in the order of their ids instead of the order they finish");
+    app.add_option("--reorder-window", reorderWindow, "Frames --reorder can hold while an older one is late (default: the item pool)")->check(CLI::PositiveNumber);
+    app.add_option("--reorder-gap", reorderGapStr, "What --reorder does with a late frame (wait: hold the younger ones, skip: skip it after --reorder-timeout)")->check(CLI::IsMember({"wait", "skip"}));
+    app.add_option("--reorder-timeout", reorderTimeout, "Time --reorder-gap skip waits for a late frame (ms)")->check(CLI::NonNegativeNumber);
+    app.add_option("--sizegpu", sizeGPU, "Size of the general GPU queue")->expected(1, MAX_STAGES);
+    app.add_option("--sizecpu", sizeCPU, "Size of the general CPU queue")->expected(1, MAX_STAGES);
+    app.add_option("--corescpu", coresCPU, "Number of cores per stage in the CPU")->expected(1, MAX_STAGES);
+    app.add_option("--coresgpu", coresGPU, "Number of cores per stage in the GPU")->expected(1, MAX_STAGES);
+    app.add_option("--prefdevice", exeDevPriority, "Preferred device per stage (0: CPU, 2: GPU)")->expected(1, MAX_STAGES);
     app.add_flag("--dependson", useDependsOnSerial, "Flag that uses sycl::events on --api being 'serie'");
-    app.add_option("--thcpu", th_CPU, "Throughput of the CPU in stage 1")->expected(1, NUM_STAGES);
-    app.add_option("--thgpu", th_GPU, "Throughput of the GPU in stage 1")->expected(1, NUM_STAGES);
+    app.add_flag("--gpu-graph", gpuGraph, "Record the stages of the frames of --api 'syclevents' that run whole on the GPU as a SYCL graph and replay it (falls back to one submission per stage)");
+    app.add_option("--queues", queuesPerDevice, "SYCL queues of each device; each frame in flight submits its stages to one of them")->check(CLI::PositiveNumber);
+    app.add_option("--queue-policy", queuePolicyStr, "Assignment of the frames to the queues of --queues (rr: round-robin, least: the least loaded queue)")->check(CLI::IsMember({"rr", "least"}));
+    app.add_option("--queue-order", queueOrderStr, "Order of the queues added by --queues (in or out, default: that of the configured queues)")->check(CLI::IsMember({"in", "out"}));
+    app.add_option("--gpu-batch", gpuBatchStr, "Frames launched together by the GPU stages (1 to " + std::to_string(MAX_GPU_BATCH) + ", or auto: by resolution)");
+    app.add_option("--gpu-batch-timeout", gpuBatchTimeout, "Time a batch of --gpu-batch waits for more frames, in microseconds")->check(CLI::NonNegativeNumber);
+    app.add_flag("--gpu-blocking", gpuBlocking, "Keep the worker of --api 'pipeline', 'fgan' or 'coro' waiting while the GPU runs a stage, instead of releasing it to the CPU path");
+    app.add_option("--thcpu", th_CPU, "Throughput of the CPU in stage 1")->expected(1, MAX_STAGES);
+    app.add_option("--thgpu", th_GPU, "Throughput of the GPU in stage 1")->expected(1, MAX_STAGES);
 
     if constexpr (AUTOMODE_ENABLED) {
         app.add_option("--timesampling", timeSamplingStr, "Time sampling for model")->default_val("10s");
@@ -245,16 +439,55 @@ void InputArgs::parseArguments(int argc, char *argv[]) {
     try {
         app.parse(argc, argv);
     } catch (const CLI::ParseError &e) {
+        if (embedded) {
+            throw std::invalid_argument(e.what());
+        }
         std::exit(app.exit(e));
     }
 
     // Obtenemos el tipo de pipeline
     pipelineName = PipelineFactory::getPipelineType(pipelineStr);
 
+    // Etapas del pipeline: dimensionan todos los vectores por etapa
+    parseStages(stagesStr, stagesFile);
+
     // Validamos que el flag --dependson solo sea válido cuando el API es 'serie'
     if (useDependsOnSerial && pipelineStr != "serie") {
         throw std::invalid_argument("--usedependsonserial is only valid when --api is 'serie'");
     }
+    // Validamos que el flag --gpu-blocking solo sea válido cuando el API es 'pipeline', 'fgan' o 'coro'
+    if (gpuBlocking && pipelineStr != "pipeline" && pipelineStr != "fgan" && pipelineStr != "coro") {
+        throw std::invalid_argument("--gpu-blocking is only valid when --api is 'pipeline', 'fgan' or 'coro'");
+    }
+    // Validamos que el flag --gpu-graph solo sea válido cuando el API es 'syclevents'
+    if (gpuGraph && pipelineStr != "syclevents") {
+        throw std::invalid_argument("--gpu-graph is only valid when --api is 'syclevents'");
+    }
+    // Validamos el tamaño de los lotes de la GPU (--gpu-batch): un número de frames o 'auto' (según la resolución)
+    if (!gpuBatchStr.empty()) {
+        if (gpuBatchStr == "auto") {
+            gpuBatch = 0;
+        } else {
+            size_t end = 0;
+            try {
+                gpuBatch = std::stoi(gpuBatchStr, &end);
+            } catch (const std::exception &) {
+                end = 0;
+            }
+            if (end != gpuBatchStr.size() || gpuBatch < 1 || gpuBatch > MAX_GPU_BATCH) {
+                throw std::invalid_argument("--gpu-batch must be 'auto' or a number of frames between 1 and " + std::to_string(MAX_GPU_BATCH));
+            }
+        }
+        if (pipelineStr == "serie") {
+            throw std::invalid_argument("--gpu-batch is not valid when --api is 'serie' (a single frame is in flight)");
+        }
+        if (gpuGraph) {
+            throw std::invalid_argument("--gpu-batch and --gpu-graph cannot be used together");
+        }
+    }
+    if (gpuBatchTimeout != DEFAULT_GPU_BATCH_TIMEOUT && gpuBatchStr.empty()) {
+        throw std::invalid_argument("--gpu-batch-timeout is only valid together with --gpu-batch");
+    }
     // Validamos que no se especifiquen ambos flags --numframes y --duration
     if (numFrames != DEFAULT_NUM_FRAMES && !durationStr.empty()) {
         throw std::invalid_argument("Specify either --numframes or --duration, not both.");
@@ -262,7 +495,7 @@ void InputArgs::parseArguments(int argc, char *argv[]) {
 
     // Si el usuario define el flag --duration, se convierte a segundos
     if (!durationStr.empty()) {
-        std::cout << "Changing duration to seconds" << std::endl;
+        console << "Changing duration to seconds" << std::endl;
         std::regex durPattern(R"((\d+h)?(\d+m)?(\d+s)?)");
         std::smatch match;
         if (std::regex_match(durationStr, match, durPattern)) {
@@ -275,6 +508,133 @@ void InputArgs::parseArguments(int argc, char *argv[]) {
         }
     }
 
+    // Si el usuario define el flag --mem-budget, se convierte a bytes (se aplica al conocer la resolución de la imagen)
+    if (!memBudgetStr.empty()) {
+        memBudget = MemoryBudget::parseSize(memBudgetStr);
+    }
+
+    // Si el usuario define el flag --input-size, se obtienen las dimensiones de los frames de la entrada raw
+    if (!inputSizeStr.empty()) {
+        std::regex sizePattern(R"((\d+)[xX](\d+))");
+        std::smatch match;
+        if (!std::regex_match(inputSizeStr, match, sizePattern)) {
+            throw std::invalid_argument("Invalid input size format. Should be like '1920x1080'.");
+        }
+        inputWidth = std::stoi(match[1].str());
+        inputHeight = std::stoi(match[2].str());
+    }
+    if (!inputSizeStr.empty() && inputPath.empty()) {
+        throw std::invalid_argument("--input-size is only valid together with --input");
+    }
+
+    // Tipo de los pixeles de la entrada raw (los .bin lo llevan en la cabecera)
+    if (!inputFormatStr.empty()) {
+        if (inputPath.empty()) {
+            throw std::invalid_argument("--input-format is only valid together with --input");
+        }
+        inputFormat = inputFormatStr == "uint8" ? FrameContainer::PixelType::UInt8 : inputFormatStr == "uint16" ? FrameContainer::PixelType::UInt16 : FrameContainer::PixelType::Float32;
+    }
+
+    // Validamos que --queue-policy y --queue-order solo se usen junto con --queues
+    if ((!queuePolicyStr.empty() || !queueOrderStr.empty()) && queuesPerDevice == 1) {
+        throw std::invalid_argument("--queue-policy and --queue-order need --queues greater than 1");
+    }
+    if (!queuePolicyStr.empty()) {
+        queuePolicy = queuePolicyStr == "least" ? QueuePolicy::LeastLoaded : QueuePolicy::RoundRobin;
+    }
+    if (!queueOrderStr.empty()) {
+        queueInOrder = queueOrderStr == "in";
+    }
+
+    // Lectura de la entrada: backend, profundidad de la cola y O_DIRECT
+    if (!ioBackendStr.empty()) {
+        ioBackend = ioBackendStr == "uring" ? IOBackend::Uring : ioBackendStr == "pread" ? IOBackend::Pread : ioBackendStr == "sync" ? IOBackend::Sync : IOBackend::Auto;
+    }
+    if ((!ioBackendStr.empty() || ioDepth != DEFAULT_IO_DEPTH || directIO) && inputPath.empty()) {
+        throw std::invalid_argument("--io-backend, --io-depth and --direct are only valid together with --input");
+    }
+    // La entrada de memoria compartida lleva la geometría en su cabecera y no se lee de disco
+    if (inputPath.rfind("shm:", 0) == 0 && (!inputSizeStr.empty() || !inputFormatStr.empty() || !ioBackendStr.empty() || ioDepth != DEFAULT_IO_DEPTH || directIO)) {
+        throw std::invalid_argument("--input-size, --input-format, --io-backend, --io-depth and --direct do not apply to a shared memory --input");
+    }
+
+    // Frames gigantes: se procesan por teselas leídas de disco a medida que se necesitan
+    if (!tileSizeStr.empty()) {
+        std::regex sizePattern(R"((\d+)[xX](\d+))");
+        std::smatch match;
+        if (!std::regex_match(tileSizeStr, match, sizePattern)) {
+            throw std::invalid_argument("Invalid tile size format. Should be like '2048x2048'.");
+        }
+        tileWidth = std::stoi(match[1].str());
+        tileHeight = std::stoi(match[2].str());
+        if (tileWidth <= 0 || tileHeight <= 0) {
+            throw std::invalid_argument("--tile must not be empty");
+        }
+        if (inputPath.empty()) {
+            throw std::invalid_argument("--tile is only valid together with --input");
+        }
+        if (inputPath.rfind("shm:", 0) == 0) {
+            throw std::invalid_argument("--tile does not apply to a shared memory --input");
+        }
+        if (directIO) {
+            throw std::invalid_argument("--tile cannot be used with --direct (the rows of a tile are not aligned to the blocks of the device)");
+        }
+        if (sinkDrop) {
+            throw std::invalid_argument("--tile cannot be used with --sink-drop (a frame is written once all its tiles have been reduced)");
+        }
+    }
+
+    // Regiones de interés: cada frame listado solo procesa las ventanas que las cubren
+    if (!roiPath.empty() && tileWidth > 0) {
+        throw std::invalid_argument("--roi cannot be used with --tile (the regions are given in the coordinates of the whole frame)");
+    }
+
+    // Reutilización temporal: solo se recalculan las teselas que cambian respecto al último keyframe
+    if ((reuseRefresh != DEFAULT_REUSE_REFRESH || reuseVerify) && reuseThreshold < 0.0) {
+        throw std::invalid_argument("--reuse-refresh and --reuse-verify are only valid together with --reuse");
+    }
+    if (reuseThreshold >= 0.0 && (!roiPath.empty() || tileWidth > 0)) {
+        throw std::invalid_argument("--reuse cannot be used with --roi or --tile");
+    }
+    // La salida reutilizada es la de las clases globales, sin ramas
+    if (reuseThreshold >= 0.0 && (hasBranches() || std::any_of(stageClassifiers.begin(), stageClassifiers.end(), [](const StageClassifier &c) { return c.custom(); }))) {
+        throw std::invalid_argument("--reuse cannot be used with branches or classifiers in --stages");
+    }
+
+    // Cámara sintética: ráfagas, jitter y plazo de los frames
+    if ((cameraBurst != 1 || cameraJitter != 0.0 || deadline != 0.0) && cameraFps == 0.0) {
+        throw std::invalid_argument("--camera-burst, --camera-jitter and --deadline are only valid together with --camera");
+    }
+
+    // Salida de las detecciones: formato (por defecto según la extensión) y tamaño de la cola
+    if (!sinkFormatStr.empty()) {
+        sinkFormat = sinkFormatStr == "binary" ? ResultSinkConfig::Format::Binary : ResultSinkConfig::Format::JsonLines;
+    } else if (sinkPath.size() >= 4 && sinkPath.compare(sinkPath.size() - 4, 4, ".bin") == 0) {
+        sinkFormat = ResultSinkConfig::Format::Binary;
+    }
+    if ((!sinkFormatStr.empty() || sinkDepth != DEFAULT_SINK_DEPTH || sinkTopK != DEFAULT_SINK_TOPK || sinkDrop) && sinkPath.empty()) {
+        throw std::invalid_argument("--sink-format, --sink-depth, --sink-topk and --sink-drop are only valid together with --sink");
+    }
+
+    // Reordenación de la salida: ventana y política de los huecos
+    if ((reorderWindow != 0 || !reorderGapStr.empty() || reorderTimeout != DEFAULT_REORDER_TIMEOUT) && !reorder) {
+        throw std::invalid_argument("--reorder-window, --reorder-gap and --reorder-timeout are only valid together with --reorder");
+    }
+    if (!reorderGapStr.empty()) {
+        reorderGap = reorderGapStr == "skip" ? ReorderGap::Skip : ReorderGap::Wait;
+    }
+    // Con 'wait' la ventana es el pool: un frame que no cabe no puede esperar en el nodo de salida
+    if ((reorderWindow != 0 || reorderTimeout != DEFAULT_REORDER_TIMEOUT) && reorderGap != ReorderGap::Skip) {
+        throw std::invalid_argument("--reorder-window and --reorder-timeout need --reorder-gap skip (the frames behind a late one wait in the item pool)");
+    }
+    if (reorderGap == ReorderGap::Skip && tileWidth > 0) {
+        throw std::invalid_argument("--reorder-gap skip cannot be used with --tile (a frame is written once all its tiles have been reduced)");
+    }
+    // Los frames retenidos no devuelven su item: el nodo de entrada espera al frame que falta, que necesita otro hilo
+    if (reorder && nThreads < 2 && pipelineName != PipelineType::Serie && pipelineName != PipelineType::SYCLEvents) {
+        throw std::invalid_argument("--reorder needs at least 2 threads (the input node waits for the late frame while the items are held)");
+    }
+
     if constexpr (AUTOMODE_ENABLED) {
         if (!timeSamplingStr.empty()) {
             std::regex timePattern(R"((\d+h)?(\d+m)?(\d+s)?)");
@@ -284,7 +644,7 @@ void InputArgs::parseArguments(int argc, char *argv[]) {
                 int minutes = match[2].length() ? std::stoi(match[2].str().substr(0, match[2].length() - 1)) : 0;
                 int seconds = match[3].length() ? std::stoi(match[3].str().substr(0, match[3].length() - 1)) : 0;
                 timeSampling = std::chrono::hours(hours) + std::chrono::minutes(minutes) + std::chrono::seconds(seconds);
-                std::cout << "Time Sampling: " << timeSampling.count() << " seconds" << std::endl;
+                console << "Time Sampling: " << timeSampling.count() << " seconds" << std::endl;
             } else {
                 throw std::invalid_argument("Invalid time sampling format. Should be like '100'.");
             }
@@ -292,9 +652,9 @@ void InputArgs::parseArguments(int argc, char *argv[]) {
     }
 
     printSeparator();
-    std::cout << " \033[1m" << "API: " << "\033[91m" << PipelineFactory::getPipelineTypeString(pipelineName) << "\033[0m" << std::endl;
+    console << " \033[1m" << "API: " << "\033[91m" << PipelineFactory::getPipelineTypeString(pipelineName) << "\033[0m" << std::endl;
     printSeparator();
-    std::cout << " INPUT ARGUMENTS" << std::endl;
+    console << " INPUT ARGUMENTS" << std::endl;
     printSeparator();
 
     // Si estamos en la versión Serie
@@ -316,13 +676,13 @@ void InputArgs::parseArguments(int argc, char *argv[]) {
 
     // Si el temporizador está activo, se imprime la duración en segundos, si no, se imprime el número de frames
     if (hasDuration()) {
-        std::cout << " Duration: " << duration.count() << " seconds" << std::endl;
+        console << " Duration: " << duration.count() << " seconds" << std::endl;
     } else {
-        std::cout << " Number of Frames: " << numFrames << std::endl;
+        console << " Number of Frames: " << numFrames << std::endl;
     }
 
     if constexpr (AUTOMODE_ENABLED) {
-        std::cout << " Time Sampling: " << timeSampling.count() << " seconds" << std::endl;
+        console << " Time Sampling: " << timeSampling.count() << " seconds" << std::endl;
     }
 
     if (pipelineName != PipelineType::Serie) {
@@ -330,14 +690,15 @@ void InputArgs::parseArguments(int argc, char *argv[]) {
             throw std::invalid_argument("Error parsing the configuration of the stages.");
         }
         // Print number of threads AND configuration of the stages
-        std::cout << " Number of Threads: " << nThreads << std::endl;
-        std::cout << " Config Stages: " << configStagesStr << std::endl;
+        console << " Number of Threads: " << nThreads << std::endl;
+        console << " Stages: " << stagesString() << std::endl;
+        console << " Config Stages: " << configStagesStr << std::endl;
 
         // Si el usuario NO define manualmente el número de frames en vuelo
         int minFramesInFlightSYCL = 2;
         if (inFlightFrames == 0) {
             inFlightFrames = (SYCL_ENABLED) ? std::min(nThreads + GPUactive, minFramesInFlightSYCL) : nThreads + GPUactive;
-            std::clog << " Number of frames in flight: " << inFlightFrames << std::endl;
+            console << " Number of frames in flight: " << inFlightFrames << std::endl;
         }
         // Si el usuario NO define manualmente el tamaño del buffer circular
         if (sizeCircularBuffer == 0) {
@@ -347,16 +708,16 @@ void InputArgs::parseArguments(int argc, char *argv[]) {
             }
         }
         // Print the number of frames in flight
-        std::cout << " In-Flight Frames: " << inFlightFrames << std::endl;
+        console << " In-Flight Frames: " << inFlightFrames << std::endl;
 
         if constexpr (TIMESTAGES_ENABLED || AUTOMODE_ENABLED) {
-            coresGPU = {DEFAULT_CORES_GPU};
+            coresGPU = {defaultCoresGPU()};
             coresCPU = {(SYCL_ENABLED) ? 1 : nThreads};
             sizeGPU = {0};
             sizeCPU = {0};
             exeDevPriority = {1};
         } else if (configStagesStr == "GPU-only") {
-            coresGPU = {DEFAULT_CORES_GPU};
+            coresGPU = {defaultCoresGPU()};
             coresCPU = {0};
             sizeGPU = {nThreads};
             sizeCPU = {0};
@@ -370,11 +731,11 @@ void InputArgs::parseArguments(int argc, char *argv[]) {
         }
 
         if constexpr (__ACQMODE__ == 0) {
-            std::cout << " Acquisition Mode: Default" << std::endl;
+            console << " Acquisition Mode: Default" << std::endl;
         } else if constexpr (__ACQMODE__ == 1) {
-            std::cout << " Acquisition Mode: Acquire cores and queues (primary & secondary)" << std::endl;
+            console << " Acquisition Mode: Acquire cores and queues (primary & secondary)" << std::endl;
         } else if constexpr (__ACQMODE__ == 2) {
-            std::cout << " Acquisition Mode: No Queue" << std::endl;
+            console << " Acquisition Mode: No Queue" << std::endl;
         }
 
         // if constexpr (AUTOMODE_ENABLED) {
@@ -384,8 +745,8 @@ void InputArgs::parseArguments(int argc, char *argv[]) {
         //         sampleFrames = numFrames * ((AVX_ENABLED || SIMD_ENABLED) ? PER_FRAMES_TO_PROCESS_VEC : PER_FRAMES_TO_PROCESS_BAS);
         //     }
         //     if constexpr (VERBOSE_ENABLED) {
-        //         std::cout << " Automatic Mode: Enabled" << std::endl;
-        //         std::cout << " - Number of frames used on sampling: " << sampleFrames << std::endl;
+        //         console << " Automatic Mode: Enabled" << std::endl;
+        //         console << " - Number of frames used on sampling: " << sampleFrames << std::endl;
         //     }
         // }
 
@@ -403,40 +764,40 @@ void InputArgs::parseArguments(int argc, char *argv[]) {
 
         auto printAccInfo = [&](Acc acc, const std::vector<double> &throughput) {
             Device *device = resourcesManager->getDevice(acc);
-            std::cout << " " << device->getAccStr() << ":" << std::endl;
+            console << " " << device->getAccStr() << ":" << std::endl;
 
             // Configurar los anchos de columna para la alineación
             const int labelWidth = 15;
             const int valueWidth = 10;
 
             if (selectedPath == PathSelection::Decoupled) {
-                std::cout << std::left << std::setw(labelWidth) << "  - Cores:" << std::setw(valueWidth) << device->getStage(0)->getTotalCores() << std::endl;
-                std::cout << std::left << std::setw(labelWidth) << "  - Q.Size:" << std::setw(valueWidth) << device->getStage(0)->getMaxQueueSize() << std::endl;
+                console << std::left << std::setw(labelWidth) << "  - Cores:" << std::setw(valueWidth) << device->getStage(0)->getTotalCores() << std::endl;
+                console << std::left << std::setw(labelWidth) << "  - Q.Size:" << std::setw(valueWidth) << device->getStage(0)->getMaxQueueSize() << std::endl;
                 if (throughput[0] != -1) {
-                    std::cout << std::left << std::setw(labelWidth) << "  - Throug.:" << std::setw(valueWidth) << throughput[0] << std::endl;
+                    console << std::left << std::setw(labelWidth) << "  - Throug.:" << std::setw(valueWidth) << throughput[0] << std::endl;
                 }
             } else {
-                for (int i = 0; i < NUM_STAGES; i++) {
-                    std::cout << "  - Stage " << (i + 1) << ":" << std::endl;
-                    std::cout << std::left << std::setw(labelWidth) << "    - Cores:" << std::setw(valueWidth) << device->getStage(i)->getTotalCores() << std::endl;
-                    std::cout << std::left << std::setw(labelWidth) << "    - Q.Size:" << std::setw(valueWidth) << device->getStage(i)->getMaxQueueSize() << std::endl;
+                for (size_t i = 0; i < numStages(); i++) {
+                    console << "  - Stage " << (i + 1) << " (" << stageNames[i] << "):" << std::endl;
+                    console << std::left << std::setw(labelWidth) << "    - Cores:" << std::setw(valueWidth) << device->getStage(i)->getTotalCores() << std::endl;
+                    console << std::left << std::setw(labelWidth) << "    - Q.Size:" << std::setw(valueWidth) << device->getStage(i)->getMaxQueueSize() << std::endl;
                     if (throughput[i] != -1) {
-                        std::cout << std::left << std::setw(labelWidth) << "    - Throug.:" << std::setw(valueWidth) << throughput[i] << std::endl;
+                        console << std::left << std::setw(labelWidth) << "    - Throug.:" << std::setw(valueWidth) << throughput[i] << std::endl;
                     }
                 }
             }
         };
 
-        std::cout << " Device Information:" << std::endl;
+        console << " Device Information:" << std::endl;
         printAccInfo(Acc::GPU, throughput_GPU);
         printAccInfo(Acc::CPU, throughput_CPU);
 
-        std::cout << " Pref. Device:" << std::endl;
+        console << " Pref. Device:" << std::endl;
         if (selectedPath == PathSelection::Decoupled) {
-            std::cout << "  - " << (executionDevicePriority[0] == Acc::GPU ? "GPU" : "CPU") << std::endl;
+            console << "  - " << (executionDevicePriority[0] == Acc::GPU ? "GPU" : "CPU") << std::endl;
         } else {
-            for (int i = 0; i < NUM_STAGES; i++) {
-                std::cout << "  - Stage " << (i + 1) << ": " << (executionDevicePriority[i] == Acc::GPU ? "GPU" : "CPU") << std::endl;
+            for (size_t i = 0; i < numStages(); i++) {
+                console << "  - Stage " << (i + 1) << ": " << (executionDevicePriority[i] == Acc::GPU ? "GPU" : "CPU") << std::endl;
             }
         }
     }
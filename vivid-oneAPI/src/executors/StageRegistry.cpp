@@ -0,0 +1,103 @@
+#include "StageRegistry.hpp"
+#include "ApplicationData.hpp"
+#include "InputArgs.hpp"
+#include "QueuePool.hpp"
+#include "execute_code.hpp"
+#include <mutex>
+#include <stdexcept>
+
+StageRegistry &StageRegistry::instance() {
+    static StageRegistry registry;
+    return registry;
+}
+
+StageRegistry::StageRegistry() {
+    // ViVid kernels
+    add("cosine", Details::cosinefilter<Acc::CPU>, Details::cosinefilter<Acc::GPU>);
+    add("histogram", Details::blockhistogram<Acc::CPU>, Details::blockhistogram<Acc::GPU>);
+    add("pwdist", Details::pwdist<Acc::CPU>, Details::pwdist<Acc::GPU>, true, true);
+    add("pwdist-float", Details::pwdist_variant<Acc::CPU, 64, float>, Details::pwdist_variant<Acc::GPU, 16, float>, true, true);
+    add("pwdist-float4", Details::pwdist_variant<Acc::CPU, 64, sycl::float4>, Details::pwdist_variant<Acc::GPU, 16, sycl::float4>, true, true);
+    add("pwdist-basic", Details::pwdist_variant<Acc::CPU, 0, basic>, Details::pwdist_variant<Acc::GPU, 0, basic>, true, true);
+
+    // Batched GPU kernels of the ViVid kernels (--gpu-batch)
+    setBatchKernel("cosine", cosinefilter_GPU_batch);
+    setBatchKernel("histogram", blockhistogram_GPU_batch);
+    setBatchKernel("pwdist", Details::pwdist_batch);
+    setBatchKernel("pwdist-float", pwdist_GPU_batch<16, float>);
+    setBatchKernel("pwdist-float4", pwdist_GPU_batch<16, sycl::float4>);
+    setBatchKernel("pwdist-basic", pwdist_GPU_batch<0, basic>);
+
+    // Workload simulator: busy waits for the time given by the throughput of the stage (--thcpu, --thgpu)
+    add(
+        "sim",
+        [](ViVidItem *item, Tracer &tracer, ApplicationData &appData, InputArgs &inputArgs, sycl::queue &, std::vector<sycl::event> *) {
+            return workloadsimulator(Acc::CPU, item, tracer, appData, inputArgs, item->stage);
+        },
+        [](ViVidItem *item, Tracer &tracer, ApplicationData &appData, InputArgs &inputArgs, sycl::queue &, std::vector<sycl::event> *) {
+            return workloadsimulator(Acc::GPU, item, tracer, appData, inputArgs, item->stage);
+        },
+        false);
+}
+
+void StageRegistry::add(const std::string &name, StageKernel cpu, StageKernel gpu, bool enqueues, bool classifier) {
+    if (name.empty() || name.find_first_of(",|: \t") != std::string::npos) {
+        throw std::invalid_argument("StageRegistry: invalid stage name '" + name + "'");
+    }
+    if (!cpu || !gpu) {
+        throw std::invalid_argument("StageRegistry: the stage '" + name + "' needs a kernel for each device");
+    }
+    if (!stages.emplace(name, StageKernels{name, std::move(cpu), std::move(gpu), enqueues, classifier}).second) {
+        throw std::invalid_argument("StageRegistry: the stage '" + name + "' is already registered");
+    }
+}
+
+void StageRegistry::setBatchKernel(const std::string &name, StageBatchKernel gpuBatch) {
+    if (!gpuBatch) {
+        throw std::invalid_argument("StageRegistry: empty batched kernel for the stage '" + name + "'");
+    }
+    auto it = stages.find(name);
+    if (it == stages.end()) {
+        throw std::invalid_argument("StageRegistry: the stage '" + name + "' is not registered");
+    }
+    it->second.gpuBatch = std::move(gpuBatch);
+}
+
+const StageKernels &StageRegistry::get(const std::string &name) const {
+    auto it = stages.find(name);
+    if (it == stages.end()) {
+        std::string known;
+        for (const auto &stage : stages) {
+            known += (known.empty() ? "" : ", ") + stage.first;
+        }
+        throw std::invalid_argument("Unknown stage '" + name + "' (registered stages: " + known + ")");
+    }
+    return it->second;
+}
+
+std::vector<std::string> StageRegistry::names() const {
+    std::vector<std::string> result;
+    result.reserve(stages.size());
+    for (const auto &stage : stages) {
+        result.push_back(stage.first);
+    }
+    return result;
+}
+
+SyclEventInfo runStage(std::size_t stage, Acc acc, ViVidItem *item, Tracer &tracer, ApplicationData &appData, InputArgs &inputArgs, StageBatcher *batcher, sycl::queue &Q,
+                       std::vector<sycl::event> *depends_on) {
+    // An item is in one stage at a time (the branches take turns), so the kernels can read their position from the item
+    std::unique_lock<std::mutex> lock(item->branchMutex, std::defer_lock);
+    if (inputArgs.isBranch(stage)) {
+        lock.lock();
+    }
+    item->stage = static_cast<int>(stage);
+    // The stages of a frame submit to the queues assigned to it (--queues)
+    sycl::queue &queue = item->queuePool != nullptr ? item->queuePool->queueOf(item, Q) : Q;
+    // With --gpu-batch the GPU stages that have a batched kernel launch the frames that reach them together
+    const StageKernels &kernels = *inputArgs.stages[stage];
+    if (acc == Acc::GPU && batcher != nullptr && kernels.gpuBatch) {
+        return batcher->submit(stage, kernels.gpuBatch, item, tracer, appData, inputArgs, queue, depends_on);
+    }
+    return kernels(acc, item, tracer, appData, inputArgs, queue, depends_on);
+}
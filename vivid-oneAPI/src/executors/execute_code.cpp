@@ -12,7 +12,7 @@ template <>
 SyclEventInfo cosinefilter<Acc::CPU>(Pipeline_template::ViVidItem *item, Tracer &my_tracer, ApplicationData &appData, InputArgs &inputArgs, sycl::queue &Q, std::vector<sycl::event> *depends_on) {
     SyclEventInfo my_event = cosinefilter_CPU(item, my_tracer, appData, inputArgs, Q, depends_on);
     if constexpr (ENERGYPCM_ENABLED || AUTOMODE_ENABLED || TIMESTAGES_ENABLED) {
-        appData.numFiltersCPU[0]++;
+        appData.numFiltersCPU[item->stage]++;
     }
     return my_event;
 }
@@ -21,7 +21,7 @@ template <>
 SyclEventInfo cosinefilter<Acc::GPU>(Pipeline_template::ViVidItem *item, Tracer &my_tracer, ApplicationData &appData, InputArgs &inputArgs, sycl::queue &Q, std::vector<sycl::event> *depends_on) {
     SyclEventInfo my_event = cosinefilter_GPU(item, my_tracer, appData, inputArgs, Q, depends_on);
     if constexpr (ENERGYPCM_ENABLED || AUTOMODE_ENABLED || TIMESTAGES_ENABLED) {
-        appData.numFiltersGPU[0]++;
+        appData.numFiltersGPU[item->stage]++;
     }
     return my_event;
 }
@@ -33,7 +33,7 @@ template <>
 SyclEventInfo blockhistogram<Acc::CPU>(Pipeline_template::ViVidItem *item, Tracer &my_tracer, ApplicationData &appData, InputArgs &inputArgs, sycl::queue &Q, std::vector<sycl::event> *depends_on) {
     SyclEventInfo my_event = blockhistogram_CPU(item, my_tracer, appData, inputArgs, Q, depends_on);
     if constexpr (ENERGYPCM_ENABLED || AUTOMODE_ENABLED || TIMESTAGES_ENABLED) {
-        appData.numFiltersCPU[1]++;
+        appData.numFiltersCPU[item->stage]++;
     }
     return my_event;
 }
@@ -42,7 +42,7 @@ template <>
 SyclEventInfo blockhistogram<Acc::GPU>(Pipeline_template::ViVidItem *item, Tracer &my_tracer, ApplicationData &appData, InputArgs &inputArgs, sycl::queue &Q, std::vector<sycl::event> *depends_on) {
     SyclEventInfo my_event = blockhistogram_GPU(item, my_tracer, appData, inputArgs, Q, depends_on);
     if constexpr (ENERGYPCM_ENABLED || AUTOMODE_ENABLED || TIMESTAGES_ENABLED) {
-        appData.numFiltersGPU[1]++;
+        appData.numFiltersGPU[item->stage]++;
     }
     return my_event;
 }
@@ -50,6 +50,33 @@ SyclEventInfo blockhistogram<Acc::GPU>(Pipeline_template::ViVidItem *item, Trace
 // *********************************************************************************************************************
 // FILTER 3:
 // *********************************************************************************************************************
+template <Acc D, size_t tile_size, typename T>
+SyclEventInfo pwdist_variant(Pipeline_template::ViVidItem *item, Tracer &my_tracer, ApplicationData &appData, InputArgs &inputArgs, sycl::queue &Q, std::vector<sycl::event> *depends_on) {
+    SyclEventInfo my_event;
+    if constexpr (D == Acc::GPU) {
+        my_event = pwdist_GPU<tile_size, T>(item, my_tracer, appData, inputArgs, Q, depends_on);
+    } else {
+        my_event = pwdist_CPU<tile_size, T>(item, my_tracer, appData, inputArgs, Q, depends_on);
+    }
+    if constexpr (ENERGYPCM_ENABLED || AUTOMODE_ENABLED || TIMESTAGES_ENABLED) {
+        if constexpr (D == Acc::GPU) {
+            appData.numFiltersGPU[item->stage]++;
+        } else {
+            appData.numFiltersCPU[item->stage]++;
+        }
+    }
+    return my_event;
+}
+
+template SyclEventInfo pwdist_variant<Acc::CPU, 64, float>(Pipeline_template::ViVidItem *item, Tracer &my_tracer, ApplicationData &appData, InputArgs &inputArgs, sycl::queue &Q, std::vector<sycl::event> *depends_on);
+template SyclEventInfo pwdist_variant<Acc::CPU, 64, sycl::float4>(Pipeline_template::ViVidItem *item, Tracer &my_tracer, ApplicationData &appData, InputArgs &inputArgs, sycl::queue &Q, std::vector<sycl::event> *depends_on);
+template SyclEventInfo pwdist_variant<Acc::CPU, 0, basic>(Pipeline_template::ViVidItem *item, Tracer &my_tracer, ApplicationData &appData, InputArgs &inputArgs, sycl::queue &Q, std::vector<sycl::event> *depends_on);
+template SyclEventInfo pwdist_variant<Acc::GPU, 16, float>(Pipeline_template::ViVidItem *item, Tracer &my_tracer, ApplicationData &appData, InputArgs &inputArgs, sycl::queue &Q, std::vector<sycl::event> *depends_on);
+template SyclEventInfo pwdist_variant<Acc::GPU, 16, sycl::float4>(Pipeline_template::ViVidItem *item, Tracer &my_tracer, ApplicationData &appData, InputArgs &inputArgs, sycl::queue &Q, std::vector<sycl::event> *depends_on);
+template SyclEventInfo pwdist_variant<Acc::GPU, 0, basic>(Pipeline_template::ViVidItem *item, Tracer &my_tracer, ApplicationData &appData, InputArgs &inputArgs, sycl::queue &Q, std::vector<sycl::event> *depends_on);
+
+// The variant of the "pwdist" stage is chosen at build time with __PWDIST__ (the others are registered as
+// pwdist-float, pwdist-float4 and pwdist-basic)
 template <>
 SyclEventInfo pwdist<Acc::CPU>(Pipeline_template::ViVidItem *item, Tracer &my_tracer, ApplicationData &appData, InputArgs &inputArgs, sycl::queue &Q, std::vector<sycl::event> *depends_on) {
 #if __PWDIST__ == 1
@@ -65,11 +92,7 @@ SyclEventInfo pwdist<Acc::CPU>(Pipeline_template::ViVidItem *item, Tracer &my_tr
     constexpr size_t tile_size = 64;
     using T = float;
 #endif
-    SyclEventInfo my_event = pwdist_CPU<tile_size, T>(item, my_tracer, appData, inputArgs, Q, depends_on);
-    if constexpr (ENERGYPCM_ENABLED || AUTOMODE_ENABLED || TIMESTAGES_ENABLED) {
-        appData.numFiltersCPU[2]++;
-    }
-    return my_event;
+    return pwdist_variant<Acc::CPU, tile_size, T>(item, my_tracer, appData, inputArgs, Q, depends_on);
 }
 
 template <>
@@ -87,40 +110,21 @@ SyclEventInfo pwdist<Acc::GPU>(Pipeline_template::ViVidItem *item, Tracer &my_tr
     constexpr size_t tile_size = 16;
     using T = sycl::float4;
 #endif
-    SyclEventInfo my_event = pwdist_GPU<tile_size, T>(item, my_tracer, appData, inputArgs, Q, depends_on);
-    if constexpr (ENERGYPCM_ENABLED || AUTOMODE_ENABLED || TIMESTAGES_ENABLED) {
-        appData.numFiltersGPU[2]++;
-    }
-    return my_event;
+    return pwdist_variant<Acc::GPU, tile_size, T>(item, my_tracer, appData, inputArgs, Q, depends_on);
 }
-} // namespace Details
 
-// General dispatch function
-SyclEventInfo cosinefilter(Acc acc, ViVidItem *item, Tracer &my_tracer, ApplicationData &appData, InputArgs &inputArgs, sycl::queue &Q, std::vector<sycl::event> *depends_on) {
-    if (acc == Acc::GPU) {
-        return Details::cosinefilter<Acc::GPU>(item, my_tracer, appData, inputArgs, Q, depends_on);
-    } else {
-        return Details::cosinefilter<Acc::CPU>(item, my_tracer, appData, inputArgs, Q, depends_on);
-    }
-}
-
-// General dispatch function
-SyclEventInfo blockhistogram(Acc acc, ViVidItem *item, Tracer &my_tracer, ApplicationData &appData, InputArgs &inputArgs, sycl::queue &Q, std::vector<sycl::event> *depends_on) {
-    if (acc == Acc::GPU) {
-        return Details::blockhistogram<Acc::GPU>(item, my_tracer, appData, inputArgs, Q, depends_on);
-    } else {
-        return Details::blockhistogram<Acc::CPU>(item, my_tracer, appData, inputArgs, Q, depends_on);
-    }
-}
-
-// General dispatch function
-SyclEventInfo pwdist(Acc acc, ViVidItem *item, Tracer &my_tracer, ApplicationData &appData, InputArgs &inputArgs, sycl::queue &Q, std::vector<sycl::event> *depends_on) {
-    if (acc == Acc::GPU) {
-        return Details::pwdist<Acc::GPU>(item, my_tracer, appData, inputArgs, Q, depends_on);
-    } else {
-        return Details::pwdist<Acc::CPU>(item, my_tracer, appData, inputArgs, Q, depends_on);
-    }
+sycl::event pwdist_batch(Pipeline_template::ViVidItem *const *items, std::size_t count, ApplicationData &appData, sycl::queue &Q, const std::vector<sycl::event> *depends_on) {
+#if __PWDIST__ == 1
+    return pwdist_GPU_batch<16, float>(items, count, appData, Q, depends_on);
+#elif __PWDIST__ == 2
+    return pwdist_GPU_batch<16, sycl::float4>(items, count, appData, Q, depends_on);
+#elif __PWDIST__ == 3
+    return pwdist_GPU_batch<0, basic>(items, count, appData, Q, depends_on);
+#else
+    return pwdist_GPU_batch<16, sycl::float4>(items, count, appData, Q, depends_on);
+#endif
 }
+} // namespace Details
 
 SyclEventInfo workloadsimulator(Acc acc, ViVidItem *item, Tracer &my_tracer, ApplicationData &appData, InputArgs &inputArgs, int stage) {
     trace_start(item, my_tracer, (acc == Acc::GPU) ? "GPU" : "CPU");
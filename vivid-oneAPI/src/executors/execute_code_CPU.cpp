@@ -15,31 +15,34 @@ SyclEventInfo cosinefilter_CPU(ViVidItem *item, Tracer &my_tracer, ApplicationDa
     trace_start(item, my_tracer, "CPU");
     start_timer(item);
     // Get the pointers to the data
-    float *ptr_frame, *ptr_ind, *ptr_val;
+    float *ptr_ind, *ptr_val;
     int f_pitch_f;
-    get_ptrs_cosine(item, ptr_frame, ptr_ind, ptr_val, f_pitch_f);
+    get_ptrs_cosine(item, ptr_ind, ptr_val, f_pitch_f);
 
     sycl::event m_event;
     if constexpr (SYCL_ENABLED) {
+        // The filter reads the pixels with the type of the input (float32, uint8 or uint16)
+        m_event = item->frame->visitPixels(BUF_READ, [&](auto *ptr_frame) {
+            return cosine_filter_transpose_sycl(ptr_frame, ptr_ind, ptr_val, appData.filterBank, appData.height, appData.width, appData.filterSize, appData.numFilters, f_pitch_f, get_active_pixels(item, appData), Q, depends_on);
+        });
         if (depends_on != nullptr) {
-            m_event = cosine_filter_transpose_sycl(ptr_frame, ptr_ind, ptr_val, appData.filterBank, appData.height, appData.width, appData.filterSize, appData.numFilters, f_pitch_f, Q, depends_on);
             wait_sycl_event(m_event);
-        } else {
-            m_event = cosine_filter_transpose_sycl(ptr_frame, ptr_ind, ptr_val, appData.filterBank, appData.height, appData.width, appData.filterSize, appData.numFilters, f_pitch_f, Q);
         }
         // Save the execution time
-        save_time_info_on_sycl(item, inputArgs, m_event, 0, "CPU_S");
+        save_time_info_on_sycl(item, inputArgs, m_event, item->stage, "CPU_S");
     } else {
-        if constexpr (AVX_ENABLED) {
-            cosine_filter_AVX(ptr_frame, ptr_ind, ptr_val, appData.filterBank, appData.height, appData.width, appData.filterDim, appData.filterDim, appData.numFilters, item->val->pitch);
-        } else if constexpr (SIMD_ENABLED) {
-            cosine_filter_SIMD(ptr_frame, ptr_ind, ptr_val, appData.filterBank, appData.height, appData.width, appData.filterDim, appData.filterDim, appData.numFilters, item->val->pitch);
-        } else {
-            cosine_filter_transpose(ptr_frame, ptr_ind, ptr_val, appData.filterBank, appData.height, appData.width, appData.filterDim, appData.filterDim, appData.numFilters, item->val->pitch);
-        }
+        item->frame->visitPixels(BUF_READ, [&](auto *ptr_frame) {
+            if constexpr (AVX_ENABLED) {
+                cosine_filter_AVX(ptr_frame, ptr_ind, ptr_val, appData.filterBank, appData.height, appData.width, appData.filterDim, appData.filterDim, appData.numFilters, item->val->pitch, get_active_pixels(item, appData));
+            } else if constexpr (SIMD_ENABLED) {
+                cosine_filter_SIMD(ptr_frame, ptr_ind, ptr_val, appData.filterBank, appData.height, appData.width, appData.filterDim, appData.filterDim, appData.numFilters, item->val->pitch, get_active_pixels(item, appData));
+            } else {
+                cosine_filter_transpose(ptr_frame, ptr_ind, ptr_val, appData.filterBank, appData.height, appData.width, appData.filterDim, appData.filterDim, appData.numFilters, item->val->pitch, get_active_pixels(item, appData));
+            }
+        });
         // Save the trace information and execution time
         save_trace_info(item);
-        save_time_info_normal(item, 0, "CPU_S");
+        save_time_info_normal(item, item->stage, "CPU_S");
     }
     // End tracing
     trace_end(item, my_tracer, "CPU");
@@ -59,24 +62,24 @@ SyclEventInfo blockhistogram_CPU(ViVidItem *item, Tracer &my_tracer, Application
     sycl::event m_event;
     if constexpr (SYCL_ENABLED) {
         if (depends_on != nullptr) {
-            m_event = block_histogram_sycl(ptr_his, ptr_ind, ptr_val, appData.cellSize, appData.height, appData.width, histogram_pitch_f, assignments_pitch_f, weights_pitch_f, Q, depends_on);
+            m_event = block_histogram_sycl(ptr_his, ptr_ind, ptr_val, appData.cellSize, appData.height, appData.width, histogram_pitch_f, assignments_pitch_f, weights_pitch_f, get_active_cells(item, appData), Q, depends_on);
             wait_sycl_event(m_event);
         } else {
-            m_event = block_histogram_sycl(ptr_his, ptr_ind, ptr_val, appData.cellSize, appData.height, appData.width, histogram_pitch_f, assignments_pitch_f, weights_pitch_f, Q);
+            m_event = block_histogram_sycl(ptr_his, ptr_ind, ptr_val, appData.cellSize, appData.height, appData.width, histogram_pitch_f, assignments_pitch_f, weights_pitch_f, get_active_cells(item, appData), Q);
         }
         // Save the execution time
-        save_time_info_on_sycl(item, inputArgs, m_event, 1, "CPU_S");
+        save_time_info_on_sycl(item, inputArgs, m_event, item->stage, "CPU_S");
     } else {
         if constexpr (AVX_ENABLED) {
-            block_histogram_AVX(ptr_his, ptr_ind, ptr_val, appData.numFilters, appData.cellSize, appData.height, appData.width, histogram_pitch_f, assignments_pitch_f);
+            block_histogram_AVX(ptr_his, ptr_ind, ptr_val, appData.numFilters, appData.cellSize, appData.height, appData.width, histogram_pitch_f, assignments_pitch_f, get_active_cells(item, appData));
         } else if constexpr (SIMD_ENABLED) {
-            block_histogram_SIMD(ptr_his, ptr_ind, ptr_val, appData.numFilters, appData.cellSize, appData.height, appData.width, histogram_pitch_f, assignments_pitch_f);
+            block_histogram_SIMD(ptr_his, ptr_ind, ptr_val, appData.numFilters, appData.cellSize, appData.height, appData.width, histogram_pitch_f, assignments_pitch_f, get_active_cells(item, appData));
         } else {
-            block_histogram(ptr_his, ptr_ind, ptr_val, appData.numFilters, appData.cellSize, appData.height, appData.width, histogram_pitch_f, assignments_pitch_f);
+            block_histogram(ptr_his, ptr_ind, ptr_val, appData.numFilters, appData.cellSize, appData.height, appData.width, histogram_pitch_f, assignments_pitch_f, get_active_cells(item, appData));
         }
         // Save the trace information and execution time
         save_trace_info(item);
-        save_time_info_normal(item, 1, "CPU_S");
+        save_time_info_normal(item, item->stage, "CPU_S");
     }
     // End tracing
     trace_end(item, my_tracer, "CPU");
@@ -119,7 +122,7 @@ SyclEventInfo pwdist_CPU(ViVidItem *item, Tracer &my_tracer, ApplicationData &ap
             }
         }
         // Save the execution time
-        save_time_info_on_sycl(item, inputArgs, m_event, 2, "CPU_S");
+        save_time_info_on_sycl(item, inputArgs, m_event, item->stage, "CPU_S");
     } else {
         if constexpr (AVX_ENABLED) {
             pwdist_AVX_cache_locality(ptra, ptrb, out, owidth, aheight, awidth, bheight, adatawidth);
@@ -129,7 +132,7 @@ SyclEventInfo pwdist_CPU(ViVidItem *item, Tracer &my_tracer, ApplicationData &ap
             pwdist_c(ptra, ptrb, out, owidth, aheight, awidth, bheight, adatawidth);
         }
         save_trace_info(item);
-        save_time_info_normal(item, 2, "CPU_S");
+        save_time_info_normal(item, item->stage, "CPU_S");
     }
     // End tracing
     trace_end(item, my_tracer, "CPU");
@@ -5,6 +5,9 @@
 
 #include "execute_code_GPU.hpp"
 #include "common_macros.hpp"
+#include <array>
+#include <stdexcept>
+#include <type_traits>
 
 using namespace std;
 
@@ -14,24 +17,25 @@ SyclEventInfo cosinefilter_GPU(ViVidItem *item, Tracer &my_tracer, ApplicationDa
     trace_start(item, my_tracer, "GPU");
     start_timer(item);
     // Get the pointers to the data
-    float *ptr_frame, *ptr_ind, *ptr_val;
+    float *ptr_ind, *ptr_val;
     int f_pitch_f;
-    get_ptrs_cosine(item, ptr_frame, ptr_ind, ptr_val, f_pitch_f);
+    get_ptrs_cosine(item, ptr_ind, ptr_val, f_pitch_f);
 
     // Reset the execution time
     item->execution_time = 0.0;
     // Create the event info
     sycl::event m_event;
 
+    // The kernel reads the pixels with the type of the input (float32, uint8 or uint16)
+    m_event = item->frame->visitPixels(BUF_READ, [&](auto *ptr_frame) {
+        return cosine_filter_transpose_sycl(ptr_frame, ptr_ind, ptr_val, appData.filterBank, appData.height, appData.width, appData.filterSize, appData.numFilters, f_pitch_f, get_active_pixels(item, appData), Q, depends_on);
+    });
     if (depends_on != nullptr) {
-        m_event = cosine_filter_transpose_sycl(ptr_frame, ptr_ind, ptr_val, appData.filterBank, appData.height, appData.width, appData.filterSize, appData.numFilters, f_pitch_f, Q, depends_on);
         wait_sycl_event(m_event);
-    } else {
-        m_event = cosine_filter_transpose_sycl(ptr_frame, ptr_ind, ptr_val, appData.filterBank, appData.height, appData.width, appData.filterSize, appData.numFilters, f_pitch_f, Q);
     }
 
     // Save the execution time and end tracing
-    save_time_info_on_sycl(item, inputArgs, m_event, 0, "GPU_S");
+    save_time_info_on_sycl(item, inputArgs, m_event, item->stage, "GPU_S");
     trace_end(item, my_tracer, "GPU");
 
     return SyclEventInfo(m_event, item->execution_time, Acc::GPU);
@@ -53,15 +57,15 @@ SyclEventInfo blockhistogram_GPU(ViVidItem *item, Tracer &my_tracer, Application
     sycl::event m_event;
 
     if (depends_on != nullptr) {
-        m_event = block_histogram_sycl(ptr_his, ptr_ind, ptr_val, appData.cellSize, appData.height, appData.width, histogram_pitch_f, assignments_pitch_f, weights_pitch_f, Q, depends_on);
+        m_event = block_histogram_sycl(ptr_his, ptr_ind, ptr_val, appData.cellSize, appData.height, appData.width, histogram_pitch_f, assignments_pitch_f, weights_pitch_f, get_active_cells(item, appData), Q, depends_on);
         if constexpr (TRACE_ENABLED)
             m_event.wait();
     } else {
-        m_event = block_histogram_sycl(ptr_his, ptr_ind, ptr_val, appData.cellSize, appData.height, appData.width, histogram_pitch_f, assignments_pitch_f, weights_pitch_f, Q);
+        m_event = block_histogram_sycl(ptr_his, ptr_ind, ptr_val, appData.cellSize, appData.height, appData.width, histogram_pitch_f, assignments_pitch_f, weights_pitch_f, get_active_cells(item, appData), Q);
     }
 
     // Save the execution time and end tracing
-    save_time_info_on_sycl(item, inputArgs, m_event, 1, "GPU_S");
+    save_time_info_on_sycl(item, inputArgs, m_event, item->stage, "GPU_S");
     trace_end(item, my_tracer, "GPU");
 
     return SyclEventInfo(m_event, item->execution_time, Acc::GPU);
@@ -110,7 +114,7 @@ SyclEventInfo pwdist_GPU(ViVidItem *item, Tracer &my_tracer, ApplicationData &ap
     }
 
     // Save the execution time and end tracing
-    save_time_info_on_sycl(item, inputArgs, m_event, 2, "GPU_S");
+    save_time_info_on_sycl(item, inputArgs, m_event, item->stage, "GPU_S");
     trace_end(item, my_tracer, "GPU");
 
     return SyclEventInfo(m_event, item->execution_time, Acc::GPU);
@@ -119,4 +123,61 @@ SyclEventInfo pwdist_GPU(ViVidItem *item, Tracer &my_tracer, ApplicationData &ap
 // Explicit template instantiation
 template SyclEventInfo pwdist_GPU<0, basic>(ViVidItem *item, Tracer &my_tracer, ApplicationData &appData, InputArgs &inputArgs, sycl::queue &Q, std::vector<sycl::event> *depends_on);
 template SyclEventInfo pwdist_GPU<16, sycl::float4>(ViVidItem *item, Tracer &my_tracer, ApplicationData &appData, InputArgs &inputArgs, sycl::queue &Q, std::vector<sycl::event> *depends_on);
-template SyclEventInfo pwdist_GPU<16, float>(ViVidItem *item, Tracer &my_tracer, ApplicationData &appData, InputArgs &inputArgs, sycl::queue &Q, std::vector<sycl::event> *depends_on);
\ No newline at end of file
+template SyclEventInfo pwdist_GPU<16, float>(ViVidItem *item, Tracer &my_tracer, ApplicationData &appData, InputArgs &inputArgs, sycl::queue &Q, std::vector<sycl::event> *depends_on);
+// *********************************************************************************************************************
+// BATCHES (--gpu-batch)
+// *********************************************************************************************************************
+// Implementation of cosinefilter_GPU_batch function
+sycl::event cosinefilter_GPU_batch(ViVidItem *const *items, std::size_t count, ApplicationData &appData, sycl::queue &Q, const std::vector<sycl::event> *depends_on) {
+    const PixelType pixelType = items[0]->frame->pixelType;
+    return items[0]->frame->visitPixels(BUF_READ, [&](auto *first_frame) {
+        using Pixel = std::remove_const_t<std::remove_pointer_t<decltype(first_frame)>>;
+        std::array<CosineBatchFrame<Pixel>, MAX_GPU_BATCH> frames;
+        for (std::size_t i = 0; i < count; i++) {
+            ViVidItem *item = items[i];
+            if (item->frame->pixelType != pixelType) {
+                throw std::invalid_argument("cosinefilter_GPU_batch: the frames of a batch must have the same pixel type");
+            }
+            float *ptr_ind, *ptr_val;
+            int f_pitch_f;
+            get_ptrs_cosine(item, ptr_ind, ptr_val, f_pitch_f);
+            frames[i] = {item->frame->pixels<Pixel>(BUF_READ), ptr_ind, ptr_val, f_pitch_f, get_active_pixels(item, appData)};
+        }
+        return cosine_filter_transpose_sycl_batch(frames.data(), static_cast<int>(count), appData.filterBank, appData.height, appData.width, appData.filterSize, appData.numFilters, Q, depends_on);
+    });
+}
+
+// Implementation of blockhistogram_GPU_batch function
+sycl::event blockhistogram_GPU_batch(ViVidItem *const *items, std::size_t count, ApplicationData &appData, sycl::queue &Q, const std::vector<sycl::event> *depends_on) {
+    std::array<HistogramBatchFrame, MAX_GPU_BATCH> frames;
+    for (std::size_t i = 0; i < count; i++) {
+        HistogramBatchFrame &frame = frames[i];
+        get_ptrs_histogram(items[i], appData, frame.ptr_his, frame.ptr_val, frame.ptr_ind, frame.histogram_pitch_f, frame.assignments_pitch_f, frame.weights_pitch_f);
+        frame.cells = get_active_cells(items[i], appData);
+    }
+    return block_histogram_sycl_batch(frames.data(), static_cast<int>(count), appData.cellSize, Q, depends_on);
+}
+
+// Implementation of pwdist_GPU_batch function
+template <size_t tile_size, typename T>
+sycl::event pwdist_GPU_batch(ViVidItem *const *items, std::size_t count, ApplicationData &appData, sycl::queue &Q, const std::vector<sycl::event> *depends_on) {
+    std::array<PwdistBatchFrame, MAX_GPU_BATCH> frames;
+    for (std::size_t i = 0; i < count; i++) {
+        PwdistBatchFrame &frame = frames[i];
+        get_ptrs_pwdist(items[i], frame.ptra, frame.ptrb, frame.out_data, frame.owidth, frame.aheight, frame.awidth, frame.bheight, frame.adatawidth);
+    }
+
+    if constexpr (std::is_same_v<T, float>) {
+        return pwdist_sycl_tiled_batch<tile_size>(frames.data(), static_cast<int>(count), Q, depends_on);
+    } else if constexpr (std::is_same_v<T, sycl::float4>) {
+        return pwdist_sycl_tiled_float4_batch<tile_size>(frames.data(), static_cast<int>(count), Q, depends_on);
+    } else {
+        static_assert(std::is_same_v<T, basic>, "pwdist_GPU_batch: type not supported");
+        return pwdist_sycl_basic_batch(frames.data(), static_cast<int>(count), Q, depends_on);
+    }
+}
+
+// Explicit template instantiation
+template sycl::event pwdist_GPU_batch<0, basic>(ViVidItem *const *items, std::size_t count, ApplicationData &appData, sycl::queue &Q, const std::vector<sycl::event> *depends_on);
+template sycl::event pwdist_GPU_batch<16, sycl::float4>(ViVidItem *const *items, std::size_t count, ApplicationData &appData, sycl::queue &Q, const std::vector<sycl::event> *depends_on);
+template sycl::event pwdist_GPU_batch<16, float>(ViVidItem *const *items, std::size_t count, ApplicationData &appData, sycl::queue &Q, const std::vector<sycl::event> *depends_on);
@@ -94,6 +94,7 @@ std::string JSONFile::generateCommonKey(const ApplicationData &appData, const In
                 (SYCL_ENABLED ? "SYCL" : (AVX_ENABLED ? "AVX" : (SIMD_ENABLED ? "SIMD" : "C++"))) + "_" +
                 ((__BACKEND__ == 0) ? "OpenCL" : ((__BACKEND__ == 1) ? "LevelZero" : "CUDA")) + "_" +
                 inputArgs.configStagesStr + "_" +
+                inputArgs.stagesString() + "_" +
                 std::to_string(inputArgs.inFlightFrames) + "_" +
                 std::to_string(inputArgs.nThreads) + "_" +
                 inputArgs.getPrefDevice() + "_" +
@@ -116,19 +117,19 @@ std::string JSONFile::generateCommonKey(const ApplicationData &appData, const In
     }
 
     if (deviceGPU != nullptr) {
-        for (int i = 0; i < NUM_STAGES; ++i) {
+        for (size_t i = 0; i < inputArgs.numStages(); ++i) {
             commonKey += std::to_string(deviceGPU->getStage(i)->getTotalCores()) + "_";
         }
-        for (int i = 0; i < NUM_STAGES; ++i) {
+        for (size_t i = 0; i < inputArgs.numStages(); ++i) {
             commonKey += std::to_string(deviceGPU->getStage(i)->getMaxQueueSize()) + "_";
         }
     }
 
     if (deviceCPU != nullptr) {
-        for (int i = 0; i < NUM_STAGES; ++i) {
+        for (size_t i = 0; i < inputArgs.numStages(); ++i) {
             commonKey += std::to_string(deviceCPU->getStage(i)->getTotalCores()) + "_";
         }
-        for (int i = 0; i < NUM_STAGES; ++i) {
+        for (size_t i = 0; i < inputArgs.numStages(); ++i) {
             commonKey += std::to_string(deviceCPU->getStage(i)->getMaxQueueSize()) + "_";
         }
     }
@@ -189,6 +190,26 @@ std::string JSONFile::prepareDirectory(const InputArgs &inputArgs, char *executa
     return base_path.string();
 }
 
+// Real-time statistics of the synthetic camera (--camera)
+static void addCameraData(nlohmann::json &commonData, nlohmann::json &variableData, const CameraStats &stats) {
+    commonData["Camera FPS"] = stats.fps;
+    commonData["Camera Burst"] = stats.burst;
+    commonData["Camera Jitter (ms)"] = stats.jitter;
+    commonData["Deadline (ms)"] = stats.deadline;
+    variableData["Camera Frames"] = stats.frames;
+    variableData["Achieved FPS"] = stats.achievedFps;
+    variableData["Deadline Misses"] = stats.deadlineMisses;
+    variableData["Deadline Miss Rate (%)"] = stats.frames > 0 ? 100.0 * stats.deadlineMisses / stats.frames : 0.0;
+    variableData["Queueing Delay Avg (ms)"] = stats.queueingDelay.avg;
+    variableData["Queueing Delay P99 (ms)"] = stats.queueingDelay.p99;
+    variableData["Queueing Delay Max (ms)"] = stats.queueingDelay.max;
+    variableData["Latency Avg (ms)"] = stats.latency.avg;
+    variableData["Latency P50 (ms)"] = stats.latency.p50;
+    variableData["Latency P90 (ms)"] = stats.latency.p90;
+    variableData["Latency P99 (ms)"] = stats.latency.p99;
+    variableData["Latency Max (ms)"] = stats.latency.max;
+}
+
 std::pair<nlohmann::json, nlohmann::json> JSONFile::buildDataMap(const ApplicationData &appData, const InputArgs &inputArgs) {
     if constexpr (VERBOSE_ENABLED) {
         std::cout << "Building data map." << std::endl;
@@ -202,9 +223,13 @@ std::pair<nlohmann::json, nlohmann::json> JSONFile::buildDataMap(const Applicati
         commonData["Resolution"] = inputArgs.getImageTypeToString();
         commonData["Num. Threads"] = inputArgs.nThreads;
         commonData["Config. Stages"] = inputArgs.configStagesStr;
+        commonData["Stages"] = inputArgs.stagesString();
         variableData["Num. Frames"] = inputArgs.numFrames;
         variableData["Throughput (FPS)"] = appData.throughput;
         variableData["Tot. Time (ms)"] = appData.totalTime;
+        if (inputArgs.cameraFps > 0.0) {
+            addCameraData(commonData, variableData, appData.cameraStats);
+        }
 
         return {commonData, variableData};
     }
@@ -214,11 +239,29 @@ std::pair<nlohmann::json, nlohmann::json> JSONFile::buildDataMap(const Applicati
     commonData["Backend CPU"] = SYCL_ENABLED ? "SYCL" : (AVX_ENABLED ? "AVX" : (SIMD_ENABLED ? "SIMD" : "C++"));
     commonData["Backend GPU"] = (__BACKEND__ == 0) ? "OpenCL" : ((__BACKEND__ == 1) ? "Level Zero" : "CUDA");
     commonData["Config. Stages"] = inputArgs.configStagesStr;
+    commonData["Stages"] = inputArgs.stagesString();
     commonData["In-flight Frames"] = inputArgs.inFlightFrames;
     commonData["Num. Threads"] = inputArgs.nThreads;
     commonData["Pref. Device"] = inputArgs.getPrefDevice();
     commonData["Queue Order"] = (INORDER_QUEUE) ? "sycl::queue::in_order" : "sycl::queue::out_of_order";
     commonData["Resolution"] = inputArgs.getImageTypeToString();
+    if (!inputArgs.inputPath.empty()) {
+        commonData["Input"] = inputArgs.inputPath;
+        commonData["I/O Backend"] = appData.ingestStats.sharedMemory ? (appData.ingestStats.zeroCopy ? "shm (zero copy)" : "shm (copy)") : ioBackendName(appData.ingestStats.backend);
+        commonData["I/O Depth"] = appData.ingestStats.ioDepth;
+        commonData["Direct I/O"] = inputArgs.directIO;
+        commonData["Resolution"] = std::to_string(appData.width) + "x" + std::to_string(appData.height);
+        if (appData.ingestStats.tiles > 0) {
+            // The items are tiles: the resolution above is the one of a tile
+            commonData["Tiles per Frame"] = appData.ingestStats.tiles;
+            commonData["Tile Overhead"] = appData.ingestStats.tileOverhead;
+        }
+    }
+    commonData["Pixel Type"] = FrameContainer::pixelTypeName(appData.pixelType);
+    if (!inputArgs.roiPath.empty()) {
+        commonData["ROI List"] = inputArgs.roiPath;
+        commonData["ROI Active Fraction"] = appData.activeFraction;
+    }
 
     Device *deviceGPU = inputArgs.resourcesManager->getDevice(Acc::GPU);
     Device *deviceCPU = inputArgs.resourcesManager->getDevice(Acc::CPU);
@@ -232,7 +275,7 @@ std::pair<nlohmann::json, nlohmann::json> JSONFile::buildDataMap(const Applicati
         }
         commonData["Pref. GPU"] = std::to_string((inputArgs.executionDevicePriority[0] == Acc::GPU) ? 1 : 0);
     } else {
-        for (int i = 0; i < NUM_STAGES; ++i) {
+        for (size_t i = 0; i < inputArgs.numStages(); ++i) {
             if (deviceGPU != nullptr) {
                 commonData["Size QGPU S" + std::to_string(i + 1)] = std::to_string(deviceGPU->getStage(i)->getMaxQueueSize());
                 commonData["Num. Cores GPU S" + std::to_string(i + 1)] = std::to_string(deviceGPU->getStage(i)->getTotalCores());
@@ -267,6 +310,57 @@ std::pair<nlohmann::json, nlohmann::json> JSONFile::buildDataMap(const Applicati
     variableData["Num. Frames"] = inputArgs.numFrames;
     variableData["Throughput (FPS)"] = appData.throughput;
     variableData["Tot. Time (ms)"] = appData.totalTime;
+    variableData["Peak USM (MB)"] = appData.usmUsage.getPeak() / (1024.0 * 1024.0);
+    if (inputArgs.memBudget > 0) {
+        variableData["Mem. Budget (MB)"] = inputArgs.memBudget / (1024.0 * 1024.0);
+        variableData["Max. Tokens"] = inputArgs.maxTokens;
+    }
+    if (!inputArgs.inputPath.empty()) {
+        variableData["Input Frames Read"] = appData.ingestStats.framesRead;
+        variableData["Ingest Latency Avg (ms)"] = appData.ingestStats.readTimeAvg;
+        variableData["Ingest Latency Max (ms)"] = appData.ingestStats.readTimeMax;
+        variableData["Ingest Bandwidth (MB/s)"] = appData.ingestStats.bandwidth;
+        variableData["Input Stalls"] = appData.ingestStats.stalls;
+        variableData["Input Stall Time (ms)"] = appData.ingestStats.stallTime;
+    }
+    if (inputArgs.cameraFps > 0.0) {
+        addCameraData(commonData, variableData, appData.cameraStats);
+    }
+    if (!inputArgs.sinkPath.empty()) {
+        commonData["Sink"] = inputArgs.sinkPath;
+        commonData["Sink Depth"] = appData.sinkStats.depth;
+        commonData["Sink Drop"] = inputArgs.sinkDrop;
+        variableData["Sink Frames Written"] = appData.sinkStats.framesWritten;
+        variableData["Sink Frames Dropped"] = appData.sinkStats.framesDropped;
+        variableData["Sink Blocked Frames"] = appData.sinkStats.blockedFrames;
+        variableData["Sink Blocked Time (ms)"] = appData.sinkStats.blockedTime;
+        variableData["Sink Peak Queued"] = appData.sinkStats.peakQueued;
+        variableData["Sink Write Time Avg (ms)"] = appData.sinkStats.writeTimeAvg;
+    }
+    if (inputArgs.reorder) {
+        commonData["Reorder Window"] = appData.reorderStats.window;
+        commonData["Reorder Gap"] = inputArgs.reorderGap == ReorderGap::Skip ? "skip" : "wait";
+        variableData["Reorder Held Frames"] = appData.reorderStats.heldFrames;
+        variableData["Reorder Depth Avg"] = appData.reorderStats.meanDepth;
+        variableData["Reorder Depth Peak"] = appData.reorderStats.peakDepth;
+        variableData["Reorder Blocked Time (ms)"] = appData.reorderStats.blockedTime;
+        variableData["Reorder Blocked Time Max (ms)"] = appData.reorderStats.blockedTimeMax;
+        variableData["Reorder Skipped Frames"] = appData.reorderStats.skipped;
+        variableData["Reorder Late Frames"] = appData.reorderStats.lateFrames;
+    }
+    if (inputArgs.reuseThreshold >= 0.0) {
+        commonData["Reuse Threshold"] = inputArgs.reuseThreshold;
+        commonData["Reuse Refresh"] = appData.reuseStats.refresh;
+        variableData["Reuse Keyframes"] = appData.reuseStats.keyframes;
+        variableData["Reuse Frames"] = appData.reuseStats.reusedFrames;
+        variableData["Reuse Ratio"] = appData.reuseStats.reuseRatio;
+        variableData["Reuse Diff Time Avg (ms)"] = appData.reuseStats.diffTimeAvg;
+        if (inputArgs.reuseVerify) {
+            variableData["Reuse Verified Frames"] = appData.reuseStats.verifiedFrames;
+            variableData["Reuse Mismatched Frames"] = appData.reuseStats.mismatchedFrames;
+            variableData["Reuse Max Error"] = appData.reuseStats.maxError;
+        }
+    }
 
     if constexpr (ADVANCEDMETRICS_ENABLED) {
         for (auto i = 0u; i < appData.numFiltersGPU.size(); ++i) {
@@ -277,8 +371,11 @@ std::pair<nlohmann::json, nlohmann::json> JSONFile::buildDataMap(const Applicati
         }
     } else {
         // Filters processed by CPU and GPU
-        int numFiltersGPU = appData.numFiltersGPU[0].load() + appData.numFiltersGPU[1].load() + appData.numFiltersGPU[2].load();
-        int numFiltersCPU = appData.numFiltersCPU[0].load() + appData.numFiltersCPU[1].load() + appData.numFiltersCPU[2].load();
+        int numFiltersGPU = 0, numFiltersCPU = 0;
+        for (size_t i = 0; i < appData.numStages(); ++i) {
+            numFiltersGPU += appData.numFiltersGPU[i].load();
+            numFiltersCPU += appData.numFiltersCPU[i].load();
+        }
         if (numFiltersCPU > 0) {
             variableData["Num. Filters CPU"] = numFiltersCPU;
         }
@@ -318,6 +415,11 @@ std::pair<nlohmann::json, nlohmann::json> JSONFile::buildDataMap(const Applicati
         variableData["Th. System Expected (FPS)"] = appData.throughputSystemExpected;
     }
 
+    if constexpr (ALLOCCOUNT_ENABLED) {
+        variableData["Allocs per Frame"] = AllocCounter::allocationsPerFrame();
+        variableData["Alloc. Bytes per Frame"] = AllocCounter::bytesPerFrame();
+    }
+
     if constexpr (ENERGYPCM_ENABLED) {
         variableData["CPU Energy (J)"] = appData.energyCPU;
         variableData["GPU Energy (J)"] = appData.energyGPU;
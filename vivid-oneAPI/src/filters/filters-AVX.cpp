@@ -1,11 +1,23 @@
 #include "filters-AVX.hpp"
+#include <type_traits>
+
+// Broadcast a pixel to the 8 lanes, converting it to float if it is an integer
+template <typename Pixel>
+static inline __m256 broadcast_pixel(const Pixel *pixel) {
+	if constexpr (std::is_same_v<Pixel, float>) {
+		return _mm256_broadcast_ss(pixel);
+	} else {
+		return _mm256_set1_ps(static_cast<float>(*pixel));
+	}
+}
+
 // *********************************************************************************************************************
 // *  FILTER 1: AVX2 implementation of the cosine filter
 // *********************************************************************************************************************
-void cosine_filter_AVX(float* fr_data, float* ind, float *val, float* fb_array, const int height, const int width, const int filter_h, const int filter_w, const int n_filters, int pitch) {
+template <typename Pixel>
+void cosine_filter_AVX(const Pixel* fr_data, float* ind, float *val, float* fb_array, const int height, const int width, const int filter_h, const int filter_w, const int n_filters, int pitch, const Rect &region) {
 	//do convolution
 	const int apron_y = filter_h / 2;
-	const int apron_x = filter_w / 2;
 
 	const int filter_size = filter_h * filter_w;
 
@@ -25,27 +37,27 @@ void cosine_filter_AVX(float* fr_data, float* ind, float *val, float* fb_array,
 	float fmask = *((float*)&imask);
 	int n_threads =1;
 
-	int valid_height = height - 2 * apron_y;
+	int valid_height = region.height;
 	int height_step = valid_height / n_threads + 1;
 	
 	for (int tid=0; tid<n_threads; tid++){
-		int start_y = apron_y + tid * height_step;
-		int end_y = std::min(start_y + height_step, height - apron_y);
+		int start_y = region.y + tid * height_step;
+		int end_y = std::min(start_y + height_step, region.y + region.height);
 			for (int i=start_y; i<end_y; i++){
-				float* fr_ptr = fr_data + i * width + apron_x;
-				float* ass_out = ind + i * pitch/sizeof(float) + apron_x;   // modified to get output in two separated arrays
-				float* wgt_out = val + i * pitch/sizeof(float) + apron_x;
-
-				for (int j=apron_x; j<(width - apron_x); j++ ){
-					__m256 image_cache0 = _mm256_broadcast_ss(&fr_ptr[pixel_offsets[0]]);
-					__m256 image_cache1 = _mm256_broadcast_ss(&fr_ptr[pixel_offsets[1]]);
-					__m256 image_cache2 = _mm256_broadcast_ss(&fr_ptr[pixel_offsets[2]]);
-					__m256 image_cache3 = _mm256_broadcast_ss(&fr_ptr[pixel_offsets[3]]);
-					__m256 image_cache4 = _mm256_broadcast_ss(&fr_ptr[pixel_offsets[4]]);
-					__m256 image_cache5 = _mm256_broadcast_ss(&fr_ptr[pixel_offsets[5]]);
-					__m256 image_cache6 = _mm256_broadcast_ss(&fr_ptr[pixel_offsets[6]]);
-					__m256 image_cache7 = _mm256_broadcast_ss(&fr_ptr[pixel_offsets[7]]);
-					__m256 image_cache8 = _mm256_broadcast_ss(&fr_ptr[pixel_offsets[8]]);
+				const Pixel* fr_ptr = fr_data + i * width + region.x;
+				float* ass_out = ind + i * pitch/sizeof(float) + region.x;   // modified to get output in two separated arrays
+				float* wgt_out = val + i * pitch/sizeof(float) + region.x;
+
+				for (int j=region.x; j<(region.x + region.width); j++ ){
+					__m256 image_cache0 = broadcast_pixel(&fr_ptr[pixel_offsets[0]]);
+					__m256 image_cache1 = broadcast_pixel(&fr_ptr[pixel_offsets[1]]);
+					__m256 image_cache2 = broadcast_pixel(&fr_ptr[pixel_offsets[2]]);
+					__m256 image_cache3 = broadcast_pixel(&fr_ptr[pixel_offsets[3]]);
+					__m256 image_cache4 = broadcast_pixel(&fr_ptr[pixel_offsets[4]]);
+					__m256 image_cache5 = broadcast_pixel(&fr_ptr[pixel_offsets[5]]);
+					__m256 image_cache6 = broadcast_pixel(&fr_ptr[pixel_offsets[6]]);
+					__m256 image_cache7 = broadcast_pixel(&fr_ptr[pixel_offsets[7]]);
+					__m256 image_cache8 = broadcast_pixel(&fr_ptr[pixel_offsets[8]]);
 
 					float max_sim[8] = {-1e6, 
 						-1e6, -1e6, -1e6, -1e6, -1e6, -1e6, -1e6};
@@ -274,11 +286,14 @@ void cosine_filter_AVX(float* fr_data, float* ind, float *val, float* fb_array,
 	free(pixel_offsets);
 }
 
+template void cosine_filter_AVX(const float* fr_data, float* ind, float *val, float* fb_array, const int height, const int width, const int filter_h, const int filter_w, const int n_filters, int pitch, const Rect &region);
+template void cosine_filter_AVX(const uint8_t* fr_data, float* ind, float *val, float* fb_array, const int height, const int width, const int filter_h, const int filter_w, const int n_filters, int pitch, const Rect &region);
+template void cosine_filter_AVX(const uint16_t* fr_data, float* ind, float *val, float* fb_array, const int height, const int width, const int filter_h, const int filter_w, const int n_filters, int pitch, const Rect &region);
+
 // *********************************************************************************************************************
 // *  FILTER2: AVX2 implementation of histogram computation 
 // *********************************************************************************************************************
-void block_histogram_AVX(float *ptr_his, float *id_data, float *wt_data, int max_bin, int cell_size, int im_height, int im_width, float pitch_his, float pitch_ind) {
-    int n_parts_y = (im_height-2) / cell_size;
+void block_histogram_AVX(float *ptr_his, float *id_data, float *wt_data, int max_bin, int cell_size, int im_height, int im_width, float pitch_his, float pitch_ind, const Rect &cells) {
     int n_parts_x = (im_width-2) / cell_size;
     int start_i = 1;
     int start_j = 1;
@@ -290,8 +305,8 @@ void block_histogram_AVX(float *ptr_his, float *id_data, float *wt_data, int max
     __m256 pitch_his_vec = _mm256_set1_ps(pitch_his);
     __m256 pitch_ind_vec = _mm256_set1_ps(pitch_ind);
 
-    for (int write_i=0; write_i<n_parts_y; write_i++) {
-        for (int write_j=0; write_j<n_parts_x; write_j++) {
+    for (int write_i=cells.y; write_i<cells.y + cells.height; write_i++) {
+        for (int write_j=cells.x; write_j<cells.x + cells.width; write_j++) {
             int out_ind = (write_i*n_parts_x + write_j) * pitch_his;
             int read_i = (start_i + (write_i * cell_size)) * pitch_ind;
 
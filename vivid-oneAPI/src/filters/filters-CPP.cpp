@@ -27,12 +27,12 @@ float * transposeBank(float* filter_bank) {
     return tmpbank;
 }
 //-----------------------------------------------------------------
-void cosine_filter_transpose(float* fr_data, float* ind, float *val, float* fb_array_main, const int height, const int width, const int filter_h, const int filter_w, const int n_filters, int pitch)
+template <typename Pixel>
+void cosine_filter_transpose(const Pixel* fr_data, float* ind, float *val, float* fb_array_main, const int height, const int width, const int filter_h, const int filter_w, const int n_filters, int pitch, const Rect &region)
 {
     float * fb_array = transposeBank(fb_array_main);
     //do convolution
     const int apron_y = filter_h / 2;
-    const int apron_x = filter_w / 2;
 
     const int filter_size = filter_h * filter_w;
 
@@ -48,26 +48,26 @@ void cosine_filter_transpose(float* fr_data, float* ind, float *val, float* fb_a
     // 100 filters, each 9 values
     int n_threads = 1;
 
-    int valid_height = height - 2 * apron_y;
+    int valid_height = region.height;
     int height_step = valid_height / n_threads + 1;
 
     for (int tid=0; tid<n_threads; tid++) {
-        int start_y = apron_y + tid * height_step;
-        int end_y = min(start_y + height_step, height - apron_y);
+        int start_y = region.y + tid * height_step;
+        int end_y = min(start_y + height_step, region.y + region.height);
     
 		//-------------------------------run CG
 		float *image_cache = (float*) std::aligned_alloc(32, sizeof(float) * filter_size);
 
 		for (int i=start_y; i<end_y; i++) {
-            float* fr_ptr = fr_data + i * width + apron_x;
-			float* ass_out = ind + i * pitch/sizeof(float) + apron_x;   // modified to get output in two separated arrays
-			float* wgt_out = val + i * pitch/sizeof(float) + apron_x;
+            const Pixel* fr_ptr = fr_data + i * width + region.x;
+			float* ass_out = ind + i * pitch/sizeof(float) + region.x;   // modified to get output in two separated arrays
+			float* wgt_out = val + i * pitch/sizeof(float) + region.x;
 
 
-			for (int j=apron_x; j<(width - apron_x); j++ ) {
+			for (int j=region.x; j<(region.x + region.width); j++ ) {
 				for (int ii=0; ii< filter_size; ii++) {
 					// copy each pixel to all elements of vector
-					image_cache[ii] = fr_ptr[pixel_offsets[ii]];
+					image_cache[ii] = static_cast<float>(fr_ptr[pixel_offsets[ii]]);
 				}
 
 				float max_sim = -1e6;
@@ -127,19 +127,22 @@ void cosine_filter_transpose(float* fr_data, float* ind, float *val, float* fb_a
     free(pixel_offsets); //added by andres, I think it is necessary
 }
 
+template void cosine_filter_transpose(const float* fr_data, float* ind, float *val, float* fb_array_main, const int height, const int width, const int filter_h, const int filter_w, const int n_filters, int pitch, const Rect &region);
+template void cosine_filter_transpose(const uint8_t* fr_data, float* ind, float *val, float* fb_array_main, const int height, const int width, const int filter_h, const int filter_w, const int n_filters, int pitch, const Rect &region);
+template void cosine_filter_transpose(const uint16_t* fr_data, float* ind, float *val, float* fb_array_main, const int height, const int width, const int filter_h, const int filter_w, const int n_filters, int pitch, const Rect &region);
+
 /**************************************
  * Filter 2 cpu
  * *************************/
-void block_histogram(float *ptr_his, float *ptr_ind, float *ptr_val, int max_bin, int cell_size, int im_height, int im_width, float pitch_his, float pitch_ind) {
+void block_histogram(float *ptr_his, float *ptr_ind, float *ptr_val, int max_bin, int cell_size, int im_height, int im_width, float pitch_his, float pitch_ind, const Rect &cells) {
     //variables
-    int n_parts_y = (im_height-2) / cell_size;
     int n_parts_x = (im_width-2) / cell_size;
     int start_i = 1;
     int start_j = 1;
     //end variables
 
-    for (int write_i=0; write_i<n_parts_y; write_i++) {
-        for (int write_j=0; write_j<n_parts_x; write_j++) {
+    for (int write_i=cells.y; write_i<cells.y + cells.height; write_i++) {
+        for (int write_j=cells.x; write_j<cells.x + cells.width; write_j++) {
             int out_ind = (write_i*n_parts_x + write_j) * pitch_his;
             int read_i = (start_i + (write_i * cell_size)) * pitch_ind;
             for (int i=0; i<cell_size; i++) {
@@ -1,8 +1,8 @@
 #include "filters-SIMD.hpp"
 
-void cosine_filter_SIMD(float *fr_data, float *ind, float *val, float *fb_array, const int height, const int width, const int filter_h, const int filter_w, const int n_filters, int pitch) {
+template <typename Pixel>
+void cosine_filter_SIMD(const Pixel *fr_data, float *ind, float *val, float *fb_array, const int height, const int width, const int filter_h, const int filter_w, const int n_filters, int pitch, const Rect &region) {
     const int apron_y = filter_h / 2;
-    const int apron_x = filter_w / 2;
     const int filter_size = filter_h * filter_w;
     const int filter_bank_size = filter_size * n_filters;
 
@@ -18,7 +18,7 @@ void cosine_filter_SIMD(float *fr_data, float *ind, float *val, float *fb_array,
     }
 
     const int n_threads = 1;
-    const int valid_height = height - 2 * apron_y;
+    const int valid_height = region.height;
     const int height_step = valid_height / n_threads + 1;
 
     std::array<simd_t, 9> image_cache;
@@ -27,14 +27,14 @@ void cosine_filter_SIMD(float *fr_data, float *ind, float *val, float *fb_array,
     simd_t best_ind = -1;
 
     for (int tid = 0; tid < n_threads; tid++) {
-        const int start_y = apron_y + tid * height_step;
-        const int end_y = std::min(start_y + height_step, height - apron_y);
+        const int start_y = region.y + tid * height_step;
+        const int end_y = std::min(start_y + height_step, region.y + region.height);
         for (int i = start_y; i < end_y; i++) {
-            float *fr_ptr = fr_data + i * width + apron_x;
-            float *ass_out = ind + i * pitch / sizeof(float) + apron_x;
-            float *wgt_out = val + i * pitch / sizeof(float) + apron_x;
+            const Pixel *fr_ptr = fr_data + i * width + region.x;
+            float *ass_out = ind + i * pitch / sizeof(float) + region.x;
+            float *wgt_out = val + i * pitch / sizeof(float) + region.x;
 
-            for (int j = apron_x; j < (width - apron_x); ++j) {
+            for (int j = region.x; j < (region.x + region.width); ++j) {
                 for (int c = 0; c < 9; ++c) {
                     image_cache[c] = simd_t(&fr_ptr[pixel_offsets[c]], stdx::element_aligned);
                 }
@@ -73,11 +73,14 @@ void cosine_filter_SIMD(float *fr_data, float *ind, float *val, float *fb_array,
     }
 }
 
+template void cosine_filter_SIMD(const float *fr_data, float *ind, float *val, float *fb_array, const int height, const int width, const int filter_h, const int filter_w, const int n_filters, int pitch, const Rect &region);
+template void cosine_filter_SIMD(const uint8_t *fr_data, float *ind, float *val, float *fb_array, const int height, const int width, const int filter_h, const int filter_w, const int n_filters, int pitch, const Rect &region);
+template void cosine_filter_SIMD(const uint16_t *fr_data, float *ind, float *val, float *fb_array, const int height, const int width, const int filter_h, const int filter_w, const int n_filters, int pitch, const Rect &region);
+
 // *********************************************************************************************************************
 // *  FILTER2: std::experimental::simd implementation of histogram computation
 // *********************************************************************************************************************
-void block_histogram_SIMD(float *ptr_his, float *id_data, float *wt_data, int max_bin, int cell_size, int im_height, int im_width, float pitch_his, float pitch_ind) {
-    int n_parts_y = (im_height - 2) / cell_size;
+void block_histogram_SIMD(float *ptr_his, float *id_data, float *wt_data, int max_bin, int cell_size, int im_height, int im_width, float pitch_his, float pitch_ind, const Rect &cells) {
     int n_parts_x = (im_width - 2) / cell_size;
     int start_i = 1;
     int start_j = 1;
@@ -86,8 +89,8 @@ void block_histogram_SIMD(float *ptr_his, float *id_data, float *wt_data, int ma
     simd_i bins;
     simd_f weights;
 
-    for (int write_i = 0; write_i < n_parts_y; write_i++) {
-        for (int write_j = 0; write_j < n_parts_x; write_j++) {
+    for (int write_i = cells.y; write_i < cells.y + cells.height; write_i++) {
+        for (int write_j = cells.x; write_j < cells.x + cells.width; write_j++) {
             int out_ind = (write_i * n_parts_x + write_j) * pitch_his;
             int read_i = (start_i + (write_i * cell_size)) * pitch_ind;
 
@@ -1,4 +1,8 @@
 #include "filters-SYCL.hpp"
+#include <algorithm>
+#include <array>
+#include <stdexcept>
+#include <string>
 
 using namespace std;
 
@@ -6,13 +10,19 @@ using namespace std;
  * FILTER 1: GPU
  * ************************************/
 // Combinar los dos kernels, para tener alto rendimiento en ambos dispositivos
-sycl::event cosine_filter_transpose_sycl(float *frame, float *ind, float *val, float *fb_array_main, const int height, const int width, const int filter_size, const int n_filters, const int f_pitch_f, sycl::queue &Q, const std::vector<sycl::event> *vector_events) {
+template <typename Pixel>
+sycl::event cosine_filter_transpose_sycl(const Pixel *frame, float *ind, float *val, float *fb_array_main, const int height, const int width, const int filter_size, const int n_filters, const int f_pitch_f, const Rect &region, sycl::queue &Q, const std::vector<sycl::event> *vector_events) {
     // Obtener el dispositivo asociado con la cola
     auto device = Q.get_device();
     // Obtener el tamaño máximo de grupo de trabajo soportado por el dispositivo
     auto max_work_group_size = device.get_info<sycl::info::device::max_work_group_size>();
     // Ajustar el local_size basado en el tamaño máximo de grupo de trabajo
     const int local_size = std::min(static_cast<int>(std::sqrt(max_work_group_size)), 16);
+    // Un work-item por pixel de la región: (posy, posx) es la esquina del vecindario 3x3 del pixel (posy + 1, posx + 1)
+    const int start_y = region.y - 1;
+    const int start_x = region.x - 1;
+    const int end_y = start_y + region.height;
+    const int end_x = start_x + region.width;
 
     auto t_event = Q.submit([&](sycl::handler &h) {
         if (vector_events != nullptr && !vector_events->empty()) {
@@ -21,32 +31,32 @@ sycl::event cosine_filter_transpose_sycl(float *frame, float *ind, float *val, f
         }
 
         sycl::range<2> local_range(local_size, local_size);
-        sycl::range<2> global_range((height - 2 + local_size - 1) / local_size * local_size, (width - 2 + local_size - 1) / local_size * local_size);
+        sycl::range<2> global_range((region.height + local_size - 1) / local_size * local_size, (region.width + local_size - 1) / local_size * local_size);
 
         if (device.is_gpu()) {
             // Usar local_accessor para GPU
             sycl::local_accessor<float, 1> local_frame(sycl::range<1>(local_size * local_size), h);
 
             h.parallel_for<>(sycl::nd_range<2>(global_range, local_range), [=](sycl::nd_item<2> item) {
-                int local_id_x = item.get_local_id(0);
-                int local_id_y = item.get_local_id(1);
-                int group_id_x = item.get_group(0);
-                int group_id_y = item.get_group(1);
+                int local_id_y = item.get_local_id(0);
+                int local_id_x = item.get_local_id(1);
+                int group_id_y = item.get_group(0);
+                int group_id_x = item.get_group(1);
                 int local_idx = local_id_y * local_size + local_id_x;
 
-                int posy = group_id_y * local_size + local_id_y;
-                int posx = group_id_x * local_size + local_id_x;
+                int posy = start_y + group_id_y * local_size + local_id_y;
+                int posx = start_x + group_id_x * local_size + local_id_x;
 
                 // Cargar datos en memoria local
                 if (posy < height && posx < width) {
-                    local_frame[local_idx] = frame[posy * f_pitch_f + posx];
+                    local_frame[local_idx] = static_cast<float>(frame[posy * f_pitch_f + posx]);
                 } else {
                     local_frame[local_idx] = 0.0f;
                 }
 
                 item.barrier(sycl::access::fence_space::local_space);
 
-                if (posy >= height - 2 || posx >= width - 2)
+                if (posy >= end_y || posx >= end_x)
                     return;
 
                 float img[9];
@@ -92,21 +102,21 @@ sycl::event cosine_filter_transpose_sycl(float *frame, float *ind, float *val, f
         } else {
             // Usar el kernel original optimizado para CPU
             h.parallel_for<>(sycl::nd_range<2>(global_range, local_range), [=](sycl::nd_item<2> item) {
-                int posy = item.get_global_id(0);
-                int posx = item.get_global_id(1);
+                int posy = start_y + item.get_global_id(0);
+                int posx = start_x + item.get_global_id(1);
 
-                if (posy >= height - 2 || posx >= width - 2)
+                if (posy >= end_y || posx >= end_x)
                     return;
 
-                float img0 = frame[posy * f_pitch_f + posx];
-                float img1 = frame[posy * f_pitch_f + posx + 1];
-                float img2 = frame[posy * f_pitch_f + posx + 2];
-                float img3 = frame[(posy + 1) * f_pitch_f + posx];
-                float img4 = frame[(posy + 1) * f_pitch_f + posx + 1];
-                float img5 = frame[(posy + 1) * f_pitch_f + posx + 2];
-                float img6 = frame[(posy + 2) * f_pitch_f + posx];
-                float img7 = frame[(posy + 2) * f_pitch_f + posx + 1];
-                float img8 = frame[(posy + 2) * f_pitch_f + posx + 2];
+                float img0 = static_cast<float>(frame[posy * f_pitch_f + posx]);
+                float img1 = static_cast<float>(frame[posy * f_pitch_f + posx + 1]);
+                float img2 = static_cast<float>(frame[posy * f_pitch_f + posx + 2]);
+                float img3 = static_cast<float>(frame[(posy + 1) * f_pitch_f + posx]);
+                float img4 = static_cast<float>(frame[(posy + 1) * f_pitch_f + posx + 1]);
+                float img5 = static_cast<float>(frame[(posy + 1) * f_pitch_f + posx + 2]);
+                float img6 = static_cast<float>(frame[(posy + 2) * f_pitch_f + posx]);
+                float img7 = static_cast<float>(frame[(posy + 2) * f_pitch_f + posx + 1]);
+                float img8 = static_cast<float>(frame[(posy + 2) * f_pitch_f + posx + 2]);
 
                 float curval = -1e6;
                 float curid = -1;
@@ -149,6 +159,10 @@ sycl::event cosine_filter_transpose_sycl(float *frame, float *ind, float *val, f
     return t_event;
 }
 
+template sycl::event cosine_filter_transpose_sycl(const float *frame, float *ind, float *val, float *fb_array_main, const int height, const int width, const int filter_size, const int n_filters, const int f_pitch_f, const Rect &region, sycl::queue &Q, const std::vector<sycl::event> *vector_events);
+template sycl::event cosine_filter_transpose_sycl(const uint8_t *frame, float *ind, float *val, float *fb_array_main, const int height, const int width, const int filter_size, const int n_filters, const int f_pitch_f, const Rect &region, sycl::queue &Q, const std::vector<sycl::event> *vector_events);
+template sycl::event cosine_filter_transpose_sycl(const uint16_t *frame, float *ind, float *val, float *fb_array_main, const int height, const int width, const int filter_size, const int n_filters, const int f_pitch_f, const Rect &region, sycl::queue &Q, const std::vector<sycl::event> *vector_events);
+
 // Optimizado para funcionar bien tanto en GPU como en CPU
 // sycl::event cosine_filter_transpose_sycl(float *frame, float *ind, float *val, float *fb_array_main, const int height, const int width, const int filter_size, const int n_filters, const int f_pitch_f, sycl::queue &Q, const std::vector<sycl::event> *vector_events) {
 //     // Obtener el dispositivo asociado con la cola
@@ -317,21 +331,22 @@ sycl::event cosine_filter_transpose_sycl(float *frame, float *ind, float *val, f
 // *********************************************************************************************************************
 // FILTER 2:
 // *********************************************************************************************************************
-sycl::event block_histogram_sycl(float *ptr_his, float *ptr_ind, float *ptr_val, int cell_size, int im_height, int im_width, float pitch_his, float pitch_ind, float pitch_val, sycl::queue &Q, const std::vector<sycl::event> *vector_events) {
+sycl::event block_histogram_sycl(float *ptr_his, float *ptr_ind, float *ptr_val, int cell_size, int im_height, int im_width, float pitch_his, float pitch_ind, float pitch_val, const Rect &cells, sycl::queue &Q, const std::vector<sycl::event> *vector_events) {
     const int histogram_pitch_f = pitch_his;
     const int assignments_pitch_f = pitch_ind;
     const int weights_pitch_f = pitch_val;
 
-    const int n_parts_y = (im_height - 2) / cell_size;
     const int n_parts_x = 74;
+    const int first_y = cells.y;
+    const int first_x = cells.x;
 
     auto t_event = Q.submit([&](sycl::handler &h) {
         if (vector_events != nullptr && !vector_events->empty()) {
             h.depends_on(*vector_events);
         }
-        h.parallel_for<>(sycl::range<2>(n_parts_y, n_parts_x), [=](sycl::id<2> idx) {
-            int block_y = idx[0];
-            int block_x = idx[1];
+        h.parallel_for<>(sycl::range<2>(cells.height, cells.width), [=](sycl::id<2> idx) {
+            int block_y = first_y + idx[0];
+            int block_x = first_x + idx[1];
 
             const int pix_y = block_y * cell_size + 1;
             const int pix_x = block_x * cell_size + 1;
@@ -433,7 +448,7 @@ sycl::event pwdist_sycl_tiled_float4(float *ptra, float *ptrb, float *out_data,
                 item.barrier(sycl::access::fence_space::local_space);
             }
 
-            if (i < aheight && j < owidth) {
+            if (i < aheight && j < bheight) {
                 out_data[i * owidth + j] = sycl::dot(sum, sycl::float4(1.0));
             }
         });
@@ -498,7 +513,7 @@ sycl::event pwdist_sycl_tiled(float *ptra, float *ptrb, float *out_data, int owi
                 item.barrier(sycl::access::fence_space::local_space);
             }
 
-            if (i < aheight && j < owidth) {
+            if (i < aheight && j < bheight) {
                 out_data[i * owidth + j] = sum;
             }
         });
@@ -512,3 +527,412 @@ sycl::event pwdist_sycl_tiled(float *ptra, float *ptrb, float *out_data, int owi
 
 template sycl::event pwdist_sycl_tiled<16>(float *ptra, float *ptrb, float *out_data, int owidth, int aheight, int awidth, int bheight, int adatawidth, sycl::queue &Q, const std::vector<sycl::event> *vector_events);
 template sycl::event pwdist_sycl_tiled<64>(float *ptra, float *ptrb, float *out_data, int owidth, int aheight, int awidth, int bheight, int adatawidth, sycl::queue &Q, const std::vector<sycl::event> *vector_events);
+
+// *********************************************************************************************************************
+// BATCHES: several frames per launch (--gpu-batch)
+// *********************************************************************************************************************
+// The kernel captures the frames of the batch by value, so the launch needs no buffer of its own
+template <typename Frame>
+static std::array<Frame, MAX_GPU_BATCH> batch_frames(const Frame *frames, int count) {
+    if (count < 1 || count > MAX_GPU_BATCH) {
+        throw std::invalid_argument("A batch has between 1 and " + std::to_string(MAX_GPU_BATCH) + " frames (got " + std::to_string(count) + ")");
+    }
+    std::array<Frame, MAX_GPU_BATCH> batch{};
+    std::copy(frames, frames + count, batch.begin());
+    return batch;
+}
+
+template <typename Pixel>
+sycl::event cosine_filter_transpose_sycl_batch(const CosineBatchFrame<Pixel> *frames, int count, float *fb_array_main, const int height, const int width, const int filter_size, const int n_filters, sycl::queue &Q, const std::vector<sycl::event> *vector_events) {
+    const auto batch = batch_frames(frames, count);
+    auto device = Q.get_device();
+    auto max_work_group_size = device.get_info<sycl::info::device::max_work_group_size>();
+    const int local_size = std::min(static_cast<int>(std::sqrt(max_work_group_size)), 16);
+    // El rango cubre la región más grande del lote; cada frame descarta los work-items que quedan fuera de la suya
+    int max_height = 0;
+    int max_width = 0;
+    for (int i = 0; i < count; i++) {
+        max_height = std::max(max_height, frames[i].region.height);
+        max_width = std::max(max_width, frames[i].region.width);
+    }
+
+    auto t_event = Q.submit([&](sycl::handler &h) {
+        if (vector_events != nullptr && !vector_events->empty()) {
+            h.depends_on(*vector_events);
+        }
+
+        sycl::range<3> local_range(1, local_size, local_size);
+        sycl::range<3> global_range(count, (max_height + local_size - 1) / local_size * local_size, (max_width + local_size - 1) / local_size * local_size);
+
+        if (device.is_gpu()) {
+            // Usar local_accessor para GPU (un grupo de trabajo nunca mezcla frames)
+            sycl::local_accessor<float, 1> local_frame(sycl::range<1>(local_size * local_size), h);
+
+            h.parallel_for<>(sycl::nd_range<3>(global_range, local_range), [=](sycl::nd_item<3> item) {
+                const CosineBatchFrame<Pixel> &f = batch[item.get_group(0)];
+                const int start_y = f.region.y - 1;
+                const int start_x = f.region.x - 1;
+                const int end_y = start_y + f.region.height;
+                const int end_x = start_x + f.region.width;
+
+                int local_id_y = item.get_local_id(1);
+                int local_id_x = item.get_local_id(2);
+                int group_id_y = item.get_group(1);
+                int group_id_x = item.get_group(2);
+                int local_idx = local_id_y * local_size + local_id_x;
+
+                int posy = start_y + group_id_y * local_size + local_id_y;
+                int posx = start_x + group_id_x * local_size + local_id_x;
+
+                // Cargar datos en memoria local
+                if (posy < height && posx < width) {
+                    local_frame[local_idx] = static_cast<float>(f.frame[posy * f.f_pitch_f + posx]);
+                } else {
+                    local_frame[local_idx] = 0.0f;
+                }
+
+                item.barrier(sycl::access::fence_space::local_space);
+
+                if (posy >= end_y || posx >= end_x)
+                    return;
+
+                float img[9];
+                img[0] = local_frame[local_id_y * local_size + local_id_x];
+                img[1] = local_frame[local_id_y * local_size + local_id_x + 1];
+                img[2] = local_frame[local_id_y * local_size + local_id_x + 2];
+                img[3] = local_frame[(local_id_y + 1) * local_size + local_id_x];
+                img[4] = local_frame[(local_id_y + 1) * local_size + local_id_x + 1];
+                img[5] = local_frame[(local_id_y + 1) * local_size + local_id_x + 2];
+                img[6] = local_frame[(local_id_y + 2) * local_size + local_id_x];
+                img[7] = local_frame[(local_id_y + 2) * local_size + local_id_x + 1];
+                img[8] = local_frame[(local_id_y + 2) * local_size + local_id_x + 2];
+
+                float curval = -1e6;
+                float curid = -1;
+
+                for (int filter_id = 0; filter_id < n_filters; filter_id++) {
+                    float tmpval = 0.0f;
+                    int fi = filter_id * filter_size;
+
+                    tmpval += fb_array_main[fi] * img[0];
+                    tmpval += fb_array_main[fi + 1] * img[1];
+                    tmpval += fb_array_main[fi + 2] * img[2];
+                    tmpval += fb_array_main[fi + 3] * img[3];
+                    tmpval += fb_array_main[fi + 4] * img[4];
+                    tmpval += fb_array_main[fi + 5] * img[5];
+                    tmpval += fb_array_main[fi + 6] * img[6];
+                    tmpval += fb_array_main[fi + 7] * img[7];
+                    tmpval += fb_array_main[fi + 8] * img[8];
+
+                    tmpval = sycl::fabs(tmpval);
+
+                    if (tmpval > curval) {
+                        curid = filter_id;
+                        curval = tmpval;
+                    }
+                }
+
+                const int o_pos = (posy + 1) * f.f_pitch_f + posx + 1;
+                f.ind[o_pos] = curid;
+                f.val[o_pos] = curval;
+            });
+        } else {
+            // Usar el kernel original optimizado para CPU
+            h.parallel_for<>(sycl::nd_range<3>(global_range, local_range), [=](sycl::nd_item<3> item) {
+                const CosineBatchFrame<Pixel> &f = batch[item.get_global_id(0)];
+                const int start_y = f.region.y - 1;
+                const int start_x = f.region.x - 1;
+                int posy = start_y + item.get_global_id(1);
+                int posx = start_x + item.get_global_id(2);
+
+                if (posy >= start_y + f.region.height || posx >= start_x + f.region.width)
+                    return;
+
+                const Pixel *frame = f.frame;
+                const int f_pitch_f = f.f_pitch_f;
+                float img0 = static_cast<float>(frame[posy * f_pitch_f + posx]);
+                float img1 = static_cast<float>(frame[posy * f_pitch_f + posx + 1]);
+                float img2 = static_cast<float>(frame[posy * f_pitch_f + posx + 2]);
+                float img3 = static_cast<float>(frame[(posy + 1) * f_pitch_f + posx]);
+                float img4 = static_cast<float>(frame[(posy + 1) * f_pitch_f + posx + 1]);
+                float img5 = static_cast<float>(frame[(posy + 1) * f_pitch_f + posx + 2]);
+                float img6 = static_cast<float>(frame[(posy + 2) * f_pitch_f + posx]);
+                float img7 = static_cast<float>(frame[(posy + 2) * f_pitch_f + posx + 1]);
+                float img8 = static_cast<float>(frame[(posy + 2) * f_pitch_f + posx + 2]);
+
+                float curval = -1e6;
+                float curid = -1;
+                int fi = 0;
+
+                for (int filter_id = 0; filter_id < n_filters; filter_id++) {
+                    float tmpval = 0.0f;
+
+                    tmpval += fb_array_main[fi++] * img0;
+                    tmpval += fb_array_main[fi++] * img1;
+                    tmpval += fb_array_main[fi++] * img2;
+
+                    tmpval += fb_array_main[fi++] * img3;
+                    tmpval += fb_array_main[fi++] * img4;
+                    tmpval += fb_array_main[fi++] * img5;
+
+                    tmpval += fb_array_main[fi++] * img6;
+                    tmpval += fb_array_main[fi++] * img7;
+                    tmpval += fb_array_main[fi++] * img8;
+
+                    tmpval = sycl::fabs(tmpval);
+
+                    if (tmpval > curval) {
+                        curid = filter_id;
+                        curval = tmpval;
+                    }
+                }
+
+                const int o_pos = (posy + 1) * f_pitch_f + posx + 1;
+                f.ind[o_pos] = curid;
+                f.val[o_pos] = curval;
+            });
+        }
+    });
+
+    if (vector_events == nullptr) {
+        t_event.wait();
+    }
+
+    return t_event;
+}
+
+template sycl::event cosine_filter_transpose_sycl_batch(const CosineBatchFrame<float> *frames, int count, float *fb_array_main, const int height, const int width, const int filter_size, const int n_filters, sycl::queue &Q, const std::vector<sycl::event> *vector_events);
+template sycl::event cosine_filter_transpose_sycl_batch(const CosineBatchFrame<uint8_t> *frames, int count, float *fb_array_main, const int height, const int width, const int filter_size, const int n_filters, sycl::queue &Q, const std::vector<sycl::event> *vector_events);
+template sycl::event cosine_filter_transpose_sycl_batch(const CosineBatchFrame<uint16_t> *frames, int count, float *fb_array_main, const int height, const int width, const int filter_size, const int n_filters, sycl::queue &Q, const std::vector<sycl::event> *vector_events);
+
+sycl::event block_histogram_sycl_batch(const HistogramBatchFrame *frames, int count, int cell_size, sycl::queue &Q, const std::vector<sycl::event> *vector_events) {
+    const auto batch = batch_frames(frames, count);
+    const int n_parts_x = 74;
+    int max_height = 0;
+    int max_width = 0;
+    for (int i = 0; i < count; i++) {
+        max_height = std::max(max_height, frames[i].cells.height);
+        max_width = std::max(max_width, frames[i].cells.width);
+    }
+
+    auto t_event = Q.submit([&](sycl::handler &h) {
+        if (vector_events != nullptr && !vector_events->empty()) {
+            h.depends_on(*vector_events);
+        }
+        h.parallel_for<>(sycl::range<3>(count, max_height, max_width), [=](sycl::id<3> idx) {
+            const HistogramBatchFrame &f = batch[idx[0]];
+            if (static_cast<int>(idx[1]) >= f.cells.height || static_cast<int>(idx[2]) >= f.cells.width)
+                return;
+
+            int block_y = f.cells.y + idx[1];
+            int block_x = f.cells.x + idx[2];
+
+            const int pix_y = block_y * cell_size + 1;
+            const int pix_x = block_x * cell_size + 1;
+
+            for (int i = 0; i < cell_size; i++) {
+                for (int j = 0; j < cell_size; j++) {
+                    const float aval = f.ptr_ind[(pix_y + j) * f.assignments_pitch_f + pix_x + i];
+                    const float wval = f.ptr_val[(pix_y + j) * f.weights_pitch_f + pix_x + i];
+                    const int block = block_y * n_parts_x + block_x;
+                    f.ptr_his[block * f.histogram_pitch_f + (int)aval] += wval;
+                }
+            }
+        });
+    });
+    if (vector_events == nullptr) {
+        t_event.wait();
+    }
+
+    return t_event;
+}
+
+// Rows of the classes and of the histograms covered by the range of a pwdist batch
+static void pwdist_batch_extent(const PwdistBatchFrame *frames, int count, int &max_aheight, int &max_bheight) {
+    max_aheight = 0;
+    max_bheight = 0;
+    for (int i = 0; i < count; i++) {
+        max_aheight = std::max(max_aheight, frames[i].aheight);
+        max_bheight = std::max(max_bheight, frames[i].bheight);
+    }
+}
+
+sycl::event pwdist_sycl_basic_batch(const PwdistBatchFrame *frames, int count, sycl::queue &Q, const std::vector<sycl::event> *vector_events) {
+    const auto batch = batch_frames(frames, count);
+    int max_aheight, max_bheight;
+    pwdist_batch_extent(frames, count, max_aheight, max_bheight);
+
+    auto t_event = Q.submit([&](sycl::handler &h) {
+        if (vector_events != nullptr && !vector_events->empty()) {
+            h.depends_on(*vector_events);
+        }
+        h.parallel_for<>(sycl::range<3>(count, max_aheight, max_bheight), [=](sycl::id<3> idx) {
+            const PwdistBatchFrame &f = batch[idx[0]];
+            int i = idx[1];
+            int j = idx[2];
+            if (i >= f.aheight || j >= f.bheight)
+                return;
+
+            float sum = 0.0;
+
+            int posa = i * f.awidth;
+            int posb = j * f.awidth;
+
+            for (size_t filter_id = 0; filter_id < f.adatawidth; filter_id++) {
+                float diff = f.ptra[posa + filter_id] - f.ptrb[posb + filter_id];
+                sum = sycl::mad(diff, diff, sum);
+            }
+
+            f.out_data[i * f.owidth + j] = sum;
+        });
+    });
+    if (vector_events == nullptr) {
+        t_event.wait();
+    }
+
+    return t_event;
+}
+
+template <size_t tile_size>
+sycl::event pwdist_sycl_tiled_float4_batch(const PwdistBatchFrame *frames, int count, sycl::queue &Q, const std::vector<sycl::event> *vector_events) {
+    const auto batch = batch_frames(frames, count);
+    int max_aheight, max_bheight;
+    pwdist_batch_extent(frames, count, max_aheight, max_bheight);
+    auto frame_range = SYCLUtils::generate2DRange(tile_size, max_aheight, max_bheight).get_global_range();
+    sycl::nd_range<3> nd_range{sycl::range<3>(count, frame_range[0], frame_range[1]), sycl::range<3>(1, tile_size, tile_size)};
+
+    auto t_event = Q.submit([&](sycl::handler &h) {
+        if (vector_events != nullptr && !vector_events->empty()) {
+            h.depends_on(*vector_events);
+        }
+        // Create local memory
+        sycl::local_accessor<sycl::float4> local_a(tile_size * tile_size / 4, h);
+        sycl::local_accessor<sycl::float4> local_b(tile_size * tile_size / 4, h);
+        h.parallel_for(nd_range, [=](sycl::nd_item<3> item) {
+            // A work-group never mixes frames, so the barriers are reached by all its work-items
+            const PwdistBatchFrame &f = batch[item.get_group(0)];
+            const float *ptra = f.ptra;
+            const float *ptrb = f.ptrb;
+            const int aheight = f.aheight;
+            const int awidth = f.awidth;
+            const int bheight = f.bheight;
+            const int owidth = f.owidth;
+            const int adatawidth = f.adatawidth;
+
+            int i = item.get_global_id(1);
+            int j = item.get_global_id(2);
+
+            int row = item.get_local_id(1);
+            int col = item.get_local_id(2);
+
+            sycl::float4 sum = sycl::float4(0.0);
+
+            for (int kk = 0; kk < adatawidth; kk += tile_size) {
+                if (i < aheight && (col + kk) < adatawidth) {
+                    local_a[row * tile_size / 4 + col / 4] = sycl::float4(ptra[i * awidth + (col + kk)], ptra[i * awidth + (col + kk) + 1], ptra[i * awidth + (col + kk) + 2], ptra[i * awidth + (col + kk) + 3]);
+                }
+
+                if ((row + kk) < bheight && j < owidth) {
+                    local_b[row * tile_size / 4 + col / 4] = sycl::float4(ptrb[(row + kk) * awidth + j], ptrb[(row + kk) * awidth + j + 1], ptrb[(row + kk) * awidth + j + 2], ptrb[(row + kk) * awidth + j + 3]);
+                }
+
+                item.barrier(sycl::access::fence_space::local_space);
+#pragma unroll
+                for (int k = 0; k < tile_size; k += 4) {
+                    sycl::float4 vec_a, vec_b, diff;
+                    if (kk + k < adatawidth) {
+                        vec_a = local_a[row * tile_size / 4 + k / 4];
+                        vec_b = local_b[col * tile_size / 4 + k / 4];
+                        diff = vec_a - vec_b;
+                        sum = sycl::mad(diff, diff, sum);
+                    }
+                }
+                item.barrier(sycl::access::fence_space::local_space);
+            }
+
+            if (i < aheight && j < bheight) {
+                f.out_data[i * owidth + j] = sycl::dot(sum, sycl::float4(1.0));
+            }
+        });
+    });
+
+    if (vector_events == nullptr) {
+        t_event.wait();
+    }
+
+    return t_event;
+}
+
+template sycl::event pwdist_sycl_tiled_float4_batch<16>(const PwdistBatchFrame *frames, int count, sycl::queue &Q, const std::vector<sycl::event> *vector_events);
+
+template <size_t tile_size>
+sycl::event pwdist_sycl_tiled_batch(const PwdistBatchFrame *frames, int count, sycl::queue &Q, const std::vector<sycl::event> *vector_events) {
+    const auto batch = batch_frames(frames, count);
+    int max_aheight, max_bheight;
+    pwdist_batch_extent(frames, count, max_aheight, max_bheight);
+    auto frame_range = SYCLUtils::generate2DRange(tile_size, max_aheight, max_bheight).get_global_range();
+    sycl::nd_range<3> nd_range{sycl::range<3>(count, frame_range[0], frame_range[1]), sycl::range<3>(1, tile_size, tile_size)};
+
+    auto t_event = Q.submit([&](sycl::handler &h) {
+        if (vector_events != nullptr && !vector_events->empty()) {
+            h.depends_on(*vector_events);
+        }
+        sycl::local_accessor<float> local_a(tile_size * tile_size, h);
+        sycl::local_accessor<float> local_b(tile_size * tile_size, h);
+
+        h.parallel_for(nd_range, [=](sycl::nd_item<3> item) {
+            // A work-group never mixes frames, so the barriers are reached by all its work-items
+            const PwdistBatchFrame &f = batch[item.get_group(0)];
+            const float *ptra = f.ptra;
+            const float *ptrb = f.ptrb;
+            const int aheight = f.aheight;
+            const int awidth = f.awidth;
+            const int bheight = f.bheight;
+            const int owidth = f.owidth;
+            const int adatawidth = f.adatawidth;
+
+            int i = item.get_global_id(1);
+            int j = item.get_global_id(2);
+
+            int row = item.get_local_id(1);
+            int col = item.get_local_id(2);
+
+            float sum = 0.0;
+
+            for (int kk = 0; kk < adatawidth; kk += tile_size) {
+                if (i < aheight && (col + kk) < adatawidth) {
+                    local_a[row * tile_size + col] = ptra[i * awidth + (col + kk)];
+                }
+
+                if ((row + kk) < bheight && j < owidth) {
+                    local_b[row * tile_size + col] = ptrb[(row + kk) * awidth + j];
+                }
+
+                item.barrier(sycl::access::fence_space::local_space);
+#pragma unroll
+                for (int k = 0; k < tile_size; ++k) {
+                    int idx = kk + k;
+                    float vec_a, vec_b, diff;
+                    if (idx < adatawidth) {
+                        vec_a = local_a[row * tile_size + k];
+                        vec_b = local_b[col * tile_size + k];
+                        diff = vec_a - vec_b;
+                        sum = sycl::mad(diff, diff, sum);
+                    }
+                }
+                item.barrier(sycl::access::fence_space::local_space);
+            }
+
+            if (i < aheight && j < bheight) {
+                f.out_data[i * owidth + j] = sum;
+            }
+        });
+    });
+    if (vector_events == nullptr) {
+        t_event.wait();
+    }
+
+    return t_event;
+}
+
+template sycl::event pwdist_sycl_tiled_batch<16>(const PwdistBatchFrame *frames, int count, sycl::queue &Q, const std::vector<sycl::event> *vector_events);
@@ -1,20 +1,31 @@
 #include "ApplicationData.hpp"
+#include "CameraEmulator.hpp"
 #include "Comparer.hpp"
 #include "DataBuffers.hpp"
+#include "FrameSource.hpp"
 #if ENERGYPCM_ENABLED
 #include "EnergyPCM.hpp"
 #endif
 #include "GlobalParameters.hpp"
 #include "ImageUtils.hpp"
 #include "InputArgs.hpp"
+#include "ItemPool.hpp"
+#include "MemoryBudget.hpp"
 #include "PipelineFactory.hpp"
+#include "PipelineRuntime.hpp"
+#include "QueuePool.hpp"
+#include "ReorderBuffer.hpp"
+#include "ResultSink.hpp"
+#include "RoiList.hpp"
 #include "Results.hpp"
 #include "SYCLUtils.hpp"
+#include "StageBatcher.hpp"
+#include "TemporalCache.hpp"
 #include "Timer.hpp"
 #include "Tracer.hpp"
-#include "circular-buffer.hpp"
 #include "jsonfile.hpp"
 #include "pipeline_template.hpp"
+#include <algorithm>
 #include <sycl/sycl.hpp>
 
 namespace fs = std::filesystem;
@@ -27,13 +38,31 @@ int main(int argc, char *argv[]) {
     ApplicationData appData;
     // Parse the input arguments
     InputArgs inputArgs(argc, argv);
+    appData.setNumStages(inputArgs.numStages());
 
     // ____________________________________________________________________________________________________________________
     // 2. Configure the pipeline
     // ____________________________________________________________________________________________________________________
-    // Create Image object
+    // Create Image object (or open the multi-frame input if --input is given)
     Image imageData;
-    imageData.loadImageData(inputArgs.imageResolution, appData.height, appData.width);
+    std::unique_ptr<FrameSource> frameSource;
+    if (inputArgs.inputPath.empty()) {
+        imageData.loadImageData(inputArgs.imageResolution, appData.height, appData.width);
+        appData.pixelType = imageData.getPixelType();
+    } else {
+        frameSource = std::make_unique<FrameSource>(inputArgs.inputPath, inputArgs.inputHeight, inputArgs.inputWidth, inputArgs.inputFormat);
+        if (inputArgs.tileWidth > 0) {
+            // Gigapixel frames (--tile): the items, buffers and kernels are sized to a tile instead of the frame
+            frameSource->setTiles(TileGrid(frameSource->inputHeight(), frameSource->inputWidth(), inputArgs.tileHeight, inputArgs.tileWidth, appData.cellSize, appData.filterDim / 2,
+                                           appData.window_height, appData.windowWidth));
+        }
+        appData.height = frameSource->height();
+        appData.width = frameSource->width();
+        appData.pixelType = frameSource->pixelType();
+    }
+
+    // Size the in-flight frames and the item pool to the memory budget (--mem-budget), if any
+    MemoryBudget::apply(appData, inputArgs);
 
     // Configure the SYCL queue if we are using SYCL as backend for filters or the pipeline
     sycl::queue Q_GPU, Q_CPU;
@@ -42,8 +71,88 @@ int main(int argc, char *argv[]) {
 
     // Configure all the buffers (GlobalFrame, FilterBank, GlobalCla)
     DataBuffers::createAllBuffers(appData, imageData.getImageData());
-    // Create the circular buffer for the items of the pipeline (default: 8*inFlightFrames)
-    circular_buffer bufferItems{inputArgs.sizeCircularBuffer, appData.globalFrame, appData.globalCla, appData.numFilters, appData.USM_queue};
+    imageData.release(); // The image now lives in the global frame, drop the mapping
+    // Create the pool of items of the pipeline (default: 4*inFlightFrames)
+    ItemPool bufferItems{inputArgs.sizeCircularBuffer, appData.globalFrame, appData.globalCla, appData.numFilters, appData.USM_queue, appData.usmUsage, static_cast<size_t>(inputArgs.inFlightFrames)};
+    // Classes and outputs of the classifiers and branches of --stages
+    DataBuffers::createStageBuffers(appData, inputArgs, bufferItems);
+    // Components the frames go through before the first stage and after the last one (attached to the pipeline)
+    PipelineRuntime runtime;
+    // Spread the frames in flight over several queues of each device (--queues)
+    std::unique_ptr<QueuePool> queuePool;
+    if (inputArgs.queuesPerDevice > 1) {
+        bool cpuQueues = SYCL_ENABLED || inputArgs.pipelineName == PipelineType::SYCLEvents;
+        queuePool = std::make_unique<QueuePool>(Q_GPU, Q_CPU, static_cast<size_t>(inputArgs.queuesPerDevice), inputArgs.queuePolicy, inputArgs.queueInOrder, cpuQueues);
+        runtime.queuePool = queuePool.get();
+        std::cout << " Queues: " << queuePool->describe() << std::endl;
+    }
+    // Launch the frames that reach a GPU stage together, up to the batch size (--gpu-batch; auto: by resolution)
+    std::unique_ptr<StageBatcher> stageBatcher;
+    if (inputArgs.gpuBatch != 1 && inputArgs.GPUactive) {
+        size_t batch = inputArgs.gpuBatch > 0 ? static_cast<size_t>(inputArgs.gpuBatch) : StageBatcher::autoSize(appData.height, appData.width);
+        // A batch cannot have more frames than the ones in flight
+        batch = std::min(batch, static_cast<size_t>(std::max(inputArgs.inFlightFrames, 1)));
+        if (batch > 1) {
+            stageBatcher = std::make_unique<StageBatcher>(inputArgs.numStages(), batch, std::chrono::microseconds(inputArgs.gpuBatchTimeout));
+            runtime.stageBatcher = stageBatcher.get();
+        }
+        std::cout << " GPU batch: " << batch << " frames per launch (timeout: " << inputArgs.gpuBatchTimeout << " us)" << std::endl;
+    }
+    if (frameSource) {
+        // The first frame is the global frame (golden output); the items take theirs from the prefetch ring
+        frameSource->readFrame(0, appData.globalFrame);
+        size_t ringSize = static_cast<size_t>(std::max(inputArgs.inFlightFrames, inputArgs.maxTokens) + inputArgs.prefetchFrames);
+        // A shared memory input is read in place only if every device whose kernels read the frames can access host
+        // memory: the GPU, and the CPU when its stages are SYCL kernels (SYCL filters or --api syclevents)
+        bool cpuKernels = (SYCL_ENABLED || inputArgs.pipelineName == PipelineType::SYCLEvents) &&
+                          std::any_of(inputArgs.stageExecutionState.begin(), inputArgs.stageExecutionState.end(), [](StageState state) { return state != StageState::GPU; });
+        bool gpuHostAccess = !inputArgs.GPUactive || Q_GPU.get_device().has(sycl::aspect::usm_system_allocations);
+        bool cpuHostAccess = !cpuKernels || Q_CPU.get_device().has(sycl::aspect::usm_system_allocations);
+        bool zeroCopy = gpuHostAccess && cpuHostAccess;
+        if (inputArgs.inputPath.rfind("shm:", 0) == 0 && !zeroCopy) {
+            std::cerr << " Warning: the " << (gpuHostAccess ? "CPU" : "GPU") << " device cannot access host memory, the shared memory frames are copied" << std::endl;
+        }
+        frameSource->start(appData.USM_queue, appData.usmUsage, ringSize, appData.globalFrame, {inputArgs.ioBackend, static_cast<size_t>(inputArgs.ioDepth), inputArgs.directIO, zeroCopy});
+        runtime.frameSource = frameSource.get();
+    }
+    // Process only the windows around the regions of interest of the listed frames (--roi)
+    std::unique_ptr<RoiList> rois;
+    if (!inputArgs.roiPath.empty()) {
+        rois = std::make_unique<RoiList>(inputArgs.roiPath, appData.height, appData.width, appData.cellSize, appData.filterDim / 2, appData.window_height, appData.windowWidth);
+        appData.activeFraction = rois->meanFraction();
+        runtime.rois = rois.get();
+    }
+    // Recompute only the tiles that changed since the last keyframe and reuse the output of the others (--reuse)
+    std::unique_ptr<TemporalCache> temporalCache;
+    if (inputArgs.reuseThreshold >= 0.0) {
+        temporalCache = std::make_unique<TemporalCache>(TemporalReuseConfig{inputArgs.reuseThreshold, inputArgs.reuseRefresh, inputArgs.reuseVerify}, appData.height, appData.width,
+                                                        appData.cellSize, appData.filterDim / 2, appData.numFilters, appData.filterBank, appData.globalCla);
+        runtime.temporalCache = temporalCache.get();
+    }
+    // Release the frames on a timer (--camera) instead of as fast as the pipeline accepts them
+    std::unique_ptr<CameraEmulator> camera;
+    if (inputArgs.cameraFps > 0.0) {
+        camera = std::make_unique<CameraEmulator>(CameraConfig{inputArgs.cameraFps, inputArgs.cameraBurst, inputArgs.cameraJitter, inputArgs.deadline});
+        runtime.camera = camera.get();
+    }
+    // Write the detections of each frame from a dedicated thread (--sink)
+    std::unique_ptr<ResultSink> resultSink;
+    if (!inputArgs.sinkPath.empty()) {
+        ResultSinkConfig sinkConfig{inputArgs.sinkPath, inputArgs.sinkFormat, static_cast<size_t>(inputArgs.sinkDepth), static_cast<size_t>(inputArgs.sinkTopK), inputArgs.sinkDrop};
+        sinkConfig.tiles = frameSource ? frameSource->tiles() : nullptr;
+        // With tiles the detections are stitched and written with the coordinates of the whole frame
+        int sinkWidth = sinkConfig.tiles != nullptr ? frameSource->inputWidth() : appData.width;
+        int sinkHeight = sinkConfig.tiles != nullptr ? frameSource->inputHeight() : appData.height;
+        resultSink = std::make_unique<ResultSink>(sinkConfig, sinkWidth, sinkHeight);
+        runtime.resultSink = resultSink.get();
+    }
+    // Deliver the frames in the order of their ids, whatever the order they finish in (--reorder)
+    std::unique_ptr<ReorderBuffer> reorderBuffer;
+    if (inputArgs.reorder) {
+        reorderBuffer = std::make_unique<ReorderBuffer>(ReorderConfig{inputArgs.reorderWindow, inputArgs.reorderGap, inputArgs.reorderTimeout}, bufferItems.capacity(), appData.id + 1);
+        runtime.reorderBuffer = reorderBuffer.get();
+        std::cout << " Reorder: " << reorderBuffer->describe() << std::endl;
+    }
 
     // ____________________________________________________________________________________________________________________
     // 3. Configure some output variables
@@ -51,6 +160,14 @@ int main(int argc, char *argv[]) {
     // Calculate the golden output used for debugging
     if constexpr (DEBUG_ENABLED) {
         Comparer::createGoldenFrame(appData);
+        // Only the frames with the pixels of the global frame have a golden output to compare with
+        if (frameSource) {
+            if (inputArgs.inputPath.rfind("shm:", 0) == 0) {
+                std::cerr << " Debug: the frames of a shared memory input do not repeat, none is compared with the golden output" << std::endl;
+            } else {
+                std::cout << " Debug: only the repetitions of the first input frame" << (frameSource->tiles() ? " (first tile)" : "") << " are compared with the golden output" << std::endl;
+            }
+        }
     }
     // Create the tracer object for the pipeline
     Tracer traceFile;
@@ -64,6 +181,7 @@ int main(int argc, char *argv[]) {
     // Determinar el tipo de pipeline a ejecutar
     // Create the pipeline
     auto pipeline = PipelineFactory::createPipeline(inputArgs.pipelineName);
+    pipeline->attach(runtime);
     if constexpr (VERBOSE_ENABLED) {
         std::cout << " Running " << PipelineFactory::getPipelineTypeString(inputArgs.pipelineName) << " version..." << std::endl;
     }
@@ -76,6 +194,25 @@ int main(int argc, char *argv[]) {
 
     // Execute the pipeline
     pipeline->executePipeline(appData, inputArgs, bufferItems, traceFile, Q_GPU, Q_CPU);
+    if (reorderBuffer) {
+        // Only frames held behind one that never finished can be left: deliver them before the input and the sink stop
+        runtime.flush(bufferItems);
+        appData.reorderStats = reorderBuffer->getStats();
+    }
+    if (frameSource) {
+        frameSource->stop();
+        appData.ingestStats = frameSource->getStats();
+    }
+    if (camera) {
+        appData.cameraStats = camera->getStats();
+    }
+    if (resultSink) {
+        resultSink->stop();
+        appData.sinkStats = resultSink->getStats();
+    }
+    if (temporalCache) {
+        appData.reuseStats = temporalCache->getStats();
+    }
 
 // // Stop the energy measurement
 #if ENERGYPCM_ENABLED
@@ -87,6 +224,29 @@ int main(int argc, char *argv[]) {
     // ____________________________________________________________________________________________________________________
     // Compute and display the results
     calculateAndDisplayResults(appData, inputArgs);
+    if constexpr (VERBOSE_ENABLED) {
+        displayItemPoolStats(bufferItems.getStats());
+    }
+    if (frameSource) {
+        displayFrameSourceStats(appData.ingestStats);
+    }
+    if (camera) {
+        displayCameraStats(appData.cameraStats);
+    }
+    if (resultSink) {
+        displayResultSinkStats(appData.sinkStats);
+    }
+    if (temporalCache) {
+        displayTemporalReuseStats(appData.reuseStats);
+    }
+    if (reorderBuffer) {
+        displayReorderStats(appData.reorderStats);
+    }
+    if (stageBatcher && stageBatcher->getLaunches() > 0) {
+        const StageBatcher &batcher = *stageBatcher;
+        std::cout << " GPU batches: " << batcher.getLaunches() << " launches, " << static_cast<double>(batcher.getFrames()) / batcher.getLaunches() << " frames per launch (max. "
+                  << batcher.getBatchSize() << ")" << std::endl;
+    }
 
     // ____________________________________________________________________________________________________________________
     // 6. Export the results to a file (JSON)
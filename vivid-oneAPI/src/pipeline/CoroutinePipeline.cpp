@@ -0,0 +1,356 @@
+#include "CoroutinePipeline.hpp"
+#include "GlobalParameters.hpp"
+#include "Timer.hpp"
+#include "common_macros.hpp"
+#include <algorithm>
+#include <condition_variable>
+#include <iostream>
+#include <stdexcept>
+#include <thread>
+
+// State shared by the tokens of a run
+struct CoroutinePipeline::Run {
+    ApplicationData &appData;
+    InputArgs &inputArgs;
+    ItemPool &bufferItems;
+    Tracer &traceFile;
+    sycl::queue &Q_GPU;
+    sycl::queue &Q_CPU;
+
+    CoroExecutor executor;
+    CoroExecutor inputThread{1}; //< Runs the input node, one frame at a time: its waits never hold a thread of executor
+    CoroMutex output{executor};  //< The output node takes one frame at a time (out of order)
+    std::unique_ptr<GPUCompletion> gpuCompletion;
+    std::vector<sycl::event> noEvents; //< The GPU kernels handed to gpuCompletion must not wait for their event
+
+    std::mutex admissionMutex;
+    std::atomic<uint64_t> releases{0};                      //< Changed under admissionMutex
+    std::vector<std::coroutine_handle<>> waitingAdmission; //< Tokens suspended until a stage releases its resources
+    std::atomic<size_t> suspendedAdmissions{0};
+
+    std::mutex tokensMutex;
+    std::condition_variable tokensDone;
+    size_t runningTokens = 0;
+    std::atomic<bool> failed{false};
+    std::exception_ptr error; //< First error of a token
+
+    Run(ApplicationData &appData_, InputArgs &inputArgs_, ItemPool &bufferItems_, Tracer &traceFile_, sycl::queue &Q_GPU_, sycl::queue &Q_CPU_, size_t numThreads)
+        : appData{appData_}, inputArgs{inputArgs_}, bufferItems{bufferItems_}, traceFile{traceFile_}, Q_GPU{Q_GPU_}, Q_CPU{Q_CPU_}, executor{numThreads} {}
+
+    // Resume every token waiting for an admission (each one tries again)
+    void released() {
+        std::vector<std::coroutine_handle<>> waiting;
+        {
+            std::lock_guard<std::mutex> lock(admissionMutex);
+            releases.fetch_add(1, std::memory_order_release);
+            waiting.swap(waitingAdmission);
+        }
+        for (auto handle : waiting) {
+            executor.schedule(handle);
+        }
+    }
+
+    void fail(std::exception_ptr exception) {
+        {
+            std::lock_guard<std::mutex> lock(tokensMutex);
+            if (!error) {
+                error = exception;
+            }
+        }
+        failed.store(true, std::memory_order_relaxed);
+        // The tokens waiting for the resources of the failed one give up
+        released();
+    }
+
+    void tokenEnded() {
+        std::lock_guard<std::mutex> lock(tokensMutex);
+        if (--runningTokens == 0) {
+            tokensDone.notify_all();
+        }
+    }
+
+    void waitTokens() {
+        std::unique_lock<std::mutex> lock(tokensMutex);
+        tokensDone.wait(lock, [&] { return runningTokens == 0; });
+    }
+};
+
+// Join of the branches of a level: counts the branches still running and the token
+struct CoroutinePipeline::Join {
+    CoroExecutor &executor;
+    std::atomic<size_t> remaining;
+    std::coroutine_handle<> token;
+    std::mutex mutex;
+    std::exception_ptr error; //< First error of a branch
+
+    Join(CoroExecutor &executor_, size_t branches) : executor{executor_}, remaining{branches} {}
+
+    // Called by each branch once it has ended; the join must not be used afterwards
+    void arrive() {
+        if (remaining.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+            executor.schedule(token);
+        }
+    }
+
+    bool await_ready() const noexcept { return false; }
+    bool await_suspend(std::coroutine_handle<> handle) {
+        token = handle;
+        return remaining.fetch_sub(1, std::memory_order_acq_rel) != 1;
+    }
+    void await_resume() const noexcept {}
+};
+
+namespace {
+// Suspends the token unless a stage has released its resources since it read `seen`
+struct AdmissionWait {
+    std::mutex &mutex;
+    std::atomic<uint64_t> &releases;
+    std::vector<std::coroutine_handle<>> &waiting;
+    uint64_t seen;
+
+    bool await_ready() const noexcept { return false; }
+    bool await_suspend(std::coroutine_handle<> handle) {
+        std::lock_guard<std::mutex> lock(mutex);
+        if (releases.load(std::memory_order_relaxed) != seen) {
+            return false;
+        }
+        waiting.push_back(handle);
+        return true;
+    }
+    void await_resume() const noexcept {}
+};
+
+// Suspends the coroutine until the kernel has completed; the completion thread of the GPU resumes it on the executor
+struct EventCompletion {
+    GPUCompletion &completion;
+    CoroExecutor &executor;
+    sycl::event &event;
+
+    static void resume(void *executor, void *handle, const sycl::event &) {
+        static_cast<CoroExecutor *>(executor)->schedule(std::coroutine_handle<>::from_address(handle));
+    }
+
+    bool await_ready() const noexcept { return false; }
+    void await_suspend(std::coroutine_handle<> handle) { completion.notify(event, resume, &executor, handle.address()); }
+    // The event has completed: this only reports the errors of the kernel
+    void await_resume() { event.wait_and_throw(); }
+};
+
+// The branches of --stages may wait for their admission for the same item at the same time
+void traceWait(Tracer &tracer, InputArgs &inputArgs, int index, ViVidItem *item, void (Tracer::*event)(ViVidItem *)) {
+    std::unique_lock<std::mutex> lock(item->branchMutex, std::defer_lock);
+    if (index >= 0 && inputArgs.isBranch(index)) {
+        lock.lock();
+    }
+    (tracer.*event)(item);
+}
+} // namespace
+
+void CoroutinePipeline::executePipeline(ApplicationData &appData, InputArgs &inputArgs, ItemPool &bufferItems, Tracer &traceFile, sycl::queue &Q_GPU, sycl::queue &Q_CPU, EnergyPCM *energyPCM) {
+    // The GPU stages only hold a thread of the executor when they block (--gpu-blocking)
+    size_t numThreads = static_cast<size_t>(inputArgs.nThreads + (inputArgs.asyncGPUStages() ? 0 : inputArgs.GPUactive));
+    size_t numTokens = static_cast<size_t>(inputArgs.inFlightFrames);
+    if constexpr (VERBOSE_ENABLED) {
+        std::cout << " Running COROUTINE version with " << numTokens << " tokens on " << std::max<size_t>(numThreads, 1) << " threads..." << std::endl;
+    }
+
+    if constexpr (LOG_ENABLED) {
+        inputArgs.resourcesManager->startMonitoring();
+    }
+
+    Run run{appData, inputArgs, bufferItems, traceFile, Q_GPU, Q_CPU, numThreads};
+    // The GPU stages release their thread while the device runs them (see GPUCompletion.hpp)
+    if (inputArgs.asyncGPUStages()) {
+        run.gpuCompletion = std::make_unique<GPUCompletion>();
+    }
+
+    appData.pipeline_start = tbb::tick_count::now();
+    // We ensure the executions always last the same, regardless of whether the automatic mode is enabled or not
+    if constexpr (AUTOMODE_ENABLED) {
+        startTimeMeasurement(appData, inputArgs);
+    } else {
+        startTimerIfNeeded(appData, inputArgs);
+    }
+
+    run.runningTokens = numTokens;
+    for (size_t i = 0; i < numTokens; ++i) {
+        runToken(run);
+    }
+    run.waitTokens();
+
+    if constexpr (VERBOSE_ENABLED) {
+        std::cout << " Admissions that suspended a token: " << run.suspendedAdmissions.load() << std::endl;
+        if (run.gpuCompletion) {
+            std::cout << " GPU stages that released their thread: " << run.gpuCompletion->getCompleted() << std::endl;
+        }
+    }
+
+    if constexpr (LOG_ENABLED) {
+        inputArgs.resourcesManager->stopMonitoring();
+    }
+    appData.pipeline_end = tbb::tick_count::now();
+
+    if (run.error) {
+        std::rethrow_exception(run.error);
+    }
+}
+
+DetachedCoroutine CoroutinePipeline::runToken(Run &run) {
+    try {
+        // The tokens run on the executor (the input node on the input thread)
+        co_await run.executor.yield();
+        while (!run.failed.load(std::memory_order_relaxed)) {
+            // The input node may wait for a free item, a frame of --input or the release of the camera: the token
+            // is suspended on the input thread meanwhile, and the other tokens keep the threads of the executor
+            ViVidItem *item = nullptr;
+            co_await run.inputThread.yield();
+            if (!run.failed.load(std::memory_order_relaxed) && hasNextFrame(run.appData, run.inputArgs, run.bufferItems)) {
+                item = processInputNode(run.appData, run.inputArgs, run.bufferItems, run.traceFile);
+                if constexpr (LOG_ENABLED) {
+                    std::clog << "Processing item " << item->item_id << " in the input node with thread " << std::this_thread::get_id() << ".\n";
+                }
+            }
+            co_await run.executor.yield();
+            if (item == nullptr) {
+                break;
+            }
+
+            // In Decoupled mode the whole frame runs on the device it is admitted to
+            if (run.inputArgs.selectedPath == PathSelection::Decoupled) {
+                Acc acc;
+                co_await admit(run, -1, item, acc);
+            }
+
+            for (const auto &level : run.inputArgs.stageLevels) {
+                co_await runLevel(run, level, item);
+            }
+
+            {
+                auto output = co_await run.output.lock();
+                // Save the previous number of tokens
+                int prev_tokens;
+                if constexpr (AUTOMODE_ENABLED) {
+                    prev_tokens = run.inputArgs.inFlightFrames;
+                }
+
+                adjustCountersAfterProcessing(item, run.inputArgs, run.appData);
+                if (run.inputArgs.selectedPath == PathSelection::Decoupled) {
+                    run.released();
+                }
+                handleTimeMeasurements(item, run.appData, run.inputArgs);
+                if (isAutoModeEnabled(run.appData, item, run.inputArgs)) {
+                    optimizePipeline(run.appData, run.inputArgs);
+                    run.inputArgs.inFlightFrames = prev_tokens;
+                }
+
+                // Check debug, trace and recycle the item
+                debugAndTrace(item, run.appData, run.traceFile);
+                processOutputNode(run.inputArgs, run.bufferItems, item);
+            }
+        }
+    } catch (...) {
+        run.fail(std::current_exception());
+    }
+    run.tokenEnded();
+}
+
+CoroTask CoroutinePipeline::runLevel(Run &run, const std::vector<size_t> &level, ViVidItem *item) {
+    if (level.size() == 1) {
+        co_await runStageAsync(run, level.front(), item);
+        co_return;
+    }
+
+    // The first branch runs in the token, the others in coroutines of their own
+    Join join{run.executor, level.size()};
+    for (size_t i = 1; i < level.size(); ++i) {
+        runBranch(run, level[i], item, join);
+    }
+    std::exception_ptr error;
+    try {
+        co_await runStageAsync(run, level.front(), item);
+    } catch (...) {
+        error = std::current_exception();
+    }
+    // The branches use the item: wait for them also if the first one failed
+    co_await join;
+    if (!error) {
+        error = join.error;
+    }
+    if (error) {
+        std::rethrow_exception(error);
+    }
+}
+
+DetachedCoroutine CoroutinePipeline::runBranch(Run &run, size_t stage, ViVidItem *item, Join &join) {
+    co_await run.executor.yield();
+    try {
+        co_await runStageAsync(run, stage, item);
+    } catch (...) {
+        std::lock_guard<std::mutex> lock(join.mutex);
+        if (!join.error) {
+            join.error = std::current_exception();
+        }
+    }
+    join.arrive();
+}
+
+CoroTask CoroutinePipeline::runStageAsync(Run &run, size_t stage, ViVidItem *item) {
+    if constexpr (LOG_ENABLED) {
+        std::clog << "Processing item " << item->item_id << " in stage " << stage << " with thread " << std::this_thread::get_id() << ".\n";
+    }
+    Acc acc;
+    co_await admit(run, static_cast<int>(stage), item, acc);
+    try {
+        if (acc == Acc::GPU && run.gpuCompletion && run.inputArgs.stages[stage]->enqueues) {
+            // The kernel only submits its work; the thread takes other tokens until the GPU has run it
+            SyclEventInfo eventInfo = runStage(stage, acc, item, run.traceFile, run.appData, run.inputArgs, runtime.stageBatcher, run.Q_GPU, &run.noEvents);
+            co_await EventCompletion{*run.gpuCompletion, run.executor, eventInfo.event};
+            std::unique_lock<std::mutex> lock(item->branchMutex, std::defer_lock);
+            if (run.inputArgs.isBranch(stage)) {
+                lock.lock();
+            }
+            record_sycl_time(item, eventInfo.event, static_cast<int>(stage), "GPU_S");
+        } else {
+            runStage(stage, acc, item, run.traceFile, run.appData, run.inputArgs, runtime.stageBatcher, (acc == Acc::GPU) ? run.Q_GPU : run.Q_CPU, nullptr);
+        }
+    } catch (...) {
+        release(run, acc, static_cast<int>(stage));
+        throw;
+    }
+    release(run, acc, static_cast<int>(stage));
+}
+
+CoroTask CoroutinePipeline::admit(Run &run, int index, ViVidItem *item, Acc &acc) {
+    if constexpr (TRACE_ENABLED) {
+        traceWait(run.traceFile, run.inputArgs, index, item, &Tracer::wait_start);
+    }
+    while (true) {
+        if (run.failed.load(std::memory_order_relaxed)) {
+            throw std::runtime_error("CoroutinePipeline: another token failed");
+        }
+        // A release after this read resumes the token if it has already been suspended, or keeps it from suspending
+        uint64_t seen = run.releases.load(std::memory_order_acquire);
+        // Never wait in the queue of a device: that would block the thread of the executor
+        if (run.inputArgs.selectedPath == PathSelection::Decoupled) {
+            acc = selectPathDecoupled(run.inputArgs, index, item->GPU_item, false);
+        } else {
+            acc = selectPathCoupled(run.inputArgs, index, item->GPU_item, false);
+        }
+        if (acc != Acc::OTHER) {
+            break;
+        }
+        run.suspendedAdmissions.fetch_add(1, std::memory_order_relaxed);
+        co_await AdmissionWait{run.admissionMutex, run.releases, run.waitingAdmission, seen};
+    }
+    if constexpr (TRACE_ENABLED) {
+        traceWait(run.traceFile, run.inputArgs, index, item, &Tracer::wait_end);
+    }
+}
+
+void CoroutinePipeline::release(Run &run, Acc acc, int index) {
+    reduceCountersAfterProcessing(run.inputArgs, run.appData, acc, index);
+    // In Decoupled mode the stages hold nothing: the device of the frame is released by the output
+    if (run.inputArgs.selectedPath != PathSelection::Decoupled) {
+        run.released();
+    }
+}
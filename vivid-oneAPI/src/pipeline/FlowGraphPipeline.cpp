@@ -1,34 +1,61 @@
 // FlowGraphPipeline.cpp
 #include "FlowGraphPipeline.hpp"
 #include "Queue.hpp"
+#include <algorithm>
+#include <memory>
 
 // Async GPU Node Definitions
-FGPU::FGPU(std::function<SyclEventInfo(ViVidItem *, Tracer &, ApplicationData &, InputArgs &, sycl::queue &)> kernel_func, int stage) : kernel_func(kernel_func), stage(stage) {
-    a.initialize(1, 0);
-}
+FGPU::FGPU(int stage, Tracer &traceFile, ApplicationData &appData, InputArgs &inputArgs, sycl::queue &Q_GPU, StageBatcher *batcher, PipelineInterface &pipeline, GPUCompletion *completion)
+    : stage(stage), traceFile(traceFile), appData(appData), inputArgs(inputArgs), Q_GPU(Q_GPU), batcher(batcher), pipeline(pipeline), completion(completion) {}
 
-void FGPU::submit(gateway_type &gateway, ViVidItem *item, Tracer &traceFile, ApplicationData &appData, InputArgs &inputArgs, sycl::queue &Q_GPU, PipelineInterface &pipeline) {
+void FGPU::submit(gateway_type &gateway, ViVidItem *item) {
     gateway.reserve_wait();
-    a.execute([this, &item, &gateway, &traceFile, &appData, &inputArgs, &Q_GPU, &pipeline]() {
-        SyclEventInfo eventInfo = kernel_func(item, traceFile, appData, inputArgs, Q_GPU);
-        pipeline.publicReduceCountersAfterProcessing(inputArgs, appData, Acc::GPU, stage);
-        gateway.try_put(item);
-        gateway.release_wait();
-    });
+    // The stages that run on the calling thread (sim) are finished here as well
+    if (completion == nullptr || !inputArgs.stages[stage]->enqueues) {
+        runStage(stage, Acc::GPU, item, traceFile, appData, inputArgs, batcher, Q_GPU);
+        finish(gateway, item, nullptr);
+        return;
+    }
+    this->gateway.store(&gateway, std::memory_order_relaxed);
+    SyclEventInfo eventInfo = runStage(stage, Acc::GPU, item, traceFile, appData, inputArgs, batcher, Q_GPU, &noEvents);
+    completion->notify(eventInfo.event, &FGPU::complete, this, item);
+}
+
+void FGPU::complete(void *self, void *item, const sycl::event &event) {
+    FGPU *fgpu = static_cast<FGPU *>(self);
+    fgpu->finish(*fgpu->gateway.load(std::memory_order_relaxed), static_cast<ViVidItem *>(item), &event);
+}
+
+void FGPU::finish(gateway_type &gateway, ViVidItem *item, const sycl::event *event) {
+    if (event != nullptr) {
+        std::unique_lock<std::mutex> lock(item->branchMutex, std::defer_lock);
+        if (inputArgs.isBranch(stage)) {
+            lock.lock();
+        }
+        record_sycl_time(item, *event, stage, "GPU_S");
+    }
+    pipeline.publicReduceCountersAfterProcessing(inputArgs, appData, Acc::GPU, stage);
+    gateway.try_put(item);
+    gateway.release_wait();
 }
 
-template <typename NodeType, std::size_t N>
-void FlowGraphPipeline<NodeType, N>::executePipeline(ApplicationData &appData, InputArgs &inputArgs, circular_buffer &bufferItems, Tracer &traceFile, sycl::queue &Q_GPU, sycl::queue &Q_CPU, EnergyPCM *energyPCM) {
+template <typename NodeType>
+void FlowGraphPipeline<NodeType>::executePipeline(ApplicationData &appData, InputArgs &inputArgs, ItemPool &bufferItems, Tracer &traceFile, sycl::queue &Q_GPU, sycl::queue &Q_CPU, EnergyPCM *energyPCM) {
     setupPipeline(appData, inputArgs, bufferItems, traceFile, Q_GPU, Q_CPU, energyPCM);
 }
 
-template <typename NodeType, std::size_t N>
-void FlowGraphPipeline<NodeType, N>::setupPipeline(ApplicationData &appData, InputArgs &inputArgs, circular_buffer &bufferItems, Tracer &traceFile, sycl::queue &Q_GPU, sycl::queue &Q_CPU, EnergyPCM *energyPCM) {
+template <typename NodeType>
+void FlowGraphPipeline<NodeType>::setupPipeline(ApplicationData &appData, InputArgs &inputArgs, ItemPool &bufferItems, Tracer &traceFile, sycl::queue &Q_GPU, sycl::queue &Q_CPU, EnergyPCM *energyPCM) {
     if constexpr (VERBOSE_ENABLED) {
         std::cout << " Running FLOW GRAPH " << (std::is_same<NodeType, FunctionalNode>::value ? "FUNCTIONAL NODE" : "ASYNC NODE") << " version..." << std::endl;
     }
 
     tbb::global_control global_limit{tbb::global_control::max_allowed_parallelism, static_cast<size_t>(inputArgs.nThreads + inputArgs.GPUactive)};
+    if constexpr (std::is_same_v<NodeType, AsyncNode>) {
+        if (inputArgs.asyncGPUStages()) {
+            gpuCompletion_ = std::make_unique<GPUCompletion>();
+        }
+    }
     tbb::flow::graph g;
 
     auto in_node = create_Input_Node(g, appData, inputArgs, bufferItems, traceFile);
@@ -38,12 +65,12 @@ void FlowGraphPipeline<NodeType, N>::setupPipeline(ApplicationData &appData, Inp
     std::vector<indexer_t *> indexers;
 
     // Configurar la primera etapa manualmente
-    using GPUNode_t = decltype(create_GPU_Node<NodeType, 0>(g, traceFile, appData, inputArgs, Q_GPU, *this));
+    using GPUNode_t = decltype(create_GPU_Node(g, 0, traceFile, appData, inputArgs, Q_GPU, *this));
 
-    // Configure the first stage manually
-    auto gpu_cpu_split = std::make_shared<mfn_two_inputs_t>(create_Splitter_Node<0>(g, inputArgs, traceFile));
-    auto filter_cpu = std::make_shared<CPUNode_t>(create_CPU_Node<0>(g, appData, inputArgs, traceFile, Q_CPU));
-    auto filter_gpu = std::make_shared<GPUNode_t>(create_GPU_Node<NodeType, 0>(g, traceFile, appData, inputArgs, Q_GPU, *this));
+    // Configure the first stage manually (its splitter also takes the token)
+    auto gpu_cpu_split = std::make_shared<mfn_two_inputs_t>(create_Splitter_Node<mfn_two_inputs_t>(g, 0, inputArgs, traceFile));
+    auto filter_cpu = std::make_shared<CPUNode_t>(create_CPU_Node(g, 0, appData, inputArgs, traceFile, Q_CPU));
+    auto filter_gpu = std::make_shared<GPUNode_t>(create_GPU_Node(g, 0, traceFile, appData, inputArgs, Q_GPU, *this));
     auto async_join = std::make_shared<indexer_t>(create_Indexer_Node(g));
 
     tbb::flow::make_edge(in_node, tbb::flow::input_port<0>(join));
@@ -55,10 +82,29 @@ void FlowGraphPipeline<NodeType, N>::setupPipeline(ApplicationData &appData, Inp
     tbb::flow::make_edge(*filter_cpu, tbb::flow::input_port<1>(*async_join));
 
     indexers.push_back(async_join.get());
-    nodes_storage_.reserve(N * 4);
+    nodes_storage_.reserve(inputArgs.numStages() * 4);
+
+    // Configurar los siguientes niveles, cada uno detrás del anterior
+    for (size_t level = 1; level < inputArgs.stageLevels.size(); ++level) {
+        const auto &stages = inputArgs.stageLevels[level];
+        indexer_t *source = indexers.back();
+        if (stages.size() == 1) {
+            addStage(g, static_cast<int>(stages[0]), *source, inputArgs, traceFile, appData, Q_GPU, Q_CPU, indexers, nodes_storage_);
+            continue;
+        }
 
-    // Configurar las siguientes etapas utilizando recursión de plantillas
-    addStage<1>(g, inputArgs, traceFile, appData, Q_GPU, Q_CPU, indexers, nodes_storage_);
+        // Branches: all of them take the output of the previous level and the last one to finish an item forwards it
+        auto branch_join = std::make_shared<mfn_join_t>(create_Join_Node(g, static_cast<int>(stages.size())));
+        auto joined = std::make_shared<indexer_t>(create_Indexer_Node(g));
+        for (size_t stage : stages) {
+            addStage(g, static_cast<int>(stage), *source, inputArgs, traceFile, appData, Q_GPU, Q_CPU, indexers, nodes_storage_);
+            tbb::flow::make_edge(*indexers.back(), *branch_join);
+        }
+        tbb::flow::make_edge(tbb::flow::output_port<0>(*branch_join), tbb::flow::input_port<0>(*joined));
+        indexers.push_back(joined.get());
+        nodes_storage_.push_back(branch_join);
+        nodes_storage_.push_back(joined);
+    }
 
     auto out_node = create_Output_Node(g, token_buffer, appData, inputArgs, bufferItems, traceFile, energyPCM);
     tbb::flow::make_edge(*indexers.back(), out_node);
@@ -76,41 +122,44 @@ void FlowGraphPipeline<NodeType, N>::setupPipeline(ApplicationData &appData, Inp
     in_node.activate();
     g.wait_for_all();
     appData.pipeline_end = tbb::tick_count::now();
-}
 
-template <typename NodeType, std::size_t N>
-template <std::size_t Stage>
-void FlowGraphPipeline<NodeType, N>::addStage(tbb::flow::graph &g, InputArgs &inputArgs, Tracer &traceFile, ApplicationData &appData, sycl::queue &Q_GPU, sycl::queue &Q_CPU, std::vector<indexer_t *> &indexers, std::vector<std::shared_ptr<void>> &nodes_storage) {
-    if constexpr (Stage < N) {
-        // Get the types of the nodes to be created
-        using GPUNode_t = decltype(create_GPU_Node<NodeType, Stage>(g, traceFile, appData, inputArgs, Q_GPU, *this));
+    // Every gateway has been released, so nothing is pending in the completion thread
+    if (gpuCompletion_) {
+        if constexpr (VERBOSE_ENABLED) {
+            std::cout << " GPU stages completed by the completion thread: " << gpuCompletion_->getCompleted() << std::endl;
+        }
+        gpuCompletion_.reset();
+    }
+}
 
-        auto gpu_cpu_split = std::make_shared<mfn_one_input_t>(create_Splitter_Node<Stage>(g, inputArgs, traceFile));
-        auto filter_cpu = std::make_shared<CPUNode_t>(create_CPU_Node<Stage>(g, appData, inputArgs, traceFile, Q_CPU));
-        auto filter_gpu = std::make_shared<GPUNode_t>(create_GPU_Node<NodeType, Stage>(g, traceFile, appData, inputArgs, Q_GPU, *this));
-        auto async_join = std::make_shared<indexer_t>(create_Indexer_Node(g));
+template <typename NodeType>
+void FlowGraphPipeline<NodeType>::addStage(tbb::flow::graph &g, int stage, indexer_t &source, InputArgs &inputArgs, Tracer &traceFile, ApplicationData &appData, sycl::queue &Q_GPU, sycl::queue &Q_CPU, std::vector<indexer_t *> &indexers, std::vector<std::shared_ptr<void>> &nodes_storage) {
+    // Get the types of the nodes to be created
+    using GPUNode_t = decltype(create_GPU_Node(g, stage, traceFile, appData, inputArgs, Q_GPU, *this));
 
-        tbb::flow::make_edge(*indexers.back(), *gpu_cpu_split);
-        tbb::flow::make_edge(tbb::flow::output_port<0>(*gpu_cpu_split), *filter_gpu);
-        tbb::flow::make_edge(tbb::flow::output_port<1>(*gpu_cpu_split), *filter_cpu);
-        tbb::flow::make_edge(*filter_gpu, tbb::flow::input_port<0>(*async_join));
-        tbb::flow::make_edge(*filter_cpu, tbb::flow::input_port<1>(*async_join));
+    auto gpu_cpu_split = std::make_shared<mfn_one_input_t>(create_Splitter_Node<mfn_one_input_t>(g, stage, inputArgs, traceFile));
+    auto filter_cpu = std::make_shared<CPUNode_t>(create_CPU_Node(g, stage, appData, inputArgs, traceFile, Q_CPU));
+    auto filter_gpu = std::make_shared<GPUNode_t>(create_GPU_Node(g, stage, traceFile, appData, inputArgs, Q_GPU, *this));
+    auto async_join = std::make_shared<indexer_t>(create_Indexer_Node(g));
 
-        indexers.push_back(async_join.get());
+    tbb::flow::make_edge(source, *gpu_cpu_split);
+    tbb::flow::make_edge(tbb::flow::output_port<0>(*gpu_cpu_split), *filter_gpu);
+    tbb::flow::make_edge(tbb::flow::output_port<1>(*gpu_cpu_split), *filter_cpu);
+    tbb::flow::make_edge(*filter_gpu, tbb::flow::input_port<0>(*async_join));
+    tbb::flow::make_edge(*filter_cpu, tbb::flow::input_port<1>(*async_join));
 
-        nodes_storage.push_back(gpu_cpu_split);
-        nodes_storage.push_back(filter_cpu);
-        nodes_storage.push_back(filter_gpu);
-        nodes_storage.push_back(async_join);
+    indexers.push_back(async_join.get());
 
-        addStage<Stage + 1>(g, inputArgs, traceFile, appData, Q_GPU, Q_CPU, indexers, nodes_storage);
-    }
+    nodes_storage.push_back(gpu_cpu_split);
+    nodes_storage.push_back(filter_cpu);
+    nodes_storage.push_back(filter_gpu);
+    nodes_storage.push_back(async_join);
 }
 
-template <typename NodeType, std::size_t N>
-auto FlowGraphPipeline<NodeType, N>::create_Input_Node(tbb::flow::graph &g, ApplicationData &appData, InputArgs &inputArgs, circular_buffer &bufferItems, Tracer &traceFile) {
+template <typename NodeType>
+auto FlowGraphPipeline<NodeType>::create_Input_Node(tbb::flow::graph &g, ApplicationData &appData, InputArgs &inputArgs, ItemPool &bufferItems, Tracer &traceFile) {
     return tbb::flow::input_node<ViVidItem *>{g, [&](tbb::flow_control &fc) -> ViVidItem * {
-                                                  if (appData.id < inputArgs.numFrames || inputArgs.hasDuration()) {
+                                                  if (hasNextFrame(appData, inputArgs, bufferItems)) {
                                                       ViVidItem *item = processInputNode(appData, inputArgs, bufferItems, traceFile);
                                                       return item;
                                                   } else {
@@ -120,14 +169,14 @@ auto FlowGraphPipeline<NodeType, N>::create_Input_Node(tbb::flow::graph &g, Appl
                                               }};
 }
 
-template <typename NodeType, std::size_t N>
-template <int Stage>
-auto FlowGraphPipeline<NodeType, N>::create_Splitter_Node(tbb::flow::graph &g, InputArgs &inputArgs, Tracer &traceFile) {
-    if constexpr (Stage == 0) {
+template <typename NodeType>
+template <typename Splitter_t>
+auto FlowGraphPipeline<NodeType>::create_Splitter_Node(tbb::flow::graph &g, int stage, InputArgs &inputArgs, Tracer &traceFile) {
+    if constexpr (std::is_same_v<Splitter_t, mfn_two_inputs_t>) {
         return mfn_two_inputs_t{
-            g, tbb::flow::unlimited, [&](const std::tuple<ViVidItem *, token_t> &v, typename mfn_two_inputs_t::output_ports_type &ports) {
+            g, tbb::flow::unlimited, [&, stage](const std::tuple<ViVidItem *, token_t> &v, typename mfn_two_inputs_t::output_ports_type &ports) {
                 ViVidItem *item = std::get<0>(v);
-                Acc acc = selectPath(inputArgs, Stage, item->GPU_item, item, &traceFile);
+                Acc acc = selectPath(inputArgs, stage, item->GPU_item, item, &traceFile);
                 if (acc == Acc::GPU) {
                     std::get<0>(ports).try_put(item);
                 } else {
@@ -136,9 +185,9 @@ auto FlowGraphPipeline<NodeType, N>::create_Splitter_Node(tbb::flow::graph &g, I
             }};
     } else {
         return mfn_one_input_t{
-            g, tbb::flow::unlimited, [&](const typename indexer_t::output_type &v, typename mfn_one_input_t::output_ports_type &ports) {
+            g, tbb::flow::unlimited, [&, stage](const typename indexer_t::output_type &v, typename mfn_one_input_t::output_ports_type &ports) {
                 ViVidItem *item = tbb::flow::cast_to<ViVidItem *>(v);
-                Acc acc = selectPath(inputArgs, Stage, item->GPU_item, item, &traceFile);
+                Acc acc = selectPath(inputArgs, stage, item->GPU_item, item, &traceFile);
                 if (acc == Acc::GPU) {
                     std::get<0>(ports).try_put(item);
                 } else {
@@ -148,34 +197,33 @@ auto FlowGraphPipeline<NodeType, N>::create_Splitter_Node(tbb::flow::graph &g, I
     }
 }
 
-template <typename NodeType, std::size_t N>
-template <int Stage>
-auto FlowGraphPipeline<NodeType, N>::create_CPU_Node(tbb::flow::graph &g, ApplicationData &appData, InputArgs &inputArgs, Tracer &traceFile, sycl::queue &Q_CPU) {
-    return CPUNode_t{g, tbb::flow::unlimited, [&](ViVidItem *item) -> ViVidItem * {
-                         SyclEventInfo eventInfo;
-                         if (USE_VIVID_APP) {
-                             if constexpr (Stage == 0) {
-                                 eventInfo = Details::cosinefilter<Acc::CPU>(item, traceFile, appData, inputArgs, Q_CPU);
-                             } else if constexpr (Stage == 1) {
-                                 eventInfo = Details::blockhistogram<Acc::CPU>(item, traceFile, appData, inputArgs, Q_CPU);
-                             } else if constexpr (Stage == 2) {
-                                 eventInfo = Details::pwdist<Acc::CPU>(item, traceFile, appData, inputArgs, Q_CPU);
-                             }
-                         } else {
-                             eventInfo = workloadsimulator(Acc::CPU, item, traceFile, appData, inputArgs, Stage);
-                         }
-                         reduceCountersAfterProcessing(inputArgs, appData, Acc::CPU, Stage);
+template <typename NodeType>
+auto FlowGraphPipeline<NodeType>::create_CPU_Node(tbb::flow::graph &g, int stage, ApplicationData &appData, InputArgs &inputArgs, Tracer &traceFile, sycl::queue &Q_CPU) {
+    return CPUNode_t{g, tbb::flow::unlimited, [&, stage](ViVidItem *item) -> ViVidItem * {
+                         SyclEventInfo eventInfo = runStage(stage, Acc::CPU, item, traceFile, appData, inputArgs, runtime.stageBatcher, Q_CPU);
+                         reduceCountersAfterProcessing(inputArgs, appData, Acc::CPU, stage);
                          return item;
                      }};
 }
 
-template <typename NodeType, std::size_t N>
-auto FlowGraphPipeline<NodeType, N>::create_Indexer_Node(tbb::flow::graph &g) {
+template <typename NodeType>
+auto FlowGraphPipeline<NodeType>::create_Indexer_Node(tbb::flow::graph &g) {
     return indexer_t{g};
 }
 
-template <typename NodeType, std::size_t N>
-auto FlowGraphPipeline<NodeType, N>::create_Output_Node(tbb::flow::graph &g, tbb::flow::buffer_node<int> &token_buffer, ApplicationData &appData, InputArgs &inputArgs, circular_buffer &bufferItems, Tracer &traceFile, EnergyPCM *energyPCM) {
+template <typename NodeType>
+auto FlowGraphPipeline<NodeType>::create_Join_Node(tbb::flow::graph &g, int branches) {
+    return mfn_join_t{g, tbb::flow::unlimited, [branches](const typename indexer_t::output_type &v, typename mfn_join_t::output_ports_type &ports) {
+                          ViVidItem *item = tbb::flow::cast_to<ViVidItem *>(v);
+                          if (item->branchesDone.fetch_add(1) + 1 == branches) {
+                              item->branchesDone = 0; // Ready for the branches of the next level
+                              std::get<0>(ports).try_put(item);
+                          }
+                      }};
+}
+
+template <typename NodeType>
+auto FlowGraphPipeline<NodeType>::create_Output_Node(tbb::flow::graph &g, tbb::flow::buffer_node<int> &token_buffer, ApplicationData &appData, InputArgs &inputArgs, ItemPool &bufferItems, Tracer &traceFile, EnergyPCM *energyPCM) {
     return tbb::flow::function_node<indexer_t::output_type, token_t>{g, 1, [&](const auto &v) -> token_t {
                                                                          ViVidItem *item = tbb::flow::cast_to<ViVidItem *>(v);
                                                                          // Save the previous number of tokens
@@ -201,85 +249,41 @@ auto FlowGraphPipeline<NodeType, N>::create_Output_Node(tbb::flow::graph &g, tbb
 
                                                                          // Check debug, trace and recycle the item
                                                                          debugAndTrace(item, appData, traceFile);
-                                                                         recycleItem(bufferItems, item);
+                                                                         processOutputNode(inputArgs, bufferItems, item);
 
                                                                          return (item->GPU_item ? 0 : 1);
                                                                      }};
 }
 
-template <typename NodeType, std::size_t N>
-template <typename GPU_NodeType, int Stage>
-auto FlowGraphPipeline<NodeType, N>::create_GPU_Node(tbb::flow::graph &g, Tracer &traceFile, ApplicationData &appData, InputArgs &inputArgs, sycl::queue &Q_GPU, PipelineInterface &pipeline) {
+template <typename NodeType>
+auto FlowGraphPipeline<NodeType>::create_GPU_Node(tbb::flow::graph &g, int stage, Tracer &traceFile, ApplicationData &appData, InputArgs &inputArgs, sycl::queue &Q_GPU, PipelineInterface &pipeline) {
     if constexpr (std::is_same_v<NodeType, AsyncNode>) {
-        return create_GPU_Node_with_AN<Stage>(g, traceFile, appData, inputArgs, Q_GPU, pipeline);
+        return create_GPU_Node_with_AN(g, stage, traceFile, appData, inputArgs, Q_GPU, pipeline);
     } else if constexpr (std::is_same_v<NodeType, FunctionalNode>) {
-        return create_GPU_Node_with_FN<Stage>(g, traceFile, appData, inputArgs, Q_GPU, pipeline);
+        return create_GPU_Node_with_FN(g, stage, traceFile, appData, inputArgs, Q_GPU, pipeline);
     }
 }
 
-template <typename NodeType, std::size_t N>
-template <int Stage>
-auto FlowGraphPipeline<NodeType, N>::create_GPU_Node_with_AN(tbb::flow::graph &g, Tracer &traceFile, ApplicationData &appData, InputArgs &inputArgs, sycl::queue &Q_GPU, PipelineInterface &pipeline) {
-    if constexpr (USE_VIVID_APP) {
-        if constexpr (Stage == 0) {
-            return FGPU_t{g, tbb::flow::unlimited, [&](ViVidItem *item, gateway_type &gateway) {
-                              FGPU([](ViVidItem *item, Tracer &traceFile, ApplicationData &appData, InputArgs &inputArgs, sycl::queue &Q_GPU) {
-                                  return Details::cosinefilter<Acc::GPU>(item, traceFile, appData, inputArgs, Q_GPU);
-                              },
-                                   0)
-                                  .submit(gateway, item, traceFile, appData, inputArgs, Q_GPU, pipeline);
-                          }};
-        } else if constexpr (Stage == 1) {
-            return FGPU_t{g, tbb::flow::unlimited, [&](ViVidItem *item, gateway_type &gateway) {
-                              FGPU([](ViVidItem *item, Tracer &traceFile, ApplicationData &appData, InputArgs &inputArgs, sycl::queue &Q_GPU) {
-                                  return Details::blockhistogram<Acc::GPU>(item, traceFile, appData, inputArgs, Q_GPU);
-                              },
-                                   1)
-                                  .submit(gateway, item, traceFile, appData, inputArgs, Q_GPU, pipeline);
-                          }};
-        } else if constexpr (Stage == 2) {
-            return FGPU_t{g, tbb::flow::unlimited, [&](ViVidItem *item, gateway_type &gateway) {
-                              FGPU([](ViVidItem *item, Tracer &traceFile, ApplicationData &appData, InputArgs &inputArgs, sycl::queue &Q_GPU) {
-                                  return Details::pwdist<Acc::GPU>(item, traceFile, appData, inputArgs, Q_GPU);
-                              },
-                                   2)
-                                  .submit(gateway, item, traceFile, appData, inputArgs, Q_GPU, pipeline);
-                          }};
-        }
-    } else {
-        return FGPU_t{g, tbb::flow::unlimited, [&](ViVidItem *item, gateway_type &gateway) {
-                          FGPU([=](ViVidItem *item, Tracer &traceFile, ApplicationData &appData, InputArgs &inputArgs, sycl::queue &Q_GPU) {
-                              return workloadsimulator(Acc::GPU, item, traceFile, appData, inputArgs, Stage);
-                          },
-                               Stage)
-                              .submit(gateway, item, traceFile, appData, inputArgs, Q_GPU, pipeline);
-                      }};
-    }
+template <typename NodeType>
+auto FlowGraphPipeline<NodeType>::create_GPU_Node_with_AN(tbb::flow::graph &g, int stage, Tracer &traceFile, ApplicationData &appData, InputArgs &inputArgs, sycl::queue &Q_GPU, PipelineInterface &pipeline) {
+    // One FGPU object per node (not per item): the per-item cost is the submission and the hand-over to the completion thread
+    auto fgpu = std::make_shared<FGPU>(stage, traceFile, appData, inputArgs, Q_GPU, runtime.stageBatcher, pipeline, gpuCompletion_.get());
+    return FGPU_t{g, tbb::flow::unlimited, [fgpu](ViVidItem *item, gateway_type &gateway) {
+                      fgpu->submit(gateway, item);
+                  }};
 }
 
-template <typename NodeType, std::size_t N>
-template <int Stage>
-auto FlowGraphPipeline<NodeType, N>::create_GPU_Node_with_FN(tbb::flow::graph &g, Tracer &traceFile, ApplicationData &appData, InputArgs &inputArgs, sycl::queue &Q_GPU, PipelineInterface &pipeline) {
-    return CPUNode_t{g, tbb::flow::unlimited, [&](ViVidItem *item) -> ViVidItem * {
-                         SyclEventInfo eventInfo;
-                         if constexpr (USE_VIVID_APP) {
-                             if constexpr (Stage == 0) {
-                                 eventInfo = Details::cosinefilter<Acc::GPU>(item, traceFile, appData, inputArgs, Q_GPU);
-                             } else if constexpr (Stage == 1) {
-                                 eventInfo = Details::blockhistogram<Acc::GPU>(item, traceFile, appData, inputArgs, Q_GPU);
-                             } else if constexpr (Stage == 2) {
-                                 eventInfo = Details::pwdist<Acc::GPU>(item, traceFile, appData, inputArgs, Q_GPU);
-                             }
-                         } else {
-                             eventInfo = workloadsimulator(Acc::GPU, item, traceFile, appData, inputArgs, Stage);
-                         }
-                         reduceCountersAfterProcessing(inputArgs, appData, Acc::GPU, Stage);
+template <typename NodeType>
+auto FlowGraphPipeline<NodeType>::create_GPU_Node_with_FN(tbb::flow::graph &g, int stage, Tracer &traceFile, ApplicationData &appData, InputArgs &inputArgs, sycl::queue &Q_GPU, PipelineInterface &pipeline) {
+    return CPUNode_t{g, tbb::flow::unlimited, [&, stage](ViVidItem *item) -> ViVidItem * {
+                         SyclEventInfo eventInfo = runStage(stage, Acc::GPU, item, traceFile, appData, inputArgs, runtime.stageBatcher, Q_GPU);
+                         reduceCountersAfterProcessing(inputArgs, appData, Acc::GPU, stage);
                          return item;
                      }};
 }
 
-template <typename NodeType, std::size_t N>
-void FlowGraphPipeline<NodeType, N>::initTokenBuffer(tbb::flow::buffer_node<int> &token_buffer, InputArgs &inputArgs) {
+template <typename NodeType>
+void FlowGraphPipeline<NodeType>::initTokenBuffer(tbb::flow::buffer_node<int> &token_buffer, InputArgs &inputArgs) {
     if constexpr (VERBOSE_ENABLED) {
         std::cout << "Filling the token_buffer with " << inputArgs.inFlightFrames << " tokens" << std::endl;
     }
@@ -289,5 +293,5 @@ void FlowGraphPipeline<NodeType, N>::initTokenBuffer(tbb::flow::buffer_node<int>
 }
 
 // Explicit template instantiation
-template class FlowGraphPipeline<FunctionalNode, NUM_STAGES>;
-template class FlowGraphPipeline<AsyncNode, NUM_STAGES>;
\ No newline at end of file
+template class FlowGraphPipeline<FunctionalNode>;
+template class FlowGraphPipeline<AsyncNode>;
\ No newline at end of file
@@ -2,22 +2,20 @@
 #include "GlobalParameters.hpp"
 #include "Timer.hpp"
 #include <oneapi/tbb.h>
-#include <unordered_map>
 
-template <std::size_t N>
 template <typename FilterType>
-void ParallelPipeline<N>::addStage(FilterType &filter, ApplicationData &appData, InputArgs &inputArgs, Tracer &traceFile, sycl::queue &Q_GPU, sycl::queue &Q_CPU) {
-    for (std::size_t stage = 0; stage < N; ++stage) {
+void ParallelPipeline::addStage(FilterType &filter, ApplicationData &appData, InputArgs &inputArgs, Tracer &traceFile, sycl::queue &Q_GPU, sycl::queue &Q_CPU) {
+    for (std::size_t stage = 0; stage < inputArgs.numStages(); ++stage) {
         filter = filter & oneapi::tbb::make_filter<ViVidItem *, ViVidItem *>(oneapi::tbb::filter_mode::parallel,
                                                                              [&, stage](ViVidItem *item) -> ViVidItem * {
                                                                                  tbb::tick_count filter_start = tbb::tick_count::now();
 
-                                                                                 logProcessing("Start: Processing item " + std::to_string(item->item_id) + " in stage " + std::to_string(stage));
+                                                                                 logProcessing("Start: Processing item ", item->item_id, " in stage ", stage);
 
                                                                                  Acc acc = selectPathWrapper(inputArgs, stage, item->GPU_item, item, &traceFile);
                                                                                  SyclEventInfo eventInfo = processStage(stage, acc, item, traceFile, appData, inputArgs, Q_GPU, Q_CPU);
 
-                                                                                 logProcessing("End: Processing item " + std::to_string(item->item_id) + " in stage " + std::to_string(stage) + " took " + std::to_string((tbb::tick_count::now() - filter_start).seconds()) + " seconds");
+                                                                                 logProcessing("End: Processing item ", item->item_id, " in stage ", stage, " took ", (tbb::tick_count::now() - filter_start).seconds(), " seconds");
 
                                                                                  reduceCountersAfterProcessing(inputArgs, appData, acc, stage);
 
@@ -26,42 +24,27 @@ void ParallelPipeline<N>::addStage(FilterType &filter, ApplicationData &appData,
     }
 }
 
-template <std::size_t N>
-SyclEventInfo ParallelPipeline<N>::processStage(std::size_t stage, Acc acc, ViVidItem *item, Tracer &traceFile, ApplicationData &appData, InputArgs &inputArgs, sycl::queue &Q_GPU, sycl::queue &Q_CPU) {
-    using StageFunction = std::function<SyclEventInfo(Acc, ViVidItem *, Tracer &, ApplicationData &, InputArgs &, sycl::queue &, std::vector<sycl::event> *)>;
-    static const std::unordered_map<std::size_t, StageFunction> stageFunctions = {
-        {0, cosinefilter},
-        {1, blockhistogram},
-        {2, pwdist}};
-
-    if constexpr (USE_VIVID_APP) {
-        if (stageFunctions.find(stage) != stageFunctions.end()) {
-            return stageFunctions.at(stage)(acc, item, traceFile, appData, inputArgs, (acc == Acc::GPU) ? Q_GPU : Q_CPU, nullptr);
-        }
-    } else {
-        return workloadsimulator(acc, item, traceFile, appData, inputArgs, stage);
+SyclEventInfo ParallelPipeline::processStage(std::size_t stage, Acc acc, ViVidItem *item, Tracer &traceFile, ApplicationData &appData, InputArgs &inputArgs, sycl::queue &Q_GPU, sycl::queue &Q_CPU) {
+    if (acc != Acc::GPU || !gpuCompletion || !inputArgs.stages[stage]->enqueues) {
+        return runStage(stage, acc, item, traceFile, appData, inputArgs, runtime.stageBatcher, (acc == Acc::GPU) ? Q_GPU : Q_CPU, nullptr);
     }
-    return {};
-}
 
-template <std::size_t N>
-void ParallelPipeline<N>::logProcessing(const std::string &message) {
-    if constexpr (LOG_ENABLED) {
-        std::clog << message << " with thread " << std::this_thread::get_id() << ".\n";
-    }
+    // The kernel only submits its work; the task is suspended until the GPU has run it and the worker takes other items
+    SyclEventInfo eventInfo = runStage(stage, acc, item, traceFile, appData, inputArgs, runtime.stageBatcher, Q_GPU, &noEvents);
+    gpuCompletion->await(eventInfo.event);
+    record_sycl_time(item, eventInfo.event, static_cast<int>(stage), "GPU_S");
+    return SyclEventInfo(eventInfo.event, item->execution_time, Acc::GPU);
 }
 
-template <std::size_t N>
-Acc ParallelPipeline<N>::selectPathWrapper(InputArgs &inputArgs, std::size_t stage, bool GPU_item, ViVidItem *item, Tracer *traceFile) {
+Acc ParallelPipeline::selectPathWrapper(InputArgs &inputArgs, std::size_t stage, bool GPU_item, ViVidItem *item, Tracer *traceFile) {
     Acc acc = selectPath(inputArgs, stage, GPU_item, item, traceFile);
-    logProcessing("Selected path for item " + std::to_string(item->item_id) + " in stage " + std::to_string(stage) + ": " + (acc == Acc::GPU ? "GPU" : "CPU"));
+    logProcessing("Selected path for item ", item->item_id, " in stage ", stage, ": ", (acc == Acc::GPU ? "GPU" : "CPU"));
     return acc;
 }
 
-template <std::size_t N>
-void ParallelPipeline<N>::executePipeline(ApplicationData &appData, InputArgs &inputArgs, circular_buffer &bufferItems, Tracer &traceFile, sycl::queue &Q_GPU, sycl::queue &Q_CPU, EnergyPCM *energyPCM) {
+void ParallelPipeline::executePipeline(ApplicationData &appData, InputArgs &inputArgs, ItemPool &bufferItems, Tracer &traceFile, sycl::queue &Q_GPU, sycl::queue &Q_CPU, EnergyPCM *energyPCM) {
     if constexpr (VERBOSE_ENABLED) {
-        std::cout << "Running PARALLEL_PIPELINE version with " << N << " stages..." << std::endl;
+        std::cout << "Running PARALLEL_PIPELINE version with " << inputArgs.numStages() << " stages..." << std::endl;
     }
 
     if (inputArgs.pipelineName != PipelineType::SYCLEvents) {
@@ -72,6 +55,11 @@ void ParallelPipeline<N>::executePipeline(ApplicationData &appData, InputArgs &i
         inputArgs.resourcesManager->startMonitoring();
     }
 
+    // The GPU stages release their worker while the device runs them (see GPUCompletion.hpp)
+    if (inputArgs.asyncGPUStages()) {
+        gpuCompletion = std::make_unique<GPUCompletion>();
+    }
+
     appData.pipeline_start = tbb::tick_count::now();
 
     // We ensure the executions always last the same, regardless of whether the automatic mode is enabled or not
@@ -83,9 +71,9 @@ void ParallelPipeline<N>::executePipeline(ApplicationData &appData, InputArgs &i
 
     auto pipeline = oneapi::tbb::make_filter<void, ViVidItem *>(oneapi::tbb::filter_mode::serial_in_order,
                                                                 [&](oneapi::tbb::flow_control &fc) -> ViVidItem * {
-                                                                    if (appData.id < inputArgs.numFrames || inputArgs.hasDuration()) {
+                                                                    if (hasNextFrame(appData, inputArgs, bufferItems)) {
                                                                         ViVidItem *item = processInputNode(appData, inputArgs, bufferItems, traceFile);
-                                                                        logProcessing("Processing item " + std::to_string(appData.id) + " in the input node");
+                                                                        logProcessing("Processing item ", item->item_id, " in the input node");
                                                                         return item;
                                                                     } else {
                                                                         fc.stop();
@@ -115,15 +103,20 @@ void ParallelPipeline<N>::executePipeline(ApplicationData &appData, InputArgs &i
 
                                                                         // Check debug, trace and recycle the item
                                                                         debugAndTrace(item, appData, traceFile);
-                                                                        recycleItem(bufferItems, item);
+                                                                        processOutputNode(inputArgs, bufferItems, item);
                                                                     });
 
     oneapi::tbb::parallel_pipeline(inputArgs.inFlightFrames, pipeline & outputFilter);
 
+    if (gpuCompletion) {
+        if constexpr (VERBOSE_ENABLED) {
+            std::cout << " GPU stages that released their worker: " << gpuCompletion->getCompleted() << std::endl;
+        }
+        gpuCompletion.reset();
+    }
+
     if constexpr (LOG_ENABLED) {
         inputArgs.resourcesManager->stopMonitoring();
     }
     appData.pipeline_end = tbb::tick_count::now();
 }
-
-template class ParallelPipeline<NUM_STAGES>;
\ No newline at end of file
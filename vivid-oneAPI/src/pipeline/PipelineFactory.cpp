@@ -4,15 +4,17 @@
 std::unique_ptr<PipelineInterface> PipelineFactory::createPipeline(PipelineType type) {
     switch (type) {
     case PipelineType::ParallelPipeline:
-        return std::make_unique<ParallelPipeline<NUM_STAGES>>();
+        return std::make_unique<ParallelPipeline>();
     case PipelineType::FlowGraphFunctionalNode:
-        return std::make_unique<FlowGraphPipeline<FunctionalNode, NUM_STAGES>>();
+        return std::make_unique<FlowGraphPipeline<FunctionalNode>>();
     case PipelineType::FlowGraphAsyncNode:
-        return std::make_unique<FlowGraphPipeline<AsyncNode, NUM_STAGES>>();
+        return std::make_unique<FlowGraphPipeline<AsyncNode>>();
     case PipelineType::SYCLEvents:
-        return std::make_unique<SYCLEventsPipeline<NUM_STAGES>>();
+        return std::make_unique<SYCLEventsPipeline>();
     case PipelineType::Taskflow:
-        return std::make_unique<TaskflowPipeline<NUM_STAGES>>();
+        return std::make_unique<TaskflowPipeline>();
+    case PipelineType::Coroutine:
+        return std::make_unique<CoroutinePipeline>();
     case PipelineType::Serie:
         return std::make_unique<SeriePipeline>();
     default:
@@ -31,6 +33,8 @@ PipelineType PipelineFactory::getPipelineType(const std::string &pipelineSelecte
         return PipelineType::SYCLEvents;
     } else if (pipelineSelected == "taskflow") {
         return PipelineType::Taskflow;
+    } else if (pipelineSelected == "coro") {
+        return PipelineType::Coroutine;
     } else if (pipelineSelected == "serie") {
         return PipelineType::Serie;
     } else {
@@ -50,6 +54,8 @@ std::string PipelineFactory::getPipelineTypeString(PipelineType type) {
         return "SYCL Events";
     case PipelineType::Taskflow:
         return "Taskflow";
+    case PipelineType::Coroutine:
+        return "Coroutines";
     case PipelineType::Serie:
         return "Serie";
     default:
@@ -69,6 +75,8 @@ std::string PipelineFactory::getPipelineTypeAsShortString(PipelineType type) {
         return "syclevents";
     case PipelineType::Taskflow:
         return "taskflow";
+    case PipelineType::Coroutine:
+        return "coro";
     case PipelineType::Serie:
         return "serie";
     default:
@@ -1,16 +1,26 @@
 #include "PipelineInterface.hpp"
+#include "AllocCounter.hpp"
 #include "Comparer.hpp"
 #include "Queue.hpp"
 #include "ResourcesManager.hpp"
 #include <functional>
 #include <iostream>
 #include <memory>
+#include <mutex>
 
 Acc PipelineInterface::selectPath(InputArgs &inputArgs, int index, bool &isGPUFrame, ViVidItem *item, Tracer *tracer) {
     Acc acc;
+    // The branches of --stages may select their path for the same item at the same time
+    auto traceWait = [&](void (Tracer::*event)(ViVidItem *)) {
+        std::unique_lock<std::mutex> lock(item->branchMutex, std::defer_lock);
+        if (index >= 0 && inputArgs.isBranch(index)) {
+            lock.lock();
+        }
+        (tracer->*event)(item);
+    };
     if constexpr (TRACE_ENABLED) {
         if (item != nullptr && tracer != nullptr)
-            tracer->wait_start(item);
+            traceWait(&Tracer::wait_start);
     }
     while (true) {
         if (inputArgs.selectedPath == PathSelection::Decoupled) {
@@ -27,19 +37,19 @@ Acc PipelineInterface::selectPath(InputArgs &inputArgs, int index, bool &isGPUFr
     }
     if constexpr (TRACE_ENABLED) {
         if (item != nullptr && tracer != nullptr)
-            tracer->wait_end(item);
+            traceWait(&Tracer::wait_end);
     }
     return acc;
 }
 
-Acc PipelineInterface::selectPathCoupled(InputArgs &inputArgs, int index, bool &isGPUFrame) {
-    auto [status, acc] = inputArgs.resourcesManager->acquireForStage(index, inputArgs.stageExecutionState[index], inputArgs.executionDevicePriority[index]);
+Acc PipelineInterface::selectPathCoupled(InputArgs &inputArgs, int index, bool &isGPUFrame, bool allowQueue) {
+    auto [status, acc] = inputArgs.resourcesManager->acquireForStage(index, inputArgs.stageExecutionState[index], inputArgs.executionDevicePriority[index], allowQueue);
     return acc;
 }
 
-Acc PipelineInterface::selectPathDecoupled(InputArgs &inputArgs, int index, bool &isGPUFrame) {
+Acc PipelineInterface::selectPathDecoupled(InputArgs &inputArgs, int index, bool &isGPUFrame, bool allowQueue) {
     if (index == -1) {
-        auto [status, acc] = inputArgs.resourcesManager->acquireForStage(0, inputArgs.stageExecutionState[0], inputArgs.executionDevicePriority[0]);
+        auto [status, acc] = inputArgs.resourcesManager->acquireForStage(0, inputArgs.stageExecutionState[0], inputArgs.executionDevicePriority[0], allowQueue);
         if (acc == Acc::GPU) {
             isGPUFrame = true;
         }
@@ -49,21 +59,23 @@ Acc PipelineInterface::selectPathDecoupled(InputArgs &inputArgs, int index, bool
 }
 
 void PipelineInterface::reduceCountersAfterProcessing(const InputArgs &inputArgs, const ApplicationData &appData, Acc accelerator, int index, sycl::queue *Q, sycl::event *event, std::vector<sycl::event> *vectorEvents) {
-    auto executeNotifyCoreAvailable = [&]() {
-        if (inputArgs.selectedPath == PathSelection::Decoupled) {
+    ResourcesManager *resourcesManager = inputArgs.resourcesManager.get();
+    PathSelection selectedPath = inputArgs.selectedPath;
+    auto executeNotifyCoreAvailable = [=]() {
+        if (selectedPath == PathSelection::Decoupled) {
             if (index == -1) {
-                inputArgs.resourcesManager->releaseForStage(0, accelerator);
+                resourcesManager->releaseForStage(0, accelerator);
             }
         } else {
-            inputArgs.resourcesManager->releaseForStage(index, accelerator);
+            resourcesManager->releaseForStage(index, accelerator);
         }
     };
 
-    // If SYCL queue and event are provided, submit a task.
+    // If SYCL queue and event are provided, release the core in a host task once the stage has run
     if (Q != nullptr && event != nullptr) {
-        auto m_event = Q->submit([&](sycl::handler &cgh) {
+        Q->submit([&](sycl::handler &cgh) {
             cgh.depends_on(*event);
-            executeNotifyCoreAvailable();
+            cgh.host_task(executeNotifyCoreAvailable);
         });
     } else {
         // Directly execute the logic if no SYCL queue and event are provided.
@@ -71,23 +83,40 @@ void PipelineInterface::reduceCountersAfterProcessing(const InputArgs &inputArgs
     }
 }
 
-ViVidItem *PipelineInterface::processInputNode(ApplicationData &appData, InputArgs &inputArgs, circular_buffer &bufferItems, Tracer &traceFile) {
+bool PipelineInterface::hasNextFrame(ApplicationData &appData, InputArgs &inputArgs, ItemPool &bufferItems) {
+    if (!(appData.id < inputArgs.numFrames || inputArgs.hasDuration())) {
+        return false;
+    }
+    // A pushed input ends when the application closes it, not after a number of frames
+    return runtime.reserveFrame();
+}
+
+ViVidItem *PipelineInterface::processInputNode(ApplicationData &appData, InputArgs &inputArgs, ItemPool &bufferItems, Tracer &traceFile) {
     if constexpr (LOG_ENABLED) {
         std::clog << "Processing input node in stage with thread " << std::this_thread::get_id() << ".\n";
     }
 
-    // Incrementar el ID de appData y obtener el siguiente item
-    appData.id++;
-    ViVidItem *item = bufferItems.get();
-    item->item_id = appData.id;
+    // Obtener el siguiente item (bloquea si no hay items libres) e incrementar el ID de appData
+    ViVidItem *item = bufferItems.acquire();
+    item->item_id = ++appData.id;
+
+    // Frame, regions of interest, tiles to recompute, queues and camera release of the item
+    runtime.admit(item);
+
+    // Once every item of the pool has been used, the pipeline is in steady state
+    if constexpr (ALLOCCOUNT_ENABLED) {
+        if (item->item_id == 2 * bufferItems.capacity()) {
+            AllocCounter::startSteadyState(item->item_id);
+        }
+    }
 
     // Rastrear el inicio del frame si TRACE_ENABLED está habilitado
     if constexpr (TRACE_ENABLED) {
         traceFile.frame_start(item);
     }
 
-    // Ejecutar selectPathDecoupled si es necesario
-    if (inputArgs.selectedPath == PathSelection::Decoupled) {
+    // Ejecutar selectPathDecoupled si es necesario (the coroutine backend awaits the admission of the frame itself)
+    if (inputArgs.selectedPath == PathSelection::Decoupled && inputArgs.pipelineName != PipelineType::Coroutine) {
         selectPathDecoupled(inputArgs, -1, item->GPU_item);
     }
 
@@ -134,9 +163,9 @@ void PipelineInterface::handleTimeMeasurements(ViVidItem *item, ApplicationData
 
     if (shouldMeasureTime) {
         if (inputArgs.pipelineName == PipelineType::SYCLEvents) {
-            timeMeasurements(appData, item, accelerator);
+            timeMeasurements(appData, inputArgs, item, accelerator);
         } else {
-            timeMeasurements(appData, item);
+            timeMeasurements(appData, inputArgs, item);
         }
     }
 }
@@ -146,7 +175,7 @@ bool PipelineInterface::isAutoModeEnabled(ApplicationData &appData, ViVidItem *i
         // Comprobamos si inputArgs.timeSampling es igual a 0
         if (appData.autoMode && inputArgs.timeSampling.count() == 0) {
             // Asegurarnos que al menos se hayan medido frames en ambos dispositivos para todas las etapas
-            for (int i = 0; i < NUM_STAGES; i++) {
+            for (size_t i = 0; i < inputArgs.numStages(); i++) {
                 if (appData.time_CPU_S[i] < 1 || appData.time_GPU_S[i] < 1) {
                     return false;
                 }
@@ -171,37 +200,46 @@ void PipelineInterface::optimizePipeline(ApplicationData &appData, InputArgs &in
         std::cout << "Phase 0: Get the mean time per stage for each accelerator" << std::endl;
     }
 
-    std::vector<double> meanTimePerStage_CPU(NUM_STAGES, 0.0);
-    std::vector<double> meanTimePerStage_GPU(NUM_STAGES, 0.0);
+    const size_t numStages = inputArgs.numStages();
+    std::vector<double> meanTimePerStage_CPU(numStages, 0.0);
+    std::vector<double> meanTimePerStage_GPU(numStages, 0.0);
     // Imprimir el número de filtros por etapa que hay en CPU y GPU
-    std::cout << "Number of filters in CPU: [" << appData.numFiltersCPU[0] << " " << appData.numFiltersCPU[1] << " " << appData.numFiltersCPU[2] << "]" << std::endl;
-    std::cout << "Number of filters in GPU: [" << appData.numFiltersGPU[0] << " " << appData.numFiltersGPU[1] << " " << appData.numFiltersGPU[2] << "]" << std::endl;
-    for (int i = 0; i < NUM_STAGES; i++) {
+    auto printStages = [numStages](const std::string &label, const std::string &prefix, const std::string &separator, const std::string &suffix, auto value) {
+        std::cout << label << prefix;
+        for (size_t i = 0; i < numStages; i++) {
+            std::cout << (i > 0 ? separator : "") << value(i);
+        }
+        std::cout << suffix << std::endl;
+    };
+    printStages("Number of filters in CPU: ", "[", " ", "]", [&](size_t i) { return appData.numFiltersCPU[i].load(); });
+    printStages("Number of filters in GPU: ", "[", " ", "]", [&](size_t i) { return appData.numFiltersGPU[i].load(); });
+    for (size_t i = 0; i < numStages; i++) {
         meanTimePerStage_CPU[i] = appData.time_CPU_S[i] / appData.numFiltersCPU[i];
         meanTimePerStage_GPU[i] = appData.time_GPU_S[i] / appData.numFiltersGPU[i];
     }
 
     double throughput_serie = 0.49;
 
-    std::vector<double> thC(NUM_STAGES, 0.0);
-    std::vector<double> thG(NUM_STAGES, 0.0);
+    std::vector<double> thC(numStages, 0.0);
+    std::vector<double> thG(numStages, 0.0);
 
     // Loop for thC and thG
     auto threadsCPU = SYCL_ENABLED ? 1 : inputArgs.nThreads;
-    for (int i = 0; i < NUM_STAGES; i++) {
-        thC[i] = (1E3 * threadsCPU) / meanTimePerStage_CPU[i];
-        thG[i] = 1E3 / meanTimePerStage_GPU[i];
+    for (size_t i = 0; i < numStages; i++) {
+        // The mean times are those of whole frames; with --roi the stages only process part of each frame
+        thC[i] = (1E3 * threadsCPU) / (meanTimePerStage_CPU[i] * appData.activeFraction);
+        thG[i] = 1E3 / (meanTimePerStage_GPU[i] * appData.activeFraction);
     }
 
     if constexpr (VERBOSE_ENABLED) {
         std::cout << " INFO ABOUT THE SYSTEM" << std::endl;
-        std::cout << "\t· time_CPU: ['" << meanTimePerStage_CPU[0] << "' '" << meanTimePerStage_CPU[1] << "' '" << meanTimePerStage_CPU[2] << "']" << std::endl;
-        std::cout << "\t· time_GPU: ['" << meanTimePerStage_GPU[0] << "' '" << meanTimePerStage_GPU[1] << "' '" << meanTimePerStage_GPU[2] << "']" << std::endl;
-        std::cout << "\t· thC=[" << thC[0] << " " << thC[1] << " " << thC[2] << "]" << std::endl;
-        std::cout << "\t· thG=[" << thG[0] << " " << thG[1] << " " << thG[2] << "]" << std::endl;
+        printStages("\t· time_CPU: ", "['", "' '", "']", [&](size_t i) { return meanTimePerStage_CPU[i]; });
+        printStages("\t· time_GPU: ", "['", "' '", "']", [&](size_t i) { return meanTimePerStage_GPU[i]; });
+        printStages("\t· thC=", "[", " ", "]", [&](size_t i) { return thC[i]; });
+        printStages("\t· thG=", "[", " ", "]", [&](size_t i) { return thG[i]; });
     }
 
-    auto results = PipelineOptimizer::findOptimalConfiguration(NUM_STAGES, thC, thG, threadsCPU);
+    auto results = PipelineOptimizer::findOptimalConfiguration(static_cast<int>(numStages), thC, thG, threadsCPU, false, inputArgs.maxTokens);
 
     for (size_t idx = 0; idx < results.size(); ++idx) {
         const auto &result = results[idx];
@@ -268,7 +306,10 @@ void PipelineInterface::optimizePipeline(ApplicationData &appData, InputArgs &in
     }
 
     if (best_result.confOptS == -1) {
-        std::unordered_map<int, int> stageMap{{0, 0}, {1, 0}, {2, 0}};
+        std::unordered_map<int, int> stageMap;
+        for (size_t i = 0; i < numStages; i++) {
+            stageMap[static_cast<int>(i)] = 0;
+        }
         deviceCPU->updateStageMapping(stageMap);
         deviceGPU->updateStageMapping(stageMap);
     }
@@ -324,7 +365,7 @@ void PipelineInterface::optimizePipeline(ApplicationData &appData, InputArgs &in
     std::cout << "Configuración del CPU:\n";
     std::cout << "Total de Cores: " << deviceCPU->getTotalCores() << "\n";
     std::cout << "Cores en uso: " << deviceCPU->getUsedCores() << "\n";
-    for (size_t i = 0; i < NUM_STAGES; ++i) {
+    for (size_t i = 0; i < numStages; ++i) {
         const auto &stage = deviceCPU->getStage(i);
         std::cout << "  Etapa " << i << ":\n";
         std::cout << "    Máximo de Cores: " << stage->getTotalCores() << "\n";
@@ -335,7 +376,7 @@ void PipelineInterface::optimizePipeline(ApplicationData &appData, InputArgs &in
     std::cout << "Configuración del GPU:\n";
     std::cout << "Total de Cores: " << deviceGPU->getTotalCores() << "\n";
     std::cout << "Cores en uso: " << deviceGPU->getUsedCores() << "\n";
-    for (size_t i = 0; i < NUM_STAGES; ++i) {
+    for (size_t i = 0; i < numStages; ++i) {
         const auto &stage = deviceGPU->getStage(i);
         std::cout << "  Etapa " << i << ":\n";
         std::cout << "    Máximo de Cores: " << stage->getTotalCores() << "\n";
@@ -343,10 +384,10 @@ void PipelineInterface::optimizePipeline(ApplicationData &appData, InputArgs &in
     }
     std::cout << "\n";
 
-    // Si confOptP es '111' se ejecuta en modo decoupled, todas las etapas son CPU_GPU
-    if (best_result.confOptP == "111") {
+    // Si confOptP es '1...1' se ejecuta en modo decoupled, todas las etapas son CPU_GPU
+    if (best_result.confOptP == std::string(numStages, '1')) {
         inputArgs.selectedPath = PathSelection::Decoupled;
-        for (int i = 0; i < NUM_STAGES; i++) {
+        for (size_t i = 0; i < numStages; i++) {
             inputArgs.stageExecutionState[i] = StageState::CPU_GPU;
         }
     } else {
@@ -354,22 +395,22 @@ void PipelineInterface::optimizePipeline(ApplicationData &appData, InputArgs &in
         inputArgs.selectedPath = PathSelection::Coupled;
         // Ajustar los estados de ejecución de las etapas según la mejor configuración
         if (best_result.confOptS == -1) {
-            for (int i = 0; i < NUM_STAGES; i++) {
+            for (size_t i = 0; i < numStages; i++) {
                 inputArgs.stageExecutionState[i] = (best_result.confOptP[i] == '1') ? StageState::GPU : StageState::CPU;
             }
         } else if (best_result.confOptS == 1) {
-            for (int i = 0; i < NUM_STAGES; i++) {
+            for (size_t i = 0; i < numStages; i++) {
                 inputArgs.stageExecutionState[i] = (best_result.confOptP[i] == '1') ? StageState::GPU : StageState::CPU_GPU;
             }
         } else if (best_result.confOptS == 0) {
-            for (int i = 0; i < NUM_STAGES; i++) {
+            for (size_t i = 0; i < numStages; i++) {
                 inputArgs.stageExecutionState[i] = (best_result.confOptP[i] == '0') ? StageState::CPU : StageState::CPU_GPU;
             }
         }
     }
 
     // Imprimir stageExecutionState
-    for (int i = 0; i < NUM_STAGES; i++) {
+    for (size_t i = 0; i < numStages; i++) {
         std::cout << "Stage " << i << " is executed in " << (inputArgs.stageExecutionState[i] == StageState::CPU ? "CPU" : (inputArgs.stageExecutionState[i] == StageState::GPU ? "GPU" : "CPU_GPU")) << std::endl;
     }
 
@@ -378,7 +419,7 @@ void PipelineInterface::optimizePipeline(ApplicationData &appData, InputArgs &in
         inputArgs.executionDevicePriority[i] = (best_result.confOptP[i] == '1') ? Acc::GPU : Acc::CPU;
     }
 
-    for (size_t i = 0; i < NUM_STAGES; ++i) {
+    for (size_t i = 0; i < numStages; ++i) {
         std::cout << "Stage " << i << " is prioritary in " << (inputArgs.executionDevicePriority[i] == Acc::GPU ? "GPU" : "CPU") << std::endl;
     }
 
@@ -415,15 +456,25 @@ void PipelineInterface::optimizePipeline(ApplicationData &appData, InputArgs &in
 
 void PipelineInterface::debugAndTrace(ViVidItem *item, ApplicationData &appData, Tracer &traceFile) {
     if constexpr (DEBUG_ENABLED) {
-        Comparer::compare(item, appData);
+        // The golden output is the one of the global frame, which is also the first frame of the input (--input)
+        if (item->frame == appData.globalFrame || (runtime.frameSource != nullptr && runtime.frameSource->holdsFirstFrame(item))) {
+            Comparer::compare(item, appData);
+        }
     }
     if constexpr (TRACE_ENABLED) {
         traceFile.frame_end(item);
     }
 }
 
-void PipelineInterface::recycleItem(circular_buffer &bufferItems, ViVidItem *item) {
-    bufferItems.recycle(item);
+void PipelineInterface::processOutputNode(InputArgs &inputArgs, ItemPool &bufferItems, ViVidItem *item) {
+    // The steady state ends when the drain is about to start: the input has no more than a pool of frames left to
+    // start (with --duration, the timer ends it at the deadline); only the first frame counts
+    if constexpr (ALLOCCOUNT_ENABLED) {
+        if (!inputArgs.hasDuration() && item->item_id > 2 * bufferItems.capacity() && item->item_id + bufferItems.capacity() >= static_cast<size_t>(inputArgs.numFrames)) {
+            AllocCounter::stopSteadyState(item->item_id);
+        }
+    }
+    runtime.complete(item, bufferItems);
 }
 
 void PipelineInterface::publicReduceCountersAfterProcessing(const InputArgs &inputArgs, const ApplicationData &appData, Acc accelerator, int index, sycl::queue *Q, sycl::event *event, std::vector<sycl::event> *vectorEvents) {
@@ -0,0 +1,70 @@
+#include "PipelineRuntime.hpp"
+
+bool PipelineRuntime::reserveFrame() const {
+    return frameSource == nullptr || frameSource->reserveFrame();
+}
+
+void PipelineRuntime::admit(ViVidItem *item) const {
+    // Take a fresh frame from the input (--input); otherwise the item keeps the global frame
+    if (frameSource != nullptr) {
+        frameSource->acquire(item);
+    }
+    // Restrict the stages to the regions of interest of the frame (--roi), numbered as in the input file if there is one
+    if (rois != nullptr) {
+        item->region = rois->find(item->inputFrame != 0 ? item->inputFrame : item->item_id);
+    }
+    // Restrict the stages to the tiles that changed since the last keyframe (--reuse)
+    if (temporalCache != nullptr) {
+        temporalCache->admit(item);
+    }
+    // Spread the frames over the queues of each device (--queues); all the stages of the frame use the same ones
+    if (queuePool != nullptr) {
+        queuePool->assign(item);
+    }
+    // With a synthetic camera (--camera), wait until the frame is released and stamp its arrival and deadline
+    if (camera != nullptr) {
+        camera->admit(item);
+    }
+}
+
+void PipelineRuntime::complete(ViVidItem *item, ItemPool &bufferItems) const {
+    // The tiles that were not recomputed take the output of the reference before anyone reads it
+    if (temporalCache != nullptr) {
+        temporalCache->complete(item);
+    }
+    if (reorderBuffer != nullptr) {
+        // The frame is delivered when the frames before it have been (by this thread, before push returns)
+        Delivery delivery{this, &bufferItems};
+        reorderBuffer->push(item, &PipelineRuntime::deliverReordered, &delivery);
+        return;
+    }
+    deliver(item, bufferItems, true);
+}
+
+void PipelineRuntime::flush(ItemPool &bufferItems) const {
+    if (reorderBuffer != nullptr) {
+        Delivery delivery{this, &bufferItems};
+        reorderBuffer->flush(&PipelineRuntime::deliverReordered, &delivery);
+    }
+}
+
+void PipelineRuntime::deliverReordered(void *delivery, ViVidItem *item, bool inOrder) {
+    Delivery *target = static_cast<Delivery *>(delivery);
+    target->runtime->deliver(item, *target->bufferItems, inOrder);
+}
+
+void PipelineRuntime::deliver(ViVidItem *item, ItemPool &bufferItems, bool inOrder) const {
+    if (resultSink != nullptr && inOrder) {
+        resultSink->submit(item);
+    }
+    if (camera != nullptr) {
+        camera->complete(item);
+    }
+    if (frameSource != nullptr) {
+        frameSource->release(item);
+    }
+    if (queuePool != nullptr) {
+        queuePool->release(item);
+    }
+    bufferItems.release(item);
+}
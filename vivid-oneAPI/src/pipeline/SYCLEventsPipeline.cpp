@@ -1,28 +1,25 @@
 // SYCLEventsPipeline.cpp
 #include "SYCLEventsPipeline.hpp"
 #include "InputArgs.hpp"
-#include <future>
-
-// Define mutexes for input and output synchronization
-std::mutex input_mutex;  ///< Mutex for protecting the ID counter and other critical sections
-std::mutex output_mutex; ///< Mutex for protecting the output node
+#include <algorithm>
+#include <exception>
+#include <iostream>
+#include <string>
 
 /**
  * @brief Executes the SYCL pipeline with the given application data, input arguments, and SYCL queues.
  *
- * @tparam N Number of stages in the pipeline.
  * @param appData Application data.
  * @param inputArgs Input arguments.
- * @param bufferItems Circular buffer containing items to process.
+ * @param bufferItems Pool of items to process.
  * @param traceFile Trace file for logging.
  * @param Q_GPU SYCL queue for GPU.
  * @param Q_CPU SYCL queue for CPU.
  * @param energyPCM Optional energy PCM pointer.
  */
-template <std::size_t N>
-void SYCLEventsPipeline<N>::executePipeline(ApplicationData &appData, InputArgs &inputArgs, circular_buffer &bufferItems, Tracer &traceFile, sycl::queue &Q_GPU, sycl::queue &Q_CPU, EnergyPCM *energyPCM) {
+void SYCLEventsPipeline::executePipeline(ApplicationData &appData, InputArgs &inputArgs, ItemPool &bufferItems, Tracer &traceFile, sycl::queue &Q_GPU, sycl::queue &Q_CPU, EnergyPCM *energyPCM) {
     if constexpr (VERBOSE_ENABLED) {
-        std::cout << "Running SYCL Events Pipeline with " << N << " stages" << std::endl;
+        std::cout << "Running SYCL Events Pipeline with " << inputArgs.numStages() << " stages" << std::endl;
     }
 
     // // Set the global control for TBB to limit the maximum allowed parallelism
@@ -32,6 +29,17 @@ void SYCLEventsPipeline<N>::executePipeline(ApplicationData &appData, InputArgs
     inFlightFrames = std::make_unique<Device>(Acc::OTHER, inputArgs.nThreads + inputArgs.GPUactive);
     inFlightFrames->addStage(0, inputArgs.nThreads + inputArgs.GPUactive, inputArgs.inFlightFrames);
 
+    // The frames that run whole on the GPU replay a recorded graph, where the queue supports it (--gpu-graph)
+    if (inputArgs.gpuGraph && inputArgs.GPUactive) {
+        std::string reason;
+        if (StageGraphs::supported(Q_GPU, reason)) {
+            // The items take the frames of --input from its ring: each one keeps a graph per slot
+            stageGraphs = std::make_unique<StageGraphs>(Q_GPU, runtime.frameSource != nullptr ? runtime.frameSource->ringSize() : 0);
+        } else {
+            std::cerr << " --gpu-graph: the stages are submitted one by one, " << reason << std::endl;
+        }
+    }
+
     // Start the pipeline timer
     appData.pipeline_start = tbb::tick_count::now();
     // We ensure the executions always last the same, regardless of whether the automatic mode is enabled or not
@@ -41,66 +49,107 @@ void SYCLEventsPipeline<N>::executePipeline(ApplicationData &appData, InputArgs
         startTimerIfNeeded(appData, inputArgs);
     }
 
-    // Vector para almacenar los futuros de los frames en vuelo
-    std::vector<std::future<void>> framesInFlight;
-    framesInFlight.reserve(inputArgs.inFlightFrames);
+    // The workers only admit and submit the frames: they do not need to outnumber the frames in flight or the threads
+    const int tokens = std::max(inputArgs.inFlightFrames, 1);
+    const int numWorkers = std::clamp(inputArgs.nThreads, 1, tokens);
+    freeTokens.store(tokens, std::memory_order_relaxed);
+    pendingCompletions.store(0, std::memory_order_relaxed);
+    failed.store(false, std::memory_order_relaxed);
+    completed.clear();
+
+    // The output thread releases the frames in the order of their ids, which the input node assigns consecutively
+    std::exception_ptr outputError;
+    std::thread output([&, firstId = static_cast<size_t>(appData.id) + 1] {
+        try {
+            processOutput(appData, inputArgs, traceFile, bufferItems, Q_GPU, Q_CPU, firstId);
+        } catch (...) {
+            outputError = std::current_exception();
+            fail();
+        }
+    });
 
-    // Lanza tareas asíncronas para procesar imágenes
-    for (int i = 0; i < inputArgs.inFlightFrames; ++i) {
-        framesInFlight.push_back(std::async(std::launch::async, &SYCLEventsPipeline::processImage, this,
-                                            std::ref(appData), std::ref(inputArgs), std::ref(traceFile), std::ref(bufferItems),
-                                            std::ref(appData.filterBank), std::ref(Q_GPU), std::ref(Q_CPU), energyPCM));
+    // Pool fijo de workers, independiente de los frames en vuelo
+    std::vector<std::thread> workers;
+    std::vector<std::exception_ptr> errors(numWorkers);
+    workers.reserve(numWorkers);
+    for (int i = 0; i < numWorkers; ++i) {
+        workers.emplace_back([&, i] {
+            try {
+                processImage(appData, inputArgs, traceFile, bufferItems, Q_GPU, Q_CPU);
+            } catch (...) {
+                errors[i] = std::current_exception();
+                // The frames after the one of this worker would wait forever for their turn
+                fail();
+            }
+        });
     }
 
-    // Espera a que todas las tareas finalicen
-    for (auto &frame : framesInFlight) {
-        frame.get(); // Bloquea hasta que la tarea esté completa y maneja cualquier excepción
+    // Espera a que todos los workers finalicen
+    for (auto &worker : workers) {
+        worker.join();
+    }
+    // Every frame has been submitted: wait until all of them have left the pipeline (all the tokens are back)
+    for (int free = freeTokens.load(std::memory_order_acquire); free != tokens && !failed.load(std::memory_order_acquire); free = freeTokens.load(std::memory_order_acquire)) {
+        freeTokens.wait(free, std::memory_order_acquire);
+    }
+    completed.push(nullptr);
+    output.join();
+    // After a failure some frames may still be running: their completions must not outlive the pipeline
+    for (int pending = pendingCompletions.load(std::memory_order_acquire); pending != 0; pending = pendingCompletions.load(std::memory_order_acquire)) {
+        pendingCompletions.wait(pending, std::memory_order_acquire);
+    }
+    completed.clear();
+    for (auto &error : errors) {
+        if (error) {
+            std::rethrow_exception(error);
+        }
+    }
+    if (outputError) {
+        std::rethrow_exception(outputError);
     }
 
     // Stop the pipeline timer
     appData.pipeline_end = tbb::tick_count::now();
+
+    if (stageGraphs) {
+        std::cout << " Frames replayed as a SYCL graph: " << stageGraphs->getReplayed() << " (" << stageGraphs->getRecorded() << " graphs recorded, "
+                  << stageGraphs->getRerecorded() << " of them again after a change of region)" << std::endl;
+        stageGraphs.reset();
+    }
 }
 
 /**
  * @brief Runs a stage wrapper function for a given stage.
  *
- * @tparam StageFunc Type of the stage function.
  * @param acc Accelerator type.
  * @param item Item to process.
  * @param traceFile Trace file for logging.
  * @param inputArgs Input arguments.
  * @param appData Application data.
  * @param Q SYCL queue.
- * @param stage_func Stage function to execute.
  * @param eventInfo SYCL event info.
  * @param stage_ID Stage identifier.
+ * @param prevEvents Events of the stages of the previous level (the stage depends on them only).
+ * @param levelEvents Events of the stages of the current level (the stages of the next level depend on them).
  */
-template <std::size_t N>
-template <typename StageFunc>
-void SYCLEventsPipeline<N>::runStageWrapper(Acc acc, ViVidItem *item, Tracer &traceFile, InputArgs &inputArgs, ApplicationData &appData, sycl::queue &Q, StageFunc stage_func, SyclEventInfo &eventInfo, int stage_ID) {
+void SYCLEventsPipeline::runStageWrapper(Acc acc, ViVidItem *item, Tracer &traceFile, InputArgs &inputArgs, ApplicationData &appData, sycl::queue &Q, SyclEventInfo &eventInfo, int stage_ID, std::vector<sycl::event> &prevEvents, std::vector<sycl::event> &levelEvents) {
     try {
-        if constexpr (USE_VIVID_APP) {
-            // Run the stage function depending on the accelerator type
-            if (acc == Acc::GPU || (acc == Acc::CPU && SYCL_ENABLED)) {
-                eventInfo = stage_func(acc, item, traceFile, appData, inputArgs, Q, &(item->stage_events));
-            } else if (acc == Acc::CPU) {
-                eventInfo.event = Q.submit([&](sycl::handler &cgh) {
-                    if (!item->stage_events.empty()) {
-                        cgh.depends_on(item->stage_events);
-                    }
-                    stage_func(acc, item, traceFile, appData, inputArgs, Q, &(item->stage_events));
-                });
-            }
+        // The kernels that enqueue their work chain it to the previous level; the rest (the CPU kernels without SYCL
+        // and the simulator) run in a host task that depends on the previous level, so the worker never runs them
+        if (inputArgs.stages[stage_ID]->enqueues && (acc == Acc::GPU || SYCL_ENABLED)) {
+            eventInfo = runStage(stage_ID, acc, item, traceFile, appData, inputArgs, runtime.stageBatcher, Q, &prevEvents);
         } else {
             eventInfo.event = Q.submit([&](sycl::handler &cgh) {
-                if (!item->stage_events.empty()) {
-                    cgh.depends_on(item->stage_events);
+                if (!prevEvents.empty()) {
+                    cgh.depends_on(prevEvents);
                 }
-                workloadsimulator(acc, item, traceFile, appData, inputArgs, stage_ID);
+                cgh.host_task([=, &traceFile, &appData, &inputArgs, &Q] {
+                    runStage(stage_ID, acc, item, traceFile, appData, inputArgs, runtime.stageBatcher, Q, nullptr);
+                });
             });
         }
         item->stage_acc.push_back(acc);
-        item->stage_events.push_back(eventInfo.getEvent());
+        levelEvents.push_back(eventInfo.getEvent());
         if (inputArgs.selectedPath != PathSelection::Decoupled) {
             reduceCountersAfterProcessing(inputArgs, appData, acc, stage_ID, &Q, &(eventInfo.event), &(item->stage_events));
         }
@@ -112,81 +161,140 @@ void SYCLEventsPipeline<N>::runStageWrapper(Acc acc, ViVidItem *item, Tracer &tr
 }
 
 /**
- * @brief Processes an image in the pipeline.
+ * @brief Worker of the pool: admits frames and submits their stages until the input ends.
  *
  * @param appData Application data.
  * @param inputArgs Input arguments.
  * @param traceFile Trace file for logging.
- * @param bufferItems Circular buffer containing items to process.
- * @param filter_bank Filter bank for processing.
+ * @param bufferItems Pool of items to process.
  * @param Q_GPU SYCL queue for GPU.
  * @param Q_CPU SYCL queue for CPU.
- * @param energyPCM Optional energy PCM pointer.
  */
-template <std::size_t N>
-void SYCLEventsPipeline<N>::processImage(ApplicationData &appData, InputArgs &inputArgs, Tracer &traceFile, circular_buffer &bufferItems, float *filter_bank, sycl::queue &Q_GPU, sycl::queue &Q_CPU, EnergyPCM *energyPCM) {
-    while (appData.id < inputArgs.numFrames || inputArgs.hasDuration()) {
+void SYCLEventsPipeline::processImage(ApplicationData &appData, InputArgs &inputArgs, Tracer &traceFile, ItemPool &bufferItems, sycl::queue &Q_GPU, sycl::queue &Q_CPU) {
+    std::vector<sycl::event> prevEvents, levelEvents;
+    std::vector<Acc> stageAccs;
+    prevEvents.reserve(MAX_STAGES);
+    levelEvents.reserve(MAX_STAGES);
+    stageAccs.reserve(MAX_STAGES);
+    while (acquireToken()) {
         ViVidItem *item = nullptr;
         reserveFrameInFlight();
         {
-            std::lock_guard<std::mutex> lock(input_mutex);
-            item = processInputNode(appData, inputArgs, bufferItems, traceFile);
+            // The input node is serial, as in the other backends: a frame takes its id, its input frame, its tiles and
+            // its camera release together, and the frame count is not overrun by workers checking it at the same time
+            std::lock_guard<std::mutex> lock(inputMutex);
+            if (hasNextFrame(appData, inputArgs, bufferItems)) {
+                item = processInputNode(appData, inputArgs, bufferItems, traceFile);
+            }
         }
         releaseFrameInFlight();
+        if (item == nullptr) {
+            releaseToken();
+            break;
+        }
 
-        addStages(item, appData, inputArgs, traceFile, Q_GPU, Q_CPU);
-
-        // Wait for all stages to finish
-        sycl::event::wait_and_throw(item->stage_events);
-
-        reserveFrameInFlight();
-        {
-            std::lock_guard<std::mutex> lock(output_mutex);
-            // Save the previous number of tokens
-            int prev_tokens;
-            if constexpr (AUTOMODE_ENABLED) {
-                prev_tokens = inputArgs.inFlightFrames;
-            }
-
-            // Get the accelerator used for the item
-            Acc acc = item->GPU_item ? Acc::GPU : Acc::CPU;
+        addStages(item, appData, inputArgs, traceFile, Q_GPU, Q_CPU, prevEvents, levelEvents, stageAccs);
 
-            if (inputArgs.selectedPath == PathSelection::Decoupled) {
-                // Get the last event in the stage events vector
-                sycl::event *last_event = &item->stage_events.back();
-                reduceCountersAfterProcessing(inputArgs, appData, acc, -1, &(acc == Acc::GPU ? Q_GPU : Q_CPU), last_event, &item->stage_events);
-            }
+        // The frame goes to the output thread when its stages have run; the worker takes the next one meanwhile
+        submitCompletion(item, Q_GPU, Q_CPU);
+    }
+}
 
-            handleTimeMeasurements(item, appData, inputArgs, acc);
-            if (isAutoModeEnabled(appData, item, inputArgs)) {
-                std::cout << "Launching optimization" << std::endl;
-                optimizePipeline(appData, inputArgs);
-                std::cout << "Optimization finished" << std::endl;
-            }
+/**
+ * @brief Submits the host task that hands the frame to the output thread once all its stages have run.
+ *
+ * @param item Item whose stages have been submitted.
+ * @param Q_GPU SYCL queue for GPU.
+ * @param Q_CPU SYCL queue for CPU.
+ */
+void SYCLEventsPipeline::submitCompletion(ViVidItem *item, sycl::queue &Q_GPU, sycl::queue &Q_CPU) {
+    // The queue of the last stage of the frame, the one most likely to finish last
+    sycl::queue &Q = !item->stage_acc.empty() && item->stage_acc.back() == Acc::GPU ? Q_GPU : Q_CPU;
+    pendingCompletions.fetch_add(1, std::memory_order_relaxed);
+    try {
+        Q.submit([&](sycl::handler &cgh) {
+            cgh.depends_on(item->stage_events);
+            cgh.host_task([this, item] {
+                completed.push(item);
+                pendingCompletions.fetch_sub(1, std::memory_order_release);
+                pendingCompletions.notify_all();
+            });
+        });
+    } catch (...) {
+        pendingCompletions.fetch_sub(1, std::memory_order_release);
+        pendingCompletions.notify_all();
+        throw;
+    }
+}
 
-            // Check debug, trace and recycle the item
-            debugAndTrace(item, appData, traceFile);
-            recycleItem(bufferItems, item);
+/**
+ * @brief Output thread: releases the completed frames in the order of their ids until it gets a nullptr.
+ *
+ * @param appData Application data.
+ * @param inputArgs Input arguments.
+ * @param traceFile Trace file for logging.
+ * @param bufferItems Pool of items to process.
+ * @param Q_GPU SYCL queue for GPU.
+ * @param Q_CPU SYCL queue for CPU.
+ * @param firstId Id of the first frame of the execution.
+ */
+void SYCLEventsPipeline::processOutput(ApplicationData &appData, InputArgs &inputArgs, Tracer &traceFile, ItemPool &bufferItems, sycl::queue &Q_GPU, sycl::queue &Q_CPU, size_t firstId) {
+    // Every id between the next frame to leave and the youngest one admitted belongs to an item of the pool, so a
+    // frame that finishes early is held in the slot of its id without colliding with another one
+    std::vector<ViVidItem *> held(bufferItems.capacity(), nullptr);
+    size_t next = firstId;
+    ViVidItem *item;
+    while (true) {
+        completed.pop(item);
+        if (item == nullptr) {
+            return;
+        }
+        held[item->item_id % held.size()] = item;
+        while ((item = held[next % held.size()]) != nullptr) {
+            held[next % held.size()] = nullptr;
+            outputFrame(item, appData, inputArgs, traceFile, bufferItems, Q_GPU, Q_CPU);
+            next++;
         }
-        releaseFrameInFlight();
     }
 }
 
 /**
- * @brief Gets the stage function for the specified stage.
+ * @brief Output node of a completed frame (its turn has come): measurements, debug and trace, then its output stage.
  *
- * @param stage Stage number.
- * @return StageFunction The stage function.
+ * @param item Item whose stages have all run.
+ * @param appData Application data.
+ * @param inputArgs Input arguments.
+ * @param traceFile Trace file for logging.
+ * @param bufferItems Pool of items to process.
+ * @param Q_GPU SYCL queue for GPU.
+ * @param Q_CPU SYCL queue for CPU.
  */
-template <std::size_t N>
-typename SYCLEventsPipeline<N>::StageFunction SYCLEventsPipeline<N>::getStageFunction(size_t stage) {
-    if constexpr (USE_VIVID_APP) {
-        return stageFunctions.at(stage);
-    } else {
-        return [stage](Acc acc, ViVidItem *item, Tracer &trace_file, ApplicationData &appData, InputArgs &inputArgs, sycl::queue &Q, std::vector<sycl::event> *depends_on) {
-            return workloadsimulator(acc, item, trace_file, appData, inputArgs, stage);
-        };
+void SYCLEventsPipeline::outputFrame(ViVidItem *item, ApplicationData &appData, InputArgs &inputArgs, Tracer &traceFile, ItemPool &bufferItems, sycl::queue &Q_GPU, sycl::queue &Q_CPU) {
+    // The events have all completed: this only reports the asynchronous errors of the stages
+    sycl::event::wait_and_throw(item->stage_events);
+
+    reserveFrameInFlight();
+    // Get the accelerator used for the item
+    Acc acc = item->GPU_item ? Acc::GPU : Acc::CPU;
+
+    if (inputArgs.selectedPath == PathSelection::Decoupled) {
+        // Get the last event in the stage events vector
+        sycl::event *last_event = &item->stage_events.back();
+        reduceCountersAfterProcessing(inputArgs, appData, acc, -1, &(acc == Acc::GPU ? Q_GPU : Q_CPU), last_event, &item->stage_events);
+    }
+
+    handleTimeMeasurements(item, appData, inputArgs, acc);
+    if (isAutoModeEnabled(appData, item, inputArgs)) {
+        std::cout << "Launching optimization" << std::endl;
+        optimizePipeline(appData, inputArgs);
+        std::cout << "Optimization finished" << std::endl;
     }
+
+    // Check debug and trace the item, then return it to the pool
+    debugAndTrace(item, appData, traceFile);
+    processOutputNode(inputArgs, bufferItems, item);
+    releaseFrameInFlight();
+    releaseToken();
 }
 
 /**
@@ -198,42 +306,131 @@ typename SYCLEventsPipeline<N>::StageFunction SYCLEventsPipeline<N>::getStageFun
  * @param traceFile Trace file for logging.
  * @param Q_GPU SYCL queue for GPU.
  * @param Q_CPU SYCL queue for CPU.
+ * @param prevEvents Scratch vector for the events of the previous level.
+ * @param levelEvents Scratch vector for the events of a level.
+ * @param stageAccs Scratch vector for the device selected for each stage.
  */
-template <std::size_t N>
-void SYCLEventsPipeline<N>::addStages(ViVidItem *item, ApplicationData &appData, InputArgs &inputArgs, Tracer &traceFile, sycl::queue &Q_GPU, sycl::queue &Q_CPU) {
-    // Initialize stage functions based on the application mode
-    stageFunctions = USE_VIVID_APP ? std::unordered_map<std::size_t, StageFunction>{
-                                         {0, cosinefilter},
-                                         {1, blockhistogram},
-                                         {2, pwdist}}
-                                   : std::unordered_map<std::size_t, StageFunction>{};
-
-    // Iterate through the stages and process each stage
-    for (size_t i = 0; i < N; ++i) {
-        reserveFrameInFlight();
-        Acc acc = selectPath(inputArgs, i, item->GPU_item, item, &traceFile);
-        StageFunction stage_func = getStageFunction(i);
-        SyclEventInfo eventInfo;
-        runStageWrapper(acc, item, traceFile, inputArgs, appData, (acc == Acc::GPU ? Q_GPU : Q_CPU), stage_func, eventInfo, i);
-        releaseFrameInFlight();
+void SYCLEventsPipeline::addStages(ViVidItem *item, ApplicationData &appData, InputArgs &inputArgs, Tracer &traceFile, sycl::queue &Q_GPU, sycl::queue &Q_CPU, std::vector<sycl::event> &prevEvents, std::vector<sycl::event> &levelEvents, std::vector<Acc> &stageAccs) {
+    // Select the device of every stage before submitting any: a frame that runs whole on the GPU may replay its graph
+    stageAccs.assign(inputArgs.numStages(), Acc::OTHER);
+    bool wholeGPU = true;
+    for (const auto &level : inputArgs.stageLevels) {
+        for (size_t i : level) {
+            reserveFrameInFlight();
+            stageAccs[i] = selectPath(inputArgs, i, item->GPU_item, item, &traceFile);
+            releaseFrameInFlight();
+            wholeGPU = wholeGPU && stageAccs[i] == Acc::GPU && inputArgs.stages[i]->enqueues;
+        }
+    }
+    if (wholeGPU && stageGraphs && replayGraph(item, appData, inputArgs, traceFile, Q_GPU, prevEvents, levelEvents)) {
+        return;
+    }
+
+    // Iterate through the levels; each stage only depends on the previous level of the same frame, so the branches of
+    // a level can overlap and the dependency lists never hold more than a level
+    prevEvents.clear();
+    for (const auto &level : inputArgs.stageLevels) {
+        levelEvents.clear();
+        for (size_t i : level) {
+            reserveFrameInFlight();
+            Acc acc = stageAccs[i];
+            SyclEventInfo eventInfo;
+            runStageWrapper(acc, item, traceFile, inputArgs, appData, (acc == Acc::GPU ? Q_GPU : Q_CPU), eventInfo, i, prevEvents, levelEvents);
+            releaseFrameInFlight();
+        }
+        item->stage_events.insert(item->stage_events.end(), levelEvents.begin(), levelEvents.end());
+        prevEvents.swap(levelEvents);
     }
 }
 
+/**
+ * @brief Submits the stages of a frame that runs whole on the GPU as the graph of its item.
+ *
+ * @param item Item to process.
+ * @param appData Application data.
+ * @param inputArgs Input arguments.
+ * @param traceFile Trace file for logging.
+ * @param Q_GPU SYCL queue for GPU.
+ * @param prevEvents Scratch vector for the events of the previous level.
+ * @param levelEvents Scratch vector for the events of a level.
+ * @return false if graphs are not usable: the stages must be submitted one by one.
+ */
+bool SYCLEventsPipeline::replayGraph(ViVidItem *item, ApplicationData &appData, InputArgs &inputArgs, Tracer &traceFile, sycl::queue &Q_GPU, std::vector<sycl::event> &prevEvents, std::vector<sycl::event> &levelEvents) {
+    // The same submissions as addStages, made to the recording queue: nothing runs and nothing is released
+    auto record = [&](sycl::queue &Q) {
+        prevEvents.clear();
+        for (const auto &level : inputArgs.stageLevels) {
+            levelEvents.clear();
+            for (size_t i : level) {
+                levelEvents.push_back(runStage(i, Acc::GPU, item, traceFile, appData, inputArgs, runtime.stageBatcher, Q, &prevEvents).getEvent());
+            }
+            prevEvents.swap(levelEvents);
+        }
+    };
+    sycl::event graphEvent;
+    if (!stageGraphs->replay(item, appData, record, graphEvent)) {
+        return false;
+    }
+
+    // Every stage ends with the graph
+    for (const auto &level : inputArgs.stageLevels) {
+        for (size_t i : level) {
+            item->stage_acc.push_back(Acc::GPU);
+            item->stage_events.push_back(graphEvent);
+            if (inputArgs.selectedPath != PathSelection::Decoupled) {
+                reduceCountersAfterProcessing(inputArgs, appData, Acc::GPU, i, &Q_GPU, &graphEvent, &item->stage_events);
+            }
+        }
+    }
+    return true;
+}
+
 /**
  * @brief Reserves a frame in flight.
  */
-template <std::size_t N>
-void SYCLEventsPipeline<N>::reserveFrameInFlight() {
+void SYCLEventsPipeline::reserveFrameInFlight() {
     inFlightFrames->acquireCore(0);
 }
 
 /**
  * @brief Releases a frame in flight.
  */
-template <std::size_t N>
-void SYCLEventsPipeline<N>::releaseFrameInFlight() {
+void SYCLEventsPipeline::releaseFrameInFlight() {
     inFlightFrames->release(0);
 }
 
-// Explicit template instantiation
-template class SYCLEventsPipeline<NUM_STAGES>;
\ No newline at end of file
+/**
+ * @brief Takes a token to admit a frame, waiting while --iff frames are in flight.
+ *
+ * @return false if the pipeline failed.
+ */
+bool SYCLEventsPipeline::acquireToken() {
+    int free = freeTokens.load(std::memory_order_acquire);
+    while (!failed.load(std::memory_order_acquire)) {
+        if (free == 0) {
+            freeTokens.wait(0, std::memory_order_acquire);
+            free = freeTokens.load(std::memory_order_acquire);
+        } else if (freeTokens.compare_exchange_weak(free, free - 1, std::memory_order_acq_rel, std::memory_order_acquire)) {
+            return true;
+        }
+    }
+    return false;
+}
+
+/**
+ * @brief Gives back the token of a frame that left the pipeline.
+ */
+void SYCLEventsPipeline::releaseToken() {
+    freeTokens.fetch_add(1, std::memory_order_release);
+    freeTokens.notify_all();
+}
+
+/**
+ * @brief Stops the workers and the output thread after a failure.
+ */
+void SYCLEventsPipeline::fail() {
+    failed.store(true, std::memory_order_release);
+    // Wake up the workers waiting for a token, the wait for the last frames and the output thread
+    releaseToken();
+    completed.push(nullptr);
+}
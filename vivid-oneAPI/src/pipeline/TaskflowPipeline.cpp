@@ -4,8 +4,7 @@
 #include "taskflow/algorithm/pipeline.hpp"
 #include "taskflow/taskflow.hpp"
 
-template <std::size_t N>
-void TaskflowPipeline<N>::executePipeline(ApplicationData &appData, InputArgs &inputArgs, circular_buffer &bufferItems, Tracer &traceFile, sycl::queue &Q_GPU, sycl::queue &Q_CPU, EnergyPCM *energyPCM) {
+void TaskflowPipeline::executePipeline(ApplicationData &appData, InputArgs &inputArgs, ItemPool &bufferItems, Tracer &traceFile, sycl::queue &Q_GPU, sycl::queue &Q_CPU, EnergyPCM *energyPCM) {
     if constexpr (VERBOSE_ENABLED) {
         std::cout << " Running SCALABLE_PIPELINE version..." << std::endl;
     }
@@ -28,7 +27,7 @@ void TaskflowPipeline<N>::executePipeline(ApplicationData &appData, InputArgs &i
     std::vector<ViVidItem *> buffer(inputArgs.inFlightFrames, nullptr);
 
     auto input_pipe = [&](tf::Pipeflow &pf) {
-        if (appData.id < inputArgs.numFrames || inputArgs.hasDuration()) {
+        if (hasNextFrame(appData, inputArgs, bufferItems)) {
             ViVidItem *item = this->processInputNode(appData, inputArgs, bufferItems, traceFile);
             if constexpr (LOG_ENABLED) {
                 std::clog << "Processing item " << appData.id << " in the input node with thread " << std::this_thread::get_id() << ".\n";
@@ -78,7 +77,7 @@ void TaskflowPipeline<N>::executePipeline(ApplicationData &appData, InputArgs &i
 
             // Check debug, trace and recycle the item
             this->debugAndTrace(item, appData, traceFile);
-            this->recycleItem(bufferItems, item);
+            this->processOutputNode(inputArgs, bufferItems, item);
         }
     };
 
@@ -88,7 +87,7 @@ void TaskflowPipeline<N>::executePipeline(ApplicationData &appData, InputArgs &i
     // Input pipe - SERIAL
     pipes.emplace_back(tf::PipeType::SERIAL, input_pipe);
 
-    for (std::size_t i = 0; i < N; ++i) {
+    for (std::size_t i = 0; i < inputArgs.numStages(); ++i) {
         pipes.emplace_back(tf::PipeType::PARALLEL, make_stage_pipe(i));
     }
 
@@ -112,23 +111,6 @@ void TaskflowPipeline<N>::executePipeline(ApplicationData &appData, InputArgs &i
     appData.pipeline_end = tbb::tick_count::now();
 }
 
-template <std::size_t N>
-SyclEventInfo TaskflowPipeline<N>::processStage(std::size_t stage, Acc acc, ViVidItem *item, Tracer &traceFile, ApplicationData &appData, InputArgs &inputArgs, sycl::queue &Q_GPU, sycl::queue &Q_CPU) {
-    using StageFunction = std::function<SyclEventInfo(Acc, ViVidItem *, Tracer &, ApplicationData &, InputArgs &, sycl::queue &, std::vector<sycl::event> *)>;
-    static const std::unordered_map<std::size_t, StageFunction> stageFunctions = {
-        {0, cosinefilter},
-        {1, blockhistogram},
-        {2, pwdist}};
-
-    if constexpr (USE_VIVID_APP) {
-        if (stageFunctions.find(stage) != stageFunctions.end()) {
-            return stageFunctions.at(stage)(acc, item, traceFile, appData, inputArgs, (acc == Acc::GPU) ? Q_GPU : Q_CPU, nullptr);
-        }
-    } else {
-        return workloadsimulator(acc, item, traceFile, appData, inputArgs, stage);
-    }
-    return {};
+SyclEventInfo TaskflowPipeline::processStage(std::size_t stage, Acc acc, ViVidItem *item, Tracer &traceFile, ApplicationData &appData, InputArgs &inputArgs, sycl::queue &Q_GPU, sycl::queue &Q_CPU) {
+    return runStage(stage, acc, item, traceFile, appData, inputArgs, runtime.stageBatcher, (acc == Acc::GPU) ? Q_GPU : Q_CPU, nullptr);
 }
-
-// Explicit instantiation
-template class TaskflowPipeline<NUM_STAGES>;
\ No newline at end of file
@@ -55,7 +55,7 @@ WaitTimeResults MMcKKModel::calculateWaitTime(double arrival, double active, int
     return {Lq, Wq, rate, prob_occupancy, ro};
 }
 
-std::vector<OptConfResults> PipelineOptimizer::findOptimalConfiguration(int nstages, std::vector<double> thC, std::vector<double> thG, int nc, bool debug) {
+std::vector<OptConfResults> PipelineOptimizer::findOptimalConfiguration(int nstages, std::vector<double> thC, std::vector<double> thG, int nc, bool debug, int maxTokens) {
     std::vector<char> confP(nstages, '0');
 
     auto [botlC, stC] = findMinWithIndex(thC);
@@ -105,7 +105,7 @@ std::vector<OptConfResults> PipelineOptimizer::findOptimalConfiguration(int nsta
             break;
         }
 
-        results.push_back(calculateOptimalConfiguration(nstages, configCount, lambda_vals, p, Sdev, TserGP, TserCP, TserCS, TserGS, nc, rhoG, rhoC, stageBotl, (botlC < botlG) ? "CPU" : "GPU", debug));
+        results.push_back(calculateOptimalConfiguration(nstages, configCount, lambda_vals, p, Sdev, TserGP, TserCP, TserCS, TserGS, nc, rhoG, rhoC, stageBotl, (botlC < botlG) ? "CPU" : "GPU", debug, maxTokens));
 
         // Invalidate the selected optimal configuration by setting its lambda value to 0
         *max_iter = 0;
@@ -171,7 +171,7 @@ OptConfResults PipelineOptimizer::calculateOptimalConfiguration(int nstages, int
                                                                 const std::vector<double> &TserCS, const std::vector<double> &TserGS,
                                                                 int nc, const std::vector<double> &rhoG, const std::vector<double> &rhoC,
                                                                 int stageBotl, std::string devBot,
-                                                                bool debug) {
+                                                                bool debug, int maxTokens) {
     double lambdaOpt = *std::max_element(lambda_vals.begin(), lambda_vals.end());
     int id_opt = std::distance(lambda_vals.begin(), std::max_element(lambda_vals.begin(), lambda_vals.end()));
     std::string confOptP = std::bitset<32>(id_opt).to_string().substr(32 - nstages);
@@ -273,6 +273,13 @@ OptConfResults PipelineOptimizer::calculateOptimalConfiguration(int nstages, int
 
     double lambdae = (id_opt == configCount - 1) ? lambdaeGP + lambdaeCP : std::min(lambdaOpt, std::min(lambdaeGP + lambdaeCS, lambdaeCP + lambdaeGS));
     int ntokens = NGP + NCP + NGS + NCS;
+    // The memory budget limits the number of items that can be in flight
+    if (maxTokens > 0 && ntokens > maxTokens) {
+        if (debug) {
+            std::clog << "ntokens= " << ntokens << " limited to " << maxTokens << " by the memory budget" << std::endl;
+        }
+        ntokens = maxTokens;
+    }
 
     return {lambdaOpt, confOptP, confOptS, lambdae, ntokens, cP, cS, lambdaeGP, lambdaeCP, lambdaeGS, lambdaeCS, NGP, NCP, NGS, NCS, stageBotl, devBot};
 }
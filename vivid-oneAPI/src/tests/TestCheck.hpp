@@ -0,0 +1,73 @@
+/**
+ * @file TestCheck.hpp
+ * @brief Minimal checks shared by the tests in src/tests (make test): a failed check is reported and counted, and
+ * the test returns the number of failures from main().
+ */
+#pragma once
+#ifndef TEST_CHECK_HPP
+#define TEST_CHECK_HPP
+
+#include <cstdlib>
+#include <exception>
+#include <iostream>
+#include <string>
+#include <unistd.h>
+
+namespace TestCheck {
+inline int failures = 0;
+
+inline void fail(const char *file, int line, const std::string &what) {
+    std::cerr << file << ":" << line << ": FAILED " << what << std::endl;
+    failures++;
+}
+
+/**
+ * @brief Check that a call throws an exception of type E whose message contains a given text.
+ */
+template <typename E, typename F>
+void throws(const char *file, int line, F &&call, const std::string &message) {
+    try {
+        call();
+    } catch (const E &e) {
+        if (std::string(e.what()).find(message) == std::string::npos) {
+            fail(file, line, "the error \"" + std::string(e.what()) + "\" does not mention \"" + message + "\"");
+        }
+        return;
+    } catch (const std::exception &e) {
+        fail(file, line, "unexpected exception \"" + std::string(e.what()) + "\"");
+        return;
+    }
+    fail(file, line, "no exception (expected \"" + message + "\")");
+}
+
+/**
+ * @brief Path of a temporary file unique to this process.
+ */
+inline std::string tempPath(const std::string &name) {
+    const char *dir = std::getenv("TMPDIR");
+    return std::string(dir != nullptr ? dir : "/tmp") + "/vivid_test_" + std::to_string(getpid()) + "_" + name;
+}
+
+/**
+ * @brief Print the summary of the test and get its exit code.
+ */
+inline int report(const char *test) {
+    if (failures == 0) {
+        std::cout << test << ": OK" << std::endl;
+    } else {
+        std::cout << test << ": " << failures << " check(s) failed" << std::endl;
+    }
+    return failures == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+}
+} // namespace TestCheck
+
+#define CHECK(cond)                                                                                                    \
+    do {                                                                                                               \
+        if (!(cond)) {                                                                                                 \
+            TestCheck::fail(__FILE__, __LINE__, #cond);                                                                \
+        }                                                                                                              \
+    } while (0)
+
+#define CHECK_THROWS(type, call, message) TestCheck::throws<type>(__FILE__, __LINE__, [&] { call; }, message)
+
+#endif // TEST_CHECK_HPP
@@ -0,0 +1,229 @@
+/**
+ * @file test_async_reader.cpp
+ * @brief Test of the asynchronous reads of the frame source: a container is read back with every backend (io_uring,
+ * pread threads and sync), through the page cache and with O_DIRECT, and the frames must match the ones written. The
+ * fallback of the auto backend is tested in a child process where io_uring_setup is blocked with seccomp.
+ */
+#include "AsyncReader.hpp"
+#include "FrameContainer.hpp"
+#include "TestCheck.hpp"
+#include <cerrno>
+#include <cstddef>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <linux/filter.h>
+#include <linux/seccomp.h>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <sys/prctl.h>
+#include <sys/syscall.h>
+#include <sys/wait.h>
+#include <unistd.h>
+#include <vector>
+
+using namespace FrameContainer;
+
+namespace {
+constexpr uint32_t WIDTH = 1000; // 4 MB frames: neither the frames nor their offsets are whole O_DIRECT blocks
+constexpr uint32_t HEIGHT = 1001;
+constexpr size_t NUM_FRAMES = 12;
+constexpr size_t DEPTH = 4; // Reads in flight
+
+const IOBackend BACKENDS[] = {IOBackend::Uring, IOBackend::Pread, IOBackend::Sync, IOBackend::Auto};
+
+std::vector<float> makeFrame(size_t frame) {
+    std::vector<float> data(static_cast<size_t>(WIDTH) * HEIGHT);
+    for (size_t i = 0; i < data.size(); ++i) {
+        data[i] = static_cast<float>((i * 31 + frame * 1009) % 65521);
+    }
+    return data;
+}
+
+bool uringAvailable() {
+    try {
+        AsyncReader::create(IOBackend::Uring, 1);
+        return true;
+    } catch (const std::runtime_error &) {
+        return false;
+    }
+}
+
+/**
+ * @brief Destination of a frame, aligned for O_DIRECT.
+ */
+struct AlignedFrame {
+    unsigned char *data;
+    explicit AlignedFrame(size_t size) : data{static_cast<unsigned char *>(std::aligned_alloc(FRAME_ALIGNMENT, (size + FRAME_ALIGNMENT - 1) / FRAME_ALIGNMENT * FRAME_ALIGNMENT))} {}
+    ~AlignedFrame() { std::free(data); }
+    AlignedFrame(const AlignedFrame &) = delete;
+    AlignedFrame &operator=(const AlignedFrame &) = delete;
+};
+
+/**
+ * @brief Read every frame of the container with DEPTH reads in flight, as the I/O thread of the frame source does:
+ * with O_DIRECT the whole blocks of a frame are read through the direct descriptor and the rest through the page cache.
+ * @return Frames whose bytes do not match the frames written (or whose reads failed).
+ */
+size_t readAll(AsyncReader &reader, FrameReader &file, bool direct) {
+    const size_t frameBytes = file.frameBytes();
+    std::vector<std::unique_ptr<AlignedFrame>> frames;
+    for (size_t f = 0; f < file.frameCount(); ++f) {
+        frames.push_back(std::make_unique<AlignedFrame>(frameBytes));
+        std::memset(frames.back()->data, 0xA5, frameBytes);
+    }
+    std::vector<int> pending(file.frameCount(), 0);
+    std::vector<int> errors(file.frameCount(), 0);
+    size_t next = 0, inFlight = 0, completed = 0;
+    while (completed < file.frameCount()) {
+        // A frame takes one read, or two with O_DIRECT (the whole blocks and the rest): keep at most capacity() outstanding
+        const size_t directBytes = direct ? frameBytes / FRAME_ALIGNMENT * FRAME_ALIGNMENT : 0;
+        const size_t reads = (directBytes > 0 ? 1 : 0) + (directBytes < frameBytes ? 1 : 0);
+        while (next < file.frameCount() && inFlight + reads <= reader.capacity()) {
+            const uint64_t offset = file.frameOffset(next);
+            unsigned char *dst = frames[next]->data;
+            CHECK(directBytes == 0 || offset % FRAME_ALIGNMENT == 0);
+            if (directBytes > 0) {
+                reader.submit({file.directDescriptor(), dst, directBytes, offset, next, FRAME_ALIGNMENT});
+            }
+            if (directBytes < frameBytes) {
+                reader.submit({file.descriptor(), dst + directBytes, frameBytes - directBytes, offset + directBytes, next});
+            }
+            pending[next] = static_cast<int>(reads);
+            inFlight += reads;
+            next++;
+        }
+        ReadCompletion completion = reader.wait();
+        inFlight--;
+        errors[completion.tag] = errors[completion.tag] != 0 ? errors[completion.tag] : completion.error;
+        if (--pending[completion.tag] == 0) {
+            completed++;
+        }
+    }
+
+    size_t mismatches = 0;
+    for (size_t f = 0; f < file.frameCount(); ++f) {
+        std::vector<float> expected = makeFrame(f);
+        if (errors[f] != 0 || std::memcmp(frames[f]->data, expected.data(), frameBytes) != 0) {
+            mismatches++;
+        }
+    }
+    return mismatches;
+}
+
+// A read past the end of the file (buffered and O_DIRECT) and a read of a closed descriptor complete with their error,
+// not an exception
+void testErrors(AsyncReader &reader, FrameReader &file, const char *what) {
+    std::vector<unsigned char> buffer(file.frameBytes());
+    const uint64_t end = file.frameOffset(file.frameCount() - 1) + file.frameBytes();
+    reader.submit({file.descriptor(), buffer.data(), buffer.size(), end, 7});
+    ReadCompletion completion = reader.wait();
+    if (completion.tag != 7 || completion.error != ENODATA) {
+        TestCheck::fail(__FILE__, __LINE__, std::string(what) + ": a read past the end of the file returned " + std::strerror(completion.error));
+    }
+    reader.submit({-1, buffer.data(), buffer.size(), 0, 8});
+    completion = reader.wait();
+    if (completion.tag != 8 || completion.error != EBADF) {
+        TestCheck::fail(__FILE__, __LINE__, std::string(what) + ": a read of an invalid descriptor returned " + std::strerror(completion.error));
+    }
+
+    // An O_DIRECT read that runs into the end of the file is short: it is resumed from its last whole block, which the
+    // file ends inside, so it must end with ENODATA instead of reading that block again and again
+    if (file.directDescriptor() >= 0) {
+        const off_t fileSize = ::lseek(file.descriptor(), 0, SEEK_END);
+        const uint64_t start = (static_cast<uint64_t>(fileSize) / FRAME_ALIGNMENT - 1) * FRAME_ALIGNMENT;
+        AlignedFrame tail(3 * FRAME_ALIGNMENT);
+        reader.submit({file.directDescriptor(), tail.data, 3 * FRAME_ALIGNMENT, start, 9, FRAME_ALIGNMENT});
+        completion = reader.wait();
+        if (completion.tag != 9 || completion.error != ENODATA) {
+            TestCheck::fail(__FILE__, __LINE__, std::string(what) + ": an O_DIRECT read past the end of the file returned " + std::strerror(completion.error));
+        }
+    }
+}
+
+void testBackend(IOBackend backend, FrameReader &file) {
+    std::unique_ptr<AsyncReader> reader = AsyncReader::create(backend, DEPTH);
+    CHECK(reader->capacity() == DEPTH);
+    CHECK(backend == IOBackend::Auto || reader->backend() == backend);
+    std::string what = std::string(ioBackendName(backend)) + " (" + ioBackendName(reader->backend()) + ")";
+    if (size_t bad = readAll(*reader, file, false)) {
+        TestCheck::fail(__FILE__, __LINE__, what + ": " + std::to_string(bad) + " frame(s) differ");
+    }
+    if (file.directDescriptor() >= 0) {
+        if (size_t bad = readAll(*reader, file, true)) {
+            TestCheck::fail(__FILE__, __LINE__, what + " with O_DIRECT: " + std::to_string(bad) + " frame(s) differ");
+        }
+    }
+    testErrors(*reader, file, what.c_str());
+}
+
+// Make io_uring_setup fail with ENOSYS in this process, as in a kernel or container without io_uring
+bool blockUring() {
+    struct sock_filter filter[] = {
+        BPF_STMT(BPF_LD | BPF_W | BPF_ABS, offsetof(struct seccomp_data, nr)),
+        BPF_JUMP(BPF_JMP | BPF_JEQ | BPF_K, __NR_io_uring_setup, 0, 1),
+        BPF_STMT(BPF_RET | BPF_K, SECCOMP_RET_ERRNO | (ENOSYS & SECCOMP_RET_DATA)),
+        BPF_STMT(BPF_RET | BPF_K, SECCOMP_RET_ALLOW),
+    };
+    struct sock_fprog program = {static_cast<unsigned short>(sizeof(filter) / sizeof(filter[0])), filter};
+    return prctl(PR_SET_NO_NEW_PRIVS, 1, 0, 0, 0) == 0 && prctl(PR_SET_SECCOMP, SECCOMP_MODE_FILTER, &program) == 0;
+}
+
+// Without io_uring the auto backend falls back to the pread threads and the io_uring backend fails
+void testFallback(FrameReader &file) {
+    pid_t child = fork();
+    if (child == 0) {
+        if (!blockUring()) {
+            _exit(2);
+        }
+        CHECK_THROWS(std::runtime_error, AsyncReader::create(IOBackend::Uring, DEPTH), "io_uring is not available");
+        std::unique_ptr<AsyncReader> reader = AsyncReader::create(IOBackend::Auto, DEPTH);
+        CHECK(reader->backend() == IOBackend::Pread);
+        CHECK(readAll(*reader, file, false) == 0);
+        _exit(TestCheck::failures == 0 ? 0 : 1);
+    }
+    int status = 0;
+    CHECK(child > 0 && waitpid(child, &status, 0) == child);
+    if (WIFEXITED(status) && WEXITSTATUS(status) == 2) {
+        std::cout << "test_async_reader: seccomp is not available, the io_uring fallback is not tested" << std::endl;
+        return;
+    }
+    CHECK(WIFEXITED(status) && WEXITSTATUS(status) == 0);
+}
+} // namespace
+
+int main() {
+    const std::string path = TestCheck::tempPath("async.bin");
+    {
+        FrameWriter writer(path, WIDTH, HEIGHT);
+        for (size_t f = 0; f < NUM_FRAMES; ++f) {
+            writer.writeFrame(makeFrame(f).data());
+        }
+        writer.close();
+    }
+    FrameReader file(path);
+    if (file.directDescriptor() < 0) {
+        std::cout << "test_async_reader: the file system of " << path << " does not support O_DIRECT, only buffered reads are tested" << std::endl;
+    }
+
+    // The fallback runs first, while the process has no other threads to fork
+    testFallback(file);
+    const bool uring = uringAvailable();
+    if (!uring) {
+        std::cout << "test_async_reader: io_uring is not available, the io_uring backend is not tested" << std::endl;
+    }
+    for (IOBackend backend : BACKENDS) {
+        if (backend == IOBackend::Uring && !uring) {
+            CHECK_THROWS(std::runtime_error, AsyncReader::create(backend, DEPTH), "io_uring is not available");
+            continue;
+        }
+        testBackend(backend, file);
+    }
+    CHECK(AsyncReader::create(IOBackend::Auto, DEPTH)->backend() == (uring ? IOBackend::Uring : IOBackend::Pread));
+    CHECK(AsyncReader::create(IOBackend::Sync, 0)->capacity() == 1);
+
+    file.release();
+    std::remove(path.c_str());
+    return TestCheck::report("test_async_reader");
+}
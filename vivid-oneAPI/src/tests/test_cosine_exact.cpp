@@ -0,0 +1,205 @@
+/**
+ * @file test_cosine_exact.cpp
+ * @brief Test of the native pixel types of stage 1: the cosine filter of every CPU backend (C++, AVX, std::simd and
+ * SYCL on the CPU) and the golden output of the Comparer give bit-identical results for uint8 and uint16 frames and
+ * for the same frames widened to float.
+ */
+#include "ApplicationData.hpp"
+#include "Comparer.hpp"
+#include "DataBuffers.hpp"
+#include "TestCheck.hpp"
+#include "filters-AVX.hpp"
+#include "filters-CPP.hpp"
+#include "filters-SIMD.hpp"
+#include "filters-SYCL.hpp"
+#include <cstdint>
+#include <cstring>
+#include <random>
+#include <string>
+#include <vector>
+
+namespace {
+constexpr int WIDTH = 77; // Not a multiple of the vector widths or of the work-group size
+constexpr int HEIGHT = 45;
+constexpr int GOLDEN_WIDTH = 160; // The golden output needs whole cells and detection windows
+constexpr int GOLDEN_HEIGHT = 136;
+constexpr int FILTER_DIM = 3;
+constexpr int NUM_FILTERS = 100;
+constexpr unsigned SEED = 2024;
+
+enum class Backend { CPP, AVX, SIMD, SYCL };
+constexpr Backend BACKENDS[] = {Backend::CPP, Backend::AVX, Backend::SIMD, Backend::SYCL};
+
+const char *backendName(Backend backend) {
+    switch (backend) {
+    case Backend::CPP:
+        return "C++";
+    case Backend::AVX:
+        return "AVX";
+    case Backend::SIMD:
+        return "std::simd";
+    default:
+        return "SYCL";
+    }
+}
+
+/**
+ * @brief Frame in USM (the SYCL kernel reads it from the CPU device), with the pixels of a reference frame.
+ */
+template <typename Pixel>
+struct UsmFrame {
+    sycl::queue &Q;
+    Pixel *pixels;
+
+    UsmFrame(const std::vector<uint16_t> &reference, sycl::queue &Q_) : Q{Q_}, pixels{sycl::malloc_shared<Pixel>(reference.size(), Q_)} {
+        for (size_t i = 0; i < reference.size(); ++i) {
+            pixels[i] = static_cast<Pixel>(reference[i]);
+        }
+    }
+    ~UsmFrame() { sycl::free(pixels, Q); }
+};
+
+// Bitwise comparison (== on the floats would take -0 for 0)
+bool sameBits(const std::vector<float> &a, const std::vector<float> &b) {
+    return a.size() == b.size() && std::memcmp(a.data(), b.data(), a.size() * sizeof(float)) == 0;
+}
+
+struct Response {
+    std::vector<float> ind;
+    std::vector<float> val;
+
+    bool operator==(const Response &other) const { return sameBits(ind, other.ind) && sameBits(val, other.val); }
+};
+
+// Stage 1 of one backend on a frame of WIDTH x HEIGHT pixels (the outputs have no padding)
+template <typename Pixel>
+Response runCosine(Backend backend, const Pixel *frame, float *filterBank, const Rect &region, sycl::queue &Q) {
+    const size_t pixels = static_cast<size_t>(WIDTH) * HEIGHT;
+    float *ind = sycl::malloc_shared<float>(pixels, Q);
+    float *val = sycl::malloc_shared<float>(pixels, Q);
+    std::memset(ind, 0, pixels * sizeof(float));
+    std::memset(val, 0, pixels * sizeof(float));
+    const int pitch = WIDTH * sizeof(float);
+    switch (backend) {
+    case Backend::CPP:
+        cosine_filter_transpose(frame, ind, val, filterBank, HEIGHT, WIDTH, FILTER_DIM, FILTER_DIM, NUM_FILTERS, pitch, region);
+        break;
+    case Backend::AVX:
+        cosine_filter_AVX(frame, ind, val, filterBank, HEIGHT, WIDTH, FILTER_DIM, FILTER_DIM, NUM_FILTERS, pitch, region);
+        break;
+    case Backend::SIMD:
+        cosine_filter_SIMD(frame, ind, val, filterBank, HEIGHT, WIDTH, FILTER_DIM, FILTER_DIM, NUM_FILTERS, pitch, region);
+        break;
+    case Backend::SYCL:
+        cosine_filter_transpose_sycl(frame, ind, val, filterBank, HEIGHT, WIDTH, FILTER_DIM * FILTER_DIM, NUM_FILTERS, WIDTH, region, Q).wait_and_throw();
+        break;
+    }
+    Response response{std::vector<float>(ind, ind + pixels), std::vector<float>(val, val + pixels)};
+    sycl::free(ind, Q);
+    sycl::free(val, Q);
+    return response;
+}
+
+// A response of zeros would make every comparison pass
+bool hasResponse(const Response &response) {
+    for (float v : response.val) {
+        if (v != 0.0f) {
+            return true;
+        }
+    }
+    return false;
+}
+
+std::vector<uint16_t> makeFrame(int width, int height, uint16_t maxValue, std::mt19937 &mte) {
+    std::uniform_int_distribution<int> value{0, maxValue};
+    std::vector<uint16_t> frame(static_cast<size_t>(width) * height);
+    for (auto &pixel : frame) {
+        pixel = static_cast<uint16_t>(value(mte));
+    }
+    return frame;
+}
+
+void testBackends(sycl::queue &Q) {
+    std::mt19937 mte{SEED};
+    USMUsage usage;
+    float *filterBank = DataBuffers::createFilterBank(NUM_FILTERS, FILTER_DIM, mte, Q, usage);
+    const std::vector<uint16_t> frame8 = makeFrame(WIDTH, HEIGHT, 255, mte);
+    const std::vector<uint16_t> frame16 = makeFrame(WIDTH, HEIGHT, 65535, mte);
+    UsmFrame<uint8_t> uint8Frame{frame8, Q};
+    UsmFrame<uint16_t> uint16Frame8{frame8, Q};
+    UsmFrame<float> floatFrame8{frame8, Q};
+    UsmFrame<uint16_t> uint16Frame16{frame16, Q};
+    UsmFrame<float> floatFrame16{frame16, Q};
+
+    const int apron = FILTER_DIM / 2;
+    const Rect regions[] = {{apron, apron, WIDTH - 2 * apron, HEIGHT - 2 * apron}, // Whole frame
+                            {9, 5, 30, 21}};                                      // Region of interest (--roi)
+    for (Backend backend : BACKENDS) {
+        for (const Rect &region : regions) {
+            const std::string what = std::string(backendName(backend)) + " on " + std::to_string(region.width) + "x" + std::to_string(region.height) + " pixels";
+            Response reference8 = runCosine(backend, floatFrame8.pixels, filterBank, region, Q);
+            Response reference16 = runCosine(backend, floatFrame16.pixels, filterBank, region, Q);
+            CHECK(hasResponse(reference8) && hasResponse(reference16));
+            if (!(runCosine(backend, uint8Frame.pixels, filterBank, region, Q) == reference8)) {
+                TestCheck::fail(__FILE__, __LINE__, what + ": uint8 frame differs from float");
+            }
+            if (!(runCosine(backend, uint16Frame8.pixels, filterBank, region, Q) == reference8)) {
+                TestCheck::fail(__FILE__, __LINE__, what + ": uint16 frame (8-bit values) differs from float");
+            }
+            if (!(runCosine(backend, uint16Frame16.pixels, filterBank, region, Q) == reference16)) {
+                TestCheck::fail(__FILE__, __LINE__, what + ": uint16 frame (16-bit values) differs from float");
+            }
+        }
+    }
+    sycl::free(filterBank, Q);
+    usage.freed(NUM_FILTERS * FILTER_DIM * FILTER_DIM * sizeof(float));
+}
+
+// Golden output of the DEBUG builds (Comparer) for a frame stored with a pixel type; the filter bank and the classes
+// are drawn from the same seed every time
+std::vector<float> goldenOutput(const std::vector<uint16_t> &frame, PixelType type, sycl::queue &Q) {
+    std::vector<unsigned char> pixels(frame.size() * FrameContainer::pixelSize(type));
+    for (size_t i = 0; i < frame.size(); ++i) {
+        if (type == PixelType::UInt8) {
+            pixels[i] = static_cast<uint8_t>(frame[i]);
+        } else if (type == PixelType::UInt16) {
+            std::memcpy(pixels.data() + i * sizeof(uint16_t), &frame[i], sizeof(uint16_t));
+        } else {
+            float value = static_cast<float>(frame[i]);
+            std::memcpy(pixels.data() + i * sizeof(float), &value, sizeof(float));
+        }
+    }
+    ApplicationData appData;
+    appData.selectUSMQueue(Q);
+    appData.height = GOLDEN_HEIGHT;
+    appData.width = GOLDEN_WIDTH;
+    appData.pixelType = type;
+    appData.mte.seed(SEED);
+    DataBuffers::createAllBuffers(appData, pixels.data());
+    Comparer::createGoldenFrame(appData);
+    const size_t resultSize = appData.globalCla->height * (GOLDEN_WIDTH / appData.cellSize) * (GOLDEN_HEIGHT / appData.cellSize);
+    std::vector<float> golden(appData.goldenFrame, appData.goldenFrame + resultSize);
+    delete appData.globalFrame;
+    delete appData.globalCla;
+    return golden;
+}
+
+void testGolden(sycl::queue &Q) {
+    std::mt19937 mte{SEED + 1};
+    const std::vector<uint16_t> frame8 = makeFrame(GOLDEN_WIDTH, GOLDEN_HEIGHT, 255, mte);
+    const std::vector<uint16_t> frame16 = makeFrame(GOLDEN_WIDTH, GOLDEN_HEIGHT, 65535, mte);
+
+    std::vector<float> reference8 = goldenOutput(frame8, PixelType::Float32, Q);
+    CHECK(sameBits(goldenOutput(frame8, PixelType::UInt8, Q), reference8));
+    CHECK(sameBits(goldenOutput(frame8, PixelType::UInt16, Q), reference8));
+    CHECK(sameBits(goldenOutput(frame16, PixelType::UInt16, Q), goldenOutput(frame16, PixelType::Float32, Q)));
+}
+} // namespace
+
+int main() {
+    sycl::queue Q{sycl::cpu_selector_v};
+    std::cout << "test_cosine_exact: " << Q.get_device().get_info<sycl::info::device::name>() << std::endl;
+    testBackends(Q);
+    testGolden(Q);
+    return TestCheck::report("test_cosine_exact");
+}
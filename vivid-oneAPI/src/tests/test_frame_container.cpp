@@ -0,0 +1,280 @@
+/**
+ * @file test_frame_container.cpp
+ * @brief Test of the frame container: files written by FrameWriter, by media/convert_img_to_bin.py and in the two
+ * legacy layouts are read back with FrameReader, and the damaged files (truncated, bad magic, corrupted frame) fail
+ * with the expected errors.
+ */
+#include "FrameContainer.hpp"
+#include "TestCheck.hpp"
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <stdexcept>
+#include <sys/wait.h>
+#include <unistd.h>
+#include <vector>
+
+#ifndef VIVID_MEDIA_DIR
+#define VIVID_MEDIA_DIR "media"
+#endif
+
+using namespace FrameContainer;
+
+namespace {
+constexpr uint32_t WIDTH = 67; // Odd sizes: the frames are not multiples of the alignment
+constexpr uint32_t HEIGHT = 33;
+constexpr size_t NUM_FRAMES = 3;
+
+// Value of a pixel of a test frame (the Python writer uses the same formula)
+uint32_t pixel(size_t frame, size_t i) {
+    return static_cast<uint32_t>((i * 7 + frame * 13) % 251);
+}
+
+template <typename T>
+std::vector<T> makeFrame(size_t frame) {
+    std::vector<T> data(static_cast<size_t>(WIDTH) * HEIGHT);
+    for (size_t i = 0; i < data.size(); ++i) {
+        data[i] = static_cast<T>(pixel(frame, i));
+    }
+    return data;
+}
+
+void writeBytes(const std::string &path, const void *data, size_t size, bool append = false) {
+    std::ofstream file(path, std::ios::binary | (append ? std::ios::app : std::ios::trunc));
+    file.write(static_cast<const char *>(data), static_cast<std::streamsize>(size));
+}
+
+void patchBytes(const std::string &path, uint64_t offset, const void *data, size_t size) {
+    std::fstream file(path, std::ios::binary | std::ios::in | std::ios::out);
+    file.seekp(static_cast<std::streamoff>(offset));
+    file.write(static_cast<const char *>(data), static_cast<std::streamsize>(size));
+}
+
+// Read every frame back and compare it with the frames that were written
+template <typename T>
+void checkFrames(FrameReader &reader, bool verify) {
+    std::vector<T> frame(static_cast<size_t>(WIDTH) * HEIGHT);
+    for (size_t f = 0; f < reader.frameCount(); ++f) {
+        std::vector<T> expected = makeFrame<T>(f);
+        reader.readFrame(f, frame.data(), verify);
+        CHECK(std::memcmp(frame.data(), expected.data(), reader.frameBytes()) == 0);
+    }
+}
+
+template <typename T>
+void testWriter(PixelType type, bool checksums, size_t alignment) {
+    const std::string path = TestCheck::tempPath("writer.bin");
+    {
+        FrameWriter writer(path, WIDTH, HEIGHT, 1, type, checksums, alignment);
+        for (size_t f = 0; f < NUM_FRAMES; ++f) {
+            writer.writeFrame(makeFrame<T>(f).data());
+        }
+        writer.close();
+    }
+    FrameReader reader(path);
+    CHECK(reader.layout() == Layout::Container);
+    CHECK(reader.version() == VERSION);
+    CHECK(reader.width() == WIDTH && reader.height() == HEIGHT && reader.channels() == 1);
+    CHECK(reader.pixelType() == type);
+    CHECK(reader.frameCount() == NUM_FRAMES);
+    CHECK(reader.frameBytes() == static_cast<size_t>(WIDTH) * HEIGHT * sizeof(T));
+    CHECK(reader.hasChecksums() == checksums);
+    for (size_t f = 0; f < NUM_FRAMES; ++f) {
+        CHECK(reader.frameOffset(f) >= HEADER_SIZE && reader.frameOffset(f) % alignment == 0);
+    }
+    checkFrames<T>(reader, checksums);
+
+    // A rectangle inside the frame, row by row
+    std::vector<T> region(10 * 5);
+    reader.readRegion(1, 3, 4, 10, 5, region.data(), 10 * sizeof(T));
+    std::vector<T> expected = makeFrame<T>(1);
+    bool same = true;
+    for (uint32_t y = 0; y < 5; ++y) {
+        for (uint32_t x = 0; x < 10; ++x) {
+            same = same && region[y * 10 + x] == expected[(y + 4) * WIDTH + x + 3];
+        }
+    }
+    CHECK(same);
+    CHECK_THROWS(std::out_of_range, reader.readRegion(0, WIDTH - 2, 0, 4, 1, region.data(), 4 * sizeof(T)), "region outside the frame");
+    std::remove(path.c_str());
+}
+
+// Containers written by FrameWriter of media/convert_img_to_bin.py (the class does not need OpenCV or numpy)
+void testConverter() {
+    const char *python = std::getenv("PYTHON") != nullptr ? std::getenv("PYTHON") : "python3";
+    const std::string script = TestCheck::tempPath("convert.py");
+    const std::string float32Path = TestCheck::tempPath("convert_float32.bin");
+    const std::string uint16Path = TestCheck::tempPath("convert_uint16.bin");
+    {
+        std::ofstream file(script);
+        file << "import struct, sys\n"
+             << "sys.path.insert(0, '" << VIVID_MEDIA_DIR << "')\n"
+             << "from convert_img_to_bin import FrameWriter\n"
+             << "W, H, N = " << WIDTH << ", " << HEIGHT << ", " << NUM_FRAMES << "\n"
+             << "def frame(f):\n"
+             << "    return [(i * 7 + f * 13) % 251 for i in range(W * H)]\n"
+             << "w = FrameWriter(sys.argv[1], W, H, pixel_type='float32')\n"
+             << "for f in range(N): w.write_frame(struct.pack(f'<{W * H}f', *frame(f)))\n"
+             << "w.close()\n"
+             << "w = FrameWriter(sys.argv[2], W, H, pixel_type='uint16', checksums=False, alignment=1)\n"
+             << "for f in range(N): w.write_frame(struct.pack(f'<{W * H}H', *frame(f)))\n"
+             << "w.close()\n";
+    }
+    const std::string command = std::string(python) + " " + script + " " + float32Path + " " + uint16Path;
+    int status = std::system(command.c_str());
+    std::remove(script.c_str());
+    if (WIFEXITED(status) && WEXITSTATUS(status) == 127) {
+        std::cout << "test_frame_container: " << python << " not found, the containers of the converter are not tested" << std::endl;
+        return;
+    }
+    CHECK(status == 0);
+    if (status != 0) {
+        return;
+    }
+
+    FrameReader float32Reader(float32Path);
+    CHECK(float32Reader.layout() == Layout::Container);
+    CHECK(float32Reader.pixelType() == PixelType::Float32);
+    CHECK(float32Reader.frameCount() == NUM_FRAMES);
+    CHECK(float32Reader.hasChecksums()); // zlib.crc32 and crc32() must agree
+    CHECK(float32Reader.frameOffset(0) % FRAME_ALIGNMENT == 0);
+    checkFrames<float>(float32Reader, true);
+
+    FrameReader uint16Reader(uint16Path);
+    CHECK(uint16Reader.pixelType() == PixelType::UInt16);
+    CHECK(uint16Reader.frameCount() == NUM_FRAMES);
+    CHECK(!uint16Reader.hasChecksums());
+    CHECK(uint16Reader.frameOffset(0) == HEADER_SIZE); // No padding with --align 1
+    checkFrames<uint16_t>(uint16Reader, false);
+
+    std::remove(float32Path.c_str());
+    std::remove(uint16Path.c_str());
+}
+
+void testLegacy() {
+    const std::string path = TestCheck::tempPath("legacy.bin");
+    const size_t frameBytes = static_cast<size_t>(WIDTH) * HEIGHT * sizeof(float);
+
+    // Two int32 header (height, width) and several float frames
+    int32_t header2[2] = {static_cast<int32_t>(HEIGHT), static_cast<int32_t>(WIDTH)};
+    writeBytes(path, header2, sizeof(header2));
+    for (size_t f = 0; f < NUM_FRAMES; ++f) {
+        writeBytes(path, makeFrame<float>(f).data(), frameBytes, true);
+    }
+    {
+        FrameReader reader(path);
+        CHECK(reader.layout() == Layout::LegacyHeader2);
+        CHECK(reader.width() == WIDTH && reader.height() == HEIGHT);
+        CHECK(reader.pixelType() == PixelType::Float32);
+        CHECK(reader.frameCount() == NUM_FRAMES);
+        CHECK(reader.frameOffset(1) == sizeof(header2) + frameBytes);
+        CHECK(!reader.hasChecksums());
+        checkFrames<float>(reader, true);
+    }
+
+    // A partial frame after the header
+    writeBytes(path, header2, sizeof(header2));
+    writeBytes(path, makeFrame<float>(0).data(), frameBytes + 4, true);
+    CHECK_THROWS(std::runtime_error, FrameReader reader(path), "does not match its legacy header");
+
+    // Six int32 header of the old converter (rows, cols, CV_32F, CV_32F, channels, bytes) and one frame
+    int32_t header6[6] = {static_cast<int32_t>(HEIGHT), static_cast<int32_t>(WIDTH), 5, 5, 1, static_cast<int32_t>(frameBytes)};
+    writeBytes(path, header6, sizeof(header6));
+    writeBytes(path, makeFrame<float>(0).data(), frameBytes, true);
+    {
+        FrameReader reader(path);
+        CHECK(reader.layout() == Layout::LegacyHeader6);
+        CHECK(reader.width() == WIDTH && reader.height() == HEIGHT);
+        CHECK(reader.frameCount() == 1);
+        CHECK(reader.frameOffset(0) == sizeof(header6));
+        checkFrames<float>(reader, false);
+    }
+
+    // The same header with the frame cut short
+    writeBytes(path, header6, sizeof(header6));
+    writeBytes(path, makeFrame<float>(0).data(), frameBytes - 4, true);
+    CHECK_THROWS(std::runtime_error, FrameReader reader(path), "is truncated: frame 0");
+    std::remove(path.c_str());
+}
+
+void testErrors() {
+    const std::string path = TestCheck::tempPath("errors.bin");
+    auto writeContainer = [&]() {
+        FrameWriter writer(path, WIDTH, HEIGHT, 1, PixelType::UInt8, true, 1);
+        for (size_t f = 0; f < NUM_FRAMES; ++f) {
+            writer.writeFrame(makeFrame<uint8_t>(f).data());
+        }
+        writer.close();
+    };
+    const uint64_t frameBytes = static_cast<uint64_t>(WIDTH) * HEIGHT;
+    const uint64_t offsetTable = HEADER_SIZE + NUM_FRAMES * frameBytes;
+
+    // Truncated files: in the header, in the tables (at the end of the file) and in a frame
+    writeContainer();
+    CHECK(truncate(path.c_str(), 32) == 0);
+    CHECK_THROWS(std::runtime_error, FrameReader reader(path), "the header needs 64 bytes");
+
+    writeContainer();
+    CHECK(truncate(path.c_str(), static_cast<off_t>(offsetTable + 8)) == 0);
+    CHECK_THROWS(std::runtime_error, FrameReader reader(path), "is truncated: the offset table");
+
+    writeContainer();
+    CHECK(truncate(path.c_str(), static_cast<off_t>(offsetTable + NUM_FRAMES * sizeof(uint64_t) + 4)) == 0);
+    CHECK_THROWS(std::runtime_error, FrameReader reader(path), "is truncated: the checksum table");
+
+    writeContainer();
+    uint64_t lastFrame = offsetTable; // Point the last frame past the end of the data
+    patchBytes(path, offsetTable + (NUM_FRAMES - 1) * sizeof(uint64_t), &lastFrame, sizeof(lastFrame));
+    CHECK(truncate(path.c_str(), static_cast<off_t>(offsetTable + NUM_FRAMES * (sizeof(uint64_t) + sizeof(uint32_t)))) == 0);
+    CHECK_THROWS(std::runtime_error, FrameReader reader(path), "is truncated: frame 2");
+
+    // Bad magic: not a container and not a legacy header either
+    writeContainer();
+    patchBytes(path, 0, "XXXX", 4);
+    CHECK_THROWS(std::runtime_error, FrameReader reader(path), "bad magic");
+    writeBytes(path, "VVD", 3);
+    CHECK_THROWS(std::runtime_error, FrameReader reader(path), "bad magic");
+
+    // Unsupported version
+    writeContainer();
+    uint16_t version = VERSION + 1;
+    patchBytes(path, 4, &version, sizeof(version));
+    CHECK_THROWS(std::runtime_error, FrameReader reader(path), "uses version " + std::to_string(VERSION + 1));
+
+    // Corrupted frame: only the frame whose checksum does not match fails, and only when it is verified
+    writeContainer();
+    {
+        FrameReader reader(path);
+        const unsigned char flipped = static_cast<unsigned char>(pixel(1, 10) ^ 0x01);
+        patchBytes(path, reader.frameOffset(1) + 10, &flipped, 1);
+        std::vector<uint8_t> frame(reader.frameBytes());
+        reader.readFrame(0, frame.data(), true);
+        reader.readFrame(1, frame.data(), false);
+        CHECK(frame[10] == flipped);
+        CHECK_THROWS(std::runtime_error, reader.readFrame(1, frame.data(), true), "checksum mismatch in frame 1");
+        CHECK_THROWS(std::runtime_error, reader.verifyFrame(1, frame.data()), "checksum mismatch in frame 1");
+    }
+
+    // Raw input that cannot hold a frame
+    writeBytes(path, makeFrame<uint8_t>(0).data(), frameBytes - 1);
+    CHECK_THROWS(std::runtime_error, FrameReader reader(path, WIDTH, HEIGHT, PixelType::UInt8), "is truncated");
+    std::remove(path.c_str());
+
+    CHECK_THROWS(std::runtime_error, FrameReader reader(path), "Failed to open");
+}
+} // namespace
+
+int main() {
+    // CRC-32 check value of the standard (zlib.crc32(b"123456789"))
+    CHECK(crc32("123456789", 9) == 0xCBF43926u);
+    CHECK(crc32("56789", 5, crc32("1234", 4)) == 0xCBF43926u);
+
+    testWriter<float>(PixelType::Float32, true, FRAME_ALIGNMENT);
+    testWriter<uint8_t>(PixelType::UInt8, false, 1);
+    testWriter<uint16_t>(PixelType::UInt16, true, 64);
+    testConverter();
+    testLegacy();
+    testErrors();
+    return TestCheck::report("test_frame_container");
+}
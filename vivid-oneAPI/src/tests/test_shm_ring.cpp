@@ -0,0 +1,256 @@
+/**
+ * @file test_shm_ring.cpp
+ * @brief Test of the shared memory input: forks shm_producer and consumes its frames with SharedFrameRing::Consumer,
+ * checking their order and content, the backpressure of the ring, the end of the stream and what the producer does
+ * when it is interrupted or when the consumer goes away.
+ *
+ * Usage: ./test_shm_ring [path of shm_producer] (default: ./shm_producer)
+ */
+#include "FrameContainer.hpp"
+#include "SharedFrameRing.hpp"
+#include "TestCheck.hpp"
+#include <chrono>
+#include <csignal>
+#include <cstdint>
+#include <cstring>
+#include <fcntl.h>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <sys/wait.h>
+#include <thread>
+#include <unistd.h>
+#include <vector>
+
+using namespace SharedFrameRing;
+
+namespace {
+constexpr uint32_t WIDTH = 64;
+constexpr uint32_t HEIGHT = 48;
+constexpr int TIMEOUT_MS = 10000; // Longest wait for the producer before the test gives up
+
+std::string producerPath = "./shm_producer";
+
+// Synthetic uint8 frame of shm_producer
+std::vector<unsigned char> syntheticFrame(uint32_t frame) {
+    std::vector<unsigned char> data(static_cast<size_t>(WIDTH) * HEIGHT);
+    for (uint32_t y = 0; y < HEIGHT; ++y) {
+        for (uint32_t x = 0; x < WIDTH; ++x) {
+            data[static_cast<size_t>(y) * WIDTH + x] = static_cast<unsigned char>((x + y + 4 * frame) & 0xFF);
+        }
+    }
+    return data;
+}
+
+std::vector<uint16_t> containerFrame(size_t frame) {
+    std::vector<uint16_t> data(static_cast<size_t>(WIDTH) * HEIGHT);
+    for (size_t i = 0; i < data.size(); ++i) {
+        data[i] = static_cast<uint16_t>(i * 97 + frame * 4099);
+    }
+    return data;
+}
+
+std::string ringName(const std::string &scenario) {
+    return "vivid_test_" + std::to_string(getpid()) + "_" + scenario;
+}
+
+pid_t startProducer(const std::vector<std::string> &args) {
+    pid_t pid = fork();
+    if (pid == 0) {
+        int null = open("/dev/null", O_WRONLY);
+        dup2(null, STDOUT_FILENO); // Keep the errors, drop the progress messages
+        std::vector<char *> argv{const_cast<char *>(producerPath.c_str())};
+        for (const std::string &arg : args) {
+            argv.push_back(const_cast<char *>(arg.c_str()));
+        }
+        argv.push_back(nullptr);
+        execv(producerPath.c_str(), argv.data());
+        _exit(127);
+    }
+    return pid;
+}
+
+/**
+ * @brief Wait for the producer to exit.
+ * @return Its exit status, or -1 if it was still running after TIMEOUT_MS (it is killed).
+ */
+int waitExit(pid_t pid) {
+    auto deadline = std::chrono::steady_clock::now() + std::chrono::milliseconds(TIMEOUT_MS);
+    int status = 0;
+    while (waitpid(pid, &status, WNOHANG) == 0) {
+        if (std::chrono::steady_clock::now() > deadline) {
+            kill(pid, SIGKILL);
+            waitpid(pid, &status, 0);
+            return -1;
+        }
+        std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    }
+    return WIFEXITED(status) ? WEXITSTATUS(status) : -1;
+}
+
+// Attach to the ring once the producer has created it (nullptr if it never does, the producer is killed)
+std::unique_ptr<Consumer> attach(const std::string &name, pid_t producer) {
+    auto deadline = std::chrono::steady_clock::now() + std::chrono::milliseconds(TIMEOUT_MS);
+    while (true) {
+        try {
+            return std::make_unique<Consumer>(name);
+        } catch (const std::invalid_argument &e) {
+            if (std::chrono::steady_clock::now() > deadline || waitpid(producer, nullptr, WNOHANG) != 0) {
+                TestCheck::fail(__FILE__, __LINE__, std::string("the producer did not create the ring: ") + e.what());
+                kill(producer, SIGKILL);
+                waitpid(producer, nullptr, 0);
+                return nullptr;
+            }
+            std::this_thread::sleep_for(std::chrono::milliseconds(5));
+        }
+    }
+}
+
+// Wait for a frame, or for the end of the stream (a timeout means the producer hangs)
+WaitResult waitFrame(Consumer &consumer, uint32_t index) {
+    auto deadline = std::chrono::steady_clock::now() + std::chrono::milliseconds(TIMEOUT_MS);
+    WaitResult result;
+    while ((result = consumer.waitFrame(index, POLL_MS)) == WaitResult::Timeout && std::chrono::steady_clock::now() < deadline) {
+    }
+    return result;
+}
+
+bool sameFrame(Consumer &consumer, uint32_t index, const void *expected) {
+    return std::memcmp(consumer.slotData(index & (consumer.slots() - 1)), expected, consumer.frameBytes()) == 0;
+}
+
+// Synthetic frames: order, content, backpressure and end of the stream after --count frames
+void testSynthetic() {
+    const std::string name = ringName("synthetic");
+    constexpr uint32_t SLOTS = 4;
+    constexpr uint32_t COUNT = 50;
+    pid_t producer = startProducer({"--name", name, "--size", std::to_string(WIDTH) + "x" + std::to_string(HEIGHT), "--format", "uint8", "--slots",
+                                    std::to_string(SLOTS), "--count", std::to_string(COUNT)});
+    std::unique_ptr<Consumer> consumer = attach(name, producer);
+    if (!consumer) {
+        return;
+    }
+    CHECK(consumer->width() == WIDTH && consumer->height() == HEIGHT);
+    CHECK(consumer->pixelType() == PixelType::UInt8);
+    CHECK(consumer->slots() == SLOTS);
+    CHECK(consumer->frameBytes() == static_cast<size_t>(WIDTH) * HEIGHT);
+    CHECK(consumer->firstFrame() == 0);
+
+    // Hold a full ring: the producer cannot publish another frame nor overwrite the held ones
+    for (uint32_t i = 0; i < SLOTS; ++i) {
+        CHECK(waitFrame(*consumer, i) == WaitResult::Ready);
+    }
+    CHECK(consumer->waitFrame(SLOTS, 300) == WaitResult::Timeout);
+    CHECK(!consumer->available(SLOTS));
+    for (uint32_t i = 0; i < SLOTS; ++i) {
+        CHECK(sameFrame(*consumer, i, syntheticFrame(i).data()));
+    }
+
+    // Then take the frames one by one, in order
+    size_t wrong = 0;
+    for (uint32_t i = 0; i < COUNT; ++i) {
+        if (waitFrame(*consumer, i) != WaitResult::Ready) {
+            TestCheck::fail(__FILE__, __LINE__, "frame " + std::to_string(i) + " was not published");
+            break;
+        }
+        wrong += sameFrame(*consumer, i, syntheticFrame(i).data()) ? 0 : 1;
+        consumer->releaseUntil(i + 1);
+        CHECK(consumer->firstFrame() == i + 1);
+    }
+    CHECK(wrong == 0);
+
+    // End of the stream: the producer leaves after --count frames and the next frame never comes
+    CHECK(waitFrame(*consumer, COUNT) == WaitResult::Closed);
+    CHECK(waitExit(producer) == 0);
+    CHECK_THROWS(std::invalid_argument, Consumer another(name), "not found"); // The name is removed with the producer
+}
+
+// Frames of a container, published in a loop
+void testContainer() {
+    const std::string name = ringName("container");
+    const std::string path = TestCheck::tempPath("shm_input.bin");
+    constexpr size_t FRAMES = 3;
+    constexpr uint32_t COUNT = 8;
+    {
+        FrameContainer::FrameWriter writer(path, WIDTH, HEIGHT, 1, PixelType::UInt16);
+        for (size_t f = 0; f < FRAMES; ++f) {
+            writer.writeFrame(containerFrame(f).data());
+        }
+        writer.close();
+    }
+    pid_t producer = startProducer({"--name", name, "--input", path, "--slots", "2", "--count", std::to_string(COUNT)});
+    std::unique_ptr<Consumer> consumer = attach(name, producer);
+    if (!consumer) {
+        std::remove(path.c_str());
+        return;
+    }
+    CHECK(consumer->pixelType() == PixelType::UInt16);
+    CHECK(consumer->frameBytes() == static_cast<size_t>(WIDTH) * HEIGHT * sizeof(uint16_t));
+    for (uint32_t i = 0; i < COUNT; ++i) {
+        if (waitFrame(*consumer, i) != WaitResult::Ready) {
+            TestCheck::fail(__FILE__, __LINE__, "frame " + std::to_string(i) + " of the container was not published");
+            break;
+        }
+        CHECK(sameFrame(*consumer, i, containerFrame(i % FRAMES).data()));
+        consumer->releaseUntil(i + 1);
+    }
+    CHECK(waitFrame(*consumer, COUNT) == WaitResult::Closed);
+    CHECK(waitExit(producer) == 0);
+    std::remove(path.c_str());
+}
+
+// Ctrl+C: the producer stops cleanly and the frames it published can still be read before the end of the stream
+void testInterrupted() {
+    const std::string name = ringName("interrupted");
+    pid_t producer = startProducer({"--name", name, "--size", std::to_string(WIDTH) + "x" + std::to_string(HEIGHT), "--format", "uint8", "--slots", "8"});
+    std::unique_ptr<Consumer> consumer = attach(name, producer);
+    if (!consumer) {
+        return;
+    }
+    uint32_t next = 0;
+    for (; next < 20; ++next) {
+        CHECK(waitFrame(*consumer, next) == WaitResult::Ready);
+        consumer->releaseUntil(next + 1);
+    }
+    kill(producer, SIGINT);
+    CHECK(waitExit(producer) == 0);
+    size_t wrong = 0;
+    while (waitFrame(*consumer, next) == WaitResult::Ready) {
+        wrong += sameFrame(*consumer, next, syntheticFrame(next).data()) ? 0 : 1;
+        consumer->releaseUntil(++next);
+    }
+    CHECK(wrong == 0);
+    CHECK(next >= 20 && next <= 20 + 8); // What was in the ring, never more
+}
+
+// The consumer goes away with the ring full: the producer notices and leaves instead of waiting forever
+void testConsumerGone() {
+    const std::string name = ringName("gone");
+    pid_t producer = startProducer({"--name", name, "--size", std::to_string(WIDTH) + "x" + std::to_string(HEIGHT), "--format", "uint8", "--slots", "4"});
+    {
+        std::unique_ptr<Consumer> consumer = attach(name, producer);
+    if (!consumer) {
+        return;
+    }
+        CHECK(waitFrame(*consumer, 0) == WaitResult::Ready);
+        consumer->releaseUntil(1);
+    }
+    CHECK(waitExit(producer) == 0);
+}
+} // namespace
+
+int main(int argc, char *argv[]) {
+    if (argc > 1) {
+        producerPath = argv[1];
+    }
+    if (access(producerPath.c_str(), X_OK) != 0) {
+        std::cerr << "test_shm_ring: " << producerPath << " not found (make shm_producer)" << std::endl;
+        return EXIT_FAILURE;
+    }
+    CHECK_THROWS(std::invalid_argument, Consumer consumer(ringName("missing")), "not found");
+    testSynthetic();
+    testContainer();
+    testInterrupted();
+    testConsumerGone();
+    return TestCheck::report("test_shm_ring");
+}
@@ -0,0 +1,369 @@
+/**
+ * @file test_vivid_api.cpp
+ * @brief Test of the C API of libvivid (include/api/vivid.h): two pipelines run at the same time in the process, one
+ * delivering its results to a callback and the other polled in frame order, and each one must report its own frames,
+ * results and USM. Also the error codes of the calls, the timeouts of a stalled pipeline and its end (close, destroy).
+ */
+#include "vivid.h"
+#include "TestCheck.hpp"
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <functional>
+#include <map>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace {
+constexpr uint32_t WIDTH_A = 320; // The pipelines have different frames, so a result or a buffer of the other one shows
+constexpr uint32_t HEIGHT_A = 256;
+constexpr uint32_t WIDTH_B = 160;
+constexpr uint32_t HEIGHT_B = 136;
+constexpr size_t FRAMES_A = 30;
+constexpr size_t FRAMES_B = 20;
+constexpr size_t PATTERNS = 3; // Frame f has the pixels of pattern f % PATTERNS
+constexpr uint32_t TOP_K = 5;
+constexpr uint32_t CELL_SIZE = 8; // Detections are reported per cell of the histograms
+
+struct FrameResult {
+    uint64_t frameId = 0;
+    std::vector<vivid_detection> detections;
+};
+
+// Results in the order they were delivered
+struct Results {
+    std::mutex mutex;
+    std::vector<FrameResult> frames;
+
+    void add(const vivid_result &result) {
+        std::lock_guard<std::mutex> lock(mutex);
+        frames.push_back({result.frame_id, std::vector<vivid_detection>(result.detections, result.detections + result.count)});
+    }
+};
+
+void onResult(const vivid_result *result, void *userData) {
+    static_cast<Results *>(userData)->add(*result);
+}
+
+std::vector<uint8_t> makeFrame(uint32_t width, uint32_t height, size_t pattern) {
+    std::vector<uint8_t> pixels(static_cast<size_t>(width) * height);
+    for (size_t i = 0; i < pixels.size(); ++i) {
+        size_t x = i % width, y = i / width;
+        pixels[i] = static_cast<uint8_t>((x * (7 + pattern) + y * 3 + pattern * 50 + (x / 16) * (y / 16) * 11) & 0xFF);
+    }
+    return pixels;
+}
+
+vivid_config baseConfig(uint32_t width, uint32_t height) {
+    vivid_config config;
+    vivid_config_init(&config);
+    config.width = width;
+    config.height = height;
+    config.pixel_type = VIVID_PIXEL_UINT8;
+    config.config_stages = "CPU"; // Same device for every frame: the frames with the same pixels give the same detections
+    config.top_k = TOP_K;
+    return config;
+}
+
+vivid_pipeline *create(const vivid_config &config) {
+    char error[256];
+    vivid_pipeline *pipeline = nullptr;
+    vivid_status status = vivid_create(&config, &pipeline, error, sizeof(error));
+    if (status != VIVID_OK) {
+        TestCheck::fail(__FILE__, __LINE__, std::string("vivid_create: ") + vivid_status_string(status) + ": " + error);
+        return nullptr;
+    }
+    CHECK(pipeline != nullptr && error[0] == '\0');
+    return pipeline;
+}
+
+vivid_stats getStats(vivid_pipeline *pipeline) {
+    vivid_stats stats{};
+    stats.struct_size = sizeof(stats);
+    CHECK(vivid_get_stats(pipeline, &stats) == VIVID_OK);
+    return stats;
+}
+
+// Push the frames of a pipeline, waiting for room in its queue
+void pushFrames(vivid_pipeline *pipeline, uint32_t width, uint32_t height, size_t frames, std::vector<uint64_t> &ids) {
+    std::vector<std::vector<uint8_t>> patterns;
+    for (size_t p = 0; p < PATTERNS; ++p) {
+        patterns.push_back(makeFrame(width, height, p));
+    }
+    for (size_t f = 0; f < frames; ++f) {
+        uint64_t id = 0;
+        vivid_status status = vivid_push_frame(pipeline, patterns[f % PATTERNS].data(), -1, &id);
+        if (status != VIVID_OK) {
+            TestCheck::fail(__FILE__, __LINE__, std::string("vivid_push_frame: ") + vivid_status_string(status) + ": " + vivid_last_error(pipeline));
+            return;
+        }
+        ids.push_back(id);
+    }
+}
+
+void pollResults(vivid_pipeline *pipeline, Results &results, vivid_status &last) {
+    vivid_result result;
+    while ((last = vivid_poll(pipeline, &result, -1)) == VIVID_OK) {
+        results.add(result);
+    }
+}
+
+bool sameDetections(const std::vector<vivid_detection> &a, const std::vector<vivid_detection> &b) {
+    if (a.size() != b.size()) {
+        return false;
+    }
+    for (size_t i = 0; i < a.size(); ++i) {
+        if (a[i].x != b[i].x || a[i].y != b[i].y || a[i].cls != b[i].cls || a[i].score != b[i].score) {
+            return false;
+        }
+    }
+    return true;
+}
+
+/**
+ * @brief Check that a pipeline delivered one result per pushed frame, with detections inside its frames, sorted by
+ * score and equal for the frames with the same pixels.
+ */
+void checkResults(const char *name, const Results &results, const std::vector<uint64_t> &ids, uint32_t width, uint32_t height) {
+    std::map<uint64_t, size_t> patternOf; // Pattern of each pushed frame id
+    for (size_t f = 0; f < ids.size(); ++f) {
+        if (f > 0 && ids[f] <= ids[f - 1]) {
+            TestCheck::fail(__FILE__, __LINE__, std::string(name) + ": the frame ids do not grow with the pushes");
+        }
+        patternOf[ids[f]] = f % PATTERNS;
+    }
+    if (results.frames.size() != ids.size()) {
+        TestCheck::fail(__FILE__, __LINE__, std::string(name) + ": " + std::to_string(results.frames.size()) + " results for " + std::to_string(ids.size()) + " frames");
+    }
+
+    std::map<uint64_t, int> delivered;
+    std::vector<const FrameResult *> firstOfPattern(PATTERNS, nullptr);
+    size_t wrong = 0;
+    for (const FrameResult &result : results.frames) {
+        auto pattern = patternOf.find(result.frameId);
+        if (pattern == patternOf.end() || delivered[result.frameId]++ > 0) {
+            TestCheck::fail(__FILE__, __LINE__, std::string(name) + ": unexpected or repeated result of the frame " + std::to_string(result.frameId));
+            continue;
+        }
+        bool valid = result.detections.size() == TOP_K;
+        for (size_t i = 0; i < result.detections.size(); ++i) {
+            const vivid_detection &d = result.detections[i];
+            valid = valid && d.x < width && d.y < height && d.x % CELL_SIZE == 0 && d.y % CELL_SIZE == 0;
+            valid = valid && (i == 0 || result.detections[i - 1].score <= d.score);
+        }
+        const FrameResult *&first = firstOfPattern[pattern->second];
+        if (first == nullptr) {
+            first = &result;
+        } else {
+            valid = valid && sameDetections(first->detections, result.detections);
+        }
+        wrong += valid ? 0 : 1;
+    }
+    if (wrong > 0) {
+        TestCheck::fail(__FILE__, __LINE__, std::string(name) + ": " + std::to_string(wrong) + " result(s) with wrong detections");
+    }
+}
+
+void checkStats(const char *name, const vivid_stats &stats, size_t frames) {
+    if (stats.frames_pushed != frames || stats.frames_processed != frames || stats.results_dropped != 0) {
+        TestCheck::fail(__FILE__, __LINE__, std::string(name) + ": pushed " + std::to_string(stats.frames_pushed) + ", processed " + std::to_string(stats.frames_processed) + ", dropped " +
+                                                std::to_string(stats.results_dropped) + " (expected " + std::to_string(frames) + " frames)");
+    }
+    CHECK(stats.struct_size == sizeof(vivid_stats));
+    CHECK(stats.elapsed_s > 0.0 && stats.throughput_fps > 0.0);
+    CHECK(stats.usm_bytes > 0 && stats.usm_peak_bytes >= stats.usm_bytes);
+}
+
+// Versions, status names and the calls that must fail without creating a pipeline
+void testArguments() {
+    CHECK(vivid_version() == ((VIVID_VERSION_MAJOR << 16) | VIVID_VERSION_MINOR));
+    CHECK(std::string(vivid_status_string(VIVID_OK)) == "ok");
+    CHECK(std::string(vivid_status_string(VIVID_ERROR_INVALID_ARGUMENT)) == "invalid argument");
+    CHECK(std::string(vivid_status_string(VIVID_ERROR_RUNTIME)) == "runtime error");
+    CHECK(std::string(vivid_status_string(VIVID_ERROR_TIMEOUT)) == "timeout");
+    CHECK(std::string(vivid_status_string(VIVID_ERROR_CLOSED)) == "closed");
+    CHECK(std::string(vivid_status_string(static_cast<vivid_status>(42))) == "unknown status");
+
+    vivid_config_init(nullptr);
+    vivid_config config = baseConfig(WIDTH_B, HEIGHT_B);
+    CHECK(config.struct_size == sizeof(vivid_config) && config.api == VIVID_API_PIPELINE && config.callback == nullptr);
+
+    char error[256];
+    vivid_pipeline *pipeline = reinterpret_cast<vivid_pipeline *>(&config); // Must be reset on failure
+    auto createFails = [&](const vivid_config *c, const char *message) {
+        vivid_status status = vivid_create(c, &pipeline, error, sizeof(error));
+        bool failed = status == VIVID_ERROR_INVALID_ARGUMENT && pipeline == nullptr && std::string(error).find(message) != std::string::npos;
+        if (!failed) {
+            TestCheck::fail(__FILE__, __LINE__, std::string("vivid_create returned ") + vivid_status_string(status) + " \"" + error + "\" (expected \"" + message + "\")");
+        }
+        if (status == VIVID_OK) {
+            vivid_destroy(pipeline);
+        }
+    };
+    CHECK(vivid_create(&config, nullptr, error, sizeof(error)) == VIVID_ERROR_INVALID_ARGUMENT && std::string(error).find("pipeline is NULL") != std::string::npos);
+    createFails(nullptr, "vivid_config_init");
+    vivid_config bad = config;
+    bad.struct_size = 0;
+    createFails(&bad, "vivid_config_init");
+    bad = config;
+    bad.api = static_cast<vivid_api>(42);
+    createFails(&bad, "unknown api");
+    bad = config;
+    bad.pixel_type = static_cast<vivid_pixel_type>(0);
+    createFails(&bad, "unknown pixel_type");
+    bad = config;
+    bad.width = 32;
+    createFails(&bad, "at least");
+    bad = config;
+    bad.stages = " , ";
+    createFails(&bad, "at least one stage");
+
+    // The description is cut to the buffer, and no buffer is fine
+    char small[8];
+    bad = config;
+    bad.api = static_cast<vivid_api>(42);
+    CHECK(vivid_create(&bad, &pipeline, small, sizeof(small)) == VIVID_ERROR_INVALID_ARGUMENT && std::strlen(small) == sizeof(small) - 1);
+    CHECK(vivid_create(&bad, &pipeline, nullptr, 0) == VIVID_ERROR_INVALID_ARGUMENT);
+
+    uint8_t pixel = 0;
+    vivid_result result;
+    vivid_stats stats{};
+    stats.struct_size = sizeof(stats);
+    CHECK(vivid_push_frame(nullptr, &pixel, 0, nullptr) == VIVID_ERROR_INVALID_ARGUMENT);
+    CHECK(vivid_poll(nullptr, &result, 0) == VIVID_ERROR_INVALID_ARGUMENT);
+    CHECK(vivid_close(nullptr) == VIVID_ERROR_INVALID_ARGUMENT);
+    CHECK(vivid_get_stats(nullptr, &stats) == VIVID_ERROR_INVALID_ARGUMENT);
+    CHECK(std::string(vivid_last_error(nullptr)).empty());
+    vivid_destroy(nullptr);
+}
+
+/**
+ * @brief Two pipelines at the same time: A delivers to a callback, B is polled in frame order (in_order) by another
+ * thread, and both are fed at once from their own threads.
+ */
+void testTwoPipelines() {
+    Results resultsA, resultsB;
+    vivid_config configA = baseConfig(WIDTH_A, HEIGHT_A);
+    configA.callback = onResult;
+    configA.user_data = &resultsA;
+    vivid_config configB = baseConfig(WIDTH_B, HEIGHT_B);
+    configB.api = VIVID_API_FGFN;
+    configB.in_order = 1;
+    vivid_pipeline *a = create(configA);
+    vivid_pipeline *b = create(configB);
+    if (a == nullptr || b == nullptr) {
+        vivid_destroy(a);
+        vivid_destroy(b);
+        return;
+    }
+
+    // Calls that do not fit the pipeline
+    vivid_result result;
+    vivid_stats stats{};
+    CHECK(vivid_poll(a, &result, 0) == VIVID_ERROR_INVALID_ARGUMENT); // It has a callback
+    CHECK(vivid_poll(b, nullptr, 0) == VIVID_ERROR_INVALID_ARGUMENT);
+    CHECK(vivid_push_frame(b, nullptr, 0, nullptr) == VIVID_ERROR_INVALID_ARGUMENT);
+    CHECK(vivid_get_stats(b, nullptr) == VIVID_ERROR_INVALID_ARGUMENT);
+    CHECK(vivid_get_stats(b, &stats) == VIVID_ERROR_INVALID_ARGUMENT); // struct_size is 0
+    // Nothing pushed yet: nothing to poll
+    CHECK(vivid_poll(b, &result, 0) == VIVID_ERROR_TIMEOUT);
+    CHECK(vivid_poll(b, &result, 20) == VIVID_ERROR_TIMEOUT);
+
+    vivid_status pollStatus = VIVID_OK;
+    std::thread poller(pollResults, b, std::ref(resultsB), std::ref(pollStatus));
+    std::vector<uint64_t> idsA, idsB;
+    std::thread pusherA(pushFrames, a, WIDTH_A, HEIGHT_A, FRAMES_A, std::ref(idsA));
+    std::thread pusherB(pushFrames, b, WIDTH_B, HEIGHT_B, FRAMES_B, std::ref(idsB));
+    pusherA.join();
+    pusherB.join();
+    CHECK(vivid_close(a) == VIVID_OK);
+    CHECK(vivid_close(b) == VIVID_OK);
+    poller.join();
+    CHECK(pollStatus == VIVID_ERROR_CLOSED);
+
+    // Results: each pipeline only has its own frames
+    checkResults("callback", resultsA, idsA, WIDTH_A, HEIGHT_A);
+    checkResults("poll", resultsB, idsB, WIDTH_B, HEIGHT_B);
+    for (size_t i = 1; i < resultsB.frames.size(); ++i) {
+        if (resultsB.frames[i].frameId < resultsB.frames[i - 1].frameId) {
+            TestCheck::fail(__FILE__, __LINE__, "in_order: the frame " + std::to_string(resultsB.frames[i].frameId) + " was delivered after the frame " +
+                                                    std::to_string(resultsB.frames[i - 1].frameId));
+            break;
+        }
+    }
+
+    // Statistics: each pipeline counts its own frames and its own USM (A has the larger frames)
+    vivid_stats statsA = getStats(a);
+    vivid_stats statsB = getStats(b);
+    checkStats("callback", statsA, FRAMES_A);
+    checkStats("poll", statsB, FRAMES_B);
+    CHECK(statsA.reorder_held == 0 && statsA.reorder_wait_ms == 0.0);
+    CHECK(statsA.usm_peak_bytes > statsB.usm_peak_bytes);
+    CHECK(getStats(a).elapsed_s == statsA.elapsed_s); // Stopped by vivid_close()
+
+    // An application built with an older vivid.h only gets the fields it knows
+    vivid_stats older;
+    std::memset(&older, 0xAB, sizeof(older));
+    older.struct_size = offsetof(vivid_stats, frames_processed);
+    CHECK(vivid_get_stats(a, &older) == VIVID_OK);
+    CHECK(older.struct_size == offsetof(vivid_stats, frames_processed) && older.frames_pushed == FRAMES_A);
+    std::vector<unsigned char> untouched(sizeof(older) - offsetof(vivid_stats, frames_processed), 0xAB);
+    CHECK(std::memcmp(reinterpret_cast<unsigned char *>(&older) + offsetof(vivid_stats, frames_processed), untouched.data(), untouched.size()) == 0);
+
+    // Closed: no more frames, nothing more to poll, closing again is fine
+    std::vector<uint8_t> frameA = makeFrame(WIDTH_A, HEIGHT_A, 0);
+    std::vector<uint8_t> frameB = makeFrame(WIDTH_B, HEIGHT_B, 0);
+    CHECK(vivid_push_frame(a, frameA.data(), 0, nullptr) == VIVID_ERROR_CLOSED);
+    CHECK(vivid_push_frame(b, frameB.data(), -1, nullptr) == VIVID_ERROR_CLOSED);
+    CHECK(vivid_poll(b, &result, -1) == VIVID_ERROR_CLOSED);
+    CHECK(vivid_close(a) == VIVID_OK);
+    CHECK(std::string(vivid_last_error(a)).empty() && std::string(vivid_last_error(b)).empty());
+
+    // Destroying B frees its USM, not the one of A
+    vivid_destroy(b);
+    CHECK(getStats(a).usm_bytes == statsA.usm_bytes);
+    {
+        std::lock_guard<std::mutex> lock(resultsA.mutex);
+        CHECK(resultsA.frames.size() == FRAMES_A); // No callback after vivid_close()
+    }
+    vivid_destroy(a);
+}
+
+/**
+ * @brief Nobody polls: the results fill result_depth, the pipeline stops taking frames and the pushes time out. The
+ * pipeline is then destroyed with its results still waiting.
+ */
+void testStalled() {
+    vivid_config config = baseConfig(WIDTH_B, HEIGHT_B);
+    config.result_depth = 1;
+    config.queue_depth = 1;
+    vivid_pipeline *pipeline = create(config);
+    if (pipeline == nullptr) {
+        return;
+    }
+    std::vector<uint8_t> frame = makeFrame(WIDTH_B, HEIGHT_B, 0);
+    constexpr size_t MAX_PUSHES = 1000; // Far more than the items, queues and results of the pipeline
+    size_t pushed = 0;
+    vivid_status status = VIVID_OK;
+    while (pushed < MAX_PUSHES && (status = vivid_push_frame(pipeline, frame.data(), 100, nullptr)) == VIVID_OK) {
+        pushed++;
+    }
+    CHECK(status == VIVID_ERROR_TIMEOUT);
+    CHECK(vivid_push_frame(pipeline, frame.data(), 0, nullptr) == VIVID_ERROR_TIMEOUT);
+    CHECK(getStats(pipeline).frames_pushed == pushed);
+
+    // A poll makes room for one more result, not for the whole stream
+    vivid_result result;
+    CHECK(vivid_poll(pipeline, &result, -1) == VIVID_OK && result.count == TOP_K);
+    vivid_destroy(pipeline); // Must not wait for the results nobody polls
+}
+} // namespace
+
+int main() {
+    testArguments();
+    testTwoPipelines();
+    testStalled();
+    return TestCheck::report("test_vivid_api");
+}
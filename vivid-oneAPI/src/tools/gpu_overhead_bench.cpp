@@ -0,0 +1,204 @@
+/**
+ * @file gpu_overhead_bench.cpp
+ * @brief Microbenchmark of the per-item cost of handing a GPU stage over, with an empty kernel.
+ *
+ * Usage:
+ *   ./gpu_overhead_bench --items 20000 --inflight 8 --chain 3
+ *
+ * Modes (the item is a single_task that does nothing, so the times are pure overhead):
+ *  - arena: a task_arena is created per item and the kernel is submitted and waited for inside it (what the async
+ *    nodes of --api fgan used to do).
+ *  - blocking: the kernel is submitted and waited for on the calling thread (--gpu-blocking).
+ *  - completion: the kernel is submitted and handed to GPUCompletion, which runs the completion of the item; up to
+ *    --inflight items are pending at the same time (what --api fgan and pipeline do now).
+ *  - chain: the item is --chain kernels, each one depending on the previous one, submitted one by one (what --api
+ *    syclevents does for a frame that runs whole on the GPU).
+ *  - graph: the same chain recorded once as a SYCL graph and replayed per item (--gpu-graph). Only if the compiler and
+ *    the device support graphs.
+ *
+ * For each mode it reports the time the submitting thread spends per item and the items completed per second.
+ */
+#include "CLI11.hpp"
+#include "GPUCompletion.hpp"
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <iostream>
+#include <oneapi/tbb/task_arena.h>
+#include <sycl/sycl.hpp>
+#include <thread>
+#include <vector>
+
+namespace {
+using Clock = std::chrono::steady_clock;
+
+struct Result {
+    double busyPerItem; //< Time of the submitting thread per item (us)
+    double itemsPerSecond;
+};
+
+sycl::event emptyKernel(sycl::queue &Q, const std::vector<sycl::event> &depends_on) {
+    return Q.submit([&](sycl::handler &h) {
+        if (!depends_on.empty()) {
+            h.depends_on(depends_on);
+        }
+        h.single_task([] {});
+    });
+}
+
+Result runArena(sycl::queue &Q, size_t items) {
+    std::vector<sycl::event> none;
+    Clock::time_point start = Clock::now();
+    for (size_t i = 0; i < items; ++i) {
+        tbb::task_arena arena;
+        arena.initialize(1, 0);
+        arena.execute([&] { emptyKernel(Q, none).wait(); });
+    }
+    double seconds = std::chrono::duration<double>(Clock::now() - start).count();
+    return {seconds * 1e6 / items, items / seconds};
+}
+
+Result runBlocking(sycl::queue &Q, size_t items) {
+    std::vector<sycl::event> none;
+    Clock::time_point start = Clock::now();
+    for (size_t i = 0; i < items; ++i) {
+        emptyKernel(Q, none).wait();
+    }
+    double seconds = std::chrono::duration<double>(Clock::now() - start).count();
+    return {seconds * 1e6 / items, items / seconds};
+}
+
+// Submit the chain of an item: each kernel depends on the previous one (the last one is returned)
+sycl::event submitChain(sycl::queue &Q, size_t chain, std::vector<sycl::event> &previous) {
+    previous.clear();
+    sycl::event event;
+    for (size_t k = 0; k < chain; ++k) {
+        event = emptyKernel(Q, previous);
+        previous.assign(1, event);
+    }
+    return event;
+}
+
+// The chains of consecutive items are independent; the submitting thread waits for an item every `inflight` items
+Result runChain(sycl::queue &Q, size_t items, size_t chain, size_t inflight) {
+    std::vector<sycl::event> previous, pending;
+    double busy = 0.0;
+    Clock::time_point start = Clock::now();
+    for (size_t i = 0; i < items; ++i) {
+        if (pending.size() == inflight) {
+            sycl::event::wait(pending);
+            pending.clear();
+        }
+        Clock::time_point submit = Clock::now();
+        pending.push_back(submitChain(Q, chain, previous));
+        busy += std::chrono::duration<double>(Clock::now() - submit).count();
+    }
+    sycl::event::wait(pending);
+    double seconds = std::chrono::duration<double>(Clock::now() - start).count();
+    return {busy * 1e6 / items, items / seconds};
+}
+
+#ifdef SYCL_EXT_ONEAPI_GRAPH
+bool graphsSupported(const sycl::queue &Q) {
+    const sycl::device device = Q.get_device();
+    return device.is_gpu() && (device.has(sycl::aspect::ext_oneapi_limited_graph) || device.has(sycl::aspect::ext_oneapi_graph));
+}
+
+Result runGraph(sycl::queue &Q, size_t items, size_t chain, size_t inflight) {
+    namespace sycl_exp = sycl::ext::oneapi::experimental;
+    // Record on a queue of its own, as StageGraphs does
+    sycl::queue recordQueue{Q.get_context(), Q.get_device()};
+    sycl_exp::command_graph<sycl_exp::graph_state::modifiable> graph{Q.get_context(), Q.get_device()};
+    std::vector<sycl::event> previous, pending;
+    graph.begin_recording(recordQueue);
+    submitChain(recordQueue, chain, previous);
+    graph.end_recording(recordQueue);
+    auto executable = graph.finalize();
+
+    double busy = 0.0;
+    Clock::time_point start = Clock::now();
+    for (size_t i = 0; i < items; ++i) {
+        if (pending.size() == inflight) {
+            sycl::event::wait(pending);
+            pending.clear();
+        }
+        Clock::time_point submit = Clock::now();
+        pending.push_back(Q.ext_oneapi_graph(executable));
+        busy += std::chrono::duration<double>(Clock::now() - submit).count();
+    }
+    sycl::event::wait(pending);
+    double seconds = std::chrono::duration<double>(Clock::now() - start).count();
+    return {busy * 1e6 / items, items / seconds};
+}
+#endif
+
+Result runCompletion(sycl::queue &Q, size_t items, size_t inflight) {
+    std::vector<sycl::event> none;
+    std::atomic<size_t> completed{0};
+    auto done = [](void *context, void *, const sycl::event &) { static_cast<std::atomic<size_t> *>(context)->fetch_add(1, std::memory_order_release); };
+
+    GPUCompletion completion;
+    double busy = 0.0;
+    Clock::time_point start = Clock::now();
+    for (size_t i = 0; i < items; ++i) {
+        // Keep at most inflight items pending, as the tokens of the pipeline do (the wait is not counted as busy)
+        while (i - completed.load(std::memory_order_acquire) >= inflight) {
+            std::this_thread::yield();
+        }
+        Clock::time_point submit = Clock::now();
+        completion.notify(emptyKernel(Q, none), done, &completed, nullptr);
+        busy += std::chrono::duration<double>(Clock::now() - submit).count();
+    }
+    while (completed.load(std::memory_order_acquire) < items) {
+        std::this_thread::yield();
+    }
+    double seconds = std::chrono::duration<double>(Clock::now() - start).count();
+    return {busy * 1e6 / items, items / seconds};
+}
+
+void print(const char *mode, const Result &result) {
+    std::printf(" %-12s %14.2f %16.0f\n", mode, result.busyPerItem, result.itemsPerSecond);
+}
+} // namespace
+
+int main(int argc, char *argv[]) {
+    CLI::App app{"gpu_overhead_bench: per-item cost of handing a GPU stage over to the device"};
+    size_t items = 20000;
+    size_t inflight = 8;
+    size_t chain = 3;
+    app.add_option("--items", items, "Number of empty kernels per mode")->check(CLI::PositiveNumber);
+    app.add_option("--inflight", inflight, "Items pending at the same time in the completion, chain and graph modes")->check(CLI::PositiveNumber);
+    app.add_option("--chain", chain, "Kernels per item in the chain and graph modes (the stages of a frame)")->check(CLI::PositiveNumber);
+    try {
+        app.parse(argc, argv);
+    } catch (const CLI::ParseError &e) {
+        return app.exit(e);
+    }
+
+    try {
+        sycl::queue Q{sycl::gpu_selector_v, sycl::property::queue::in_order()};
+        std::cout << " Device: " << Q.get_device().get_info<sycl::info::device::name>() << std::endl;
+
+        // Warm up the queue (the first submissions build the kernel)
+        runBlocking(Q, 100);
+
+        std::printf(" %-12s %14s %16s\n", "Mode", "Busy (us/item)", "Items per second");
+        print("arena", runArena(Q, items));
+        print("blocking", runBlocking(Q, items));
+        print("completion", runCompletion(Q, items, inflight));
+        print("chain", runChain(Q, items, chain, inflight));
+#ifdef SYCL_EXT_ONEAPI_GRAPH
+        if (graphsSupported(Q)) {
+            print("graph", runGraph(Q, items, chain, inflight));
+        } else {
+            std::cout << " graph: not supported by " << Q.get_device().get_info<sycl::info::device::name>() << std::endl;
+        }
+#else
+        std::cout << " graph: the compiler does not support sycl_ext_oneapi_graph" << std::endl;
+#endif
+    } catch (const std::exception &e) {
+        std::cerr << "Error: " << e.what() << std::endl;
+        return EXIT_FAILURE;
+    }
+    return EXIT_SUCCESS;
+}
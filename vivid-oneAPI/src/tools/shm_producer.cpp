@@ -0,0 +1,139 @@
+/**
+ * @file shm_producer.cpp
+ * @brief Test producer of a shared memory input: publishes frames in a SharedFrameRing as a capture process would.
+ *
+ * Usage:
+ *   ./shm_producer --name vivid --input media/frames.bin --fps 30    # frames of a container, in a loop
+ *   ./shm_producer --name vivid --size 1920x1080 --format uint8       # synthetic frames, as fast as they are taken
+ *   ./main --api pipeline --input shm:vivid --numframes 1000          # in another terminal
+ *
+ * The producer stops after --count frames (0: never), when the pipeline detaches with the ring full, or with Ctrl+C.
+ */
+#include "CLI11.hpp"
+#include "FrameContainer.hpp"
+#include "SharedFrameRing.hpp"
+#include <chrono>
+#include <csignal>
+#include <cstring>
+#include <iostream>
+#include <regex>
+#include <thread>
+
+namespace {
+volatile std::sig_atomic_t interrupted = 0;
+
+void onSignal(int) {
+    interrupted = 1;
+}
+
+// Moving diagonal gradient, so consecutive frames differ
+void syntheticFrame(unsigned char *dst, uint32_t width, uint32_t height, FrameContainer::PixelType type, uint32_t frame) {
+    for (uint32_t y = 0; y < height; ++y) {
+        for (uint32_t x = 0; x < width; ++x) {
+            uint32_t v = (x + y + 4 * frame) & 0xFF;
+            size_t i = static_cast<size_t>(y) * width + x;
+            switch (type) {
+            case FrameContainer::PixelType::UInt8:
+                dst[i] = static_cast<uint8_t>(v);
+                break;
+            case FrameContainer::PixelType::UInt16: {
+                uint16_t p = static_cast<uint16_t>(v << 8);
+                std::memcpy(dst + 2 * i, &p, sizeof(p));
+                break;
+            }
+            default: {
+                float p = static_cast<float>(v) / 255.0f;
+                std::memcpy(dst + 4 * i, &p, sizeof(p));
+                break;
+            }
+            }
+        }
+    }
+}
+} // namespace
+
+int main(int argc, char *argv[]) {
+    CLI::App app{"shm_producer: publishes frames in a shared memory ring for --input shm:NAME"};
+    std::string name = "vivid";
+    std::string inputPath;
+    std::string sizeStr = "1920x1080";
+    std::string formatStr = "float32";
+    uint32_t slots = 8;
+    double fps = 0.0;
+    uint64_t count = 0;
+    app.add_option("--name", name, "Name of the shared memory segment (the pipeline reads --input shm:NAME)");
+    app.add_option("--input", inputPath, "Container (.bin) whose frames are published in a loop (default: synthetic frames)");
+    app.add_option("--size", sizeStr, "Size of the synthetic frames as WIDTHxHEIGHT");
+    app.add_option("--format", formatStr, "Pixel type of the synthetic frames (float32, uint8 or uint16)")->check(CLI::IsMember({"float32", "uint8", "uint16"}));
+    app.add_option("--slots", slots, "Number of frames of the ring (power of two)")->check(CLI::PositiveNumber);
+    app.add_option("--fps", fps, "Frames published per second (0: as fast as the pipeline takes them)")->check(CLI::NonNegativeNumber);
+    app.add_option("--count", count, "Number of frames to publish (0: until interrupted)");
+    try {
+        app.parse(argc, argv);
+    } catch (const CLI::ParseError &e) {
+        return app.exit(e);
+    }
+
+    try {
+        std::unique_ptr<FrameContainer::FrameReader> reader;
+        uint32_t width, height;
+        FrameContainer::PixelType type;
+        if (!inputPath.empty()) {
+            reader = std::make_unique<FrameContainer::FrameReader>(inputPath);
+            if (reader->channels() != 1 || reader->frameCount() == 0) {
+                throw std::invalid_argument("The input must contain at least one single-channel frame");
+            }
+            width = reader->width();
+            height = reader->height();
+            type = reader->pixelType();
+        } else {
+            std::smatch match;
+            if (!std::regex_match(sizeStr, match, std::regex(R"((\d+)[xX](\d+))"))) {
+                throw std::invalid_argument("Invalid frame size format. Should be like '1920x1080'.");
+            }
+            width = static_cast<uint32_t>(std::stoul(match[1].str()));
+            height = static_cast<uint32_t>(std::stoul(match[2].str()));
+            type = formatStr == "uint8" ? FrameContainer::PixelType::UInt8 : formatStr == "uint16" ? FrameContainer::PixelType::UInt16 : FrameContainer::PixelType::Float32;
+        }
+
+        SharedFrameRing::Producer producer(name, width, height, type, slots);
+        std::signal(SIGINT, onSignal);
+        std::signal(SIGTERM, onSignal);
+        std::cout << "Publishing " << FrameContainer::pixelTypeName(type) << " frames of " << width << "x" << height << " in " << producer.name() << " (" << slots
+                  << " slots)" << std::endl;
+
+        using Clock = std::chrono::steady_clock;
+        Clock::time_point start = Clock::now();
+        uint64_t published = 0;
+        size_t waits = 0;
+        while (!interrupted && (count == 0 || published < count)) {
+            if (fps > 0.0) {
+                std::this_thread::sleep_until(start + std::chrono::duration_cast<Clock::duration>(std::chrono::duration<double>(published / fps)));
+            }
+            SharedFrameRing::WaitResult result = producer.waitSlot(SharedFrameRing::POLL_MS);
+            if (result == SharedFrameRing::WaitResult::Closed) {
+                std::cout << "The pipeline has detached" << std::endl;
+                break;
+            }
+            if (result == SharedFrameRing::WaitResult::Timeout) {
+                waits++;
+                continue;
+            }
+            if (reader) {
+                reader->readFrame(published % reader->frameCount(), producer.nextFrame());
+            } else {
+                syntheticFrame(producer.nextFrame(), width, height, type, static_cast<uint32_t>(published));
+            }
+            producer.publish();
+            published++;
+        }
+
+        double seconds = std::chrono::duration<double>(Clock::now() - start).count();
+        std::cout << "Published " << published << " frames in " << seconds << " s (" << (seconds > 0 ? published / seconds : 0.0) << " FPS, " << waits
+                  << " waits of " << SharedFrameRing::POLL_MS << " ms for a free slot)" << std::endl;
+    } catch (const std::exception &e) {
+        std::cerr << "Error: " << e.what() << std::endl;
+        return EXIT_FAILURE;
+    }
+    return EXIT_SUCCESS;
+}
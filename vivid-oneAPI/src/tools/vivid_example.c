@@ -0,0 +1,115 @@
+/*
+ * Example of libvivid: two pipelines in the same process, one delivering its results to a callback and the other
+ * polled by a second thread, both fed with synthetic 8-bit frames.
+ *
+ *   make libvivid.a vivid_example && ./vivid_example [frames] [width] [height]
+ */
+#include "vivid.h"
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+typedef struct {
+    unsigned long results;
+    unsigned long detections;
+} counters;
+
+static void on_result(const vivid_result *result, void *user_data) {
+    counters *c = (counters *)user_data;
+    c->results++;
+    c->detections += result->count;
+}
+
+static void *poll_results(void *arg) {
+    vivid_pipeline *pipeline = (vivid_pipeline *)arg;
+    vivid_result result;
+    unsigned long results = 0;
+    vivid_status status;
+    while ((status = vivid_poll(pipeline, &result, -1)) == VIVID_OK) {
+        if (results++ == 0 && result.count > 0) {
+            printf(" [poll] frame %llu: best window (%u, %u) class %u score %.3f\n", (unsigned long long)result.frame_id, result.detections[0].x, result.detections[0].y,
+                   result.detections[0].cls, result.detections[0].score);
+        }
+    }
+    printf(" [poll] %lu results (%s)\n", results, vivid_status_string(status));
+    return NULL;
+}
+
+static void print_stats(const char *name, vivid_pipeline *pipeline) {
+    vivid_stats stats;
+    stats.struct_size = sizeof(stats);
+    if (vivid_get_stats(pipeline, &stats) == VIVID_OK) {
+        printf(" [%s] pushed %llu, processed %llu, dropped %llu, %.2f fps, push waits %llu (%.1f ms), input stalls %llu (%.1f ms), peak USM %.1f MB\n", name,
+               (unsigned long long)stats.frames_pushed, (unsigned long long)stats.frames_processed, (unsigned long long)stats.results_dropped, stats.throughput_fps,
+               (unsigned long long)stats.push_waits, stats.push_wait_ms, (unsigned long long)stats.input_stalls, stats.input_stall_ms, stats.usm_peak_bytes / (1024.0 * 1024.0));
+    }
+}
+
+int main(int argc, char *argv[]) {
+    int frames = argc > 1 ? atoi(argv[1]) : 100;
+    uint32_t width = argc > 2 ? (uint32_t)atoi(argv[2]) : 1920;
+    uint32_t height = argc > 3 ? (uint32_t)atoi(argv[3]) : 1080;
+    char error[256];
+
+    printf("libvivid %u.%u\n", vivid_version() >> 16, vivid_version() & 0xffff);
+
+    vivid_config config;
+    vivid_config_init(&config);
+    config.width = width;
+    config.height = height;
+    config.pixel_type = VIVID_PIXEL_UINT8;
+
+    /* Pipeline A: results to a callback */
+    counters counted = {0, 0};
+    config.callback = on_result;
+    config.user_data = &counted;
+    vivid_pipeline *a;
+    if (vivid_create(&config, &a, error, sizeof(error)) != VIVID_OK) {
+        fprintf(stderr, "vivid_create: %s\n", error);
+        return EXIT_FAILURE;
+    }
+
+    /* Pipeline B: results polled by another thread */
+    config.api = VIVID_API_FGFN;
+    config.callback = NULL;
+    config.user_data = NULL;
+    vivid_pipeline *b;
+    if (vivid_create(&config, &b, error, sizeof(error)) != VIVID_OK) {
+        fprintf(stderr, "vivid_create: %s\n", error);
+        vivid_destroy(a);
+        return EXIT_FAILURE;
+    }
+    pthread_t poller;
+    pthread_create(&poller, NULL, poll_results, b);
+
+    uint8_t *pixels = malloc((size_t)width * height);
+    for (int f = 0; f < frames; f++) {
+        for (size_t i = 0; i < (size_t)width * height; i++) {
+            pixels[i] = (uint8_t)((i % width) * 7 + (i / width) * 3 + f);
+        }
+        uint64_t id;
+        vivid_status status = vivid_push_frame(a, pixels, -1, &id);
+        if (status == VIVID_OK) {
+            status = vivid_push_frame(b, pixels, -1, &id);
+        }
+        if (status != VIVID_OK) {
+            fprintf(stderr, "vivid_push_frame: %s %s\n", vivid_status_string(status), vivid_last_error(a));
+            break;
+        }
+    }
+    free(pixels);
+
+    vivid_status status_a = vivid_close(a);
+    vivid_status status_b = vivid_close(b);
+    pthread_join(poller, NULL);
+    printf(" [callback] %lu results, %lu detections (%s)\n", counted.results, counted.detections, vivid_status_string(status_a));
+    print_stats("callback", a);
+    print_stats("poll", b);
+    if (status_b != VIVID_OK) {
+        fprintf(stderr, " [poll] %s\n", vivid_last_error(b));
+    }
+
+    vivid_destroy(a);
+    vivid_destroy(b);
+    return status_a == VIVID_OK && status_b == VIVID_OK ? EXIT_SUCCESS : EXIT_FAILURE;
+}
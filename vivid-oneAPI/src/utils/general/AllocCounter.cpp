@@ -0,0 +1,136 @@
+/**
+ * @file AllocCounter.cpp
+ * @brief Implementation of the allocation audit counter (replacement of the global operator new/delete).
+ */
+#include "AllocCounter.hpp"
+#include <atomic>
+#include <cstdlib>
+#include <new>
+
+namespace {
+std::atomic<size_t> numAllocations{0}; // Number of allocations
+std::atomic<size_t> numBytes{0};       // Number of bytes allocated
+
+std::atomic<bool> steadyStarted{false};
+std::atomic<bool> steadyStopped{false};
+size_t startAllocations = 0, stopAllocations = 0;
+size_t startBytes = 0, stopBytes = 0;
+int startFrame = 0, stopFrame = 0;
+} // namespace
+
+#if ALLOCCOUNT_ENABLED
+namespace {
+void *countedAlloc(std::size_t size, std::size_t alignment) {
+    numAllocations.fetch_add(1, std::memory_order_relaxed);
+    numBytes.fetch_add(size, std::memory_order_relaxed);
+    if (size == 0) {
+        size = 1;
+    }
+    void *ptr = nullptr;
+    if (alignment > alignof(std::max_align_t)) {
+        // aligned_alloc requires the size to be a multiple of the alignment
+        ptr = std::aligned_alloc(alignment, (size + alignment - 1) / alignment * alignment);
+    } else {
+        ptr = std::malloc(size);
+    }
+    if (ptr == nullptr) {
+        throw std::bad_alloc();
+    }
+    return ptr;
+}
+} // namespace
+
+void *operator new(std::size_t size) {
+    return countedAlloc(size, alignof(std::max_align_t));
+}
+void *operator new[](std::size_t size) {
+    return countedAlloc(size, alignof(std::max_align_t));
+}
+void *operator new(std::size_t size, std::align_val_t al) {
+    return countedAlloc(size, static_cast<std::size_t>(al));
+}
+void *operator new[](std::size_t size, std::align_val_t al) {
+    return countedAlloc(size, static_cast<std::size_t>(al));
+}
+void *operator new(std::size_t size, const std::nothrow_t &) noexcept {
+    try {
+        return countedAlloc(size, alignof(std::max_align_t));
+    } catch (...) {
+        return nullptr;
+    }
+}
+void *operator new[](std::size_t size, const std::nothrow_t &) noexcept {
+    try {
+        return countedAlloc(size, alignof(std::max_align_t));
+    } catch (...) {
+        return nullptr;
+    }
+}
+void operator delete(void *ptr) noexcept {
+    std::free(ptr);
+}
+void operator delete[](void *ptr) noexcept {
+    std::free(ptr);
+}
+void operator delete(void *ptr, std::size_t) noexcept {
+    std::free(ptr);
+}
+void operator delete[](void *ptr, std::size_t) noexcept {
+    std::free(ptr);
+}
+void operator delete(void *ptr, std::align_val_t) noexcept {
+    std::free(ptr);
+}
+void operator delete[](void *ptr, std::align_val_t) noexcept {
+    std::free(ptr);
+}
+void operator delete(void *ptr, std::size_t, std::align_val_t) noexcept {
+    std::free(ptr);
+}
+void operator delete[](void *ptr, std::size_t, std::align_val_t) noexcept {
+    std::free(ptr);
+}
+#endif
+
+namespace AllocCounter {
+size_t allocations() noexcept {
+    return numAllocations.load(std::memory_order_relaxed);
+}
+
+size_t bytes() noexcept {
+    return numBytes.load(std::memory_order_relaxed);
+}
+
+void startSteadyState(int frame) noexcept {
+    if constexpr (ALLOCCOUNT_ENABLED) {
+        bool expected = false;
+        if (steadyStarted.compare_exchange_strong(expected, true)) {
+            startAllocations = allocations();
+            startBytes = bytes();
+            startFrame = frame;
+        }
+    }
+}
+
+void stopSteadyState(int frame) noexcept {
+    if constexpr (ALLOCCOUNT_ENABLED) {
+        if (steadyStarted.load() && !steadyStopped.exchange(true)) {
+            stopAllocations = allocations();
+            stopBytes = bytes();
+            stopFrame = frame;
+        }
+    }
+}
+
+bool hasSteadyState() noexcept {
+    return steadyStarted.load() && steadyStopped.load() && stopFrame > startFrame;
+}
+
+double allocationsPerFrame() noexcept {
+    return hasSteadyState() ? static_cast<double>(stopAllocations - startAllocations) / (stopFrame - startFrame) : 0.0;
+}
+
+double bytesPerFrame() noexcept {
+    return hasSteadyState() ? static_cast<double>(stopBytes - startBytes) / (stopFrame - startFrame) : 0.0;
+}
+} // namespace AllocCounter
@@ -0,0 +1,389 @@
+#include "AsyncReader.hpp"
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <condition_variable>
+#include <cstring>
+#include <linux/io_uring.h>
+#include <mutex>
+#include <stdexcept>
+#include <string>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <sys/uio.h>
+#include <thread>
+#include <unistd.h>
+#include <vector>
+
+const char *ioBackendName(IOBackend backend) {
+    switch (backend) {
+    case IOBackend::Auto:
+        return "auto";
+    case IOBackend::Uring:
+        return "io_uring";
+    case IOBackend::Pread:
+        return "pread";
+    case IOBackend::Sync:
+        return "sync";
+    }
+    return "unknown";
+}
+
+namespace {
+constexpr size_t MAX_READ_SIZE = size_t(1) << 30; // Largest single read (the length of an io_uring read is 32 bits)
+
+/**
+ * @brief Fixed-capacity FIFO (no allocations once created).
+ */
+template <typename T>
+class FixedQueue {
+  public:
+    explicit FixedQueue(size_t capacity) : items(capacity) {}
+    bool empty() const { return count == 0; }
+    void push(const T &item) {
+        items[(head + count++) % items.size()] = item;
+    }
+    T pop() {
+        T item = items[head];
+        head = (head + 1) % items.size();
+        --count;
+        return item;
+    }
+
+  private:
+    std::vector<T> items;
+    size_t head = 0;
+    size_t count = 0;
+};
+
+/**
+ * @brief Bytes of a request kept after a short read, from which the rest is read.
+ *
+ * O_DIRECT needs the position, the destination and the length of every read aligned to the block, so a read that
+ * stopped inside a block is resumed from the start of that block.
+ * @param request Request being read.
+ * @param done Bytes read so far (the request is not complete).
+ * @param resumed Bytes kept after the previous read; the new resume point must be past it.
+ * @param error Set to ENODATA if the data ends inside the block of the previous resume point.
+ * @return The resume point (0 on error).
+ */
+size_t resumePoint(const ReadRequest &request, size_t done, size_t resumed, int &error) {
+    size_t point = request.alignment > 0 ? done - done % request.alignment : done;
+    if (point <= resumed) {
+        error = ENODATA; // Not even one more block: O_DIRECT stopped at the end of the file
+        return 0;
+    }
+    return point;
+}
+
+// Read the whole range with pread (EINTR and short reads are retried)
+int readFully(const ReadRequest &request) {
+    char *dst = static_cast<char *>(request.dst);
+    size_t done = 0;
+    while (done < request.size) {
+        ssize_t r = ::pread(request.fd, dst + done, std::min(request.size - done, MAX_READ_SIZE), static_cast<off_t>(request.offset + done));
+        if (r < 0 && errno == EINTR) {
+            continue;
+        }
+        if (r < 0) {
+            return errno;
+        }
+        if (r == 0) {
+            return ENODATA;
+        }
+        if (done + static_cast<size_t>(r) < request.size) {
+            int error = 0;
+            done = resumePoint(request, done + static_cast<size_t>(r), done, error);
+            if (error != 0) {
+                return error;
+            }
+        } else {
+            done = request.size;
+        }
+    }
+    return 0;
+}
+
+// ____________________________________________________________________________________________________________________
+// sync: pread in the calling thread
+// ____________________________________________________________________________________________________________________
+class SyncReader final : public AsyncReader {
+  public:
+    explicit SyncReader(size_t capacity) : AsyncReader{capacity}, done{capacity} {}
+
+    IOBackend backend() const override { return IOBackend::Sync; }
+
+    void submit(const ReadRequest &request) override {
+        done.push({request.tag, readFully(request)});
+    }
+
+    ReadCompletion wait() override {
+        if (done.empty()) {
+            throw std::logic_error("AsyncReader: wait() without outstanding reads");
+        }
+        return done.pop();
+    }
+
+  private:
+    FixedQueue<ReadCompletion> done;
+};
+
+// ____________________________________________________________________________________________________________________
+// pread: one thread per outstanding read
+// ____________________________________________________________________________________________________________________
+class PreadReader final : public AsyncReader {
+  public:
+    explicit PreadReader(size_t capacity) : AsyncReader{capacity}, pending{capacity}, done{capacity} {
+        workers.reserve(capacity);
+        for (size_t i = 0; i < capacity; ++i) {
+            workers.emplace_back(&PreadReader::work, this);
+        }
+    }
+
+    ~PreadReader() override {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            stopping = true;
+        }
+        requestReady.notify_all();
+        for (auto &worker : workers) {
+            worker.join();
+        }
+    }
+
+    IOBackend backend() const override { return IOBackend::Pread; }
+
+    void submit(const ReadRequest &request) override {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            pending.push(request);
+        }
+        requestReady.notify_one();
+    }
+
+    ReadCompletion wait() override {
+        std::unique_lock<std::mutex> lock(mutex);
+        readDone.wait(lock, [this] { return !done.empty(); });
+        return done.pop();
+    }
+
+  private:
+    FixedQueue<ReadRequest> pending;
+    FixedQueue<ReadCompletion> done;
+    std::mutex mutex;
+    std::condition_variable requestReady;
+    std::condition_variable readDone;
+    bool stopping = false;
+    std::vector<std::thread> workers;
+
+    void work() {
+        while (true) {
+            ReadRequest request;
+            {
+                std::unique_lock<std::mutex> lock(mutex);
+                requestReady.wait(lock, [this] { return stopping || !pending.empty(); });
+                if (stopping) {
+                    return;
+                }
+                request = pending.pop();
+            }
+            int error = readFully(request);
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+                done.push({request.tag, error});
+            }
+            readDone.notify_one();
+        }
+    }
+};
+
+// ____________________________________________________________________________________________________________________
+// io_uring (raw system calls, the same protocol liburing implements)
+// ____________________________________________________________________________________________________________________
+class UringReader final : public AsyncReader {
+  public:
+    explicit UringReader(size_t capacity) : AsyncReader{capacity}, requests(capacity), freeRequests{capacity} {
+        io_uring_params params;
+        std::memset(&params, 0, sizeof(params));
+        ringFd = static_cast<int>(syscall(__NR_io_uring_setup, static_cast<unsigned>(capacity), &params));
+        if (ringFd < 0) {
+            throw std::runtime_error(std::string("io_uring is not available (") + std::strerror(errno) + ")");
+        }
+
+        sqRingSize = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+        cqRingSize = params.cq_off.cqes + params.cq_entries * sizeof(io_uring_cqe);
+        bool singleMmap = (params.features & IORING_FEAT_SINGLE_MMAP) != 0;
+        if (singleMmap) {
+            sqRingSize = cqRingSize = std::max(sqRingSize, cqRingSize);
+        }
+        sqRing = map(sqRingSize, IORING_OFF_SQ_RING);
+        cqRing = singleMmap ? sqRing : map(cqRingSize, IORING_OFF_CQ_RING);
+        sqesSize = params.sq_entries * sizeof(io_uring_sqe);
+        sqes = static_cast<io_uring_sqe *>(map(sqesSize, IORING_OFF_SQES));
+
+        char *sq = static_cast<char *>(sqRing);
+        char *cq = static_cast<char *>(cqRing);
+        sqTail = reinterpret_cast<unsigned *>(sq + params.sq_off.tail);
+        sqMask = *reinterpret_cast<unsigned *>(sq + params.sq_off.ring_mask);
+        sqArray = reinterpret_cast<unsigned *>(sq + params.sq_off.array);
+        cqHead = reinterpret_cast<unsigned *>(cq + params.cq_off.head);
+        cqTail = reinterpret_cast<unsigned *>(cq + params.cq_off.tail);
+        cqMask = *reinterpret_cast<unsigned *>(cq + params.cq_off.ring_mask);
+        cqes = reinterpret_cast<io_uring_cqe *>(cq + params.cq_off.cqes);
+
+        for (size_t i = 0; i < capacity; ++i) {
+            freeRequests.push(static_cast<unsigned>(i));
+        }
+    }
+
+    ~UringReader() override {
+        unmap();
+    }
+
+    IOBackend backend() const override { return IOBackend::Uring; }
+
+    void submit(const ReadRequest &request) override {
+        unsigned index = freeRequests.pop();
+        requests[index].request = request;
+        requests[index].done = 0;
+        queueRead(index);
+    }
+
+    ReadCompletion wait() override {
+        while (true) {
+            unsigned head = *cqHead;
+            if (head == std::atomic_ref<unsigned>(*cqTail).load(std::memory_order_acquire)) {
+                enter(0, 1, IORING_ENTER_GETEVENTS);
+                continue;
+            }
+            io_uring_cqe cqe = cqes[head & cqMask];
+            std::atomic_ref<unsigned>(*cqHead).store(head + 1, std::memory_order_release);
+
+            unsigned index = static_cast<unsigned>(cqe.user_data);
+            Pending &pending = requests[index];
+            int error = 0;
+            if (cqe.res == -EINTR || cqe.res == -EAGAIN) {
+                queueRead(index); // Retry the same range
+                continue;
+            } else if (cqe.res < 0) {
+                error = -cqe.res;
+            } else if (cqe.res == 0) {
+                error = ENODATA;
+            } else {
+                size_t done = pending.done + static_cast<size_t>(cqe.res);
+                if (done < pending.request.size) {
+                    pending.done = resumePoint(pending.request, done, pending.done, error);
+                    if (error == 0) {
+                        queueRead(index); // Short read, read the rest
+                        continue;
+                    }
+                }
+            }
+            freeRequests.push(index);
+            return {pending.request.tag, error};
+        }
+    }
+
+  private:
+    struct Pending {
+        ReadRequest request;
+        size_t done;        //< Bytes already read (kept at a whole block with O_DIRECT)
+        struct iovec iov;   //< Buffer of the current READV operation
+    };
+
+    int ringFd = -1;
+    void *sqRing = nullptr;
+    void *cqRing = nullptr;
+    io_uring_sqe *sqes = nullptr;
+    size_t sqRingSize = 0;
+    size_t cqRingSize = 0;
+    size_t sqesSize = 0;
+    unsigned *sqTail = nullptr;
+    unsigned sqMask = 0;
+    unsigned *sqArray = nullptr;
+    unsigned *cqHead = nullptr;
+    unsigned *cqTail = nullptr;
+    unsigned cqMask = 0;
+    io_uring_cqe *cqes = nullptr;
+    std::vector<Pending> requests;
+    FixedQueue<unsigned> freeRequests;
+
+    void *map(size_t size, off_t offset) {
+        void *ptr = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ringFd, offset);
+        if (ptr == MAP_FAILED) {
+            int error = errno;
+            unmap(); // The destructor does not run if the constructor throws
+            throw std::runtime_error(std::string("Failed to map the io_uring rings (") + std::strerror(error) + ")");
+        }
+        return ptr;
+    }
+
+    void unmap() {
+        if (sqes != nullptr) {
+            munmap(sqes, sqesSize);
+            sqes = nullptr;
+        }
+        if (cqRing != nullptr && cqRing != sqRing) {
+            munmap(cqRing, cqRingSize);
+        }
+        cqRing = nullptr;
+        if (sqRing != nullptr) {
+            munmap(sqRing, sqRingSize);
+            sqRing = nullptr;
+        }
+        if (ringFd >= 0) {
+            ::close(ringFd);
+            ringFd = -1;
+        }
+    }
+
+    void enter(unsigned toSubmit, unsigned minComplete, unsigned flags) {
+        while (syscall(__NR_io_uring_enter, ringFd, toSubmit, minComplete, flags, nullptr, 0) < 0) {
+            if (errno != EINTR && errno != EAGAIN) {
+                throw std::runtime_error(std::string("io_uring_enter failed (") + std::strerror(errno) + ")");
+            }
+        }
+    }
+
+    // READV is used instead of READ so that kernels older than 5.6 are supported
+    void queueRead(unsigned index) {
+        Pending &pending = requests[index];
+        pending.iov.iov_base = static_cast<char *>(pending.request.dst) + pending.done;
+        pending.iov.iov_len = std::min(pending.request.size - pending.done, MAX_READ_SIZE);
+
+        unsigned tail = *sqTail; // Only this thread writes the tail
+        unsigned slot = tail & sqMask;
+        io_uring_sqe &sqe = sqes[slot];
+        std::memset(&sqe, 0, sizeof(sqe));
+        sqe.opcode = IORING_OP_READV;
+        sqe.fd = pending.request.fd;
+        sqe.addr = reinterpret_cast<uint64_t>(&pending.iov);
+        sqe.len = 1;
+        sqe.off = pending.request.offset + pending.done;
+        sqe.user_data = index;
+        sqArray[slot] = slot;
+        std::atomic_ref<unsigned>(*sqTail).store(tail + 1, std::memory_order_release);
+        enter(1, 0, 0);
+    }
+};
+} // namespace
+
+std::unique_ptr<AsyncReader> AsyncReader::create(IOBackend backend, size_t capacity) {
+    capacity = std::max<size_t>(capacity, 1);
+    switch (backend) {
+    case IOBackend::Uring:
+        return std::make_unique<UringReader>(capacity);
+    case IOBackend::Pread:
+        return std::make_unique<PreadReader>(capacity);
+    case IOBackend::Sync:
+        return std::make_unique<SyncReader>(capacity);
+    case IOBackend::Auto:
+    default:
+        try {
+            return std::make_unique<UringReader>(capacity);
+        } catch (const std::runtime_error &) {
+            // io_uring disabled (old kernel, seccomp, io_uring_disabled sysctl...)
+            return std::make_unique<PreadReader>(capacity);
+        }
+    }
+}
@@ -0,0 +1,91 @@
+#include "CameraEmulator.hpp"
+#include "GlobalParameters.hpp"
+#include <algorithm>
+#include <stdexcept>
+#include <thread>
+
+namespace {
+double toMs(CameraEmulator::Clock::duration d) {
+    return std::chrono::duration<double, std::milli>(d).count();
+}
+
+CameraEmulator::Clock::duration fromMs(double ms) {
+    return std::chrono::duration_cast<CameraEmulator::Clock::duration>(std::chrono::duration<double, std::milli>(ms));
+}
+} // namespace
+
+CameraEmulator::CameraEmulator(const CameraConfig &config_)
+    : config{config_}, rng{config_.seed}, jitter{-config_.jitter, config_.jitter} {
+    if (!(config.fps > 0.0)) {
+        throw std::invalid_argument("CameraEmulator: the frame rate must be positive");
+    }
+    if (config.burst < 1) {
+        throw std::invalid_argument("CameraEmulator: the burst must be at least one frame");
+    }
+    if (config.jitter < 0.0 || config.deadline < 0.0) {
+        throw std::invalid_argument("CameraEmulator: the jitter and the deadline cannot be negative");
+    }
+    period = fromMs(1000.0 / config.fps);
+    if (config.deadline == 0.0) {
+        config.deadline = DEFAULT_DEADLINE_PERIODS * 1000.0 / config.fps;
+    }
+    deadline = fromMs(config.deadline);
+}
+
+void CameraEmulator::admit(ViVidItem *item) {
+    // Several workers can admit at once (--api syclevents): the frame and its arrival are taken under the lock and
+    // the wait happens outside it, so a worker never sleeps on behalf of another
+    Clock::time_point arrival;
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        if (!started) {
+            t0 = lastArrival = Clock::now();
+            started = true;
+        }
+
+        // The first frame of each burst fixes the arrival of the whole group
+        if (nextFrame % static_cast<size_t>(config.burst) == 0) {
+            Clock::time_point nominal = t0 + period * static_cast<Clock::rep>(nextFrame);
+            Clock::time_point jittered = config.jitter > 0.0 ? nominal + fromMs(jitter(rng)) : nominal;
+            groupArrival = std::max(jittered, lastArrival);
+            lastArrival = groupArrival;
+        }
+        ++nextFrame;
+        arrival = groupArrival;
+    }
+
+    std::this_thread::sleep_until(arrival);
+    Clock::time_point admission = Clock::now();
+
+    item->arrivalTime = arrival;
+    item->deadlineTime = arrival + deadline;
+    queueingDelay.record(toMs(admission - arrival));
+}
+
+void CameraEmulator::complete(ViVidItem *item) noexcept {
+    Clock::time_point now = Clock::now();
+    latency.record(toMs(now - item->arrivalTime));
+    if (now > item->deadlineTime) {
+        misses.fetch_add(1, std::memory_order_relaxed);
+    }
+
+    int64_t elapsed = std::chrono::duration_cast<std::chrono::nanoseconds>(now - t0).count();
+    int64_t prev = lastCompletion.load(std::memory_order_relaxed);
+    while (elapsed > prev && !lastCompletion.compare_exchange_weak(prev, elapsed, std::memory_order_relaxed)) {
+    }
+}
+
+CameraStats CameraEmulator::getStats() const {
+    CameraStats stats;
+    stats.fps = config.fps;
+    stats.burst = config.burst;
+    stats.jitter = config.jitter;
+    stats.deadline = config.deadline;
+    stats.queueingDelay = queueingDelay.summary();
+    stats.latency = latency.summary();
+    stats.frames = stats.latency.count;
+    stats.deadlineMisses = misses.load(std::memory_order_relaxed);
+    double elapsed = static_cast<double>(lastCompletion.load(std::memory_order_relaxed)) / 1e9;
+    stats.achievedFps = elapsed > 0.0 ? static_cast<double>(stats.frames) / elapsed : 0.0;
+    return stats;
+}
@@ -11,8 +11,12 @@ void Comparer::compare(ViVidItem *item, ApplicationData &appData) {
     int max_print = 5;              // Number of values to print in case of error
     int index_error = 0;            // Index of the first error
 
-    // Check all the values
+    int cells = item->out->pitch / sizeof(float); // Cells per class
+    // Check all the values (with --roi, only those of the active cells)
     for (int j = 0; j < resultSize; j++) {
+        if (item->region != nullptr && !item->region->contains(j % cells)) {
+            continue;
+        }
         float vabs = sycl::fabs(appData.goldenFrame[j] - item->out->data[j]);
         if (sycl::isnotequal(appData.goldenFrame[j], item->out->data[j]) && vabs >= tolerance) {
             if constexpr (VERBOSE_ENABLED)
@@ -39,22 +43,28 @@ void Comparer::createGoldenFrame(ApplicationData &appData) {
     if constexpr (VERBOSE_ENABLED) {
         printf(" Calculating the reference output...\n");
     }
-    item_dbg = new ViVidItem{appData.globalFrame, appData.globalCla, appData.numFilters, Q_GPU};
+    item_dbg = new ViVidItem{appData.globalFrame, appData.globalCla, appData.numFilters, Q_GPU, appData.usmUsage};
+    // The reference output always covers the whole frame
+    int apron = appData.filterDim / 2;
+    Rect pixels{apron, apron, appData.width - 2 * apron, appData.height - 2 * apron};
+    Rect cells{0, 0, pixels.width / appData.cellSize, pixels.height / appData.cellSize};
     if constexpr (VERBOSE_ENABLED)
         printf(" Start of reference output calculation...\n");
     if constexpr (VERBOSE_ENABLED)
         printf("  - Filter 1...\n");
-    cosine_filter_transpose(item_dbg->frame->get_HOST_PTR(BUF_READ), item_dbg->ind->get_HOST_PTR(BUF_WRITE), item_dbg->val->get_HOST_PTR(BUF_WRITE), appData.filterBank, appData.height, appData.width, appData.filterDim, appData.filterDim, appData.numFilters, item_dbg->val->pitch);
+    item_dbg->frame->visitPixels(BUF_READ, [&](auto *ptr_frame) {
+        cosine_filter_transpose(ptr_frame, item_dbg->ind->get_HOST_PTR(BUF_WRITE), item_dbg->val->get_HOST_PTR(BUF_WRITE), appData.filterBank, appData.height, appData.width, appData.filterDim, appData.filterDim, appData.numFilters, item_dbg->val->pitch, pixels);
+    });
     if constexpr (VERBOSE_ENABLED)
         printf("  - Filter 2...\n");
-    block_histogram(item_dbg->his->get_HOST_PTR(BUF_WRITE), item_dbg->ind->get_HOST_PTR(BUF_READ), item_dbg->val->get_HOST_PTR(BUF_READ), appData.cellSize, appData.height, appData.width, item_dbg->his->pitch / sizeof(float), item_dbg->ind->pitch / sizeof(float), item_dbg->val->pitch / sizeof(float));
+    block_histogram(item_dbg->his->get_HOST_PTR(BUF_WRITE), item_dbg->ind->get_HOST_PTR(BUF_READ), item_dbg->val->get_HOST_PTR(BUF_READ), appData.numFilters, appData.cellSize, appData.height, appData.width, item_dbg->his->pitch / sizeof(float), item_dbg->ind->pitch / sizeof(float), cells);
     if constexpr (VERBOSE_ENABLED)
         printf("  - Filter 3...\n");
     pwdist_c(item_dbg->cla->get_HOST_PTR(BUF_READ), item_dbg->his->get_HOST_PTR(BUF_READ), item_dbg->out->get_HOST_PTR(BUF_WRITE), item_dbg->out->pitch / sizeof(float), item_dbg->cla->height, item_dbg->cla->pitch / sizeof(float), item_dbg->his->height, item_dbg->cla->width);
     if constexpr (VERBOSE_ENABLED)
         printf(" End of reference output calculation\n");
     int resultSize = item_dbg->out->Ne;
-    appData.goldenFrame = (float *)malloc(resultSize * sizeof(float));
+    appData.goldenFrame = new float[resultSize]; // Released by ApplicationData
     memcpy(appData.goldenFrame, item_dbg->out->data, resultSize * sizeof(float)); // Copy the result to the golden array
     std::cout << " Golden (first values...): \n\t";
     for (int j = 0; j < 10; j++)
@@ -0,0 +1,81 @@
+#include "Coroutines.hpp"
+#include <algorithm>
+
+CoroExecutor::CoroExecutor(size_t numThreads) {
+    numThreads = std::max<size_t>(numThreads, 1);
+    threads.reserve(numThreads);
+    for (size_t i = 0; i < numThreads; ++i) {
+        threads.emplace_back(&CoroExecutor::worker, this);
+    }
+}
+
+CoroExecutor::~CoroExecutor() {
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        stopping = true;
+    }
+    available.notify_all();
+    for (auto &thread : threads) {
+        thread.join();
+    }
+}
+
+void CoroExecutor::schedule(std::coroutine_handle<> handle) {
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        ready.push_back(handle);
+    }
+    available.notify_one();
+}
+
+void CoroExecutor::worker() {
+    while (true) {
+        std::coroutine_handle<> handle;
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            available.wait(lock, [&] { return stopping || !ready.empty(); });
+            if (ready.empty()) {
+                return;
+            }
+            handle = ready.front();
+            ready.pop_front();
+        }
+        // Runs until the coroutine is suspended again or ends
+        handle.resume();
+    }
+}
+
+bool CoroMutex::tryLock() {
+    std::lock_guard<std::mutex> lock(mutex);
+    if (locked) {
+        return false;
+    }
+    locked = true;
+    return true;
+}
+
+bool CoroMutex::lockOrWait(std::coroutine_handle<> handle) {
+    std::lock_guard<std::mutex> lock(mutex);
+    if (!locked) {
+        // Unlocked since tryLock: take it without suspending
+        locked = true;
+        return false;
+    }
+    waiting.push_back(handle);
+    return true;
+}
+
+void CoroMutex::unlock() {
+    std::coroutine_handle<> next;
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        if (waiting.empty()) {
+            locked = false;
+            return;
+        }
+        // The mutex stays locked: it is handed to the first waiting coroutine
+        next = waiting.front();
+        waiting.pop_front();
+    }
+    executor.schedule(next);
+}
@@ -1,20 +1,55 @@
 #include "DataBuffers.hpp"
+#include "InputArgs.hpp"
+#include <algorithm>
+#include <cstring>
+#include <fstream>
+#include <tbb/blocked_range.h>
+#include <tbb/parallel_for.h>
 
-FloatBuffer *DataBuffers::createGlobalFrame(const std::unique_ptr<float[]> &f_imData, int height, int width, sycl::queue &Q) {
+FrameBuffer *DataBuffers::createGlobalFrame(const void *f_imData, int height, int width, PixelType pixelType, sycl::queue &Q, USMUsage &usage) {
     FloatBuffer::set_ZCB(false);
     FloatBuffer::set_device_pitch(false);
+    FrameBuffer::set_ZCB(false);
+    FrameBuffer::set_device_pitch(false);
 
-    FloatBuffer *global_frame = new FloatBuffer(height, width, BUF_READ, Q);
-    float *punt = global_frame->get_HOST_PTR(BUF_WRITE);
-    memcpy(punt, f_imData.get(), global_frame->size);
+    // The frame keeps the pixel type of the input, stage 1 widens the pixels to float
+    FrameBuffer *global_frame = new FrameBuffer(height, width, pixelType, BUF_READ, Q, usage);
+    unsigned char *punt = global_frame->get_HOST_PTR(BUF_WRITE);
+    if (f_imData == nullptr) {
+        return global_frame; // Filled later by the caller (multi-frame input)
+    }
+
+    // Unica copia de la imagen: de la proyeccion del fichero (page cache) al buffer USM
+#ifdef SYCL_EXT_ONEAPI_COPY_OPTIMIZE
+    // Pin the mapped pages so the runtime can copy them with the DMA engine
+    sycl::ext::oneapi::experimental::prepare_for_device_copy(f_imData, global_frame->size, Q);
+    Q.memcpy(punt, f_imData, global_frame->size).wait();
+    sycl::ext::oneapi::experimental::release_from_device_copy(f_imData, Q);
+#else
+    // Copy in chunks from several threads so the page faults of the mapping are served in parallel
+    constexpr size_t CHUNK_SIZE = 4 << 20;
+    const size_t nChunks = (global_frame->size + CHUNK_SIZE - 1) / CHUNK_SIZE;
+    const char *src = static_cast<const char *>(f_imData);
+    char *dst = reinterpret_cast<char *>(punt);
+    tbb::parallel_for(tbb::blocked_range<size_t>(0, nChunks), [&](const tbb::blocked_range<size_t> &r) {
+        for (size_t c = r.begin(); c != r.end(); ++c) {
+            size_t offset = c * CHUNK_SIZE;
+            std::memcpy(dst + offset, src + offset, std::min(CHUNK_SIZE, global_frame->size - offset));
+        }
+    });
+#endif
 
     return global_frame;
 }
 
-float *DataBuffers::createFilterBank(const int num_filters, const int filter_dim, std::mt19937 &mte, sycl::queue &Q) {
+float *DataBuffers::createFilterBank(const int num_filters, const int filter_dim, std::mt19937 &mte, sycl::queue &Q, USMUsage &usage) {
     std::uniform_real_distribution<float> uniform_filter_bank{0.00000001, 0.00000099};
 
     float *filter_bank = sycl::malloc_shared<float>(num_filters * filter_dim * filter_dim, Q);
+    if (filter_bank == nullptr) {
+        throw std::runtime_error("Unable to allocate the filter bank in USM");
+    }
+    usage.allocated(num_filters * filter_dim * filter_dim * sizeof(float));
     for (int i = 0; i < num_filters * filter_dim * filter_dim; i++) {
         filter_bank[i] = uniform_filter_bank(mte);
     }
@@ -22,28 +57,28 @@ float *DataBuffers::createFilterBank(const int num_filters, const int filter_dim
     return filter_bank;
 }
 
-void DataBuffers::createAllBuffers(ApplicationData &appData, const std::unique_ptr<float[]> &f_imData) {
+void DataBuffers::createAllBuffers(ApplicationData &appData, const void *f_imData) {
     // Configure the buffers and copy the image to the buffer
     if constexpr (VERBOSE_ENABLED) {
         printf(" Configuring the buffers...\n");
-        printf(" Image size: %d x %d\n", appData.height, appData.width);
+        printf(" Image size: %d x %d (%s)\n", appData.height, appData.width, FrameContainer::pixelTypeName(appData.pixelType));
     }
-    appData.globalFrame = createGlobalFrame(f_imData, appData.height, appData.width, appData.USM_queue);
+    appData.globalFrame = createGlobalFrame(f_imData, appData.height, appData.width, appData.pixelType, appData.USM_queue, appData.usmUsage);
 
     // Create a random filter bank (filter_dim = 3)
     if constexpr (VERBOSE_ENABLED) {
         printf(" Creating the filter bank...\n");
     };
-    appData.filterBank = createFilterBank(appData.numFilters, appData.filterDim, appData.mte, appData.USM_queue);
+    appData.filterBank = createFilterBank(appData.numFilters, appData.filterDim, appData.mte, appData.USM_queue, appData.usmUsage);
 
     // Create a random coefficients
     if constexpr (VERBOSE_ENABLED) {
         printf(" Creating the coefficients...\n");
     };
-    appData.globalCla = createGlobalCla(appData.window_height, appData.windowWidth, appData.cellSize, appData.blockSize, appData.dictSize, appData.mte, appData.USM_queue);
+    appData.globalCla = createGlobalCla(appData.window_height, appData.windowWidth, appData.cellSize, appData.blockSize, appData.dictSize, appData.mte, appData.USM_queue, appData.usmUsage);
 }
 
-FloatBuffer *DataBuffers::createGlobalCla(const int window_height, const int window_width, const int cell_size, const int block_size, const int dict_size, std::mt19937 &mte, sycl::queue &Q) {
+FloatBuffer *DataBuffers::createGlobalCla(const int window_height, const int window_width, const int cell_size, const int block_size, const int dict_size, std::mt19937 &mte, sycl::queue &Q, USMUsage &usage) {
     std::uniform_real_distribution<float> uniform_coefficients{0.05, 0.099};
 
     int n_cells_x = window_width / cell_size;
@@ -53,7 +88,7 @@ FloatBuffer *DataBuffers::createGlobalCla(const int window_height, const int win
 
     size_t n_total_coeff = block_size * block_size * n_blocks_x * n_blocks_y * dict_size;
 
-    FloatBuffer *global_cla = new FloatBuffer{n_total_coeff / dict_size, static_cast<size_t>(dict_size), BUF_READ, Q};
+    FloatBuffer *global_cla = new FloatBuffer{n_total_coeff / dict_size, static_cast<size_t>(dict_size), BUF_READ, Q, usage};
     float *coefficients = global_cla->get_HOST_PTR(BUF_WRITE);
 
     for (int i = 0; i < dict_size; i++) {
@@ -63,4 +98,48 @@ FloatBuffer *DataBuffers::createGlobalCla(const int window_height, const int win
     }
 
     return global_cla;
+}
+
+void DataBuffers::createStageBuffers(ApplicationData &appData, const InputArgs &inputArgs, ItemPool &bufferItems) {
+    appData.stageCla.assign(inputArgs.numStages(), nullptr);
+    for (size_t stage = 0; stage < inputArgs.numStages(); ++stage) {
+        const StageClassifier &classifier = inputArgs.stageClassifiers[stage];
+        if (classifier.custom()) {
+            // Same number of classes (rows) as the global ones, so the outputs of all the stages have the same size
+            size_t rows = appData.globalCla->height;
+            size_t dict = classifier.dictSize > 0 ? static_cast<size_t>(classifier.dictSize) : 0;
+            std::vector<float> coefficients;
+            if (!classifier.model.empty()) {
+                std::ifstream file(classifier.model, std::ios::binary | std::ios::ate);
+                if (!file) {
+                    throw std::invalid_argument("Cannot open the model " + classifier.model + " of the stage " + inputArgs.stageNames[stage]);
+                }
+                size_t floats = static_cast<size_t>(file.tellg()) / sizeof(float);
+                if (dict == 0 && floats % rows == 0) {
+                    dict = floats / rows;
+                }
+                if (dict == 0 || floats != rows * dict) {
+                    throw std::invalid_argument("The model " + classifier.model + " must have " + std::to_string(rows) + " classes of dict floats (" + std::to_string(floats) + " floats)");
+                }
+                coefficients.resize(floats);
+                file.seekg(0);
+                file.read(reinterpret_cast<char *>(coefficients.data()), static_cast<std::streamsize>(floats * sizeof(float)));
+            }
+            if (dict > static_cast<size_t>(appData.numFilters)) {
+                throw std::invalid_argument("The stage " + inputArgs.stageNames[stage] + " compares " + std::to_string(dict) + " bins, the histograms have " + std::to_string(appData.numFilters));
+            }
+
+            FloatBuffer *cla = createGlobalCla(appData.window_height, appData.windowWidth, appData.cellSize, appData.blockSize, static_cast<int>(dict), appData.mte, appData.USM_queue, appData.usmUsage);
+            if (!coefficients.empty()) {
+                float *ptr = cla->get_HOST_PTR(BUF_WRITE);
+                for (size_t j = 0; j < rows; j++) {
+                    std::memcpy(ptr + j * cla->pitch / sizeof(float), coefficients.data() + j * dict, dict * sizeof(float));
+                }
+            }
+            appData.stageCla[stage] = cla;
+        }
+        if (appData.stageCla[stage] != nullptr || inputArgs.hasOwnOutput(stage)) {
+            bufferItems.setStageBuffers(stage, appData.stageCla[stage], inputArgs.hasOwnOutput(stage));
+        }
+    }
 }
\ No newline at end of file
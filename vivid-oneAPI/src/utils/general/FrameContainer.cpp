@@ -0,0 +1,434 @@
+#include "FrameContainer.hpp"
+#include <algorithm>
+#include <array>
+#include <bit>
+#include <cerrno>
+#include <cstring>
+#include <fcntl.h>
+#include <stdexcept>
+#include <sys/stat.h>
+#include <unistd.h>
+
+static_assert(std::endian::native == std::endian::little, "FrameContainer assumes a little endian host");
+
+using namespace FrameContainer;
+
+namespace {
+constexpr size_t LEGACY2_HEADER_SIZE = 2 * sizeof(int32_t);
+constexpr size_t LEGACY6_HEADER_SIZE = 6 * sizeof(int32_t);
+constexpr int32_t CV_32F = 5; // OpenCV depth of the frames written by the old converter
+
+constexpr std::array<uint32_t, 256> makeCrcTable() {
+    std::array<uint32_t, 256> table{};
+    for (uint32_t i = 0; i < 256; ++i) {
+        uint32_t c = i;
+        for (int k = 0; k < 8; ++k) {
+            c = (c & 1) ? 0xEDB88320u ^ (c >> 1) : c >> 1;
+        }
+        table[i] = c;
+    }
+    return table;
+}
+constexpr std::array<uint32_t, 256> CRC_TABLE = makeCrcTable();
+
+template <typename T>
+T field(const unsigned char *header, size_t offset) {
+    T value;
+    std::memcpy(&value, header + offset, sizeof(T));
+    return value;
+}
+
+template <typename T>
+void setField(unsigned char *header, size_t offset, T value) {
+    std::memcpy(header + offset, &value, sizeof(T));
+}
+} // namespace
+
+size_t FrameContainer::pixelSize(PixelType type) {
+    switch (type) {
+    case PixelType::Float32:
+        return sizeof(float);
+    case PixelType::UInt8:
+        return sizeof(uint8_t);
+    case PixelType::UInt16:
+        return sizeof(uint16_t);
+    }
+    return 0;
+}
+
+const char *FrameContainer::pixelTypeName(PixelType type) {
+    switch (type) {
+    case PixelType::Float32:
+        return "float32";
+    case PixelType::UInt8:
+        return "uint8";
+    case PixelType::UInt16:
+        return "uint16";
+    }
+    return "unknown";
+}
+
+uint32_t FrameContainer::crc32(const void *data, size_t size, uint32_t crc) {
+    const unsigned char *ptr = static_cast<const unsigned char *>(data);
+    crc = ~crc;
+    for (size_t i = 0; i < size; ++i) {
+        crc = CRC_TABLE[(crc ^ ptr[i]) & 0xFF] ^ (crc >> 8);
+    }
+    return ~crc;
+}
+
+// ____________________________________________________________________________________________________________________
+// FrameReader
+// ____________________________________________________________________________________________________________________
+FrameReader::FrameReader(const std::string &path) : filePath{path} {
+    open();
+    unsigned char magic[4] = {0, 0, 0, 0};
+    if (fileSize >= sizeof(magic)) {
+        readAt(magic, sizeof(magic), 0);
+    }
+    if (std::memcmp(magic, MAGIC, sizeof(magic)) == 0) {
+        parseContainer();
+    } else {
+        parseLegacy();
+    }
+    checkFrames();
+}
+
+FrameReader::FrameReader(const std::string &path, uint32_t width, uint32_t height, PixelType type_)
+    : filePath{path}, fileLayout{Layout::Raw}, frameWidth{width}, frameHeight{height}, type{type_} {
+    if (width == 0 || height == 0) {
+        throw std::runtime_error("Raw input " + path + " needs the frame dimensions");
+    }
+    open();
+    bytesPerFrame = static_cast<size_t>(width) * height * pixelSize(type);
+    size_t numFrames = fileSize / bytesPerFrame;
+    if (numFrames == 0) {
+        throw std::runtime_error("Raw input " + path + " is truncated: " + std::to_string(fileSize) + " bytes cannot hold a " + std::to_string(width) + "x" +
+                                 std::to_string(height) + " " + pixelTypeName(type) + " frame (" + std::to_string(bytesPerFrame) + " bytes)");
+    }
+    for (size_t i = 0; i < numFrames; ++i) {
+        offsets.push_back(i * bytesPerFrame);
+    }
+}
+
+FrameReader::~FrameReader() {
+    release();
+}
+
+FrameReader::FrameReader(FrameReader &&other) noexcept
+    : filePath{std::move(other.filePath)}, fd{other.fd}, directFd{other.directFd}, directUnsupported{other.directUnsupported}, fileSize{other.fileSize}, fileLayout{other.fileLayout}, fileVersion{other.fileVersion},
+      frameWidth{other.frameWidth}, frameHeight{other.frameHeight}, frameChannels{other.frameChannels}, type{other.type}, bytesPerFrame{other.bytesPerFrame},
+      offsets{std::move(other.offsets)}, checksums{std::move(other.checksums)} {
+    other.fd = -1;
+    other.directFd = -1;
+}
+
+FrameReader &FrameReader::operator=(FrameReader &&other) noexcept {
+    if (this != &other) {
+        release();
+        filePath = std::move(other.filePath);
+        fd = other.fd;
+        directFd = other.directFd;
+        directUnsupported = other.directUnsupported;
+        fileSize = other.fileSize;
+        fileLayout = other.fileLayout;
+        fileVersion = other.fileVersion;
+        frameWidth = other.frameWidth;
+        frameHeight = other.frameHeight;
+        frameChannels = other.frameChannels;
+        type = other.type;
+        bytesPerFrame = other.bytesPerFrame;
+        offsets = std::move(other.offsets);
+        checksums = std::move(other.checksums);
+        other.fd = -1;
+        other.directFd = -1;
+    }
+    return *this;
+}
+
+void FrameReader::open() {
+    fd = ::open(filePath.c_str(), O_RDONLY);
+    if (fd < 0) {
+        throw std::runtime_error("Failed to open " + filePath + " (" + std::strerror(errno) + ")");
+    }
+    struct stat st;
+    if (fstat(fd, &st) != 0) {
+        release();
+        throw std::runtime_error("Failed to get the size of " + filePath);
+    }
+    fileSize = static_cast<uint64_t>(st.st_size);
+    posix_fadvise(fd, 0, 0, POSIX_FADV_SEQUENTIAL);
+}
+
+void FrameReader::release() {
+    if (fd >= 0) {
+        ::close(fd);
+        fd = -1;
+    }
+    if (directFd >= 0) {
+        ::close(directFd);
+        directFd = -1;
+    }
+}
+
+int FrameReader::descriptor() {
+    if (fd < 0) {
+        open();
+    }
+    return fd;
+}
+
+int FrameReader::directDescriptor() {
+    if (directFd < 0 && !directUnsupported) {
+        directFd = ::open(filePath.c_str(), O_RDONLY | O_DIRECT);
+        if (directFd < 0) {
+            if (errno != EINVAL) {
+                throw std::runtime_error("Failed to open " + filePath + " (" + std::strerror(errno) + ")");
+            }
+            directUnsupported = true; // e.g. tmpfs
+        }
+    }
+    return directFd;
+}
+
+void FrameReader::readAt(void *dst, size_t size, uint64_t offset) {
+    if (fd < 0) {
+        open();
+    }
+    char *ptr = static_cast<char *>(dst);
+    while (size > 0) {
+        ssize_t r = ::pread(fd, ptr, size, static_cast<off_t>(offset));
+        if (r < 0 && errno == EINTR) {
+            continue;
+        }
+        if (r <= 0) {
+            throw std::runtime_error("Failed to read " + filePath + (r < 0 ? std::string(" (") + std::strerror(errno) + ")" : " (unexpected end of file)"));
+        }
+        ptr += r;
+        offset += static_cast<uint64_t>(r);
+        size -= static_cast<size_t>(r);
+    }
+}
+
+void FrameReader::parseContainer() {
+    if (fileSize < HEADER_SIZE) {
+        throw std::runtime_error(filePath + " is truncated: the header needs " + std::to_string(HEADER_SIZE) + " bytes, the file has " + std::to_string(fileSize));
+    }
+    unsigned char header[HEADER_SIZE];
+    readAt(header, HEADER_SIZE, 0);
+
+    fileLayout = Layout::Container;
+    fileVersion = field<uint16_t>(header, 4);
+    uint16_t headerSize = field<uint16_t>(header, 6);
+    frameWidth = field<uint32_t>(header, 8);
+    frameHeight = field<uint32_t>(header, 12);
+    frameChannels = field<uint32_t>(header, 16);
+    uint32_t pixelType = field<uint32_t>(header, 20);
+    uint64_t frameCount = field<uint64_t>(header, 24);
+    uint64_t offsetTable = field<uint64_t>(header, 32);
+    uint64_t checksumTable = field<uint64_t>(header, 40);
+
+    if (fileVersion == 0 || fileVersion > VERSION) {
+        throw std::runtime_error(filePath + " uses version " + std::to_string(fileVersion) + " of the frame container, this build reads up to version " + std::to_string(VERSION));
+    }
+    if (headerSize < HEADER_SIZE || headerSize > fileSize) {
+        throw std::runtime_error(filePath + " has an invalid header size (" + std::to_string(headerSize) + " bytes)");
+    }
+    if (frameWidth == 0 || frameHeight == 0 || frameChannels == 0) {
+        throw std::runtime_error(filePath + " has invalid frame dimensions (" + std::to_string(frameWidth) + "x" + std::to_string(frameHeight) + "x" +
+                                 std::to_string(frameChannels) + ")");
+    }
+    if (pixelType < static_cast<uint32_t>(PixelType::Float32) || pixelType > static_cast<uint32_t>(PixelType::UInt16)) {
+        throw std::runtime_error(filePath + " has an unknown pixel type (" + std::to_string(pixelType) + ")");
+    }
+    type = static_cast<PixelType>(pixelType);
+    bytesPerFrame = static_cast<size_t>(frameWidth) * frameHeight * frameChannels * pixelSize(type);
+
+    if (frameCount == 0) {
+        throw std::runtime_error(filePath + " does not contain any frame");
+    }
+    if (offsetTable < headerSize || offsetTable > fileSize || frameCount > (fileSize - offsetTable) / sizeof(uint64_t)) {
+        throw std::runtime_error(filePath + " is truncated: the offset table of " + std::to_string(frameCount) + " frames does not fit in the file (" +
+                                 std::to_string(fileSize) + " bytes)");
+    }
+    offsets.resize(frameCount);
+    readAt(offsets.data(), frameCount * sizeof(uint64_t), offsetTable);
+
+    if (checksumTable != 0) {
+        if (checksumTable < headerSize || checksumTable > fileSize || frameCount > (fileSize - checksumTable) / sizeof(uint32_t)) {
+            throw std::runtime_error(filePath + " is truncated: the checksum table does not fit in the file");
+        }
+        checksums.resize(frameCount);
+        readAt(checksums.data(), frameCount * sizeof(uint32_t), checksumTable);
+    }
+}
+
+void FrameReader::parseLegacy() {
+    if (fileSize < LEGACY2_HEADER_SIZE) {
+        throw std::runtime_error(filePath + " is not a frame container (bad magic) and is too small for the legacy layout");
+    }
+    int32_t header[6] = {0, 0, 0, 0, 0, 0};
+    readAt(header, std::min<uint64_t>(fileSize, LEGACY6_HEADER_SIZE), 0);
+
+    // Old converter: rows, cols, CV_32F, CV_32F, channels, bytes and a single frame
+    if (fileSize >= LEGACY6_HEADER_SIZE && header[0] > 0 && header[1] > 0 && header[2] == CV_32F && header[3] == CV_32F && header[4] == 1 &&
+        static_cast<uint64_t>(header[5]) == static_cast<uint64_t>(header[0]) * header[1] * sizeof(float)) {
+        fileLayout = Layout::LegacyHeader6;
+        frameHeight = static_cast<uint32_t>(header[0]);
+        frameWidth = static_cast<uint32_t>(header[1]);
+        bytesPerFrame = static_cast<size_t>(header[5]);
+        offsets.push_back(LEGACY6_HEADER_SIZE);
+        return;
+    }
+
+    // Two int32 header (height, width) and any number of frames
+    if (header[0] <= 0 || header[1] <= 0) {
+        throw std::runtime_error(filePath + " is not a frame container (bad magic) and its legacy header is not valid (" + std::to_string(header[0]) + "x" +
+                                 std::to_string(header[1]) + ")");
+    }
+    fileLayout = Layout::LegacyHeader2;
+    frameHeight = static_cast<uint32_t>(header[0]);
+    frameWidth = static_cast<uint32_t>(header[1]);
+    bytesPerFrame = static_cast<size_t>(frameWidth) * frameHeight * sizeof(float);
+    size_t numFrames = (fileSize - LEGACY2_HEADER_SIZE) / bytesPerFrame;
+    if (numFrames == 0 || (fileSize - LEGACY2_HEADER_SIZE) % bytesPerFrame != 0) {
+        throw std::runtime_error(filePath + " is not a frame container (bad magic) and does not match its legacy header: " + std::to_string(frameHeight) +
+                                 "x" + std::to_string(frameWidth) + " float frames need a multiple of " + std::to_string(bytesPerFrame) +
+                                 " bytes after the header, found " + std::to_string(fileSize - LEGACY2_HEADER_SIZE));
+    }
+    for (size_t i = 0; i < numFrames; ++i) {
+        offsets.push_back(LEGACY2_HEADER_SIZE + i * bytesPerFrame);
+    }
+}
+
+void FrameReader::checkFrames() {
+    for (size_t i = 0; i < offsets.size(); ++i) {
+        if (offsets[i] > fileSize || bytesPerFrame > fileSize - offsets[i]) {
+            throw std::runtime_error(filePath + " is truncated: frame " + std::to_string(i) + " needs " + std::to_string(bytesPerFrame) + " bytes at offset " +
+                                     std::to_string(offsets[i]) + ", the file has " + std::to_string(fileSize) + " bytes");
+        }
+    }
+}
+
+void FrameReader::readFrame(size_t index, void *dst, bool verify) {
+    readAt(dst, bytesPerFrame, offsets.at(index));
+    if (verify) {
+        verifyFrame(index, dst);
+    }
+}
+
+void FrameReader::readRegion(size_t index, uint32_t x, uint32_t y, uint32_t width, uint32_t height, void *dst, size_t dstPitch) {
+    if (x + width > frameWidth || y + height > frameHeight) {
+        throw std::out_of_range(filePath + ": region outside the frame");
+    }
+    size_t pixelBytes = bytesPerFrame / (static_cast<size_t>(frameWidth) * frameHeight);
+    size_t rowBytes = width * pixelBytes;
+    uint64_t offset = offsets.at(index) + (static_cast<uint64_t>(y) * frameWidth + x) * pixelBytes;
+    char *row = static_cast<char *>(dst);
+    if (x == 0 && width == frameWidth && dstPitch == rowBytes) {
+        readAt(row, rowBytes * height, offset); // Whole rows: a single read
+        return;
+    }
+    for (uint32_t r = 0; r < height; ++r) {
+        readAt(row + r * dstPitch, rowBytes, offset + static_cast<uint64_t>(r) * frameWidth * pixelBytes);
+    }
+}
+
+void FrameReader::verifyFrame(size_t index, const void *data) const {
+    if (checksums.empty()) {
+        return;
+    }
+    uint32_t crc = crc32(data, bytesPerFrame);
+    if (crc != checksums.at(index)) {
+        throw std::runtime_error(filePath + ": checksum mismatch in frame " + std::to_string(index) + " (file is corrupted)");
+    }
+}
+
+// ____________________________________________________________________________________________________________________
+// FrameWriter
+// ____________________________________________________________________________________________________________________
+FrameWriter::FrameWriter(const std::string &path, uint32_t width, uint32_t height, uint32_t channels, PixelType type_, bool checksums_, size_t alignment)
+    : filePath{path}, frameWidth{width}, frameHeight{height}, frameChannels{channels}, type{type_}, withChecksums{checksums_}, frameAlignment{alignment} {
+    if (width == 0 || height == 0 || channels == 0) {
+        throw std::invalid_argument("FrameWriter: invalid frame dimensions");
+    }
+    if (alignment == 0) {
+        throw std::invalid_argument("FrameWriter: the frame alignment must be at least 1");
+    }
+    bytesPerFrame = static_cast<size_t>(width) * height * channels * pixelSize(type);
+    fd = ::open(path.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (fd < 0) {
+        throw std::runtime_error("Failed to create " + path + " (" + std::strerror(errno) + ")");
+    }
+}
+
+FrameWriter::~FrameWriter() {
+    if (fd >= 0) {
+        try {
+            close();
+        } catch (...) {
+            // Destructors must not throw, call close() to get the error
+        }
+    }
+}
+
+void FrameWriter::writeAt(const void *src, size_t size, uint64_t offset) {
+    const char *ptr = static_cast<const char *>(src);
+    while (size > 0) {
+        ssize_t w = ::pwrite(fd, ptr, size, static_cast<off_t>(offset));
+        if (w < 0 && errno == EINTR) {
+            continue;
+        }
+        if (w <= 0) {
+            throw std::runtime_error("Failed to write " + filePath + " (" + std::strerror(errno) + ")");
+        }
+        ptr += w;
+        offset += static_cast<uint64_t>(w);
+        size -= static_cast<size_t>(w);
+    }
+}
+
+void FrameWriter::writeFrame(const void *data) {
+    if (fd < 0) {
+        throw std::logic_error("FrameWriter: " + filePath + " is already closed");
+    }
+    position = (position + frameAlignment - 1) / frameAlignment * frameAlignment; // The gap is a hole of zeros
+    writeAt(data, bytesPerFrame, position);
+    offsets.push_back(position);
+    if (withChecksums) {
+        checksums.push_back(crc32(data, bytesPerFrame));
+    }
+    position += bytesPerFrame;
+}
+
+void FrameWriter::close() {
+    if (fd < 0) {
+        return;
+    }
+    uint64_t offsetTable = position;
+    writeAt(offsets.data(), offsets.size() * sizeof(uint64_t), offsetTable);
+    uint64_t checksumTable = 0;
+    if (withChecksums) {
+        checksumTable = offsetTable + offsets.size() * sizeof(uint64_t);
+        writeAt(checksums.data(), checksums.size() * sizeof(uint32_t), checksumTable);
+    }
+
+    unsigned char header[HEADER_SIZE] = {};
+    std::memcpy(header, MAGIC, sizeof(MAGIC));
+    setField<uint16_t>(header, 4, VERSION);
+    setField<uint16_t>(header, 6, static_cast<uint16_t>(HEADER_SIZE));
+    setField<uint32_t>(header, 8, frameWidth);
+    setField<uint32_t>(header, 12, frameHeight);
+    setField<uint32_t>(header, 16, frameChannels);
+    setField<uint32_t>(header, 20, static_cast<uint32_t>(type));
+    setField<uint64_t>(header, 24, static_cast<uint64_t>(offsets.size()));
+    setField<uint64_t>(header, 32, offsetTable);
+    setField<uint64_t>(header, 40, checksumTable);
+    writeAt(header, HEADER_SIZE, 0);
+
+    int result = ::close(fd);
+    fd = -1;
+    if (result != 0) {
+        throw std::runtime_error("Failed to close " + filePath + " (" + std::strerror(errno) + ")");
+    }
+}
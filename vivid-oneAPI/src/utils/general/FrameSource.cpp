@@ -0,0 +1,691 @@
+#include "FrameSource.hpp"
+#include "GlobalParameters.hpp"
+#include <algorithm>
+#include <cerrno>
+#include <chrono>
+#include <cstdint>
+#include <cstring>
+#include <filesystem>
+#include <iostream>
+#include <stdexcept>
+#include <tbb/tick_count.h>
+
+namespace fs = std::filesystem;
+
+namespace {
+constexpr size_t TILE_ROW_READS = 32; //< Row reads of the tiles in flight (a tile narrower than the frame is read row by row)
+} // namespace
+
+FrameSource::FrameSource(const std::string &path, int rawHeight, int rawWidth, PixelType rawType) {
+    if (path.rfind("shm:", 0) == 0) {
+        shm = std::make_unique<SharedFrameRing::Consumer>(path.substr(4));
+        frameHeight = static_cast<int>(shm->height());
+        frameWidth = static_cast<int>(shm->width());
+        framePixelType = shm->pixelType();
+        frameBytes = shm->frameBytes();
+        shmNext = shmReleased = shm->firstFrame();
+        stats.sharedMemory = true;
+        std::cout << " Input: shared memory ring " << shm->name() << " (" << FrameContainer::pixelTypeName(framePixelType) << " frames of " << frameWidth << "x" << frameHeight << ", "
+                  << shm->slots() << " slots)" << std::endl;
+        return;
+    }
+    if (!fs::exists(path)) {
+        throw std::invalid_argument("Input not found: " + path);
+    }
+    if (fs::is_directory(path)) {
+        std::vector<std::string> paths;
+        for (const auto &entry : fs::directory_iterator(path)) {
+            if (entry.is_regular_file() && entry.path().extension() == ".bin") {
+                paths.push_back(entry.path().string());
+            }
+        }
+        std::sort(paths.begin(), paths.end());
+        for (const auto &p : paths) {
+            addFile(p, rawHeight, rawWidth, rawType);
+        }
+    } else {
+        addFile(path, rawHeight, rawWidth, rawType);
+    }
+    if (frames.empty()) {
+        throw std::invalid_argument("The input " + path + " does not contain any frame");
+    }
+
+    std::cout << " Input: " << path << " (" << frames.size() << " " << FrameContainer::pixelTypeName(framePixelType) << " frames of " << frameWidth << "x" << frameHeight << " in " << files.size() << " file"
+              << (files.size() > 1 ? "s" : "") << ")" << std::endl;
+}
+
+FrameSource::FrameSource(int height, int width, PixelType type)
+    : frameHeight{height}, frameWidth{width}, framePixelType{type}, pushMode{true} {
+    if (height <= 0 || width <= 0) {
+        throw std::invalid_argument("The pushed frames cannot be empty");
+    }
+    frameBytes = static_cast<size_t>(height) * static_cast<size_t>(width) * FrameContainer::pixelSize(type);
+    stats.pushed = true;
+}
+
+FrameSource::~FrameSource() {
+    stop();
+    for (auto &slot : slots) {
+        delete slot;
+    }
+}
+
+void FrameSource::addFile(const std::string &path, int rawHeight, int rawWidth, PixelType rawType) {
+    using namespace FrameContainer;
+    bool isBin = fs::path(path).extension() == ".bin";
+    if (!isBin && (rawHeight <= 0 || rawWidth <= 0)) {
+        throw std::invalid_argument("Raw input " + path + " needs the frame dimensions (--input-size WIDTHxHEIGHT)");
+    }
+
+    FrameReader reader = isBin ? FrameReader(path) : FrameReader(path, static_cast<uint32_t>(rawWidth), static_cast<uint32_t>(rawHeight), rawType);
+    if (reader.channels() != 1) {
+        throw std::invalid_argument("Input " + path + " has " + std::to_string(reader.channels()) + " " + pixelTypeName(reader.pixelType()) +
+                                    " channels, the pipeline needs a single (grayscale) channel");
+    }
+    int h = static_cast<int>(reader.height());
+    int w = static_cast<int>(reader.width());
+    if (files.empty()) {
+        frameHeight = h;
+        frameWidth = w;
+        framePixelType = reader.pixelType();
+        frameBytes = reader.frameBytes();
+    } else if (reader.pixelType() != framePixelType) {
+        throw std::invalid_argument("Pixel type of " + path + " (" + pixelTypeName(reader.pixelType()) + ") differs from the previous files (" +
+                                    pixelTypeName(framePixelType) + ")");
+    } else if (h != frameHeight || w != frameWidth) {
+        throw std::invalid_argument("Frame dimensions of " + path + " (" + std::to_string(w) + "x" + std::to_string(h) + ") differ from the previous files (" +
+                                    std::to_string(frameWidth) + "x" + std::to_string(frameHeight) + ")");
+    }
+
+    for (size_t i = 0; i < reader.frameCount(); ++i) {
+        frames.push_back({files.size(), i});
+    }
+    reader.release(); // Reopened when its frames are read
+    files.push_back(std::move(reader));
+}
+
+void FrameSource::setTiles(const TileGrid &grid) {
+    if (shm || pushMode) {
+        throw std::invalid_argument("Only the frames of a file input can be split into tiles");
+    }
+    if (!slots.empty()) {
+        throw std::logic_error("FrameSource: the tiles must be set before the I/O thread starts");
+    }
+    tileGrid = std::make_unique<TileGrid>(grid);
+    stats.tiles = grid.size();
+    stats.tileOverhead = grid.overhead();
+    std::cout << " Tiles: " << grid.columns() << "x" << grid.rows() << " tiles of " << grid.tileWidth() << "x" << grid.tileHeight() << " per frame ("
+              << static_cast<int>(grid.overhead() * 100.0 + 0.5) << "% of the pixels processed twice or padding)" << std::endl;
+}
+
+void FrameSource::readInto(const FrameLocation &location, FrameBuffer *dst, bool verify) {
+    if (dst->pixelType != framePixelType || dst->pitch != frameBytes / static_cast<size_t>(frameHeight)) {
+        throw std::logic_error("FrameSource: the frame buffers must have the pixel type of the input and no device pitch");
+    }
+    // Keep only the file being read open: the frames are read in order, so consecutive frames are usually in the same file
+    if (openFile != location.file) {
+        files[openFile].release();
+        openFile = location.file;
+    }
+    files[location.file].readFrame(location.index, dst->get_HOST_PTR(BUF_WRITE), verify);
+}
+
+void FrameSource::readFrame(size_t index, FrameBuffer *dst) {
+    if (pushMode) {
+        throw std::logic_error("FrameSource: a pushed input has no frames before the pipeline starts");
+    }
+    if (shm) {
+        // Only the global frame is read this way: copy the oldest frame of the shared ring, it is still given to the pipeline
+        if (dst->pixelType != framePixelType || dst->pitch * static_cast<size_t>(frameHeight) != frameBytes) {
+            throw std::logic_error("FrameSource: the frame buffers must have the pixel type of the input and no device pitch");
+        }
+        if (!waitShmFrame(shmNext, false)) {
+            throw std::runtime_error("The producer of the shared memory ring " + shm->name() + " finished before publishing a frame");
+        }
+        std::memcpy(dst->get_HOST_PTR(BUF_WRITE), shm->slotData(shmNext & (shm->slots() - 1)), frameBytes);
+        return;
+    }
+    if (tileGrid) {
+        const FrameLocation &location = frames[index % frames.size()];
+        const Tile &tile = (*tileGrid)[0];
+        if (dst->pixelType != framePixelType || dst->pixelWidth != static_cast<size_t>(tileGrid->tileWidth()) || dst->height != static_cast<size_t>(tileGrid->tileHeight())) {
+            throw std::logic_error("FrameSource: the frame buffers must have the pixel type of the input and the size of a tile");
+        }
+        std::memset(dst->get_HOST_PTR(BUF_WRITE), 0, dst->size);
+        if (openFile != location.file) {
+            files[openFile].release();
+            openFile = location.file;
+        }
+        files[location.file].readRegion(location.index, tile.x, tile.y, tile.width, tile.height, dst->get_HOST_PTR(BUF_WRITE), dst->pitch);
+        return;
+    }
+    readInto(frames[index % frames.size()], dst, true);
+}
+
+void FrameSource::start(sycl::queue &Q, USMUsage &usage, size_t numSlots, FrameBuffer *idleFrame_, const FrameSourceIO &io) {
+    if (ioThread.joinable()) {
+        throw std::logic_error("FrameSource: the I/O thread is already running");
+    }
+    numSlots = std::max<size_t>(numSlots, 2);
+    idleFrame = idleFrame_;
+    ioConfig = io;
+    stopping = false;
+
+    if (shm && io.zeroCopy) {
+        // The slots of the ring are the slots of the shared ring, no I/O thread
+        for (uint32_t i = 0; i < shm->slots(); ++i) {
+            slots.push_back(new FrameBuffer(frameHeight, frameWidth, framePixelType, shm->slotData(i), BUF_READ, Q, usage));
+        }
+        if (slots.front()->pitch * static_cast<size_t>(frameHeight) == frameBytes) {
+            shmDone.assign(shm->slots(), 0);
+            stats.zeroCopy = true;
+            if constexpr (VERBOSE_ENABLED) {
+                std::cout << " Input ring: " << shm->slots() << " shared frames, read in place" << std::endl;
+            }
+            return;
+        }
+        // Rows padded to the device pitch: the frames must be copied
+        for (auto &slot : slots) {
+            delete slot;
+        }
+        slots.clear();
+    }
+
+    if (shm || pushMode) {
+        slots.reserve(numSlots);
+        freeSlots.init(numSlots);
+        readySlots.init(numSlots);
+        for (size_t i = 0; i < numSlots; ++i) {
+            slots.push_back(new FrameBuffer(frameHeight, frameWidth, framePixelType, BUF_READ, Q, usage));
+            slots.back()->get_HOST_PTR(BUF_WRITE);
+            freeSlots.push(static_cast<int>(i));
+        }
+        if (pushMode) {
+            slotFrame.assign(numSlots, 0);
+            return; // Filled by push()
+        }
+        if constexpr (VERBOSE_ENABLED) {
+            std::cout << " Input prefetch ring: " << numSlots << " frames copied from " << shm->slots() << " shared frames" << std::endl;
+        }
+        ioThread = std::thread(&FrameSource::shmLoop, this);
+        return;
+    }
+
+    ioConfig.depth = std::clamp<size_t>(io.depth, 1, numSlots);
+    // Up to two reads per frame (O_DIRECT blocks and tail); the tiles keep TILE_ROW_READS rows being read
+    reader = AsyncReader::create(io.backend, tileGrid ? std::max(2 * ioConfig.depth, TILE_ROW_READS) : 2 * ioConfig.depth);
+    stats.backend = reader->backend();
+    stats.ioDepth = ioConfig.depth;
+
+    slots.reserve(numSlots);
+    freeSlots.init(numSlots);
+    readySlots.init(numSlots);
+    readingSlots.init(numSlots);
+    pendingReads.assign(numSlots, 0);
+    slotFrame.assign(numSlots, 0);
+    slotVerify.assign(numSlots, 0);
+    slotTile.assign(numSlots, 0);
+    slotFrameNumber.assign(numSlots, 0);
+    submitTime.assign(numSlots, tbb::tick_count());
+    for (size_t i = 0; i < numSlots; ++i) {
+        slots.push_back(new FrameBuffer(height(), width(), framePixelType, BUF_READ, Q, usage));
+        slots.back()->get_HOST_PTR(BUF_WRITE); // Allocate now, not in the I/O thread
+        freeSlots.push(static_cast<int>(i));
+    }
+    if constexpr (VERBOSE_ENABLED) {
+        std::cout << " Input prefetch ring: " << numSlots << (tileGrid ? " tiles (" : " frames (") << static_cast<double>(numSlots * slots.front()->size) / (1024.0 * 1024.0) << " MB); reads: "
+                  << ioBackendName(stats.backend) << ", depth " << ioConfig.depth << (ioConfig.direct ? ", O_DIRECT" : "") << std::endl;
+    }
+    ioThread = std::thread(&FrameSource::ioLoop, this);
+}
+
+void FrameSource::stop() {
+    {
+        std::lock_guard<std::mutex> lock(ringMutex);
+        stopping = true;
+    }
+    slotFreed.notify_all();
+    frameReady.notify_all();
+    if (ioThread.joinable()) {
+        ioThread.join();
+    }
+}
+
+void FrameSource::ioLoop() {
+    try {
+        while (true) {
+            // Keep up to depth frames being read while there are free slots in the ring
+            bool stop = false;
+            while (readingSlots.count < ioConfig.depth) {
+                int slot;
+                {
+                    std::unique_lock<std::mutex> lock(ringMutex);
+                    if (readingSlots.count == 0) {
+                        slotFreed.wait(lock, [this] { return stopping || freeSlots.count > 0; });
+                    }
+                    stop = stopping;
+                    if (stopping || freeSlots.count == 0) {
+                        break;
+                    }
+                    slot = freeSlots.pop();
+                }
+                submitFrame(slot);
+            }
+            if (stop) {
+                drainReads();
+                return;
+            }
+            completeRead();
+        }
+    } catch (...) {
+        // The ring buffers must not be written once the thread is gone
+        try {
+            drainReads();
+        } catch (...) {
+        }
+        {
+            std::lock_guard<std::mutex> lock(ringMutex);
+            ioError = std::current_exception();
+        }
+        frameReady.notify_all();
+    }
+}
+
+void FrameSource::submitFrame(int slot) {
+    if (tileGrid) {
+        submitTile(slot);
+        return;
+    }
+    const FrameLocation &location = frames[nextFrame];
+    // Keep only the file being read open: its reads must complete before it is closed
+    if (openFile != location.file) {
+        while (readingSlots.count > 0) {
+            completeRead();
+        }
+        files[openFile].release();
+        openFile = location.file;
+    }
+    FrameContainer::FrameReader &file = files[location.file];
+    unsigned char *dst = slots[slot]->get_HOST_PTR(BUF_WRITE);
+    uint64_t offset = file.frameOffset(location.index);
+    uint64_t tag = static_cast<uint64_t>(slot);
+
+    // O_DIRECT for the whole blocks of the frame (the frame and the buffer must be aligned), the page cache for the tail
+    size_t direct = 0;
+    int directFd = -1;
+    if (ioConfig.direct && offset % FrameContainer::FRAME_ALIGNMENT == 0 && reinterpret_cast<uintptr_t>(dst) % FrameContainer::FRAME_ALIGNMENT == 0) {
+        directFd = file.directDescriptor();
+        if (directFd >= 0) {
+            direct = frameBytes / FrameContainer::FRAME_ALIGNMENT * FrameContainer::FRAME_ALIGNMENT;
+        }
+    }
+    pendingReads[slot] = (direct > 0 ? 1 : 0) + (direct < frameBytes ? 1 : 0);
+    slotFrame[slot] = nextFrame;
+    slotVerify[slot] = stats.loops == 0; // Only the I/O thread writes loops
+    submitTime[slot] = tbb::tick_count::now();
+    if (readingSlots.count == 0) {
+        busyStart = submitTime[slot];
+    }
+    readingSlots.push(slot);
+    if (direct > 0) {
+        reader->submit({directFd, dst, direct, offset, tag, FrameContainer::FRAME_ALIGNMENT});
+        readsInFlight++;
+    }
+    if (direct < frameBytes) {
+        reader->submit({file.descriptor(), dst + direct, frameBytes - direct, offset + direct, tag});
+        readsInFlight++;
+    }
+
+    std::lock_guard<std::mutex> lock(ringMutex);
+    if (direct > 0) {
+        stats.directFrames++;
+    }
+    if (++nextFrame == frames.size()) {
+        nextFrame = 0;
+        stats.loops++;
+    }
+}
+
+void FrameSource::submitTile(int slot) {
+    const FrameLocation &location = frames[nextFrame];
+    if (openFile != location.file) {
+        while (readingSlots.count > 0) {
+            completeRead();
+        }
+        files[openFile].release();
+        openFile = location.file;
+    }
+    FrameContainer::FrameReader &file = files[location.file];
+    const Tile &tile = (*tileGrid)[nextTile];
+    FrameBuffer *dst = slots[slot];
+    unsigned char *data = dst->get_HOST_PTR(BUF_WRITE);
+    uint64_t tag = static_cast<uint64_t>(slot);
+    if (tile.width < tileGrid->tileWidth() || tile.height < tileGrid->tileHeight()) {
+        std::memset(data, 0, dst->size); // Edge of the frame: the part of the tile outside it is zero
+    }
+
+    // Tiles as wide as the frame are a single range of the file, the others are read row by row
+    size_t pixelBytes = FrameContainer::pixelSize(framePixelType);
+    size_t rowBytes = static_cast<size_t>(tile.width) * pixelBytes;
+    size_t frameRowBytes = static_cast<size_t>(frameWidth) * pixelBytes;
+    uint64_t offset = file.frameOffset(location.index) + static_cast<uint64_t>(tile.y) * frameRowBytes + static_cast<uint64_t>(tile.x) * pixelBytes;
+    bool wholeRows = rowBytes == frameRowBytes && dst->pitch == rowBytes;
+    if (nextTile == 0) {
+        framesStarted++;
+    }
+    pendingReads[slot] = wholeRows ? 1 : tile.height;
+    slotFrame[slot] = nextFrame;
+    slotTile[slot] = nextTile;
+    slotFrameNumber[slot] = framesStarted;
+    slotVerify[slot] = 0; // The checksums cover whole frames
+    submitTime[slot] = tbb::tick_count::now();
+    if (readingSlots.count == 0) {
+        busyStart = submitTime[slot];
+    }
+    readingSlots.push(slot);
+    int fd = file.descriptor();
+    if (wholeRows) {
+        reader->submit({fd, data, rowBytes * tile.height, offset, tag});
+        readsInFlight++;
+    } else {
+        for (int r = 0; r < tile.height; ++r) {
+            if (readsInFlight == reader->capacity()) {
+                completeRead();
+            }
+            reader->submit({fd, data + r * dst->pitch, rowBytes, offset + r * frameRowBytes, tag});
+            readsInFlight++;
+        }
+    }
+
+    std::lock_guard<std::mutex> lock(ringMutex);
+    if (++nextTile == tileGrid->size()) {
+        nextTile = 0;
+        if (++nextFrame == frames.size()) {
+            nextFrame = 0;
+            stats.loops++;
+        }
+    }
+}
+
+void FrameSource::completeRead() {
+    ReadCompletion completion = reader->wait();
+    readsInFlight--;
+    int slot = static_cast<int>(completion.tag);
+    if (completion.error != 0) {
+        const FrameLocation &location = frames[slotFrame[slot]];
+        throw std::runtime_error("Failed to read frame " + std::to_string(location.index) + " of " + files[location.file].path() + " (" +
+                                 (completion.error == ENODATA ? std::string("unexpected end of file") : std::strerror(completion.error)) + ")");
+    }
+    pendingReads[slot]--;
+
+    // The frames are given to the pipeline in input order, even if their reads complete out of order
+    while (readingSlots.count > 0 && pendingReads[readingSlots.front()] == 0) {
+        int ready = readingSlots.pop();
+        if (slotVerify[ready]) {
+            const FrameLocation &location = frames[slotFrame[ready]];
+            files[location.file].verifyFrame(location.index, slots[ready]->get_HOST_PTR(BUF_READ));
+        }
+        tbb::tick_count now = tbb::tick_count::now();
+        double readTime = (now - submitTime[ready]).seconds() * 1000.0;
+        {
+            std::lock_guard<std::mutex> lock(ringMutex);
+            stats.framesRead++;
+            readTimeTotal += readTime;
+            stats.readTimeMax = std::max(stats.readTimeMax, readTime);
+            if (readingSlots.count == 0) {
+                busyTime += (now - busyStart).seconds() * 1000.0;
+            }
+            readySlots.push(ready);
+        }
+        frameReady.notify_one();
+    }
+}
+
+void FrameSource::drainReads() {
+    while (readsInFlight > 0) {
+        reader->wait();
+        readsInFlight--;
+    }
+}
+
+bool FrameSource::waitShmFrame(uint32_t index, bool countStall) {
+    tbb::tick_count t0 = tbb::tick_count::now();
+    bool stalled = false;
+    bool ready = false;
+    while (true) {
+        SharedFrameRing::WaitResult result = shm->waitFrame(index, SharedFrameRing::POLL_MS);
+        if (result == SharedFrameRing::WaitResult::Ready) {
+            ready = true;
+            break;
+        }
+        stalled = true;
+        std::lock_guard<std::mutex> lock(ringMutex);
+        if (result == SharedFrameRing::WaitResult::Closed || stopping) {
+            break;
+        }
+    }
+    if (countStall && stalled) {
+        std::lock_guard<std::mutex> lock(ringMutex);
+        stats.stalls++;
+        stats.stallTime += (tbb::tick_count::now() - t0).seconds() * 1000.0;
+    }
+    return ready;
+}
+
+void FrameSource::shmLoop() {
+    try {
+        uint32_t mask = shm->slots() - 1;
+        while (true) {
+            int slot;
+            {
+                std::unique_lock<std::mutex> lock(ringMutex);
+                slotFreed.wait(lock, [this] { return stopping || freeSlots.count > 0; });
+                if (stopping) {
+                    return;
+                }
+                slot = freeSlots.pop();
+            }
+            if (!waitShmFrame(shmNext, false)) {
+                std::lock_guard<std::mutex> lock(ringMutex);
+                if (stopping) {
+                    return;
+                }
+                throw std::runtime_error("The producer of the shared memory ring " + shm->name() + " finished after " + std::to_string(stats.framesRead) + " frames");
+            }
+
+            // Copy the frame and give its shared slot back at once, so the producer never waits for the pipeline
+            tbb::tick_count t0 = tbb::tick_count::now();
+            std::memcpy(slots[slot]->get_HOST_PTR(BUF_WRITE), shm->slotData(shmNext & mask), frameBytes);
+            shm->releaseUntil(++shmNext);
+            double copyTime = (tbb::tick_count::now() - t0).seconds() * 1000.0;
+            {
+                std::lock_guard<std::mutex> lock(ringMutex);
+                stats.framesRead++;
+                readTimeTotal += copyTime;
+                stats.readTimeMax = std::max(stats.readTimeMax, copyTime);
+                busyTime += copyTime;
+                readySlots.push(slot);
+            }
+            frameReady.notify_one();
+        }
+    } catch (...) {
+        {
+            std::lock_guard<std::mutex> lock(ringMutex);
+            ioError = std::current_exception();
+        }
+        frameReady.notify_all();
+    }
+}
+
+size_t FrameSource::push(const void *pixels, int timeoutMs) {
+    if (!pushMode) {
+        throw std::logic_error("FrameSource: only a pushed input accepts frames");
+    }
+    int slot;
+    {
+        std::unique_lock<std::mutex> lock(ringMutex);
+        if (pushClosed || stopping) {
+            throw std::logic_error("FrameSource: the input has been closed");
+        }
+        if (freeSlots.count == 0) {
+            auto available = [this] { return stopping || freeSlots.count > 0; };
+            tbb::tick_count t0 = tbb::tick_count::now();
+            if (timeoutMs < 0) {
+                slotFreed.wait(lock, available);
+            } else if (!slotFreed.wait_for(lock, std::chrono::milliseconds(timeoutMs), available)) {
+                return 0;
+            }
+            stats.pushWaits++;
+            stats.pushWaitTime += (tbb::tick_count::now() - t0).seconds() * 1000.0;
+            if (stopping) {
+                throw std::logic_error("FrameSource: the input has been stopped");
+            }
+        }
+        slot = freeSlots.pop();
+    }
+
+    // Only the caller owns the slot until it is marked as ready, the copy is done without the lock
+    tbb::tick_count t0 = tbb::tick_count::now();
+    std::memcpy(slots[slot]->get_HOST_PTR(BUF_WRITE), pixels, frameBytes);
+    double copyTime = (tbb::tick_count::now() - t0).seconds() * 1000.0;
+    size_t frame;
+    {
+        std::lock_guard<std::mutex> lock(ringMutex);
+        frame = ++stats.framesRead; // Numbered when it becomes ready, so the numbers follow the order of the ring
+        slotFrame[slot] = frame;
+        readTimeTotal += copyTime;
+        stats.readTimeMax = std::max(stats.readTimeMax, copyTime);
+        busyTime += copyTime;
+        readySlots.push(slot);
+    }
+    frameReady.notify_all();
+    return frame;
+}
+
+void FrameSource::close() {
+    {
+        std::lock_guard<std::mutex> lock(ringMutex);
+        pushClosed = true;
+    }
+    frameReady.notify_all();
+}
+
+bool FrameSource::reserveFrame() {
+    if (!pushMode) {
+        return true;
+    }
+    // Several input nodes may run at the same time (syclevents): each reserved frame is guaranteed to be pushed
+    std::unique_lock<std::mutex> lock(ringMutex);
+    auto pending = [this] { return stats.framesRead - framesReserved; };
+    if (pending() == 0 && !pushClosed && !stopping) {
+        stats.stalls++;
+        tbb::tick_count t0 = tbb::tick_count::now();
+        frameReady.wait(lock, [&] { return pending() > 0 || pushClosed || stopping; });
+        stats.stallTime += (tbb::tick_count::now() - t0).seconds() * 1000.0;
+    }
+    if (pending() == 0) {
+        return false;
+    }
+    framesReserved++;
+    return true;
+}
+
+void FrameSource::acquire(ViVidItem *item) {
+    if (stats.zeroCopy) {
+        // Several input nodes may take frames at the same time (syclevents): the wait, the slot and the increment of
+        // shmNext go under their own lock. Not ringMutex: release() needs it to give the slots the producer waits for
+        int slot;
+        {
+            std::lock_guard<std::mutex> take(shmTakeMutex);
+            if (!waitShmFrame(shmNext, true)) {
+                std::lock_guard<std::mutex> lock(ringMutex);
+                throw std::runtime_error("The producer of the shared memory ring " + shm->name() + " finished after " + std::to_string(stats.framesRead) + " frames");
+            }
+            slot = static_cast<int>(shmNext & (shm->slots() - 1));
+            shmNext++;
+            std::lock_guard<std::mutex> lock(ringMutex);
+            stats.framesRead++;
+        }
+        item->frame = slots[slot];
+        item->frameSlot = slot;
+        return;
+    }
+
+    std::unique_lock<std::mutex> lock(ringMutex);
+    if (readySlots.count == 0 && !ioError) {
+        stats.stalls++;
+        tbb::tick_count t0 = tbb::tick_count::now();
+        frameReady.wait(lock, [this] { return readySlots.count > 0 || ioError || stopping; });
+        stats.stallTime += (tbb::tick_count::now() - t0).seconds() * 1000.0;
+    }
+    if (readySlots.count == 0) {
+        if (ioError) {
+            std::rethrow_exception(ioError);
+        }
+        throw std::runtime_error("FrameSource: the I/O thread has been stopped");
+    }
+    int slot = readySlots.pop();
+    item->frame = slots[slot];
+    item->frameSlot = slot;
+    if (tileGrid) {
+        item->tile = &(*tileGrid)[slotTile[slot]];
+        item->tileFrame = slotFrameNumber[slot];
+    }
+    if (pushMode) {
+        // Several input nodes may take frames at the same time (syclevents): the id is the number returned by push()
+        item->item_id = slotFrame[slot];
+    } else if (!shm) {
+        item->inputFrame = slotFrame[slot] + 1;
+    }
+}
+
+void FrameSource::release(ViVidItem *item) {
+    if (item->frameSlot < 0) {
+        return;
+    }
+    if (stats.zeroCopy) {
+        // The shared slots are given back in order, once every older frame has been released too
+        std::lock_guard<std::mutex> lock(ringMutex);
+        uint32_t mask = shm->slots() - 1;
+        shmDone[item->frameSlot] = 1;
+        uint32_t first = shmReleased;
+        while (shmDone[shmReleased & mask]) {
+            shmDone[shmReleased & mask] = 0;
+            shmReleased++;
+        }
+        if (shmReleased != first) {
+            shm->releaseUntil(shmReleased);
+        }
+        item->frame = idleFrame;
+        item->frameSlot = -1;
+        return;
+    }
+    {
+        std::lock_guard<std::mutex> lock(ringMutex);
+        freeSlots.push(item->frameSlot);
+    }
+    slotFreed.notify_one();
+    item->frame = idleFrame;
+    item->frameSlot = -1;
+    item->tile = nullptr;
+}
+
+bool FrameSource::holdsFirstFrame(const ViVidItem *item) const {
+    if (shm || pushMode || item->inputFrame != 1) {
+        return false;
+    }
+    return !tileGrid || item->tile == &(*tileGrid)[0];
+}
+
+FrameSourceStats FrameSource::getStats() {
+    std::lock_guard<std::mutex> lock(ringMutex);
+    FrameSourceStats snapshot = stats;
+    if (stats.framesRead > 0) {
+        snapshot.readTimeAvg = readTimeTotal / stats.framesRead;
+    }
+    if (busyTime > 0) {
+        size_t bytes = tileGrid ? static_cast<size_t>(height()) * width() * FrameContainer::pixelSize(framePixelType) : frameBytes;
+        snapshot.bandwidth = (static_cast<double>(stats.framesRead * bytes) / (1024.0 * 1024.0)) / (busyTime / 1000.0);
+    }
+    return snapshot;
+}
@@ -0,0 +1,77 @@
+#include "GPUCompletion.hpp"
+#include <algorithm>
+
+namespace {
+bool isComplete(const sycl::event &event) {
+    return event.get_info<sycl::info::event::command_execution_status>() == sycl::info::event_command_status::complete;
+}
+
+void resumeTask(void *tag, void *, const sycl::event &) {
+    tbb::task::resume(static_cast<tbb::task::suspend_point>(tag));
+}
+} // namespace
+
+GPUCompletion::GPUCompletion() {
+    completion = std::thread(&GPUCompletion::completionLoop, this);
+}
+
+GPUCompletion::~GPUCompletion() {
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        stopping = true;
+    }
+    ready.notify_one();
+    completion.join();
+}
+
+void GPUCompletion::await(sycl::event &event) {
+    tbb::task::suspend([&](tbb::task::suspend_point tag) { notify(event, resumeTask, tag, nullptr); });
+    // The event has completed: this only reports the errors of the kernel
+    event.wait_and_throw();
+}
+
+void GPUCompletion::notify(const sycl::event &event, Callback done, void *context, void *arg) {
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        pending.push_back({event, done, context, arg});
+    }
+    ready.notify_one();
+}
+
+size_t GPUCompletion::getCompleted() {
+    std::lock_guard<std::mutex> lock(mutex);
+    return completed;
+}
+
+void GPUCompletion::completionLoop() {
+    std::vector<Pending> waiting;
+    size_t finishedStages = 0; //< Completed since the last time the lock was taken
+    while (true) {
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            completed += finishedStages;
+            finishedStages = 0;
+            ready.wait(lock, [&] { return stopping || !pending.empty() || !waiting.empty(); });
+            if (stopping && pending.empty() && waiting.empty()) {
+                return;
+            }
+            waiting.insert(waiting.end(), pending.begin(), pending.end());
+            pending.clear();
+        }
+
+        // Wait for the oldest kernel and complete every stage whose kernel has finished by then. The errors are left to
+        // the completions (the queues report them to their async handler, await rethrows them)
+        try {
+            waiting.front().event.wait();
+        } catch (const sycl::exception &) {
+        }
+        auto finished = std::stable_partition(waiting.begin() + 1, waiting.end(), [](const Pending &p) { return !isComplete(p.event); });
+        finishedStages = 1 + static_cast<size_t>(waiting.end() - finished);
+        waiting.front().done(waiting.front().context, waiting.front().arg, waiting.front().event);
+        for (auto it = finished; it != waiting.end(); ++it) {
+            it->done(it->context, it->arg, it->event);
+        }
+        waiting.erase(finished, waiting.end());
+        waiting.erase(waiting.begin());
+    }
+}
@@ -1,42 +1,58 @@
 #include "ImageUtils.hpp"
+#include "FrameContainer.hpp"
 #include "GlobalParameters.hpp"
+#include <cerrno>
+#include <cstdint>
+#include <cstring>
+#include <fcntl.h>
 #include <filesystem>
-#include <fstream>
 #include <iostream>
 #include <stdexcept>
 #include <string>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
 
-Image::Image() : imageData(nullptr) {}
+Image::Image() {}
 
-std::ifstream Image::openImageFile(const std::string &imagePath) {
-    std::ifstream fbin(imagePath, std::ios::binary);
-    if (!fbin) {
-        throw std::runtime_error("Failed to open image file: " + imagePath);
-    }
-    return fbin;
+Image::~Image() {
+    release();
 }
 
-std::unique_ptr<float[]> Image::readImageData(std::ifstream &fbin, int &height, int &width) {
-    // Leer las dimensiones de la imagen
-    readImageDimensions(fbin, height, width);
+void Image::mapImageFile(const std::string &imagePath) {
+    fd = ::open(imagePath.c_str(), O_RDONLY);
+    if (fd < 0) {
+        throw std::runtime_error("Failed to open image file: " + imagePath + " (" + std::strerror(errno) + ")");
+    }
 
-    // Calcular el tamaño del buffer y leer los datos de la imagen
-    size_t size = height * width;
-    std::unique_ptr<float[]> data(new float[size]);
-    fbin.read(reinterpret_cast<char *>(data.get()), size * sizeof(float));
-    return data;
-}
+    struct stat st;
+    if (fstat(fd, &st) != 0) {
+        release();
+        throw std::runtime_error("Failed to get the size of the image file: " + imagePath);
+    }
+    mappingSize = static_cast<size_t>(st.st_size);
 
-void Image::readImageDimensions(std::ifstream &fbin, int &height, int &width) {
-    fbin.read(reinterpret_cast<char *>(&height), sizeof(height));
-    fbin.read(reinterpret_cast<char *>(&width), sizeof(width));
+    mapping = mmap(nullptr, mappingSize, PROT_READ, MAP_PRIVATE, fd, 0);
+    if (mapping == MAP_FAILED) {
+        mapping = nullptr;
+        release();
+        throw std::runtime_error("Failed to map image file: " + imagePath + " (" + std::strerror(errno) + ")");
+    }
+    // The whole file is read once, sequentially (the advice values are not flags: one call each). The advice only
+    // affects read-ahead, so a kernel that rejects it costs speed, not correctness
+    if (madvise(mapping, mappingSize, MADV_SEQUENTIAL) != 0) {
+        std::cerr << " madvise(MADV_SEQUENTIAL) on " << imagePath << " failed: " << std::strerror(errno) << std::endl;
+    }
+    if (madvise(mapping, mappingSize, MADV_WILLNEED) != 0) {
+        std::cerr << " madvise(MADV_WILLNEED) on " << imagePath << " failed: " << std::strerror(errno) << std::endl;
+    }
 }
 
 std::string Image::getExampleImagePath(int quality) {
     return "image" + convertImageTypeToString(quality) + ".bin";
 }
 
-std::unique_ptr<float[]> Image::loadImageData(int quality, int &height, int &width) {
+void Image::loadImageData(int quality, int &height, int &width) {
     std::filesystem::path exe_path = std::filesystem::canonical("/proc/self/exe").parent_path();
     std::string path = exe_path.string() + "/media/" + getExampleImagePath(quality);
 
@@ -46,26 +62,62 @@ std::unique_ptr<float[]> Image::loadImageData(int quality, int &height, int &wid
     std::size_t found = path.find_last_of("/\\");
     std::string fileName = path.substr(found + 1);
     std::cout << " Open image file (bin): " << fileName << std::endl;
-    std::ifstream fbin = openImageFile(path);
 
-    imageData = readImageData(fbin, height, width);
-    std::cout << " Height = " << height << "; Width = " << width
-              << (VERBOSE_ENABLED ? "; Data size = " + std::to_string(static_cast<double>(height * width * sizeof(float)) / (1024.0 * 1024.0)) + " MB" : "")
-              << std::endl;
+    release();
 
-    // Crear un nuevo std::unique_ptr con el tamaño adecuado
-    std::unique_ptr<float[]> copy(new float[height * width]);
+    // Leer y validar la cabecera del contenedor (dimensiones, tipo y tamaño del fichero)
+    FrameContainer::FrameReader reader(path);
+    if (reader.channels() != 1) {
+        throw std::runtime_error("Image file " + fileName + " has " + std::to_string(reader.channels()) + " " + FrameContainer::pixelTypeName(reader.pixelType()) +
+                                 " channels, the pipeline needs a single (grayscale) channel");
+    }
+    height = static_cast<int>(reader.height());
+    width = static_cast<int>(reader.width());
+    imageSize = reader.frameBytes();
+    pixelType = reader.pixelType();
 
-    // Copiar los datos de imageData al nuevo buffer
-    std::copy(imageData.get(), imageData.get() + height * width, copy.get());
+    // Proyectar el fichero y apuntar al primer frame
+    mapImageFile(path);
+    imageData = static_cast<const char *>(mapping) + reader.frameOffset(0);
+    try {
+        reader.verifyFrame(0, imageData);
+    } catch (...) {
+        release();
+        throw;
+    }
 
-    return copy;
+    std::cout << " Height = " << height << "; Width = " << width << "; Pixels = " << FrameContainer::pixelTypeName(pixelType)
+              << (VERBOSE_ENABLED ? "; Data size = " + std::to_string(static_cast<double>(imageSize) / (1024.0 * 1024.0)) + " MB" : "")
+              << std::endl;
 }
 
-const std::unique_ptr<float[]> &Image::getImageData() const {
+const void *Image::getImageData() const {
     return imageData;
 }
 
+FrameContainer::PixelType Image::getPixelType() const {
+    return pixelType;
+}
+
+size_t Image::getImageSize() const {
+    return imageSize;
+}
+
+void Image::release() {
+    if (mapping != nullptr) {
+        munmap(mapping, mappingSize);
+        mapping = nullptr;
+    }
+    if (fd >= 0) {
+        ::close(fd);
+        fd = -1;
+    }
+    mappingSize = 0;
+    imageData = nullptr;
+    imageSize = 0;
+    pixelType = FrameContainer::PixelType::Float32;
+}
+
 const std::string Image::convertImageTypeToString(int type) const {
     switch (type) {
     case 1:
@@ -0,0 +1,102 @@
+#include "MemoryBudget.hpp"
+#include <algorithm>
+#include <cctype>
+#include <iomanip>
+#include <iostream>
+#include <limits>
+#include <regex>
+#include <stdexcept>
+
+namespace {
+constexpr double MB = 1024.0 * 1024.0;
+
+// Number of rows of the classification coefficients buffer (see DataBuffers::createGlobalCla)
+size_t claRows(const ApplicationData &appData) {
+    size_t n_blocks_x = appData.windowWidth / appData.cellSize - appData.blockSize + 1;
+    size_t n_blocks_y = appData.window_height / appData.cellSize - appData.blockSize + 1;
+    return appData.blockSize * appData.blockSize * n_blocks_x * n_blocks_y;
+}
+} // namespace
+
+size_t MemoryBudget::globalFootprint(const ApplicationData &appData) {
+    size_t frame = static_cast<size_t>(appData.height) * appData.width * FrameContainer::pixelSize(appData.pixelType);
+    size_t filterBank = static_cast<size_t>(appData.numFilters) * appData.filterSize * sizeof(float);
+    size_t cla = claRows(appData) * appData.dictSize * sizeof(float);
+    return frame + filterBank + cla;
+}
+
+size_t MemoryBudget::itemFootprint(const ApplicationData &appData) {
+    // Same sizes as the buffers created in the ViVidItem constructor
+    size_t pixels = static_cast<size_t>(appData.height) * appData.width;
+    size_t cells = static_cast<size_t>(appData.width / 8) * (appData.height / 8);
+    size_t ind = pixels * sizeof(float);
+    size_t val = pixels * sizeof(float);
+    size_t his = cells * appData.numFilters * sizeof(float);
+    size_t out = claRows(appData) * cells * sizeof(float);
+    return ind + val + his + out + sizeof(ViVidItem) + 4 * sizeof(FloatBuffer);
+}
+
+void MemoryBudget::apply(const ApplicationData &appData, InputArgs &inputArgs) {
+    if (inputArgs.memBudget == 0) {
+        return;
+    }
+
+    size_t global = globalFootprint(appData);
+    size_t perItem = itemFootprint(appData);
+    // The branches of --stages but the first of each level write their own output
+    size_t cells = static_cast<size_t>(appData.width / 8) * (appData.height / 8);
+    perItem += (inputArgs.numStages() - inputArgs.stageLevels.size()) * claRows(appData) * cells * sizeof(float);
+    if (!inputArgs.inputPath.empty()) {
+        // Prefetch ring of the multi-frame input: one frame per token plus the frames read ahead
+        size_t frame = static_cast<size_t>(appData.height) * appData.width * FrameContainer::pixelSize(appData.pixelType);
+        global += static_cast<size_t>(inputArgs.prefetchFrames) * frame;
+        perItem += frame;
+    }
+    if (inputArgs.memBudget < global + perItem) {
+        throw std::invalid_argument("The memory budget (" + std::to_string(inputArgs.memBudget / MB) + " MB) cannot hold the global buffers (" +
+                                    std::to_string(global / MB) + " MB) and one item (" + std::to_string(perItem / MB) + " MB)");
+    }
+    size_t maxItems = (inputArgs.memBudget - global) / perItem;
+
+    // The number of tokens can never be larger than the number of items
+    inputArgs.maxTokens = static_cast<int>(std::min<size_t>(maxItems, std::numeric_limits<int>::max()));
+    if (inputArgs.inFlightFrames > inputArgs.maxTokens) {
+        std::cout << " Memory budget: reducing the in-flight frames from " << inputArgs.inFlightFrames << " to " << inputArgs.maxTokens << std::endl;
+        inputArgs.inFlightFrames = inputArgs.maxTokens;
+    }
+
+    // In AUTO mode the optimizer can increase the tokens up to maxTokens, so the pool must be able to hold them
+    size_t poolSize = AUTOMODE_ENABLED ? maxItems : std::min(inputArgs.sizeCircularBuffer, maxItems);
+    inputArgs.sizeCircularBuffer = std::max(poolSize, static_cast<size_t>(std::max(inputArgs.inFlightFrames, 1)));
+
+    std::cout << " Memory budget: " << std::fixed << std::setprecision(2) << inputArgs.memBudget / MB << " MB (global buffers: " << global / MB
+              << " MB; per item: " << perItem / MB << " MB)" << std::endl;
+    std::cout << " Memory budget: max. tokens = " << inputArgs.maxTokens << "; in-flight frames = " << inputArgs.inFlightFrames
+              << "; pool size = " << inputArgs.sizeCircularBuffer << " items" << std::endl;
+}
+
+size_t MemoryBudget::parseSize(const std::string &str) {
+    std::regex sizePattern(R"(^\s*(\d+(?:\.\d+)?)\s*([kKmMgGtT]?)[bB]?\s*$)");
+    std::smatch match;
+    if (!std::regex_match(str, match, sizePattern)) {
+        throw std::invalid_argument("Invalid memory size '" + str + "'. Should be like '512M', '8G' or a number of bytes.");
+    }
+    double value = std::stod(match[1].str());
+    switch (match[2].length() ? std::toupper(match[2].str()[0]) : 'B') {
+    case 'T':
+        value *= 1024.0;
+        [[fallthrough]];
+    case 'G':
+        value *= 1024.0;
+        [[fallthrough]];
+    case 'M':
+        value *= 1024.0;
+        [[fallthrough]];
+    case 'K':
+        value *= 1024.0;
+        break;
+    default:
+        break;
+    }
+    return static_cast<size_t>(value);
+}
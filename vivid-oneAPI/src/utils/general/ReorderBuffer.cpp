@@ -0,0 +1,162 @@
+#include "ReorderBuffer.hpp"
+#include <algorithm>
+#include <sstream>
+#include <stdexcept>
+
+ReorderBuffer::ReorderBuffer(const ReorderConfig &config, size_t poolCapacity, size_t firstId) : gap{config.gap}, next{firstId} {
+    if (poolCapacity == 0) {
+        throw std::invalid_argument("ReorderBuffer: the item pool is empty");
+    }
+    if (config.timeout < 0.0) {
+        throw std::invalid_argument("ReorderBuffer: the timeout must not be negative");
+    }
+    // Every held frame keeps its item: a window larger than the pool could never fill
+    const size_t window = config.window == 0 ? poolCapacity : std::min(config.window, poolCapacity);
+    timeout = std::chrono::duration_cast<Clock::duration>(std::chrono::duration<double, std::milli>(config.timeout));
+    slots.resize(window);
+    ready.reserve(poolCapacity);
+    batch.reserve(poolCapacity);
+}
+
+void ReorderBuffer::push(ViVidItem *item, Deliver deliver, void *context) {
+    const size_t id = item->item_id;
+    const Clock::time_point now = Clock::now();
+    std::unique_lock<std::mutex> lock(mutex);
+    arrivals++;
+    depthSum += held;
+
+    if (id < next) {
+        // Its gap was skipped: the younger frames are already out
+        stats.lateFrames++;
+        lock.unlock();
+        deliver(context, item, false);
+        return;
+    }
+
+    // The frame does not fit in the window: skip the oldest frames until it does (only with a --reorder-window
+    // smaller than the pool, the ids in flight always fit in the whole pool)
+    const size_t window = slots.size();
+    while (id >= next + window) {
+        if (slots[next % window].item != nullptr) {
+            take(next, now);
+        } else {
+            stats.skipped++;
+        }
+        next++;
+        blockedSince = now;
+    }
+
+    Slot &slot = slots[id % window];
+    slot.item = item;
+    slot.arrival = now;
+    slot.held = id != next;
+    if (slot.held) {
+        if (held == 0) {
+            blockedSince = now;
+        }
+        stats.heldFrames++;
+    }
+    held++;
+
+    // The head of the window delivers the run of frames it was holding back
+    if (slots[next % window].item != nullptr) {
+        while (slots[next % window].item != nullptr) {
+            take(next, now);
+            next++;
+        }
+        blockedSince = now; // The frames left wait for a new gap
+    }
+    stats.peakDepth = std::max(stats.peakDepth, held);
+
+    if (gap == ReorderGap::Skip && held > 0 && now - blockedSince >= timeout) {
+        skipGap(now);
+    }
+    drain(lock, deliver, context);
+}
+
+void ReorderBuffer::flush(Deliver deliver, void *context) {
+    std::unique_lock<std::mutex> lock(mutex);
+    const Clock::time_point now = Clock::now();
+    const size_t window = slots.size();
+    while (held > 0) {
+        if (slots[next % window].item != nullptr) {
+            take(next, now);
+        } else {
+            stats.skipped++;
+        }
+        next++;
+    }
+    drain(lock, deliver, context);
+}
+
+void ReorderBuffer::take(size_t id, Clock::time_point now) {
+    Slot &slot = slots[id % slots.size()];
+    if (slot.held) {
+        double waited = std::chrono::duration<double, std::milli>(now - slot.arrival).count();
+        stats.blockedTime += waited;
+        stats.blockedTimeMax = std::max(stats.blockedTimeMax, waited);
+    }
+    ready.push_back(slot.item);
+    slot.item = nullptr;
+    slot.held = false;
+    held--;
+    stats.delivered++;
+}
+
+void ReorderBuffer::skipGap(Clock::time_point now) {
+    // Skip the missing frames up to the oldest held one, then deliver the run that starts there
+    const size_t window = slots.size();
+    while (slots[next % window].item == nullptr) {
+        stats.skipped++;
+        next++;
+    }
+    while (slots[next % window].item != nullptr) {
+        take(next, now);
+        next++;
+    }
+    blockedSince = now;
+}
+
+void ReorderBuffer::drain(std::unique_lock<std::mutex> &lock, Deliver deliver, void *context) {
+    // Another thread is delivering: it also delivers the frames queued here before it leaves
+    if (delivering) {
+        return;
+    }
+    delivering = true;
+    while (!ready.empty()) {
+        batch.swap(ready);
+        lock.unlock();
+        try {
+            for (ViVidItem *item : batch) {
+                deliver(context, item, true);
+            }
+        } catch (...) {
+            lock.lock();
+            batch.clear();
+            delivering = false;
+            throw;
+        }
+        batch.clear();
+        lock.lock();
+    }
+    delivering = false;
+}
+
+ReorderStats ReorderBuffer::getStats() {
+    std::lock_guard<std::mutex> lock(mutex);
+    ReorderStats snapshot = stats;
+    snapshot.window = slots.size();
+    snapshot.meanDepth = arrivals > 0 ? static_cast<double>(depthSum) / arrivals : 0.0;
+    return snapshot;
+}
+
+std::string ReorderBuffer::describe() const {
+    std::ostringstream text;
+    text << "window of " << slots.size() << " frames, ";
+    if (gap == ReorderGap::Skip) {
+        text << "late frames skipped after " << std::chrono::duration<double, std::milli>(timeout).count() << " ms";
+    } else {
+        text << "late frames waited for";
+    }
+    return text.str();
+}
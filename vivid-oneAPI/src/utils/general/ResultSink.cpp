@@ -0,0 +1,350 @@
+#include "ResultSink.hpp"
+#include <algorithm>
+#include <cerrno>
+#include <charconv>
+#include <cstring>
+#include <limits>
+#include <stdexcept>
+#include <tbb/tick_count.h>
+
+namespace {
+constexpr char SINK_MAGIC[4] = {'V', 'V', 'D', 'T'};
+constexpr uint32_t SINK_VERSION = 1;
+constexpr int CELL_SIZE = 8; //< Pixels per cell of the histograms (the stride of the window positions)
+constexpr int APRON = 1;     //< Border of the frame without cells (filterDim / 2, see block_histogram)
+
+bool worse(const Detection &a, const Detection &b) {
+    return a.score < b.score;
+}
+
+/**
+ * @brief Add a detection to a max-heap of the k best (smallest score) detections.
+ */
+void keepBest(Detection *heap, size_t &count, size_t k, const Detection &detection) {
+    if (count == k) {
+        if (!(detection.score < heap[0].score)) {
+            return;
+        }
+        std::pop_heap(heap, heap + count, worse);
+        heap[count - 1] = detection;
+    } else {
+        heap[count++] = detection;
+    }
+    std::push_heap(heap, heap + count, worse);
+}
+
+template <typename T>
+void appendRaw(std::string &buffer, const T &value) {
+    buffer.append(reinterpret_cast<const char *>(&value), sizeof(T));
+}
+
+template <typename T>
+void appendNumber(std::string &buffer, T value) {
+    char digits[32];
+    auto [end, ec] = std::to_chars(digits, digits + sizeof(digits), value);
+    buffer.append(digits, end);
+}
+} // namespace
+
+ResultSink::ResultSink(const ResultSinkConfig &config_, int frameWidth, int frameHeight)
+    : config{config_} {
+    if (config.depth == 0 || config.topK == 0) {
+        throw std::invalid_argument("ResultSink: the queue depth and the detections per frame must be at least 1");
+    }
+    if (config.tiles != nullptr && config.drop) {
+        throw std::invalid_argument("ResultSink: the tiles of a frame cannot be dropped");
+    }
+    // Same layout as the histograms of stage 2: the cells start after the apron of the filter
+    int itemWidth = config.tiles != nullptr ? config.tiles->tileWidth() : frameWidth;
+    int itemHeight = config.tiles != nullptr ? config.tiles->tileHeight() : frameHeight;
+    cellsX = std::max(0, (itemWidth - 2 * APRON) / CELL_SIZE);
+    cellsY = std::max(0, (itemHeight - 2 * APRON) / CELL_SIZE);
+    size_t cells = static_cast<size_t>(cellsX) * static_cast<size_t>(cellsY);
+
+    if (!config.callback) {
+        file = std::fopen(config.path.c_str(), "wb");
+        if (file == nullptr) {
+            throw std::runtime_error("Unable to open the result sink " + config.path + " (" + std::strerror(errno) + ")");
+        }
+    }
+    if (file != nullptr && config.format == ResultSinkConfig::Format::Binary) {
+        std::string header;
+        header.append(SINK_MAGIC, sizeof(SINK_MAGIC));
+        appendRaw(header, SINK_VERSION);
+        appendRaw(header, static_cast<uint32_t>(frameWidth));
+        appendRaw(header, static_cast<uint32_t>(frameHeight));
+        appendRaw(header, static_cast<uint32_t>(config.topK));
+        if (std::fwrite(header.data(), 1, header.size(), file) != header.size()) {
+            std::fclose(file);
+            throw std::runtime_error("Unable to write the header of the result sink " + config.path);
+        }
+        stats.bytesWritten = header.size();
+    }
+
+    // Everything the output node touches is allocated here
+    slots.resize(config.depth);
+    for (auto &slot : slots) {
+        slot.detections.resize(config.topK);
+        slot.best.resize(cells);
+        slot.bestClass.resize(cells);
+    }
+    if (config.tiles != nullptr) {
+        partials.resize(config.depth); // Grows if more frames are incomplete at the same time
+        for (auto &partial : partials) {
+            partial.detections.resize(config.topK);
+        }
+    }
+    record.reserve(64 + config.topK * 80);
+    stats.depth = config.depth;
+
+    writer = std::thread(&ResultSink::writeLoop, this);
+}
+
+ResultSink::~ResultSink() {
+    try {
+        stop();
+    } catch (const std::exception &) {
+        // The error has already been reported by stop() if it was called explicitly
+    }
+}
+
+void ResultSink::submit(ViVidItem *item) {
+    std::unique_lock<std::mutex> lock(mutex);
+    if (tail - head == slots.size()) {
+        if (config.drop) {
+            ++stats.framesDropped;
+            return;
+        }
+        tbb::tick_count waitStart = tbb::tick_count::now();
+        slotFree.wait(lock, [this] { return tail - head < slots.size(); });
+        ++stats.blockedFrames;
+        stats.blockedTime += (tbb::tick_count::now() - waitStart).seconds() * 1000;
+    }
+    Slot &slot = slots[tail % slots.size()];
+    ++tail;
+    stats.peakQueued = std::max(stats.peakQueued, tail - head);
+    lock.unlock();
+
+    // The slot is owned by this thread until it is marked as ready
+    reduce(item, slot);
+
+    lock.lock();
+    slot.ready = true;
+    lock.unlock();
+    slotReady.notify_one();
+}
+
+void ResultSink::reduce(ViVidItem *item, Slot &slot) {
+    const float *out = item->out->get_HOST_PTR(BUF_READ);
+    size_t pitch = item->out->pitch / sizeof(float);
+    size_t classes = item->out->height;
+    size_t cells = std::min(item->out->width, slot.best.size());
+    // With regions of interest only the span of active cells has been computed
+    const ActiveRegion *region = item->region;
+    size_t first = region != nullptr ? std::min(region->firstCell, cells) : 0;
+    size_t end = region != nullptr ? std::min(region->endCell, cells) : cells;
+
+    // Best class of each cell (row by row, so the output is read sequentially)
+    std::fill(slot.best.begin() + first, slot.best.begin() + end, std::numeric_limits<float>::infinity());
+    for (size_t c = 0; c < classes; ++c) {
+        const float *row = out + c * pitch;
+        for (size_t j = first; j < end; ++j) {
+            if (row[j] < slot.best[j]) {
+                slot.best[j] = row[j];
+                slot.bestClass[j] = static_cast<uint32_t>(c);
+            }
+        }
+    }
+
+    // Keep the topK cells with the smallest distance (max-heap on the score); a tile only reports the cells it owns and a
+    // frame with regions of interest its active cells
+    const Tile *tile = item->tile;
+    int x0 = 0, x1 = cellsX, y0 = 0, y1 = cellsY;
+    if (tile != nullptr) {
+        x0 = tile->cellX0;
+        x1 = tile->cellX1;
+        y0 = tile->cellY0;
+        y1 = tile->cellY1;
+    } else if (region != nullptr) {
+        x0 = region->cells.x;
+        x1 = region->cells.x + region->cells.width;
+        y0 = region->cells.y;
+        y1 = region->cells.y + region->cells.height;
+    }
+    uint32_t originX = tile != nullptr ? static_cast<uint32_t>(tile->x) : 0;
+    uint32_t originY = tile != nullptr ? static_cast<uint32_t>(tile->y) : 0;
+    Detection *heap = slot.detections.data();
+    size_t k = slot.detections.size();
+    size_t count = 0;
+    for (int cy = y0; cy < y1; ++cy) {
+        for (int cx = x0; cx < x1; ++cx) {
+            size_t j = static_cast<size_t>(cy) * cellsX + cx;
+            if (j >= end) {
+                break;
+            }
+            Detection detection{originX + static_cast<uint32_t>(cx * CELL_SIZE), originY + static_cast<uint32_t>(cy * CELL_SIZE), slot.bestClass[j], slot.best[j]};
+            keepBest(heap, count, k, detection);
+        }
+    }
+    std::sort_heap(heap, heap + count, worse);
+
+    slot.frameId = tile != nullptr ? item->tileFrame : item->item_id;
+    slot.tile = tile != nullptr;
+    slot.count = count;
+}
+
+ResultSink::PartialFrame &ResultSink::stitch(const Slot &slot) {
+    PartialFrame *partial = nullptr;
+    PartialFrame *free = nullptr;
+    for (auto &p : partials) {
+        if (p.tilesLeft > 0 && p.frameId == slot.frameId) {
+            partial = &p;
+            break;
+        }
+        if (p.tilesLeft == 0 && free == nullptr) {
+            free = &p;
+        }
+    }
+    if (partial == nullptr) {
+        if (free == nullptr) {
+            partials.emplace_back();
+            free = &partials.back();
+            free->detections.resize(config.topK);
+        }
+        partial = free;
+        partial->frameId = slot.frameId;
+        partial->tilesLeft = config.tiles->size();
+        partial->count = 0;
+    }
+    for (size_t i = 0; i < slot.count; ++i) {
+        keepBest(partial->detections.data(), partial->count, config.topK, slot.detections[i]);
+    }
+    if (--partial->tilesLeft == 0) {
+        std::sort_heap(partial->detections.data(), partial->detections.data() + partial->count, worse);
+    }
+    return *partial;
+}
+
+void ResultSink::encode(uint64_t frameId, const Detection *detections, size_t count) {
+    record.clear();
+    if (config.format == ResultSinkConfig::Format::Binary) {
+        appendRaw(record, static_cast<uint64_t>(frameId));
+        appendRaw(record, static_cast<uint32_t>(count));
+        for (size_t i = 0; i < count; ++i) {
+            const Detection &d = detections[i];
+            appendRaw(record, d.x);
+            appendRaw(record, d.y);
+            appendRaw(record, d.cls);
+            appendRaw(record, d.score);
+        }
+        return;
+    }
+
+    record += "{\"frame\":";
+    appendNumber(record, frameId);
+    record += ",\"detections\":[";
+    for (size_t i = 0; i < count; ++i) {
+        const Detection &d = detections[i];
+        record += i == 0 ? "{\"x\":" : ",{\"x\":";
+        appendNumber(record, d.x);
+        record += ",\"y\":";
+        appendNumber(record, d.y);
+        record += ",\"class\":";
+        appendNumber(record, d.cls);
+        record += ",\"score\":";
+        appendNumber(record, d.score);
+        record += '}';
+    }
+    record += "]}\n";
+}
+
+void ResultSink::writeLoop() {
+    while (true) {
+        std::unique_lock<std::mutex> lock(mutex);
+        slotReady.wait(lock, [this] { return (head != tail && slots[head % slots.size()].ready) || (stopping && head == tail); });
+        if (head == tail) {
+            return; // Stopping and every queued frame has been written
+        }
+        Slot &slot = slots[head % slots.size()];
+        bool failed = writeError != nullptr;
+        lock.unlock();
+
+        // A tile is merged into its frame, which is written with the last of its tiles
+        uint64_t frameId = slot.frameId;
+        const Detection *detections = slot.detections.data();
+        size_t count = slot.count;
+        bool complete = true;
+        if (slot.tile) {
+            PartialFrame &partial = stitch(slot);
+            complete = partial.tilesLeft == 0;
+            detections = partial.detections.data();
+            count = partial.count;
+        }
+
+        // After a failed write the queue is still drained, so that no submit() waits forever
+        tbb::tick_count writeStart = tbb::tick_count::now();
+        bool written = false;
+        std::exception_ptr callbackError;
+        record.clear();
+        if (complete && !failed && config.callback) {
+            try {
+                config.callback(frameId, detections, count);
+                written = true;
+            } catch (...) {
+                callbackError = std::current_exception();
+            }
+        } else if (complete && !failed) {
+            encode(frameId, detections, count);
+            written = std::fwrite(record.data(), 1, record.size(), file) == record.size();
+        }
+        double writeTime = (tbb::tick_count::now() - writeStart).seconds() * 1000;
+
+        lock.lock();
+        if (!complete) {
+            // Nothing to write until the other tiles of the frame arrive
+        } else if (written) {
+            ++stats.framesWritten;
+            stats.detections += count;
+            stats.bytesWritten += record.size();
+            writeTimeTotal += writeTime;
+        } else if (callbackError) {
+            writeError = callbackError;
+        } else if (!failed) {
+            writeError = std::make_exception_ptr(std::runtime_error("Unable to write to the result sink " + config.path + " (" + std::strerror(errno) + ")"));
+        }
+        slot.ready = false;
+        ++head;
+        lock.unlock();
+        slotFree.notify_one();
+    }
+}
+
+void ResultSink::stop() {
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        stopping = true;
+    }
+    slotReady.notify_one();
+    if (writer.joinable()) {
+        writer.join();
+    }
+    if (file != nullptr) {
+        bool closed = std::fclose(file) == 0;
+        file = nullptr;
+        if (!closed && writeError == nullptr) {
+            writeError = std::make_exception_ptr(std::runtime_error("Unable to write to the result sink " + config.path + " (" + std::strerror(errno) + ")"));
+        }
+    }
+    if (writeError != nullptr) {
+        std::exception_ptr error = writeError;
+        writeError = nullptr;
+        std::rethrow_exception(error);
+    }
+}
+
+ResultSinkStats ResultSink::getStats() {
+    std::lock_guard<std::mutex> lock(mutex);
+    ResultSinkStats snapshot = stats;
+    snapshot.writeTimeAvg = stats.framesWritten > 0 ? writeTimeTotal / stats.framesWritten : 0.0;
+    return snapshot;
+}
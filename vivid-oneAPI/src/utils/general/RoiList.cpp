@@ -0,0 +1,111 @@
+#include "RoiList.hpp"
+#include <algorithm>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <stdexcept>
+#include <tuple>
+
+namespace {
+int floorDiv(int a, int b) {
+    return a / b - (a % b != 0 && (a < 0) != (b < 0));
+}
+
+int ceilDiv(int a, int b) {
+    return -floorDiv(-a, b);
+}
+
+/**
+ * @brief Cells [first, end) of an axis whose window overlaps [start, start + length).
+ */
+std::pair<int, int> activeCells(int start, int length, int cellSize, int apron, int window, int cells) {
+    int first = std::clamp(floorDiv(start - window - apron, cellSize) + 1, 0, cells - 1);
+    int end = std::clamp(ceilDiv(start + length - apron, cellSize), first + 1, cells);
+    return {first, end};
+}
+} // namespace
+
+RoiList::RoiList(const std::string &path, int frameHeight_, int frameWidth_, int cellSize_, int apron_, int windowHeight_, int windowWidth_)
+    : frameHeight{frameHeight_}, frameWidth{frameWidth_}, cellSize{cellSize_}, apron{apron_}, windowHeight{windowHeight_}, windowWidth{windowWidth_},
+      cellsX{(frameWidth_ - 2 * apron_) / cellSize_}, cellsY{(frameHeight_ - 2 * apron_) / cellSize_} {
+    if (cellsX <= 0 || cellsY <= 0) {
+        throw std::invalid_argument("RoiList: the frames are smaller than a cell");
+    }
+    std::ifstream file(path);
+    if (!file) {
+        throw std::runtime_error("Unable to open the list of regions of interest " + path);
+    }
+
+    std::string line;
+    for (size_t lineNumber = 1; std::getline(file, line); ++lineNumber) {
+        line = line.substr(0, line.find('#'));
+        std::istringstream fields(line);
+        long long frame;
+        Rect roi;
+        if (!(fields >> frame)) {
+            continue; // Empty line or comment
+        }
+        std::string rest;
+        if (!(fields >> roi.x >> roi.y >> roi.width >> roi.height) || (fields >> rest) || frame < 1) {
+            throw std::invalid_argument(path + ":" + std::to_string(lineNumber) + ": expected 'frame x y width height' with frames numbered from 1");
+        }
+        // Clip the region to the frame
+        int x1 = std::min(roi.x + roi.width, frameWidth);
+        int y1 = std::min(roi.y + roi.height, frameHeight);
+        roi.x = std::max(roi.x, 0);
+        roi.y = std::max(roi.y, 0);
+        roi.width = x1 - roi.x;
+        roi.height = y1 - roi.y;
+        if (roi.width <= 0 || roi.height <= 0) {
+            throw std::invalid_argument(path + ":" + std::to_string(lineNumber) + ": the region is empty or lies outside the " + std::to_string(frameWidth) + "x" +
+                                        std::to_string(frameHeight) + " frame");
+        }
+
+        if (static_cast<size_t>(frame) > regions.size()) {
+            regions.resize(frame);
+        }
+        if (regions[frame - 1].rois.empty()) {
+            listedFrames++;
+        }
+        regions[frame - 1].rois.push_back(roi);
+        listedRois++;
+    }
+
+    for (ActiveRegion &region : regions) {
+        if (!region.rois.empty()) {
+            activate(region);
+        }
+    }
+    std::cout << " ROIs: " << listedRois << " regions in " << listedFrames << " frames (" << static_cast<int>(meanFraction() * 100.0 + 0.5)
+              << "% of the frame processed on average)" << std::endl;
+}
+
+void RoiList::activate(ActiveRegion &region) const {
+    // Bounding box of the window positions that overlap any of the regions
+    int x0 = cellsX, x1 = 0, y0 = cellsY, y1 = 0;
+    for (const Rect &roi : region.rois) {
+        auto [first, end] = activeCells(roi.x, roi.width, cellSize, apron, windowWidth, cellsX);
+        x0 = std::min(x0, first);
+        x1 = std::max(x1, end);
+        std::tie(first, end) = activeCells(roi.y, roi.height, cellSize, apron, windowHeight, cellsY);
+        y0 = std::min(y0, first);
+        y1 = std::max(y1, end);
+    }
+    region.cells = {x0, y0, x1 - x0, y1 - y0};
+    region.pixels = {apron + x0 * cellSize, apron + y0 * cellSize, (x1 - x0) * cellSize, (y1 - y0) * cellSize};
+    region.cellsPerRow = cellsX;
+    region.firstCell = static_cast<size_t>(y0) * cellsX + x0;
+    region.endCell = static_cast<size_t>(y1 - 1) * cellsX + x1;
+    region.fraction = static_cast<double>(x1 - x0) * (y1 - y0) / (static_cast<double>(cellsX) * cellsY);
+}
+
+double RoiList::meanFraction() const {
+    if (regions.empty()) {
+        return 1.0;
+    }
+    double total = 0.0;
+    for (const ActiveRegion &region : regions) {
+        total += region.rois.empty() ? 1.0 : region.fraction;
+    }
+    return total / regions.size();
+}
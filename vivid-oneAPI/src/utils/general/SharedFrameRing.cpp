@@ -0,0 +1,233 @@
+#include "SharedFrameRing.hpp"
+#include <algorithm>
+#include <cerrno>
+#include <climits>
+#include <cstring>
+#include <ctime>
+#include <fcntl.h>
+#include <linux/futex.h>
+#include <stdexcept>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+namespace SharedFrameRing {
+namespace {
+std::string segmentPath(const std::string &name) {
+    if (name.empty()) {
+        throw std::invalid_argument("The name of the shared memory ring is empty");
+    }
+    return name[0] == '/' ? name : "/" + name;
+}
+
+// Process-shared futex (no FUTEX_PRIVATE_FLAG): the producer and the consumer are different processes
+uint32_t *futexWord(std::atomic<uint32_t> &word) {
+    return reinterpret_cast<uint32_t *>(&word);
+}
+
+void futexWait(std::atomic<uint32_t> &word, uint32_t expected, int timeoutMs) {
+    timespec timeout{timeoutMs / 1000, static_cast<long>(timeoutMs % 1000) * 1000000L};
+    syscall(SYS_futex, futexWord(word), FUTEX_WAIT, expected, &timeout, nullptr, 0); // EAGAIN, EINTR and ETIMEDOUT are handled by the caller
+}
+
+void futexWake(std::atomic<uint32_t> &word) {
+    syscall(SYS_futex, futexWord(word), FUTEX_WAKE, INT_MAX, nullptr, nullptr, 0);
+}
+
+size_t roundUp(size_t n, size_t alignment) {
+    return (n + alignment - 1) / alignment * alignment;
+}
+} // namespace
+
+// ____________________________________________________________________________________________________________________
+// Segment
+// ____________________________________________________________________________________________________________________
+Segment::~Segment() {
+    if (base != nullptr) {
+        munmap(base, size);
+    }
+}
+
+void Segment::map(int fd, size_t bytes) {
+    void *ptr = mmap(nullptr, bytes, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    if (ptr == MAP_FAILED) {
+        throw std::runtime_error("Failed to map the shared memory ring " + segmentName + " (" + std::strerror(errno) + ")");
+    }
+    base = ptr;
+    size = bytes;
+    header = static_cast<Header *>(base);
+}
+
+unsigned char *Segment::slotData(uint32_t slot) const {
+    return static_cast<unsigned char *>(base) + header->dataOffset + static_cast<size_t>(slot) * header->slotBytes;
+}
+
+// ____________________________________________________________________________________________________________________
+// Producer
+// ____________________________________________________________________________________________________________________
+Producer::Producer(const std::string &name, uint32_t width, uint32_t height, PixelType type, uint32_t slots) {
+    segmentName = segmentPath(name);
+    if (width == 0 || height == 0) {
+        throw std::invalid_argument("The frames of the shared memory ring cannot be empty");
+    }
+    if (slots == 0 || (slots & (slots - 1)) != 0) {
+        throw std::invalid_argument("The number of slots of the shared memory ring must be a power of two");
+    }
+    size_t frameBytes = static_cast<size_t>(width) * height * FrameContainer::pixelSize(type);
+    size_t slotBytes = roundUp(frameBytes, PAGE_SIZE);
+    size_t bytes = PAGE_SIZE + slotBytes * slots;
+
+    shm_unlink(segmentName.c_str()); // A producer that crashed may have left the segment behind
+    int fd = shm_open(segmentName.c_str(), O_CREAT | O_EXCL | O_RDWR, 0600);
+    if (fd < 0) {
+        throw std::runtime_error("Failed to create the shared memory ring " + segmentName + " (" + std::strerror(errno) + ")");
+    }
+    if (ftruncate(fd, static_cast<off_t>(bytes)) != 0) {
+        int error = errno;
+        ::close(fd);
+        shm_unlink(segmentName.c_str());
+        throw std::runtime_error("Failed to size the shared memory ring " + segmentName + " (" + std::strerror(error) + ")");
+    }
+    try {
+        map(fd, bytes);
+    } catch (...) {
+        ::close(fd);
+        shm_unlink(segmentName.c_str());
+        throw;
+    }
+    ::close(fd); // The mapping keeps the segment alive
+
+    // The segment is zero filled: the counters start at 0 and ready stays 0 until the header is complete
+    header->version = VERSION;
+    header->pixelType = static_cast<uint32_t>(type);
+    header->width = width;
+    header->height = height;
+    header->slots = slots;
+    header->frameBytes = frameBytes;
+    header->slotBytes = slotBytes;
+    header->dataOffset = PAGE_SIZE;
+    std::memcpy(header->magic, MAGIC, sizeof(MAGIC));
+    header->producerOpen.store(1, std::memory_order_relaxed);
+    header->ready.store(1, std::memory_order_release);
+}
+
+Producer::~Producer() {
+    if (header != nullptr) {
+        header->producerOpen.store(0, std::memory_order_release);
+        futexWake(header->writeIndex);
+        shm_unlink(segmentName.c_str()); // An attached consumer keeps its mapping
+    }
+}
+
+WaitResult Producer::waitSlot(int timeoutMs) {
+    uint32_t write = header->writeIndex.load(std::memory_order_relaxed); // Only the producer writes it
+    timespec start;
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    while (true) {
+        uint32_t read = header->readIndex.load(std::memory_order_acquire);
+        if (write - read < header->slots) {
+            return WaitResult::Ready;
+        }
+        if (header->consumerOpen.load(std::memory_order_acquire) == 0 && header->attachments.load(std::memory_order_acquire) > 0) {
+            return WaitResult::Closed; // The ring is full and its consumer has gone away
+        }
+        timespec now;
+        clock_gettime(CLOCK_MONOTONIC, &now);
+        long elapsed = (now.tv_sec - start.tv_sec) * 1000L + (now.tv_nsec - start.tv_nsec) / 1000000L;
+        if (elapsed >= timeoutMs) {
+            return WaitResult::Timeout;
+        }
+        futexWait(header->readIndex, read, std::min<long>(timeoutMs - elapsed, POLL_MS));
+    }
+}
+
+unsigned char *Producer::nextFrame() const {
+    return slotData(header->writeIndex.load(std::memory_order_relaxed) & (header->slots - 1));
+}
+
+void Producer::publish() {
+    header->writeIndex.fetch_add(1, std::memory_order_release);
+    futexWake(header->writeIndex);
+}
+
+bool Producer::consumerAttached() const {
+    return header->consumerOpen.load(std::memory_order_acquire) != 0;
+}
+
+uint32_t Producer::published() const {
+    return header->writeIndex.load(std::memory_order_relaxed);
+}
+
+// ____________________________________________________________________________________________________________________
+// Consumer
+// ____________________________________________________________________________________________________________________
+Consumer::Consumer(const std::string &name) {
+    segmentName = segmentPath(name);
+    int fd = shm_open(segmentName.c_str(), O_RDWR, 0);
+    if (fd < 0) {
+        throw std::invalid_argument("Shared memory ring " + segmentName + " not found (" + std::strerror(errno) + "); start the producer first");
+    }
+    struct stat st;
+    if (fstat(fd, &st) != 0 || static_cast<size_t>(st.st_size) < PAGE_SIZE) {
+        ::close(fd);
+        throw std::invalid_argument("Shared memory ring " + segmentName + " is not initialised");
+    }
+    try {
+        map(fd, static_cast<size_t>(st.st_size));
+    } catch (...) {
+        ::close(fd);
+        throw;
+    }
+    ::close(fd);
+
+    if (header->ready.load(std::memory_order_acquire) != 1 || std::memcmp(header->magic, MAGIC, sizeof(MAGIC)) != 0) {
+        throw std::invalid_argument("Shared memory " + segmentName + " is not a frame ring (or its producer has not finished creating it)");
+    }
+    if (header->version != VERSION) {
+        throw std::invalid_argument("Shared memory ring " + segmentName + " has version " + std::to_string(header->version) + ", only version " +
+                                    std::to_string(VERSION) + " is supported");
+    }
+    if (header->pixelType > static_cast<uint32_t>(PixelType::UInt16) || header->slots == 0 || (header->slots & (header->slots - 1)) != 0 ||
+        header->frameBytes != static_cast<uint64_t>(header->width) * header->height * FrameContainer::pixelSize(pixelType()) ||
+        header->slotBytes < header->frameBytes || header->dataOffset + header->slotBytes * header->slots > size) {
+        throw std::invalid_argument("Shared memory ring " + segmentName + " has an inconsistent header");
+    }
+    header->attachments.fetch_add(1, std::memory_order_relaxed);
+    header->consumerOpen.store(1, std::memory_order_release);
+}
+
+Consumer::~Consumer() {
+    if (header != nullptr) {
+        header->consumerOpen.store(0, std::memory_order_release);
+        futexWake(header->readIndex);
+    }
+}
+
+WaitResult Consumer::waitFrame(uint32_t index, int timeoutMs) {
+    uint32_t write = header->writeIndex.load(std::memory_order_acquire);
+    if (write != index) {
+        return WaitResult::Ready;
+    }
+    if (header->producerOpen.load(std::memory_order_acquire) == 0) {
+        // Check again: the producer may have published the frame just before leaving
+        return header->writeIndex.load(std::memory_order_acquire) != index ? WaitResult::Ready : WaitResult::Closed;
+    }
+    futexWait(header->writeIndex, write, std::min(timeoutMs, POLL_MS));
+    return header->writeIndex.load(std::memory_order_acquire) != index ? WaitResult::Ready : WaitResult::Timeout;
+}
+
+bool Consumer::available(uint32_t index) const {
+    return header->writeIndex.load(std::memory_order_acquire) != index;
+}
+
+void Consumer::releaseUntil(uint32_t index) {
+    header->readIndex.store(index, std::memory_order_release);
+    futexWake(header->readIndex);
+}
+
+uint32_t Consumer::firstFrame() const {
+    return header->readIndex.load(std::memory_order_acquire);
+}
+
+} // namespace SharedFrameRing
@@ -0,0 +1,259 @@
+#include "TemporalCache.hpp"
+#include "GlobalParameters.hpp"
+#include "filters-CPP.hpp"
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <iostream>
+#include <stdexcept>
+#include <tbb/tick_count.h>
+#include <type_traits>
+
+namespace {
+constexpr float TOLERANCE = 10E-2f; //< Same tolerance as Comparer::compare
+} // namespace
+
+TemporalCache::TemporalCache(const TemporalReuseConfig &config_, int height_, int width_, int cellSize_, int apron_, int numFilters_, float *filterBank_, FloatBuffer *cla_)
+    : config{config_}, height{height_}, width{width_}, cellSize{cellSize_}, apron{apron_}, numFilters{numFilters_}, filterBank{filterBank_}, cla{cla_},
+      cellsX{(width_ - 2 * apron_) / cellSize_}, cellsY{(height_ - 2 * apron_) / cellSize_} {
+    if (config.threshold < 0.0) {
+        throw std::invalid_argument("TemporalCache: the threshold cannot be negative");
+    }
+    if (cellsX <= 0 || cellsY <= 0) {
+        throw std::invalid_argument("TemporalCache: the frames are smaller than a cell");
+    }
+    if (config.refresh <= 0) {
+        config.refresh = DEFAULT_REUSE_REFRESH;
+    }
+    tilesX = (cellsX + TILE_CELLS - 1) / TILE_CELLS;
+    tilesY = (cellsY + TILE_CELLS - 1) / TILE_CELLS;
+    tileDiff.resize(static_cast<size_t>(tilesX) * tilesY);
+}
+
+void TemporalCache::admit(ViVidItem *item) {
+    std::shared_ptr<const TemporalReference> reference;
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        bool due = current == nullptr || item->item_id >= current->itemId + static_cast<size_t>(config.refresh);
+        if (due && !keyframePending) {
+            keyframePending = true;
+            item->keyframe = true;
+            return;
+        }
+        reference = current;
+    }
+    if (reference == nullptr) {
+        return; // The first keyframe is still in flight: the frame is processed whole
+    }
+
+    double time;
+    {
+        // Several input nodes may admit at the same time (syclevents): tileDiff is shared scratch
+        std::lock_guard<std::mutex> lock(diffMutex);
+        tbb::tick_count start = tbb::tick_count::now();
+        findDirtyRegion(item, *reference);
+        time = (tbb::tick_count::now() - start).seconds() * 1000;
+    }
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        diffTime += time;
+        ++diffs;
+    }
+    item->reference = std::move(reference);
+    item->region = &item->dirtyRegion;
+}
+
+void TemporalCache::findDirtyRegion(ViVidItem *item, const TemporalReference &reference) {
+    // Mean absolute difference of each tile over the pixels its cells depend on (cells plus the halo of the filter)
+    item->frame->visitPixels(BUF_READ, [&](auto *pixels) {
+        using Pixel = std::remove_const_t<std::remove_pointer_t<decltype(pixels)>>;
+        const Pixel *previous = reinterpret_cast<const Pixel *>(reference.pixels.data());
+        size_t pitch = item->frame->pixelPitch();
+        for (int ty = 0; ty < tilesY; ++ty) {
+            int y0 = ty * TILE_CELLS * cellSize;
+            int y1 = std::min(apron + std::min((ty + 1) * TILE_CELLS, cellsY) * cellSize + apron, height);
+            for (int tx = 0; tx < tilesX; ++tx) {
+                int x0 = tx * TILE_CELLS * cellSize;
+                int x1 = std::min(apron + std::min((tx + 1) * TILE_CELLS, cellsX) * cellSize + apron, width);
+                double sum = 0.0;
+                for (int y = y0; y < y1; ++y) {
+                    const Pixel *row = pixels + y * pitch;
+                    const Pixel *previousRow = previous + static_cast<size_t>(y) * width;
+                    float rowSum = 0.0f;
+                    for (int x = x0; x < x1; ++x) {
+                        rowSum += std::fabs(static_cast<float>(row[x]) - static_cast<float>(previousRow[x]));
+                    }
+                    sum += rowSum;
+                }
+                tileDiff[static_cast<size_t>(ty) * tilesX + tx] = sum / (static_cast<double>(y1 - y0) * (x1 - x0));
+            }
+        }
+    });
+
+    // Bounding box of the dirty tiles
+    int x0 = cellsX, x1 = 0, y0 = cellsY, y1 = 0;
+    size_t dirty = 0;
+    size_t worst = 0;
+    auto extend = [&](size_t tile) {
+        int tx = static_cast<int>(tile % tilesX);
+        int ty = static_cast<int>(tile / tilesX);
+        x0 = std::min(x0, tx * TILE_CELLS);
+        x1 = std::max(x1, std::min((tx + 1) * TILE_CELLS, cellsX));
+        y0 = std::min(y0, ty * TILE_CELLS);
+        y1 = std::max(y1, std::min((ty + 1) * TILE_CELLS, cellsY));
+    };
+    for (size_t tile = 0; tile < tileDiff.size(); ++tile) {
+        if (tileDiff[tile] > config.threshold) {
+            extend(tile);
+            ++dirty;
+        }
+        if (tileDiff[tile] > tileDiff[worst]) {
+            worst = tile;
+        }
+    }
+    if (dirty == 0) {
+        // Nothing changed: the stages need a region, so the tile closest to changing is recomputed
+        extend(worst);
+        dirty = 1;
+    }
+    dirtyTiles.fetch_add(dirty, std::memory_order_relaxed);
+    tiles.fetch_add(tileDiff.size(), std::memory_order_relaxed);
+
+    ActiveRegion &region = item->dirtyRegion;
+    region.cells = {x0, y0, x1 - x0, y1 - y0};
+    region.pixels = {apron + x0 * cellSize, apron + y0 * cellSize, (x1 - x0) * cellSize, (y1 - y0) * cellSize};
+    region.cellsPerRow = cellsX;
+    region.firstCell = static_cast<size_t>(y0) * cellsX + x0;
+    region.endCell = static_cast<size_t>(y1 - 1) * cellsX + x1;
+    region.fraction = static_cast<double>(x1 - x0) * (y1 - y0) / (static_cast<double>(cellsX) * cellsY);
+}
+
+void TemporalCache::complete(ViVidItem *item) {
+    frames.fetch_add(1, std::memory_order_relaxed);
+    totalCells.fetch_add(static_cast<uint64_t>(cellsX) * cellsY, std::memory_order_relaxed);
+    if (item->keyframe) {
+        publish(item);
+        keyframes.fetch_add(1, std::memory_order_relaxed);
+    } else if (item->reference != nullptr) {
+        merge(item, *item->reference);
+        const Rect &cells = item->dirtyRegion.cells;
+        reusedCells.fetch_add(static_cast<uint64_t>(cellsX) * cellsY - static_cast<uint64_t>(cells.width) * cells.height, std::memory_order_relaxed);
+        reusedFrames.fetch_add(1, std::memory_order_relaxed);
+        if (config.verify) {
+            verify(item);
+        }
+        // The output is complete: the result sink reports the whole frame
+        item->region = nullptr;
+    }
+    item->keyframe = false;
+    item->reference.reset();
+}
+
+void TemporalCache::publish(ViVidItem *item) {
+    // Rewrite a reference no item holds any more (only the cache owns it), so the steady state does not allocate
+    std::shared_ptr<TemporalReference> reference;
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        for (const std::shared_ptr<TemporalReference> &spare : spares) {
+            if (spare.use_count() == 1) {
+                reference = spare;
+                break;
+            }
+        }
+        if (reference == nullptr) {
+            reference = std::make_shared<TemporalReference>();
+            spares.push_back(reference);
+        }
+    }
+
+    reference->itemId = item->item_id;
+    FrameBuffer *frame = item->frame;
+    size_t rowBytes = frame->pixelWidth * FrameContainer::pixelSize(frame->pixelType);
+    reference->pixels.resize(rowBytes * frame->height);
+    const unsigned char *pixels = frame->get_HOST_PTR(BUF_READ);
+    for (size_t y = 0; y < frame->height; ++y) {
+        std::memcpy(reference->pixels.data() + y * rowBytes, pixels + y * frame->pitch, rowBytes);
+    }
+    const float *out = item->out->get_HOST_PTR(BUF_READ);
+    reference->out.assign(out, out + item->out->size / sizeof(float));
+
+    std::lock_guard<std::mutex> lock(mutex);
+    current = std::move(reference);
+    keyframePending = false;
+}
+
+void TemporalCache::merge(ViVidItem *item, const TemporalReference &reference) const {
+    float *out = item->out->get_HOST_PTR(BUF_READWRITE);
+    size_t pitch = item->out->pitch / sizeof(float);
+    size_t cells = item->out->width;
+    const Rect &box = item->dirtyRegion.cells;
+    size_t x0 = box.x, x1 = box.x + box.width, y0 = box.y, y1 = box.y + box.height;
+
+    // Copy the cells outside the box: before its first row, between its rows and after its last row
+    auto copy = [&](size_t first, size_t end) {
+        for (size_t c = 0; c < item->out->height; ++c) {
+            std::memcpy(out + c * pitch + first, reference.out.data() + c * pitch + first, (end - first) * sizeof(float));
+        }
+    };
+    copy(0, y0 * cellsX + x0);
+    for (size_t cy = y0; cy + 1 < y1; ++cy) {
+        copy(cy * cellsX + x1, (cy + 1) * cellsX + x0);
+    }
+    copy((y1 - 1) * cellsX + x1, cells);
+}
+
+void TemporalCache::verify(ViVidItem *item) {
+    std::lock_guard<std::mutex> lock(verifyMutex);
+    size_t claPitch = cla->pitch / sizeof(float);
+    size_t outPitch = item->out->pitch / sizeof(float);
+    scratchInd.assign(static_cast<size_t>(height) * width, 0.0f);
+    scratchVal.assign(static_cast<size_t>(height) * width, 0.0f);
+    scratchHis.assign(item->his->height * claPitch, 0.0f);
+    scratchOut.assign(item->out->height * outPitch, 0.0f);
+
+    // Whole frame on the host, as the reference output of Comparer
+    int filterDim = 2 * apron + 1;
+    Rect pixels{apron, apron, width - 2 * apron, height - 2 * apron};
+    Rect cells{0, 0, cellsX, cellsY};
+    item->frame->visitPixels(BUF_READ, [&](auto *frame) {
+        cosine_filter_transpose(frame, scratchInd.data(), scratchVal.data(), filterBank, height, width, filterDim, filterDim, numFilters, width * sizeof(float), pixels);
+    });
+    block_histogram(scratchHis.data(), scratchInd.data(), scratchVal.data(), numFilters, cellSize, height, width, claPitch, width, cells);
+    pwdist_c(cla->get_HOST_PTR(BUF_READ), scratchHis.data(), scratchOut.data(), outPitch, cla->height, claPitch, item->his->height, cla->width);
+
+    const float *out = item->out->get_HOST_PTR(BUF_READ);
+    double error = 0.0;
+    for (size_t c = 0; c < item->out->height; ++c) {
+        for (size_t j = 0; j < static_cast<size_t>(cellsX) * cellsY; ++j) {
+            error = std::max(error, static_cast<double>(std::fabs(out[c * outPitch + j] - scratchOut[c * outPitch + j])));
+        }
+    }
+    maxError = std::max(maxError, error);
+    verifiedFrames.fetch_add(1, std::memory_order_relaxed);
+    if (error >= TOLERANCE) {
+        mismatchedFrames.fetch_add(1, std::memory_order_relaxed);
+        std::cout << "ERROR: The reused output of item " << item->item_id << " differs from its full recomputation by " << error << std::endl;
+    }
+}
+
+TemporalReuseStats TemporalCache::getStats() const {
+    TemporalReuseStats stats;
+    stats.threshold = config.threshold;
+    stats.refresh = config.refresh;
+    stats.frames = frames.load();
+    stats.keyframes = keyframes.load();
+    stats.reusedFrames = reusedFrames.load();
+    stats.dirtyTiles = dirtyTiles.load();
+    stats.tiles = tiles.load();
+    uint64_t total = totalCells.load();
+    stats.reuseRatio = total > 0 ? static_cast<double>(reusedCells.load()) / total : 0.0;
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        stats.diffTimeAvg = diffs > 0 ? diffTime / diffs : 0.0;
+    }
+    stats.verifiedFrames = verifiedFrames.load();
+    stats.mismatchedFrames = mismatchedFrames.load();
+    std::lock_guard<std::mutex> lock(verifyMutex);
+    stats.maxError = maxError;
+    return stats;
+}
@@ -0,0 +1,55 @@
+#include "TileGrid.hpp"
+#include <algorithm>
+#include <stdexcept>
+#include <string>
+
+TileGrid::TileGrid(int frameHeight_, int frameWidth_, int tileHeight, int tileWidth, int cellSize, int apron, int windowHeight, int windowWidth)
+    : height{std::min(tileHeight, frameHeight_)}, width{std::min(tileWidth, frameWidth_)}, frameHeight{frameHeight_}, frameWidth{frameWidth_} {
+    if (tileHeight <= 0 || tileWidth <= 0) {
+        throw std::invalid_argument("TileGrid: the tiles must not be empty");
+    }
+    std::vector<Span> columns = split(frameWidth, width, cellSize, apron, windowWidth, "width");
+    std::vector<Span> rowSpans = split(frameHeight, height, cellSize, apron, windowHeight, "height");
+    tilesX = columns.size();
+    tilesY = rowSpans.size();
+
+    // Row-major order, so consecutive tiles are close in the file
+    tiles.reserve(tilesX * tilesY);
+    for (const Span &row : rowSpans) {
+        for (const Span &column : columns) {
+            tiles.push_back({column.origin, row.origin, column.length, row.length, column.cell0, column.cell1, row.cell0, row.cell1});
+        }
+    }
+}
+
+std::vector<TileGrid::Span> TileGrid::split(int frameLength, int tileLength, int cellSize, int apron, int windowLength, const char *axis) {
+    int frameCells = (frameLength - 2 * apron) / cellSize; // Cells of the frame (same count as block_histogram)
+    if (tileLength == frameLength) {
+        return {{0, frameLength, 0, frameCells}};
+    }
+    int tileCells = (tileLength - 2 * apron) / cellSize;
+    int windowCells = windowLength / cellSize;
+    // A tile owns the window positions whose window lies entirely inside it
+    int step = tileCells - windowCells + 1;
+    if (step < 1) {
+        throw std::invalid_argument("The " + std::string(axis) + " of the tiles (" + std::to_string(tileLength) + ") must be at least the window plus the apron of the filter (" +
+                                    std::to_string(windowLength + 2 * apron) + ")");
+    }
+
+    std::vector<Span> spans;
+    for (int first = 0; first < frameCells; first += step) {
+        int origin = first * cellSize;
+        bool last = first + tileCells >= frameCells;
+        spans.push_back({origin, std::min(tileLength, frameLength - origin), 0, last ? frameCells - first : step});
+        if (last) {
+            break;
+        }
+    }
+    return spans;
+}
+
+double TileGrid::overhead() const {
+    double processed = static_cast<double>(tiles.size()) * height * width;
+    double frame = static_cast<double>(frameHeight) * frameWidth;
+    return processed > 0.0 ? 1.0 - frame / processed : 0.0;
+}
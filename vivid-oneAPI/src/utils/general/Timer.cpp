@@ -1,4 +1,5 @@
 #include "Timer.hpp"
+#include "AllocCounter.hpp"
 
 void startTimerIfNeeded(ApplicationData &appData, InputArgs &inputArgs) {
     if (inputArgs.hasDuration()) {
@@ -8,6 +9,10 @@ void startTimerIfNeeded(ApplicationData &appData, InputArgs &inputArgs) {
             }
             std::this_thread::sleep_for(inputArgs.duration);
             inputArgs.numFrames = appData.id;
+            // The frames started from now on only drain the pipeline: the steady state ends at the deadline
+            if constexpr (ALLOCCOUNT_ENABLED) {
+                AllocCounter::stopSteadyState(appData.id);
+            }
             inputArgs.duration = std::chrono::seconds(0);
             if constexpr (VERBOSE_ENABLED) {
                 std::cout << " Timer finished" << std::endl;
@@ -141,8 +141,10 @@ void Tracer::frame_end(ViVidItem *item) {
         item->traceItem << "8 " << (now - start).seconds() << " F" << m_id << " T " << std::endl; // destroy frame
         item->traceItem << "15 " << (now - start).seconds() << " T1 TK 1.0" << std::endl;         // add n tokens -1
 
-        tracefile << item->traceItem.rdbuf();
-        item->traceItem.str("");
+        if (item->traceItem.overflowed()) {
+            std::cerr << "Warning: trace events of frame " << m_id << " exceeded the trace buffer and were truncated" << std::endl;
+        }
+        item->traceItem.writeTo(tracefile);
         item->traceItem.clear();
     }
 }
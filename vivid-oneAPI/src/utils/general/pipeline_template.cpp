@@ -14,16 +14,22 @@ namespace Pipeline_template {
  * @param global_cla A pointer to the classification buffer.
  * @param num_filters The number of filters in the processing pipeline.
  * @param Q A SYCL queue object used for memory management.
+ * @param usage Accounting of the USM of the buffers.
  */
-ViVidItem::ViVidItem(FloatBuffer *global_frame, FloatBuffer *global_cla, int num_filters, sycl::queue &Q) : frame{global_frame}, cla{global_cla}, ViVidItemQueue{Q} {
-    ind = new FloatBuffer{global_frame->height, global_frame->width, BUF_READWRITE, ViVidItemQueue}; // create new buffers
-    val = new FloatBuffer{global_frame->height, global_frame->width, BUF_READWRITE, ViVidItemQueue};
-    his = new FloatBuffer{(global_frame->width / 8) * (global_frame->height / 8), static_cast<size_t>(num_filters), BUF_READWRITE, ViVidItemQueue};
-    out = new FloatBuffer{global_cla->height, (global_frame->width / 8) * (global_frame->height / 8), BUF_READWRITE, ViVidItemQueue};
+ViVidItem::ViVidItem(FrameBuffer *global_frame, FloatBuffer *global_cla, int num_filters, sycl::queue &Q, USMUsage &usage)
+    : frame{global_frame}, cla{global_cla}, ViVidItemQueue{Q}, ViVidItemUsage{usage} {
+    ind = new FloatBuffer{global_frame->height, global_frame->pixelWidth, BUF_READWRITE, ViVidItemQueue, ViVidItemUsage}; // create new buffers
+    val = new FloatBuffer{global_frame->height, global_frame->pixelWidth, BUF_READWRITE, ViVidItemQueue, ViVidItemUsage};
+    his = new FloatBuffer{(global_frame->pixelWidth / 8) * (global_frame->height / 8), static_cast<size_t>(num_filters), BUF_READWRITE, ViVidItemQueue, ViVidItemUsage};
+    out = new FloatBuffer{global_cla->height, (global_frame->pixelWidth / 8) * (global_frame->height / 8), BUF_READWRITE, ViVidItemQueue, ViVidItemUsage};
 
     for (auto &element : ptrSizeStage) {
         element = nullptr;
     }
+
+    // Preallocate the per-stage vectors so that they never grow in the steady state
+    stage_events.reserve(2 * MAX_STAGES);
+    stage_acc.reserve(2 * MAX_STAGES);
 }
 
 /**
@@ -33,16 +39,22 @@ ViVidItem::ViVidItem(FloatBuffer *global_frame, FloatBuffer *global_cla, int num
  * @param global_cla A pointer to the global classification buffer.
  * @param num_filters The number of filters in the processing pipeline.
  * @param Q A SYCL queue object used for memory management.
+ * @param usage Accounting of the USM of the buffers.
  */
-ViVidItem::ViVidItem(size_t id, FloatBuffer *global_frame, FloatBuffer *global_cla, int num_filters, sycl::queue &Q) : item_id{id}, frame{global_frame}, cla{global_cla}, ViVidItemQueue{Q} {
-    ind = new FloatBuffer{global_frame->height, global_frame->width, BUF_READWRITE, ViVidItemQueue}; // create new buffers
-    val = new FloatBuffer{global_frame->height, global_frame->width, BUF_READWRITE, ViVidItemQueue};
-    his = new FloatBuffer{(global_frame->width / 8) * (global_frame->height / 8), static_cast<size_t>(num_filters), BUF_READWRITE, ViVidItemQueue};
-    out = new FloatBuffer{global_cla->height, (global_frame->width / 8) * (global_frame->height / 8), BUF_READWRITE, ViVidItemQueue};
+ViVidItem::ViVidItem(size_t id, FrameBuffer *global_frame, FloatBuffer *global_cla, int num_filters, sycl::queue &Q, USMUsage &usage)
+    : item_id{id}, frame{global_frame}, cla{global_cla}, ViVidItemQueue{Q}, ViVidItemUsage{usage} {
+    ind = new FloatBuffer{global_frame->height, global_frame->pixelWidth, BUF_READWRITE, ViVidItemQueue, ViVidItemUsage}; // create new buffers
+    val = new FloatBuffer{global_frame->height, global_frame->pixelWidth, BUF_READWRITE, ViVidItemQueue, ViVidItemUsage};
+    his = new FloatBuffer{(global_frame->pixelWidth / 8) * (global_frame->height / 8), static_cast<size_t>(num_filters), BUF_READWRITE, ViVidItemQueue, ViVidItemUsage};
+    out = new FloatBuffer{global_cla->height, (global_frame->pixelWidth / 8) * (global_frame->height / 8), BUF_READWRITE, ViVidItemQueue, ViVidItemUsage};
 
     for (auto &element : ptrSizeStage) {
         element = nullptr;
     }
+
+    // Preallocate the per-stage vectors so that they never grow in the steady state
+    stage_events.reserve(2 * MAX_STAGES);
+    stage_acc.reserve(2 * MAX_STAGES);
 }
 
 /**
@@ -53,6 +65,16 @@ ViVidItem::~ViVidItem() {
     delete val;
     delete his;
     delete out;
+    for (auto buffer : outStage) {
+        delete buffer;
+    }
+}
+
+void ViVidItem::setStageBuffers(int stage_, FloatBuffer *classes, bool ownOutput) {
+    claStage[stage_] = classes;
+    if (ownOutput && outStage[stage_] == nullptr) {
+        outStage[stage_] = new FloatBuffer{out->height, out->width, BUF_READWRITE, ViVidItemQueue, ViVidItemUsage};
+    }
 }
 
 /**
@@ -68,16 +90,45 @@ void ViVidItem::recycle() {
                 std::cerr << "Warning: Attempting to clear an invalid buffer. Data: " << buffer->data << ", Size: " << buffer->size << std::endl;
         }*/
     };
-    // Clear buffers
-    clear_buffer(ind);
-    clear_buffer(val);
-    clear_buffer(his);
-    clear_buffer(out);
+    // Clear buffers (with regions of interest only their active part has been written)
+    if (region != nullptr) {
+        auto clear_rows = [](FloatBuffer *buffer, size_t first, size_t rows) {
+            if (buffer && buffer->data) {
+                std::memset(buffer->data + first * (buffer->pitch / sizeof(float)), 0, rows * buffer->pitch);
+            }
+        };
+        clear_rows(ind, region->pixels.y, region->pixels.height);
+        clear_rows(val, region->pixels.y, region->pixels.height);
+        clear_rows(his, region->firstCell, region->endCell - region->firstCell);
+        auto clear_cells = [this](FloatBuffer *buffer) {
+            if (buffer && buffer->data) {
+                for (size_t c = 0; c < buffer->height; ++c) {
+                    std::memset(buffer->data + c * (buffer->pitch / sizeof(float)) + region->firstCell, 0, (region->endCell - region->firstCell) * sizeof(float));
+                }
+            }
+        };
+        clear_cells(out);
+        for (auto buffer : outStage) {
+            clear_cells(buffer);
+        }
+        region = nullptr;
+    } else {
+        clear_buffer(ind);
+        clear_buffer(val);
+        clear_buffer(his);
+        clear_buffer(out);
+        for (auto buffer : outStage) {
+            clear_buffer(buffer);
+        }
+    }
+    inputFrame = 0;
+    reference.reset();
+    keyframe = false;
 
-    // Clear vector of events
+    // Clear vector of events (keeps the capacity)
     stage_events.clear();
 
-    // Clear vector of accelerators
+    // Clear vector of accelerators (keeps the capacity)
     stage_acc.clear();
 
     // Clear the pointer to the current stage
@@ -90,9 +141,10 @@ void ViVidItem::recycle() {
     }
 
     // Reset time stages for CPU and GPU
-    timeGPU_S = std::vector<double>(NUM_STAGES, 0.0);
-    timeCPU_S = std::vector<double>(NUM_STAGES, 0.0);
+    timeGPU_S.fill(0.0);
+    timeCPU_S.fill(0.0);
 
     GPU_item = false;
+    branchesDone = 0;
 }
 } // namespace Pipeline_template
\ No newline at end of file
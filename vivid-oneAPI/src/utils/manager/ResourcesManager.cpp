@@ -63,9 +63,9 @@ ResourcesManager::~ResourcesManager() {
     }
 }
 
-std::tuple<AcquisitionStatus, Acc> ResourcesManager::acquireForStage(int stageIndex, StageState stageState, Acc preferredAcc) {
-    static std::unordered_map<std::thread::id, Acc> lastUsedDevice; // Map to store the last used device for each thread
-    std::mutex lastUsedDeviceMutex;                                 // Mutex to protect access to lastUsedDevice map
+std::tuple<AcquisitionStatus, Acc> ResourcesManager::acquireForStage(int stageIndex, StageState stageState, Acc preferredAcc, bool allowQueue) {
+    // Enqueuing blocks the thread until a core is free: a caller that cannot block waits for a release on its own
+    const bool useQueue = DEVICE_QUEUE_ENABLED && allowQueue;
 
     // Helper function to acquire core or enqueue task on a device
     auto tryAcquireCore = [&](Device *device) -> std::tuple<AcquisitionStatus, Acc> {
@@ -176,19 +176,19 @@ std::tuple<AcquisitionStatus, Acc> ResourcesManager::acquireForStage(int stageIn
     switch (mode) {
     case AcquisitionMode::DEFAULT: {
         if (stageState == StageState::CPU) {
-            return acquireResources(primaryDevice, nullptr, DEVICE_QUEUE_ENABLED);
+            return acquireResources(primaryDevice, nullptr, useQueue);
         } else if (stageState == StageState::GPU) {
-            return acquireResources(primaryDevice, nullptr, DEVICE_QUEUE_ENABLED);
+            return acquireResources(primaryDevice, nullptr, useQueue);
         } else if (stageState == StageState::CPU_GPU) {
-            return acquireResources(primaryDevice, secondaryDevice, DEVICE_QUEUE_ENABLED);
+            return acquireResources(primaryDevice, secondaryDevice, useQueue);
         }
         break;
     }
     case AcquisitionMode::PRIMARY_SECONDARY: {
         if (stageState == StageState::CPU) {
-            return acquireResources(primaryDevice, nullptr, DEVICE_QUEUE_ENABLED);
+            return acquireResources(primaryDevice, nullptr, useQueue);
         } else if (stageState == StageState::GPU) {
-            return acquireResources(primaryDevice, nullptr, DEVICE_QUEUE_ENABLED);
+            return acquireResources(primaryDevice, nullptr, useQueue);
         } else if (stageState == StageState::CPU_GPU) {
             // Try primary device first, then secondary
             if (primaryDevice) {
@@ -196,7 +196,7 @@ std::tuple<AcquisitionStatus, Acc> ResourcesManager::acquireForStage(int stageIn
                 if (status == AcquisitionStatus::AcquiredCore) {
                     return std::make_tuple(status, acc);
                 }
-                if (DEVICE_QUEUE_ENABLED) { // Verificación adicional
+                if (useQueue) { // Verificación adicional
                     auto [enqueueStatus, enqueueAcc] = tryEnqueueTask(primaryDevice);
                     if (enqueueStatus == AcquisitionStatus::Enqueued) {
                         return std::make_tuple(enqueueStatus, enqueueAcc);
@@ -208,7 +208,7 @@ std::tuple<AcquisitionStatus, Acc> ResourcesManager::acquireForStage(int stageIn
                 if (status == AcquisitionStatus::AcquiredCore) {
                     return std::make_tuple(status, acc);
                 }
-                if (DEVICE_QUEUE_ENABLED) { // Verificación adicional
+                if (useQueue) { // Verificación adicional
                     auto [enqueueStatus, enqueueAcc] = tryEnqueueTask(secondaryDevice);
                     if (enqueueStatus == AcquisitionStatus::Enqueued) {
                         return std::make_tuple(enqueueStatus, enqueueAcc);
@@ -0,0 +1,84 @@
+#include "QueuePool.hpp"
+#include <stdexcept>
+
+QueuePool::QueuePool(sycl::queue &gpuQueue, sycl::queue &cpuQueue, size_t queuesPerDevice, QueuePolicy policy_, bool inOrder_, bool cpuQueues)
+    : slots{queuesPerDevice}, policy{policy_}, inOrder{inOrder_} {
+    if (queuesPerDevice == 0) {
+        throw std::invalid_argument("QueuePool: a device needs at least one queue");
+    }
+    createQueues(gpu, gpuQueue, slots, inOrder);
+    if (cpuQueues) {
+        createQueues(cpu, cpuQueue, slots, inOrder);
+    }
+    load = std::make_unique<std::atomic<int>[]>(slots);
+    for (size_t i = 0; i < slots; ++i) {
+        load[i].store(0, std::memory_order_relaxed);
+    }
+}
+
+void QueuePool::createQueues(DeviceQueues &device, sycl::queue &configured, size_t count, bool inOrder) {
+    device.configured = &configured;
+    device.queues.reserve(count);
+    device.queues.push_back(configured);
+    // Same context as the configured queue, so the USM buffers of the items are valid on every queue
+    sycl::property_list props;
+    const bool profiling = configured.has_property<sycl::property::queue::enable_profiling>();
+    if (profiling && inOrder) {
+        props = sycl::property_list{sycl::property::queue::enable_profiling{}, sycl::property::queue::in_order{}};
+    } else if (profiling) {
+        props = sycl::property_list{sycl::property::queue::enable_profiling{}};
+    } else if (inOrder) {
+        props = sycl::property_list{sycl::property::queue::in_order{}};
+    }
+    for (size_t i = 1; i < count; ++i) {
+        device.queues.emplace_back(configured.get_context(), configured.get_device(), props);
+    }
+}
+
+void QueuePool::assign(ViVidItem *item) {
+    size_t slot = 0;
+    if (policy == QueuePolicy::LeastLoaded) {
+        // Approximate under concurrent assignments: a tie or a stale load only costs balance
+        int lowest = load[0].load(std::memory_order_relaxed);
+        for (size_t i = 1; i < slots && lowest > 0; ++i) {
+            int current = load[i].load(std::memory_order_relaxed);
+            if (current < lowest) {
+                lowest = current;
+                slot = i;
+            }
+        }
+    } else {
+        slot = next.fetch_add(1, std::memory_order_relaxed) % slots;
+    }
+    load[slot].fetch_add(1, std::memory_order_relaxed);
+    item->queuePool = this;
+    item->queueSlot = static_cast<int>(slot);
+}
+
+void QueuePool::release(ViVidItem *item) {
+    if (item->queueSlot >= 0) {
+        load[item->queueSlot].fetch_sub(1, std::memory_order_relaxed);
+        item->queuePool = nullptr;
+        item->queueSlot = -1;
+    }
+}
+
+sycl::queue &QueuePool::queueOf(const ViVidItem *item, sycl::queue &Q) {
+    if (item == nullptr || item->queueSlot < 0) {
+        return Q;
+    }
+    if (&Q == gpu.configured) {
+        return gpu.queues[item->queueSlot];
+    }
+    if (cpu.configured != nullptr && &Q == cpu.configured) {
+        return cpu.queues[item->queueSlot];
+    }
+    return Q;
+}
+
+std::string QueuePool::describe() const {
+    std::string text = std::to_string(slots) + (inOrder ? " in-order" : " out-of-order") + " queues per device (";
+    text += policy == QueuePolicy::LeastLoaded ? "least loaded" : "round-robin";
+    text += cpu.configured != nullptr ? ", GPU and CPU)" : ", GPU)";
+    return text;
+}
@@ -1,4 +1,6 @@
 #include "SYCLUtils.hpp"
+#include <cstdlib>
+#include <string>
 
 using namespace SYCLUtils;
 
@@ -34,7 +36,13 @@ sycl::nd_range<2> SYCLUtils::generate2DRange(std::size_t tileSize, std::size_t n
     return {sycl::range<2>{globalRows, globalCols}, sycl::range<2>{tileSize, tileSize}};
 }
 
-void SYCLUtils::configureSYCLQueues(sycl::queue &gpuQueue, sycl::queue &cpuQueue, int numThreads, bool syclEventsEnabled) {
+void SYCLUtils::configureSYCLQueues(sycl::queue &gpuQueue, sycl::queue &cpuQueue, int numThreads, bool syclEventsEnabled, bool quiet) {
+    // The host stages of --api syclevents run in host tasks: one thread of the runtime per CPU core for them (the
+    // variable is read when the runtime starts, a value given by the user wins)
+    if (syclEventsEnabled) {
+        setenv("SYCL_QUEUE_THREAD_POOL_SIZE", std::to_string(numThreads).c_str(), 0);
+    }
+
     // Select the properties of the queue
     sycl::property_list props;
     std::string propsStr = " SYCL Properties: ";
@@ -87,6 +95,9 @@ void SYCLUtils::configureSYCLQueues(sycl::queue &gpuQueue, sycl::queue &cpuQueue
         warmupSYCLDevice(cpuQueue);
     }
 
+    if (quiet) {
+        return; // Embedded (libvivid): the application owns the console
+    }
     std::cout << "---------------------------------------------------------------------------------------" << std::endl;
     std::cout << " DEVICES" << std::endl;
     std::cout << "---------------------------------------------------------------------------------------" << std::endl;
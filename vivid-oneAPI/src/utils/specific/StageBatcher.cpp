@@ -0,0 +1,129 @@
+#include "StageBatcher.hpp"
+#include "ApplicationData.hpp"
+#include "InputArgs.hpp"
+#include "Tracer.hpp"
+#include "common_macros.hpp"
+#include <algorithm>
+#include <stdexcept>
+#include <string>
+
+std::size_t StageBatcher::autoSize(int height, int width) {
+    const double pixels = static_cast<double>(height) * width;
+    if (pixels <= 0.0) {
+        return 1;
+    }
+    const auto batch = static_cast<std::size_t>(GPU_BATCH_PIXELS / pixels);
+    return std::clamp<std::size_t>(batch, 1, MAX_GPU_BATCH);
+}
+
+StageBatcher::StageBatcher(std::size_t numStages, std::size_t batchSize_, std::chrono::microseconds timeout_) : batchSize{batchSize_}, timeout{timeout_} {
+    if (batchSize < 2 || batchSize > MAX_GPU_BATCH) {
+        throw std::invalid_argument("StageBatcher: a batch has between 2 and " + std::to_string(MAX_GPU_BATCH) + " frames (got " + std::to_string(batchSize) + ")");
+    }
+    stages.reserve(numStages);
+    for (std::size_t i = 0; i < numStages; ++i) {
+        stages.push_back(std::make_unique<Stage>());
+    }
+}
+
+StageBatcher::~StageBatcher() = default;
+
+StageBatcher::Batch *StageBatcher::takeBatch(Stage &stage) {
+    if (stage.spare.empty()) {
+        stage.batches.push_back(std::make_unique<Batch>());
+        stage.batches.back()->depends_on.reserve(batchSize);
+        return stage.batches.back().get();
+    }
+    Batch *batch = stage.spare.back();
+    stage.spare.pop_back();
+    batch->count = 0;
+    batch->depends_on.clear();
+    batch->closed = false;
+    batch->done = false;
+    batch->event = sycl::event();
+    batch->error = nullptr;
+    return batch;
+}
+
+void StageBatcher::launch(Stage &stage, Batch *batch, const StageBatchKernel &kernel, ApplicationData &appData, std::unique_lock<std::mutex> &lock) {
+    // Close the batch: the next frames of the stage start another one while this one is launched
+    batch->closed = true;
+    if (stage.open == batch) {
+        stage.open = nullptr;
+    }
+    lock.unlock();
+    sycl::event event;
+    std::exception_ptr error;
+    try {
+        event = kernel(batch->items.data(), batch->count, appData, *batch->Q, &batch->depends_on);
+    } catch (...) {
+        error = std::current_exception();
+    }
+    launches.fetch_add(1, std::memory_order_relaxed);
+    frames.fetch_add(batch->count, std::memory_order_relaxed);
+    lock.lock();
+    batch->event = event;
+    batch->error = error;
+    batch->done = true;
+    stage.changed.notify_all();
+}
+
+SyclEventInfo StageBatcher::submit(std::size_t stageIndex, const StageBatchKernel &kernel, ViVidItem *item, Tracer &tracer, ApplicationData &appData, InputArgs &inputArgs, sycl::queue &Q,
+                                   std::vector<sycl::event> *depends_on) {
+    // Start tracing and timing, the time of the item is that of the launch of its batch
+    trace_start(item, tracer, "GPU");
+    start_timer(item);
+    item->execution_time = 0.0;
+
+    Stage &stage = *stages[stageIndex];
+    std::unique_lock<std::mutex> lock(stage.mutex);
+    Batch *batch = stage.open;
+    const bool first = batch == nullptr;
+    if (first) {
+        batch = takeBatch(stage);
+        batch->Q = &Q;
+        batch->deadline = std::chrono::steady_clock::now() + timeout;
+        stage.open = batch;
+    }
+    batch->items[batch->count++] = item;
+    if (depends_on != nullptr) {
+        batch->depends_on.insert(batch->depends_on.end(), depends_on->begin(), depends_on->end());
+    }
+    ++batch->waiting;
+
+    if (batch->count == batchSize) {
+        launch(stage, batch, kernel, appData, lock);
+    } else if (first) {
+        // The first frame launches the batch if it is not full in time
+        stage.changed.wait_until(lock, batch->deadline, [batch] { return batch->closed; });
+        if (!batch->closed) {
+            launch(stage, batch, kernel, appData, lock);
+        }
+    }
+    stage.changed.wait(lock, [batch] { return batch->done; });
+    sycl::event event = batch->event;
+    std::exception_ptr error = batch->error;
+    if (--batch->waiting == 0) {
+        stage.spare.push_back(batch);
+    }
+    lock.unlock();
+    if (error) {
+        std::rethrow_exception(error);
+    }
+
+    // As the kernels of one frame: without events to chain to, the stage returns once the kernel has run
+    if (depends_on == nullptr) {
+        event.wait();
+    } else {
+        wait_sycl_event(event);
+    }
+    if constexpr (ENERGYPCM_ENABLED || AUTOMODE_ENABLED || TIMESTAGES_ENABLED) {
+        appData.numFiltersGPU[stageIndex]++;
+    }
+
+    // Save the execution time and end tracing
+    save_time_info_on_sycl(item, inputArgs, event, static_cast<int>(stageIndex), "GPU_S");
+    trace_end(item, tracer, "GPU");
+
+    return SyclEventInfo(event, item->execution_time, Acc::GPU);
+}
@@ -0,0 +1,154 @@
+#include "StageGraphs.hpp"
+#include "InputArgs.hpp"
+#include "QueuePool.hpp"
+#include "Tracer.hpp"
+#include "common_macros.hpp"
+#include <iostream>
+#include <optional>
+#include <vector>
+
+#ifdef SYCL_EXT_ONEAPI_GRAPH
+namespace sycl_exp = sycl::ext::oneapi::experimental;
+
+struct StageGraphs::Graph {
+    Key key;
+    std::optional<sycl_exp::command_graph<sycl_exp::graph_state::executable>> graph;
+};
+#else
+struct StageGraphs::Graph {
+    Key key;
+};
+#endif
+
+struct StageGraphs::Slot {
+    std::vector<Graph> graphs; //< Graph of each slot of the input ring (the last one: the global frame)
+};
+
+bool StageGraphs::supported(const sycl::queue &Q, std::string &reason) {
+#ifdef SYCL_EXT_ONEAPI_GRAPH
+    if constexpr (TRACE_ENABLED || TIMESTAGES_ENABLED || AUTOMODE_ENABLED || ADVANCEDMETRICS_ENABLED) {
+        // A graph has a single event: the time of each stage could not be read from the profiling of its kernel
+        reason = "the stages are profiled one by one in this build";
+        return false;
+    }
+    const sycl::device device = Q.get_device();
+    if (!device.is_gpu()) {
+        reason = "the GPU queue runs on " + device.get_info<sycl::info::device::name>();
+        return false;
+    }
+    if (!device.has(sycl::aspect::ext_oneapi_limited_graph) && !device.has(sycl::aspect::ext_oneapi_graph)) {
+        reason = "the backend of " + device.get_info<sycl::info::device::name>() + " does not support graphs";
+        return false;
+    }
+    return true;
+#else
+    reason = "the compiler does not support sycl_ext_oneapi_graph";
+    return false;
+#endif
+}
+
+StageGraphs::StageGraphs(sycl::queue &Q_, size_t frameSlots_) : Q{Q_}, frameSlots{frameSlots_}, recordQueue{Q_.get_context(), Q_.get_device()} {}
+
+StageGraphs::~StageGraphs() = default;
+
+StageGraphs::Key StageGraphs::keyOf(ViVidItem *item, ApplicationData &appData) {
+    Key key;
+    key.frame = item->frame;
+    key.hasRegion = item->region != nullptr;
+    key.pixels = get_active_pixels(item, appData);
+    key.cells = get_active_cells(item, appData);
+    if (item->region != nullptr) {
+        key.firstCell = item->region->firstCell;
+        key.endCell = item->region->endCell;
+    }
+    return key;
+}
+
+bool StageGraphs::sameKey(const Key &a, const Key &b) {
+    auto sameRect = [](const Rect &r, const Rect &s) { return r.x == s.x && r.y == s.y && r.width == s.width && r.height == s.height; };
+    return a.frame == b.frame && a.hasRegion == b.hasRegion && sameRect(a.pixels, b.pixels) && sameRect(a.cells, b.cells) && a.firstCell == b.firstCell && a.endCell == b.endCell;
+}
+
+bool StageGraphs::countHit(bool hit) {
+    if (!hit) {
+        windowMisses.fetch_add(1, std::memory_order_relaxed);
+    }
+    if ((windowFrames.fetch_add(1, std::memory_order_relaxed) + 1) % HIT_WINDOW != 0) {
+        return true;
+    }
+    size_t misses = windowMisses.exchange(0, std::memory_order_relaxed);
+    if (misses <= MAX_MISSES) {
+        return true;
+    }
+    if (active.exchange(false)) {
+        std::cerr << " SYCL graphs disabled, the stages are submitted one by one: " << misses << " of the last " << HIT_WINDOW
+                  << " frames had to record their graph again (their region keeps changing)" << std::endl;
+    }
+    return false;
+}
+
+bool StageGraphs::replayGraph(ViVidItem *item, ApplicationData &appData, RecordFn record, void *context, sycl::event &event) {
+#ifdef SYCL_EXT_ONEAPI_GRAPH
+    if (!active.load(std::memory_order_relaxed)) {
+        return false;
+    }
+
+    // The graphs of an item are only used by the frame that holds the item
+    Slot *slot;
+    {
+        std::lock_guard<std::mutex> lock(slotsMutex);
+        std::unique_ptr<Slot> &entry = slots[item];
+        if (!entry) {
+            entry = std::make_unique<Slot>();
+            entry->graphs.resize(frameSlots + 1);
+        }
+        slot = entry.get();
+    }
+    size_t frameSlot = item->frameSlot >= 0 && static_cast<size_t>(item->frameSlot) < frameSlots ? static_cast<size_t>(item->frameSlot) : frameSlots;
+    Graph &cached = slot->graphs[frameSlot];
+
+    try {
+        Key key = keyOf(item, appData);
+        bool hit = cached.graph && sameKey(cached.key, key);
+        // Only the slots that already have a graph count: the first frames of each slot always record theirs
+        if (cached.graph && !countHit(hit)) {
+            return false;
+        }
+        if (!hit) {
+            sycl_exp::command_graph<sycl_exp::graph_state::modifiable> graph{Q.get_context(), Q.get_device()};
+            {
+                std::lock_guard<std::mutex> lock(recordMutex);
+                graph.begin_recording(recordQueue);
+                try {
+                    record(context, recordQueue);
+                } catch (...) {
+                    graph.end_recording(recordQueue);
+                    throw;
+                }
+                graph.end_recording(recordQueue);
+            }
+            // The previous graph of the slot finished with the last frame of the item
+            if (cached.graph) {
+                rerecorded.fetch_add(1, std::memory_order_relaxed);
+            }
+            cached.graph.reset();
+            cached.graph.emplace(graph.finalize());
+            cached.key = key;
+            recorded.fetch_add(1, std::memory_order_relaxed);
+        }
+        // With --queues the frame replays on its own queue (same context and device as the one of the graph)
+        sycl::queue &replayQueue = item->queuePool != nullptr ? item->queuePool->queueOf(item, Q) : Q;
+        event = replayQueue.ext_oneapi_graph(*cached.graph);
+        replayed.fetch_add(1, std::memory_order_relaxed);
+        return true;
+    } catch (const sycl::exception &e) {
+        cached.graph.reset();
+        if (active.exchange(false)) {
+            std::cerr << " SYCL graphs disabled, the stages are submitted one by one: " << e.what() << std::endl;
+        }
+        return false;
+    }
+#else
+    return false;
+#endif
+}